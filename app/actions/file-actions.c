@@ -100,6 +100,14 @@ static const GimpActionEntry file_actions[] =
     file_create_template_cmd_callback,
     GIMP_HELP_FILE_CREATE_TEMPLATE },
 
+  { "file-compact", NULL,
+    NC_("file-action", "Co_mpact"), NULL, { NULL },
+    NC_("file-action",
+        "Save this image again, rewriting the whole file instead of "
+        "appending the changes to it"),
+    file_compact_cmd_callback,
+    GIMP_HELP_FILE_COMPACT },
+
   { "file-revert", GIMP_ICON_IMAGE_RELOAD,
     NC_("file-action", "Re_vert"), NULL, { NULL },
     NC_("file-action", "Reload the image file from disk"),
@@ -291,6 +299,9 @@ file_actions_update (GimpActionGroup *group,
   SET_SENSITIVE ("file-save-as",              drawables);
   SET_SENSITIVE ("file-save-a-copy",          drawables);
   SET_SENSITIVE ("file-save-and-close",       drawables);
+  SET_SENSITIVE ("file-compact",              file && drawables &&
+                                              gimp->config->xcf_incremental_save);
+  SET_VISIBLE   ("file-compact",              gimp->config->xcf_incremental_save);
   SET_SENSITIVE ("file-revert",               file || source);
   SET_SENSITIVE ("file-export",               drawables);
   SET_VISIBLE   ("file-export",               ! show_overwrite);
@@ -60,6 +60,8 @@
 #include "dialogs/dialogs.h"
 #include "dialogs/file-save-dialog.h"
 
+#include "xcf/xcf.h"
+
 #include "actions.h"
 #include "file-commands.h"
 
@@ -430,6 +432,50 @@ file_create_template_cmd_callback (GimpAction *action,
   gtk_widget_show (dialog);
 }
 
+void
+file_compact_cmd_callback (GimpAction *action,
+                           GVariant   *value,
+                           gpointer    data)
+{
+  Gimp                *gimp;
+  GimpDisplay         *display;
+  GimpImage           *image;
+  GimpPlugInProcedure *save_proc;
+  GFile               *file;
+  return_if_no_gimp (gimp, data);
+  return_if_no_display (display, data);
+
+  image = gimp_display_get_image (display);
+  file  = gimp_image_get_file (image);
+
+  if (! file)
+    return;
+
+  save_proc = gimp_image_get_save_proc (image);
+
+  if (! save_proc)
+    save_proc =
+      gimp_plug_in_manager_file_procedure_find (gimp->plug_in_manager,
+                                                GIMP_FILE_PROCEDURE_GROUP_SAVE,
+                                                file, NULL);
+
+  if (! save_proc)
+    return;
+
+  /*  forget about the incremental saves, so the whole file gets
+   *  rewritten even if the image is clean
+   */
+  xcf_drop_incremental_state (image);
+
+  file_save_dialog_save_image (GIMP_PROGRESS (display),
+                               gimp, image, file,
+                               save_proc,
+                               GIMP_RUN_WITH_LAST_VALS,
+                               TRUE, FALSE, FALSE,
+                               gimp_image_get_xcf_compression (image),
+                               TRUE);
+}
+
 void
 file_revert_cmd_callback (GimpAction *action,
                           GVariant   *value,
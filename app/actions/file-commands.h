@@ -41,6 +41,9 @@ void   file_create_template_cmd_callback      (GimpAction *action,
                                                GVariant   *value,
                                                gpointer    data);
 
+void   file_compact_cmd_callback              (GimpAction *action,
+                                               GVariant   *value,
+                                               gpointer    data);
 void   file_revert_cmd_callback               (GimpAction *action,
                                                GVariant   *value,
                                                gpointer    data);
@@ -114,6 +114,10 @@ enum
   PROP_IMPORT_PROMOTE_DITHER,
   PROP_IMPORT_ADD_ALPHA,
   PROP_IMPORT_RAW_PLUG_IN,
+  PROP_BRUSH_CACHE_TOLERANCE,
+  PROP_RENDER_CACHE,
+  PROP_XCF_LAZY_LOAD,
+  PROP_XCF_INCREMENTAL_SAVE,
   PROP_EXPORT_FILE_TYPE,
   PROP_EXPORT_COLOR_PROFILE,
   PROP_EXPORT_COMMENT,
@@ -744,6 +748,34 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                          GIMP_PARAM_STATIC_STRINGS |
                          GIMP_CONFIG_PARAM_RESTART);
 
+  GIMP_CONFIG_PROP_DOUBLE (object_class, PROP_BRUSH_CACHE_TOLERANCE,
+                           "brush-cache-tolerance",
+                           "Brush cache tolerance",
+                           BRUSH_CACHE_TOLERANCE_BLURB,
+                           0.0, 4.0, 0.0,
+                           GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_RENDER_CACHE,
+                            "render-cache",
+                            "Render cache",
+                            RENDER_CACHE_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOAD,
+                            "xcf-lazy-load",
+                            "XCF lazy load",
+                            XCF_LAZY_LOAD_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_INCREMENTAL_SAVE,
+                            "xcf-incremental-save",
+                            "XCF incremental save",
+                            XCF_INCREMENTAL_SAVE_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_ENUM (object_class, PROP_EXPORT_FILE_TYPE,
                          "export-file-type",
                          "Default export file type",
@@ -1181,6 +1213,18 @@ gimp_core_config_set_property (GObject      *object,
       g_set_str (&core_config->import_raw_plug_in,
                  g_value_get_string (value));
       break;
+    case PROP_BRUSH_CACHE_TOLERANCE:
+      core_config->brush_cache_tolerance = g_value_get_double (value);
+      break;
+    case PROP_RENDER_CACHE:
+      core_config->render_cache = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_LAZY_LOAD:
+      core_config->xcf_lazy_load = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_INCREMENTAL_SAVE:
+      core_config->xcf_incremental_save = g_value_get_boolean (value);
+      break;
     case PROP_EXPORT_FILE_TYPE:
       core_config->export_file_type = g_value_get_enum (value);
       break;
@@ -1452,6 +1496,18 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_IMPORT_RAW_PLUG_IN:
       g_value_set_string (value, core_config->import_raw_plug_in);
       break;
+    case PROP_BRUSH_CACHE_TOLERANCE:
+      g_value_set_double (value, core_config->brush_cache_tolerance);
+      break;
+    case PROP_RENDER_CACHE:
+      g_value_set_boolean (value, core_config->render_cache);
+      break;
+    case PROP_XCF_LAZY_LOAD:
+      g_value_set_boolean (value, core_config->xcf_lazy_load);
+      break;
+    case PROP_XCF_INCREMENTAL_SAVE:
+      g_value_set_boolean (value, core_config->xcf_incremental_save);
+      break;
     case PROP_EXPORT_FILE_TYPE:
       g_value_set_enum (value, core_config->export_file_type);
       break;
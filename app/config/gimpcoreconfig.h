@@ -97,6 +97,10 @@ struct _GimpCoreConfig
   gboolean                import_promote_dither;
   gboolean                import_add_alpha;
   gchar                  *import_raw_plug_in;
+  gdouble                 brush_cache_tolerance;
+  gboolean                render_cache;
+  gboolean                xcf_lazy_load;
+  gboolean                xcf_incremental_save;
   GimpExportFileType      export_file_type;
   gboolean                export_color_profile;
   gboolean                export_comment;
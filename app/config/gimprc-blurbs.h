@@ -227,6 +227,26 @@ _("Add an alpha channel to all layers of imported images.")
 #define IMPORT_RAW_PLUG_IN_BLURB \
 _("Which plug-in to use for importing raw digital camera files.")
 
+#define BRUSH_CACHE_TOLERANCE_BLURB \
+_("How far, in pixels, the outline of a transformed brush may move so " \
+  "that nearby dabs can reuse it instead of transforming the brush " \
+  "again.  Set it to 0 to always paint the exact brush.")
+
+#define RENDER_CACHE_BLURB \
+_("Keep the composite of the layers below the selected layer in " \
+  "memory, so that editing the layer only composites the layers above " \
+  "it again.  The cache uses at most a quarter of the tile cache.")
+
+#define XCF_LAZY_LOAD_BLURB \
+_("Map local XCF files into memory when opening them and only decode " \
+  "the pixels of a layer when they are first needed.")
+
+#define XCF_INCREMENTAL_SAVE_BLURB \
+_("When saving an XCF file again, only encode the pixels which changed " \
+  "since the last save and reuse the rest of the file.  The file is " \
+  "rewritten from scratch once it contains more unused than used data.  " \
+  "Such files can only be opened by GIMP 3.2 or newer.")
+
 #define EXPORT_FILE_TYPE_BLURB \
 _("Export file type used by default.")
 
@@ -789,3 +789,11 @@ typedef enum  /*< pdb-skip, skip >*/
                              GIMP_ITEM_TYPE_CHANNELS |
                              GIMP_ITEM_TYPE_PATHS)
 } GimpItemTypeMask;
+
+
+typedef enum  /*< pdb-skip, skip >*/
+{
+  GIMP_XCF_COMPRESSION_NONE,  /*  RLE, readable by all versions  */
+  GIMP_XCF_COMPRESSION_ZLIB,  /*  needs GIMP 2.10                */
+  GIMP_XCF_COMPRESSION_ZSTD   /*  needs GIMP 3.2                 */
+} GimpXcfCompression;
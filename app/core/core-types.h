@@ -232,13 +232,18 @@ typedef struct _GimpWaitable                    GimpWaitable;    /* dummy typede
 /*  non-object types  */
 
 typedef struct _GimpBacktrace                   GimpBacktrace;
+typedef struct _GimpBoundaryCache               GimpBoundaryCache;
+typedef struct _GimpBoundaryIndex               GimpBoundaryIndex;
 typedef struct _GimpBoundSeg                    GimpBoundSeg;
 typedef struct _GimpChunkIterator               GimpChunkIterator;
 typedef struct _GimpCoords                      GimpCoords;
+typedef struct _GimpDataCache                   GimpDataCache;
+typedef struct _GimpDataCacheReader             GimpDataCacheReader;
 typedef struct _GimpGradientSegment             GimpGradientSegment;
 typedef struct _GimpPaletteEntry                GimpPaletteEntry;
 typedef struct _GimpScanConvert                 GimpScanConvert;
 typedef struct _GimpTempBuf                     GimpTempBuf;
+typedef struct _GimpUndoJournal                 GimpUndoJournal;
 typedef         guint32                         GimpTattoo;
 
 /* The following hack is made so that we can reuse the definition
@@ -105,6 +105,10 @@ gimp_data_factories_init (Gimp *gimp)
                                        gimp_brush_pipe_load,
                                        GIMP_BRUSH_PIPE_FILE_EXTENSION,
                                        TRUE);
+  gimp_data_loader_factory_set_cache (gimp->brush_factory,
+                                      "brushes",
+                                      gimp_brush_save_to_cache,
+                                      gimp_brush_load_from_cache);
 
   gimp->dynamics_factory =
     gimp_data_loader_factory_new (gimp,
@@ -156,6 +160,10 @@ gimp_data_factories_init (Gimp *gimp)
   gimp_data_loader_factory_add_fallback (gimp->pattern_factory,
                                          "Pattern from GdkPixbuf",
                                          gimp_pattern_load_pixbuf);
+  gimp_data_loader_factory_set_cache (gimp->pattern_factory,
+                                      "patterns",
+                                      gimp_pattern_save_to_cache,
+                                      gimp_pattern_load_from_cache);
 
   gimp->gradient_factory =
     gimp_data_loader_factory_new (gimp,
@@ -177,6 +185,10 @@ gimp_data_factories_init (Gimp *gimp)
                                        gimp_gradient_load_svg,
                                        GIMP_GRADIENT_SVG_FILE_EXTENSION,
                                        FALSE);
+  gimp_data_loader_factory_set_cache (gimp->gradient_factory,
+                                      "gradients",
+                                      gimp_gradient_save_to_cache,
+                                      gimp_gradient_load_from_cache);
 
   gimp->palette_factory =
     gimp_data_loader_factory_new (gimp,
@@ -193,6 +205,10 @@ gimp_data_factories_init (Gimp *gimp)
                                        gimp_palette_load,
                                        GIMP_PALETTE_FILE_EXTENSION,
                                        TRUE);
+  gimp_data_loader_factory_set_cache (gimp->palette_factory,
+                                      "palettes",
+                                      gimp_palette_save_to_cache,
+                                      gimp_palette_load_from_cache);
 
   gimp->font_factory =
     gimp_font_factory_new (gimp,
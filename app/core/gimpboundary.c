@@ -32,6 +32,18 @@
 /* GimpBoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* size of the tiles of a GimpBoundaryCache */
+#define CACHE_TILE_SIZE  128
+
+/* size of the cells of a GimpBoundaryIndex */
+#define INDEX_CELL_SIZE  128
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+#define IS_SENTINEL(seg) \
+  ((seg)->x1 == -1 && (seg)->y1 == -1 && (seg)->x2 == -1 && (seg)->y2 == -1)
+
 
 typedef struct _GimpBoundary GimpBoundary;
 
@@ -52,6 +64,63 @@ struct _GimpBoundary
   gint          max_empty_segs;
 };
 
+typedef struct
+{
+  GimpBoundSeg *segs;
+  gint          num_segs;
+  gboolean      valid;
+} BoundaryTile;
+
+struct _GimpBoundaryCache
+{
+  /*  the parameters the tiles were computed with  */
+  GeglBuffer       *buffer;
+  GeglRectangle     extent;
+  GeglRectangle     region;
+  const Babl       *format;
+  GimpBoundaryType  type;
+  gint              x1, y1;
+  gint              x2, y2;
+  gfloat            threshold;
+
+  /*  the pixels which can be selected, except for the hole  */
+  GeglRectangle     area;
+  GeglRectangle     hole;
+
+  /*  the tiles, covering the edges between the buffer's pixels  */
+  BoundaryTile     *tiles;
+  gint              n_cols;
+  gint              n_rows;
+};
+
+struct _GimpBoundaryIndex
+{
+  const GimpBoundSeg *segs;
+  gint                num_segs;
+
+  /*  the segs, bucketed by the cell of their top-left end  */
+  gint                x, y;
+  gint                n_cols;
+  gint                n_rows;
+  gint               *cell_start;
+  gint               *cell_x2;
+  gint               *cell_y2;
+  gint               *order;
+};
+
+typedef struct
+{
+  GimpBoundaryCache *cache;
+  gint              *tiles;
+} BoundaryCacheData;
+
+typedef struct
+{
+  const GimpBoundSeg *seg;
+  gint                row;  /* the row of pixels the seg borders     */
+  gint                run;  /* the run of selected pixels it borders */
+} BoundaryCacheSeg;
+
 
 /*  local function prototypes  */
 
@@ -101,6 +170,30 @@ static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
                                                 gint                 y2,
                                                 gfloat               threshold);
 
+static void           gimp_boundary_cache_reset     (GimpBoundaryCache       *cache);
+static void           boundary_cache_get_tile_edges (GimpBoundaryCache       *cache,
+                                                     gint                     col,
+                                                     gint                     row,
+                                                     GeglRectangle           *edges);
+static void           boundary_cache_compute_tile   (GimpBoundaryCache       *cache,
+                                                     gint                     i);
+static void           boundary_cache_compute_tiles  (gsize                    offset,
+                                                     gsize                    size,
+                                                     BoundaryCacheData       *data);
+static void           boundary_cache_update         (GimpBoundaryCache       *cache);
+static GimpBoundSeg * boundary_cache_stitch         (GimpBoundaryCache       *cache,
+                                                     gint                    *num_segs);
+static GimpBoundSeg * boundary_cache_sort           (GimpBoundaryCache       *cache,
+                                                     GimpBoundSeg            *segs,
+                                                     gint                    *num_segs);
+static gint           boundary_cache_cmp_vert       (const GimpBoundSeg     **seg_ptr_a,
+                                                     const GimpBoundSeg     **seg_ptr_b);
+static gint           boundary_cache_cmp_horiz      (const BoundaryCacheSeg  *seg_a,
+                                                     const BoundaryCacheSeg  *seg_b);
+
+static inline gint    boundary_index_cell           (const GimpBoundaryIndex *index,
+                                                     const GimpBoundSeg      *seg);
+
 static gint       cmp_segptr_xy1_addr     (const GimpBoundSeg **seg_ptr_a,
                                            const GimpBoundSeg **seg_ptr_b);
 static gint       cmp_segptr_xy2_addr     (const GimpBoundSeg **seg_ptr_a,
@@ -408,6 +501,381 @@ gimp_boundary_offset (GimpBoundSeg *segs,
     }
 }
 
+/**
+ * gimp_boundary_cache_new:
+ *
+ * Creates a cache which keeps the boundary of a buffer in tiles, so that
+ * after a change only the tiles touching the changed area need to be
+ * computed again, see gimp_boundary_cache_invalidate().
+ *
+ * Returns: the new #GimpBoundaryCache.
+ **/
+GimpBoundaryCache *
+gimp_boundary_cache_new (void)
+{
+  return g_slice_new0 (GimpBoundaryCache);
+}
+
+void
+gimp_boundary_cache_free (GimpBoundaryCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  gimp_boundary_cache_reset (cache);
+
+  g_slice_free (GimpBoundaryCache, cache);
+}
+
+/**
+ * gimp_boundary_cache_invalidate:
+ * @cache: a #GimpBoundaryCache
+ * @rect:  the changed area of the buffer, or %NULL
+ *
+ * Drops the tiles of the boundary affected by a change of the pixels in
+ * @rect, or all of them if @rect is %NULL.
+ **/
+void
+gimp_boundary_cache_invalidate (GimpBoundaryCache   *cache,
+                                const GeglRectangle *rect)
+{
+  gint col1, row1;
+  gint col2, row2;
+  gint col, row;
+
+  g_return_if_fail (cache != NULL);
+
+  if (! rect)
+    {
+      gimp_boundary_cache_reset (cache);
+      return;
+    }
+
+  if (! cache->tiles || rect->width <= 0 || rect->height <= 0)
+    return;
+
+  /*  a pixel borders the edges on its top and left sides, which belong
+   *  to its own tile, and the ones on its bottom and right sides, which
+   *  may belong to the next tiles
+   */
+  col1 = floor ((gdouble) (rect->x - cache->extent.x) /
+                CACHE_TILE_SIZE);
+  row1 = floor ((gdouble) (rect->y - cache->extent.y) /
+                CACHE_TILE_SIZE);
+  col2 = floor ((gdouble) (rect->x + rect->width - cache->extent.x) /
+                CACHE_TILE_SIZE);
+  row2 = floor ((gdouble) (rect->y + rect->height - cache->extent.y) /
+                CACHE_TILE_SIZE);
+
+  col1 = MAX (col1, 0);
+  row1 = MAX (row1, 0);
+  col2 = MIN (col2, cache->n_cols - 1);
+  row2 = MIN (row2, cache->n_rows - 1);
+
+  for (row = row1; row <= row2; row++)
+    {
+      for (col = col1; col <= col2; col++)
+        {
+          BoundaryTile *tile = &cache->tiles[row * cache->n_cols + col];
+
+          g_clear_pointer (&tile->segs, g_free);
+          tile->num_segs = 0;
+          tile->valid    = FALSE;
+        }
+    }
+}
+
+/**
+ * gimp_boundary_cache_find:
+ * @cache:     a #GimpBoundaryCache
+ * @buffer:    a #GeglBuffer
+ * @region:    the area of @buffer to consider, or %NULL
+ * @format:    a #Babl float format representing the component to analyze
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        bottom side of bounds
+ * @threshold: pixel value of boundary line
+ * @num_segs:  number of returned #GimpBoundSeg's
+ *
+ * Like gimp_boundary_find(), but only computes the tiles of the boundary
+ * which were invalidated since the last call, and stitches them with
+ * the cached ones.  The returned segments are the same as the ones
+ * returned by gimp_boundary_find(), in the same order.
+ *
+ * The cache starts over when called with a different buffer or
+ * different parameters.
+ *
+ * Returns: the boundary array.
+ **/
+GimpBoundSeg *
+gimp_boundary_cache_find (GimpBoundaryCache   *cache,
+                          GeglBuffer          *buffer,
+                          const GeglRectangle *region,
+                          const Babl          *format,
+                          GimpBoundaryType     type,
+                          gint                 x1,
+                          gint                 y1,
+                          gint                 x2,
+                          gint                 y2,
+                          gfloat               threshold,
+                          gint                *num_segs)
+{
+  GeglRectangle rect = { 0, };
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (num_segs != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (babl_format_get_bytes_per_pixel (format) ==
+                        sizeof (gfloat), NULL);
+
+  if (region)
+    {
+      rect = *region;
+    }
+  else
+    {
+      rect.width  = gegl_buffer_get_width  (buffer);
+      rect.height = gegl_buffer_get_height (buffer);
+    }
+
+  if (cache->buffer    != buffer                               ||
+      ! gegl_rectangle_equal (&cache->extent,
+                              gegl_buffer_get_extent (buffer)) ||
+      ! gegl_rectangle_equal (&cache->region, &rect)           ||
+      cache->format    != format                               ||
+      cache->type      != type                                 ||
+      cache->x1        != x1                                   ||
+      cache->y1        != y1                                   ||
+      cache->x2        != x2                                   ||
+      cache->y2        != y2                                   ||
+      cache->threshold != threshold)
+    {
+      gimp_boundary_cache_reset (cache);
+
+      cache->buffer    = buffer;
+      cache->extent    = *gegl_buffer_get_extent (buffer);
+      cache->region    = rect;
+      cache->format    = format;
+      cache->type      = type;
+      cache->x1        = x1;
+      cache->y1        = y1;
+      cache->x2        = x2;
+      cache->y2        = y2;
+      cache->threshold = threshold;
+
+      g_object_add_weak_pointer (G_OBJECT (buffer),
+                                 (gpointer) &cache->buffer);
+
+      /*  the tiles cover the edges between the pixels, which are one
+       *  more than the pixels in each direction
+       */
+      cache->n_cols = (cache->extent.width  + CACHE_TILE_SIZE) /
+                      CACHE_TILE_SIZE;
+      cache->n_rows = (cache->extent.height + CACHE_TILE_SIZE) /
+                      CACHE_TILE_SIZE;
+
+      cache->tiles = g_new0 (BoundaryTile, cache->n_cols * cache->n_rows);
+    }
+
+  boundary_cache_update (cache);
+
+  return boundary_cache_sort (cache,
+                              boundary_cache_stitch (cache, num_segs),
+                              num_segs);
+}
+
+/**
+ * gimp_boundary_index_new:
+ * @segs:     segs, as returned by gimp_boundary_find()
+ * @num_segs: number of segs
+ *
+ * Creates a spatial index of @segs, which allows finding the segs in an
+ * area quickly, see gimp_boundary_index_query().  @segs must stay around
+ * as long as the index.
+ *
+ * Returns: the new #GimpBoundaryIndex.
+ **/
+GimpBoundaryIndex *
+gimp_boundary_index_new (const GimpBoundSeg *segs,
+                         gint                num_segs)
+{
+  GimpBoundaryIndex *index;
+  gint               x1 = G_MAXINT;
+  gint               y1 = G_MAXINT;
+  gint               x2 = G_MININT;
+  gint               y2 = G_MININT;
+  gint               n_cells;
+  gint               i;
+
+  g_return_val_if_fail ((segs == NULL && num_segs == 0) ||
+                        (segs != NULL && num_segs >  0), NULL);
+
+  index = g_slice_new0 (GimpBoundaryIndex);
+
+  index->segs     = segs;
+  index->num_segs = num_segs;
+
+  for (i = 0; i < num_segs; i++)
+    {
+      if (IS_SENTINEL (&segs[i]))
+        continue;
+
+      x1 = MIN (x1, MIN (segs[i].x1, segs[i].x2));
+      y1 = MIN (y1, MIN (segs[i].y1, segs[i].y2));
+      x2 = MAX (x2, MAX (segs[i].x1, segs[i].x2));
+      y2 = MAX (y2, MAX (segs[i].y1, segs[i].y2));
+    }
+
+  if (x1 > x2)
+    return index;
+
+  index->x      = x1;
+  index->y      = y1;
+  index->n_cols = (x2 - x1) / INDEX_CELL_SIZE + 1;
+  index->n_rows = (y2 - y1) / INDEX_CELL_SIZE + 1;
+
+  n_cells = index->n_cols * index->n_rows;
+
+  /*  bucket the segs by the cell of their top-left end, and remember how
+   *  far the segs of each cell reach
+   */
+  index->cell_start = g_new0 (gint, n_cells + 1);
+  index->cell_x2    = g_new  (gint, n_cells);
+  index->cell_y2    = g_new  (gint, n_cells);
+  index->order      = g_new  (gint, num_segs);
+
+  for (i = 0; i < n_cells; i++)
+    {
+      index->cell_x2[i] = G_MININT;
+      index->cell_y2[i] = G_MININT;
+    }
+
+  for (i = 0; i < num_segs; i++)
+    {
+      gint cell;
+
+      if (IS_SENTINEL (&segs[i]))
+        continue;
+
+      cell = boundary_index_cell (index, &segs[i]);
+
+      index->cell_start[cell + 1]++;
+      index->cell_x2[cell] = MAX (index->cell_x2[cell],
+                                  MAX (segs[i].x1, segs[i].x2));
+      index->cell_y2[cell] = MAX (index->cell_y2[cell],
+                                  MAX (segs[i].y1, segs[i].y2));
+    }
+
+  for (i = 0; i < n_cells; i++)
+    index->cell_start[i + 1] += index->cell_start[i];
+
+  {
+    gint *fill = g_memdup2 (index->cell_start, n_cells * sizeof (gint));
+
+    for (i = 0; i < num_segs; i++)
+      {
+        if (IS_SENTINEL (&segs[i]))
+          continue;
+
+        index->order[fill[boundary_index_cell (index, &segs[i])]++] = i;
+      }
+
+    g_free (fill);
+  }
+
+  return index;
+}
+
+void
+gimp_boundary_index_free (GimpBoundaryIndex *index)
+{
+  g_return_if_fail (index != NULL);
+
+  g_free (index->cell_start);
+  g_free (index->cell_x2);
+  g_free (index->cell_y2);
+  g_free (index->order);
+
+  g_slice_free (GimpBoundaryIndex, index);
+}
+
+/**
+ * gimp_boundary_index_query:
+ * @index:    a #GimpBoundaryIndex
+ * @rect:     the area to look in
+ * @num_segs: number of returned segs
+ *
+ * Returns the segs of @index which touch @rect, for example to only
+ * draw the visible part of a boundary.
+ *
+ * Returns: a newly allocated array of segs, or %NULL if there are none.
+ **/
+GimpBoundSeg *
+gimp_boundary_index_query (GimpBoundaryIndex   *index,
+                           const GeglRectangle *rect,
+                           gint                *num_segs)
+{
+  GArray *segs;
+  gint    col2, row2;
+  gint    col, row;
+
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (rect != NULL, NULL);
+  g_return_val_if_fail (num_segs != NULL, NULL);
+
+  *num_segs = 0;
+
+  if (! index->cell_start)
+    return NULL;
+
+  if (rect->x + rect->width < index->x || rect->y + rect->height < index->y)
+    return NULL;
+
+  /*  segs start in their cell, so only the cells up to the area's
+   *  bottom-right corner can have segs in it
+   */
+  col2 = MIN ((rect->x + rect->width  - index->x) / INDEX_CELL_SIZE,
+              index->n_cols - 1);
+  row2 = MIN ((rect->y + rect->height - index->y) / INDEX_CELL_SIZE,
+              index->n_rows - 1);
+
+  segs = g_array_new (FALSE, FALSE, sizeof (GimpBoundSeg));
+
+  for (row = 0; row <= row2; row++)
+    {
+      for (col = 0; col <= col2; col++)
+        {
+          gint cell = row * index->n_cols + col;
+          gint i;
+
+          if (index->cell_x2[cell] < rect->x ||
+              index->cell_y2[cell] < rect->y)
+            {
+              continue;
+            }
+
+          for (i = index->cell_start[cell]; i < index->cell_start[cell + 1]; i++)
+            {
+              const GimpBoundSeg *seg = &index->segs[index->order[i]];
+
+              if (MAX (seg->x1, seg->x2) >= rect->x                &&
+                  MIN (seg->x1, seg->x2) <= rect->x + rect->width  &&
+                  MAX (seg->y1, seg->y2) >= rect->y                &&
+                  MIN (seg->y1, seg->y2) <= rect->y + rect->height)
+                {
+                  g_array_append_val (segs, *seg);
+                }
+            }
+        }
+    }
+
+  *num_segs = segs->len;
+
+  return (GimpBoundSeg *) g_array_free (segs, segs->len == 0);
+}
+
 
 /*  private functions  */
 
@@ -769,6 +1237,537 @@ generate_boundary (GeglBuffer          *buffer,
   return boundary;
 }
 
+/*  boundary cache functions  */
+
+static void
+gimp_boundary_cache_reset (GimpBoundaryCache *cache)
+{
+  if (cache->tiles)
+    {
+      gint i;
+
+      for (i = 0; i < cache->n_cols * cache->n_rows; i++)
+        g_free (cache->tiles[i].segs);
+
+      g_clear_pointer (&cache->tiles, g_free);
+    }
+
+  if (cache->buffer)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (cache->buffer),
+                                    (gpointer) &cache->buffer);
+      cache->buffer = NULL;
+    }
+
+  cache->n_cols = 0;
+  cache->n_rows = 0;
+}
+
+/* returns the edges a tile of the cache covers: the horizontal edges
+ * above its pixels, and the vertical edges to their left.
+ */
+static void
+boundary_cache_get_tile_edges (GimpBoundaryCache *cache,
+                               gint               col,
+                               gint               row,
+                               GeglRectangle     *edges)
+{
+  edges->x      = cache->extent.x + col * CACHE_TILE_SIZE;
+  edges->y      = cache->extent.y + row * CACHE_TILE_SIZE;
+  edges->width  = MIN (CACHE_TILE_SIZE,
+                       cache->extent.x + cache->extent.width  + 1 - edges->x);
+  edges->height = MIN (CACHE_TILE_SIZE,
+                       cache->extent.y + cache->extent.height + 1 - edges->y);
+}
+
+static inline void
+boundary_tile_add_seg (GArray   *segs,
+                       gint      x1,
+                       gint      y1,
+                       gint      x2,
+                       gint      y2,
+                       gboolean  open)
+{
+  GimpBoundSeg seg = { x1, y1, x2, y2, open, FALSE };
+
+  g_array_append_val (segs, seg);
+}
+
+/* computes the segs of a tile: runs of edges between a selected and an
+ * unselected pixel, the same way generate_boundary() finds them, but
+ * cut at the tile's sides.
+ */
+static void
+boundary_cache_compute_tile (GimpBoundaryCache *cache,
+                             gint               i)
+{
+  BoundaryTile  *tile = &cache->tiles[i];
+  GeglRectangle  edges;
+  GeglRectangle  pixels;
+  GeglRectangle  src;
+  GArray        *segs;
+
+  boundary_cache_get_tile_edges (cache,
+                                 i % cache->n_cols, i / cache->n_cols,
+                                 &edges);
+
+  pixels.x      = edges.x - 1;
+  pixels.y      = edges.y - 1;
+  pixels.width  = edges.width  + 1;
+  pixels.height = edges.height + 1;
+
+  segs = g_array_new (FALSE, FALSE, sizeof (GimpBoundSeg));
+
+  if (gegl_rectangle_intersect (&src, &pixels, &cache->area))
+    {
+      gint    stride = pixels.width;
+      guchar *mask;
+      gfloat *data;
+      gint    x, y;
+
+      mask = g_new0 (guchar, pixels.width * pixels.height);
+      data = g_new (gfloat, src.width * src.height);
+
+      gegl_buffer_get (cache->buffer, &src, 1.0, cache->format, data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (y = 0; y < src.height; y++)
+        {
+          const gfloat *d = data + y * src.width;
+          guchar       *m = mask + (src.y - pixels.y + y) * stride +
+                                   (src.x - pixels.x);
+
+          for (x = 0; x < src.width; x++)
+            {
+              m[x] = d[x] > cache->threshold &&
+                     ! (src.x + x >= cache->hole.x                      &&
+                        src.x + x <  cache->hole.x + cache->hole.width  &&
+                        src.y + y >= cache->hole.y                      &&
+                        src.y + y <  cache->hole.y + cache->hole.height);
+            }
+        }
+
+      g_free (data);
+
+      /*  horizontal segs, between each row of pixels and the one above  */
+      for (y = 0; y < edges.height; y++)
+        {
+          const guchar *above = mask + y * stride + 1;
+          const guchar *below = above + stride;
+          gint          kind  = -1;
+          gint          start = 0;
+
+          for (x = 0; x <= edges.width; x++)
+            {
+              gint k = -1;
+
+              if (x < edges.width && above[x] != below[x])
+                k = below[x];
+
+              if (k != kind)
+                {
+                  if (kind >= 0)
+                    boundary_tile_add_seg (segs,
+                                           edges.x + start, edges.y + y,
+                                           edges.x + x,     edges.y + y,
+                                           kind);
+
+                  kind  = k;
+                  start = x;
+                }
+            }
+        }
+
+      /*  vertical segs, between each column of pixels and the one to the
+       *  left
+       */
+      for (x = 0; x < edges.width; x++)
+        {
+          gint kind  = -1;
+          gint start = 0;
+
+          for (y = 0; y <= edges.height; y++)
+            {
+              gint k = -1;
+
+              if (y < edges.height)
+                {
+                  const guchar *m = mask + (y + 1) * stride + x;
+
+                  if (m[0] != m[1])
+                    k = m[1];
+                }
+
+              if (k != kind)
+                {
+                  if (kind >= 0)
+                    boundary_tile_add_seg (segs,
+                                           edges.x + x, edges.y + start,
+                                           edges.x + x, edges.y + y,
+                                           kind);
+
+                  kind  = k;
+                  start = y;
+                }
+            }
+        }
+
+      g_free (mask);
+    }
+
+  tile->num_segs = segs->len;
+  tile->segs     = (GimpBoundSeg *) g_array_free (segs, segs->len == 0);
+  tile->valid    = TRUE;
+}
+
+static void
+boundary_cache_compute_tiles (gsize              offset,
+                              gsize              size,
+                              BoundaryCacheData *data)
+{
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    boundary_cache_compute_tile (data->cache, data->tiles[i]);
+}
+
+/* computes the invalid tiles of the cache, on worker threads */
+static void
+boundary_cache_update (GimpBoundaryCache *cache)
+{
+  BoundaryCacheData data;
+  gint              n_tiles = cache->n_cols * cache->n_rows;
+  gint              n_invalid;
+  gint              i;
+
+  data.cache = cache;
+  data.tiles = g_new (gint, n_tiles);
+
+  for (i = 0, n_invalid = 0; i < n_tiles; i++)
+    {
+      if (! cache->tiles[i].valid)
+        data.tiles[n_invalid++] = i;
+    }
+
+  if (n_invalid > 0)
+    {
+      /*  the pixels which can be selected, and, when ignoring bounds, the
+       *  ones which can't even so
+       */
+      if (cache->type == GIMP_BOUNDARY_WITHIN_BOUNDS)
+        {
+          gint y1 = MAX (cache->y1, cache->region.y);
+          gint y2 = MIN (cache->y2, cache->region.y + cache->region.height);
+
+          gegl_rectangle_set (&cache->area,
+                              cache->x1, y1,
+                              MAX (cache->x2 - cache->x1, 0), MAX (y2 - y1, 0));
+          gegl_rectangle_set (&cache->hole, 0, 0, 0, 0);
+        }
+      else
+        {
+          cache->area = cache->region;
+
+          gegl_rectangle_set (&cache->hole,
+                              cache->x1, cache->y1,
+                              MAX (cache->x2 - cache->x1, 0),
+                              MAX (cache->y2 - cache->y1, 0));
+        }
+
+      gegl_rectangle_intersect (&cache->area, &cache->area, &cache->extent);
+
+      gegl_parallel_distribute_range (
+        n_invalid, PIXELS_PER_THREAD / (CACHE_TILE_SIZE * CACHE_TILE_SIZE),
+        (GeglParallelDistributeRangeFunc) boundary_cache_compute_tiles,
+        &data);
+    }
+
+  g_free (data.tiles);
+}
+
+/* joins the segs of all tiles, merging the ones which continue across
+ * the tiles' sides.
+ */
+static GimpBoundSeg *
+boundary_cache_stitch (GimpBoundaryCache *cache,
+                       gint              *num_segs)
+{
+  GimpBoundSeg *segs;
+  gint         *pending_h;
+  gint         *next_h;
+  gint         *pending_v;
+  gint         *next_v;
+  gint          max_segs = 0;
+  gint          n_segs   = 0;
+  gint          width    = cache->extent.width + 1;
+  gint          col, row;
+  gint          i;
+
+  for (i = 0; i < cache->n_cols * cache->n_rows; i++)
+    max_segs += cache->tiles[i].num_segs;
+
+  *num_segs = 0;
+
+  if (max_segs == 0)
+    return NULL;
+
+  segs = g_new (GimpBoundSeg, max_segs);
+
+  /*  the segs ending on the right side of the previous tile, by row, and
+   *  on the bottom side of the previous row of tiles, by column
+   */
+  pending_h = g_new (gint, CACHE_TILE_SIZE);
+  next_h    = g_new (gint, CACHE_TILE_SIZE);
+  pending_v = g_new (gint, width);
+  next_v    = g_new (gint, width);
+
+  for (i = 0; i < width; i++)
+    pending_v[i] = -1;
+
+  for (row = 0; row < cache->n_rows; row++)
+    {
+      for (i = 0; i < width; i++)
+        next_v[i] = -1;
+
+      for (i = 0; i < CACHE_TILE_SIZE; i++)
+        pending_h[i] = -1;
+
+      for (col = 0; col < cache->n_cols; col++)
+        {
+          const BoundaryTile *tile = &cache->tiles[row * cache->n_cols + col];
+          GeglRectangle       edges;
+          gint               *tmp;
+
+          boundary_cache_get_tile_edges (cache, col, row, &edges);
+
+          for (i = 0; i < CACHE_TILE_SIZE; i++)
+            next_h[i] = -1;
+
+          for (i = 0; i < tile->num_segs; i++)
+            {
+              const GimpBoundSeg *seg = &tile->segs[i];
+              gint                index;
+
+              if (seg->y1 == seg->y2)
+                {
+                  gint y = seg->y1 - edges.y;
+
+                  index = pending_h[y];
+
+                  if (seg->x1 == edges.x && index >= 0 &&
+                      segs[index].open == seg->open)
+                    {
+                      segs[index].x2 = seg->x2;
+                    }
+                  else
+                    {
+                      index = n_segs;
+                      segs[n_segs++] = *seg;
+                    }
+
+                  if (seg->x2 == edges.x + edges.width)
+                    next_h[y] = index;
+                }
+              else
+                {
+                  gint x = seg->x1 - cache->extent.x;
+
+                  index = pending_v[x];
+
+                  if (seg->y1 == edges.y && index >= 0 &&
+                      segs[index].open == seg->open)
+                    {
+                      segs[index].y2 = seg->y2;
+                    }
+                  else
+                    {
+                      index = n_segs;
+                      segs[n_segs++] = *seg;
+                    }
+
+                  if (seg->y2 == edges.y + edges.height)
+                    next_v[x] = index;
+                }
+            }
+
+          tmp       = pending_h;
+          pending_h = next_h;
+          next_h    = tmp;
+        }
+
+      {
+        gint *tmp = pending_v;
+
+        pending_v = next_v;
+        next_v    = tmp;
+      }
+    }
+
+  g_free (pending_h);
+  g_free (next_h);
+  g_free (pending_v);
+  g_free (next_v);
+
+  *num_segs = n_segs;
+
+  return g_renew (GimpBoundSeg, segs, n_segs);
+}
+
+/* puts the stitched segs in the order generate_boundary() adds them in:
+ * row by row, and for each run of selected pixels in a row, the
+ * horizontal segs above it, then the ones below it, each one after the
+ * vertical segs it closes.  the runs of a row are told apart by the
+ * vertical segs crossing it, and the vertical segs are then made again
+ * by process_horiz_seg(), the same way generate_boundary() makes them.
+ */
+static GimpBoundSeg *
+boundary_cache_sort (GimpBoundaryCache *cache,
+                     GimpBoundSeg      *segs,
+                     gint              *num_segs)
+{
+  GimpBoundary        *boundary;
+  BoundaryCacheSeg    *horiz;
+  const GimpBoundSeg **vert;
+  gint                 n_horiz = 0;
+  gint                 n_vert  = 0;
+  gint                 n_rows  = cache->extent.height;
+  gint                *row_start;
+  gint                *row_fill;
+  gint                *row_edges;
+  gint                 i;
+
+  if (*num_segs == 0)
+    return segs;
+
+  horiz     = g_new (BoundaryCacheSeg, *num_segs);
+  vert      = g_new (const GimpBoundSeg *, *num_segs);
+  row_start = g_new0 (gint, n_rows + 1);
+
+  for (i = 0; i < *num_segs; i++)
+    {
+      const GimpBoundSeg *seg = &segs[i];
+
+      if (seg->y1 == seg->y2)
+        {
+          horiz[n_horiz++].seg = seg;
+        }
+      else
+        {
+          gint y;
+
+          vert[n_vert++] = seg;
+
+          for (y = seg->y1; y < seg->y2; y++)
+            row_start[y - cache->extent.y + 1]++;
+        }
+    }
+
+  for (i = 0; i < n_rows; i++)
+    row_start[i + 1] += row_start[i];
+
+  /*  the x of the vertical segs crossing each row, from left to right  */
+  qsort (vert, n_vert, sizeof (const GimpBoundSeg *),
+         (GCompareFunc) boundary_cache_cmp_vert);
+
+  row_fill  = g_memdup2 (row_start, n_rows * sizeof (gint));
+  row_edges = g_new (gint, MAX (row_start[n_rows], 1));
+
+  for (i = 0; i < n_vert; i++)
+    {
+      gint y;
+
+      for (y = vert[i]->y1; y < vert[i]->y2; y++)
+        row_edges[row_fill[y - cache->extent.y]++] = vert[i]->x1;
+    }
+
+  /*  a run starts at a vertical seg, so the number of vertical segs up
+   *  to a horizontal seg tells the run of its row it borders
+   */
+  for (i = 0; i < n_horiz; i++)
+    {
+      const GimpBoundSeg *seg   = horiz[i].seg;
+      gint                row   = (seg->open ? seg->y1 : seg->y1 - 1) -
+                                  cache->extent.y;
+      const gint         *edges = row_edges + row_start[row];
+      gint                lo    = 0;
+      gint                hi    = row_start[row + 1] - row_start[row];
+
+      while (lo < hi)
+        {
+          gint mid = (lo + hi) / 2;
+
+          if (edges[mid] <= seg->x1)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+      horiz[i].row = row;
+      horiz[i].run = lo;
+    }
+
+  qsort (horiz, n_horiz, sizeof (BoundaryCacheSeg),
+         (GCompareFunc) boundary_cache_cmp_horiz);
+
+  boundary = gimp_boundary_new (&cache->region);
+
+  for (i = 0; i < n_horiz; i++)
+    {
+      const GimpBoundSeg *seg = horiz[i].seg;
+
+      process_horiz_seg (boundary,
+                         seg->x1, seg->y1, seg->x2, seg->y2, seg->open);
+    }
+
+  g_free (row_edges);
+  g_free (row_fill);
+  g_free (row_start);
+  g_free (vert);
+  g_free (horiz);
+  g_free (segs);
+
+  *num_segs = boundary->num_segs;
+
+  return gimp_boundary_free (boundary, FALSE);
+}
+
+static gint
+boundary_cache_cmp_vert (const GimpBoundSeg **seg_ptr_a,
+                         const GimpBoundSeg **seg_ptr_b)
+{
+  return (*seg_ptr_a)->x1 - (*seg_ptr_b)->x1;
+}
+
+static gint
+boundary_cache_cmp_horiz (const BoundaryCacheSeg *seg_a,
+                          const BoundaryCacheSeg *seg_b)
+{
+  if (seg_a->row != seg_b->row)
+    return seg_a->row - seg_b->row;
+
+  if (seg_a->run != seg_b->run)
+    return seg_a->run - seg_b->run;
+
+  /*  the segs above a run come before the ones below it  */
+  if (seg_a->seg->open != seg_b->seg->open)
+    return (gint) seg_b->seg->open - (gint) seg_a->seg->open;
+
+  return seg_a->seg->x1 - seg_b->seg->x1;
+}
+
+
+/*  boundary index functions  */
+
+static inline gint
+boundary_index_cell (const GimpBoundaryIndex *index,
+                     const GimpBoundSeg      *seg)
+{
+  gint col = (MIN (seg->x1, seg->x2) - index->x) / INDEX_CELL_SIZE;
+  gint row = (MIN (seg->y1, seg->y2) - index->y) / INDEX_CELL_SIZE;
+
+  return row * index->n_cols + col;
+}
+
 /*  sorting utility functions  */
 
 static inline gint
@@ -58,6 +58,30 @@ GimpBoundSeg * gimp_boundary_simplify  (GimpBoundSeg        *sorted_segs,
                                         gint                 num_groups,
                                         gint                *num_segs);
 
+
+GimpBoundaryCache * gimp_boundary_cache_new        (void);
+void                gimp_boundary_cache_free       (GimpBoundaryCache   *cache);
+void                gimp_boundary_cache_invalidate (GimpBoundaryCache   *cache,
+                                                    const GeglRectangle *rect);
+GimpBoundSeg      * gimp_boundary_cache_find       (GimpBoundaryCache   *cache,
+                                                    GeglBuffer          *buffer,
+                                                    const GeglRectangle *region,
+                                                    const Babl          *format,
+                                                    GimpBoundaryType     type,
+                                                    gint                 x1,
+                                                    gint                 y1,
+                                                    gint                 x2,
+                                                    gint                 y2,
+                                                    gfloat               threshold,
+                                                    gint                *num_segs);
+
+GimpBoundaryIndex * gimp_boundary_index_new        (const GimpBoundSeg  *segs,
+                                                    gint                 num_segs);
+void                gimp_boundary_index_free       (GimpBoundaryIndex   *index);
+GimpBoundSeg      * gimp_boundary_index_query      (GimpBoundaryIndex   *index,
+                                                    const GeglRectangle *rect,
+                                                    gint                *num_segs);
+
 /* offsets in-place */
 void       gimp_boundary_offset        (GimpBoundSeg        *segs,
                                         gint                 num_segs,
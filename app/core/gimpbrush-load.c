@@ -30,6 +30,7 @@
 #include "gimpbrush-header.h"
 #include "gimpbrush-load.h"
 #include "gimpbrush-private.h"
+#include "gimpdatacache.h"
 #include "gimppattern-header.h"
 #include "gimptempbuf.h"
 #include "gimp-utils.h"
@@ -510,6 +511,82 @@ gimp_brush_load_abr (GimpContext   *context,
   return g_list_reverse (brush_list);
 }
 
+/* serializes plain brushes for the brush factory's data cache, brush
+ * pipes and generated brushes are always loaded from their files.
+ */
+gboolean
+gimp_brush_save_to_cache (GimpData   *data,
+                          GByteArray *output)
+{
+  GimpBrush *brush = GIMP_BRUSH (data);
+
+  if (G_OBJECT_TYPE (brush) != GIMP_TYPE_BRUSH)
+    return FALSE;
+
+  gimp_data_cache_write_string (output, gimp_object_get_name (brush));
+  gimp_data_cache_write_string (output, gimp_data_get_mime_type (data));
+
+  gimp_data_cache_write_int    (output, brush->priv->spacing);
+  gimp_data_cache_write_double (output, brush->priv->x_axis.x);
+  gimp_data_cache_write_double (output, brush->priv->x_axis.y);
+  gimp_data_cache_write_double (output, brush->priv->y_axis.x);
+  gimp_data_cache_write_double (output, brush->priv->y_axis.y);
+
+  return (gimp_data_cache_write_temp_buf (output, brush->priv->mask) &&
+          gimp_data_cache_write_temp_buf (output, brush->priv->pixmap));
+}
+
+GimpData *
+gimp_brush_load_from_cache (GimpContext         *context,
+                            GimpDataCacheReader *reader)
+{
+  GimpBrush   *brush;
+  gchar       *name;
+  gchar       *mime_type = NULL;
+  gint32       spacing;
+  GimpVector2  x_axis;
+  GimpVector2  y_axis;
+  GimpTempBuf *mask   = NULL;
+  GimpTempBuf *pixmap = NULL;
+
+  if (! gimp_data_cache_read_string (reader, &name))
+    return NULL;
+
+  if (! name                                               ||
+      ! gimp_data_cache_read_string   (reader, &mime_type) ||
+      ! gimp_data_cache_read_int      (reader, &spacing)   ||
+      ! gimp_data_cache_read_double   (reader, &x_axis.x)  ||
+      ! gimp_data_cache_read_double   (reader, &x_axis.y)  ||
+      ! gimp_data_cache_read_double   (reader, &y_axis.x)  ||
+      ! gimp_data_cache_read_double   (reader, &y_axis.y)  ||
+      ! gimp_data_cache_read_temp_buf (reader, &mask)      ||
+      ! mask                                               ||
+      ! gimp_data_cache_read_temp_buf (reader, &pixmap))
+    {
+      g_clear_pointer (&mask, gimp_temp_buf_unref);
+      g_free (name);
+      g_free (mime_type);
+      return NULL;
+    }
+
+  brush = g_object_new (GIMP_TYPE_BRUSH,
+                        "name",      name,
+                        "mime-type", mime_type,
+                        NULL);
+
+  g_free (name);
+  g_free (mime_type);
+
+  brush->priv->mask   = mask;
+  brush->priv->pixmap = pixmap;
+
+  brush->priv->spacing = spacing;
+  brush->priv->x_axis  = x_axis;
+  brush->priv->y_axis  = y_axis;
+
+  return GIMP_DATA (brush);
+}
+
 
 /*  private functions  */
 
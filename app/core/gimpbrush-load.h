@@ -37,3 +37,8 @@ GList     * gimp_brush_load_abr    (GimpContext   *context,
                                     GFile         *file,
                                     GInputStream  *input,
                                     GError       **error);
+
+gboolean    gimp_brush_save_to_cache   (GimpData            *data,
+                                        GByteArray          *output);
+GimpData  * gimp_brush_load_from_cache (GimpContext         *context,
+                                        GimpDataCacheReader *reader);
@@ -37,6 +37,7 @@ struct _GimpBrushPrivate
   GimpVector2      y_axis;     /*  for calculating brush spacing  */
 
   gint             use_count;  /*  for keeping the caches alive   */
+  gdouble          cache_tolerance;
   GimpBrushCache  *mask_cache;
   GimpBrushCache  *pixmap_cache;
   GimpBrushCache  *boundary_cache;
@@ -100,6 +100,13 @@ static gboolean      gimp_brush_real_want_null_motion (GimpBrush            *bru
 
 static gchar       * gimp_brush_get_checksum          (GimpTagged           *tagged);
 
+static void          gimp_brush_quantize_transform    (GimpBrush            *brush,
+                                                       GimpBrushCache       *cache,
+                                                       gdouble              *scale,
+                                                       gdouble              *aspect_ratio,
+                                                       gdouble              *angle,
+                                                       gdouble              *hardness);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpBrush, gimp_brush, GIMP_TYPE_DATA,
                          G_ADD_PRIVATE (GimpBrush)
@@ -253,6 +260,13 @@ gimp_brush_get_memsize (GimpObject *object,
 
   memsize += gimp_brush_mipmap_get_memsize (brush);
 
+  memsize += gimp_object_get_memsize (GIMP_OBJECT (brush->priv->mask_cache),
+                                      gui_size);
+  memsize += gimp_object_get_memsize (GIMP_OBJECT (brush->priv->pixmap_cache),
+                                      gui_size);
+  memsize += gimp_object_get_memsize (GIMP_OBJECT (brush->priv->boundary_cache),
+                                      gui_size);
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -466,13 +480,29 @@ static void
 gimp_brush_real_begin_use (GimpBrush *brush)
 {
   brush->priv->mask_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'M', 'm');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'M', 'm');
 
   brush->priv->pixmap_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'P', 'p');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'P', 'p');
 
   brush->priv->boundary_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, 'B', 'b');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free,
+                          (GimpBrushCacheSizeFunc) gimp_bezier_desc_get_memsize,
+                          'B', 'b');
+
+  g_object_set (brush->priv->mask_cache,
+                "tolerance", brush->priv->cache_tolerance,
+                NULL);
+  g_object_set (brush->priv->pixmap_cache,
+                "tolerance", brush->priv->cache_tolerance,
+                NULL);
+  g_object_set (brush->priv->boundary_cache,
+                "tolerance", brush->priv->cache_tolerance,
+                NULL);
 }
 
 static void
@@ -537,6 +567,40 @@ gimp_brush_get_checksum (GimpTagged *tagged)
   return checksum_string;
 }
 
+/* snaps the transform parameters to the grid of @cache, so that dabs
+ * whose dynamics vary the brush by less than the cache's tolerance
+ * share the transformed brush.  @hardness may be NULL.
+ */
+static void
+gimp_brush_quantize_transform (GimpBrush      *brush,
+                               GimpBrushCache *cache,
+                               gdouble        *scale,
+                               gdouble        *aspect_ratio,
+                               gdouble        *angle,
+                               gdouble        *hardness)
+{
+  gdouble size;
+  gdouble dummy_hardness = 1.0;
+
+  /*  the brush isn't in use  */
+  if (! cache)
+    return;
+
+  if (! hardness)
+    hardness = &dummy_hardness;
+
+  /*  nothing to snap for the untransformed brush  */
+  if (*scale == 1.0 && *aspect_ratio == 0.0 && *angle == 0.0 &&
+      *hardness == 1.0)
+    return;
+
+  size = MAX (gimp_temp_buf_get_width  (brush->priv->mask),
+              gimp_temp_buf_get_height (brush->priv->mask));
+
+  gimp_brush_cache_quantize (cache, size,
+                             scale, aspect_ratio, angle, hardness);
+}
+
 /*  public functions  */
 
 GimpData *
@@ -590,6 +654,46 @@ gimp_brush_end_use (GimpBrush *brush)
     GIMP_BRUSH_GET_CLASS (brush)->end_use (brush);
 }
 
+/* sets how far, in pixels, the outline of a transformed brush may
+ * move so that nearby dabs share the cached transform.  0 means the
+ * brush is always transformed exactly.
+ */
+void
+gimp_brush_set_cache_tolerance (GimpBrush *brush,
+                                gdouble    tolerance)
+{
+  g_return_if_fail (GIMP_IS_BRUSH (brush));
+  g_return_if_fail (tolerance >= 0.0);
+
+  if (tolerance == brush->priv->cache_tolerance)
+    return;
+
+  brush->priv->cache_tolerance = tolerance;
+
+  if (brush->priv->mask_cache)
+    g_object_set (brush->priv->mask_cache,
+                  "tolerance", tolerance,
+                  NULL);
+
+  if (brush->priv->pixmap_cache)
+    g_object_set (brush->priv->pixmap_cache,
+                  "tolerance", tolerance,
+                  NULL);
+
+  if (brush->priv->boundary_cache)
+    g_object_set (brush->priv->boundary_cache,
+                  "tolerance", tolerance,
+                  NULL);
+}
+
+gdouble
+gimp_brush_get_cache_tolerance (GimpBrush *brush)
+{
+  g_return_val_if_fail (GIMP_IS_BRUSH (brush), 0.0);
+
+  return brush->priv->cache_tolerance;
+}
+
 GimpBrush *
 gimp_brush_select_brush (GimpBrush        *brush,
                          const GimpCoords *last_coords,
@@ -632,6 +736,10 @@ gimp_brush_transform_size (GimpBrush     *brush,
   g_return_if_fail (width != NULL);
   g_return_if_fail (height != NULL);
 
+  /*  the size has to match the transformed mask's  */
+  gimp_brush_quantize_transform (brush, brush->priv->mask_cache,
+                                 &scale, &aspect_ratio, &angle, NULL);
+
   if (scale             == 1.0 &&
       aspect_ratio      == 0.0 &&
       fmod (angle, 0.5) == 0.0)
@@ -658,11 +766,16 @@ gimp_brush_transform_mask (GimpBrush *brush,
   const GimpTempBuf *mask;
   gint               width;
   gint               height;
-  gdouble            effective_hardness = hardness;
+  gdouble            effective_hardness;
 
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_quantize_transform (brush, brush->priv->mask_cache,
+                                 &scale, &aspect_ratio, &angle, &hardness);
+
+  effective_hardness = hardness;
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -725,12 +838,17 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
   const GimpTempBuf *pixmap;
   gint               width;
   gint               height;
-  gdouble            effective_hardness = hardness;
+  gdouble            effective_hardness;
 
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
   g_return_val_if_fail (brush->priv->pixmap != NULL, NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_quantize_transform (brush, brush->priv->pixmap_cache,
+                                 &scale, &aspect_ratio, &angle, &hardness);
+
+  effective_hardness = hardness;
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -794,6 +912,9 @@ gimp_brush_transform_boundary (GimpBrush *brush,
   g_return_val_if_fail (width != NULL, NULL);
   g_return_val_if_fail (height != NULL, NULL);
 
+  gimp_brush_quantize_transform (brush, brush->priv->boundary_cache,
+                                 &scale, &aspect_ratio, &angle, &hardness);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              width, height);
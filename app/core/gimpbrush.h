@@ -93,6 +93,10 @@ GimpData             * gimp_brush_get_standard       (GimpContext      *context)
 void                   gimp_brush_begin_use          (GimpBrush        *brush);
 void                   gimp_brush_end_use            (GimpBrush        *brush);
 
+void                   gimp_brush_set_cache_tolerance (GimpBrush       *brush,
+                                                       gdouble          tolerance);
+gdouble                gimp_brush_get_cache_tolerance (GimpBrush       *brush);
+
 GimpBrush            * gimp_brush_select_brush       (GimpBrush        *brush,
                                                       const GimpCoords *last_coords,
                                                       const GimpCoords *current_coords);
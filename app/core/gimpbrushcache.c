@@ -18,12 +18,26 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+/* The cache keeps the transformed masks, pixmaps and outlines of a
+ * brush while it is in use.  Its units are hashed by their transform
+ * parameters, and evicted least recently used first once their total
+ * size exceeds the cache's "max-memsize".
+ *
+ * Brush dynamics vary the parameters from dab to dab, so they hardly
+ * ever match exactly.  gimp_brush_cache_quantize() snaps them to a grid
+ * which is fine enough for the brush's outline to move by no more than
+ * the cache's "tolerance", in pixels, which makes nearby dabs share a
+ * unit.  The tolerance is 0 unless the "brush-cache-tolerance"
+ * preference says otherwise, so by default only exact matches are hit.
+ */
+
 #include "config.h"
 
 #include <gio/gio.h>
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
@@ -33,13 +47,17 @@
 #include "gimp-intl.h"
 
 
-#define MAX_CACHED_DATA 20
+#define DEFAULT_TOLERANCE   0.0
+#define DEFAULT_MAX_MEMSIZE (64 << 20)
 
 
 enum
 {
   PROP_0,
-  PROP_DATA_DESTROY
+  PROP_DATA_DESTROY,
+  PROP_DATA_SIZE,
+  PROP_TOLERANCE,
+  PROP_MAX_MEMSIZE
 };
 
 
@@ -48,6 +66,8 @@ typedef struct _GimpBrushCacheUnit GimpBrushCacheUnit;
 struct _GimpBrushCacheUnit
 {
   gpointer data;
+  gsize    memsize;
+  GList    link;
 
   gint     width;
   gint     height;
@@ -59,16 +79,26 @@ struct _GimpBrushCacheUnit
 };
 
 
-static void   gimp_brush_cache_constructed  (GObject      *object);
-static void   gimp_brush_cache_finalize     (GObject      *object);
-static void   gimp_brush_cache_set_property (GObject      *object,
-                                             guint         property_id,
-                                             const GValue *value,
-                                             GParamSpec   *pspec);
-static void   gimp_brush_cache_get_property (GObject      *object,
-                                             guint         property_id,
-                                             GValue       *value,
-                                             GParamSpec   *pspec);
+static void     gimp_brush_cache_constructed  (GObject            *object);
+static void     gimp_brush_cache_finalize     (GObject            *object);
+static void     gimp_brush_cache_set_property (GObject            *object,
+                                               guint               property_id,
+                                               const GValue       *value,
+                                               GParamSpec         *pspec);
+static void     gimp_brush_cache_get_property (GObject            *object,
+                                               guint               property_id,
+                                               GValue             *value,
+                                               GParamSpec         *pspec);
+
+static gint64   gimp_brush_cache_get_memsize  (GimpObject         *object,
+                                               gint64             *gui_size);
+
+static void     gimp_brush_cache_remove_unit  (GimpBrushCache     *cache,
+                                               GimpBrushCacheUnit *unit);
+
+static guint    gimp_brush_cache_unit_hash    (const GimpBrushCacheUnit *unit);
+static gboolean gimp_brush_cache_unit_equal   (const GimpBrushCacheUnit *unit1,
+                                               const GimpBrushCacheUnit *unit2);
 
 
 G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
@@ -79,23 +109,52 @@ G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 static void
 gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
 {
-  GObjectClass  *object_class = G_OBJECT_CLASS (klass);
+  GObjectClass    *object_class      = G_OBJECT_CLASS (klass);
+  GimpObjectClass *gimp_object_class = GIMP_OBJECT_CLASS (klass);
+
+  object_class->constructed      = gimp_brush_cache_constructed;
+  object_class->finalize         = gimp_brush_cache_finalize;
+  object_class->set_property     = gimp_brush_cache_set_property;
+  object_class->get_property     = gimp_brush_cache_get_property;
 
-  object_class->constructed  = gimp_brush_cache_constructed;
-  object_class->finalize     = gimp_brush_cache_finalize;
-  object_class->set_property = gimp_brush_cache_set_property;
-  object_class->get_property = gimp_brush_cache_get_property;
+  gimp_object_class->get_memsize = gimp_brush_cache_get_memsize;
 
   g_object_class_install_property (object_class, PROP_DATA_DESTROY,
                                    g_param_spec_pointer ("data-destroy",
                                                          NULL, NULL,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_DATA_SIZE,
+                                   g_param_spec_pointer ("data-size",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_TOLERANCE,
+                                   g_param_spec_double ("tolerance",
+                                                        NULL, NULL,
+                                                        0.0, 4.0,
+                                                        DEFAULT_TOLERANCE,
+                                                        GIMP_PARAM_READWRITE |
+                                                        G_PARAM_CONSTRUCT));
+
+  g_object_class_install_property (object_class, PROP_MAX_MEMSIZE,
+                                   g_param_spec_uint64 ("max-memsize",
+                                                        NULL, NULL,
+                                                        0, G_MAXUINT64,
+                                                        DEFAULT_MAX_MEMSIZE,
+                                                        GIMP_PARAM_READWRITE |
+                                                        G_PARAM_CONSTRUCT));
 }
 
 static void
-gimp_brush_cache_init (GimpBrushCache *brush)
+gimp_brush_cache_init (GimpBrushCache *cache)
 {
+  cache->units = g_hash_table_new ((GHashFunc)  gimp_brush_cache_unit_hash,
+                                   (GEqualFunc) gimp_brush_cache_unit_equal);
+
+  g_queue_init (&cache->lru);
 }
 
 static void
@@ -106,6 +165,7 @@ gimp_brush_cache_constructed (GObject *object)
   G_OBJECT_CLASS (parent_class)->constructed (object);
 
   gimp_assert (cache->data_destroy != NULL);
+  gimp_assert (cache->data_size != NULL);
 }
 
 static void
@@ -115,6 +175,8 @@ gimp_brush_cache_finalize (GObject *object)
 
   gimp_brush_cache_clear (cache);
 
+  g_clear_pointer (&cache->units, g_hash_table_unref);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -132,6 +194,20 @@ gimp_brush_cache_set_property (GObject      *object,
       cache->data_destroy = g_value_get_pointer (value);
       break;
 
+    case PROP_DATA_SIZE:
+      cache->data_size = g_value_get_pointer (value);
+      break;
+
+    case PROP_TOLERANCE:
+      cache->tolerance = g_value_get_double (value);
+      /*  units quantized with another tolerance would never be hit  */
+      gimp_brush_cache_clear (cache);
+      break;
+
+    case PROP_MAX_MEMSIZE:
+      cache->max_memsize = g_value_get_uint64 (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -152,26 +228,55 @@ gimp_brush_cache_get_property (GObject    *object,
       g_value_set_pointer (value, cache->data_destroy);
       break;
 
+    case PROP_DATA_SIZE:
+      g_value_set_pointer (value, cache->data_size);
+      break;
+
+    case PROP_TOLERANCE:
+      g_value_set_double (value, cache->tolerance);
+      break;
+
+    case PROP_MAX_MEMSIZE:
+      g_value_set_uint64 (value, cache->max_memsize);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
     }
 }
 
+static gint64
+gimp_brush_cache_get_memsize (GimpObject *object,
+                              gint64     *gui_size)
+{
+  GimpBrushCache *cache   = GIMP_BRUSH_CACHE (object);
+  gint64          memsize = 0;
+
+  memsize += cache->memsize;
+  memsize += g_queue_get_length (&cache->lru) * sizeof (GimpBrushCacheUnit);
+
+  return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
+                                                                  gui_size);
+}
+
 
 /*  public functions  */
 
 GimpBrushCache *
-gimp_brush_cache_new (GDestroyNotify  data_destroy,
-                      gchar           debug_hit,
-                      gchar           debug_miss)
+gimp_brush_cache_new (GDestroyNotify          data_destroy,
+                      GimpBrushCacheSizeFunc  data_size,
+                      gchar                   debug_hit,
+                      gchar                   debug_miss)
 {
   GimpBrushCache *cache;
 
   g_return_val_if_fail (data_destroy != NULL, NULL);
+  g_return_val_if_fail (data_size != NULL, NULL);
 
   cache =  g_object_new (GIMP_TYPE_BRUSH_CACHE,
                          "data-destroy", data_destroy,
+                         "data-size",    data_size,
                          NULL);
 
   cache->debug_hit  = debug_hit;
@@ -183,22 +288,71 @@ gimp_brush_cache_new (GDestroyNotify  data_destroy,
 void
 gimp_brush_cache_clear (GimpBrushCache *cache)
 {
+  GimpBrushCacheUnit *unit;
+
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
 
-  if (cache->cached_units)
+  if (cache->n_hits || cache->n_misses)
     {
-      GList *iter;
+      GIMP_LOG (BRUSH_CACHE,
+                "%p: %d hits, %d misses, %d evictions, "
+                "%u units of %" G_GUINT64_FORMAT " bytes",
+                cache, cache->n_hits, cache->n_misses, cache->n_evictions,
+                g_queue_get_length (&cache->lru), cache->memsize);
+
+      cache->n_hits      = 0;
+      cache->n_misses    = 0;
+      cache->n_evictions = 0;
+    }
 
-      for (iter = cache->cached_units; iter; iter = g_list_next (iter))
-        {
-          GimpBrushCacheUnit *unit = iter->data;
+  while ((unit = g_queue_peek_head (&cache->lru)))
+    gimp_brush_cache_remove_unit (cache, unit);
+}
 
-          cache->data_destroy (unit->data);
-        }
+/* snaps the transform parameters of a brush whose bigger side is
+ * @size pixels to the cache's grid, see above.  the parameters of the
+ * untransformed brush are left alone.
+ */
+void
+gimp_brush_cache_quantize (GimpBrushCache *cache,
+                           gdouble         size,
+                           gdouble        *scale,
+                           gdouble        *aspect_ratio,
+                           gdouble        *angle,
+                           gdouble        *hardness)
+{
+  gdouble tolerance;
+  gdouble length;
 
-      g_list_free_full (cache->cached_units, g_free);
-      cache->cached_units = NULL;
-    }
+  g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
+  g_return_if_fail (scale != NULL);
+  g_return_if_fail (aspect_ratio != NULL);
+  g_return_if_fail (angle != NULL);
+  g_return_if_fail (hardness != NULL);
+
+  tolerance = cache->tolerance;
+
+  if (tolerance <= 0.0 || size <= 0.0)
+    return;
+
+#define QUANTIZE(value, step) (RINT ((value) / (step)) * (step))
+
+  /*  the brush's bigger side, on a grid of tolerance pixels  */
+  length = MAX (QUANTIZE (*scale * size, tolerance), tolerance);
+  *scale = length / size;
+
+  /*  the sides are scaled by (1 +- aspect_ratio / 20)  */
+  *aspect_ratio = QUANTIZE (*aspect_ratio, 20.0 * tolerance / length);
+  *aspect_ratio = CLAMP (*aspect_ratio, -20.0, 20.0);
+
+  /*  the angle is in turns, its arc at the outline is pi * length  */
+  *angle = QUANTIZE (*angle, tolerance / (G_PI * length));
+
+  /*  the hardness scales the radius of the brush's solid core  */
+  *hardness = 1.0 - QUANTIZE (1.0 - *hardness, 2.0 * tolerance / length);
+  *hardness = CLAMP (*hardness, 0.0, 1.0);
+
+#undef QUANTIZE
 }
 
 gconstpointer
@@ -211,40 +365,40 @@ gimp_brush_cache_get (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList *iter;
+  GimpBrushCacheUnit  key;
+  GimpBrushCacheUnit *unit;
 
   g_return_val_if_fail (GIMP_IS_BRUSH_CACHE (cache), NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  key.width        = width;
+  key.height       = height;
+  key.scale        = scale;
+  key.aspect_ratio = aspect_ratio;
+  key.angle        = angle;
+  key.reflect      = reflect;
+  key.hardness     = hardness;
+
+  unit = g_hash_table_lookup (cache->units, &key);
+
+  if (unit)
     {
-      GimpBrushCacheUnit *unit = iter->data;
-
-      if (unit->data                         &&
-          unit->width        == width        &&
-          unit->height       == height       &&
-          unit->scale        == scale        &&
-          unit->aspect_ratio == aspect_ratio &&
-          unit->angle        == angle        &&
-          unit->reflect      == reflect      &&
-          unit->hardness     == hardness)
-        {
-          if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-            g_printerr ("%c", cache->debug_hit);
+      if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
+        g_printerr ("%c", cache->debug_hit);
 
-          /* Make the returned cached brush first in the list. */
-          cache->cached_units = g_list_remove_link (cache->cached_units, iter);
-          iter->next = cache->cached_units;
-          if (cache->cached_units)
-            cache->cached_units->prev = iter;
-          cache->cached_units = iter;
+      cache->n_hits++;
 
-          return (gconstpointer) unit->data;
-        }
+      /* Make the returned cached brush the most recently used one. */
+      g_queue_unlink (&cache->lru, &unit->link);
+      g_queue_push_head_link (&cache->lru, &unit->link);
+
+      return (gconstpointer) unit->data;
     }
 
   if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
     g_printerr ("%c", cache->debug_miss);
 
+  cache->n_misses++;
+
   return NULL;
 }
 
@@ -259,44 +413,106 @@ gimp_brush_cache_add (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList              *iter;
   GimpBrushCacheUnit *unit;
-  GList              *last   = NULL;
-  gint                length = 0;
+  GimpBrushCacheUnit *old_unit;
 
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  unit = g_slice_new0 (GimpBrushCacheUnit);
+
+  unit->data         = data;
+  unit->memsize      = cache->data_size (data);
+  unit->link.data    = unit;
+  unit->width        = width;
+  unit->height       = height;
+  unit->scale        = scale;
+  unit->aspect_ratio = aspect_ratio;
+  unit->angle        = angle;
+  unit->reflect      = reflect;
+  unit->hardness     = hardness;
+
+  old_unit = g_hash_table_lookup (cache->units, unit);
+
+  if (old_unit)
     {
-      unit = iter->data;
+      if (old_unit->data == data)
+        {
+          g_slice_free (GimpBrushCacheUnit, unit);
 
-      if (data == unit->data)
-        return;
+          return;
+        }
 
-      length++;
-      last = iter;
+      gimp_brush_cache_remove_unit (cache, old_unit);
     }
 
-  if (length > MAX_CACHED_DATA)
+  /*  evict the least recently used units, but always keep the new one  */
+  while (! g_queue_is_empty (&cache->lru) &&
+         cache->memsize + unit->memsize > cache->max_memsize)
     {
-      unit = last->data;
+      gimp_brush_cache_remove_unit (cache, g_queue_peek_tail (&cache->lru));
 
-      cache->data_destroy (unit->data);
-      cache->cached_units = g_list_delete_link (cache->cached_units, last);
-      g_free (unit);
+      cache->n_evictions++;
     }
 
-  unit = g_new0 (GimpBrushCacheUnit, 1);
+  g_hash_table_add (cache->units, unit);
+  g_queue_push_head_link (&cache->lru, &unit->link);
 
-  unit->data         = data;
-  unit->width        = width;
-  unit->height       = height;
-  unit->scale        = scale;
-  unit->aspect_ratio = aspect_ratio;
-  unit->angle        = angle;
-  unit->reflect      = reflect;
-  unit->hardness     = hardness;
+  cache->memsize += unit->memsize;
+}
+
+
+/*  private functions  */
+
+static void
+gimp_brush_cache_remove_unit (GimpBrushCache     *cache,
+                              GimpBrushCacheUnit *unit)
+{
+  g_hash_table_remove (cache->units, unit);
+  g_queue_unlink (&cache->lru, &unit->link);
+
+  cache->memsize -= unit->memsize;
+
+  cache->data_destroy (unit->data);
 
-  cache->cached_units = g_list_prepend (cache->cached_units, unit);
+  g_slice_free (GimpBrushCacheUnit, unit);
+}
+
+static inline guint
+gimp_brush_cache_double_hash (gdouble value)
+{
+  /*  -0.0 == 0.0, but their bits differ  */
+  if (value == 0.0)
+    value = 0.0;
+
+  return g_double_hash (&value);
+}
+
+static guint
+gimp_brush_cache_unit_hash (const GimpBrushCacheUnit *unit)
+{
+  guint hash;
+
+  hash = unit->width;
+  hash = hash * 31 + unit->height;
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->scale);
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->aspect_ratio);
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->angle);
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->hardness);
+  hash = hash * 2  + (unit->reflect ? 1 : 0);
+
+  return hash;
+}
+
+static gboolean
+gimp_brush_cache_unit_equal (const GimpBrushCacheUnit *unit1,
+                             const GimpBrushCacheUnit *unit2)
+{
+  return (unit1->width        == unit2->width        &&
+          unit1->height       == unit2->height       &&
+          unit1->scale        == unit2->scale        &&
+          unit1->aspect_ratio == unit2->aspect_ratio &&
+          unit1->angle        == unit2->angle        &&
+          unit1->reflect      == unit2->reflect      &&
+          unit1->hardness     == unit2->hardness);
 }
@@ -33,16 +33,28 @@
 
 typedef struct _GimpBrushCacheClass GimpBrushCacheClass;
 
+typedef gsize (* GimpBrushCacheSizeFunc) (gconstpointer data);
+
 struct _GimpBrushCache
 {
-  GimpObject      parent_instance;
+  GimpObject              parent_instance;
+
+  GDestroyNotify          data_destroy;
+  GimpBrushCacheSizeFunc  data_size;
+
+  gdouble                 tolerance;
+  guint64                 max_memsize;
 
-  GDestroyNotify  data_destroy;
+  GHashTable             *units;
+  GQueue                  lru;
+  guint64                 memsize;
 
-  GList          *cached_units;
+  gint                    n_hits;
+  gint                    n_misses;
+  gint                    n_evictions;
 
-  gchar           debug_hit;
-  gchar           debug_miss;
+  gchar                   debug_hit;
+  gchar                   debug_miss;
 };
 
 struct _GimpBrushCacheClass
@@ -53,26 +65,34 @@ struct _GimpBrushCacheClass
 
 GType            gimp_brush_cache_get_type (void) G_GNUC_CONST;
 
-GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify  data_destory,
-                                            gchar           debug_hit,
-                                            gchar           debug_miss);
-
-void             gimp_brush_cache_clear    (GimpBrushCache *cache);
-
-gconstpointer    gimp_brush_cache_get      (GimpBrushCache *cache,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gboolean        reflect,
-                                            gdouble         hardness);
-void             gimp_brush_cache_add      (GimpBrushCache *cache,
-                                            gpointer        data,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gboolean        reflect,
-                                            gdouble         hardness);
+GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify          data_destroy,
+                                            GimpBrushCacheSizeFunc  data_size,
+                                            gchar                   debug_hit,
+                                            gchar                   debug_miss);
+
+void             gimp_brush_cache_clear    (GimpBrushCache         *cache);
+
+void             gimp_brush_cache_quantize (GimpBrushCache         *cache,
+                                            gdouble                 size,
+                                            gdouble                *scale,
+                                            gdouble                *aspect_ratio,
+                                            gdouble                *angle,
+                                            gdouble                *hardness);
+
+gconstpointer    gimp_brush_cache_get      (GimpBrushCache         *cache,
+                                            gint                    width,
+                                            gint                    height,
+                                            gdouble                 scale,
+                                            gdouble                 aspect_ratio,
+                                            gdouble                 angle,
+                                            gboolean                reflect,
+                                            gdouble                 hardness);
+void             gimp_brush_cache_add      (GimpBrushCache         *cache,
+                                            gpointer                data,
+                                            gint                    width,
+                                            gint                    height,
+                                            gdouble                 scale,
+                                            gdouble                 aspect_ratio,
+                                            gdouble                 angle,
+                                            gboolean                reflect,
+                                            gdouble                 hardness);
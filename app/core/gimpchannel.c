@@ -200,6 +200,13 @@ static void       gimp_channel_real_flood    (GimpChannel         *channel,
                                               gboolean             push_undo);
 
 
+static GimpBoundSeg *
+                 gimp_channel_boundary_query (const GimpBoundSeg   *segs,
+                                              gint                  num_segs,
+                                              const GimpBoundSeg   *channel_segs,
+                                              GimpBoundaryIndex   **channel_index,
+                                              const GeglRectangle  *rect,
+                                              gint                 *num_rect_segs);
 static void      gimp_channel_buffer_changed (GeglBuffer          *buffer,
                                               const GeglRectangle *rect,
                                               GimpChannel         *channel);
@@ -334,8 +341,12 @@ gimp_channel_finalize (GObject *object)
 {
   GimpChannel *channel = GIMP_CHANNEL (object);
 
-  g_clear_pointer (&channel->segs_in,  g_free);
-  g_clear_pointer (&channel->segs_out, g_free);
+  g_clear_pointer (&channel->index_in,  gimp_boundary_index_free);
+  g_clear_pointer (&channel->index_out, gimp_boundary_index_free);
+  g_clear_pointer (&channel->segs_in,   g_free);
+  g_clear_pointer (&channel->segs_out,  g_free);
+  g_clear_pointer (&channel->cache_in,  gimp_boundary_cache_free);
+  g_clear_pointer (&channel->cache_out, gimp_boundary_cache_free);
   g_clear_object (&channel->color);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -969,6 +980,12 @@ gimp_channel_set_buffer (GimpDrawable        *drawable,
                                             channel);
     }
 
+  if (channel->cache_in)
+    gimp_boundary_cache_invalidate (channel->cache_in, NULL);
+
+  if (channel->cache_out)
+    gimp_boundary_cache_invalidate (channel->cache_out, NULL);
+
   GIMP_DRAWABLE_CLASS (parent_class)->set_buffer (drawable,
                                                   push_undo, undo_desc,
                                                   buffer, bounds);
@@ -1034,38 +1051,57 @@ gimp_channel_real_boundary (GimpChannel         *channel,
       gint x3, y3, x4, y4;
 
       /* free the out of date boundary segments */
+      g_clear_pointer (&channel->index_in,  gimp_boundary_index_free);
+      g_clear_pointer (&channel->index_out, gimp_boundary_index_free);
       g_free (channel->segs_in);
       g_free (channel->segs_out);
 
       if (gimp_item_bounds (GIMP_ITEM (channel), &x3, &y3, &x4, &y4))
         {
-          GeglBuffer    *buffer;
-          GeglRectangle  rect = { x3, y3, x4, y4 };
-
-          x4 += x3;
-          y4 += y3;
+          GeglBuffer *buffer;
+          gint        width;
+          gint        height;
 
           buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
 
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
-          x1 = MAX (x1, x3);
-          y1 = MAX (y1, y3);
-          x2 = MIN (x2, x4);
-          y2 = MIN (y2, y4);
-
-          if (x2 > x1 && y2 > y1)
+          width  = gegl_buffer_get_width  (buffer);
+          height = gegl_buffer_get_height (buffer);
+
+          if (! channel->cache_in)
+            {
+              channel->cache_in  = gimp_boundary_cache_new ();
+              channel->cache_out = gimp_boundary_cache_new ();
+            }
+
+          /*  there are no selected pixels outside the channel's bounds,
+           *  so the boundary is the same when looking at the whole
+           *  buffer, which lets the caches keep their tiles while the
+           *  bounds change.  the caches only recompute the tiles the
+           *  buffer's "changed" signal invalidated.
+           */
+          channel->segs_out =
+            gimp_boundary_cache_find (channel->cache_out, buffer, NULL,
+                                      babl_format ("Y float"),
+                                      GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                      x1, y1, x2, y2,
+                                      GIMP_BOUNDARY_HALF_WAY,
+                                      &channel->num_segs_out);
+
+          x1 = CLAMP (x1, 0, width);
+          y1 = CLAMP (y1, 0, height);
+          x2 = CLAMP (x2, 0, width);
+          y2 = CLAMP (y2, 0, height);
+
+          if (x2 > x1 && y2 > y1 &&
+              x2 > x3 && y2 > y3 && x1 < x3 + x4 && y1 < y3 + y4)
             {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
+              channel->segs_in =
+                gimp_boundary_cache_find (channel->cache_in, buffer, NULL,
+                                          babl_format ("Y float"),
+                                          GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                          x1, y1, x2, y2,
+                                          GIMP_BOUNDARY_HALF_WAY,
+                                          &channel->num_segs_in);
             }
           else
             {
@@ -1106,8 +1142,10 @@ gimp_channel_real_is_empty (GimpChannel *channel)
     return FALSE;
 
   /*  The mask is empty, meaning we can set the bounds as known  */
-  g_clear_pointer (&channel->segs_in,  g_free);
-  g_clear_pointer (&channel->segs_out, g_free);
+  g_clear_pointer (&channel->index_in,  gimp_boundary_index_free);
+  g_clear_pointer (&channel->index_out, gimp_boundary_index_free);
+  g_clear_pointer (&channel->segs_in,   g_free);
+  g_clear_pointer (&channel->segs_out,  g_free);
 
   channel->empty          = TRUE;
   channel->full           = FALSE;
@@ -1514,11 +1552,53 @@ gimp_channel_real_flood (GimpChannel *channel,
   gimp_drawable_update (GIMP_DRAWABLE (channel), x, y, width, height);
 }
 
+/* returns the segs touching rect.  the channel keeps an index of its
+ * own segs, while foreign segs, like the boundary of a floating
+ * selection, get a throwaway one.
+ */
+static GimpBoundSeg *
+gimp_channel_boundary_query (const GimpBoundSeg   *segs,
+                             gint                  num_segs,
+                             const GimpBoundSeg   *channel_segs,
+                             GimpBoundaryIndex   **channel_index,
+                             const GeglRectangle  *rect,
+                             gint                 *num_rect_segs)
+{
+  GimpBoundaryIndex *index;
+  GimpBoundSeg      *rect_segs;
+
+  *num_rect_segs = 0;
+
+  if (num_segs == 0)
+    return NULL;
+
+  if (segs == channel_segs)
+    {
+      if (! *channel_index)
+        *channel_index = gimp_boundary_index_new (segs, num_segs);
+
+      return gimp_boundary_index_query (*channel_index, rect, num_rect_segs);
+    }
+
+  index     = gimp_boundary_index_new (segs, num_segs);
+  rect_segs = gimp_boundary_index_query (index, rect, num_rect_segs);
+
+  gimp_boundary_index_free (index);
+
+  return rect_segs;
+}
+
 static void
 gimp_channel_buffer_changed (GeglBuffer          *buffer,
                              const GeglRectangle *rect,
                              GimpChannel         *channel)
 {
+  if (channel->cache_in)
+    gimp_boundary_cache_invalidate (channel->cache_in, rect);
+
+  if (channel->cache_out)
+    gimp_boundary_cache_invalidate (channel->cache_out, rect);
+
   gimp_drawable_invalidate_boundary (GIMP_DRAWABLE (channel));
 }
 
@@ -1850,6 +1930,70 @@ gimp_channel_boundary (GimpChannel         *channel,
                                                      x2, y2);
 }
 
+/**
+ * gimp_channel_boundary_in_rect:
+ * @channel:      a #GimpChannel
+ * @rect:         the area to look in
+ * @segs_in:      returns the segs of the inner boundary in @rect
+ * @segs_out:     returns the segs of the outer boundary in @rect
+ * @num_segs_in:  returns the number of @segs_in
+ * @num_segs_out: returns the number of @segs_out
+ * @x1:           left side of bounds
+ * @y1:           top side of bounds
+ * @x2:           right side of bounds
+ * @y2:           bottom side of bounds
+ *
+ * Like gimp_channel_boundary(), but only returns the segs touching
+ * @rect, looking them up in a spatial index of the boundary instead of
+ * going over all of them.  Use this to draw the visible part of a large
+ * boundary.
+ *
+ * The returned arrays must be freed with g_free().
+ *
+ * Returns: the same as gimp_channel_boundary().
+ **/
+gboolean
+gimp_channel_boundary_in_rect (GimpChannel          *channel,
+                               const GeglRectangle  *rect,
+                               GimpBoundSeg        **segs_in,
+                               GimpBoundSeg        **segs_out,
+                               gint                 *num_segs_in,
+                               gint                 *num_segs_out,
+                               gint                  x1,
+                               gint                  y1,
+                               gint                  x2,
+                               gint                  y2)
+{
+  const GimpBoundSeg *all_segs_in;
+  const GimpBoundSeg *all_segs_out;
+  gint                num_all_segs_in;
+  gint                num_all_segs_out;
+  gboolean            retval;
+
+  g_return_val_if_fail (GIMP_IS_CHANNEL (channel), FALSE);
+  g_return_val_if_fail (rect != NULL, FALSE);
+  g_return_val_if_fail (segs_in != NULL, FALSE);
+  g_return_val_if_fail (segs_out != NULL, FALSE);
+  g_return_val_if_fail (num_segs_in != NULL, FALSE);
+  g_return_val_if_fail (num_segs_out != NULL, FALSE);
+
+  retval = gimp_channel_boundary (channel,
+                                  &all_segs_in, &all_segs_out,
+                                  &num_all_segs_in, &num_all_segs_out,
+                                  x1, y1, x2, y2);
+
+  *segs_in  = gimp_channel_boundary_query (all_segs_in, num_all_segs_in,
+                                           channel->segs_in,
+                                           &channel->index_in,
+                                           rect, num_segs_in);
+  *segs_out = gimp_channel_boundary_query (all_segs_out, num_all_segs_out,
+                                           channel->segs_out,
+                                           &channel->index_out,
+                                           rect, num_segs_out);
+
+  return retval;
+}
+
 gboolean
 gimp_channel_is_empty (GimpChannel *channel)
 {
@@ -32,27 +32,31 @@ typedef struct _GimpChannelClass GimpChannelClass;
 
 struct _GimpChannel
 {
-  GimpDrawable  parent_instance;
+  GimpDrawable       parent_instance;
 
-  GeglColor    *color;             /*  Also stores the opacity        */
-  gboolean      show_masked;       /*  Show masked areas--as          */
-                                   /*  opposed to selected areas      */
+  GeglColor         *color;            /*  Also stores the opacity        */
+  gboolean           show_masked;      /*  Show masked areas--as          */
+                                       /*  opposed to selected areas      */
 
-  GeglNode     *color_node;
-  GeglNode     *invert_node;
-  GeglNode     *mask_node;
+  GeglNode          *color_node;
+  GeglNode          *invert_node;
+  GeglNode          *mask_node;
 
   /*  Selection mask variables  */
-  gboolean      boundary_known;    /*  is the current boundary valid  */
-  GimpBoundSeg *segs_in;           /*  outline of selected region     */
-  GimpBoundSeg *segs_out;          /*  outline of selected region     */
-  gint          num_segs_in;       /*  number of lines in boundary    */
-  gint          num_segs_out;      /*  number of lines in boundary    */
-  gboolean      empty;             /*  is the region empty?           */
-  gboolean      full;              /*  is the region completely full? */
-  gboolean      bounds_known;      /*  recalculate the bounds?        */
-  gint          x1, y1;            /*  coordinates for bounding box   */
-  gint          x2, y2;            /*  lower right hand coordinate    */
+  gboolean           boundary_known;   /*  is the current boundary valid  */
+  GimpBoundSeg      *segs_in;          /*  outline of selected region     */
+  GimpBoundSeg      *segs_out;         /*  outline of selected region     */
+  gint               num_segs_in;      /*  number of lines in boundary    */
+  gint               num_segs_out;     /*  number of lines in boundary    */
+  GimpBoundaryCache *cache_in;         /*  tiles of segs_in               */
+  GimpBoundaryCache *cache_out;        /*  tiles of segs_out              */
+  GimpBoundaryIndex *index_in;         /*  spatial index of segs_in       */
+  GimpBoundaryIndex *index_out;        /*  spatial index of segs_out      */
+  gboolean           empty;            /*  is the region empty?           */
+  gboolean           full;             /*  is the region completely full? */
+  gboolean           bounds_known;     /*  recalculate the bounds?        */
+  gint               x1, y1;           /*  coordinates for bounding box   */
+  gint               x2, y2;           /*  lower right hand coordinate    */
 };
 
 struct _GimpChannelClass
@@ -176,6 +180,16 @@ gboolean      gimp_channel_boundary           (GimpChannel            *mask,
                                                gint                    y1,
                                                gint                    x2,
                                                gint                    y2);
+gboolean      gimp_channel_boundary_in_rect   (GimpChannel            *mask,
+                                               const GeglRectangle    *rect,
+                                               GimpBoundSeg          **segs_in,
+                                               GimpBoundSeg          **segs_out,
+                                               gint                   *num_segs_in,
+                                               gint                   *num_segs_out,
+                                               gint                    x1,
+                                               gint                    y1,
+                                               gint                    x2,
+                                               gint                    y2);
 gboolean      gimp_channel_is_empty           (GimpChannel            *mask);
 
 gboolean      gimp_channel_is_full            (GimpChannel            *mask);
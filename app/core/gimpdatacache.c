@@ -0,0 +1,826 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdatacache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* The data cache keeps the data objects loaded from the files of a
+ * data factory's folders in a single binary file, so they can be
+ * restored at startup without opening and parsing every single file.
+ *
+ * The cache file starts with a fixed size index, which is used in
+ * place from the mapped file.  Every index entry records the URI,
+ * modification time and size of a data file, and points to the
+ * serialized data objects, which are only decoded when the data
+ * factory asks for the file, and only if the file didn't change.
+ *
+ * The file is mapped privately and writable, and the pixels of the
+ * restored temp bufs are used in place, so they are only paged in when
+ * a brush or pattern is first used, and only copied if they are
+ * written to.  Payloads and the pixels within them are aligned to
+ * GIMP_DATA_CACHE_ALIGNMENT bytes for this.
+ *
+ * The payloads are written and read by the factory's
+ * GimpDataCacheSaveFunc and GimpDataCacheLoadFunc, using the
+ * gimp_data_cache_write_*() and gimp_data_cache_read_*() functions.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core-types.h"
+
+#include "gimpdatacache.h"
+#include "gimptempbuf.h"
+
+
+#define GIMP_DATA_CACHE_MAGIC   0x47444331  /* "GDC1" */
+#define GIMP_DATA_CACHE_VERSION 2
+
+#define GIMP_DATA_CACHE_ALIGNMENT 16
+#define GIMP_DATA_CACHE_ALIGN(offset) \
+  (((offset) + GIMP_DATA_CACHE_ALIGNMENT - 1) & ~(guint64) (GIMP_DATA_CACHE_ALIGNMENT - 1))
+
+
+typedef struct _GimpDataCacheHeader     GimpDataCacheHeader;
+typedef struct _GimpDataCacheIndexEntry GimpDataCacheIndexEntry;
+typedef struct _GimpDataCacheEntry      GimpDataCacheEntry;
+
+/*  the on-disk structures, in host byte order  */
+
+struct _GimpDataCacheHeader
+{
+  guint32 magic;
+  guint32 version;
+  guint32 n_entries;
+  guint32 reserved;
+  gchar   gimp_version[16];
+};
+
+struct _GimpDataCacheIndexEntry
+{
+  guint64 key_offset;
+  guint64 payload_offset;
+  guint64 payload_size;
+  guint64 size;
+  guint64 mtime;
+  guint32 mtime_usec;
+  guint32 key_length;
+  guint32 n_data;
+  guint32 reserved;
+};
+
+struct _GimpDataCacheEntry
+{
+  guint64   size;
+  guint64   mtime;
+  guint32   mtime_usec;
+  gint      n_data;
+  GBytes   *payload;
+  gboolean  used;
+};
+
+struct _GimpDataCache
+{
+  GFile       *file;
+  GMappedFile *mapped_file;
+  GHashTable  *entries;
+  gboolean     dirty;
+};
+
+
+static void       gimp_data_cache_map           (GimpDataCache        *cache);
+
+static gboolean   gimp_data_cache_write         (GOutputStream        *output,
+                                                 gconstpointer         data,
+                                                 gsize                 size,
+                                                 GError              **error);
+
+static void       gimp_data_cache_write_padding (GByteArray           *output);
+static gboolean   gimp_data_cache_read_padding  (GimpDataCacheReader  *reader);
+
+static void       gimp_data_cache_entry_free    (GimpDataCacheEntry   *entry);
+
+
+/*  public functions  */
+
+GimpDataCache *
+gimp_data_cache_new (GFile *file)
+{
+  GimpDataCache *cache;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  cache = g_slice_new0 (GimpDataCache);
+
+  cache->file    = g_object_ref (file);
+  cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free,
+                                          (GDestroyNotify) gimp_data_cache_entry_free);
+
+  gimp_data_cache_map (cache);
+
+  return cache;
+}
+
+void
+gimp_data_cache_free (GimpDataCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  /*  the entries' payloads keep the mapping alive, if needed  */
+  g_hash_table_unref (cache->entries);
+
+  g_clear_pointer (&cache->mapped_file, g_mapped_file_unref);
+  g_object_unref (cache->file);
+
+  g_slice_free (GimpDataCache, cache);
+}
+
+/* returns the payload of @file's data objects if the cache has an
+ * entry for @file which matches the modification time and size in
+ * @info, and drops the entry otherwise.
+ */
+GBytes *
+gimp_data_cache_lookup (GimpDataCache *cache,
+                        GFile         *file,
+                        GFileInfo     *info,
+                        gint          *n_data)
+{
+  GimpDataCacheEntry *entry;
+  gchar              *uri;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (G_IS_FILE_INFO (info), NULL);
+  g_return_val_if_fail (n_data != NULL, NULL);
+
+  uri   = g_file_get_uri (file);
+  entry = g_hash_table_lookup (cache->entries, uri);
+
+  if (entry)
+    {
+      if (entry->mtime      == g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)      &&
+          entry->mtime_usec == g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC) &&
+          entry->size       == g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
+        {
+          entry->used = TRUE;
+        }
+      else
+        {
+          g_hash_table_remove (cache->entries, uri);
+          cache->dirty = TRUE;
+
+          entry = NULL;
+        }
+    }
+
+  g_free (uri);
+
+  if (! entry)
+    return NULL;
+
+  *n_data = entry->n_data;
+
+  return g_bytes_ref (entry->payload);
+}
+
+void
+gimp_data_cache_add (GimpDataCache *cache,
+                     GFile         *file,
+                     GFileInfo     *info,
+                     gint           n_data,
+                     GBytes        *payload)
+{
+  GimpDataCacheEntry *entry;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (G_IS_FILE_INFO (info));
+  g_return_if_fail (n_data > 0);
+  g_return_if_fail (payload != NULL);
+
+  entry = g_slice_new0 (GimpDataCacheEntry);
+
+  entry->size       = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+  entry->mtime      = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  entry->mtime_usec = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  entry->n_data     = n_data;
+  entry->payload    = g_bytes_ref (payload);
+  entry->used       = TRUE;
+
+  g_hash_table_replace (cache->entries, g_file_get_uri (file), entry);
+
+  cache->dirty = TRUE;
+}
+
+/* writes the cache file, if any entry was added, or dropped, or not
+ * looked up since the cache was opened, in which case its file is
+ * gone.
+ */
+gboolean
+gimp_data_cache_save (GimpDataCache  *cache,
+                      GError        **error)
+{
+  GimpDataCacheHeader      header = { 0, };
+  GimpDataCacheIndexEntry *index;
+  GOutputStream           *output;
+  GFile                   *parent;
+  GHashTableIter           iter;
+  gpointer                 key;
+  gpointer                 value;
+  GPtrArray               *keys;
+  guint64                  offset;
+  gboolean                 success = TRUE;
+  gint                     i;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_hash_table_iter_init (&iter, cache->entries);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      GimpDataCacheEntry *entry = value;
+
+      if (! entry->used)
+        {
+          g_hash_table_iter_remove (&iter);
+          cache->dirty = TRUE;
+        }
+    }
+
+  if (! cache->dirty)
+    return TRUE;
+
+  parent = g_file_get_parent (cache->file);
+
+  if (parent)
+    {
+      GError *my_error = NULL;
+
+      if (! g_file_make_directory_with_parents (parent, NULL, &my_error) &&
+          ! g_error_matches (my_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+        {
+          g_propagate_error (error, my_error);
+          g_object_unref (parent);
+
+          return FALSE;
+        }
+
+      g_clear_error (&my_error);
+      g_object_unref (parent);
+    }
+
+  output = G_OUTPUT_STREAM (g_file_replace (cache->file,
+                                            NULL, FALSE, G_FILE_CREATE_NONE,
+                                            NULL, error));
+  if (! output)
+    return FALSE;
+
+  keys  = g_ptr_array_new ();
+  index = g_new0 (GimpDataCacheIndexEntry, g_hash_table_size (cache->entries));
+
+  offset = sizeof (GimpDataCacheHeader) +
+           g_hash_table_size (cache->entries) * sizeof (GimpDataCacheIndexEntry);
+
+  g_hash_table_iter_init (&iter, cache->entries);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GimpDataCacheEntry      *entry       = value;
+      GimpDataCacheIndexEntry *index_entry = &index[keys->len];
+
+      index_entry->key_length     = strlen (key);
+      index_entry->key_offset     = offset;
+      offset                     += index_entry->key_length + 1;
+      offset                      = GIMP_DATA_CACHE_ALIGN (offset);
+
+      index_entry->payload_size   = g_bytes_get_size (entry->payload);
+      index_entry->payload_offset = offset;
+      offset                     += index_entry->payload_size;
+
+      index_entry->size           = entry->size;
+      index_entry->mtime          = entry->mtime;
+      index_entry->mtime_usec     = entry->mtime_usec;
+      index_entry->n_data         = entry->n_data;
+
+      g_ptr_array_add (keys, key);
+    }
+
+  header.magic     = GIMP_DATA_CACHE_MAGIC;
+  header.version   = GIMP_DATA_CACHE_VERSION;
+  header.n_entries = keys->len;
+  g_strlcpy (header.gimp_version, GIMP_VERSION, sizeof (header.gimp_version));
+
+  success = (gimp_data_cache_write (output, &header, sizeof (header),
+                                    error) &&
+             gimp_data_cache_write (output,
+                                    index, keys->len * sizeof (index[0]),
+                                    error));
+
+  for (i = 0; success && i < keys->len; i++)
+    {
+      static const guchar  padding[GIMP_DATA_CACHE_ALIGNMENT] = { 0, };
+      GimpDataCacheEntry  *entry;
+      gsize                key_end;
+
+      entry = g_hash_table_lookup (cache->entries, keys->pdata[i]);
+
+      key_end = index[i].key_offset + index[i].key_length + 1;
+
+      success = (gimp_data_cache_write (output,
+                                        keys->pdata[i],
+                                        index[i].key_length + 1,
+                                        error) &&
+                 gimp_data_cache_write (output,
+                                        padding,
+                                        index[i].payload_offset - key_end,
+                                        error) &&
+                 gimp_data_cache_write (output,
+                                        g_bytes_get_data (entry->payload, NULL),
+                                        index[i].payload_size,
+                                        error));
+    }
+
+  g_ptr_array_free (keys, TRUE);
+  g_free (index);
+
+  if (success)
+    {
+      success = g_output_stream_close (output, NULL, error);
+    }
+  else
+    {
+      GCancellable *cancellable = g_cancellable_new ();
+
+      /*  cancel the close, so the old cache file is kept  */
+      g_cancellable_cancel (cancellable);
+      g_output_stream_close (output, cancellable, NULL);
+      g_object_unref (cancellable);
+    }
+
+  g_object_unref (output);
+
+  if (success)
+    cache->dirty = FALSE;
+
+  return success;
+}
+
+void
+gimp_data_cache_reader_init (GimpDataCacheReader *reader,
+                             GBytes              *payload)
+{
+  g_return_if_fail (reader != NULL);
+  g_return_if_fail (payload != NULL);
+
+  reader->bytes  = payload;
+  reader->data   = g_bytes_get_data (payload, &reader->size);
+  reader->offset = 0;
+}
+
+void
+gimp_data_cache_write_int (GByteArray *output,
+                           gint32      value)
+{
+  g_byte_array_append (output, (const guint8 *) &value, sizeof (value));
+}
+
+void
+gimp_data_cache_write_double (GByteArray *output,
+                              gdouble     value)
+{
+  g_byte_array_append (output, (const guint8 *) &value, sizeof (value));
+}
+
+void
+gimp_data_cache_write_string (GByteArray  *output,
+                              const gchar *value)
+{
+  if (value)
+    {
+      gint32 length = strlen (value);
+
+      gimp_data_cache_write_int (output, length);
+      g_byte_array_append (output, (const guint8 *) value, length);
+    }
+  else
+    {
+      gimp_data_cache_write_int (output, -1);
+    }
+}
+
+/* writes @buf, which may be %NULL, and fails if its format can't be
+ * restored from the format's name.
+ */
+gboolean
+gimp_data_cache_write_temp_buf (GByteArray        *output,
+                                const GimpTempBuf *buf)
+{
+  const Babl *format;
+
+  if (! buf)
+    {
+      gimp_data_cache_write_string (output, NULL);
+
+      return TRUE;
+    }
+
+  format = gimp_temp_buf_get_format (buf);
+
+  if (babl_format (babl_format_get_encoding (format)) != format)
+    return FALSE;
+
+  gimp_data_cache_write_string (output, babl_format_get_encoding (format));
+  gimp_data_cache_write_int    (output, gimp_temp_buf_get_width  (buf));
+  gimp_data_cache_write_int    (output, gimp_temp_buf_get_height (buf));
+
+  gimp_data_cache_write_padding (output);
+
+  g_byte_array_append (output,
+                       gimp_temp_buf_get_data (buf),
+                       gimp_temp_buf_get_data_size (buf));
+
+  return TRUE;
+}
+
+/* writes @color, which may be %NULL, and fails for palette colors,
+ * whose palette can't be restored.
+ */
+gboolean
+gimp_data_cache_write_color (GByteArray *output,
+                             GeglColor  *color)
+{
+  const Babl *format;
+  const Babl *space;
+  GBytes     *bytes;
+  gsize       size;
+
+  if (! color)
+    {
+      gimp_data_cache_write_string (output, NULL);
+
+      return TRUE;
+    }
+
+  format = gegl_color_get_format (color);
+
+  if (babl_format_is_palette (format))
+    return FALSE;
+
+  gimp_data_cache_write_string (output, babl_format_get_encoding (format));
+
+  space = babl_format_get_space (format);
+
+  if (space != babl_space ("sRGB"))
+    {
+      const gchar *icc;
+      gint         icc_length;
+
+      icc = babl_space_get_icc (space, &icc_length);
+
+      if (! icc)
+        return FALSE;
+
+      gimp_data_cache_write_int (output, icc_length);
+      g_byte_array_append (output, (const guint8 *) icc, icc_length);
+    }
+  else
+    {
+      gimp_data_cache_write_int (output, 0);
+    }
+
+  bytes = gegl_color_get_bytes (color, format);
+
+  g_byte_array_append (output, g_bytes_get_data (bytes, &size), size);
+
+  g_bytes_unref (bytes);
+
+  return TRUE;
+}
+
+gboolean
+gimp_data_cache_read_int (GimpDataCacheReader *reader,
+                          gint32              *value)
+{
+  if (reader->size - reader->offset < sizeof (*value))
+    return FALSE;
+
+  memcpy (value, reader->data + reader->offset, sizeof (*value));
+  reader->offset += sizeof (*value);
+
+  return TRUE;
+}
+
+gboolean
+gimp_data_cache_read_double (GimpDataCacheReader *reader,
+                             gdouble             *value)
+{
+  if (reader->size - reader->offset < sizeof (*value))
+    return FALSE;
+
+  memcpy (value, reader->data + reader->offset, sizeof (*value));
+  reader->offset += sizeof (*value);
+
+  return TRUE;
+}
+
+gboolean
+gimp_data_cache_read_string (GimpDataCacheReader  *reader,
+                             gchar               **value)
+{
+  gint32 length;
+
+  if (! gimp_data_cache_read_int (reader, &length) || length < -1)
+    return FALSE;
+
+  if (length < 0)
+    {
+      *value = NULL;
+
+      return TRUE;
+    }
+
+  if (length > reader->size - reader->offset ||
+      ! g_utf8_validate ((const gchar *) reader->data + reader->offset,
+                         length, NULL))
+    return FALSE;
+
+  *value = g_strndup ((const gchar *) reader->data + reader->offset, length);
+  reader->offset += length;
+
+  return TRUE;
+}
+
+gboolean
+gimp_data_cache_read_temp_buf (GimpDataCacheReader  *reader,
+                               GimpTempBuf         **buf)
+{
+  const Babl *format;
+  gchar      *encoding;
+  gint32      width;
+  gint32      height;
+  gsize       size;
+
+  if (! gimp_data_cache_read_string (reader, &encoding))
+    return FALSE;
+
+  if (! encoding)
+    {
+      *buf = NULL;
+
+      return TRUE;
+    }
+
+  format = babl_format_exists (encoding) ? babl_format (encoding) : NULL;
+  g_free (encoding);
+
+  if (! format                                       ||
+      ! gimp_data_cache_read_int (reader, &width)    ||
+      ! gimp_data_cache_read_int (reader, &height)   ||
+      width  <= 0 || width  > GIMP_MAX_IMAGE_SIZE    ||
+      height <= 0 || height > GIMP_MAX_IMAGE_SIZE)
+    return FALSE;
+
+  size = (gsize) width * height * babl_format_get_bytes_per_pixel (format);
+
+  if (! gimp_data_cache_read_padding (reader) ||
+      size > reader->size - reader->offset)
+    return FALSE;
+
+  if (reader->bytes &&
+      (guintptr) (reader->data + reader->offset) % GIMP_DATA_CACHE_ALIGNMENT == 0)
+    {
+      GBytes *bytes = g_bytes_new_from_bytes (reader->bytes,
+                                              reader->offset, size);
+
+      *buf = gimp_temp_buf_new_from_bytes (width, height, format, bytes);
+
+      g_bytes_unref (bytes);
+    }
+  else
+    {
+      *buf = gimp_temp_buf_new (width, height, format);
+
+      memcpy (gimp_temp_buf_get_data (*buf),
+              reader->data + reader->offset, size);
+    }
+
+  reader->offset += size;
+
+  return TRUE;
+}
+
+gboolean
+gimp_data_cache_read_color (GimpDataCacheReader  *reader,
+                            GeglColor           **color)
+{
+  const Babl *format;
+  gchar      *encoding;
+  gint32      icc_length;
+  gsize       size;
+
+  if (! gimp_data_cache_read_string (reader, &encoding))
+    return FALSE;
+
+  if (! encoding)
+    {
+      *color = NULL;
+
+      return TRUE;
+    }
+
+  format = babl_format_exists (encoding) ? babl_format (encoding) : NULL;
+
+  if (! format                                        ||
+      ! gimp_data_cache_read_int (reader, &icc_length) ||
+      icc_length < 0                                  ||
+      icc_length > reader->size - reader->offset)
+    {
+      g_free (encoding);
+
+      return FALSE;
+    }
+
+  if (icc_length > 0)
+    {
+      const Babl  *space;
+      const gchar *babl_error = NULL;
+
+      space = babl_space_from_icc ((const gchar *) reader->data + reader->offset,
+                                   icc_length,
+                                   BABL_ICC_INTENT_RELATIVE_COLORIMETRIC,
+                                   &babl_error);
+      reader->offset += icc_length;
+
+      if (! space)
+        {
+          g_free (encoding);
+
+          return FALSE;
+        }
+
+      format = babl_format_with_space (encoding, space);
+    }
+
+  g_free (encoding);
+
+  size = babl_format_get_bytes_per_pixel (format);
+
+  if (size > reader->size - reader->offset)
+    return FALSE;
+
+  *color = gegl_color_new (NULL);
+  gegl_color_set_pixel (*color, format, reader->data + reader->offset);
+  reader->offset += size;
+
+  return TRUE;
+}
+
+
+/*  private functions  */
+
+static void
+gimp_data_cache_map (GimpDataCache *cache)
+{
+  const GimpDataCacheHeader     *header;
+  const GimpDataCacheIndexEntry *index;
+  const gchar                   *data;
+  GBytes                        *bytes;
+  gchar                         *path;
+  gsize                          size;
+  gint                           i;
+
+  path = g_file_get_path (cache->file);
+
+  /*  the mapping is private, writing to it never changes the file  */
+  if (path)
+    cache->mapped_file = g_mapped_file_new (path, TRUE, NULL);
+
+  g_free (path);
+
+  if (! cache->mapped_file)
+    return;
+
+  data = g_mapped_file_get_contents (cache->mapped_file);
+  size = g_mapped_file_get_length (cache->mapped_file);
+
+  header = (const GimpDataCacheHeader *) data;
+
+  if (size < sizeof (GimpDataCacheHeader)                               ||
+      header->magic   != GIMP_DATA_CACHE_MAGIC                          ||
+      header->version != GIMP_DATA_CACHE_VERSION                        ||
+      strncmp (header->gimp_version, GIMP_VERSION,
+               sizeof (header->gimp_version))                           ||
+      header->n_entries > (size - sizeof (GimpDataCacheHeader)) /
+                          sizeof (GimpDataCacheIndexEntry))
+    {
+      /*  a foreign or broken cache, it is replaced when saving  */
+      g_clear_pointer (&cache->mapped_file, g_mapped_file_unref);
+      cache->dirty = TRUE;
+
+      return;
+    }
+
+  index = (const GimpDataCacheIndexEntry *) (header + 1);
+  bytes = g_mapped_file_get_bytes (cache->mapped_file);
+
+  for (i = 0; i < header->n_entries; i++)
+    {
+      const GimpDataCacheIndexEntry *index_entry = &index[i];
+      GimpDataCacheEntry            *entry;
+
+      if (index_entry->key_offset     >= size                              ||
+          index_entry->key_length     >= size - index_entry->key_offset    ||
+          data[index_entry->key_offset + index_entry->key_length] != '\0' ||
+          index_entry->payload_offset >  size                              ||
+          index_entry->payload_size   >  size - index_entry->payload_offset ||
+          index_entry->n_data         == 0                                 ||
+          index_entry->n_data         >  G_MAXINT)
+        {
+          cache->dirty = TRUE;
+          continue;
+        }
+
+      entry = g_slice_new0 (GimpDataCacheEntry);
+
+      entry->size       = index_entry->size;
+      entry->mtime      = index_entry->mtime;
+      entry->mtime_usec = index_entry->mtime_usec;
+      entry->n_data     = index_entry->n_data;
+      entry->payload    = g_bytes_new_from_bytes (bytes,
+                                                  index_entry->payload_offset,
+                                                  index_entry->payload_size);
+
+      g_hash_table_replace (cache->entries,
+                            g_strdup (data + index_entry->key_offset),
+                            entry);
+    }
+
+  g_bytes_unref (bytes);
+}
+
+/* pads @output, so the next pixels are aligned, relative to the start
+ * of the payload, which is itself aligned in the cache file.
+ */
+static void
+gimp_data_cache_write_padding (GByteArray *output)
+{
+  static const guint8 padding[GIMP_DATA_CACHE_ALIGNMENT] = { 0, };
+
+  g_byte_array_append (output, padding,
+                       GIMP_DATA_CACHE_ALIGN (output->len) - output->len);
+}
+
+static gboolean
+gimp_data_cache_read_padding (GimpDataCacheReader *reader)
+{
+  gsize offset = GIMP_DATA_CACHE_ALIGN (reader->offset);
+
+  if (offset > reader->size)
+    return FALSE;
+
+  reader->offset = offset;
+
+  return TRUE;
+}
+
+static gboolean
+gimp_data_cache_write (GOutputStream  *output,
+                       gconstpointer   data,
+                       gsize           size,
+                       GError        **error)
+{
+  gsize bytes_written;
+
+  return g_output_stream_write_all (output, data, size,
+                                    &bytes_written, NULL, error);
+}
+
+static void
+gimp_data_cache_entry_free (GimpDataCacheEntry *entry)
+{
+  g_bytes_unref (entry->payload);
+
+  g_slice_free (GimpDataCacheEntry, entry);
+}
@@ -0,0 +1,77 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdatacache.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+typedef gboolean   (* GimpDataCacheSaveFunc) (GimpData            *data,
+                                              GByteArray          *output);
+typedef GimpData * (* GimpDataCacheLoadFunc) (GimpContext         *context,
+                                              GimpDataCacheReader *reader);
+
+
+struct _GimpDataCacheReader
+{
+  GBytes       *bytes;
+  const guchar *data;
+  gsize         size;
+  gsize         offset;
+};
+
+
+GimpDataCache * gimp_data_cache_new            (GFile                *file);
+void            gimp_data_cache_free           (GimpDataCache        *cache);
+
+GBytes        * gimp_data_cache_lookup         (GimpDataCache        *cache,
+                                                GFile                *file,
+                                                GFileInfo            *info,
+                                                gint                 *n_data);
+void            gimp_data_cache_add            (GimpDataCache        *cache,
+                                                GFile                *file,
+                                                GFileInfo            *info,
+                                                gint                  n_data,
+                                                GBytes               *payload);
+
+gboolean        gimp_data_cache_save           (GimpDataCache        *cache,
+                                                GError              **error);
+
+void            gimp_data_cache_reader_init    (GimpDataCacheReader  *reader,
+                                                GBytes               *payload);
+
+void            gimp_data_cache_write_int      (GByteArray           *output,
+                                                gint32                value);
+void            gimp_data_cache_write_double   (GByteArray           *output,
+                                                gdouble               value);
+void            gimp_data_cache_write_string   (GByteArray           *output,
+                                                const gchar          *value);
+gboolean        gimp_data_cache_write_temp_buf (GByteArray           *output,
+                                                const GimpTempBuf    *buf);
+gboolean        gimp_data_cache_write_color    (GByteArray           *output,
+                                                GeglColor            *color);
+
+gboolean        gimp_data_cache_read_int       (GimpDataCacheReader  *reader,
+                                                gint32               *value);
+gboolean        gimp_data_cache_read_double    (GimpDataCacheReader  *reader,
+                                                gdouble              *value);
+gboolean        gimp_data_cache_read_string    (GimpDataCacheReader  *reader,
+                                                gchar               **value);
+gboolean        gimp_data_cache_read_temp_buf  (GimpDataCacheReader  *reader,
+                                                GimpTempBuf         **buf);
+gboolean        gimp_data_cache_read_color     (GimpDataCacheReader  *reader,
+                                                GeglColor           **color);
@@ -33,6 +33,7 @@
 #include "gimp-utils.h"
 #include "gimpcontainer.h"
 #include "gimpdata.h"
+#include "gimpdatacache.h"
 #include "gimpdataloaderfactory.h"
 
 #include "gimp-intl.h"
@@ -57,8 +58,13 @@ struct _GimpDataLoader
 
 struct _GimpDataLoaderFactoryPrivate
 {
-  GList          *loaders;
-  GimpDataLoader *fallback;
+  GList                 *loaders;
+  GimpDataLoader        *fallback;
+
+  gchar                 *cache_name;
+  GimpDataCacheSaveFunc  cache_save_func;
+  GimpDataCacheLoadFunc  cache_load_func;
+  GimpDataCache         *data_cache;
 };
 
 #define GET_PRIVATE(obj) (((GimpDataLoaderFactory *) (obj))->priv)
@@ -92,6 +98,15 @@ static void   gimp_data_loader_factory_load_data      (GimpDataFactory *factory,
                                                        GFileInfo       *info,
                                                        GFile           *top_directory);
 
+static GList * gimp_data_loader_factory_load_cached   (GimpDataFactory *factory,
+                                                       GimpContext     *context,
+                                                       GFile           *file,
+                                                       GFileInfo       *info);
+static void    gimp_data_loader_factory_cache_data    (GimpDataFactory *factory,
+                                                       GFile           *file,
+                                                       GFileInfo       *info,
+                                                       GList           *data_list);
+
 static GimpDataLoader * gimp_data_loader_new          (const gchar     *name,
                                                        GimpDataLoadFunc load_func,
                                                        const gchar     *extension,
@@ -133,6 +148,8 @@ gimp_data_loader_factory_finalize (GObject *object)
 
   g_clear_pointer (&priv->fallback, gimp_data_loader_free);
 
+  g_clear_pointer (&priv->cache_name, g_free);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -289,6 +306,33 @@ gimp_data_loader_factory_add_fallback (GimpDataFactory  *factory,
   priv->fallback = gimp_data_loader_new (name, load_func, NULL, FALSE);
 }
 
+/* makes @factory keep the data objects loaded from its folders in a
+ * cache file, and restore them from there instead of loading them, as
+ * long as their files don't change.  @save_func may refuse to
+ * serialize a data object, its file is then loaded each time.
+ */
+void
+gimp_data_loader_factory_set_cache (GimpDataFactory       *factory,
+                                    const gchar           *cache_name,
+                                    GimpDataCacheSaveFunc  save_func,
+                                    GimpDataCacheLoadFunc  load_func)
+{
+  GimpDataLoaderFactoryPrivate *priv;
+
+  g_return_if_fail (GIMP_IS_DATA_LOADER_FACTORY (factory));
+  g_return_if_fail (cache_name != NULL);
+  g_return_if_fail (save_func != NULL);
+  g_return_if_fail (load_func != NULL);
+
+  priv = GET_PRIVATE (factory);
+
+  g_free (priv->cache_name);
+
+  priv->cache_name      = g_strconcat (cache_name, ".cache", NULL);
+  priv->cache_save_func = save_func;
+  priv->cache_load_func = load_func;
+}
+
 
 /*  private functions  */
 
@@ -315,10 +359,23 @@ gimp_data_loader_factory_load (GimpDataFactory *factory,
                                GimpContext     *context,
                                GHashTable      *cache)
 {
-  const GList *ext_path;
-  GList       *path;
-  GList       *writable_path;
-  GList       *list;
+  GimpDataLoaderFactoryPrivate *priv = GET_PRIVATE (factory);
+  const GList                  *ext_path;
+  GList                        *path;
+  GList                        *writable_path;
+  GList                        *list;
+
+  if (priv->cache_name)
+    {
+      GFile *file = g_file_new_build_filename (gimp_cache_directory (),
+                                               "data",
+                                               priv->cache_name,
+                                               NULL);
+
+      priv->data_cache = gimp_data_cache_new (file);
+
+      g_object_unref (file);
+    }
 
   path          = gimp_data_factory_get_data_path          (factory);
   writable_path = gimp_data_factory_get_data_path_writable (factory);
@@ -353,6 +410,23 @@ gimp_data_loader_factory_load (GimpDataFactory *factory,
 
   g_list_free_full (path,          (GDestroyNotify) g_object_unref);
   g_list_free_full (writable_path, (GDestroyNotify) g_object_unref);
+
+  if (priv->data_cache)
+    {
+      GError *error = NULL;
+
+      if (! gimp_data_cache_save (priv->data_cache, &error))
+        {
+          /*  not fatal, the data is loaded from its files next time  */
+          if (gimp_data_factory_get_gimp (factory)->be_verbose)
+            g_printerr ("Failed to write data cache '%s': %s\n",
+                        priv->cache_name, error->message);
+
+          g_clear_error (&error);
+        }
+
+      g_clear_pointer (&priv->data_cache, gimp_data_cache_free);
+    }
 }
 
 static void
@@ -369,7 +443,9 @@ gimp_data_loader_factory_load_directory (GimpDataFactory *factory,
                                           G_FILE_ATTRIBUTE_STANDARD_NAME ","
                                           G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
                                           G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                                          G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
                                           G_FILE_QUERY_INFO_NONE,
                                           NULL, NULL);
 
@@ -423,13 +499,13 @@ gimp_data_loader_factory_load_data (GimpDataFactory *factory,
                                     GFileInfo       *info,
                                     GFile           *top_directory)
 {
-  GimpDataLoader *loader;
-  GimpContainer  *container;
-  GimpContainer  *container_obsolete;
-  GList          *data_list = NULL;
-  GInputStream   *input;
-  guint64         mtime;
-  GError         *error = NULL;
+  GimpDataLoaderFactoryPrivate *priv = GET_PRIVATE (factory);
+  GimpDataLoader               *loader;
+  GimpContainer                *container;
+  GimpContainer                *container_obsolete;
+  GList                        *data_list = NULL;
+  guint64                       mtime;
+  GError                       *error = NULL;
 
   loader = gimp_data_loader_factory_get_loader (factory, file);
 
@@ -458,39 +534,67 @@ gimp_data_loader_factory_load_data (GimpDataFactory *factory,
           for (list = cached_data; list; list = g_list_next (list))
             gimp_container_add (container, list->data);
 
+          if (priv->data_cache)
+            {
+              GBytes *payload;
+              gint    n_data;
+
+              /*  keep the file's cache entry if it is still valid  */
+              payload = gimp_data_cache_lookup (priv->data_cache,
+                                                file, info, &n_data);
+
+              if (payload)
+                g_bytes_unref (payload);
+              else
+                gimp_data_loader_factory_cache_data (factory, file, info,
+                                                     cached_data);
+            }
+
           return;
         }
     }
 
-  input = G_INPUT_STREAM (g_file_read (file, NULL, &error));
+  if (priv->data_cache)
+    data_list = gimp_data_loader_factory_load_cached (factory, context,
+                                                      file, info);
 
-  if (input)
+  if (! data_list)
     {
-      GInputStream *buffered = g_buffered_input_stream_new (input);
+      GInputStream *input = G_INPUT_STREAM (g_file_read (file, NULL, &error));
 
-      data_list = loader->load_func (context, file, buffered, &error);
+      if (input)
+        {
+          GInputStream *buffered = g_buffered_input_stream_new (input);
+
+          data_list = loader->load_func (context, file, buffered, &error);
 
-      if (error)
+          if (error)
+            {
+              g_prefix_error (&error,
+                              _("Error loading '%s': "),
+                              gimp_file_get_utf8_name (file));
+            }
+          else if (! data_list)
+            {
+              g_set_error (&error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                           _("Error loading '%s'"),
+                           gimp_file_get_utf8_name (file));
+            }
+          else if (priv->data_cache)
+            {
+              gimp_data_loader_factory_cache_data (factory, file, info,
+                                                   data_list);
+            }
+
+          g_object_unref (buffered);
+          g_object_unref (input);
+        }
+      else
         {
           g_prefix_error (&error,
-                          _("Error loading '%s': "),
+                          _("Could not open '%s' for reading: "),
                           gimp_file_get_utf8_name (file));
         }
-      else if (! data_list)
-        {
-          g_set_error (&error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
-                       _("Error loading '%s'"),
-                       gimp_file_get_utf8_name (file));
-        }
-
-      g_object_unref (buffered);
-      g_object_unref (input);
-    }
-  else
-    {
-      g_prefix_error (&error,
-                      _("Could not open '%s' for reading: "),
-                      gimp_file_get_utf8_name (file));
     }
 
   if (G_LIKELY (data_list))
@@ -554,6 +658,82 @@ gimp_data_loader_factory_load_data (GimpDataFactory *factory,
     }
 }
 
+/* restores the data objects of @file from the data cache, if they are
+ * in the cache and @file didn't change since.
+ */
+static GList *
+gimp_data_loader_factory_load_cached (GimpDataFactory *factory,
+                                      GimpContext     *context,
+                                      GFile           *file,
+                                      GFileInfo       *info)
+{
+  GimpDataLoaderFactoryPrivate *priv      = GET_PRIVATE (factory);
+  GList                        *data_list = NULL;
+  GimpDataCacheReader           reader;
+  GBytes                       *payload;
+  gint                          n_data;
+  gint                          i;
+
+  payload = gimp_data_cache_lookup (priv->data_cache, file, info, &n_data);
+
+  if (! payload)
+    return NULL;
+
+  gimp_data_cache_reader_init (&reader, payload);
+
+  for (i = 0; i < n_data; i++)
+    {
+      GimpData *data = priv->cache_load_func (context, &reader);
+
+      if (! data)
+        break;
+
+      data_list = g_list_prepend (data_list, data);
+    }
+
+  if (i < n_data || reader.offset != reader.size)
+    {
+      /*  a broken entry, it is replaced when the file is loaded  */
+      g_list_free_full (data_list, g_object_unref);
+      data_list = NULL;
+    }
+
+  g_bytes_unref (payload);
+
+  return g_list_reverse (data_list);
+}
+
+static void
+gimp_data_loader_factory_cache_data (GimpDataFactory *factory,
+                                     GFile           *file,
+                                     GFileInfo       *info,
+                                     GList           *data_list)
+{
+  GimpDataLoaderFactoryPrivate *priv = GET_PRIVATE (factory);
+  GByteArray                   *output;
+  GBytes                       *payload;
+  GList                        *list;
+
+  output = g_byte_array_new ();
+
+  for (list = data_list; list; list = g_list_next (list))
+    {
+      if (! priv->cache_save_func (list->data, output))
+        {
+          g_byte_array_unref (output);
+
+          return;
+        }
+    }
+
+  payload = g_byte_array_free_to_bytes (output);
+
+  gimp_data_cache_add (priv->data_cache, file, info,
+                       g_list_length (data_list), payload);
+
+  g_bytes_unref (payload);
+}
+
 static GimpDataLoader *
 gimp_data_loader_new (const gchar      *name,
                       GimpDataLoadFunc  load_func,
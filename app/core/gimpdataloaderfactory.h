@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "gimpdatacache.h"
 #include "gimpdatafactory.h"
 
 
@@ -71,3 +72,8 @@ void              gimp_data_loader_factory_add_loader   (GimpDataFactory
 void              gimp_data_loader_factory_add_fallback (GimpDataFactory         *factory,
                                                          const gchar             *name,
                                                          GimpDataLoadFunc         load_func);
+
+void              gimp_data_loader_factory_set_cache    (GimpDataFactory         *factory,
+                                                         const gchar             *cache_name,
+                                                         GimpDataCacheSaveFunc    save_func,
+                                                         GimpDataCacheLoadFunc    load_func);
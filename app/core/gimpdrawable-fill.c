@@ -48,6 +48,26 @@
 #include "gimp-intl.h"
 
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
+typedef struct
+{
+  GimpScanConvert *scan_convert;
+  GeglBuffer      *mask_buffer;
+  gint             off_x;
+  gint             off_y;
+  gboolean         antialias;
+} ScanConvertRender;
+
+
+/*  local function prototypes  */
+
+static void   gimp_drawable_fill_scan_convert_area (const GeglRectangle *area,
+                                                    ScanConvertRender   *render);
+
+
 /*  public functions  */
 
 void
@@ -222,12 +242,27 @@ gimp_drawable_fill_scan_convert (GimpDrawable    *drawable,
                                  GimpScanConvert *scan_convert,
                                  gboolean         push_undo)
 {
-  GimpContext *context;
-  GeglBuffer  *buffer;
-  GeglBuffer  *mask_buffer;
-  gint         x, y, w, h;
-  gint         off_x;
-  gint         off_y;
+  gimp_drawable_fill_scan_convert_rect (drawable, options, scan_convert,
+                                        NULL, push_undo);
+}
+
+/* like gimp_drawable_fill_scan_convert(), but only touches the part of
+ * the drawable inside @rect, or the whole drawable if @rect is NULL.
+ */
+void
+gimp_drawable_fill_scan_convert_rect (GimpDrawable        *drawable,
+                                      GimpFillOptions     *options,
+                                      GimpScanConvert     *scan_convert,
+                                      const GeglRectangle *rect,
+                                      gboolean             push_undo)
+{
+  GimpContext       *context;
+  GeglBuffer        *buffer;
+  GeglBuffer        *mask_buffer;
+  ScanConvertRender  render;
+  GeglRectangle      area;
+  gint               off_x;
+  gint               off_y;
 
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
@@ -239,25 +274,41 @@ gimp_drawable_fill_scan_convert (GimpDrawable    *drawable,
 
   context = GIMP_CONTEXT (options);
 
-  if (! gimp_item_mask_intersect (GIMP_ITEM (drawable), &x, &y, &w, &h))
+  if (! gimp_item_mask_intersect (GIMP_ITEM (drawable),
+                                  &area.x, &area.y,
+                                  &area.width, &area.height))
+    return;
+
+  if (rect && ! gegl_rectangle_intersect (&area, &area, rect))
     return;
 
   /* fill a 1-bpp GeglBuffer with black, this will describe the shape
    * of the stroke.
    */
-  mask_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, w, h),
+  mask_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                 area.width, area.height),
                                  babl_format ("Y u8"));
 
-  /* render the stroke into it */
+  /* render the stroke into it, in parallel */
   gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
 
-  gimp_scan_convert_render (scan_convert, mask_buffer,
-                            x + off_x, y + off_y,
-                            gimp_fill_options_get_antialias (options));
+  render.scan_convert = scan_convert;
+  render.mask_buffer  = mask_buffer;
+  render.off_x        = area.x + off_x;
+  render.off_y        = area.y + off_y;
+  render.antialias    = gimp_fill_options_get_antialias (options);
+
+  gegl_parallel_distribute_area (
+    GEGL_RECTANGLE (0, 0, area.width, area.height),
+    PIXELS_PER_THREAD, GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) gimp_drawable_fill_scan_convert_area,
+    &render);
 
   buffer = gimp_fill_options_create_buffer (options, drawable,
-                                            GEGL_RECTANGLE (0, 0, w, h),
-                                            -x, -y);
+                                            GEGL_RECTANGLE (0, 0,
+                                                            area.width,
+                                                            area.height),
+                                            -area.x, -area.y);
 
   gimp_gegl_apply_opacity (buffer, NULL, NULL, buffer,
                            mask_buffer, 0, 0, 1.0);
@@ -265,7 +316,7 @@ gimp_drawable_fill_scan_convert (GimpDrawable    *drawable,
 
   /* Apply to drawable */
   gimp_drawable_apply_buffer (drawable, buffer,
-                              GEGL_RECTANGLE (0, 0, w, h),
+                              GEGL_RECTANGLE (0, 0, area.width, area.height),
                               push_undo, C_("undo-type", "Render Stroke"),
                               gimp_context_get_opacity (context),
                               gimp_context_get_paint_mode (context),
@@ -273,9 +324,30 @@ gimp_drawable_fill_scan_convert (GimpDrawable    *drawable,
                               GIMP_LAYER_COLOR_SPACE_AUTO,
                               gimp_layer_mode_get_paint_composite_mode (
                                 gimp_context_get_paint_mode (context)),
-                              NULL, x, y);
+                              NULL, area.x, area.y);
 
   g_object_unref (buffer);
 
-  gimp_drawable_update (drawable, x, y, w, h);
+  gimp_drawable_update (drawable, area.x, area.y, area.width, area.height);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_fill_scan_convert_area (const GeglRectangle *area,
+                                      ScanConvertRender   *render)
+{
+  GeglBuffer *sub_buffer;
+
+  /* the scan convert is only read while rendering, so each thread can
+   * render its own part of the mask
+   */
+  sub_buffer = gegl_buffer_create_sub_buffer (render->mask_buffer, area);
+
+  gimp_scan_convert_render (render->scan_convert, sub_buffer,
+                            render->off_x, render->off_y,
+                            render->antialias);
+
+  g_object_unref (sub_buffer);
 }
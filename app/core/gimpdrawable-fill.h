@@ -54,3 +54,8 @@ void       gimp_drawable_fill_scan_convert (GimpDrawable        *drawable,
                                             GimpFillOptions     *options,
                                             GimpScanConvert     *scan_convert,
                                             gboolean             push_undo);
+void  gimp_drawable_fill_scan_convert_rect (GimpDrawable        *drawable,
+                                            GimpFillOptions     *options,
+                                            GimpScanConvert     *scan_convert,
+                                            const GeglRectangle *rect,
+                                            gboolean             push_undo);
@@ -50,10 +50,17 @@
 #include "gimp-intl.h"
 
 
+static void   gimp_drawable_fuse_run (GList *run);
+
+
 void
 _gimp_drawable_filters_init (GimpDrawable *drawable)
 {
   drawable->private->filter_stack = gimp_filter_stack_new (GIMP_TYPE_FILTER);
+
+  g_signal_connect_swapped (drawable->private->filter_stack, "reorder",
+                            G_CALLBACK (gimp_drawable_fuse_filters),
+                            drawable);
 }
 
 void
@@ -270,6 +277,54 @@ gimp_drawable_lower_filter (GimpDrawable *drawable,
   return FALSE;
 }
 
+/*  runs each sequence of adjacent filters which only apply a point
+ *  filter as-is in one pass: the top filter of the sequence renders all
+ *  their operations, and the ones below it are folded, i.e. they pass
+ *  their input through.
+ */
+void
+gimp_drawable_fuse_filters (GimpDrawable *drawable)
+{
+  GList *run = NULL;
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  for (list = GIMP_LIST (drawable->private->filter_stack)->queue->tail;
+       list;
+       list = g_list_previous (list))
+    {
+      GimpFilter *filter = list->data;
+
+      /*  inactive filters aren't part of the graph, so they don't
+       *  separate the ones around them
+       */
+      if (gimp_filter_get_active (filter)   &&
+          GIMP_IS_DRAWABLE_FILTER (filter) &&
+          gimp_drawable_filter_can_fuse (GIMP_DRAWABLE_FILTER (filter)))
+        {
+          run = g_list_append (run, filter);
+
+          continue;
+        }
+
+      if (GIMP_IS_DRAWABLE_FILTER (filter))
+        {
+          gimp_drawable_filter_set_fused (GIMP_DRAWABLE_FILTER (filter), NULL);
+          gimp_drawable_filter_set_folded (GIMP_DRAWABLE_FILTER (filter), FALSE);
+        }
+
+      if (gimp_filter_get_active (filter))
+        {
+          gimp_drawable_fuse_run (run);
+          g_clear_pointer (&run, g_list_free);
+        }
+    }
+
+  gimp_drawable_fuse_run (run);
+  g_list_free (run);
+}
+
 void
 gimp_drawable_merge_filters (GimpDrawable *drawable)
 {
@@ -611,3 +666,28 @@ gimp_drawable_merge_filter (GimpDrawable *drawable,
 
   return success;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_fuse_run (GList *run)
+{
+  GList *list;
+
+  for (list = run; list; list = g_list_next (list))
+    {
+      GimpDrawableFilter *filter = list->data;
+
+      if (list->next)
+        {
+          gimp_drawable_filter_set_fused (filter, NULL);
+          gimp_drawable_filter_set_folded (filter, TRUE);
+        }
+      else
+        {
+          gimp_drawable_filter_set_folded (filter, FALSE);
+          gimp_drawable_filter_set_fused (filter, run);
+        }
+    }
+}
@@ -51,6 +51,8 @@ gboolean        gimp_drawable_raise_filter          (GimpDrawable *drawable,
 gboolean        gimp_drawable_lower_filter          (GimpDrawable *drawable,
                                                      GimpFilter   *filter);
 
+void            gimp_drawable_fuse_filters          (GimpDrawable *drawable);
+
 void            gimp_drawable_merge_filters         (GimpDrawable *drawable);
 gboolean        gimp_drawable_merge_filter          (GimpDrawable *drawable,
                                                      GimpFilter   *filter,
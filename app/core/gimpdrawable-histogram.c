@@ -25,6 +25,7 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-loops.h"
 #include "gegl/gimp-gegl-nodes.h"
 #include "gegl/gimptilehandlervalidate.h"
 
@@ -254,3 +255,72 @@ gimp_drawable_calculate_histogram_async (GimpDrawable  *drawable,
                                                      histogram, with_filters,
                                                      TRUE);
 }
+
+/* applies a change of @area of @drawable to @histogram, which must
+ * have been calculated without filters from the drawable's buffer as
+ * it is in @snapshot, and updates @area of @snapshot, so it can be
+ * used for the next change.  returns FALSE, if the histogram has to
+ * be calculated from scratch instead.
+ */
+gboolean
+gimp_drawable_update_histogram (GimpDrawable        *drawable,
+                                GimpHistogram       *histogram,
+                                GeglBuffer          *snapshot,
+                                const GeglRectangle *area)
+{
+  GimpImage     *image;
+  GimpChannel   *mask;
+  GeglBuffer    *buffer;
+  GeglRectangle  rect;
+  gint           x, y, width, height;
+  gboolean       success;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), FALSE);
+  g_return_val_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)), FALSE);
+  g_return_val_if_fail (GIMP_IS_HISTOGRAM (histogram), FALSE);
+  g_return_val_if_fail (GEGL_IS_BUFFER (snapshot), FALSE);
+  g_return_val_if_fail (area != NULL, FALSE);
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  if (gimp_drawable_has_visible_filters (drawable)                      ||
+      gegl_buffer_get_format (snapshot) != gegl_buffer_get_format (buffer) ||
+      ! gegl_rectangle_equal (gegl_buffer_get_extent (snapshot),
+                              gegl_buffer_get_extent (buffer)))
+    {
+      return FALSE;
+    }
+
+  if (! gimp_item_mask_intersect (GIMP_ITEM (drawable), &x, &y, &width, &height) ||
+      ! gegl_rectangle_intersect (&rect,
+                                  area, GEGL_RECTANGLE (x, y, width, height)))
+    {
+      return TRUE;
+    }
+
+  image = gimp_item_get_image (GIMP_ITEM (drawable));
+  mask  = gimp_image_get_mask (image);
+
+  if (! gimp_channel_is_empty (mask))
+    {
+      gint off_x, off_y;
+
+      gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+
+      success = gimp_histogram_update (
+        histogram, snapshot, buffer, &rect,
+        gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)),
+        GEGL_RECTANGLE (rect.x + off_x, rect.y + off_y,
+                        rect.width, rect.height));
+    }
+  else
+    {
+      success = gimp_histogram_update (histogram, snapshot, buffer, &rect,
+                                       NULL, NULL);
+    }
+
+  if (success)
+    gimp_gegl_buffer_copy (buffer, &rect, GEGL_ABYSS_NONE, snapshot, &rect);
+
+  return success;
+}
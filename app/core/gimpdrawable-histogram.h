@@ -20,9 +20,14 @@
 #pragma once
 
 
-void        gimp_drawable_calculate_histogram       (GimpDrawable  *drawable,
-                                                     GimpHistogram *histogram,
-                                                     gboolean       with_filters);
-GimpAsync * gimp_drawable_calculate_histogram_async (GimpDrawable  *drawable,
-                                                     GimpHistogram *histogram,
-                                                     gboolean       with_filters);
+void        gimp_drawable_calculate_histogram       (GimpDrawable        *drawable,
+                                                     GimpHistogram       *histogram,
+                                                     gboolean             with_filters);
+GimpAsync * gimp_drawable_calculate_histogram_async (GimpDrawable        *drawable,
+                                                     GimpHistogram       *histogram,
+                                                     gboolean             with_filters);
+
+gboolean    gimp_drawable_update_histogram          (GimpDrawable        *drawable,
+                                                     GimpHistogram       *histogram,
+                                                     GeglBuffer          *snapshot,
+                                                     const GeglRectangle *area);
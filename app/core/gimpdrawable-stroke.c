@@ -118,6 +118,20 @@ gimp_drawable_stroke_scan_convert (GimpDrawable      *drawable,
                                    GimpStrokeOptions *options,
                                    GimpScanConvert   *scan_convert,
                                    gboolean           push_undo)
+{
+  gimp_drawable_stroke_scan_convert_rect (drawable, options, scan_convert,
+                                          NULL, push_undo);
+}
+
+/* like gimp_drawable_stroke_scan_convert(), but only touches the part
+ * of the drawable inside @rect, or the whole drawable if @rect is NULL.
+ */
+void
+gimp_drawable_stroke_scan_convert_rect (GimpDrawable        *drawable,
+                                        GimpStrokeOptions   *options,
+                                        GimpScanConvert     *scan_convert,
+                                        const GeglRectangle *rect,
+                                        gboolean             push_undo)
 {
   gdouble   width;
   GimpUnit *unit;
@@ -156,6 +170,6 @@ gimp_drawable_stroke_scan_convert (GimpDrawable      *drawable,
                             gimp_stroke_options_get_dash_offset (options),
                             gimp_stroke_options_get_dash_info (options));
 
-  gimp_drawable_fill_scan_convert (drawable, GIMP_FILL_OPTIONS (options),
-                                   scan_convert, push_undo);
+  gimp_drawable_fill_scan_convert_rect (drawable, GIMP_FILL_OPTIONS (options),
+                                        scan_convert, rect, push_undo);
 }
@@ -35,7 +35,12 @@ gboolean   gimp_drawable_stroke_path         (GimpDrawable       *drawable,
                                               gboolean            push_undo,
                                               GError            **error);
 
-void       gimp_drawable_stroke_scan_convert (GimpDrawable      *drawable,
-                                              GimpStrokeOptions *options,
-                                              GimpScanConvert   *scan_convert,
-                                              gboolean           push_undo);
+void       gimp_drawable_stroke_scan_convert (GimpDrawable        *drawable,
+                                              GimpStrokeOptions   *options,
+                                              GimpScanConvert     *scan_convert,
+                                              gboolean             push_undo);
+void  gimp_drawable_stroke_scan_convert_rect (GimpDrawable        *drawable,
+                                              GimpStrokeOptions   *options,
+                                              GimpScanConvert     *scan_convert,
+                                              const GeglRectangle *rect,
+                                              gboolean             push_undo);
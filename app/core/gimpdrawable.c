@@ -890,6 +890,8 @@ gimp_drawable_real_update (GimpDrawable *drawable,
 static void
 gimp_drawable_real_filters_changed (GimpDrawable *drawable)
 {
+  gimp_drawable_fuse_filters (drawable);
+
   gimp_drawable_update_bounding_box (drawable);
 }
 
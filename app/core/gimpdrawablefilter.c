@@ -39,6 +39,7 @@
 #include "core-types.h"
 
 #include "operations/gimp-operation-config.h"
+#include "operations/gimpoperationfusedpointfilter.h"
 
 #include "gegl/gimp-babl.h"
 #include "gegl/gimpapplicator.h"
@@ -117,6 +118,9 @@ struct _GimpDrawableFilter
   GeglNode               *crop_after;
   GimpApplicator         *applicator;
 
+  GeglNode               *fused;
+  gboolean                folded;
+
   gboolean                temporary;
   /* This is mirroring merge_filter option of GimpFilterOptions. */
   gboolean                to_be_merged;
@@ -150,6 +154,7 @@ static void       gimp_drawable_filter_sync_mode             (GimpDrawableFilter
 static void       gimp_drawable_filter_sync_affect           (GimpDrawableFilter  *filter);
 static void       gimp_drawable_filter_sync_format           (GimpDrawableFilter  *filter);
 static void       gimp_drawable_filter_sync_mask             (GimpDrawableFilter  *filter);
+static void       gimp_drawable_filter_sync_fusion           (GimpDrawableFilter  *filter);
 
 static gboolean   gimp_drawable_filter_is_added              (GimpDrawableFilter  *filter);
 static gboolean   gimp_drawable_filter_is_active             (GimpDrawableFilter  *filter);
@@ -794,6 +799,7 @@ gimp_drawable_filter_set_preview (GimpDrawableFilter *filter,
       filter->preview_enabled = enabled;
 
       gimp_drawable_filter_sync_active (filter);
+      gimp_drawable_filter_sync_fusion (filter);
 
       if (gimp_drawable_filter_is_added (filter))
         {
@@ -1184,6 +1190,115 @@ gimp_drawable_filter_get_format (GimpDrawableFilter *filter)
   return format;
 }
 
+gboolean
+gimp_drawable_filter_can_fuse (GimpDrawableFilter *filter)
+{
+  GimpChannel *mask;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE_FILTER (filter), FALSE);
+
+  /*  only filters which replace the drawable's pixels with the result of
+   *  a point filter, as-is, can run fused with the ones next to them
+   */
+  if (! filter->has_input                       ||
+      ! filter->preview_enabled                 ||
+      filter->to_be_merged                      ||
+      filter->crop_enabled                      ||
+      filter->preview_split_enabled             ||
+      filter->opacity    != GIMP_OPACITY_OPAQUE ||
+      filter->paint_mode != GIMP_LAYER_MODE_REPLACE)
+    {
+      return FALSE;
+    }
+
+  if (! gimp_operation_fused_point_filter_can_fuse (filter->operation))
+    return FALSE;
+
+  if (! filter->override_constraints &&
+      gimp_drawable_get_active_mask (filter->drawable) != GIMP_COMPONENT_MASK_ALL)
+    {
+      return FALSE;
+    }
+
+  if (filter->mask)
+    mask = GIMP_CHANNEL (filter->mask);
+  else
+    mask = gimp_image_get_mask (gimp_item_get_image (GIMP_ITEM (filter->drawable)));
+
+  return ! mask || gimp_channel_is_empty (mask);
+}
+
+void
+gimp_drawable_filter_set_fused (GimpDrawableFilter *filter,
+                                GList              *filters)
+{
+  GeglNode *node;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE_FILTER (filter));
+  g_return_if_fail (filters == NULL || g_list_last (filters)->data == filter);
+
+  node = gimp_filter_get_node (GIMP_FILTER (filter));
+
+  if (g_list_length (filters) > 1)
+    {
+      GeglNode **nodes;
+      GList     *list;
+      gint       n_nodes = 0;
+
+      nodes = g_new (GeglNode *, g_list_length (filters));
+
+      for (list = filters; list; list = g_list_next (list))
+        {
+          GimpDrawableFilter *member = list->data;
+
+          nodes[n_nodes++] = member->operation;
+        }
+
+      if (! filter->fused)
+        {
+          filter->fused = gegl_node_new_child (node,
+                                               "operation", "gimp:fused-point-filter",
+                                               NULL);
+
+          /*  keep the operation linked to its input, it's still asked
+           *  about the input's format
+           */
+          gegl_node_link_many (filter->crop_before,
+                               filter->fused,
+                               filter->crop_after,
+                               NULL);
+        }
+
+      gimp_operation_fused_point_filter_set_nodes (
+        GIMP_OPERATION_FUSED_POINT_FILTER (gegl_node_get_gegl_operation (filter->fused)),
+        nodes, n_nodes);
+
+      g_free (nodes);
+    }
+  else if (filter->fused)
+    {
+      gegl_node_disconnect (filter->fused, "input");
+      gegl_node_link (filter->operation, filter->crop_after);
+
+      gegl_node_remove_child (node, filter->fused);
+      filter->fused = NULL;
+    }
+}
+
+void
+gimp_drawable_filter_set_folded (GimpDrawableFilter *filter,
+                                 gboolean            folded)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE_FILTER (filter));
+
+  if (folded != filter->folded)
+    {
+      filter->folded = folded;
+
+      gimp_drawable_filter_sync_active (filter);
+    }
+}
+
 void
 gimp_drawable_filter_apply (GimpDrawableFilter  *filter,
                             const GeglRectangle *area)
@@ -1268,6 +1383,10 @@ gimp_drawable_filter_commit (GimpDrawableFilter *filter,
       /* Only commit if filter is applied destructively */
       if (! non_destructive)
         {
+          /* merging renders this filter's own operation */
+          gimp_drawable_filter_set_fused (filter, NULL);
+          gimp_drawable_filter_set_folded (filter, FALSE);
+
           success = gimp_drawable_merge_filter (filter->drawable,
                                                 GIMP_FILTER (filter),
                                                 progress,
@@ -1382,7 +1501,8 @@ void gimp_drawable_filter_refresh_crop (GimpDrawableFilter *filter,
 static void
 gimp_drawable_filter_sync_active (GimpDrawableFilter *filter)
 {
-  gimp_applicator_set_active (filter->applicator, filter->preview_enabled);
+  gimp_applicator_set_active (filter->applicator,
+                              filter->preview_enabled && ! filter->folded);
 }
 
 static void
@@ -1621,6 +1741,8 @@ gimp_drawable_filter_sync_crop (GimpDrawableFilter  *filter,
 
   gimp_applicator_set_crop (filter->applicator, enabled ? &new_rect : NULL);
 
+  gimp_drawable_filter_sync_fusion (filter);
+
   if (update                                  &&
       gimp_drawable_filter_is_active (filter) &&
       ! gegl_rectangle_equal (&old_rect, &new_rect))
@@ -1643,6 +1765,8 @@ gimp_drawable_filter_sync_opacity (GimpDrawableFilter *filter)
 {
   gimp_applicator_set_opacity (filter->applicator,
                                filter->opacity);
+
+  gimp_drawable_filter_sync_fusion (filter);
 }
 
 static void
@@ -1664,6 +1788,8 @@ gimp_drawable_filter_sync_mode (GimpDrawableFilter *filter)
                             filter->blend_space,
                             filter->composite_space,
                             filter->composite_mode);
+
+  gimp_drawable_filter_sync_fusion (filter);
 }
 
 static void
@@ -1679,6 +1805,8 @@ gimp_drawable_filter_sync_affect (GimpDrawableFilter *filter)
       GIMP_COMPONENT_MASK_ALPHA :
 
       gimp_drawable_get_active_mask (filter->drawable));
+
+  gimp_drawable_filter_sync_fusion (filter);
 }
 
 static void
@@ -1713,6 +1841,8 @@ gimp_drawable_filter_sync_format (GimpDrawableFilter *filter)
 
   if (changed && gimp_drawable_filter_is_active (filter))
     gimp_drawable_filter_update_drawable (filter, NULL);
+
+  gimp_drawable_filter_sync_fusion (filter);
 }
 
 static void
@@ -1763,6 +1893,18 @@ gimp_drawable_filter_sync_mask (GimpDrawableFilter *filter)
 
       gimp_drawable_filter_sync_region (filter);
     }
+
+  gimp_drawable_filter_sync_fusion (filter);
+}
+
+/*  filters can only be fused while they're part of the stack, and
+ *  whether they can changes with most of their settings
+ */
+static void
+gimp_drawable_filter_sync_fusion (GimpDrawableFilter *filter)
+{
+  if (gimp_drawable_filter_is_added (filter))
+    gimp_drawable_fuse_filters (filter->drawable);
 }
 
 static gboolean
@@ -1889,6 +2031,9 @@ gimp_drawable_filter_remove_filter (GimpDrawableFilter *filter)
                                             gimp_drawable_filter_affect_changed,
                                             filter);
 
+      gimp_drawable_filter_set_fused (filter, NULL);
+      gimp_drawable_filter_set_folded (filter, FALSE);
+
       gimp_drawable_remove_filter (drawable, GIMP_FILTER (filter));
 
       gimp_drawable_update_bounding_box (drawable);
@@ -135,6 +135,12 @@ void       gimp_drawable_filter_set_override_constraints
 const Babl *
            gimp_drawable_filter_get_format     (GimpDrawableFilter      *filter);
 
+gboolean   gimp_drawable_filter_can_fuse       (GimpDrawableFilter      *filter);
+void       gimp_drawable_filter_set_fused      (GimpDrawableFilter      *filter,
+                                                GList                   *filters);
+void       gimp_drawable_filter_set_folded     (GimpDrawableFilter      *filter,
+                                                gboolean                 folded);
+
 void       gimp_drawable_filter_apply          (GimpDrawableFilter      *filter,
                                                 const GeglRectangle     *area);
 
@@ -17,18 +17,66 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
+#include <zlib.h>
 
 #include "libgimpbase/gimpbase.h"
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-loops.h"
+
 #include "gimp-memsize.h"
+#include "gimp-parallel.h"
+#include "gimpasync.h"
+#include "gimpwaitable.h"
 #include "gimpimage.h"
 #include "gimpdrawable.h"
 #include "gimpdrawable-filters.h"
 #include "gimpdrawableundo.h"
+#include "gimperror.h"
+#include "gimpundojournal.h"
+
+#include "gimp-intl.h"
+
+
+typedef struct
+{
+  GeglRectangle  rect;
+  guchar        *data;       /* NULL once evicted to the journal */
+  goffset        offset;
+  gsize          size;
+  gboolean       compressed;
+} GimpDrawableUndoTile;
+
+typedef enum
+{
+  TILE_UNKNOWN,
+  TILE_SHARED,
+  TILE_UNSHARED
+} GimpDrawableUndoTileState;
+
+struct _GimpDrawableUndoShares
+{
+  GMutex      mutex;
+
+  GeglBuffer *buffer;         /* the drawable's, not referenced */
+  gulong      changed_id;
+  gint        x;
+  gint        y;
+  gint        width;
+  gint        height;
+  gint        tile_width;
+  gint        tile_height;
+  gint        bpp;
+  gint        n_tile_cols;
+  gint        n_tiles;
+  guint8     *states;
+  gint64      unshared_size;  /* the tiles which stopped being shared */
+};
 
 
 enum
@@ -40,24 +88,48 @@ enum
 };
 
 
-static void     gimp_drawable_undo_constructed  (GObject             *object);
-static void     gimp_drawable_undo_set_property (GObject             *object,
-                                                 guint                property_id,
-                                                 const GValue        *value,
-                                                 GParamSpec          *pspec);
-static void     gimp_drawable_undo_get_property (GObject             *object,
-                                                 guint                property_id,
-                                                 GValue              *value,
-                                                 GParamSpec          *pspec);
-
-static gint64   gimp_drawable_undo_get_memsize  (GimpObject          *object,
-                                                 gint64              *gui_size);
-
-static void     gimp_drawable_undo_pop          (GimpUndo            *undo,
-                                                 GimpUndoMode         undo_mode,
-                                                 GimpUndoAccumulator *accum);
-static void     gimp_drawable_undo_free         (GimpUndo            *undo,
-                                                 GimpUndoMode         undo_mode);
+static void     gimp_drawable_undo_constructed         (GObject                *object);
+static void     gimp_drawable_undo_finalize            (GObject                *object);
+static void     gimp_drawable_undo_set_property        (GObject                *object,
+                                                        guint                   property_id,
+                                                        const GValue           *value,
+                                                        GParamSpec             *pspec);
+static void     gimp_drawable_undo_get_property        (GObject                *object,
+                                                        guint                   property_id,
+                                                        GValue                 *value,
+                                                        GParamSpec             *pspec);
+
+static gint64   gimp_drawable_undo_get_memsize         (GimpObject             *object,
+                                                        gint64                 *gui_size);
+
+static void     gimp_drawable_undo_pop                 (GimpUndo               *undo,
+                                                        GimpUndoMode            undo_mode,
+                                                        GimpUndoAccumulator    *accum);
+static void     gimp_drawable_undo_free                (GimpUndo               *undo,
+                                                        GimpUndoMode            undo_mode);
+static gint64   gimp_drawable_undo_evict               (GimpUndo               *undo,
+                                                        GimpUndoJournal        *journal);
+
+static void     gimp_drawable_undo_compress            (GimpDrawableUndo       *drawable_undo);
+static gboolean gimp_drawable_undo_compress_idle       (GimpDrawableUndo       *drawable_undo);
+static void     gimp_drawable_undo_compress_async_func (GimpAsync              *async,
+                                                        GimpDrawableUndo       *drawable_undo);
+static gboolean gimp_drawable_undo_decompress          (GimpDrawableUndo       *drawable_undo,
+                                                        GError                **error);
+static void     gimp_drawable_undo_clear_tiles         (GimpDrawableUndo       *drawable_undo);
+
+static void     gimp_drawable_undo_track_shares        (GimpDrawableUndo       *drawable_undo,
+                                                        GeglBuffer             *buffer);
+static void     gimp_drawable_undo_clear_shares        (GimpDrawableUndo       *drawable_undo);
+static void     gimp_drawable_undo_share_tile          (GimpDrawableUndoShares *shares,
+                                                        const GeglRectangle    *rect);
+static void     gimp_drawable_undo_shares_changed      (GeglBuffer             *buffer,
+                                                        const GeglRectangle    *rect,
+                                                        GimpDrawableUndoShares *shares);
+static void     gimp_drawable_undo_shares_notify       (GimpDrawableUndoShares *shares,
+                                                        GObject                *buffer);
+
+static void     gimp_drawable_undo_tile_free           (GimpDrawableUndoTile   *tile);
 
 
 G_DEFINE_TYPE (GimpDrawableUndo, gimp_drawable_undo, GIMP_TYPE_ITEM_UNDO)
@@ -73,6 +145,7 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
   GimpUndoClass   *undo_class        = GIMP_UNDO_CLASS (klass);
 
   object_class->constructed      = gimp_drawable_undo_constructed;
+  object_class->finalize         = gimp_drawable_undo_finalize;
   object_class->set_property     = gimp_drawable_undo_set_property;
   object_class->get_property     = gimp_drawable_undo_get_property;
 
@@ -80,6 +153,7 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
 
   undo_class->pop                = gimp_drawable_undo_pop;
   undo_class->free               = gimp_drawable_undo_free;
+  undo_class->evict              = gimp_drawable_undo_evict;
 
   g_object_class_install_property (object_class, PROP_BUFFER,
                                    g_param_spec_object ("buffer", NULL, NULL,
@@ -103,6 +177,8 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
 static void
 gimp_drawable_undo_init (GimpDrawableUndo *undo)
 {
+  undo->tiles = g_ptr_array_new_with_free_func (
+    (GDestroyNotify) gimp_drawable_undo_tile_free);
 }
 
 static void
@@ -114,6 +190,21 @@ gimp_drawable_undo_constructed (GObject *object)
 
   gimp_assert (GIMP_IS_DRAWABLE (GIMP_ITEM_UNDO (object)->item));
   gimp_assert (GEGL_IS_BUFFER (drawable_undo->buffer));
+
+  gimp_drawable_undo_compress (drawable_undo);
+}
+
+static void
+gimp_drawable_undo_finalize (GObject *object)
+{
+  GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
+
+  gimp_drawable_undo_clear_tiles (drawable_undo);
+
+  g_clear_pointer (&drawable_undo->tiles, g_ptr_array_unref);
+  g_clear_object (&drawable_undo->buffer);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -175,7 +266,30 @@ gimp_drawable_undo_get_memsize (GimpObject *object,
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
   gint64            memsize       = 0;
 
-  memsize += gimp_gegl_buffer_get_memsize (drawable_undo->buffer);
+  /*  once the buffer is compressed, it only holds the tiles it shares
+   *  with the drawable, which cost nothing until the drawable changes
+   */
+  if (drawable_undo->compress_async &&
+      gimp_async_is_finished (drawable_undo->compress_async))
+    {
+      GimpDrawableUndoShares *shares = drawable_undo->shares;
+
+      memsize += gimp_g_object_get_memsize (G_OBJECT (drawable_undo->buffer));
+      memsize += drawable_undo->tiles_size;
+
+      if (shares)
+        {
+          g_mutex_lock (&shares->mutex);
+          memsize += shares->unshared_size;
+          g_mutex_unlock (&shares->mutex);
+
+          memsize += sizeof (GimpDrawableUndoShares) + shares->n_tiles;
+        }
+    }
+  else
+    {
+      memsize += gimp_gegl_buffer_get_memsize (drawable_undo->buffer);
+    }
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -188,9 +302,37 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
   GimpDrawable     *drawable      = GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item);
+  GError           *error         = NULL;
 
   GIMP_UNDO_CLASS (parent_class)->pop (undo, undo_mode, accum);
 
+  /*  the step failed and is being reverted, and this undo never
+   *  changed the drawable
+   */
+  if (drawable_undo->pop_failed)
+    {
+      drawable_undo->pop_failed = FALSE;
+
+      return;
+    }
+
+  if (! gimp_drawable_undo_decompress (drawable_undo, &error))
+    {
+      /*  keep the tiles, so the step can be tried again  */
+      drawable_undo->pop_failed = TRUE;
+
+      if (! error)
+        g_set_error_literal (&error, GIMP_ERROR, GIMP_FAILED,
+                             _("The pixels to undo could not be restored."));
+
+      if (! accum->error)
+        accum->error = error;
+      else
+        g_clear_error (&error);
+
+      return;
+    }
+
   gimp_drawable_swap_pixels (drawable,
                              drawable_undo->buffer,
                              drawable_undo->x,
@@ -198,6 +340,9 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
 
   if (gimp_drawable_has_visible_filters (drawable))
     gimp_drawable_update (drawable, 0, 0, -1, -1);
+
+  /*  the buffer now holds the pixels to redo, or undo again  */
+  gimp_drawable_undo_compress (drawable_undo);
 }
 
 static void
@@ -206,7 +351,519 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
 
+  gimp_drawable_undo_clear_tiles (drawable_undo);
+
   g_clear_object (&drawable_undo->buffer);
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+static gint64
+gimp_drawable_undo_evict (GimpUndo        *undo,
+                          GimpUndoJournal *journal)
+{
+  GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+  gint64            evicted       = 0;
+  gint              i;
+
+  /*  only the compressed tiles are evicted, the rest of the buffer is
+   *  shared with the drawable
+   */
+  if (! drawable_undo->compress_async ||
+      ! gimp_async_is_finished (drawable_undo->compress_async))
+    return 0;
+
+  g_return_val_if_fail (drawable_undo->journal == NULL ||
+                        drawable_undo->journal == journal, 0);
+
+  for (i = 0; i < drawable_undo->tiles->len; i++)
+    {
+      GimpDrawableUndoTile *tile  = g_ptr_array_index (drawable_undo->tiles, i);
+      GError               *error = NULL;
+
+      if (! tile->data)
+        continue;
+
+      if (! gimp_undo_journal_append (journal, tile->data, tile->size,
+                                      &tile->offset, &error))
+        {
+          g_printerr ("%s: %s\n", G_STRFUNC, error->message);
+          g_clear_error (&error);
+          break;
+        }
+
+      g_clear_pointer (&tile->data, g_free);
+
+      evicted += tile->size;
+    }
+
+  if (evicted && ! drawable_undo->journal)
+    drawable_undo->journal = gimp_undo_journal_ref (journal);
+
+  drawable_undo->tiles_size -= evicted;
+
+  return evicted;
+}
+
+
+/*  private functions  */
+
+/* the buffer is compared against the drawable from an idle, because
+ * most undos are pushed right before the drawable is modified.  the
+ * tiles which didn't change are then shared copy-on-write with the
+ * drawable, and only the changed ones are kept, compressed.  sharing
+ * only identical tiles keeps the buffer valid no matter when this
+ * runs, it only makes it larger if the drawable changed again.
+ */
+static void
+gimp_drawable_undo_compress (GimpDrawableUndo *drawable_undo)
+{
+  if (! drawable_undo->compress_idle_id)
+    {
+      drawable_undo->compress_idle_id =
+        g_idle_add_full (G_PRIORITY_LOW,
+                         (GSourceFunc) gimp_drawable_undo_compress_idle,
+                         drawable_undo, NULL);
+    }
+}
+
+static gboolean
+gimp_drawable_undo_compress_idle (GimpDrawableUndo *drawable_undo)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (GIMP_ITEM_UNDO (drawable_undo)->item);
+  gint          width    = gegl_buffer_get_width  (drawable_undo->buffer);
+  gint          height   = gegl_buffer_get_height (drawable_undo->buffer);
+
+  drawable_undo->compress_idle_id = 0;
+
+  gimp_drawable_undo_track_shares (drawable_undo,
+                                   gimp_drawable_get_buffer (drawable));
+
+  /*  a copy-on-write snapshot, so the drawable can change meanwhile  */
+  drawable_undo->snapshot =
+    gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
+                     gegl_buffer_get_format (drawable_undo->buffer));
+
+  gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (drawable_undo->x, drawable_undo->y,
+                                         width, height),
+                         GEGL_ABYSS_NONE,
+                         drawable_undo->snapshot,
+                         GEGL_RECTANGLE (0, 0, 0, 0));
+
+  drawable_undo->compress_async = gimp_parallel_run_async_full (
+    +1,
+    (GimpRunAsyncFunc) gimp_drawable_undo_compress_async_func,
+    drawable_undo, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gimp_drawable_undo_compress_async_func (GimpAsync        *async,
+                                        GimpDrawableUndo *drawable_undo)
+{
+  GeglBuffer    *buffer   = drawable_undo->buffer;
+  const Babl    *format   = gegl_buffer_get_format (buffer);
+  gint           bpp      = babl_format_get_bytes_per_pixel (format);
+  GeglRectangle  extent   = *gegl_buffer_get_extent (buffer);
+  guchar        *data;
+  guchar        *current;
+  gint           tile_width;
+  gint           tile_height;
+  gint           x, y;
+
+  g_object_get (buffer,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  data    = g_malloc ((gsize) tile_width * tile_height * bpp);
+  current = g_malloc ((gsize) tile_width * tile_height * bpp);
+
+  for (y = 0; y < extent.height; y += tile_height)
+    {
+      for (x = 0; x < extent.width; x += tile_width)
+        {
+          GimpDrawableUndoTile *tile;
+          GeglRectangle         rect;
+          gsize                 size;
+          uLongf                compressed_size;
+
+          if (gimp_async_is_canceled (async))
+            {
+              g_free (data);
+              g_free (current);
+
+              gimp_async_abort (async);
+
+              return;
+            }
+
+          gegl_rectangle_intersect (&rect,
+                                    GEGL_RECTANGLE (x, y,
+                                                    tile_width, tile_height),
+                                    &extent);
+
+          size = (gsize) rect.width * rect.height * bpp;
+
+          gegl_buffer_get (buffer, &rect, 1.0, format, data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+          gegl_buffer_get (drawable_undo->snapshot, &rect, 1.0, format, current,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          if (! memcmp (data, current, size))
+            {
+              gimp_gegl_buffer_copy (drawable_undo->snapshot,
+                                     &rect, GEGL_ABYSS_NONE,
+                                     buffer, &rect);
+              gimp_drawable_undo_share_tile (drawable_undo->shares, &rect);
+              continue;
+            }
+
+          tile = g_slice_new (GimpDrawableUndoTile);
+
+          tile->rect   = rect;
+          tile->offset = -1;
+
+          compressed_size = compressBound (size);
+          tile->data      = g_malloc (compressed_size);
+
+          if (compress2 (tile->data, &compressed_size, data, size,
+                         Z_BEST_SPEED) == Z_OK &&
+              compressed_size < size)
+            {
+              tile->data       = g_realloc (tile->data, compressed_size);
+              tile->size       = compressed_size;
+              tile->compressed = TRUE;
+            }
+          else
+            {
+              memcpy (tile->data, data, size);
+
+              tile->data       = g_realloc (tile->data, size);
+              tile->size       = size;
+              tile->compressed = FALSE;
+            }
+
+          g_ptr_array_add (drawable_undo->tiles, tile);
+          drawable_undo->tiles_size += sizeof (GimpDrawableUndoTile) +
+                                       tile->size;
+
+          gegl_buffer_clear (buffer, &rect);
+        }
+    }
+
+  g_free (data);
+  g_free (current);
+
+  g_clear_object (&drawable_undo->snapshot);
+
+  gimp_async_finish (async, NULL);
+}
+
+/* restores the tiles into the undo's buffer.  if any tile can't be
+ * read or decompressed, the tiles are kept and FALSE is returned.
+ */
+static gboolean
+gimp_drawable_undo_decompress (GimpDrawableUndo  *drawable_undo,
+                               GError           **error)
+{
+  GeglBuffer *buffer = drawable_undo->buffer;
+  const Babl *format = gegl_buffer_get_format (buffer);
+  gint        bpp    = babl_format_get_bytes_per_pixel (format);
+  guchar     *data   = NULL;
+  guchar     *stored = NULL;
+  gint        i;
+
+  if (drawable_undo->compress_idle_id)
+    {
+      g_source_remove (drawable_undo->compress_idle_id);
+      drawable_undo->compress_idle_id = 0;
+    }
+
+  if (drawable_undo->compress_async)
+    gimp_waitable_wait (GIMP_WAITABLE (drawable_undo->compress_async));
+
+  for (i = 0; i < drawable_undo->tiles->len; i++)
+    {
+      GimpDrawableUndoTile *tile     = g_ptr_array_index (drawable_undo->tiles, i);
+      const guchar         *contents = tile->data;
+      uLongf                size;
+
+      size = (uLongf) tile->rect.width * tile->rect.height * bpp;
+
+      if (! contents)
+        {
+          stored = g_realloc (stored, tile->size);
+
+          if (! gimp_undo_journal_read (drawable_undo->journal,
+                                        tile->offset, stored, tile->size,
+                                        error))
+            break;
+
+          contents = stored;
+        }
+
+      if (tile->compressed)
+        {
+          uLongf expected_size = size;
+
+          data = g_realloc (data, size);
+
+          if (uncompress (data, &size, contents, tile->size) != Z_OK ||
+              size != expected_size)
+            {
+              g_set_error_literal (error, GIMP_ERROR, GIMP_FAILED,
+                                   _("The pixels to undo are corrupt."));
+              break;
+            }
+
+          contents = data;
+        }
+
+      /*  restoring a tile twice is harmless, so the tiles set before a
+       *  failure are simply set again when the step is retried
+       */
+      gegl_buffer_set (buffer, &tile->rect, 0, format, contents,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (data);
+  g_free (stored);
+
+  if (i < drawable_undo->tiles->len)
+    return FALSE;
+
+  gimp_drawable_undo_clear_tiles (drawable_undo);
+
+  return TRUE;
+}
+
+static void
+gimp_drawable_undo_clear_tiles (GimpDrawableUndo *drawable_undo)
+{
+  if (drawable_undo->compress_idle_id)
+    {
+      g_source_remove (drawable_undo->compress_idle_id);
+      drawable_undo->compress_idle_id = 0;
+    }
+
+  if (drawable_undo->compress_async)
+    {
+      gimp_async_cancel_and_wait (drawable_undo->compress_async);
+      g_clear_object (&drawable_undo->compress_async);
+    }
+
+  g_clear_object (&drawable_undo->snapshot);
+
+  gimp_drawable_undo_clear_shares (drawable_undo);
+
+  if (drawable_undo->journal)
+    {
+      gint i;
+
+      for (i = 0; i < drawable_undo->tiles->len; i++)
+        {
+          GimpDrawableUndoTile *tile = g_ptr_array_index (drawable_undo->tiles,
+                                                          i);
+
+          if (! tile->data)
+            gimp_undo_journal_release (drawable_undo->journal,
+                                       tile->offset, tile->size);
+        }
+
+      g_clear_pointer (&drawable_undo->journal, gimp_undo_journal_unref);
+    }
+
+  if (drawable_undo->tiles)
+    g_ptr_array_set_size (drawable_undo->tiles, 0);
+
+  drawable_undo->tiles_size = 0;
+}
+
+/* the tiles copied from the snapshot are shared with the drawable's
+ * buffer, until either of them is written to.  the drawable's buffer
+ * is watched from before the snapshot is taken, so the tiles it
+ * changes in the meantime are known not to be shared.
+ */
+static void
+gimp_drawable_undo_track_shares (GimpDrawableUndo *drawable_undo,
+                                 GeglBuffer       *buffer)
+{
+  GimpDrawableUndoShares *shares;
+  gint                    n_tile_rows;
+
+  gimp_drawable_undo_clear_shares (drawable_undo);
+
+  shares = g_slice_new0 (GimpDrawableUndoShares);
+
+  g_mutex_init (&shares->mutex);
+
+  shares->buffer = buffer;
+  shares->x      = drawable_undo->x;
+  shares->y      = drawable_undo->y;
+  shares->width  = gegl_buffer_get_width  (drawable_undo->buffer);
+  shares->height = gegl_buffer_get_height (drawable_undo->buffer);
+  shares->bpp    = babl_format_get_bytes_per_pixel (
+                     gegl_buffer_get_format (drawable_undo->buffer));
+
+  g_object_get (drawable_undo->buffer,
+                "tile-width",  &shares->tile_width,
+                "tile-height", &shares->tile_height,
+                NULL);
+
+  shares->n_tile_cols = (shares->width + shares->tile_width - 1) /
+                        shares->tile_width;
+  n_tile_rows         = (shares->height + shares->tile_height - 1) /
+                        shares->tile_height;
+  shares->n_tiles     = shares->n_tile_cols * n_tile_rows;
+  shares->states      = g_new0 (guint8, shares->n_tiles);
+
+  g_object_weak_ref (G_OBJECT (buffer),
+                     (GWeakNotify) gimp_drawable_undo_shares_notify,
+                     shares);
+
+  shares->changed_id =
+    gegl_buffer_signal_connect (buffer, "changed",
+                                G_CALLBACK (gimp_drawable_undo_shares_changed),
+                                shares);
+
+  drawable_undo->shares = shares;
+}
+
+static void
+gimp_drawable_undo_clear_shares (GimpDrawableUndo *drawable_undo)
+{
+  GimpDrawableUndoShares *shares = drawable_undo->shares;
+
+  if (! shares)
+    return;
+
+  if (shares->buffer)
+    {
+      g_signal_handler_disconnect (shares->buffer, shares->changed_id);
+      g_object_weak_unref (G_OBJECT (shares->buffer),
+                           (GWeakNotify) gimp_drawable_undo_shares_notify,
+                           shares);
+    }
+
+  g_mutex_clear (&shares->mutex);
+  g_free (shares->states);
+
+  g_slice_free (GimpDrawableUndoShares, shares);
+
+  drawable_undo->shares = NULL;
+}
+
+/* called from the compression worker, for each tile of the undo's
+ * buffer copied from the snapshot.  only whole tiles at the same
+ * position in the drawable's tile grid are actually shared, the rest
+ * are copies.
+ */
+static void
+gimp_drawable_undo_share_tile (GimpDrawableUndoShares *shares,
+                               const GeglRectangle    *rect)
+{
+  gint64 size = (gint64) rect->width * rect->height * shares->bpp;
+
+  g_mutex_lock (&shares->mutex);
+
+  if (shares->buffer                                   &&
+      rect->width  == shares->tile_width               &&
+      rect->height == shares->tile_height              &&
+      (shares->x + rect->x) % shares->tile_width  == 0 &&
+      (shares->y + rect->y) % shares->tile_height == 0)
+    {
+      gint i = ((rect->y / shares->tile_height) * shares->n_tile_cols +
+                rect->x / shares->tile_width);
+
+      if (shares->states[i] == TILE_UNSHARED)
+        shares->unshared_size += size;
+      else
+        shares->states[i] = TILE_SHARED;
+    }
+  else
+    {
+      shares->unshared_size += size;
+    }
+
+  g_mutex_unlock (&shares->mutex);
+}
+
+/* may be called from any thread writing to the drawable's buffer */
+static void
+gimp_drawable_undo_shares_changed (GeglBuffer             *buffer,
+                                   const GeglRectangle    *rect,
+                                   GimpDrawableUndoShares *shares)
+{
+  GeglRectangle area;
+  gint          tile_size;
+  gint          col, row;
+
+  if (! gegl_rectangle_intersect (&area,
+                                  GEGL_RECTANGLE (rect->x - shares->x,
+                                                  rect->y - shares->y,
+                                                  rect->width,
+                                                  rect->height),
+                                  GEGL_RECTANGLE (0, 0,
+                                                  shares->width,
+                                                  shares->height)))
+    return;
+
+  tile_size = shares->tile_width * shares->tile_height * shares->bpp;
+
+  g_mutex_lock (&shares->mutex);
+
+  for (row = area.y / shares->tile_height;
+       row * shares->tile_height < area.y + area.height;
+       row++)
+    {
+      for (col = area.x / shares->tile_width;
+           col * shares->tile_width < area.x + area.width;
+           col++)
+        {
+          gint i = row * shares->n_tile_cols + col;
+
+          if (shares->states[i] == TILE_SHARED)
+            shares->unshared_size += tile_size;
+
+          shares->states[i] = TILE_UNSHARED;
+        }
+    }
+
+  g_mutex_unlock (&shares->mutex);
+}
+
+/* the drawable got a new buffer, and the old one is gone, so the
+ * tiles it shared are the undo's alone
+ */
+static void
+gimp_drawable_undo_shares_notify (GimpDrawableUndoShares *shares,
+                                  GObject                *buffer)
+{
+  gint tile_size = shares->tile_width * shares->tile_height * shares->bpp;
+  gint i;
+
+  g_mutex_lock (&shares->mutex);
+
+  for (i = 0; i < shares->n_tiles; i++)
+    {
+      if (shares->states[i] == TILE_SHARED)
+        shares->unshared_size += tile_size;
+
+      shares->states[i] = TILE_UNSHARED;
+    }
+
+  shares->buffer = NULL;
+
+  g_mutex_unlock (&shares->mutex);
+}
+
+static void
+gimp_drawable_undo_tile_free (GimpDrawableUndoTile *tile)
+{
+  g_free (tile->data);
+
+  g_slice_free (GimpDrawableUndoTile, tile);
+}
@@ -28,16 +28,33 @@
 #define GIMP_DRAWABLE_UNDO_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GIMP_TYPE_DRAWABLE_UNDO, GimpDrawableUndoClass))
 
 
-typedef struct _GimpDrawableUndo      GimpDrawableUndo;
-typedef struct _GimpDrawableUndoClass GimpDrawableUndoClass;
+typedef struct _GimpDrawableUndo       GimpDrawableUndo;
+typedef struct _GimpDrawableUndoClass  GimpDrawableUndoClass;
+typedef struct _GimpDrawableUndoShares GimpDrawableUndoShares;
 
 struct _GimpDrawableUndo
 {
-  GimpItemUndo  parent_instance;
+  GimpItemUndo            parent_instance;
 
-  GeglBuffer   *buffer;
-  gint          x;
-  gint          y;
+  GeglBuffer             *buffer;
+  gint                    x;
+  gint                    y;
+
+  /*  the tiles which differ from the drawable, compressed  */
+  guint                   compress_idle_id;
+  GimpAsync              *compress_async;
+  GeglBuffer             *snapshot;
+  GPtrArray              *tiles;
+  gint64                  tiles_size;
+
+  /*  the tiles shared copy-on-write with the drawable  */
+  GimpDrawableUndoShares *shares;
+
+  /*  where the tiles were evicted to, when the undo stack got too large  */
+  GimpUndoJournal        *journal;
+
+  /*  the tiles couldn't be restored, and the drawable wasn't changed  */
+  gboolean                pop_failed;
 };
 
 struct _GimpDrawableUndoClass
@@ -25,32 +25,57 @@
 
 #include "core-types.h"
 
+#include "gimp-memsize.h"
 #include "gimpfilter.h"
 #include "gimpfilterstack.h"
 
 
+/*  a run of filters that the subclass composites in a single node,
+ *  which replaces their nodes in the graph.  the filters' own nodes
+ *  stay linked to each other, but their output isn't used.
+ */
+typedef struct
+{
+  GList    *filters;  /*  bottom to top  */
+  GeglNode *node;
+} GimpFilterStackMerge;
+
+
 /*  local function prototypes  */
 
-static void   gimp_filter_stack_constructed      (GObject         *object);
-static void   gimp_filter_stack_finalize         (GObject         *object);
+static void       gimp_filter_stack_constructed        (GObject              *object);
+static void       gimp_filter_stack_finalize           (GObject              *object);
+
+static gint64     gimp_filter_stack_get_memsize        (GimpObject           *object,
+                                                        gint64               *gui_size);
 
-static void   gimp_filter_stack_add              (GimpContainer   *container,
-                                                  GimpObject      *object);
-static void   gimp_filter_stack_remove           (GimpContainer   *container,
-                                                  GimpObject      *object);
-static void   gimp_filter_stack_reorder          (GimpContainer   *container,
-                                                  GimpObject      *object,
-                                                  gint             old_index,
-                                                  gint             new_index);
+static void       gimp_filter_stack_add                (GimpContainer        *container,
+                                                        GimpObject           *object);
+static void       gimp_filter_stack_remove             (GimpContainer        *container,
+                                                        GimpObject           *object);
+static void       gimp_filter_stack_reorder            (GimpContainer        *container,
+                                                        GimpObject           *object,
+                                                        gint                  old_index,
+                                                        gint                  new_index);
 
-static void   gimp_filter_stack_add_node         (GimpFilterStack *stack,
-                                                  GimpFilter      *filter);
-static void   gimp_filter_stack_remove_node      (GimpFilterStack *stack,
-                                                  GimpFilter      *filter);
-static void   gimp_filter_stack_update_last_node (GimpFilterStack *stack);
+static void       gimp_filter_stack_add_node           (GimpFilterStack      *stack,
+                                                        GimpFilter           *filter);
+static void       gimp_filter_stack_remove_node        (GimpFilterStack      *stack,
+                                                        GimpFilter           *filter);
+static void       gimp_filter_stack_update_last_node   (GimpFilterStack      *stack);
+static GeglNode * gimp_filter_stack_get_node_above     (GimpFilterStack      *stack,
+                                                        GimpFilter           *filter);
 
-static void   gimp_filter_stack_filter_active    (GimpFilter      *filter,
-                                                  GimpFilterStack *stack);
+static void       gimp_filter_stack_add_cache_node     (GimpFilterStack      *stack);
+static void       gimp_filter_stack_remove_cache_node  (GimpFilterStack      *stack);
+
+static GList *    gimp_filter_stack_get_runs           (GimpFilterStack      *stack);
+static void       gimp_filter_stack_add_merge_nodes    (GimpFilterStack      *stack);
+static void       gimp_filter_stack_remove_merge_nodes (GimpFilterStack      *stack);
+static void       gimp_filter_stack_merge_free         (GimpFilterStackMerge *merge);
+
+static void       gimp_filter_stack_filter_active      (GimpFilter           *filter,
+                                                        GimpFilterStack      *stack);
 
 
 G_DEFINE_TYPE (GimpFilterStack, gimp_filter_stack, GIMP_TYPE_LIST);
@@ -61,11 +86,14 @@ G_DEFINE_TYPE (GimpFilterStack, gimp_filter_stack, GIMP_TYPE_LIST);
 static void
 gimp_filter_stack_class_init (GimpFilterStackClass *klass)
 {
-  GObjectClass       *object_class    = G_OBJECT_CLASS (klass);
-  GimpContainerClass *container_class = GIMP_CONTAINER_CLASS (klass);
+  GObjectClass       *object_class      = G_OBJECT_CLASS (klass);
+  GimpObjectClass    *gimp_object_class = GIMP_OBJECT_CLASS (klass);
+  GimpContainerClass *container_class   = GIMP_CONTAINER_CLASS (klass);
+
+  object_class->constructed      = gimp_filter_stack_constructed;
+  object_class->finalize         = gimp_filter_stack_finalize;
 
-  object_class->constructed = gimp_filter_stack_constructed;
-  object_class->finalize    = gimp_filter_stack_finalize;
+  gimp_object_class->get_memsize = gimp_filter_stack_get_memsize;
 
   container_class->add      = gimp_filter_stack_add;
   container_class->remove   = gimp_filter_stack_remove;
@@ -97,11 +125,41 @@ gimp_filter_stack_finalize (GObject *object)
 {
   GimpFilterStack *stack = GIMP_FILTER_STACK (object);
 
+  g_list_free_full (stack->merges,
+                    (GDestroyNotify) gimp_filter_stack_merge_free);
+  stack->merges = NULL;
+
   g_clear_object (&stack->graph);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static gint64
+gimp_filter_stack_get_memsize (GimpObject *object,
+                               gint64     *gui_size)
+{
+  GimpFilterStack *stack = GIMP_FILTER_STACK (object);
+
+  /*  the cache can be rendered again, like a projection  */
+  if (stack->cache_node)
+    {
+      GeglBuffer *cache = NULL;
+
+      gegl_node_get (stack->cache_node,
+                     "cache", &cache,
+                     NULL);
+
+      if (cache)
+        {
+          *gui_size += gimp_gegl_buffer_get_memsize (cache);
+
+          g_object_unref (cache);
+        }
+    }
+
+  return GIMP_OBJECT_CLASS (parent_class)->get_memsize (object, gui_size);
+}
+
 static void
 gimp_filter_stack_add (GimpContainer *container,
                        GimpObject    *object)
@@ -115,8 +173,14 @@ gimp_filter_stack_add (GimpContainer *container,
     {
       if (stack->graph)
         {
+          gimp_filter_stack_remove_cache_node (stack);
+          gimp_filter_stack_remove_merge_nodes (stack);
+
           gegl_node_add_child (stack->graph, gimp_filter_get_node (filter));
           gimp_filter_stack_add_node (stack, filter);
+
+          gimp_filter_stack_add_merge_nodes (stack);
+          gimp_filter_stack_add_cache_node (stack);
         }
 
       gimp_filter_stack_update_last_node (stack);
@@ -132,12 +196,27 @@ gimp_filter_stack_remove (GimpContainer *container,
 
   if (stack->graph && gimp_filter_get_active (filter))
     {
+      gimp_filter_stack_remove_cache_node (stack);
+      gimp_filter_stack_remove_merge_nodes (stack);
+
       gimp_filter_stack_remove_node (stack, filter);
       gegl_node_remove_child (stack->graph, gimp_filter_get_node (filter));
     }
 
+  /*  there is no cache node for the filter at this point, and the merge
+   *  nodes must not be added back before it's gone from the list
+   */
+  if (filter == stack->cache_filter)
+    stack->cache_filter = NULL;
+
   GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
 
+  if (stack->graph && gimp_filter_get_active (filter))
+    {
+      gimp_filter_stack_add_merge_nodes (stack);
+      gimp_filter_stack_add_cache_node (stack);
+    }
+
   if (gimp_filter_get_active (filter))
     {
       gimp_filter_set_is_last_node (filter, FALSE);
@@ -155,7 +234,11 @@ gimp_filter_stack_reorder (GimpContainer *container,
   GimpFilter      *filter = GIMP_FILTER (object);
 
   if (stack->graph && gimp_filter_get_active (filter))
-    gimp_filter_stack_remove_node (stack, filter);
+    {
+      gimp_filter_stack_remove_cache_node (stack);
+      gimp_filter_stack_remove_merge_nodes (stack);
+      gimp_filter_stack_remove_node (stack, filter);
+    }
 
   GIMP_CONTAINER_CLASS (parent_class)->reorder (container, object,
                                                 old_index, new_index);
@@ -165,7 +248,11 @@ gimp_filter_stack_reorder (GimpContainer *container,
       gimp_filter_stack_update_last_node (stack);
 
       if (stack->graph)
-        gimp_filter_stack_add_node (stack, filter);
+        {
+          gimp_filter_stack_add_node (stack, filter);
+          gimp_filter_stack_add_merge_nodes (stack);
+          gimp_filter_stack_add_cache_node (stack);
+        }
     }
 }
 
@@ -223,40 +310,135 @@ gimp_filter_stack_get_graph (GimpFilterStack *stack)
 
   gegl_node_link (previous, output);
 
+  gimp_filter_stack_add_merge_nodes (stack);
+  gimp_filter_stack_add_cache_node (stack);
+
   return stack->graph;
 }
 
+/**
+ * gimp_filter_stack_set_cache_filter:
+ * @stack:  a #GimpFilterStack
+ * @filter: (nullable): a filter of @stack
+ *
+ * Caches the composite of all filters below @filter, so that changes
+ * to @filter, or to the filters above it, don't cause the filters
+ * below it to be processed again. The cache is invalidated region by
+ * region whenever anything below @filter changes.
+ *
+ * Passing %NULL drops the cache.
+ **/
+void
+gimp_filter_stack_set_cache_filter (GimpFilterStack *stack,
+                                    GimpFilter      *filter)
+{
+  g_return_if_fail (GIMP_IS_FILTER_STACK (stack));
+  g_return_if_fail (filter == NULL || GIMP_IS_FILTER (filter));
+  g_return_if_fail (filter == NULL ||
+                    gimp_container_have (GIMP_CONTAINER (stack),
+                                         GIMP_OBJECT (filter)));
 
-/*  private functions  */
+  if (filter != stack->cache_filter)
+    {
+      gimp_filter_stack_remove_cache_node (stack);
+      gimp_filter_stack_remove_merge_nodes (stack);
 
-static void
-gimp_filter_stack_add_node (GimpFilterStack *stack,
-                            GimpFilter      *filter)
+      stack->cache_filter = filter;
+
+      gimp_filter_stack_add_merge_nodes (stack);
+      gimp_filter_stack_add_cache_node (stack);
+    }
+}
+
+GimpFilter *
+gimp_filter_stack_get_cache_filter (GimpFilterStack *stack)
 {
-  GeglNode *node;
-  GeglNode *node_above = NULL;
-  GeglNode *node_below = NULL;
-  GList    *iter;
+  g_return_val_if_fail (GIMP_IS_FILTER_STACK (stack), NULL);
 
-  node = gimp_filter_get_node (filter);
+  return stack->cache_filter;
+}
+
+/**
+ * gimp_filter_stack_update_merges:
+ * @stack: a #GimpFilterStack
+ *
+ * Finds the runs of filters that the stack's class can composite in a
+ * single node again.  Subclasses call this when anything changes that
+ * their can_merge() or merge() implementations depend on.  If the runs
+ * are still the same, their nodes are only updated, otherwise they're
+ * replaced.
+ **/
+void
+gimp_filter_stack_update_merges (GimpFilterStack *stack)
+{
+  GimpFilterStackClass *klass;
+  GList                *runs;
+  GList                *run;
+  GList                *list;
 
+  g_return_if_fail (GIMP_IS_FILTER_STACK (stack));
 
-  iter = g_list_find (GIMP_LIST (stack)->queue->head, filter);
+  klass = GIMP_FILTER_STACK_GET_CLASS (stack);
 
-  while ((iter = g_list_previous (iter)))
+  if (! stack->graph || ! klass->can_merge)
+    return;
+
+  runs = gimp_filter_stack_get_runs (stack);
+
+  /*  stack->merges is top to bottom, the runs are bottom to top  */
+  for (run = runs, list = g_list_last (stack->merges);
+       run && list;
+       run = g_list_next (run), list = g_list_previous (list))
     {
-      GimpFilter *filter_above = iter->data;
+      GimpFilterStackMerge *merge   = list->data;
+      GList                *filter1 = run->data;
+      GList                *filter2 = merge->filters;
 
-      if (gimp_filter_get_active (filter_above))
+      while (filter1 && filter2 && filter1->data == filter2->data)
+        {
+          filter1 = g_list_next (filter1);
+          filter2 = g_list_next (filter2);
+        }
+
+      if (filter1 || filter2)
+        break;
+    }
+
+  if (! run && ! list)
+    {
+      for (list = stack->merges; list; list = g_list_next (list))
         {
-          node_above = gimp_filter_get_node (filter_above);
+          GimpFilterStackMerge *merge = list->data;
 
-          break;
+          klass->merge (stack, merge->filters, merge->node);
         }
     }
+  else
+    {
+      gimp_filter_stack_remove_cache_node (stack);
+      gimp_filter_stack_remove_merge_nodes (stack);
+
+      gimp_filter_stack_add_merge_nodes (stack);
+      gimp_filter_stack_add_cache_node (stack);
+    }
+
+  g_list_free_full (runs, (GDestroyNotify) g_list_free);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_filter_stack_add_node (GimpFilterStack *stack,
+                            GimpFilter      *filter)
+{
+  GeglNode *node;
+  GeglNode *node_above;
+  GeglNode *node_below;
 
-  if (! node_above)
-    node_above = gegl_node_get_output_proxy (stack->graph, "output");
+  node = gimp_filter_get_node (filter);
+
+  node_above = gimp_filter_stack_get_node_above (stack, filter);
 
   node_below = gegl_node_get_producer (node_above, "input", NULL);
 
@@ -269,12 +451,29 @@ gimp_filter_stack_remove_node (GimpFilterStack *stack,
                                GimpFilter      *filter)
 {
   GeglNode *node;
-  GeglNode *node_above = NULL;
-  GeglNode *node_below = NULL;
-  GList    *iter;
+  GeglNode *node_above;
+  GeglNode *node_below;
 
   node = gimp_filter_get_node (filter);
 
+  node_above = gimp_filter_stack_get_node_above (stack, filter);
+
+  node_below = gegl_node_get_producer (node, "input", NULL);
+
+  gegl_node_disconnect (node, "input");
+
+  gegl_node_link (node_below, node_above);
+}
+
+/*  returns the node of the first active filter above @filter, or the
+ *  graph's output proxy
+ */
+static GeglNode *
+gimp_filter_stack_get_node_above (GimpFilterStack *stack,
+                                  GimpFilter      *filter)
+{
+  GList *iter;
+
   iter = g_list_find (GIMP_LIST (stack)->queue->head, filter);
 
   while ((iter = g_list_previous (iter)))
@@ -282,21 +481,193 @@ gimp_filter_stack_remove_node (GimpFilterStack *stack,
       GimpFilter *filter_above = iter->data;
 
       if (gimp_filter_get_active (filter_above))
+        return gimp_filter_get_node (filter_above);
+    }
+
+  return gegl_node_get_output_proxy (stack->graph, "output");
+}
+
+static void
+gimp_filter_stack_add_cache_node (GimpFilterStack *stack)
+{
+  GeglNode *node;
+  GeglNode *node_below;
+
+  if (! stack->graph       ||
+      ! stack->cache_filter ||
+      stack->cache_node    ||
+      ! gimp_filter_get_active (stack->cache_filter))
+    {
+      return;
+    }
+
+  node       = gimp_filter_get_node (stack->cache_filter);
+  node_below = gegl_node_get_producer (node, "input", NULL);
+
+  if (! node_below)
+    return;
+
+  stack->cache_node = gegl_node_new_child (stack->graph,
+                                           "operation", "gegl:cache",
+                                           NULL);
+
+  gegl_node_link (node_below, stack->cache_node);
+  gegl_node_link (stack->cache_node, node);
+}
+
+static void
+gimp_filter_stack_remove_cache_node (GimpFilterStack *stack)
+{
+  GeglNode *node_below;
+
+  if (! stack->cache_node)
+    return;
+
+  node_below = gegl_node_get_producer (stack->cache_node, "input", NULL);
+
+  gegl_node_disconnect (stack->cache_node, "input");
+
+  if (node_below)
+    gegl_node_link (node_below, gimp_filter_get_node (stack->cache_filter));
+
+  gegl_node_remove_child (stack->graph, stack->cache_node);
+  stack->cache_node = NULL;
+}
+
+/*  returns the runs of at least two active filters, bottom to top, that
+ *  can be merged, as lists of filters, bottom to top.  the cache filter
+ *  is never part of a run, so that the cache node stays in the graph.
+ */
+static GList *
+gimp_filter_stack_get_runs (GimpFilterStack *stack)
+{
+  GimpFilterStackClass *klass = GIMP_FILTER_STACK_GET_CLASS (stack);
+  GList                *runs  = NULL;
+  GList                *run   = NULL;
+  GimpFilter           *below = NULL;
+  GList                *list;
+
+  if (! klass->can_merge)
+    return NULL;
+
+  for (list = GIMP_LIST (stack)->queue->tail;
+       list;
+       list = g_list_previous (list))
+    {
+      GimpFilter *filter = list->data;
+
+      if (! gimp_filter_get_active (filter))
+        continue;
+
+      if (below                        &&
+          filter != stack->cache_filter &&
+          below  != stack->cache_filter &&
+          klass->can_merge (stack, filter, below))
         {
-          node_above = gimp_filter_get_node (filter_above);
+          if (! run)
+            run = g_list_prepend (run, below);
 
-          break;
+          run = g_list_prepend (run, filter);
+        }
+      else if (run)
+        {
+          runs = g_list_prepend (runs, g_list_reverse (run));
+          run  = NULL;
         }
+
+      below = filter;
     }
 
-  if (! node_above)
-    node_above = gegl_node_get_output_proxy (stack->graph, "output");
+  if (run)
+    runs = g_list_prepend (runs, g_list_reverse (run));
 
-  node_below = gegl_node_get_producer (node, "input", NULL);
+  return g_list_reverse (runs);
+}
 
-  gegl_node_disconnect (node, "input");
+static void
+gimp_filter_stack_add_merge_nodes (GimpFilterStack *stack)
+{
+  GimpFilterStackClass *klass = GIMP_FILTER_STACK_GET_CLASS (stack);
+  GList                *runs;
+  GList                *list;
 
-  gegl_node_link (node_below, node_above);
+  if (! stack->graph || stack->merges)
+    return;
+
+  runs = gimp_filter_stack_get_runs (stack);
+
+  for (list = runs; list; list = g_list_next (list))
+    {
+      GimpFilterStackMerge *merge = g_slice_new (GimpFilterStackMerge);
+      GimpFilter           *first = g_list_first (list->data)->data;
+      GimpFilter           *last  = g_list_last (list->data)->data;
+      GeglNode             *node_above;
+      GeglNode             *node_below;
+
+      merge->filters = list->data;
+      merge->node    = gegl_node_new_child (stack->graph, NULL);
+
+      klass->merge (stack, merge->filters, merge->node);
+
+      node_above = gimp_filter_stack_get_node_above (stack, last);
+      node_below = gegl_node_get_producer (gimp_filter_get_node (first),
+                                           "input", NULL);
+
+      if (node_below)
+        gegl_node_link (node_below, merge->node);
+
+      gegl_node_link (merge->node, node_above);
+
+      stack->merges = g_list_prepend (stack->merges, merge);
+    }
+
+  g_list_free (runs);
+}
+
+static void
+gimp_filter_stack_remove_merge_nodes (GimpFilterStack *stack)
+{
+  GList *list;
+
+  /*  top to bottom, so that each merge node's consumer is back in the
+   *  graph when it's removed
+   */
+  for (list = stack->merges; list; list = g_list_next (list))
+    {
+      GimpFilterStackMerge  *merge = list->data;
+      GimpFilter            *last  = g_list_last (merge->filters)->data;
+      GeglNode             **nodes;
+      const gchar          **pads;
+      gint                   n_consumers;
+      gint                   i;
+
+      n_consumers = gegl_node_get_consumers (merge->node, "output",
+                                             &nodes, &pads);
+
+      for (i = 0; i < n_consumers; i++)
+        {
+          gegl_node_connect (gimp_filter_get_node (last), "output",
+                             nodes[i],                    pads[i]);
+        }
+
+      g_free (nodes);
+      g_free (pads);
+
+      gegl_node_disconnect (merge->node, "input");
+      gegl_node_remove_child (stack->graph, merge->node);
+
+      gimp_filter_stack_merge_free (merge);
+    }
+
+  g_clear_pointer (&stack->merges, g_list_free);
+}
+
+static void
+gimp_filter_stack_merge_free (GimpFilterStackMerge *merge)
+{
+  g_list_free (merge->filters);
+
+  g_slice_free (GimpFilterStackMerge, merge);
 }
 
 static void
@@ -329,6 +700,9 @@ gimp_filter_stack_filter_active (GimpFilter      *filter,
 {
   if (stack->graph)
     {
+      gimp_filter_stack_remove_cache_node (stack);
+      gimp_filter_stack_remove_merge_nodes (stack);
+
       if (gimp_filter_get_active (filter))
         {
           gegl_node_add_child (stack->graph, gimp_filter_get_node (filter));
@@ -339,6 +713,9 @@ gimp_filter_stack_filter_active (GimpFilter      *filter,
           gimp_filter_stack_remove_node (stack, filter);
           gegl_node_remove_child (stack->graph, gimp_filter_get_node (filter));
         }
+
+      gimp_filter_stack_add_merge_nodes (stack);
+      gimp_filter_stack_add_cache_node (stack);
     }
 
   gimp_filter_stack_update_last_node (stack);
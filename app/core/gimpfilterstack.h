@@ -34,18 +34,37 @@ typedef struct _GimpFilterStackClass GimpFilterStackClass;
 
 struct _GimpFilterStack
 {
-  GimpList  parent_instance;
+  GimpList    parent_instance;
 
-  GeglNode *graph;
+  GeglNode   *graph;
+
+  GimpFilter *cache_filter;
+  GeglNode   *cache_node;
+
+  GList      *merges;
 };
 
 struct _GimpFilterStackClass
 {
   GimpListClass  parent_class;
+
+  /*  virtual functions  */
+  gboolean (* can_merge) (GimpFilterStack *stack,
+                          GimpFilter      *filter,
+                          GimpFilter      *below);
+  void     (* merge)     (GimpFilterStack *stack,
+                          GList           *filters,
+                          GeglNode        *node);
 };
 
 
-GType           gimp_filter_stack_get_type  (void) G_GNUC_CONST;
-GimpContainer * gimp_filter_stack_new       (GType            filter_type);
+GType           gimp_filter_stack_get_type         (void) G_GNUC_CONST;
+GimpContainer * gimp_filter_stack_new              (GType            filter_type);
+
+GeglNode *      gimp_filter_stack_get_graph        (GimpFilterStack *stack);
+
+void            gimp_filter_stack_set_cache_filter (GimpFilterStack *stack,
+                                                    GimpFilter      *filter);
+GimpFilter *    gimp_filter_stack_get_cache_filter (GimpFilterStack *stack);
 
-GeglNode *      gimp_filter_stack_get_graph (GimpFilterStack *stack);
+void            gimp_filter_stack_update_merges    (GimpFilterStack *stack);
@@ -33,6 +33,7 @@
 #include "config/gimpxmlparser.h"
 
 #include "gimp-utils.h"
+#include "gimpdatacache.h"
 #include "gimpgradient.h"
 #include "gimpgradient-load.h"
 
@@ -359,6 +360,133 @@ gimp_gradient_load_svg (GimpContext   *context,
   return g_list_reverse (parser.gradients);
 }
 
+gboolean
+gimp_gradient_save_to_cache (GimpData   *data,
+                             GByteArray *output)
+{
+  GimpGradient        *gradient = GIMP_GRADIENT (data);
+  GimpGradientSegment *seg;
+
+  if (G_OBJECT_TYPE (gradient) != GIMP_TYPE_GRADIENT)
+    return FALSE;
+
+  gimp_data_cache_write_string (output, gimp_object_get_name (gradient));
+  gimp_data_cache_write_string (output, gimp_data_get_mime_type (data));
+
+  gimp_data_cache_write_int (output,
+                             gimp_gradient_segment_range_get_n_segments (gradient,
+                                                                         gradient->segments,
+                                                                         NULL));
+
+  for (seg = gradient->segments; seg; seg = seg->next)
+    {
+      gimp_data_cache_write_double (output, seg->left);
+      gimp_data_cache_write_double (output, seg->middle);
+      gimp_data_cache_write_double (output, seg->right);
+      gimp_data_cache_write_int    (output, seg->left_color_type);
+      gimp_data_cache_write_int    (output, seg->right_color_type);
+      gimp_data_cache_write_int    (output, seg->type);
+      gimp_data_cache_write_int    (output, seg->color);
+
+      if (! gimp_data_cache_write_color (output, seg->left_color) ||
+          ! gimp_data_cache_write_color (output, seg->right_color))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+GimpData *
+gimp_gradient_load_from_cache (GimpContext         *context,
+                               GimpDataCacheReader *reader)
+{
+  GimpGradient        *gradient;
+  GimpGradientSegment *prev = NULL;
+  gchar               *name;
+  gchar               *mime_type = NULL;
+  gint32               n_segments;
+  gint                 i;
+
+  if (! gimp_data_cache_read_string (reader, &name))
+    return NULL;
+
+  if (! name                                           ||
+      ! gimp_data_cache_read_string (reader, &mime_type) ||
+      ! gimp_data_cache_read_int    (reader, &n_segments) ||
+      n_segments < 1)
+    {
+      g_free (name);
+      g_free (mime_type);
+      return NULL;
+    }
+
+  gradient = g_object_new (GIMP_TYPE_GRADIENT,
+                           "name",      name,
+                           "mime-type", mime_type,
+                           NULL);
+
+  g_free (name);
+  g_free (mime_type);
+
+  for (i = 0; i < n_segments; i++)
+    {
+      GimpGradientSegment *seg = gimp_gradient_segment_new ();
+      gint32               left_color_type;
+      gint32               right_color_type;
+      gint32               type;
+      gint32               color;
+
+      seg->prev = prev;
+
+      if (prev)
+        prev->next = seg;
+      else
+        gradient->segments = seg;
+
+      prev = seg;
+
+      g_clear_object (&seg->left_color);
+      g_clear_object (&seg->right_color);
+
+      if (! gimp_data_cache_read_double (reader, &seg->left)           ||
+          ! gimp_data_cache_read_double (reader, &seg->middle)         ||
+          ! gimp_data_cache_read_double (reader, &seg->right)          ||
+          ! gimp_data_cache_read_int    (reader, &left_color_type)     ||
+          ! gimp_data_cache_read_int    (reader, &right_color_type)    ||
+          ! gimp_data_cache_read_int    (reader, &type)                ||
+          ! gimp_data_cache_read_int    (reader, &color)               ||
+          ! gimp_data_cache_read_color  (reader, &seg->left_color)     ||
+          ! gimp_data_cache_read_color  (reader, &seg->right_color)    ||
+          ! seg->left_color                                            ||
+          ! seg->right_color                                           ||
+          left_color_type  < GIMP_GRADIENT_COLOR_FIXED                 ||
+          left_color_type  > GIMP_GRADIENT_COLOR_BACKGROUND_TRANSPARENT ||
+          right_color_type < GIMP_GRADIENT_COLOR_FIXED                 ||
+          right_color_type > GIMP_GRADIENT_COLOR_BACKGROUND_TRANSPARENT ||
+          type             < GIMP_GRADIENT_SEGMENT_LINEAR              ||
+          type             > GIMP_GRADIENT_SEGMENT_STEP                ||
+          color            < GIMP_GRADIENT_SEGMENT_RGB                 ||
+          color            > GIMP_GRADIENT_SEGMENT_HSV_CW)
+        {
+          /*  the segments' colors must not be NULL when freeing them  */
+          if (! seg->left_color)
+            seg->left_color = gegl_color_new ("black");
+          if (! seg->right_color)
+            seg->right_color = gegl_color_new ("white");
+
+          g_object_unref (gradient);
+          return NULL;
+        }
+
+      seg->left_color_type  = left_color_type;
+      seg->right_color_type = right_color_type;
+      seg->type             = type;
+      seg->color            = color;
+    }
+
+  return GIMP_DATA (gradient);
+}
+
 static void
 svg_parser_start_element (GMarkupParseContext  *context,
                           const gchar          *element_name,
@@ -22,11 +22,16 @@
 #define GIMP_GRADIENT_SVG_FILE_EXTENSION ".svg"
 
 
-GList  * gimp_gradient_load     (GimpContext   *context,
-                                 GFile         *file,
-                                 GInputStream  *input,
-                                 GError       **error);
-GList  * gimp_gradient_load_svg (GimpContext   *context,
-                                 GFile         *file,
-                                 GInputStream  *input,
-                                 GError       **error);
+GList    * gimp_gradient_load            (GimpContext          *context,
+                                          GFile                *file,
+                                          GInputStream         *input,
+                                          GError              **error);
+GList    * gimp_gradient_load_svg        (GimpContext          *context,
+                                          GFile                *file,
+                                          GInputStream         *input,
+                                          GError              **error);
+
+gboolean   gimp_gradient_save_to_cache   (GimpData             *data,
+                                          GByteArray           *output);
+GimpData * gimp_gradient_load_from_cache (GimpContext          *context,
+                                          GimpDataCacheReader  *reader);
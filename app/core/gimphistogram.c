@@ -414,6 +414,91 @@ gimp_histogram_calculate_async (GimpHistogram       *histogram,
   return histogram->priv->calculate_async;
 }
 
+/* subtracts the contribution of @buffer_rect in @old_buffer from the
+ * histogram, and adds the contribution of the same area in @buffer.
+ * @mask and @mask_rect must be the same ones the current values were
+ * calculated with.  returns FALSE, leaving the values untouched, if
+ * the histogram can't be updated this way, and has to be recalculated.
+ */
+gboolean
+gimp_histogram_update (GimpHistogram       *histogram,
+                       GeglBuffer          *old_buffer,
+                       GeglBuffer          *buffer,
+                       const GeglRectangle *buffer_rect,
+                       GeglBuffer          *mask,
+                       const GeglRectangle *mask_rect)
+{
+  GimpHistogramPrivate *priv;
+  CalculateContext      old_context = {};
+  CalculateContext      new_context = {};
+  gboolean              success     = FALSE;
+
+  g_return_val_if_fail (GIMP_IS_HISTOGRAM (histogram), FALSE);
+  g_return_val_if_fail (GEGL_IS_BUFFER (old_buffer), FALSE);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (buffer_rect != NULL, FALSE);
+
+  priv = histogram->priv;
+
+  if (priv->calculate_async)
+    gimp_waitable_wait (GIMP_WAITABLE (priv->calculate_async));
+
+  if (! priv->values)
+    return FALSE;
+
+  if (gegl_rectangle_is_empty (buffer_rect))
+    return TRUE;
+
+  old_context.histogram   = histogram;
+  old_context.buffer      = old_buffer;
+  old_context.buffer_rect = *buffer_rect;
+
+  if (mask)
+    {
+      old_context.mask = mask;
+
+      if (mask_rect)
+        old_context.mask_rect = *mask_rect;
+      else
+        old_context.mask_rect = *gegl_buffer_get_extent (mask);
+    }
+
+  new_context        = old_context;
+  new_context.buffer = buffer;
+
+  gimp_histogram_calculate_internal (NULL, &old_context);
+  gimp_histogram_calculate_internal (NULL, &new_context);
+
+  if (old_context.values                                                 &&
+      new_context.values                                                 &&
+      old_context.n_components == new_context.n_components               &&
+      old_context.n_bins       == new_context.n_bins                     &&
+      old_context.n_components + N_DERIVED_CHANNELS == priv->n_channels  &&
+      old_context.n_bins       == priv->n_bins)
+    {
+      gint n_values = priv->n_channels * priv->n_bins;
+      gint i;
+
+      for (i = 0; i < n_values; i++)
+        {
+          gdouble value = priv->values[i] -
+                          old_context.values[i] + new_context.values[i];
+
+          /*  don't let rounding errors produce negative counts  */
+          priv->values[i] = MAX (value, 0.0);
+        }
+
+      g_object_notify (G_OBJECT (histogram), "values");
+
+      success = TRUE;
+    }
+
+  g_free (old_context.values);
+  g_free (new_context.values);
+
+  return success;
+}
+
 void
 gimp_histogram_clear_values (GimpHistogram *histogram,
                              gint           n_components)
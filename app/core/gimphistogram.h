@@ -62,6 +62,12 @@ GimpAsync     * gimp_histogram_calculate_async (GimpHistogram        *histogram,
                                                 const GeglRectangle  *buffer_rect,
                                                 GeglBuffer           *mask,
                                                 const GeglRectangle  *mask_rect);
+gboolean        gimp_histogram_update          (GimpHistogram        *histogram,
+                                                GeglBuffer           *old_buffer,
+                                                GeglBuffer           *buffer,
+                                                const GeglRectangle  *buffer_rect,
+                                                GeglBuffer           *mask,
+                                                const GeglRectangle  *mask_rect);
 
 void            gimp_histogram_clear_values    (GimpHistogram        *histogram,
                                                 gint                  n_components);
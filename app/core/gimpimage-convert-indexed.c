@@ -157,6 +157,7 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-atomic.h"
 #include "gimpcontainer.h"
 #include "gimpdrawable.h"
 #include "gimperror.h"
@@ -201,8 +202,18 @@
 #define G_SCALE 24              /*  scale G (a*) distances by this much  */
 #define B_SCALE 26              /*  and B (b*) by this much              */
 
+/* the mapping passes process the layer in bands of rows, and update
+ * the progress in between
+ */
+#define PASS2_BAND_HEIGHT 128
+#define FS_BAND_HEIGHT    64
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
 
 typedef struct _Color Color;
+typedef struct _ColorNode ColorNode;
 typedef struct _QuantizeObj QuantizeObj;
 
 typedef void (* Pass1Func)     (QuantizeObj *quantize_obj);
@@ -524,6 +535,16 @@ struct _Color
   gint blue;
 };
 
+/* a node of the k-d tree used to find the nearest colormap entries */
+struct _ColorNode
+{
+  gint point[3];   /* the entry's scaled L*a*b* coordinates */
+  gint index;      /* the entry's colormap index            */
+  gint axis;       /* the axis its subtree is split along   */
+  gint left;       /* the nodes below the split, or -1      */
+  gint right;      /* the nodes above the split, or -1      */
+};
+
 struct _QuantizeObj
 {
   Pass1Func     first_pass;       /* first pass over image data creates colormap  */
@@ -540,6 +561,9 @@ struct _QuantizeObj
   Color         clin[256];                /* .. converted to linear space */
   guint64       index_used_count[256];    /* how many times an index was used  */
   CFHistogram   histogram;                /* holds the histogram               */
+  gint         *inverse_cmap;             /* nearest entry + 1, per cell       */
+  ColorNode     color_tree[256];          /* .. as a k-d tree, for lookups     */
+  gint          color_tree_root;
 
   gboolean      want_dither_alpha;
   gint          error_freedom;            /* 0=much bleed, 1=controlled bleed */
@@ -2420,336 +2444,164 @@ select_colors_rgb (QuantizeObj *quantobj,
  * cache for future use.  The pass2 scanning routines call fill_inverse_cmap
  * when they need to use an unfilled entry in the cache.
  *
- * Our method of efficiently finding nearest colors is based on the "locally
- * sorted search" idea described by Heckbert and on the incremental distance
- * calculation described by Spencer W. Thomas in chapter III.1 of Graphics
- * Gems II (James Arvo, ed.  Academic Press, 1991).  Thomas points out that
- * the distances from a given colormap entry to each cell of the histogram can
- * be computed quickly using an incremental method: the differences between
- * distances to adjacent cells themselves differ by a constant.  This allows a
- * fairly fast implementation of the "brute force" approach of computing the
- * distance from every colormap entry to every histogram cell.  Unfortunately,
- * it needs a work array to hold the best-distance-so-far for each histogram
- * cell (because the inner loop has to be over cells, not colormap entries).
- * The work array elements have to be ints, so the work array would need
- * 256Kb at our recommended precision.  This is not feasible in DOS machines.
+ * We find the nearest colors with a k-d tree over the colormap, built in
+ * L*a*b* space scaled by R_SCALE, G_SCALE and B_SCALE, so the distances
+ * are the ones the colormap was chosen by.  The search is exact: when
+ * several entries are equally close to a cell, the one with the lowest
+ * index wins.  Each cell needs about log2(colors) distance computations
+ * instead of one per colormap entry, and since the tree is read-only
+ * once built, the pass2 routines can search it from several threads.
  *
- * To get around these problems, we apply Thomas' method to compute the
- * nearest colors for only the cells within a small subbox of the histogram.
- * The work array need be only as big as the subbox, so the memory usage
- * problem is solved.  Furthermore, we need not fill subboxes that are never
- * referenced in pass2; many images use only part of the color gamut, so a
- * fair amount of work is saved.  An additional advantage of this
- * approach is that we can apply Heckbert's locality criterion to quickly
- * eliminate colormap entries that are far away from the subbox; typically
- * three-fourths of the colormap entries are rejected by Heckbert's criterion,
- * and we need not compute their distances to individual cells in the subbox.
- * The speed of this approach is heavily influenced by the subbox size: too
- * small means too much overhead, too big loses because Heckbert's criterion
- * can't eliminate as many colormap entries.  Empirically the best subbox
- * size seems to be about 1/512th of the histogram (1/8th in each direction).
- *
- * Thomas' article also describes a refined method which is asymptotically
- * faster than the brute-force method, but it is also far more complex and
- * cannot efficiently be applied to small subboxes.  It is therefore not
- * useful for programs intended to be portable to DOS machines.  On machines
- * with plenty of memory, filling the whole histogram in one shot with Thomas'
- * refined method might be faster than the present code --- but then again,
- * it might not be any faster, and it's certainly more complicated.
+ * The cache itself is shared by all threads: a cell's entry depends only
+ * on the cell and the colormap, so threads racing to fill the same entry
+ * store the same value.
  */
 
 
-/* log2(histogram cells in update box) for each axis; this can be adjusted */
-/*#define BOX_R_LOG  (PRECISION_R-3)
-  #define BOX_G_LOG  (PRECISION_G-3)
-  #define BOX_B_LOG  (PRECISION_B-3)*/
-
-/*adam*/
-#define BOX_R_LOG 0
-#define BOX_G_LOG 0
-#define BOX_B_LOG 0
-
-#define BOX_R_ELEMS  (1<<BOX_R_LOG) /* # of hist cells in update box */
-#define BOX_G_ELEMS  (1<<BOX_G_LOG)
-#define BOX_B_ELEMS  (1<<BOX_B_LOG)
-
-#define BOX_R_SHIFT  (R_SHIFT + BOX_R_LOG)
-#define BOX_G_SHIFT  (G_SHIFT + BOX_G_LOG)
-#define BOX_B_SHIFT  (B_SHIFT + BOX_B_LOG)
+static gint
+color_node_compare_r (const void *a,
+                      const void *b)
+{
+  return ((const ColorNode *) a)->point[0] - ((const ColorNode *) b)->point[0];
+}
 
+static gint
+color_node_compare_g (const void *a,
+                      const void *b)
+{
+  return ((const ColorNode *) a)->point[1] - ((const ColorNode *) b)->point[1];
+}
 
-/*
- * The next three routines implement inverse colormap filling.  They
- * could all be folded into one big routine, but splitting them up
- * this way saves some stack space (the mindist[] and bestdist[]
- * arrays need not coexist) and may allow some compilers to produce
- * better code by registerizing more inner-loop variables.
- */
+static gint
+color_node_compare_b (const void *a,
+                      const void *b)
+{
+  return ((const ColorNode *) a)->point[2] - ((const ColorNode *) b)->point[2];
+}
 
-/* Locate the colormap entries close enough to an update box to be
- * candidates for the nearest entry to some cell(s) in the update box.
- * The update box is specified by the center coordinates of its first
- * cell.  The number of candidate colormap entries is returned, and
- * their colormap indexes are placed in colorlist[].
- *
- * This routine uses Heckbert's "locally sorted search" criterion to
- * select the colors that need further consideration.
+/* Build the subtree of the n_nodes nodes at start, and return the
+ * position of its root.  Each subtree is split at the median along the
+ * axis along which its entries are spread the most.
  */
 static gint
-find_nearby_colors (QuantizeObj *quantobj,
-                    int          minR,
-                    int          minG,
-                    int          minB,
-                    int          colorlist[])
+build_color_tree (ColorNode *tree,
+                  gint       start,
+                  gint       n_nodes)
 {
-  int numcolors = quantobj->actual_number_of_colors;
-  int maxR, maxG, maxB;
-  int centerR, centerG, centerB;
-  int i, x, ncolors;
-  int minmaxdist, min_dist, max_dist, tdist;
-  int mindist[MAXNUMCOLORS];    /* min distance to colormap entry i */
-
-  /* Compute true coordinates of update box's upper corner and center.
-   * Actually we compute the coordinates of the center of the upper-corner
-   * histogram cell, which are the upper bounds of the volume we care about.
-   * Note that since ">>" rounds down, the "center" values may be closer to
-   * min than to max; hence comparisons to them must be "<=", not "<".
-   */
-  maxR = minR + ((1 << BOX_R_SHIFT) - (1 << R_SHIFT));
-  centerR = (minR + maxR + 1) >> 1;
-  maxG = minG + ((1 << BOX_G_SHIFT) - (1 << G_SHIFT));
-  centerG = (minG + maxG + 1) >> 1;
-  maxB = minB + ((1 << BOX_B_SHIFT) - (1 << B_SHIFT));
-  centerB = (minB + maxB + 1) >> 1;
-
-  /* For each color in colormap, find:
-   *  1. its minimum squared-distance to any point in the update box
-   *     (zero if color is within update box);
-   *  2. its maximum squared-distance to any point in the update box.
-   * Both of these can be found by considering only the corners of the box.
-   * We save the minimum distance for each color in mindist[];
-   * only the smallest maximum distance is of interest.
-   */
-  minmaxdist = 0x7FFFFFFFL;
+  static gint (* const compare[3]) (const void *, const void *) =
+    {
+      color_node_compare_r,
+      color_node_compare_g,
+      color_node_compare_b
+    };
+  gint min[3] = { G_MAXINT, G_MAXINT, G_MAXINT };
+  gint max[3] = { G_MININT, G_MININT, G_MININT };
+  gint axis   = 0;
+  gint median;
+  gint i, c;
+
+  if (n_nodes <= 0)
+    return -1;
 
-  for (i = 0; i < numcolors; i++)
+  for (i = start; i < start + n_nodes; i++)
     {
-      /* We compute the squared-R-distance term, then add in the other two. */
-      x = quantobj->clab[i].red;
-      if (x < minR)
-        {
-          tdist = (x - minR) * R_SCALE;
-          min_dist = tdist*tdist;
-          tdist = (x - maxR) * R_SCALE;
-          max_dist = tdist*tdist;
-        }
-      else if (x > maxR)
+      for (c = 0; c < 3; c++)
         {
-          tdist = (x - maxR) * R_SCALE;
-          min_dist = tdist*tdist;
-          tdist = (x - minR) * R_SCALE;
-          max_dist = tdist*tdist;
-        }
-      else
-        {
-          /* within cell range so no contribution to min_dist */
-          min_dist = 0;
-          if (x <= centerR)
-            {
-              tdist = (x - maxR) * R_SCALE;
-              max_dist = tdist*tdist;
-            }
-          else
-            {
-              tdist = (x - minR) * R_SCALE;
-              max_dist = tdist*tdist;
-            }
+          min[c] = MIN (min[c], tree[i].point[c]);
+          max[c] = MAX (max[c], tree[i].point[c]);
         }
+    }
 
-      x = quantobj->clab[i].green;
-      if (x < minG)
-        {
-          tdist = (x - minG) * G_SCALE;
-          min_dist += tdist*tdist;
-          tdist = (x - maxG) * G_SCALE;
-          max_dist += tdist*tdist;
-        }
-      else if (x > maxG)
-        {
-          tdist = (x - maxG) * G_SCALE;
-          min_dist += tdist*tdist;
-          tdist = (x - minG) * G_SCALE;
-          max_dist += tdist*tdist;
-        }
-      else
-        {
-          /* within cell range so no contribution to min_dist */
-          if (x <= centerG)
-            {
-              tdist = (x - maxG) * G_SCALE;
-              max_dist += tdist*tdist;
-            }
-          else
-            {
-              tdist = (x - minG) * G_SCALE;
-              max_dist += tdist*tdist;
-            }
-        }
+  for (c = 1; c < 3; c++)
+    {
+      if (max[c] - min[c] > max[axis] - min[axis])
+        axis = c;
+    }
 
-      x = quantobj->clab[i].blue;
-      if (x < minB)
-        {
-          tdist = (x - minB) * B_SCALE;
-          min_dist += tdist*tdist;
-          tdist = (x - maxB) * B_SCALE;
-          max_dist += tdist*tdist;
-        }
-      else if (x > maxB)
-        {
-          tdist = (x - maxB) * B_SCALE;
-          min_dist += tdist*tdist;
-          tdist = (x - minB) * B_SCALE;
-          max_dist += tdist*tdist;
-        }
-      else
-        {
-          /* within cell range so no contribution to min_dist */
-          if (x <= centerB)
-            {
-              tdist = (x - maxB) * B_SCALE;
-              max_dist += tdist*tdist;
-            }
-          else
-            {
-              tdist = (x - minB) * B_SCALE;
-              max_dist += tdist*tdist;
-            }
-        }
+  qsort (tree + start, n_nodes, sizeof (ColorNode), compare[axis]);
 
-      mindist[i] = min_dist;      /* save away the results */
-      if (max_dist < minmaxdist)
-        minmaxdist = max_dist;
-    }
+  median = start + n_nodes / 2;
 
-  /* Now we know that no cell in the update box is more than minmaxdist
-   * away from some colormap entry.  Therefore, only colors that are
-   * within minmaxdist of some part of the box need be considered.
-   */
-  ncolors = 0;
-  for (i = 0; i < numcolors; i++)
+  tree[median].axis  = axis;
+  tree[median].left  = build_color_tree (tree, start, median - start);
+  tree[median].right = build_color_tree (tree, median + 1,
+                                         start + n_nodes - median - 1);
+
+  return median;
+}
+
+static void
+init_color_tree (QuantizeObj *quantobj)
+{
+  gint i;
+
+  for (i = 0; i < quantobj->actual_number_of_colors; i++)
     {
-      if (mindist[i] <= minmaxdist)
-        colorlist[ncolors++] = i;
+      ColorNode *node = &quantobj->color_tree[i];
+
+      node->point[0] = quantobj->clab[i].red   * R_SCALE;
+      node->point[1] = quantobj->clab[i].green * G_SCALE;
+      node->point[2] = quantobj->clab[i].blue  * B_SCALE;
+      node->index    = i;
     }
 
-  return ncolors;
+  quantobj->color_tree_root =
+    build_color_tree (quantobj->color_tree, 0,
+                      quantobj->actual_number_of_colors);
 }
 
-
-/* Find the closest colormap entry for each cell in the update box,
- * given the list of candidate colors prepared by find_nearby_colors.
- * Return the indexes of the closest entries in the bestcolor[] array.
- * This routine uses Thomas' incremental distance calculation method
- * to find the distance from a colormap entry to successive cells in
- * the box.
- */
 static void
-find_best_colors (QuantizeObj *quantobj,
-                  gint         minR,
-                  gint         minG,
-                  gint         minB,
-                  gint         numcolors,
-                  gint         colorlist[],
-                  gint         bestcolor[])
+search_color_tree (const ColorNode *tree,
+                   gint             node,
+                   const gint       point[3],
+                   gint            *bestcolor,
+                   gint            *bestdist)
 {
-  gint  iR, iG, iB;
-  gint  i, icolor;
-  gint *bptr;           /* pointer into bestdist[] array */
-  gint *cptr;           /* pointer into bestcolor[] array */
-  gint  dist0, dist1;     /* initial distance values */
-  gint  dist2;            /* current distance in inner loop */
-  gint  xx0, xx1;         /* distance increments */
-  gint  xx2;
-  gint  inR, inG, inB;    /* initial values for increments */
-
-  /* This array holds the distance to the nearest-so-far color for each cell */
-  gint  bestdist[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
-
-  /* Initialize best-distance for each cell of the update box */
-  bptr = bestdist;
-  for (i = BOX_R_ELEMS*BOX_G_ELEMS*BOX_B_ELEMS-1; i >= 0; i--)
-    *bptr++ = 0x7FFFFFFFL;
-
-  /* For each color selected by find_nearby_colors,
-   * compute its distance to the center of each cell in the box.
-   * If that's less than best-so-far, update best distance and color number.
+  const ColorNode *n;
+  gint             dist = 0;
+  gint             diff;
+  gint             c;
+
+  if (node < 0)
+    return;
+
+  n = &tree[node];
+
+  for (c = 0; c < 3; c++)
+    {
+      diff  = point[c] - n->point[c];
+      dist += diff * diff;
+    }
+
+  if (dist < *bestdist || (dist == *bestdist && n->index < *bestcolor))
+    {
+      *bestdist  = dist;
+      *bestcolor = n->index;
+    }
+
+  /* Entries on the far side of the split are at least diff away; we
+   * still have to look at them when they can tie with the best one.
    */
+  diff = point[n->axis] - n->point[n->axis];
 
-  /* Nominal steps between cell centers ("x" in Thomas article) */
-#define STEP_R  ((1 << R_SHIFT) * R_SCALE)
-#define STEP_G  ((1 << G_SHIFT) * G_SCALE)
-#define STEP_B  ((1 << B_SHIFT) * B_SCALE)
+  if (diff < 0)
+    {
+      search_color_tree (tree, n->left, point, bestcolor, bestdist);
 
-  for (i = 0; i < numcolors; i++)
+      if (diff * diff <= *bestdist)
+        search_color_tree (tree, n->right, point, bestcolor, bestdist);
+    }
+  else
     {
-      icolor = colorlist[i];
-      /* Compute (square of) distance from minR/G/B to this color */
-      inR = (minR - quantobj->clab[icolor].red) * R_SCALE;
-      dist0 = inR*inR;
-      /* special-case for L*==0: chroma diffs irrelevant */
-      /*    if (minR > 0 || quantobj->clab[icolor].red > 0) */
-      {
-        inG = (minG - quantobj->clab[icolor].green) * G_SCALE;
-        dist0 += inG*inG;
-        inB = (minB - quantobj->clab[icolor].blue) * B_SCALE;
-        dist0 += inB*inB;
-      }
-      /*    else
-            {
-            inG = 0;
-            inB = 0;
-            } */
-      /* Form the initial difference increments */
-      inR = inR * (2 * STEP_R) + STEP_R * STEP_R;
-      inG = inG * (2 * STEP_G) + STEP_G * STEP_G;
-      inB = inB * (2 * STEP_B) + STEP_B * STEP_B;
-      /* Now loop over all cells in box, updating distance per Thomas method */
-      bptr = bestdist;
-      cptr = bestcolor;
-      xx0 = inR;
-      for (iR = BOX_R_ELEMS-1; iR >= 0; iR--)
-        {
-          dist1 = dist0;
-          xx1 = inG;
-          for (iG = BOX_G_ELEMS-1; iG >= 0; iG--)
-            {
-              dist2 = dist1;
-              xx2 = inB;
-              for (iB = BOX_B_ELEMS-1; iB >= 0; iB--)
-                {
-                  if (dist2 < *bptr)
-                    {
-                      *bptr = dist2;
-                      *cptr = icolor;
-                    }
-                  dist2 += xx2;
-                  xx2 += 2 * STEP_B * STEP_B;
-                  bptr++;
-                  cptr++;
-                }
-              dist1 += xx1;
-              xx1 += 2 * STEP_G * STEP_G;
-            }
-          dist0 += xx0;
-          xx0 += 2 * STEP_R * STEP_R;
-        }
+      search_color_tree (tree, n->right, point, bestcolor, bestdist);
+
+      if (diff * diff <= *bestdist)
+        search_color_tree (tree, n->left, point, bestcolor, bestdist);
     }
 }
 
 
-/* Fill the inverse-colormap entries in the update box that contains
- * histogram cell R/G/B.  (Only that one cell MUST be filled, but we
- * can fill as many others as we wish.)
+/* Fill the inverse-colormap entry of gray value pixel.
  */
 static void
 fill_inverse_cmap_gray (QuantizeObj *quantobj,
@@ -2784,63 +2636,45 @@ fill_inverse_cmap_gray (QuantizeObj *quantobj,
 }
 
 
-/* Fill the inverse-colormap entries in the update box that contains
- * histogram cell R/G/B.  (Only that one cell MUST be filled, but we
- * can fill as many others as we wish.)
+/* Fill the inverse-colormap entry of histogram cell R/G/B, and return
+ * it.  The inverse colormap is shared by the threads mapping the layer,
+ * so its entries are stored atomically; threads racing to fill the same
+ * entry store the same value.
  */
-static void
+static gint
 fill_inverse_cmap_rgb (QuantizeObj *quantobj,
-                       CFHistogram  histogram,
                        gint         R,
                        gint         G,
                        gint         B)
 {
-  gint  minR, minG, minB; /* lower left corner of update box */
-  gint  iR, iG, iB;
-  gint *cptr;           /* pointer into bestcolor[] array */
-  /* This array lists the candidate colormap indexes. */
-  gint  colorlist[MAXNUMCOLORS];
-  gint  numcolors;                /* number of candidate colors */
-  /* This array holds the actually closest colormap index for each cell. */
-  gint  bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
-
-  /* Convert cell coordinates to update box id */
-  R >>= BOX_R_LOG;
-  G >>= BOX_G_LOG;
-  B >>= BOX_B_LOG;
-
-  /* Compute true coordinates of update box's origin corner.
-   * Actually we compute the coordinates of the center of the corner
-   * histogram cell, which are the lower bounds of the volume we care about.
-   */
-  minR = (R << BOX_R_SHIFT) + ((1 << R_SHIFT) >> 1);
-  minG = (G << BOX_G_SHIFT) + ((1 << G_SHIFT) >> 1);
-  minB = (B << BOX_B_SHIFT) + ((1 << B_SHIFT) >> 1);
+  const gint point[3]  = { R * R_SCALE, G * G_SCALE, B * B_SCALE };
+  gint       bestcolor = 0;
+  gint       bestdist  = G_MAXINT;
 
-  /* Determine which colormap entries are close enough to be candidates
-   * for the nearest entry to some cell in the update box.
-   */
-  numcolors = find_nearby_colors (quantobj, minR, minG, minB, colorlist);
-
-  /* Determine the actually nearest colors. */
-  find_best_colors (quantobj, minR, minG, minB, numcolors, colorlist,
-                    bestcolor);
-
-  /* Save the best color numbers (plus 1) in the main cache array */
-  R <<= BOX_R_LOG;              /* convert id back to base cell indexes */
-  G <<= BOX_G_LOG;
-  B <<= BOX_B_LOG;
-  cptr = bestcolor;
-  for (iR = 0; iR < BOX_R_ELEMS; iR++)
-    {
-      for (iG = 0; iG < BOX_G_ELEMS; iG++)
-        {
-          for (iB = 0; iB < BOX_B_ELEMS; iB++)
-            {
-              *HIST_LIN (histogram, R + iR, G + iG, B + iB) = (*cptr++) + 1;
-            }
-        }
-    }
+  search_color_tree (quantobj->color_tree, quantobj->color_tree_root,
+                     point, &bestcolor, &bestdist);
+
+  g_atomic_int_set (HIST_LIN (quantobj->inverse_cmap, R, G, B),
+                    bestcolor + 1);
+
+  return bestcolor;
+}
+
+/* Return the colormap index nearest to histogram cell R/G/B, filling
+ * its inverse-colormap entry if we have not seen this color before.
+ */
+static inline gint
+lookup_inverse_cmap_rgb (QuantizeObj *quantobj,
+                         gint         R,
+                         gint         G,
+                         gint         B)
+{
+  gint entry = g_atomic_int_get (HIST_LIN (quantobj->inverse_cmap, R, G, B));
+
+  if (entry == 0)
+    return fill_inverse_cmap_rgb (quantobj, R, G, B);
+
+  return entry - 1;
 }
 
 
@@ -2975,635 +2809,596 @@ custompal_pass1 (QuantizeObj *quantobj)
 
 /*
  * Map some rows of pixels to the output colormapped representation.
+ *
+ * The no-dither and fixed-dither passes map each pixel on its own, so
+ * they run on worker threads, each one mapping an area of the layer and
+ * counting the used indices on its own.  The counts are summed up when
+ * all areas are done.
  */
 
-static void
-median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
-                                 GimpLayer   *layer,
-                                 GeglBuffer  *new_buffer)
-{
-  GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
-  guint64            *index_used_count = quantobj->index_used_count;
-  gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
+typedef struct _Pass2Data Pass2Data;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+typedef void (* Pass2ChunkFunc) (const Pass2Data     *data,
+                                 const guchar        *src,
+                                 guchar              *dest,
+                                 const GeglRectangle *roi,
+                                 guint64             *index_used_count);
 
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+struct _Pass2Data
+{
+  QuantizeObj    *quantobj;
+  Pass2ChunkFunc  chunk_func;
+  GeglBuffer     *src_buffer;
+  GeglBuffer     *dest_buffer;
+  gint            src_bpp;
+  gint            dest_bpp;
+  gboolean        has_alpha;
+  gint            red_pix;
+  gint            green_pix;
+  gint            blue_pix;
+  gint            alpha_pix;
+  gint            offsetx;
+  gint            offsety;
+  GSList         *counts_list;
+};
 
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
 
-  has_alpha = babl_format_has_alpha (src_format);
+static void
+median_cut_pass2_area (const GeglRectangle *area,
+                       Pass2Data           *data)
+{
+  GeglBufferIterator *iter;
+  guint64            *index_used_count;
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  index_used_count = g_new0 (guint64, 256);
+  gimp_atomic_slist_push_head (&data->counts_list, index_used_count);
+
+  iter = gegl_buffer_iterator_new (data->src_buffer, area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
-  src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->dest_buffer, area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *src  = iter->items[0].data;
-      guchar       *dest = iter->items[1].data;
-      gint          row;
+      data->chunk_func (data,
+                        iter->items[0].data,
+                        iter->items[1].data,
+                        &iter->items[0].roi,
+                        index_used_count);
+    }
+}
 
-      for (row = 0; row < src_roi->height; row++)
+static void
+median_cut_pass2_distribute (QuantizeObj    *quantobj,
+                             GimpLayer      *layer,
+                             GeglBuffer     *new_buffer,
+                             Pass2ChunkFunc  chunk_func)
+{
+  Pass2Data   data   = { 0, };
+  const Babl *src_format;
+  gint        width  = gimp_item_get_width  (GIMP_ITEM (layer));
+  gint        height = gimp_item_get_height (GIMP_ITEM (layer));
+  GSList     *list;
+  gint        y;
+
+  src_format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+  data.quantobj    = quantobj;
+  data.chunk_func  = chunk_func;
+  data.src_buffer  = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.dest_buffer = new_buffer;
+  data.src_bpp     = babl_format_get_bytes_per_pixel (src_format);
+  data.dest_bpp    = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (new_buffer));
+  data.has_alpha   = babl_format_has_alpha (src_format);
+
+  /*  In the case of web/mono palettes, we actually force
+   *   grayscale drawables through the rgb pass2 functions
+   */
+  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
+    {
+      data.red_pix   = data.green_pix = data.blue_pix = GRAY;
+      data.alpha_pix = ALPHA_G;
+    }
+  else
+    {
+      data.red_pix   = RED;
+      data.green_pix = GREEN;
+      data.blue_pix  = BLUE;
+      data.alpha_pix = ALPHA;
+    }
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offsetx, &data.offsety);
+
+  for (y = 0; y < height; y += PASS2_BAND_HEIGHT)
+    {
+      GeglRectangle band = { 0, y, width, MIN (PASS2_BAND_HEIGHT, height - y) };
+
+      gegl_parallel_distribute_area (
+        &band, PIXELS_PER_THREAD, GEGL_SPLIT_STRATEGY_AUTO,
+        (GeglParallelDistributeAreaFunc) median_cut_pass2_area,
+        &data);
+
+      if (quantobj->progress)
+        gimp_progress_set_value (quantobj->progress,
+                                 (gdouble) (y + band.height) / (gdouble) height);
+    }
+
+  for (list = data.counts_list; list; list = g_slist_next (list))
+    {
+      const guint64 *index_used_count = list->data;
+      gint           i;
+
+      for (i = 0; i < 256; i++)
+        quantobj->index_used_count[i] += index_used_count[i];
+    }
+
+  g_slist_free_full (data.counts_list, g_free);
+}
+
+static void
+median_cut_pass2_no_dither_gray_chunk (const Pass2Data     *data,
+                                       const guchar        *src,
+                                       guchar              *dest,
+                                       const GeglRectangle *roi,
+                                       guint64             *index_used_count)
+{
+  QuantizeObj *quantobj     = data->quantobj;
+  CFHistogram  histogram    = quantobj->histogram;
+  ColorFreq   *cachep;
+  gboolean     dither_alpha = quantobj->want_dither_alpha;
+  gint         row;
+
+  for (row = 0; row < roi->height; row++)
+    {
+      gint col;
+
+      for (col = 0; col < roi->width; col++)
         {
-          gint col;
+          /* get pixel value and index into the cache, which has been
+           * filled by median_cut_pass2_gray_init()
+           */
+          gint pixel = src[GRAY];
 
-          for (col = 0; col < src_roi->width; col++)
-            {
-              /* get pixel value and index into the cache */
-              gint pixel = src[GRAY];
+          cachep = &histogram[pixel];
 
-              cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
+          if (data->has_alpha)
+            {
+              gboolean transparent = FALSE;
 
-              if (has_alpha)
+              if (dither_alpha)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (dither_alpha)
-                    {
-                      gint dither_x = (col + offsetx + src_roi->x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + src_roi->y) & DM_HEIGHTMASK;
+                  gint dither_x = (col + data->offsetx + roi->x) & DM_WIDTHMASK;
+                  gint dither_y = (row + data->offsety + roi->y) & DM_HEIGHTMASK;
 
-                      if ((src[ALPHA_G]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[ALPHA_G] <= 127)
-                        transparent = TRUE;
-                    }
+                  if ((src[ALPHA_G]) < DM[dither_x][dither_y])
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (src[ALPHA_G] <= 127)
+                    transparent = TRUE;
+                }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                      index_used_count[dest[INDEXED] = *cachep - 1]++;
-                    }
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
                 }
               else
                 {
-                  /* Now emit the colormap index for this cell */
+                  dest[ALPHA_I] = 255;
                   index_used_count[dest[INDEXED] = *cachep - 1]++;
                 }
-
-              src  += src_bpp;
-              dest += dest_bpp;
             }
+          else
+            {
+              /* Now emit the colormap index for this cell */
+              index_used_count[dest[INDEXED] = *cachep - 1]++;
+            }
+
+          src  += data->src_bpp;
+          dest += data->dest_bpp;
         }
     }
 }
 
 static void
-median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
-                                    GimpLayer   *layer,
-                                    GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
+                                 GimpLayer   *layer,
+                                 GeglBuffer  *new_buffer)
 {
-  GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gboolean            has_alpha;
-  gint                pixval1 = 0;
-  gint                pixval2 = 0;
-  gint                err1;
-  gint                err2;
-  Color              *color1;
-  Color              *color2;
-  guint64            *index_used_count = quantobj->index_used_count;
-  gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_no_dither_gray_chunk);
+}
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+static void
+median_cut_pass2_fixed_dither_gray_chunk (const Pass2Data     *data,
+                                          const guchar        *src,
+                                          guchar              *dest,
+                                          const GeglRectangle *roi,
+                                          guint64             *index_used_count)
+{
+  QuantizeObj *quantobj     = data->quantobj;
+  CFHistogram  histogram    = quantobj->histogram;
+  ColorFreq   *cachep;
+  gint         pixval1      = 0;
+  gint         pixval2      = 0;
+  gint         err1;
+  gint         err2;
+  Color       *color1;
+  Color       *color2;
+  gboolean     dither_alpha = quantobj->want_dither_alpha;
+  gint         row;
+
+  for (row = 0; row < roi->height; row++)
+    {
+      gint col;
 
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+      for (col = 0; col < roi->width; col++)
+        {
+          gint       pixel;
+          const gint dmval =
+            DM[(col + data->offsetx + roi->x) & DM_WIDTHMASK]
+            [(row + data->offsety + roi->y) & DM_HEIGHTMASK];
 
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
+          /* get pixel value and index into the cache, which has been
+           * filled by median_cut_pass2_gray_init()
+           */
+          pixel = src[GRAY];
 
-  has_alpha = babl_format_has_alpha (src_format);
+          cachep = &histogram[pixel];
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
-  src_roi = &iter->items[0].roi;
+          pixval1 = *cachep - 1;
+          color1 = &quantobj->cmap[pixval1];
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
-                            GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+          if (quantobj->actual_number_of_colors > 2)
+            {
+              const int re = src[GRAY] - (int)color1->red;
+              int RV = src[GRAY] + re;
 
-  while (gegl_buffer_iterator_next (iter))
-    {
-      const guchar *src  = iter->items[0].data;
-      guchar       *dest = iter->items[1].data;
-      gint          row;
+              do
+                {
+                  const gint R = CLAMP0255 (RV);
 
-      for (row = 0; row < src_roi->height; row++)
-        {
-          gint col;
+                  cachep = &histogram[R];
 
-          for (col = 0; col < src_roi->width; col++)
+                  pixval2 = *cachep - 1;
+                  RV += re;
+                }
+              while ((pixval1 == pixval2) &&
+                     (! (RV>255 || RV<0) ) &&
+                     re);
+            }
+          else
             {
-              gint       pixel;
-              const gint dmval =
-                DM[(col + offsetx + src_roi->x) & DM_WIDTHMASK]
-                [(row + offsety + src_roi->y) & DM_HEIGHTMASK];
-
-              /* get pixel value and index into the cache */
-              pixel = src[GRAY];
-
-              cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
+              /* not enough colors to bother looking for an 'alternative'
+                 color (we may fail to do so anyway), so decide that
+                 the alternative color is simply the other cmap entry. */
+              pixval2 = (pixval1 + 1) %
+                (quantobj->actual_number_of_colors);
+            }
 
-              pixval1 = *cachep - 1;
+          /* always deterministically sort pixval1 and pixval2, to
+             avoid artifacts in the dither range due to inverting our
+             relative color viewpoint -- most obvious in 1-bit dither. */
+          if (pixval1 > pixval2)
+            {
+              gint tmpval = pixval1;
+              pixval1 = pixval2;
+              pixval2 = tmpval;
               color1 = &quantobj->cmap[pixval1];
+            }
 
-              if (quantobj->actual_number_of_colors > 2)
-                {
-                  const int re = src[GRAY] - (int)color1->red;
-                  int RV = src[GRAY] + re;
-
-                  do
-                    {
-                      const gint R = CLAMP0255 (RV);
+          color2 = &quantobj->cmap[pixval2];
 
-                      cachep = &histogram[R];
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_gray (quantobj, histogram, R);
+          err1 = ABS(color1->red - src[GRAY]);
+          err2 = ABS(color2->red - src[GRAY]);
+          if (err1 || err2)
+            {
+              const int proportion2 = (256 * 255 * err2) / (err1 + err2);
 
-                      pixval2 = *cachep - 1;
-                      RV += re;
-                    }
-                  while ((pixval1 == pixval2) &&
-                         (! (RV>255 || RV<0) ) &&
-                         re);
-                }
-              else
+              if ((dmval * 256) > proportion2)
                 {
-                  /* not enough colors to bother looking for an 'alternative'
-                     color (we may fail to do so anyway), so decide that
-                     the alternative color is simply the other cmap entry. */
-                  pixval2 = (pixval1 + 1) %
-                    (quantobj->actual_number_of_colors);
+                  pixval1 = pixval2; /* use color2 instead of color1*/
                 }
+            }
 
-              /* always deterministically sort pixval1 and pixval2, to
-                 avoid artifacts in the dither range due to inverting our
-                 relative color viewpoint -- most obvious in 1-bit dither. */
-              if (pixval1 > pixval2)
+          if (data->has_alpha)
+            {
+              gboolean transparent = FALSE;
+
+              if (dither_alpha)
                 {
-                  gint tmpval = pixval1;
-                  pixval1 = pixval2;
-                  pixval2 = tmpval;
-                  color1 = &quantobj->cmap[pixval1];
+                  if (src[ALPHA_G] < dmval)
+                    transparent = TRUE;
                 }
-
-              color2 = &quantobj->cmap[pixval2];
-
-              err1 = ABS(color1->red - src[GRAY]);
-              err2 = ABS(color2->red - src[GRAY]);
-              if (err1 || err2)
+              else
                 {
-                  const int proportion2 = (256 * 255 * err2) / (err1 + err2);
-
-                  if ((dmval * 256) > proportion2)
-                    {
-                      pixval1 = pixval2; /* use color2 instead of color1*/
-                    }
+                  if (src[ALPHA_G] <= 127)
+                    transparent = TRUE;
                 }
 
-              if (has_alpha)
+              if (transparent)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (dither_alpha)
-                    {
-                      if (src[ALPHA_G] < dmval)
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[ALPHA_G] <= 127)
-                        transparent = TRUE;
-                    }
-
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                      index_used_count[dest[INDEXED] = pixval1]++;
-                    }
+                  dest[ALPHA_I] = 0;
                 }
               else
                 {
-                  /* Now emit the colormap index for this cell, barfbarf */
+                  dest[ALPHA_I] = 255;
                   index_used_count[dest[INDEXED] = pixval1]++;
                 }
-
-              src  += src_bpp;
-              dest += dest_bpp;
             }
+          else
+            {
+              /* Now emit the colormap index for this cell, barfbarf */
+              index_used_count[dest[INDEXED] = pixval1]++;
+            }
+
+          src  += data->src_bpp;
+          dest += data->dest_bpp;
         }
     }
 }
 
 static void
-median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
-                                GimpLayer   *layer,
-                                GeglBuffer  *new_buffer)
+median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
+                                    GimpLayer   *layer,
+                                    GeglBuffer  *new_buffer)
 {
-  GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
-  gint                R, G, B;
-  gint                red_pix          = RED;
-  gint                green_pix        = GREEN;
-  gint                blue_pix         = BLUE;
-  gint                alpha_pix        = ALPHA;
-  gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
-  guint64            *index_used_count = quantobj->index_used_count;
-  gint64              total_size       = 0;
-  gint64              layer_size;
-  gint                count            = 0;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
-
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
-
-  has_alpha = babl_format_has_alpha (src_format);
-
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
-    {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
-    }
-
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
-  src_roi = &iter->items[0].roi;
-
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
-                            GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_fixed_dither_gray_chunk);
+}
 
-  while (gegl_buffer_iterator_next (iter))
+static void
+median_cut_pass2_no_dither_rgb_chunk (const Pass2Data     *data,
+                                      const guchar        *src,
+                                      guchar              *dest,
+                                      const GeglRectangle *roi,
+                                      guint64             *index_used_count)
+{
+  QuantizeObj *quantobj     = data->quantobj;
+  gint         R, G, B;
+  gint         red_pix      = data->red_pix;
+  gint         green_pix    = data->green_pix;
+  gint         blue_pix     = data->blue_pix;
+  gint         alpha_pix    = data->alpha_pix;
+  gboolean     dither_alpha = quantobj->want_dither_alpha;
+  gint         row;
+
+  for (row = 0; row < roi->height; row++)
     {
-      const guchar *src  = iter->items[0].data;
-      guchar       *dest = iter->items[1].data;
-      gint          row;
-
-      total_size += src_roi->height * src_roi->width;
+      gint col;
 
-      for (row = 0; row < src_roi->height; row++)
+      for (col = 0; col < roi->width; col++)
         {
-          gint col;
-
-          for (col = 0; col < src_roi->width; col++)
+          if (data->has_alpha)
             {
-              if (has_alpha)
-                {
-                  gboolean transparent = FALSE;
-
-                  if (dither_alpha)
-                    {
-                      gint dither_x = (col + offsetx + src_roi->x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + src_roi->y) & DM_HEIGHTMASK;
+              gboolean transparent = FALSE;
 
-                      if ((src[alpha_pix]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
+              if (dither_alpha)
+                {
+                  gint dither_x = (col + data->offsetx + roi->x) & DM_WIDTHMASK;
+                  gint dither_y = (row + data->offsety + roi->y) & DM_HEIGHTMASK;
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
+                  if ((src[alpha_pix]) < DM[dither_x][dither_y])
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (src[alpha_pix] <= 127)
+                    transparent = TRUE;
                 }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
-                          &R, &G, &B);
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
+                  goto next_pixel;
+                }
+              else
+                {
+                  dest[ALPHA_I] = 255;
+                }
+            }
 
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+          /* get pixel value and index into the cache */
+          rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
+                      &R, &G, &B);
 
-              /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = *cachep - 1]++;
+          /* Now emit the colormap index for this cell, barfbarf */
+          dest[INDEXED] = lookup_inverse_cmap_rgb (quantobj, R, G, B);
+          index_used_count[dest[INDEXED]]++;
 
-            next_pixel:
+        next_pixel:
 
-              src  += src_bpp;
-              dest += dest_bpp;
-            }
+          src  += data->src_bpp;
+          dest += data->dest_bpp;
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (gdouble) total_size / (gdouble) layer_size);
     }
 }
 
 static void
-median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
-                                   GimpLayer   *layer,
-                                   GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
+                                GimpLayer   *layer,
+                                GeglBuffer  *new_buffer)
 {
-  GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
-  gint                pixval1 = 0;
-  gint                pixval2 = 0;
-  Color              *color1;
-  Color              *color2;
-  gint                R, G, B;
-  gint                err1;
-  gint                err2;
-  gint                red_pix          = RED;
-  gint                green_pix        = GREEN;
-  gint                blue_pix         = BLUE;
-  gint                alpha_pix        = ALPHA;
-  gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
-  guint64            *index_used_count = quantobj->index_used_count;
-  gint64              total_size       = 0;
-  gint64              layer_size;
-  gint                count            = 0;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
-
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
-
-  has_alpha = babl_format_has_alpha (src_format);
-
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
-    {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
-    }
-
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
-  src_roi = &iter->items[0].roi;
-
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
-                            GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_no_dither_rgb_chunk);
+}
 
-  while (gegl_buffer_iterator_next (iter))
+static void
+median_cut_pass2_fixed_dither_rgb_chunk (const Pass2Data     *data,
+                                         const guchar        *src,
+                                         guchar              *dest,
+                                         const GeglRectangle *roi,
+                                         guint64             *index_used_count)
+{
+  QuantizeObj *quantobj     = data->quantobj;
+  gint         pixval1      = 0;
+  gint         pixval2      = 0;
+  Color       *color1;
+  Color       *color2;
+  gint         R, G, B;
+  gint         err1;
+  gint         err2;
+  gint         red_pix      = data->red_pix;
+  gint         green_pix    = data->green_pix;
+  gint         blue_pix     = data->blue_pix;
+  gint         alpha_pix    = data->alpha_pix;
+  gboolean     dither_alpha = quantobj->want_dither_alpha;
+  gint         row;
+
+  for (row = 0; row < roi->height; row++)
     {
-      const guchar *src  = iter->items[0].data;
-      guchar       *dest = iter->items[1].data;
-      gint          row;
+      gint col;
 
-      total_size += src_roi->height * src_roi->width;
-
-      for (row = 0; row < src_roi->height; row++)
+      for (col = 0; col < roi->width; col++)
         {
-          gint col;
+          const int dmval =
+            DM[(col + data->offsetx + roi->x) & DM_WIDTHMASK]
+            [(row + data->offsety + roi->y) & DM_HEIGHTMASK];
 
-          for (col = 0; col < src_roi->width; col++)
+          if (data->has_alpha)
             {
-              const int dmval =
-                DM[(col + offsetx + src_roi->x) & DM_WIDTHMASK]
-                [(row + offsety + src_roi->y) & DM_HEIGHTMASK];
+              gboolean transparent = FALSE;
 
-              if (has_alpha)
+              if (dither_alpha)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (dither_alpha)
-                    {
-                      if (src[alpha_pix] < dmval)
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
+                  if (src[alpha_pix] < dmval)
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (src[alpha_pix] <= 127)
+                    transparent = TRUE;
+                }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
+                  goto next_pixel;
+                }
+              else
+                {
+                  dest[ALPHA_I] = 255;
                 }
+            }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
-                          &R, &G, &B);
+          /* get pixel value and index into the cache */
+          rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
+                      &R, &G, &B);
 
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
-              /* We now try to find a color which, when mixed in some
-               * fashion with the closest match, yields something
-               * closer to the desired color.  We do this by
-               * repeatedly extrapolating the color vector from one to
-               * the other until we find another color cell.  Then we
-               * assess the distance of both mixer colors from the
-               * intended color to determine their relative
-               * probabilities of being chosen.
-               */
-              pixval1 = *cachep - 1;
-              color1 = &quantobj->cmap[pixval1];
+          pixval1 = lookup_inverse_cmap_rgb (quantobj, R, G, B);
+
+          /* We now try to find a color which, when mixed in some
+           * fashion with the closest match, yields something
+           * closer to the desired color.  We do this by
+           * repeatedly extrapolating the color vector from one to
+           * the other until we find another color cell.  Then we
+           * assess the distance of both mixer colors from the
+           * intended color to determine their relative
+           * probabilities of being chosen.
+           */
+          color1 = &quantobj->cmap[pixval1];
 
-              if (quantobj->actual_number_of_colors > 2)
+          if (quantobj->actual_number_of_colors > 2)
+            {
+              const gint re = src[red_pix]   - (gint) color1->red;
+              const gint ge = src[green_pix] - (gint) color1->green;
+              const gint be = src[blue_pix]  - (gint) color1->blue;
+              gint       RV = src[red_pix]   + re;
+              gint       GV = src[green_pix] + ge;
+              gint       BV = src[blue_pix]  + be;
+
+              do
                 {
-                  const gint re = src[red_pix]   - (gint) color1->red;
-                  const gint ge = src[green_pix] - (gint) color1->green;
-                  const gint be = src[blue_pix]  - (gint) color1->blue;
-                  gint       RV = src[red_pix]   + re;
-                  gint       GV = src[green_pix] + ge;
-                  gint       BV = src[blue_pix]  + be;
-
-                  do
-                    {
-                      rgb_to_lin ((CLAMP0255(RV)),
-                                  (CLAMP0255(GV)),
-                                  (CLAMP0255(BV)),
-                                  &R, &G, &B);
-
-                      cachep = HIST_LIN (histogram, R, G, B);
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+                  rgb_to_lin ((CLAMP0255(RV)),
+                              (CLAMP0255(GV)),
+                              (CLAMP0255(BV)),
+                              &R, &G, &B);
 
-                      pixval2 = *cachep - 1;
-                      RV += re;  GV += ge;  BV += be;
-                    }
-                  while ((pixval1 == pixval2) &&
-                         (!( (RV>255 || RV<0) || (GV>255 || GV<0) || (BV>255 || BV<0) )) &&
-                         (re || ge || be));
+                  pixval2 = lookup_inverse_cmap_rgb (quantobj, R, G, B);
+                  RV += re;  GV += ge;  BV += be;
                 }
+              while ((pixval1 == pixval2) &&
+                     (!( (RV>255 || RV<0) || (GV>255 || GV<0) || (BV>255 || BV<0) )) &&
+                     (re || ge || be));
+            }
 
-              if (quantobj->actual_number_of_colors <= 2
-                  /* || pixval1 == pixval2 */) {
-                /* not enough colors to bother looking for an 'alternative'
-                   color (we may fail to do so anyway), so decide that
-                   the alternative color is simply the other cmap entry. */
-                pixval2 = (pixval1 + 1) %
-                  (quantobj->actual_number_of_colors);
-              }
+          if (quantobj->actual_number_of_colors <= 2
+              /* || pixval1 == pixval2 */) {
+            /* not enough colors to bother looking for an 'alternative'
+               color (we may fail to do so anyway), so decide that
+               the alternative color is simply the other cmap entry. */
+            pixval2 = (pixval1 + 1) %
+              (quantobj->actual_number_of_colors);
+          }
 
-              /* always deterministically sort pixval1 and pixval2, to
-                 avoid artifacts in the dither range due to inverting our
-                 relative color viewpoint -- most obvious in 1-bit dither. */
-              if (pixval1 > pixval2)
-                {
-                  gint tmpval = pixval1;
-                  pixval1 = pixval2;
-                  pixval2 = tmpval;
-                  color1 = &quantobj->cmap[pixval1];
-                }
+          /* always deterministically sort pixval1 and pixval2, to
+             avoid artifacts in the dither range due to inverting our
+             relative color viewpoint -- most obvious in 1-bit dither. */
+          if (pixval1 > pixval2)
+            {
+              gint tmpval = pixval1;
+              pixval1 = pixval2;
+              pixval2 = tmpval;
+              color1 = &quantobj->cmap[pixval1];
+            }
 
-              color2 = &quantobj->cmap[pixval2];
+          color2 = &quantobj->cmap[pixval2];
 
-              /* now figure out the relative probabilities of choosing
-                 either of our candidates. */
+          /* now figure out the relative probabilities of choosing
+             either of our candidates. */
 #define DISTP(R1,G1,B1,R2,G2,B2,D) do {D = sqrt( 30*SQR((R1)-(R2)) + \
-                                                 59*SQR((G1)-(G2)) + \
-                                                 11*SQR((B1)-(B2)) ); }while(0)
+                                             59*SQR((G1)-(G2)) + \
+                                             11*SQR((B1)-(B2)) ); }while(0)
 #define LIN_DISTP(R1,G1,B1,R2,G2,B2,D) do { \
-                int spacer1, spaceg1, spaceb1; \
-                int spacer2, spaceg2, spaceb2; \
-                rgb_to_unshifted_lin (R1,G1,B1, &spacer1, &spaceg1, &spaceb1); \
-                rgb_to_unshifted_lin (R2,G2,B2, &spacer2, &spaceg2, &spaceb2); \
-                D = sqrt(R_SCALE * SQR((spacer1)-(spacer2)) +           \
-                         G_SCALE * SQR((spaceg1)-(spaceg2)) + \
-                         B_SCALE * SQR((spaceb1)-(spaceb2))); \
-              } while(0)
-
-              /* although LIN_DISTP is more correct, DISTP is much faster and
-                 barely distinguishable. */
-              DISTP (color1->red, color1->green, color1->blue,
-                     src[red_pix], src[green_pix], src[blue_pix],
-                     err1);
-              DISTP (color2->red, color2->green, color2->blue,
-                     src[red_pix], src[green_pix], src[blue_pix],
-                     err2);
-
-              if (err1 || err2)
+            int spacer1, spaceg1, spaceb1; \
+            int spacer2, spaceg2, spaceb2; \
+            rgb_to_unshifted_lin (R1,G1,B1, &spacer1, &spaceg1, &spaceb1); \
+            rgb_to_unshifted_lin (R2,G2,B2, &spacer2, &spaceg2, &spaceb2); \
+            D = sqrt(R_SCALE * SQR((spacer1)-(spacer2)) +           \
+                     G_SCALE * SQR((spaceg1)-(spaceg2)) + \
+                     B_SCALE * SQR((spaceb1)-(spaceb2))); \
+          } while(0)
+
+          /* although LIN_DISTP is more correct, DISTP is much faster and
+             barely distinguishable. */
+          DISTP (color1->red, color1->green, color1->blue,
+                 src[red_pix], src[green_pix], src[blue_pix],
+                 err1);
+          DISTP (color2->red, color2->green, color2->blue,
+                 src[red_pix], src[green_pix], src[blue_pix],
+                 err2);
+
+          if (err1 || err2)
+            {
+              const int proportion2 = (255 * err2) / (err1 + err2);
+              if (dmval > proportion2)
                 {
-                  const int proportion2 = (255 * err2) / (err1 + err2);
-                  if (dmval > proportion2)
-                    {
-                      pixval1 = pixval2; /* use color2 instead of color1*/
-                    }
+                  pixval1 = pixval2; /* use color2 instead of color1*/
                 }
+            }
 
-              /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = pixval1]++;
+          /* Now emit the colormap index for this cell, barfbarf */
+          index_used_count[dest[INDEXED] = pixval1]++;
 
-            next_pixel:
+        next_pixel:
 
-              src  += src_bpp;
-              dest += dest_bpp;
-            }
+          src  += data->src_bpp;
+          dest += data->dest_bpp;
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-        gimp_progress_set_value (quantobj->progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
     }
 }
 
+static void
+median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
+                                   GimpLayer   *layer,
+                                   GeglBuffer  *new_buffer)
+{
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               median_cut_pass2_fixed_dither_rgb_chunk);
+}
+
 static void
 median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
                                         GimpLayer   *layer,
@@ -3762,6 +3557,114 @@ static int error_limit_16(int error_freedom, int in)
     return CLAMP(in, -192*256, 192*256);
 }
 
+/*
+ * The error diffusion passes scan the rows in alternating directions, so
+ * each row starts where the previous one ended, and needs all of the
+ * errors the previous one passed down: the rows can't overlap without
+ * changing the result.  What doesn't depend on the errors, converting
+ * the pixels to linear light and deciding their transparency, is done on
+ * worker threads, for a band of rows at a time, and only the diffusion
+ * itself runs row by row.
+ */
+
+typedef struct
+{
+  QuantizeObj  *quantobj;
+  const guchar *src_buf;
+  gint          src_bpp;
+  gint          width;
+  gint          y;
+  gboolean      has_alpha;
+  gint          red_pix;
+  gint          green_pix;
+  gint          blue_pix;
+  gint          alpha_pix;
+  gint          offsetx;
+  gint          offsety;
+  gint         *lin;          /* the pixels in linear light */
+  guchar       *transparent;  /* whether the pixels are transparent */
+} FSBandData;
+
+
+static inline gboolean
+fs_dither_is_transparent (const FSBandData *data,
+                          const guchar     *src,
+                          gint              x,
+                          gint              y)
+{
+  if (! data->has_alpha)
+    return FALSE;
+
+  if (data->quantobj->want_dither_alpha)
+    {
+      gint dither_x = (x + data->offsetx) & DM_WIDTHMASK;
+      gint dither_y = (y + data->offsety) & DM_HEIGHTMASK;
+
+      return src[data->alpha_pix] < DM[dither_x][dither_y];
+    }
+
+  return src[data->alpha_pix] <= 127;
+}
+
+static void
+fs_dither_prepare_gray (gsize       offset,
+                        gsize       size,
+                        FSBandData *data)
+{
+  gsize r;
+
+  for (r = offset; r < offset + size; r++)
+    {
+      const guchar *src         = data->src_buf + r * data->width * data->src_bpp;
+      gint         *lin         = data->lin + r * data->width;
+      guchar       *transparent = data->transparent + r * data->width;
+      gint          x;
+
+      for (x = 0; x < data->width; x++)
+        {
+          lin[x]         = gray_to_linear (src[GRAY]);
+          transparent[x] = fs_dither_is_transparent (data, src,
+                                                     x, data->y + r);
+
+          src += data->src_bpp;
+        }
+    }
+}
+
+static void
+fs_dither_prepare_rgb (gsize       offset,
+                       gsize       size,
+                       FSBandData *data)
+{
+  gsize r;
+
+  for (r = offset; r < offset + size; r++)
+    {
+      const guchar *src         = data->src_buf + r * data->width * data->src_bpp;
+      gint         *lin         = data->lin + 3 * r * data->width;
+      guchar       *transparent = data->transparent + r * data->width;
+      gint          x;
+
+      for (x = 0; x < data->width; x++)
+        {
+          transparent[x] = fs_dither_is_transparent (data, src,
+                                                     x, data->y + r);
+
+          if (! transparent[x])
+            {
+              rgb_to_linear (src[data->red_pix],
+                             src[data->green_pix],
+                             src[data->blue_pix],
+                             &lin[3 * x + 0],
+                             &lin[3 * x + 1],
+                             &lin[3 * x + 2]);
+            }
+
+          src += data->src_bpp;
+        }
+    }
+}
+
 /*
  * Map some rows of pixels to the output colormapped representation.
  * Perform floyd-steinberg dithering.
@@ -3778,6 +3681,7 @@ median_cut_pass2_fs_dither_gray (QuantizeObj *quantobj,
   Color        *color;
   const Babl   *src_format;
   const Babl   *dest_format;
+  FSBandData    band;
   gint          src_bpp;
   gint          dest_bpp;
   guchar       *src_buf, *dest_buf;
@@ -3787,20 +3691,16 @@ median_cut_pass2_fs_dither_gray (QuantizeObj *quantobj,
   gint          pixel;
   gint          pixel_lin;
   gint          pixele;
-  gint          row, col;
+  gint          y, row, col;
   gint          index;
-  gint          step_dest, step_src;
+  gint          step_dest, step;
   gint          odd_row;
   gboolean      has_alpha;
-  gint          offsetx, offsety;
-  gboolean      dither_alpha = quantobj->want_dither_alpha;
   gint          width, height;
   guint64      *index_used_count = quantobj->index_used_count;
 
   src_buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
   src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
   dest_format = gegl_buffer_get_format (new_buffer);
 
@@ -3812,93 +3712,104 @@ median_cut_pass2_fs_dither_gray (QuantizeObj *quantobj,
   width  = gimp_item_get_width  (GIMP_ITEM (layer));
   height = gimp_item_get_height (GIMP_ITEM (layer));
 
-  src_buf  = g_malloc (width * src_bpp);
-  dest_buf = g_malloc (width * dest_bpp);
+  src_buf  = g_malloc ((gsize) width * FS_BAND_HEIGHT * src_bpp);
+  dest_buf = g_malloc ((gsize) width * FS_BAND_HEIGHT * dest_bpp);
+
+  band.quantobj    = quantobj;
+  band.src_buf     = src_buf;
+  band.src_bpp     = src_bpp;
+  band.width       = width;
+  band.has_alpha   = has_alpha;
+  band.red_pix     = band.green_pix = band.blue_pix = GRAY;
+  band.alpha_pix   = ALPHA_G;
+  band.lin         = g_new (gint, (gsize) width * FS_BAND_HEIGHT);
+  band.transparent = g_new (guchar, (gsize) width * FS_BAND_HEIGHT);
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &band.offsetx, &band.offsety);
 
   next_row = g_new (gint, width + 2);
   prev_row = g_new0 (gint, width + 2);
 
   odd_row = 0;
 
-  for (row = 0; row < height; row++)
+  for (y = 0; y < height; y += FS_BAND_HEIGHT)
     {
-      const guchar *src;
-      guchar       *dest;
+      gint band_height = MIN (FS_BAND_HEIGHT, height - y);
 
-      gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, row, width, 1),
+      gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, y, width, band_height),
                        1.0, NULL, src_buf,
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-      src  = src_buf;
-      dest = dest_buf;
+      band.y = y;
 
-      nr = next_row;
-      pr = prev_row + 1;
+      gegl_parallel_distribute_range (
+        band_height, PIXELS_PER_THREAD / width,
+        (GeglParallelDistributeRangeFunc) fs_dither_prepare_gray,
+        &band);
 
-      if (odd_row)
+      for (row = 0; row < band_height; row++)
         {
-          step_dest = -dest_bpp;
-          step_src  = -src_bpp;
+          const gint   *lin         = band.lin + (gsize) row * width;
+          const guchar *transparent = band.transparent + (gsize) row * width;
+          guchar       *dest        = dest_buf + (gsize) row * width * dest_bpp;
 
-          src  += (width * src_bpp) - src_bpp;
-          dest += (width * dest_bpp) - dest_bpp;
+          nr = next_row;
+          pr = prev_row + 1;
 
-          nr += width + 1;
-          pr += width;
+          if (odd_row)
+            {
+              step_dest = -dest_bpp;
+              step      = -1;
 
-          *(nr - 1) = 0;
-        }
-      else
-        {
-          step_dest = dest_bpp;
-          step_src  = src_bpp;
+              lin         += width - 1;
+              transparent += width - 1;
+              dest        += (width * dest_bpp) - dest_bpp;
 
-          *(nr + 1) = 0;
-        }
+              nr += width + 1;
+              pr += width;
+
+              *(nr - 1) = 0;
+            }
+          else
+            {
+              step_dest = dest_bpp;
+              step      = 1;
 
-      *nr = 0;
+              *(nr + 1) = 0;
+            }
 
-      for (col = 0; col < width; col++)
-        {
-          pixel_lin = gray_to_linear(src[GRAY]) + error_limit_16(quantobj->error_freedom, *pr);
+          *nr = 0;
 
-          pixel_lin = CLAMP(pixel_lin, 0, 65535);
+          for (col = 0; col < width; col++)
+            {
+              pixel_lin = *lin + error_limit_16(quantobj->error_freedom, *pr);
 
-          pixel = linear_to_u8 (pixel_lin);
+              pixel_lin = CLAMP(pixel_lin, 0, 65535);
 
-          cachep = &histogram[pixel];
-          /* If we have not seen this color before, find nearest
-           * colormap entry and update the cache
-           */
-          if (*cachep == 0)
-            fill_inverse_cmap_gray (quantobj, histogram, pixel);
+              pixel = linear_to_u8 (pixel_lin);
 
-          if (has_alpha)
-            {
-              gboolean transparent = FALSE;
+              /* the cache has been filled by median_cut_pass2_gray_init() */
+              cachep = &histogram[pixel];
 
-              if (odd_row)
+              if (has_alpha)
                 {
-                  if (dither_alpha)
+                  if (*transparent)
                     {
-                      gint dither_x = ((width-col)+offsetx-1) & DM_WIDTHMASK;
-                      gint dither_y = (row+offsety) & DM_HEIGHTMASK;
+                      dest[ALPHA_I] = 0;
 
-                      if ((src[ALPHA_G]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[ALPHA_G] <= 127)
-                        transparent = TRUE;
-                    }
+                      if (odd_row)
+                        {
+                          pr--;
+                          nr--;
+                          *(nr - 1) = 0;
+                        }
+                      else
+                        {
+                          pr++;
+                          nr++;
+                          *(nr + 1) = 0;
+                        }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      pr--;
-                      nr--;
-                      *(nr - 1) = 0;
                       goto next_pixel;
                     }
                   else
@@ -3906,77 +3817,55 @@ median_cut_pass2_fs_dither_gray (QuantizeObj *quantobj,
                       dest[ALPHA_I] = 255;
                     }
                 }
-              else
-                {
-                  if (dither_alpha)
-                    {
-                      gint dither_x = (col + offsetx) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety) & DM_HEIGHTMASK;
 
-                      if ((src[ALPHA_G]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[ALPHA_G] <= 127)
-                        transparent = TRUE;
-                    }
+              index = *cachep - 1;
+              index_used_count[dest[INDEXED] = index]++;
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      pr++;
-                      nr++;
-                      *(nr + 1) = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
-                }
-            }
+              color = &quantobj->clin[index];
+              pixele = pixel_lin - color->red;
 
-          index = *cachep - 1;
-          index_used_count[dest[INDEXED] = index]++;
+              if (odd_row)
+                {
+                  *(--pr) += (7 * pixele)>>4;
+                  *nr-- += (3 * pixele)>>4;
+                  *nr += (5 * pixele)>>4;
+                  *(nr-1) = (1*pixele)>>4;
+                }
+              else
+                {
+                  *(++pr) += (7 * pixele)>>4;
+                  *nr++ += (3 * pixele)>>4;
+                  *nr += (5 * pixele)>>4;
+                  *(nr+1) = (1*pixele)>>4;
+                }
 
-          color = &quantobj->clin[index];
-          pixele = pixel_lin - color->red;
+            next_pixel:
 
-          if (odd_row)
-            {
-              *(--pr) += (7 * pixele)>>4;
-              *nr-- += (3 * pixele)>>4;
-              *nr += (5 * pixele)>>4;
-              *(nr-1) = (1*pixele)>>4;
-            }
-          else
-            {
-              *(++pr) += (7 * pixele)>>4;
-              *nr++ += (3 * pixele)>>4;
-              *nr += (5 * pixele)>>4;
-              *(nr+1) = (1*pixele)>>4;
+              dest        += step_dest;
+              lin         += step;
+              transparent += step;
             }
 
-        next_pixel:
+          tmp = next_row;
+          next_row = prev_row;
+          prev_row = tmp;
 
-          dest += step_dest;
-          src += step_src;
+          odd_row = !odd_row;
         }
 
-      tmp = next_row;
-      next_row = prev_row;
-      prev_row = tmp;
-
-      odd_row = !odd_row;
-
-      gegl_buffer_set (new_buffer, GEGL_RECTANGLE (0, row, width, 1),
+      gegl_buffer_set (new_buffer, GEGL_RECTANGLE (0, y, width, band_height),
                        0, NULL, dest_buf,
                        GEGL_AUTO_ROWSTRIDE);
+
+      if (quantobj->progress)
+        gimp_progress_set_value (quantobj->progress,
+                                 (gdouble) (y + band_height) / (gdouble) height);
     }
 
   g_free (next_row);
   g_free (prev_row);
+  g_free (band.lin);
+  g_free (band.transparent);
   g_free (src_buf);
   g_free (dest_buf);
 }
@@ -3986,7 +3875,14 @@ median_cut_pass2_rgb_init (QuantizeObj *quantobj)
 {
   int i;
 
-  zero_histogram_rgb (quantobj->histogram);
+  /* The histogram isn't needed anymore, the inverse colormap takes its
+   * place.
+   */
+  g_clear_pointer (&quantobj->histogram, g_free);
+
+  g_free (quantobj->inverse_cmap);
+  quantobj->inverse_cmap = g_new0 (gint,
+                                   HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS);
 
   /* Mark all indices as currently unused */
   memset (quantobj->index_used_count, 0, 256 * sizeof (guint64));
@@ -4001,6 +3897,9 @@ median_cut_pass2_rgb_init (QuantizeObj *quantobj)
                             &quantobj->clab[i].green,
                             &quantobj->clab[i].blue);
     }
+  /* .. and index it for the nearest color searches */
+  init_color_tree (quantobj);
+
   /* Make a version of our discovered colormap in linear space */
   for (i = 0; i < quantobj->actual_number_of_colors; i++)
     {
@@ -4030,6 +3929,12 @@ median_cut_pass2_gray_init (QuantizeObj *quantobj)
                             &quantobj->clin[i].green,
                             &quantobj->clin[i].blue);
     }
+
+  /* The gray inverse colormap is small enough to be filled up front,
+   * so the mapping passes only have to read it.
+   */
+  for (int i = 0; i < 256; i++)
+    fill_inverse_cmap_gray (quantobj, quantobj->histogram, i);
 }
 
 
@@ -4039,11 +3944,10 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
                                 GeglBuffer  *new_buffer)
 {
   GeglBuffer   *src_buffer;
-  CFHistogram   histogram = quantobj->histogram;
-  ColorFreq    *cachep;
   Color        *linearcolor;
   const Babl   *src_format;
   const Babl   *dest_format;
+  FSBandData    band;
   gint          src_bpp;
   gint          dest_bpp;
   guchar       *src_buf, *dest_buf;
@@ -4055,18 +3959,12 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   gint         *bnr, *bpr;
   gint         *tmp;
   gint          re, ge, be;
-  gint          row, col;
+  gint          y, row, col;
   gint          index;
-  gint          step_dest, step_src;
+  gint          step_dest, step;
   gint          odd_row;
   gboolean      has_alpha;
   gint          width, height;
-  gint          red_pix   = RED;
-  gint          green_pix = GREEN;
-  gint          blue_pix  = BLUE;
-  gint          alpha_pix = ALPHA;
-  gint          offsetx, offsety;
-  gboolean      dither_alpha     = quantobj->want_dither_alpha;
   guint64      *index_used_count = quantobj->index_used_count;
   gint          global_rmax = 0, global_rmin = G_MAXINT;
   gint          global_gmax = 0, global_gmin = G_MAXINT;
@@ -4074,14 +3972,6 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
 
   src_buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
-    red_pix = green_pix = blue_pix = GRAY;
-
   src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
   dest_format = gegl_buffer_get_format (new_buffer);
 
@@ -4107,8 +3997,34 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
       global_bmin = MIN(global_bmin, quantobj->clin[index].blue);
     }
 
-  src_buf  = g_malloc (width * src_bpp);
-  dest_buf = g_malloc (width * dest_bpp);
+  src_buf  = g_malloc ((gsize) width * FS_BAND_HEIGHT * src_bpp);
+  dest_buf = g_malloc ((gsize) width * FS_BAND_HEIGHT * dest_bpp);
+
+  band.quantobj    = quantobj;
+  band.src_buf     = src_buf;
+  band.src_bpp     = src_bpp;
+  band.width       = width;
+  band.has_alpha   = has_alpha;
+  band.lin         = g_new (gint, (gsize) 3 * width * FS_BAND_HEIGHT);
+  band.transparent = g_new (guchar, (gsize) width * FS_BAND_HEIGHT);
+
+  /*  In the case of web/mono palettes, we actually force
+   *   grayscale drawables through the rgb pass2 functions
+   */
+  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
+    {
+      band.red_pix   = band.green_pix = band.blue_pix = GRAY;
+      band.alpha_pix = ALPHA_G;
+    }
+  else
+    {
+      band.red_pix   = RED;
+      band.green_pix = GREEN;
+      band.blue_pix  = BLUE;
+      band.alpha_pix = ALPHA;
+    }
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &band.offsetx, &band.offsety);
 
   red_n_row = g_new (gint, width + 2);
   red_p_row = g_new0 (gint, width + 2);
@@ -4119,109 +4035,83 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
 
   odd_row = 0;
 
-  for (row = 0; row < height; row++)
+  for (y = 0; y < height; y += FS_BAND_HEIGHT)
     {
-      const guchar *src;
-      guchar       *dest;
+      gint band_height = MIN (FS_BAND_HEIGHT, height - y);
 
-      gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, row, width, 1),
+      gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, y, width, band_height),
                        1.0, NULL, src_buf,
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-      src  = src_buf;
-      dest = dest_buf;
+      band.y = y;
 
-      rnr = red_n_row;
-      gnr = grn_n_row;
-      bnr = blu_n_row;
-      rpr = red_p_row + 1;
-      gpr = grn_p_row + 1;
-      bpr = blu_p_row + 1;
+      gegl_parallel_distribute_range (
+        band_height, PIXELS_PER_THREAD / width,
+        (GeglParallelDistributeRangeFunc) fs_dither_prepare_rgb,
+        &band);
 
-      if (odd_row)
+      for (row = 0; row < band_height; row++)
         {
-          step_dest = -dest_bpp;
-          step_src  = -src_bpp;
+          const gint   *lin         = band.lin + (gsize) 3 * row * width;
+          const guchar *transparent = band.transparent + (gsize) row * width;
+          guchar       *dest        = dest_buf + (gsize) row * width * dest_bpp;
 
-          src += (width * src_bpp) - src_bpp;
-          dest += (width * dest_bpp) - dest_bpp;
+          rnr = red_n_row;
+          gnr = grn_n_row;
+          bnr = blu_n_row;
+          rpr = red_p_row + 1;
+          gpr = grn_p_row + 1;
+          bpr = blu_p_row + 1;
 
-          rnr += width + 1;
-          gnr += width + 1;
-          bnr += width + 1;
-          rpr += width;
-          gpr += width;
-          bpr += width;
-
-          *(rnr - 1) = *(gnr - 1) = *(bnr - 1) = 0;
-        }
-      else
-        {
-          step_dest = dest_bpp;
-          step_src  = src_bpp;
+          if (odd_row)
+            {
+              step_dest = -dest_bpp;
+              step      = -1;
 
-          *(rnr + 1) = *(gnr + 1) = *(bnr + 1) = 0;
-        }
+              lin         += 3 * (width - 1);
+              transparent += width - 1;
+              dest        += (width * dest_bpp) - dest_bpp;
 
-      *rnr = *gnr = *bnr = 0;
+              rnr += width + 1;
+              gnr += width + 1;
+              bnr += width + 1;
+              rpr += width;
+              gpr += width;
+              bpr += width;
 
-      for (col = 0; col < width; col++)
-        {
-          if (has_alpha)
+              *(rnr - 1) = *(gnr - 1) = *(bnr - 1) = 0;
+            }
+          else
             {
-              gboolean transparent = FALSE;
+              step_dest = dest_bpp;
+              step      = 1;
 
-              if (odd_row)
-                {
-                  if (dither_alpha)
-                    {
-                      gint dither_x = ((width-col)+offsetx-1) & DM_WIDTHMASK;
-                      gint dither_y = (row+offsety) & DM_HEIGHTMASK;
+              *(rnr + 1) = *(gnr + 1) = *(bnr + 1) = 0;
+            }
 
-                      if ((src[alpha_pix]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
+          *rnr = *gnr = *bnr = 0;
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      rpr--; gpr--; bpr--;
-                      rnr--; gnr--; bnr--;
-                      *(rnr - 1) = *(gnr - 1) = *(bnr - 1) = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
-                }
-              else
+          for (col = 0; col < width; col++)
+            {
+              if (has_alpha)
                 {
-                  if (dither_alpha)
+                  if (*transparent)
                     {
-                      gint dither_x = (col + offsetx) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety) & DM_HEIGHTMASK;
+                      dest[ALPHA_I] = 0;
 
-                      if ((src[alpha_pix]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
+                      if (odd_row)
+                        {
+                          rpr--; gpr--; bpr--;
+                          rnr--; gnr--; bnr--;
+                          *(rnr - 1) = *(gnr - 1) = *(bnr - 1) = 0;
+                        }
+                      else
+                        {
+                          rpr++; gpr++; bpr++;
+                          rnr++; gnr++; bnr++;
+                          *(rnr + 1) = *(gnr + 1) = *(bnr + 1) = 0;
+                        }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      rpr++; gpr++; bpr++;
-                      rnr++; gnr++; bnr++;
-                      *(rnr + 1) = *(gnr + 1) = *(bnr + 1) = 0;
                       goto next_pixel;
                     }
                   else
@@ -4229,120 +4119,109 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
                       dest[ALPHA_I] = 255;
                     }
                 }
-            }
 
-          rgb_to_linear (src[red_pix], src[green_pix], src[blue_pix],
-                         &re, &ge, &be);
+              *rpr = error_limit_16 (quantobj->error_freedom, *rpr);
+              *gpr = error_limit_16 (quantobj->error_freedom, *gpr);
+              *bpr = error_limit_16 (quantobj->error_freedom, *bpr);
 
-          *rpr = error_limit_16 (quantobj->error_freedom, *rpr);
-          *gpr = error_limit_16 (quantobj->error_freedom, *gpr);
-          *bpr = error_limit_16 (quantobj->error_freedom, *bpr);
+              re = lin[0] + *rpr;
+              ge = lin[1] + *gpr;
+              be = lin[2] + *bpr;
 
-          re = re + *rpr;
-          ge = ge + *gpr;
-          be = be + *bpr;
+              // in theory we should only do this before the look-up
+              // comments in the source indicates that error running
+              // away from gamut looks icky - for now trust that
+              re = CLAMP(re, global_rmin, global_rmax);
+              ge = CLAMP(ge, global_gmin, global_gmax);
+              be = CLAMP(be, global_bmin, global_bmax);
 
-          // in theory we should only do this before the look-up
-          // comments in the source indicates that error running
-          // away from gamut looks icky - for now trust that
-          re = CLAMP(re, global_rmin, global_rmax);
-          ge = CLAMP(ge, global_gmin, global_gmax);
-          be = CLAMP(be, global_bmin, global_bmax);
-
-          {
-            guint16 rgb16[3]={re,ge,be};
-            float rgbF[3];
-            gint lab8[3];
-            babl_process (linear_to_rgb_float_fish, rgb16, rgbF, 1);
-            rgb_to_unshifted_lin(rgbF[0]*255,rgbF[1]*255,rgbF[2]*255, &lab8[0], &lab8[1], &lab8[2]);
-            cachep = HIST_LIN (histogram,
-                               RSDF (lab8[0]),
-                               GSDF (lab8[1]),
-                               BSDF (lab8[2]));
-            /* If we have not seen this color before, find nearest
-             * colormap entry and update the cache
-             */
-            if (*cachep == 0)
-              fill_inverse_cmap_rgb (quantobj, histogram,
-                                     RSDF (lab8[0]),
-                                     GSDF (lab8[1]),
-                                     BSDF (lab8[2]));
-          }
+              {
+                guint16 rgb16[3]={re,ge,be};
+                float rgbF[3];
+                gint lab8[3];
+                babl_process (linear_to_rgb_float_fish, rgb16, rgbF, 1);
+                rgb_to_unshifted_lin(rgbF[0]*255,rgbF[1]*255,rgbF[2]*255, &lab8[0], &lab8[1], &lab8[2]);
+                index = lookup_inverse_cmap_rgb (quantobj,
+                                                 RSDF (lab8[0]),
+                                                 GSDF (lab8[1]),
+                                                 BSDF (lab8[2]));
+              }
 
-          index = *cachep - 1;
-          index_used_count[index]++;
-          dest[INDEXED] = index;
+              index_used_count[index]++;
+              dest[INDEXED] = index;
 
-          linearcolor = &quantobj->clin[index];
+              linearcolor = &quantobj->clin[index];
 
-           re = re - linearcolor->red;
-           ge = ge - linearcolor->green;
-           be = be - linearcolor->blue;
+              re = re - linearcolor->red;
+              ge = ge - linearcolor->green;
+              be = be - linearcolor->blue;
 
-          if (odd_row)
-            {
-              *(--rpr) += (7 * re)>>4;
-              *(--gpr) += (7 * ge)>>4;
-              *(--bpr) += (7 * be)>>4;
+              if (odd_row)
+                {
+                  *(--rpr) += (7 * re)>>4;
+                  *(--gpr) += (7 * ge)>>4;
+                  *(--bpr) += (7 * be)>>4;
 
-              *rnr-- += (3 * re)>>4;
-              *gnr-- += (3 * ge)>>4;
-              *bnr-- += (3 * be)>>4;
+                  *rnr-- += (3 * re)>>4;
+                  *gnr-- += (3 * ge)>>4;
+                  *bnr-- += (3 * be)>>4;
 
-              *rnr += (5 * re)>>4;
-              *gnr += (5 * ge)>>4;
-              *bnr += (5 * be)>>4;
+                  *rnr += (5 * re)>>4;
+                  *gnr += (5 * ge)>>4;
+                  *bnr += (5 * be)>>4;
 
-              *(rnr-1) = (1 * re)>>4;
-              *(gnr-1) = (1 * ge)>>4;
-              *(bnr-1) = (1 * be)>>4;
-            }
-          else
-            {
-              *(++rpr) += (7 * re)>>4;
-              *(++gpr) += (7 * ge)>>4;
-              *(++bpr) += (7 * be)>>4;
+                  *(rnr-1) = (1 * re)>>4;
+                  *(gnr-1) = (1 * ge)>>4;
+                  *(bnr-1) = (1 * be)>>4;
+                }
+              else
+                {
+                  *(++rpr) += (7 * re)>>4;
+                  *(++gpr) += (7 * ge)>>4;
+                  *(++bpr) += (7 * be)>>4;
 
-              *rnr++ += (3 * re)>>4;
-              *gnr++ += (3 * ge)>>4;
-              *bnr++ += (3 * be)>>4;
+                  *rnr++ += (3 * re)>>4;
+                  *gnr++ += (3 * ge)>>4;
+                  *bnr++ += (3 * be)>>4;
 
-              *rnr += (5 * re)>>4;
-              *gnr += (5 * ge)>>4;
-              *bnr += (5 * be)>>4;
+                  *rnr += (5 * re)>>4;
+                  *gnr += (5 * ge)>>4;
+                  *bnr += (5 * be)>>4;
 
-              *(rnr+1) = (1 * re)>>4;
-              *(gnr+1) = (1 * ge)>>4;
-              *(bnr+1) = (1 * be)>>4;
-            }
+                  *(rnr+1) = (1 * re)>>4;
+                  *(gnr+1) = (1 * ge)>>4;
+                  *(bnr+1) = (1 * be)>>4;
+                }
 
-        next_pixel:
+            next_pixel:
 
-          dest += step_dest;
-          src += step_src;
-        }
+              dest        += step_dest;
+              lin         += 3 * step;
+              transparent += step;
+            }
 
-      tmp = red_n_row;
-      red_n_row = red_p_row;
-      red_p_row = tmp;
+          tmp = red_n_row;
+          red_n_row = red_p_row;
+          red_p_row = tmp;
 
-      tmp = grn_n_row;
-      grn_n_row = grn_p_row;
-      grn_p_row = tmp;
+          tmp = grn_n_row;
+          grn_n_row = grn_p_row;
+          grn_p_row = tmp;
 
-      tmp = blu_n_row;
-      blu_n_row = blu_p_row;
-      blu_p_row = tmp;
+          tmp = blu_n_row;
+          blu_n_row = blu_p_row;
+          blu_p_row = tmp;
 
-      odd_row = !odd_row;
+          odd_row = !odd_row;
+        }
 
-      gegl_buffer_set (new_buffer, GEGL_RECTANGLE (0, row, width, 1),
+      gegl_buffer_set (new_buffer, GEGL_RECTANGLE (0, y, width, band_height),
                        0, NULL, dest_buf,
                        GEGL_AUTO_ROWSTRIDE);
 
-      if (quantobj->progress && (row % 16 == 0))
+      if (quantobj->progress)
         gimp_progress_set_value (quantobj->progress,
-                                 (gdouble) row / (gdouble) height);
+                                 (gdouble) (y + band_height) / (gdouble) height);
     }
 
   g_free (red_n_row);
@@ -4351,6 +4230,8 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   g_free (grn_p_row);
   g_free (blu_n_row);
   g_free (blu_p_row);
+  g_free (band.lin);
+  g_free (band.transparent);
   g_free (src_buf);
   g_free (dest_buf);
 }
@@ -4360,6 +4241,7 @@ static void
 delete_median_cut (QuantizeObj *quantobj)
 {
   g_free (quantobj->histogram);
+  g_free (quantobj->inverse_cmap);
   g_free (quantobj);
 }
 
@@ -84,7 +84,7 @@ struct _GimpImagePrivate
   GFile             *save_a_copy_file;      /*  the image's save-a-copy file */
   GFile             *untitled_file;         /*  a file saying "Untitled"     */
 
-  gboolean           xcf_compression;       /*  XCF compression enabled?     */
+  GimpXcfCompression xcf_compression;       /*  XCF compression method       */
 
   gint               dirty;                 /*  dirty flag -- # of ops       */
   gint64             dirty_time;            /*  time when image became dirty */
@@ -100,6 +100,8 @@ struct _GimpImagePrivate
   GimpProjection    *projection;            /*  projection layers & channels */
   GeglNode          *graph;                 /*  GEGL projection graph        */
   GeglNode          *visible_mask;          /*  component visibility node    */
+  gboolean           render_cache;          /*  cache below the edited layer */
+  GList             *render_cache_stacks;   /*  the stacks holding caches    */
 
   GList             *symmetries;            /*  Painting symmetries          */
   GimpSymmetry      *active_symmetry;       /*  Active symmetry              */
@@ -142,6 +144,7 @@ struct _GimpImagePrivate
   /*  Undo apparatus  */
   GimpUndoStack     *undo_stack;            /*  stack for undo operations    */
   GimpUndoStack     *redo_stack;            /*  stack for redo operations    */
+  GimpUndoJournal   *undo_journal;          /*  evicted undo payloads        */
   gint               group_count;           /*  nested undo groups           */
   GimpUndoType       pushing_undo_group;    /*  undo group status flag       */
 
@@ -20,6 +20,8 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
+#include "libgimpconfig/gimpconfig.h"
+
 #include "core-types.h"
 
 #include "config/gimpcoreconfig.h"
@@ -31,16 +33,18 @@
 #include "gimpimage-undo.h"
 #include "gimpitem.h"
 #include "gimplist.h"
+#include "gimpundojournal.h"
 #include "gimpundostack.h"
 
 
 /*  local function prototypes  */
 
-static void          gimp_image_undo_pop_stack       (GimpImage     *image,
+static gboolean      gimp_image_undo_pop_stack       (GimpImage     *image,
                                                       GimpUndoStack *undo_stack,
                                                       GimpUndoStack *redo_stack,
                                                       GimpUndoMode   undo_mode);
 static void          gimp_image_undo_free_space      (GimpImage     *image);
+static gboolean      gimp_image_undo_evict           (GimpImage     *image);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
@@ -123,12 +127,10 @@ gimp_image_undo (GimpImage *image)
   g_return_val_if_fail (private->pushing_undo_group == GIMP_UNDO_GROUP_NONE,
                         FALSE);
 
-  gimp_image_undo_pop_stack (image,
-                             private->undo_stack,
-                             private->redo_stack,
-                             GIMP_UNDO_MODE_UNDO);
-
-  return TRUE;
+  return gimp_image_undo_pop_stack (image,
+                                    private->undo_stack,
+                                    private->redo_stack,
+                                    GIMP_UNDO_MODE_UNDO);
 }
 
 gboolean
@@ -143,12 +145,10 @@ gimp_image_redo (GimpImage *image)
   g_return_val_if_fail (private->pushing_undo_group == GIMP_UNDO_GROUP_NONE,
                         FALSE);
 
-  gimp_image_undo_pop_stack (image,
-                             private->redo_stack,
-                             private->undo_stack,
-                             GIMP_UNDO_MODE_REDO);
-
-  return TRUE;
+  return gimp_image_undo_pop_stack (image,
+                                    private->redo_stack,
+                                    private->undo_stack,
+                                    GIMP_UNDO_MODE_REDO);
 }
 
 /*
@@ -463,20 +463,53 @@ gimp_image_undo_can_compress (GimpImage    *image,
 
 /*  private functions  */
 
-static void
+/* pops the top undo of @undo_stack onto @redo_stack.  if any part of
+ * it fails, the parts which were popped are reverted, the undo stays on
+ * @undo_stack, so it can be tried again, and FALSE is returned.
+ */
+static gboolean
 gimp_image_undo_pop_stack (GimpImage     *image,
                            GimpUndoStack *undo_stack,
                            GimpUndoStack *redo_stack,
                            GimpUndoMode   undo_mode)
 {
   GimpUndo            *undo;
-  GimpUndoAccumulator  accum = { 0, };
+  GimpUndoAccumulator  accum   = { 0, };
+  gboolean             success = TRUE;
 
   g_object_freeze_notify (G_OBJECT (image));
 
   undo = gimp_undo_stack_pop_undo (undo_stack, undo_mode, &accum);
 
-  if (undo)
+  if (undo && accum.error)
+    {
+      GError *error = accum.error;
+
+      accum.error = NULL;
+
+      /*  the failed undo ignores this, the others are swapped back  */
+      if (GIMP_IS_UNDO_STACK (undo))
+        gimp_list_reverse (GIMP_LIST (GIMP_UNDO_STACK (undo)->undos));
+
+      gimp_undo_pop (undo,
+                     undo_mode == GIMP_UNDO_MODE_UNDO ?
+                     GIMP_UNDO_MODE_REDO : GIMP_UNDO_MODE_UNDO,
+                     &accum);
+
+      if (GIMP_IS_UNDO_STACK (undo))
+        gimp_list_reverse (GIMP_LIST (GIMP_UNDO_STACK (undo)->undos));
+
+      gimp_undo_stack_push_undo (undo_stack, undo);
+
+      gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            error->message);
+
+      g_clear_error (&error);
+      g_clear_error (&accum.error);
+
+      success = FALSE;
+    }
+  else if (undo)
     {
       if (GIMP_IS_UNDO_STACK (undo))
         gimp_list_reverse (GIMP_LIST (GIMP_UNDO_STACK (undo)->undos));
@@ -510,6 +543,8 @@ gimp_image_undo_pop_stack (GimpImage     *image,
     }
 
   g_object_thaw_notify (G_OBJECT (image));
+
+  return success;
 }
 
 static void
@@ -533,6 +568,20 @@ gimp_image_undo_free_space (GimpImage *image)
               (glong) gimp_object_get_memsize (GIMP_OBJECT (container), NULL));
 #endif
 
+  /*  first move the pixels of the oldest steps to the undo journal,
+   *  and only free steps if that isn't enough
+   */
+  while (gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size &&
+         gimp_image_undo_evict (image))
+    {
+#ifdef DEBUG_IMAGE_UNDO
+      g_printerr ("evicted one step: undo_steps: %d    undo_bytes: %ld\n",
+                  gimp_container_get_n_children (container),
+                  (glong) gimp_object_get_memsize (GIMP_OBJECT (container),
+                                                   NULL));
+#endif
+    }
+
   /*  keep at least min_undo_levels undo steps  */
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
@@ -559,6 +608,57 @@ gimp_image_undo_free_space (GimpImage *image)
     }
 }
 
+/* evicts the oldest undo step which still holds pixels in memory,
+ * except for the newest one, which is the most likely to be undone.
+ */
+static gboolean
+gimp_image_undo_evict (GimpImage *image)
+{
+  GimpImagePrivate *private   = GIMP_IMAGE_GET_PRIVATE (image);
+  GimpContainer    *container = private->undo_stack->undos;
+  GList            *list;
+
+  if (! private->undo_journal)
+    {
+      GimpGeglConfig *config = GIMP_GEGL_CONFIG (image->gimp->config);
+      GFile          *directory;
+      GError         *error  = NULL;
+
+      if (! config->swap_path)
+        return FALSE;
+
+      directory = gimp_file_new_for_config_path (config->swap_path, NULL);
+
+      if (! directory)
+        return FALSE;
+
+      private->undo_journal = gimp_undo_journal_new (directory, &error);
+
+      g_object_unref (directory);
+
+      if (! private->undo_journal)
+        {
+          if (image->gimp->be_verbose)
+            g_printerr ("Could not create undo journal: %s\n",
+                        error->message);
+
+          g_clear_error (&error);
+
+          return FALSE;
+        }
+    }
+
+  for (list = GIMP_LIST (container)->queue->tail;
+       list && list != GIMP_LIST (container)->queue->head;
+       list = g_list_previous (list))
+    {
+      if (gimp_undo_evict (list->data, private->undo_journal) > 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 static void
 gimp_image_undo_free_redo (GimpImage *image)
 {
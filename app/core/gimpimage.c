@@ -83,6 +83,7 @@
 #include "gimpsymmetry.h"
 #include "gimptempbuf.h"
 #include "gimptemplate.h"
+#include "gimpundojournal.h"
 #include "gimpundostack.h"
 
 #include "text/gimptextlayer.h"
@@ -224,6 +225,13 @@ static GeglRectangle gimp_image_get_bounding_box (GimpProjectable   *projectable
 static GeglNode   * gimp_image_get_graph         (GimpProjectable   *projectable);
 static GimpImage  * gimp_image_get_image         (GimpProjectable   *projectable);
 static const Babl * gimp_image_get_proj_format   (GimpProjectable   *projectable);
+static void         gimp_image_set_render_cache  (GimpProjectable   *projectable,
+                                                  gboolean           enable);
+static gboolean     gimp_image_get_render_cache  (GimpProjectable   *projectable);
+static void     gimp_image_update_render_cache   (GimpImage         *image);
+static void     gimp_image_render_cache_notify   (GimpCoreConfig    *config,
+                                                  const GParamSpec  *pspec,
+                                                  GimpImage         *image);
 
 static void         gimp_image_pickable_flush    (GimpPickable      *pickable);
 static GeglBuffer * gimp_image_get_buffer        (GimpPickable      *pickable);
@@ -723,6 +731,8 @@ gimp_projectable_iface_init (GimpProjectableInterface *iface)
   iface->get_bounding_box   = gimp_image_get_bounding_box;
   iface->get_graph          = gimp_image_get_graph;
   iface->invalidate_preview = (void (*) (GimpProjectable*)) gimp_viewable_invalidate_preview;
+  iface->set_render_cache   = gimp_image_set_render_cache;
+  iface->get_render_cache   = gimp_image_get_render_cache;
 }
 
 static void
@@ -788,6 +798,7 @@ gimp_image_init (GimpImage *image)
   private->tattoo_state        = 0;
 
   private->projection          = gimp_projection_new (GIMP_PROJECTABLE (image));
+  private->render_cache        = FALSE;
 
   private->symmetries          = NULL;
   private->active_symmetry     = NULL;
@@ -958,6 +969,15 @@ gimp_image_constructed (GObject *object)
                            G_CALLBACK (gimp_viewable_size_changed),
                            image, G_CONNECT_SWAPPED);
 
+  private->render_cache = config->render_cache;
+
+  g_signal_connect_object (config, "notify::render-cache",
+                           G_CALLBACK (gimp_image_render_cache_notify),
+                           image, 0);
+  g_signal_connect_object (config, "notify::tile-cache-size",
+                           G_CALLBACK (gimp_image_render_cache_notify),
+                           image, 0);
+
   gimp_container_add (image->gimp->images, GIMP_OBJECT (image));
 }
 
@@ -1142,6 +1162,9 @@ gimp_image_dispose (GObject *object)
                                         gimp_image_channel_remove,
                                         image);
 
+  private->render_cache = FALSE;
+  gimp_image_update_render_cache (image);
+
   g_object_run_dispose (G_OBJECT (private->layers));
   g_object_run_dispose (G_OBJECT (private->channels));
   g_object_run_dispose (G_OBJECT (private->paths));
@@ -1209,6 +1232,7 @@ gimp_image_finalize (GObject *object)
 
   g_clear_object (&private->undo_stack);
   g_clear_object (&private->redo_stack);
+  g_clear_pointer (&private->undo_journal, gimp_undo_journal_unref);
 
   if (image->gimp && image->gimp->image_table)
     {
@@ -1725,6 +1749,110 @@ gimp_image_get_graph (GimpProjectable *projectable)
   return private->graph;
 }
 
+static void
+gimp_image_set_render_cache (GimpProjectable *projectable,
+                             gboolean         enable)
+{
+  GimpImage        *image   = GIMP_IMAGE (projectable);
+  GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  if (enable != private->render_cache)
+    {
+      private->render_cache = enable;
+
+      gimp_image_update_render_cache (image);
+    }
+}
+
+static gboolean
+gimp_image_get_render_cache (GimpProjectable *projectable)
+{
+  return GIMP_IMAGE_GET_PRIVATE (projectable)->render_cache;
+}
+
+/*  caches the composite below the first selected layer, in its own
+ *  stack and in the stacks of all its parent groups, so that editing
+ *  the layer only recomposites the layers above it.  each group's
+ *  result is cached too, as part of the composite below the next
+ *  layer above it.
+ *
+ *  the caches are kept while no layer is selected, e.g. while a channel
+ *  or the selection mask is edited.  the innermost stacks are cached
+ *  first, for as long as the caches fit in a quarter of the tile cache.
+ */
+static void
+gimp_image_update_render_cache (GimpImage *image)
+{
+  GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+  GList            *stacks  = NULL;
+  GList            *list;
+
+  if (private->render_cache)
+    {
+      GList    *layers = gimp_image_get_selected_layers (image);
+      GimpItem *item;
+      guint64   budget;
+
+      if (! layers)
+        return;
+
+      budget = GIMP_GEGL_CONFIG (image->gimp->config)->tile_cache_size / 4;
+
+      for (item = layers->data; item; item = gimp_item_get_parent (item))
+        {
+          GimpContainer *container = gimp_item_get_container (item);
+          GimpItem      *parent    = gimp_item_get_parent (item);
+          guint64        size;
+
+          if (! GIMP_IS_FILTER_STACK (container))
+            continue;
+
+          /*  the composite is cached in float, and doesn't exceed the
+           *  bounds of the group, or of the image
+           */
+          if (parent)
+            size = (guint64) gimp_item_get_width  (parent) *
+                   (guint64) gimp_item_get_height (parent);
+          else
+            size = (guint64) gimp_image_get_width  (image) *
+                   (guint64) gimp_image_get_height (image);
+
+          size *= 4 * sizeof (gfloat);
+
+          if (size > budget)
+            break;
+
+          budget -= size;
+
+          gimp_filter_stack_set_cache_filter (GIMP_FILTER_STACK (container),
+                                              GIMP_FILTER (item));
+
+          stacks = g_list_prepend (stacks, g_object_ref (container));
+        }
+    }
+
+  for (list = private->render_cache_stacks; list; list = g_list_next (list))
+    {
+      if (! g_list_find (stacks, list->data))
+        gimp_filter_stack_set_cache_filter (list->data, NULL);
+    }
+
+  g_list_free_full (private->render_cache_stacks, g_object_unref);
+  private->render_cache_stacks = stacks;
+}
+
+static void
+gimp_image_render_cache_notify (GimpCoreConfig   *config,
+                                const GParamSpec *pspec,
+                                GimpImage        *image)
+{
+  GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  private->render_cache = config->render_cache;
+
+  gimp_image_update_render_cache (image);
+}
+
 static void
 gimp_image_projection_buffer_notify (GimpProjection   *projection,
                                      const GParamSpec *pspec,
@@ -1855,6 +1983,8 @@ gimp_image_selected_layers_notify (GimpItemTree     *tree,
   if (layers && gimp_image_get_selected_channels (image))
     gimp_image_set_selected_channels (image, NULL);
 
+  gimp_image_update_render_cache (image);
+
   g_signal_emit (image, gimp_image_signals[SELECTED_LAYERS_CHANGED], 0);
 }
 
@@ -2807,11 +2937,11 @@ gimp_image_get_export_proc (GimpImage *image)
 }
 
 gint
-gimp_image_get_xcf_version (GimpImage    *image,
-                            gboolean      zlib_compression,
-                            gint         *gimp_version,
-                            const gchar **version_string,
-                            gchar       **version_reason)
+gimp_image_get_xcf_version (GimpImage          *image,
+                            GimpXcfCompression  compression,
+                            gint               *gimp_version,
+                            const gchar       **version_string,
+                            gchar             **version_reason)
 {
   GList       *items;
   GList       *list;
@@ -3099,13 +3229,33 @@ gimp_image_get_xcf_version (GimpImage    *image,
     }
 
   /* need version 8 for zlib compression */
-  if (zlib_compression)
+  if (compression == GIMP_XCF_COMPRESSION_ZLIB)
     {
       ADD_REASON (g_strdup_printf (_("Internal zlib compression was "
                                      "added in %s"), "GIMP 2.10"));
       version = MAX (8, version);
     }
 
+  /* need version 26 for zstd compression, and version 28 for the
+   * predictive filtering of its tiles
+   */
+  if (compression == GIMP_XCF_COMPRESSION_ZSTD)
+    {
+      ADD_REASON (g_strdup_printf (_("Internal zstd compression was "
+                                     "added in %s"), "GIMP 3.2"));
+      version = MAX (28, version);
+    }
+
+  /* incremental saving needs the tile data length tables of version 27
+   * to refer to the tiles of earlier saves
+   */
+  if (image->gimp->config->xcf_incremental_save)
+    {
+      ADD_REASON (g_strdup_printf (_("Incremental saving was "
+                                     "added in %s"), "GIMP 3.2"));
+      version = MAX (27, version);
+    }
+
   /* if version is 10 (lots of new layer modes), go to version 11 with
    * 64 bit offsets right away
    */
@@ -3214,6 +3364,9 @@ gimp_image_get_xcf_version (GimpImage    *image,
       break;
     case 24:
     case 25:
+    case 26:
+    case 27:
+    case 28:
       if (gimp_version)   *gimp_version   = 320;
       if (version_string) *version_string = "GIMP 3.2";
       break;
@@ -3241,18 +3394,18 @@ gimp_image_get_xcf_version (GimpImage    *image,
 }
 
 void
-gimp_image_set_xcf_compression (GimpImage *image,
-                                gboolean   compression)
+gimp_image_set_xcf_compression (GimpImage          *image,
+                                GimpXcfCompression  compression)
 {
   g_return_if_fail (GIMP_IS_IMAGE (image));
 
   GIMP_IMAGE_GET_PRIVATE (image)->xcf_compression = compression;
 }
 
-gboolean
+GimpXcfCompression
 gimp_image_get_xcf_compression (GimpImage *image)
 {
-  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), GIMP_XCF_COMPRESSION_NONE);
 
   return GIMP_IMAGE_GET_PRIVATE (image)->xcf_compression;
 }
@@ -180,14 +180,14 @@ void            gimp_image_exported              (GimpImage          *image,
                                                   GFile              *file);
 
 gint            gimp_image_get_xcf_version       (GimpImage          *image,
-                                                  gboolean            zlib_compression,
+                                                  GimpXcfCompression  compression,
                                                   gint               *gimp_version,
                                                   const gchar       **version_string,
                                                   gchar             **version_reason);
 
 void            gimp_image_set_xcf_compression   (GimpImage          *image,
-                                                  gboolean            compression);
-gboolean        gimp_image_get_xcf_compression   (GimpImage          *image);
+                                                  GimpXcfCompression  compression);
+GimpXcfCompression gimp_image_get_xcf_compression (GimpImage          *image);
 
 void            gimp_image_set_resolution        (GimpImage          *image,
                                                   gdouble             xres,
@@ -25,35 +25,54 @@
 
 #include "core-types.h"
 
+#include "operations/layer-modes/gimp-layer-modes.h"
+#include "operations/layer-modes/gimpoperationnormalstack.h"
+
+#include "gimpdrawable-filters.h"
 #include "gimplayer.h"
 #include "gimplayerstack.h"
 
 
 /*  local function prototypes  */
 
-static void   gimp_layer_stack_constructed             (GObject       *object);
-
-static void   gimp_layer_stack_add                     (GimpContainer *container,
-                                                        GimpObject    *object);
-static void   gimp_layer_stack_remove                  (GimpContainer *container,
-                                                        GimpObject    *object);
-static void   gimp_layer_stack_reorder                 (GimpContainer *container,
-                                                        GimpObject    *object,
-                                                        gint           old_index,
-                                                        gint           new_index);
-
-static void   gimp_layer_stack_layer_active            (GimpLayer      *layer,
-                                                        GimpLayerStack *stack);
-static void   gimp_layer_stack_layer_excludes_backdrop (GimpLayer      *layer,
-                                                        GimpLayerStack *stack);
-
-static void   gimp_layer_stack_update_backdrop         (GimpLayerStack *stack,
-                                                        GimpLayer      *layer,
-                                                        gboolean        ignore_active,
-                                                        gboolean        ignore_excludes_backdrop);
-static void   gimp_layer_stack_update_range            (GimpLayerStack *stack,
-                                                        gint            first,
-                                                        gint            last);
+static void     gimp_layer_stack_constructed             (GObject             *object);
+
+static void     gimp_layer_stack_add                     (GimpContainer       *container,
+                                                          GimpObject          *object);
+static void     gimp_layer_stack_remove                  (GimpContainer       *container,
+                                                          GimpObject          *object);
+static void     gimp_layer_stack_reorder                 (GimpContainer       *container,
+                                                          GimpObject          *object,
+                                                          gint                 old_index,
+                                                          gint                 new_index);
+
+static gboolean gimp_layer_stack_can_merge               (GimpFilterStack     *stack,
+                                                          GimpFilter          *filter,
+                                                          GimpFilter          *below);
+static void     gimp_layer_stack_merge                   (GimpFilterStack     *stack,
+                                                          GList               *filters,
+                                                          GeglNode            *node);
+
+static void     gimp_layer_stack_layer_active            (GimpLayer           *layer,
+                                                          GimpLayerStack      *stack);
+static void     gimp_layer_stack_layer_excludes_backdrop (GimpLayer           *layer,
+                                                          GimpLayerStack      *stack);
+static void     gimp_layer_stack_layer_merge_changed     (GimpLayer           *layer,
+                                                          GimpLayerStack      *stack);
+static void     gimp_layer_stack_layer_merge_notify      (GimpLayer           *layer,
+                                                          const GParamSpec    *pspec,
+                                                          GimpLayerStack      *stack);
+
+static void     gimp_layer_stack_update_backdrop         (GimpLayerStack      *stack,
+                                                          GimpLayer           *layer,
+                                                          gboolean             ignore_active,
+                                                          gboolean             ignore_excludes_backdrop);
+static void     gimp_layer_stack_update_range            (GimpLayerStack      *stack,
+                                                          gint                 first,
+                                                          gint                 last);
+
+static gboolean gimp_layer_stack_is_normal_layer         (GimpLayer           *layer,
+                                                          GimpLayerColorSpace *composite_space);
 
 
 G_DEFINE_TYPE (GimpLayerStack, gimp_layer_stack, GIMP_TYPE_DRAWABLE_STACK)
@@ -64,14 +83,18 @@ G_DEFINE_TYPE (GimpLayerStack, gimp_layer_stack, GIMP_TYPE_DRAWABLE_STACK)
 static void
 gimp_layer_stack_class_init (GimpLayerStackClass *klass)
 {
-  GObjectClass       *object_class    = G_OBJECT_CLASS (klass);
-  GimpContainerClass *container_class = GIMP_CONTAINER_CLASS (klass);
+  GObjectClass         *object_class       = G_OBJECT_CLASS (klass);
+  GimpContainerClass   *container_class    = GIMP_CONTAINER_CLASS (klass);
+  GimpFilterStackClass *filter_stack_class = GIMP_FILTER_STACK_CLASS (klass);
 
-  object_class->constructed = gimp_layer_stack_constructed;
+  object_class->constructed     = gimp_layer_stack_constructed;
 
-  container_class->add      = gimp_layer_stack_add;
-  container_class->remove   = gimp_layer_stack_remove;
-  container_class->reorder  = gimp_layer_stack_reorder;
+  container_class->add          = gimp_layer_stack_add;
+  container_class->remove       = gimp_layer_stack_remove;
+  container_class->reorder      = gimp_layer_stack_reorder;
+
+  filter_stack_class->can_merge = gimp_layer_stack_can_merge;
+  filter_stack_class->merge     = gimp_layer_stack_merge;
 }
 
 static void
@@ -95,6 +118,34 @@ gimp_layer_stack_constructed (GObject *object)
   gimp_container_add_handler (container, "excludes-backdrop-changed",
                               G_CALLBACK (gimp_layer_stack_layer_excludes_backdrop),
                               container);
+
+  /*  everything that decides if, and how, a layer is merged with its
+   *  neighbors
+   */
+  gimp_container_add_handler (container, "opacity-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_changed),
+                              container);
+  gimp_container_add_handler (container, "effective-mode-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_changed),
+                              container);
+  gimp_container_add_handler (container, "mask-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_changed),
+                              container);
+  gimp_container_add_handler (container, "filters-changed",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_changed),
+                              container);
+  gimp_container_add_handler (container, "notify::buffer",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_notify),
+                              container);
+  gimp_container_add_handler (container, "notify::offset-x",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_notify),
+                              container);
+  gimp_container_add_handler (container, "notify::offset-y",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_notify),
+                              container);
+  gimp_container_add_handler (container, "notify::floating-selection",
+                              G_CALLBACK (gimp_layer_stack_layer_merge_notify),
+                              container);
 }
 
 static void
@@ -165,6 +216,87 @@ gimp_layer_stack_new (GType layer_type)
 
 /*  private functions  */
 
+static gboolean
+gimp_layer_stack_can_merge (GimpFilterStack *stack,
+                            GimpFilter      *filter,
+                            GimpFilter      *below)
+{
+  GimpLayerColorSpace composite_space;
+  GimpLayerColorSpace below_composite_space;
+
+  return (gimp_layer_stack_is_normal_layer (GIMP_LAYER (filter),
+                                            &composite_space)       &&
+          gimp_layer_stack_is_normal_layer (GIMP_LAYER (below),
+                                            &below_composite_space) &&
+          composite_space == below_composite_space);
+}
+
+static void
+gimp_layer_stack_merge (GimpFilterStack *stack,
+                        GList           *filters,
+                        GeglNode        *node)
+{
+  GimpOperationNormalStack *operation;
+  GimpLayerColorSpace       composite_space;
+  gboolean                  update;
+  GList                    *list;
+  gint                      i;
+
+  gimp_layer_stack_is_normal_layer (filters->data, &composite_space);
+
+  /*  setting the node's properties invalidates all of it, so only set
+   *  the ones that changed
+   */
+  if (! GIMP_IS_OPERATION_NORMAL_STACK (gegl_node_get_gegl_operation (node)))
+    {
+      gegl_node_set (node,
+                     "operation", "gimp:normal-stack",
+                     NULL);
+    }
+
+  operation = GIMP_OPERATION_NORMAL_STACK (gegl_node_get_gegl_operation (node));
+
+  if (operation->composite_space != composite_space)
+    {
+      gegl_node_set (node,
+                     "composite-space", composite_space,
+                     NULL);
+    }
+
+  /*  if the run still has the same number of layers, only update the
+   *  layers that changed, so that changing a layer's opacity or offset
+   *  only invalidates that layer's area
+   */
+  update = (gimp_operation_normal_stack_get_n_layers (operation) ==
+            g_list_length (filters));
+
+  if (! update)
+    gimp_operation_normal_stack_clear (operation);
+
+  for (list = filters, i = 0; list; list = g_list_next (list), i++)
+    {
+      GimpLayer  *layer  = list->data;
+      GeglBuffer *buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+      gint        offset_x;
+      gint        offset_y;
+
+      gimp_item_get_offset (GIMP_ITEM (layer), &offset_x, &offset_y);
+
+      if (update)
+        {
+          gimp_operation_normal_stack_set_layer (operation, i, buffer,
+                                                 offset_x, offset_y,
+                                                 gimp_layer_get_opacity (layer));
+        }
+      else
+        {
+          gimp_operation_normal_stack_add_layer (operation, buffer,
+                                                 offset_x, offset_y,
+                                                 gimp_layer_get_opacity (layer));
+        }
+    }
+}
+
 static void
 gimp_layer_stack_layer_active (GimpLayer      *layer,
                                GimpLayerStack *stack)
@@ -179,6 +311,25 @@ gimp_layer_stack_layer_excludes_backdrop (GimpLayer      *layer,
   gimp_layer_stack_update_backdrop (stack, layer, FALSE, TRUE);
 }
 
+static void
+gimp_layer_stack_layer_merge_changed (GimpLayer      *layer,
+                                      GimpLayerStack *stack)
+{
+  GimpFilterStack *filter_stack = GIMP_FILTER_STACK (stack);
+
+  /*  the cache filter is never merged, so it doesn't affect the merges  */
+  if (GIMP_FILTER (layer) != gimp_filter_stack_get_cache_filter (filter_stack))
+    gimp_filter_stack_update_merges (filter_stack);
+}
+
+static void
+gimp_layer_stack_layer_merge_notify (GimpLayer        *layer,
+                                     const GParamSpec *pspec,
+                                     GimpLayerStack   *stack)
+{
+  gimp_layer_stack_layer_merge_changed (layer, stack);
+}
+
 static void
 gimp_layer_stack_update_backdrop (GimpLayerStack *stack,
                                   GimpLayer      *layer,
@@ -240,3 +391,31 @@ gimp_layer_stack_update_range (GimpLayerStack *stack,
         }
     }
 }
+
+/*  returns whether @layer is a plain NORMAL-mode layer, without a mask
+ *  or effects, whose node does nothing gimp:normal-stack can't do
+ */
+static gboolean
+gimp_layer_stack_is_normal_layer (GimpLayer           *layer,
+                                  GimpLayerColorSpace *composite_space)
+{
+  GimpLayerMode          mode;
+  GimpLayerCompositeMode composite_mode;
+
+  gimp_layer_get_effective_mode (layer,
+                                 &mode, NULL, composite_space, &composite_mode);
+
+  if (*composite_space == GIMP_LAYER_COLOR_SPACE_AUTO)
+    *composite_space = gimp_layer_mode_get_composite_space (mode);
+
+  if (composite_mode == GIMP_LAYER_COMPOSITE_AUTO)
+    composite_mode = gimp_layer_mode_get_composite_mode (mode);
+
+  return ((mode == GIMP_LAYER_MODE_NORMAL ||
+           mode == GIMP_LAYER_MODE_NORMAL_LEGACY)              &&
+          composite_mode == GIMP_LAYER_COMPOSITE_UNION         &&
+          ! gimp_viewable_get_children (GIMP_VIEWABLE (layer)) &&
+          ! gimp_layer_get_mask (layer)                        &&
+          ! gimp_layer_is_floating_sel (layer)                 &&
+          ! gimp_drawable_has_visible_filters (GIMP_DRAWABLE (layer)));
+}
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
@@ -46,6 +48,34 @@
 
 #include "gimp-intl.h"
 
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+#define EDGELS_PER_THREAD \
+  (/* each thread costs as much as */ 1024.0 /* edgels */)
+
+/* number of inputs whose closed line art is kept around, so that
+ * switching between drawables, or editing one of them, doesn't require
+ * closing the whole line art again.
+ */
+#define CACHE_SIZE 3
+
+/* distance, in addition to the maximum closure length, up to which a
+ * change of the input can affect the closed line art.
+ */
+#define UPDATE_MARGIN 32
+
+/* width of the band around the updated part of the line art which
+ * must not contain any stroke pixel outside of it.
+ */
+#define UPDATE_BORDER 5
+
+/* regions created by the closure smaller than this many pixels are
+ * filled or rejected.
+ */
+#define CREATED_REGIONS_MINIMUM_AREA 100
+
+
 enum
 {
   COMPUTING_START,
@@ -64,49 +94,75 @@ enum
   PROP_SEGMENT_MAX_LEN,
 };
 
+typedef struct _LineArtResult      LineArtResult;
 typedef struct _GimpLineArtPrivate GimpLineArtPrivate;
 
 struct _GimpLineArtPrivate
 {
-  gboolean      frozen;
-  gboolean      compute_after_thaw;
+  gboolean       frozen;
+  gboolean       compute_after_thaw;
 
-  GimpAsync    *async;
+  GimpAsync     *async;
+
+  gint           idle_id;
 
-  gint          idle_id;
+  GimpPickable  *input;
+  LineArtResult *result;
 
-  GimpPickable *input;
-  GeglBuffer   *closed;
-  gfloat       *distmap;
+  /* Results of the last few inputs, most recently used first. */
+  GList         *cache;
 
   /* Used in the closing step. */
-  gboolean      select_transparent;
-  gdouble       threshold;
-  gboolean      automatic_closure;
-  gint          spline_max_len;
-  gint          segment_max_len;
-  gboolean      max_len_bound;
+  gboolean       select_transparent;
+  gdouble        threshold;
+  gboolean       automatic_closure;
+  gint           spline_max_len;
+  gint           segment_max_len;
+  gboolean       max_len_bound;
 
   /* Used in the grow step. */
-  gint          max_grow;
+  gint           max_grow;
 };
 
 typedef struct
 {
-  GeglBuffer  *buffer;
+  GeglBuffer    *buffer;
+
+  gboolean       select_transparent;
+  gdouble        threshold;
+  gboolean       automatic_closure;
+  gint           spline_max_len;
+  gint           segment_max_len;
 
-  gboolean     select_transparent;
-  gdouble      threshold;
-  gboolean     automatic_closure;
-  gint         spline_max_len;
-  gint         segment_max_len;
+  /* Result of a previous computation for the same input, if any. */
+  LineArtResult *previous;
 } LineArtData;
 
-typedef struct
+struct _LineArtResult
 {
+  gint        ref_count;
+
+  /* The input and parameters the line art was closed for. */
+  GeglBuffer *input;
+  gboolean    select_transparent;
+  gdouble     threshold;
+  gboolean    automatic_closure;
+  gint        spline_max_len;
+  gint        segment_max_len;
+
+  /* Whole-image properties of the input which affect all pixels. */
+  gboolean    transparent;
+  guchar      max_value;
+
   GeglBuffer *closed;
   gfloat     *distmap;
-} LineArtResult;
+};
+
+typedef struct
+{
+  GimpPickable  *input;
+  LineArtResult *result;
+} LineArtCacheEntry;
 
 static int DeltaX[4] = {+1, -1, 0, 0};
 static int DeltaY[4] = {0, 0, +1, -1};
@@ -147,6 +203,49 @@ typedef struct _Edgel
   guint     next, previous;
 } Edgel;
 
+typedef struct
+{
+  guchar    *strokes;
+  gint32    *parent;
+  gboolean  *strip_start;
+  gint       width;
+  gint       minimum_area;
+  GimpAsync *async;
+} DenoiseData;
+
+typedef struct
+{
+  GArray       *set;
+  GeglBuffer   *buffer;
+  GHashTable   *edgel2index;
+  const gfloat *weights;
+  gint          mask_size;
+  gfloat       *smoothed_curvatures;
+  GimpAsync    *async;
+} EdgelsetData;
+
+typedef struct
+{
+  gfloat       *normals;
+  gfloat       *curvatures;
+  const gfloat *smoothed_curvatures;
+  const gfloat *radii;
+  gfloat        threshold;
+  gfloat        clamped_threshold;
+  gint          width;
+  GimpAsync    *async;
+} CurvaturesData;
+
+typedef struct
+{
+  GeglBuffer   *mask;
+  const gfloat *dist;
+  gfloat       *thickness;
+  gint          width;
+  gint          height;
+  GimpAsync    *async;
+} RadiiData;
+
 
 static void            gimp_line_art_finalize                  (GObject               *object);
 static void            gimp_line_art_set_property              (GObject                *object,
@@ -171,9 +270,26 @@ static void            gimp_line_art_prepare_async_func        (GimpAsync
 static LineArtData   * line_art_data_new                       (GeglBuffer             *buffer,
                                                                 GimpLineArt            *line_art);
 static void            line_art_data_free                      (LineArtData            *data);
-static LineArtResult * line_art_result_new                     (GeglBuffer             *line_art,
+static LineArtResult * line_art_result_new                     (LineArtData            *data,
+                                                                gboolean                transparent,
+                                                                guchar                  max_value,
+                                                                GeglBuffer             *closed,
                                                                 gfloat                 *distmap);
-static void            line_art_result_free                    (LineArtResult          *result);
+static LineArtResult * line_art_result_ref                     (LineArtResult          *result);
+static void            line_art_result_unref                   (LineArtResult          *result);
+static gboolean        line_art_result_is_compatible           (LineArtResult          *result,
+                                                                LineArtData            *data,
+                                                                gboolean                transparent,
+                                                                guchar                  max_value);
+
+static LineArtResult * gimp_line_art_cache_lookup              (GimpLineArt            *line_art,
+                                                                GimpPickable           *input);
+static void            gimp_line_art_cache_add                 (GimpLineArt            *line_art,
+                                                                GimpPickable           *input,
+                                                                LineArtResult          *result);
+static void            gimp_line_art_cache_clear               (GimpLineArt            *line_art);
+static void            gimp_line_art_cache_input_finalized     (GimpLineArt            *line_art,
+                                                                GObject                *input);
 
 static gboolean        gimp_line_art_idle                      (GimpLineArt            *line_art);
 static void            gimp_line_art_input_invalidate_preview  (GimpViewable           *viewable,
@@ -182,8 +298,42 @@ static void            gimp_line_art_input_invalidate_preview  (GimpViewable
 
 /* All actual computation functions. */
 
+static GeglBuffer    * gimp_line_art_close_data                (LineArtData            *data,
+                                                                GeglBuffer             *buffer,
+                                                                gboolean                transparent,
+                                                                guchar                  max_value,
+                                                                gfloat                **distmap,
+                                                                GimpAsync              *async);
+static gint            gimp_line_art_max_value                 (GeglBuffer             *buffer,
+                                                                GimpAsync              *async);
+static gboolean        gimp_line_art_find_changes              (GeglBuffer             *buffer,
+                                                                GeglBuffer             *previous,
+                                                                GeglRectangle          *changes,
+                                                                GimpAsync              *async);
+static gint64          gimp_line_art_fill_component            (guchar                 *pixels,
+                                                                gint                    width,
+                                                                gint                    height,
+                                                                gint                    index,
+                                                                guchar                  value,
+                                                                guchar                  visited,
+                                                                GArray                 *stack,
+                                                                GeglRectangle          *bounds);
+static gboolean        gimp_line_art_complete_area             (LineArtData            *data,
+                                                                gboolean                transparent,
+                                                                guchar                  max_value,
+                                                                GeglRectangle          *area,
+                                                                GimpAsync              *async);
+static gboolean        gimp_line_art_has_clipped_regions       (GeglBuffer             *closed,
+                                                                const GeglRectangle    *area,
+                                                                const GeglRectangle    *extent);
+static LineArtResult * gimp_line_art_update                    (LineArtData            *data,
+                                                                gboolean                transparent,
+                                                                guchar                  max_value,
+                                                                const GeglRectangle    *changes,
+                                                                GimpAsync              *async);
 static GeglBuffer    * gimp_line_art_close                     (GeglBuffer             *buffer,
                                                                 gboolean                select_transparent,
+                                                                guchar                  max_value,
                                                                 gdouble                 stroke_threshold,
                                                                 gboolean                automatic_closure,
                                                                 gint                    spline_max_length,
@@ -200,18 +350,39 @@ static GeglBuffer    * gimp_line_art_close                     (GeglBuffer
                                                                 gboolean                small_segments_from_spline_sources,
                                                                 gfloat                **lineart_distmap,
                                                                 GimpAsync              *async);
+static GeglBuffer    * gimp_line_art_binarize                  (GeglBuffer             *buffer,
+                                                                gboolean                select_transparent,
+                                                                guchar                  max_value,
+                                                                gdouble                 stroke_threshold,
+                                                                GimpAsync              *async);
+static gfloat        * gimp_line_art_distmap                   (GeglBuffer             *closed);
 
 static void            gimp_lineart_denoise                    (GeglBuffer             *buffer,
                                                                 int                     size,
                                                                 GimpAsync              *async);
+static void            gimp_lineart_denoise_label              (gsize                   offset,
+                                                                gsize                   size,
+                                                                DenoiseData            *data);
+static void            gimp_lineart_denoise_clear              (gsize                   offset,
+                                                                gsize                   size,
+                                                                DenoiseData            *data);
 static void            gimp_lineart_compute_normals_curvatures (GeglBuffer             *mask,
                                                                 gfloat                 *normals,
                                                                 gfloat                 *curvatures,
                                                                 gfloat                 *smoothed_curvatures,
                                                                 int                     normal_estimate_mask_size,
                                                                 GimpAsync              *async);
+static void            gimp_lineart_normalize_normals          (gsize                   offset,
+                                                                gsize                   size,
+                                                                CurvaturesData         *data);
 static gfloat        * gimp_lineart_get_smooth_curvatures      (GArray                 *edgelset,
                                                                 GimpAsync              *async);
+static void            gimp_lineart_smooth_curvatures_func     (gsize                   offset,
+                                                                gsize                   size,
+                                                                EdgelsetData           *data);
+static void            gimp_lineart_end_points_threshold       (gsize                   offset,
+                                                                gsize                   size,
+                                                                CurvaturesData         *data);
 static GArray        * gimp_lineart_curvature_extremums        (gfloat                 *curvatures,
                                                                 gfloat                 *smoothed_curvatures,
                                                                 gint                    curvatures_width,
@@ -245,6 +416,8 @@ static GArray        * gimp_lineart_line_segment_until_hit      (const GeglBuffe
                                                                  int                     size);
 static gfloat        * gimp_lineart_estimate_strokes_radii      (GeglBuffer             *mask,
                                                                  GimpAsync              *async);
+static void            gimp_lineart_estimate_strokes_radii_area (const GeglRectangle    *area,
+                                                                 RadiiData              *data);
 static void            gimp_line_art_simple_fill                (GeglBuffer             *buffer,
                                                                  gint                    x,
                                                                  gint                    y,
@@ -295,13 +468,22 @@ static void       gimp_edgelset_init_normals      (GArray             *set);
 static void       gimp_edgelset_smooth_normals    (GArray             *set,
                                                    int                 mask_size,
                                                    GimpAsync          *async);
+static void       gimp_edgelset_normals_func      (gsize               offset,
+                                                   gsize               size,
+                                                   EdgelsetData       *data);
 static void       gimp_edgelset_compute_curvature (GArray             *set,
                                                    GimpAsync          *async);
+static void       gimp_edgelset_curvature_func    (gsize               offset,
+                                                   gsize               size,
+                                                   EdgelsetData       *data);
 
 static void       gimp_edgelset_build_graph       (GArray            *set,
                                                    GeglBuffer        *buffer,
                                                    GHashTable        *edgel2index,
                                                    GimpAsync         *async);
+static void       gimp_edgelset_graph_func        (gsize              offset,
+                                                   gsize              size,
+                                                   EdgelsetData      *data);
 static void       gimp_edgelset_next8             (const GeglBuffer  *buffer,
                                                    Edgel             *it,
                                                    Edgel             *n);
@@ -395,6 +577,8 @@ gimp_line_art_finalize (GObject *object)
 
   gimp_line_art_set_input (line_art, NULL);
 
+  gimp_line_art_cache_clear (line_art);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -576,19 +760,19 @@ gimp_line_art_get (GimpLineArt  *line_art,
     {
       gimp_waitable_wait (GIMP_WAITABLE (line_art->priv->async));
     }
-  else if (! line_art->priv->closed)
+  else if (! line_art->priv->result)
     {
       gimp_line_art_compute (line_art);
       if (line_art->priv->async)
         gimp_waitable_wait (GIMP_WAITABLE (line_art->priv->async));
     }
 
-  g_return_val_if_fail (line_art->priv->closed, NULL);
+  g_return_val_if_fail (line_art->priv->result, NULL);
 
   if (distmap)
-    *distmap = line_art->priv->distmap;
+    *distmap = line_art->priv->result->distmap;
 
-  return line_art->priv->closed;
+  return line_art->priv->result->closed;
 }
 
 /* Functions for asynchronous computation. */
@@ -619,8 +803,7 @@ gimp_line_art_compute (GimpLineArt *line_art)
       line_art->priv->idle_id = 0;
     }
 
-  g_clear_object (&line_art->priv->closed);
-  g_clear_pointer (&line_art->priv->distmap, g_free);
+  g_clear_pointer (&line_art->priv->result, line_art_result_unref);
 
   if (line_art->priv->input)
     {
@@ -658,9 +841,8 @@ gimp_line_art_compute_cb (GimpAsync   *async,
 
       result = gimp_async_get_result (async);
 
-      line_art->priv->closed  = g_object_ref (result->closed);
-      line_art->priv->distmap = result->distmap;
-      result->distmap  = NULL;
+      line_art->priv->result = line_art_result_ref (result);
+      gimp_line_art_cache_add (line_art, line_art->priv->input, result);
       g_signal_emit (line_art, gimp_line_art_signals[COMPUTING_END], 0);
     }
 
@@ -698,13 +880,15 @@ static void
 gimp_line_art_prepare_async_func (GimpAsync   *async,
                                   LineArtData *data)
 {
-  GeglBuffer *buffer;
-  GeglBuffer *closed  = NULL;
-  gfloat     *distmap = NULL;
-  gint        buffer_x;
-  gint        buffer_y;
-  gboolean    has_alpha;
-  gboolean    select_transparent = FALSE;
+  LineArtResult *result;
+  GeglBuffer    *buffer;
+  GeglBuffer    *closed  = NULL;
+  gfloat        *distmap = NULL;
+  gint           buffer_x;
+  gint           buffer_y;
+  gboolean       has_alpha;
+  gboolean       select_transparent = FALSE;
+  gint           max_value          = 0;
 
   has_alpha = babl_format_has_alpha (gegl_buffer_get_format (data->buffer));
 
@@ -753,6 +937,70 @@ gimp_line_art_prepare_async_func (GimpAsync   *async,
         }
     }
 
+  if (! select_transparent)
+    {
+      /* The luminosity is binarized relative to the biggest value of
+       * the whole input, which is why it is computed here, rather than
+       * on the part of the input we may actually close.
+       */
+      max_value = gimp_line_art_max_value (data->buffer, async);
+
+      if (gimp_async_is_stopped (async))
+        {
+          line_art_data_free (data);
+
+          return;
+        }
+    }
+
+  /* When only a part of the input changed since the line art was last
+   * closed, only close the line art again around the changes.
+   */
+  if (data->previous &&
+      line_art_result_is_compatible (data->previous, data,
+                                     select_transparent, max_value))
+    {
+      GeglRectangle changes;
+
+      if (! gimp_line_art_find_changes (data->buffer, data->previous->input,
+                                        &changes, async))
+        {
+          if (! gimp_async_is_stopped (async))
+            {
+              gimp_async_finish_full (async,
+                                      line_art_result_ref (data->previous),
+                                      (GDestroyNotify) line_art_result_unref);
+            }
+
+          line_art_data_free (data);
+
+          return;
+        }
+
+      GIMP_TIMER_START();
+
+      result = gimp_line_art_update (data, select_transparent, max_value,
+                                     &changes, async);
+
+      GIMP_TIMER_END("update line-art");
+
+      if (result)
+        {
+          gimp_async_finish_full (async, result,
+                                  (GDestroyNotify) line_art_result_unref);
+
+          line_art_data_free (data);
+
+          return;
+        }
+      else if (gimp_async_is_stopped (async))
+        {
+          line_art_data_free (data);
+
+          return;
+        }
+    }
+
   buffer   = data->buffer;
   buffer_x = gegl_buffer_get_x (data->buffer);
   buffer_y = gegl_buffer_get_y (data->buffer);
@@ -772,34 +1020,9 @@ gimp_line_art_prepare_async_func (GimpAsync   *async,
    */
   GIMP_TIMER_START();
 
-  closed = gimp_line_art_close (buffer,
-                                select_transparent,
-                                data->threshold,
-                                data->automatic_closure,
-                                data->spline_max_len,
-                                data->segment_max_len,
-                                /*minimal_lineart_area,*/
-                                5,
-                                /*normal_estimate_mask_size,*/
-                                5,
-                                /*end_point_rate,*/
-                                0.85,
-                                /*spline_max_angle,*/
-                                90.0,
-                                /*end_point_connectivity,*/
-                                2,
-                                /*spline_roundness,*/
-                                1.0,
-                                /*allow_self_intersections,*/
-                                TRUE,
-                                /*created_regions_significant_area,*/
-                                4,
-                                /*created_regions_minimum_area,*/
-                                100,
-                                /*small_segments_from_spline_sources,*/
-                                TRUE,
-                                &distmap,
-                                async);
+  closed = gimp_line_art_close_data (data, buffer,
+                                     select_transparent, max_value,
+                                     &distmap, async);
 
   GIMP_TIMER_END("close line-art");
 
@@ -821,9 +1044,11 @@ gimp_line_art_prepare_async_func (GimpAsync   *async,
           closed = buffer;
         }
 
-      gimp_async_finish_full (async,
-                              line_art_result_new (closed, distmap),
-                              (GDestroyNotify) line_art_result_free);
+      result = line_art_result_new (data, select_transparent, max_value,
+                                    closed, distmap);
+
+      gimp_async_finish_full (async, result,
+                              (GDestroyNotify) line_art_result_unref);
     }
 
   line_art_data_free (data);
@@ -833,7 +1058,8 @@ static LineArtData *
 line_art_data_new (GeglBuffer  *buffer,
                    GimpLineArt *line_art)
 {
-  LineArtData *data = g_slice_new (LineArtData);
+  LineArtData   *data = g_slice_new (LineArtData);
+  LineArtResult *previous;
 
   data->buffer             = g_object_ref (buffer);
   data->select_transparent = line_art->priv->select_transparent;
@@ -841,6 +1067,12 @@ line_art_data_new (GeglBuffer  *buffer,
   data->automatic_closure  = line_art->priv->automatic_closure;
   data->spline_max_len     = line_art->priv->spline_max_len;
   data->segment_max_len    = line_art->priv->segment_max_len;
+  data->previous           = NULL;
+
+  previous = gimp_line_art_cache_lookup (line_art, line_art->priv->input);
+
+  if (previous)
+    data->previous = line_art_result_ref (previous);
 
   return data;
 }
@@ -849,30 +1081,189 @@ static void
 line_art_data_free (LineArtData *data)
 {
   g_object_unref (data->buffer);
+  g_clear_pointer (&data->previous, line_art_result_unref);
 
   g_slice_free (LineArtData, data);
 }
 
 static LineArtResult *
-line_art_result_new (GeglBuffer *closed,
-                     gfloat     *distmap)
+line_art_result_new (LineArtData *data,
+                     gboolean     transparent,
+                     guchar       max_value,
+                     GeglBuffer  *closed,
+                     gfloat      *distmap)
+{
+  LineArtResult *result;
+
+  result = g_slice_new (LineArtResult);
+  result->ref_count          = 1;
+  result->input              = g_object_ref (data->buffer);
+  result->select_transparent = data->select_transparent;
+  result->threshold          = data->threshold;
+  result->automatic_closure  = data->automatic_closure;
+  result->spline_max_len     = data->spline_max_len;
+  result->segment_max_len    = data->segment_max_len;
+  result->transparent        = transparent;
+  result->max_value          = max_value;
+  result->closed             = closed;
+  result->distmap            = distmap;
+
+  return result;
+}
+
+static LineArtResult *
+line_art_result_ref (LineArtResult *result)
+{
+  g_atomic_int_inc (&result->ref_count);
+
+  return result;
+}
+
+static void
+line_art_result_unref (LineArtResult *result)
+{
+  if (g_atomic_int_dec_and_test (&result->ref_count))
+    {
+      g_object_unref (result->input);
+      g_object_unref (result->closed);
+      g_free (result->distmap);
+
+      g_slice_free (LineArtResult, result);
+    }
+}
+
+/* Whether @result was closed with the same parameters as @data, and an
+ * input of the same size and format, so that it only needs to be
+ * updated where the inputs differ.
+ */
+static gboolean
+line_art_result_is_compatible (LineArtResult *result,
+                               LineArtData   *data,
+                               gboolean       transparent,
+                               guchar         max_value)
+{
+  return (result->select_transparent == data->select_transparent &&
+          result->threshold          == data->threshold          &&
+          result->automatic_closure  == data->automatic_closure  &&
+          result->spline_max_len     == data->spline_max_len     &&
+          result->segment_max_len    == data->segment_max_len    &&
+          result->transparent        == transparent              &&
+          result->max_value          == max_value                &&
+          gegl_rectangle_equal (gegl_buffer_get_extent (result->input),
+                                gegl_buffer_get_extent (data->buffer)) &&
+          gegl_buffer_get_format (result->input) ==
+          gegl_buffer_get_format (data->buffer));
+}
+
+static LineArtResult *
+gimp_line_art_cache_lookup (GimpLineArt  *line_art,
+                            GimpPickable *input)
+{
+  GList *list;
+
+  for (list = line_art->priv->cache; list; list = g_list_next (list))
+    {
+      LineArtCacheEntry *entry = list->data;
+
+      if (entry->input == input)
+        return entry->result;
+    }
+
+  return NULL;
+}
+
+static void
+gimp_line_art_cache_add (GimpLineArt   *line_art,
+                         GimpPickable  *input,
+                         LineArtResult *result)
 {
-  LineArtResult *data;
+  LineArtCacheEntry *entry = NULL;
+  GList             *list;
 
-  data = g_slice_new (LineArtResult);
-  data->closed  = closed;
-  data->distmap = distmap;
+  for (list = line_art->priv->cache; list; list = g_list_next (list))
+    {
+      if (((LineArtCacheEntry *) list->data)->input == input)
+        {
+          entry = list->data;
 
-  return data;
+          line_art->priv->cache = g_list_delete_link (line_art->priv->cache,
+                                                      list);
+          break;
+        }
+    }
+
+  if (entry)
+    {
+      line_art_result_unref (entry->result);
+    }
+  else
+    {
+      entry = g_slice_new (LineArtCacheEntry);
+      entry->input = input;
+
+      g_object_weak_ref (G_OBJECT (input),
+                         (GWeakNotify) gimp_line_art_cache_input_finalized,
+                         line_art);
+    }
+
+  entry->result = line_art_result_ref (result);
+
+  line_art->priv->cache = g_list_prepend (line_art->priv->cache, entry);
+
+  while (g_list_length (line_art->priv->cache) > CACHE_SIZE)
+    {
+      list  = g_list_last (line_art->priv->cache);
+      entry = list->data;
+
+      g_object_weak_unref (G_OBJECT (entry->input),
+                           (GWeakNotify) gimp_line_art_cache_input_finalized,
+                           line_art);
+      line_art_result_unref (entry->result);
+      g_slice_free (LineArtCacheEntry, entry);
+
+      line_art->priv->cache = g_list_delete_link (line_art->priv->cache,
+                                                  list);
+    }
+}
+
+static void
+gimp_line_art_cache_clear (GimpLineArt *line_art)
+{
+  while (line_art->priv->cache)
+    {
+      LineArtCacheEntry *entry = line_art->priv->cache->data;
+
+      g_object_weak_unref (G_OBJECT (entry->input),
+                           (GWeakNotify) gimp_line_art_cache_input_finalized,
+                           line_art);
+      line_art_result_unref (entry->result);
+      g_slice_free (LineArtCacheEntry, entry);
+
+      line_art->priv->cache = g_list_delete_link (line_art->priv->cache,
+                                                  line_art->priv->cache);
+    }
 }
 
 static void
-line_art_result_free (LineArtResult *data)
+gimp_line_art_cache_input_finalized (GimpLineArt *line_art,
+                                     GObject     *input)
 {
-  g_object_unref (data->closed);
-  g_clear_pointer (&data->distmap, g_free);
+  GList *list;
+
+  for (list = line_art->priv->cache; list; list = g_list_next (list))
+    {
+      LineArtCacheEntry *entry = list->data;
+
+      if ((GObject *) entry->input == input)
+        {
+          line_art_result_unref (entry->result);
+          g_slice_free (LineArtCacheEntry, entry);
 
-  g_slice_free (LineArtResult, data);
+          line_art->priv->cache = g_list_delete_link (line_art->priv->cache,
+                                                      list);
+          break;
+        }
+    }
 }
 
 static gboolean
@@ -900,133 +1291,116 @@ gimp_line_art_input_invalidate_preview (GimpViewable *viewable,
 
 /* All actual computation functions. */
 
-/**
- * gimp_line_art_close:
- * @buffer: the input #GeglBuffer.
- * @select_transparent: whether we binarize the alpha channel or the
- *                      luminosity.
- * @stroke_threshold: [0-1] threshold value for detecting stroke pixels
- *                    (higher values will detect more stroke pixels).
- * @automatic_closure: whether the closing step should be performed or
- *                     not. @spline_max_length and @segment_max_len are
- *                     used only if @automatic_closure is %TRUE.
- * @spline_max_length: the maximum length for creating splines between
- *                     end points.
- * @segment_max_length: the maximum length for creating segments
- *                      between end points. Unlike splines, segments
- *                      are straight lines.
- * @minimal_lineart_area: the minimum size in number pixels for area to
- *                        be considered as line art.
- * @normal_estimate_mask_size:
- * @end_point_rate: threshold to estimate if a curvature is an end-point
- *                  in [0-1] range value.
- * @spline_max_angle: the maximum angle between end point normals for
- *                    creating splines between them.
- * @end_point_connectivity:
- * @spline_roundness:
- * @allow_self_intersections: whether to allow created splines and
- *                            segments to intersect.
- * @created_regions_significant_area:
- * @created_regions_minimum_area:
- * @small_segments_from_spline_sources:
- * @closed_distmap: a distance map of the closed line art pixels.
- * @async: the #GimpAsync associated with the computation
- *
- * Creates a binarized version of the strokes of @buffer, detected either
- * with luminosity (light means background) or alpha values depending on
- * @select_transparent. This binary version of the strokes will have closed
- * regions allowing adequate selection of "nearly closed regions".
- * This algorithm is meant for digital painting (and in particular on the
- * sketch-only step), and therefore will likely produce unexpected results on
- * other types of input.
- *
- * The algorithm is the first step from the research paper "A Fast and
- * Efficient Semi-guided Algorithm for Flat Coloring Line-arts", by Sébastian
- * Fourey, David Tschumperlé, David Revoy.
- * https://hal.archives-ouvertes.fr/hal-01891876
- *
- * Returns: a new #GeglBuffer of format "Y u8" representing the
- *          binarized @line_art. If @lineart_distmap is not %NULL, a
- *          newly allocated float buffer is returned, which can be used
- *          for overflowing created masks later.
- */
+/* Closes the line art of @buffer with the parameters of @data. */
 static GeglBuffer *
-gimp_line_art_close (GeglBuffer  *buffer,
-                     gboolean     select_transparent,
-                     gdouble      stroke_threshold,
-                     gboolean     automatic_closure,
-                     gint         spline_max_length,
-                     gint         segment_max_length,
-                     gint         minimal_lineart_area,
-                     gint         normal_estimate_mask_size,
-                     gfloat       end_point_rate,
-                     gfloat       spline_max_angle,
-                     gint         end_point_connectivity,
-                     gfloat       spline_roundness,
-                     gboolean     allow_self_intersections,
-                     gint         created_regions_significant_area,
-                     gint         created_regions_minimum_area,
-                     gboolean     small_segments_from_spline_sources,
-                     gfloat     **closed_distmap,
-                     GimpAsync   *async)
+gimp_line_art_close_data (LineArtData  *data,
+                          GeglBuffer   *buffer,
+                          gboolean      transparent,
+                          guchar        max_value,
+                          gfloat      **distmap,
+                          GimpAsync    *async)
+{
+  return gimp_line_art_close (buffer,
+                              transparent,
+                              max_value,
+                              data->threshold,
+                              data->automatic_closure,
+                              data->spline_max_len,
+                              data->segment_max_len,
+                              /*minimal_lineart_area,*/
+                              5,
+                              /*normal_estimate_mask_size,*/
+                              5,
+                              /*end_point_rate,*/
+                              0.85,
+                              /*spline_max_angle,*/
+                              90.0,
+                              /*end_point_connectivity,*/
+                              2,
+                              /*spline_roundness,*/
+                              1.0,
+                              /*allow_self_intersections,*/
+                              TRUE,
+                              /*created_regions_significant_area,*/
+                              4,
+                              /*created_regions_minimum_area,*/
+                              CREATED_REGIONS_MINIMUM_AREA,
+                              /*small_segments_from_spline_sources,*/
+                              TRUE,
+                              distmap,
+                              async);
+}
+
+/* Returns the biggest luminosity of @buffer, or -1 if @async was
+ * canceled.
+ */
+static gint
+gimp_line_art_max_value (GeglBuffer *buffer,
+                         GimpAsync  *async)
 {
-  const Babl         *gray_format;
   GeglBufferIterator *gi;
-  GeglBuffer         *closed  = NULL;
-  GeglBuffer         *strokes = NULL;
   guchar              max_value = 0;
-  gint                width  = gegl_buffer_get_width (buffer);
-  gint                height = gegl_buffer_get_height (buffer);
-  gint                i;
-
-  if (select_transparent)
-    /* Keep alpha channel as gray levels */
-    gray_format = babl_format ("A u8");
-  else
-    /* Keep luminance */
-    gray_format = babl_format ("Y' u8");
-
-  /* Transform the line art from any format to gray. */
-  strokes = gegl_buffer_new (gegl_buffer_get_extent (buffer),
-                             gray_format);
-  gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE, strokes, NULL);
-  gegl_buffer_set_format (strokes, babl_format ("Y' u8"));
 
-  if (! select_transparent)
+  gi = gegl_buffer_iterator_new (buffer, NULL, 0, babl_format ("Y' u8"),
+                                 GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
+  while (gegl_buffer_iterator_next (gi))
     {
-      /* Compute the biggest value */
-      gi = gegl_buffer_iterator_new (strokes, NULL, 0, NULL,
-                                     GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
-      while (gegl_buffer_iterator_next (gi))
-        {
-          guchar *data = (guchar*) gi->items[0].data;
-          gint    k;
+      guchar *data = (guchar*) gi->items[0].data;
+      gint    k;
 
-          if (gimp_async_is_canceled (async))
-            {
-              gegl_buffer_iterator_stop (gi);
+      if (gimp_async_is_canceled (async))
+        {
+          gegl_buffer_iterator_stop (gi);
 
-              gimp_async_abort (async);
+          gimp_async_abort (async);
 
-              goto end1;
-            }
+          return -1;
+        }
 
-          for (k = 0; k < gi->length; k++)
-            {
-              if (*data > max_value)
-                max_value = *data;
-              data++;
-            }
+      for (k = 0; k < gi->length; k++)
+        {
+          if (*data > max_value)
+            max_value = *data;
+          data++;
         }
     }
 
-  /* Make the image binary: 1 is stroke, 0 background */
-  gi = gegl_buffer_iterator_new (strokes, NULL, 0, NULL,
-                                 GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE, 1);
+  return max_value;
+}
+
+/* Compares @buffer with @previous, which must have the same extent and
+ * format, and returns the bounding box of the pixels which differ in
+ * @changes.
+ *
+ * Returns: %TRUE if any pixel changed, %FALSE if none did, or if @async
+ *          was canceled.
+ */
+static gboolean
+gimp_line_art_find_changes (GeglBuffer    *buffer,
+                            GeglBuffer    *previous,
+                            GeglRectangle *changes,
+                            GimpAsync     *async)
+{
+  GeglBufferIterator *gi;
+  gint                bpp;
+  gint                x1 = G_MAXINT;
+  gint                y1 = G_MAXINT;
+  gint                x2 = G_MININT;
+  gint                y2 = G_MININT;
+
+  bpp = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (buffer));
+
+  gi = gegl_buffer_iterator_new (buffer, NULL, 0, NULL,
+                                 GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
+  gegl_buffer_iterator_add (gi, previous, NULL, 0, NULL,
+                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   while (gegl_buffer_iterator_next (gi))
     {
-      guchar *data = (guchar*) gi->items[0].data;
-      gint    k;
+      const guchar  *data     = gi->items[0].data;
+      const guchar  *old_data = gi->items[1].data;
+      GeglRectangle *roi      = &gi->items[0].roi;
+      gint           stride   = roi->width * bpp;
+      gint           y;
 
       if (gimp_async_is_canceled (async))
         {
@@ -1034,23 +1408,487 @@ gimp_line_art_close (GeglBuffer  *buffer,
 
           gimp_async_abort (async);
 
-          goto end1;
+          return FALSE;
         }
 
-      for (k = 0; k < gi->length; k++)
+      for (y = 0; y < roi->height; y++)
         {
-          if (! select_transparent)
-            /* Negate the value. */
-            *data = max_value - *data;
-          /* Apply a threshold. */
-          if (*data > (guchar) (255.0f * (1.0f - stroke_threshold)))
-            *data = 1;
-          else
-            *data = 0;
-          data++;
+          if (memcmp (data, old_data, stride))
+            {
+              gint left  = 0;
+              gint right = roi->width - 1;
+
+              while (! memcmp (data + left * bpp, old_data + left * bpp, bpp))
+                left++;
+              while (! memcmp (data + right * bpp, old_data + right * bpp, bpp))
+                right--;
+
+              x1 = MIN (x1, roi->x + left);
+              x2 = MAX (x2, roi->x + right + 1);
+              y1 = MIN (y1, roi->y + y);
+              y2 = MAX (y2, roi->y + y + 1);
+            }
+
+          data     += stride;
+          old_data += stride;
+        }
+    }
+
+  if (x1 >= x2)
+    return FALSE;
+
+  gegl_rectangle_set (changes, x1, y1, x2 - x1, y2 - y1);
+
+  return TRUE;
+}
+
+/* Flood fills the not yet visited pixels of value @value in @pixels,
+ * starting at @index, and marks them visited by setting their
+ * @visited bit.  Stroke pixels are 8-connected, like when denoising,
+ * and other pixels 4-connected, like when measuring regions.  The
+ * bounding box of the filled pixels is added to @bounds, if not %NULL.
+ *
+ * Returns: the number of filled pixels.
+ */
+static gint64
+gimp_line_art_fill_component (guchar        *pixels,
+                              gint           width,
+                              gint           height,
+                              gint           index,
+                              guchar         value,
+                              guchar         visited,
+                              GArray        *stack,
+                              GeglRectangle *bounds)
+{
+  static const gint dx[8] = { +1, -1,  0,  0, +1, +1, -1, -1 };
+  static const gint dy[8] = {  0,  0, +1, -1, +1, -1, +1, -1 };
+
+  gint   n_neighbors = value == 1 ? 8 : 4;
+  gint64 count       = 0;
+  gint   x1          = G_MAXINT;
+  gint   y1          = G_MAXINT;
+  gint   x2          = G_MININT;
+  gint   y2          = G_MININT;
+
+  pixels[index] |= visited;
+  g_array_append_val (stack, index);
+
+  while (stack->len > 0)
+    {
+      gint x, y;
+      gint i;
+
+      index = g_array_index (stack, gint, stack->len - 1);
+      g_array_set_size (stack, stack->len - 1);
+
+      x = index % width;
+      y = index / width;
+
+      x1 = MIN (x1, x);
+      y1 = MIN (y1, y);
+      x2 = MAX (x2, x + 1);
+      y2 = MAX (y2, y + 1);
+
+      count++;
+
+      for (i = 0; i < n_neighbors; i++)
+        {
+          gint nx = x + dx[i];
+          gint ny = y + dy[i];
+          gint n;
+
+          if (nx < 0 || nx >= width || ny < 0 || ny >= height)
+            continue;
+
+          n = nx + ny * width;
+
+          if ((pixels[n] & ~visited) == value && ! (pixels[n] & visited))
+            {
+              pixels[n] |= visited;
+              g_array_append_val (stack, n);
+            }
         }
     }
 
+  if (bounds)
+    gegl_rectangle_bounding_box (bounds, bounds,
+                                 GEGL_RECTANGLE (x1, y1, x2 - x1, y2 - y1));
+
+  return count;
+}
+
+/* Grows @area until there are no stroke pixels within UPDATE_BORDER
+ * pixels around it, by adding the whole stroke components found
+ * there.  The stroke components the area then contains are complete,
+ * and far enough from the others, for the denoising, the end points
+ * and the normals to be the same as in the whole line art.
+ *
+ * Returns: %FALSE if the area grew too big for an update to be any
+ *          faster than closing the whole line art again, or if @async
+ *          was canceled.
+ */
+static gboolean
+gimp_line_art_complete_area (LineArtData   *data,
+                             gboolean       transparent,
+                             guchar         max_value,
+                             GeglRectangle *area,
+                             GimpAsync     *async)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (data->buffer);
+  GeglBuffer          *strokes;
+  guchar              *pixels;
+  GArray              *stack;
+  GeglRectangle        rect;
+  gboolean             grown;
+  gboolean             complete = TRUE;
+
+  strokes = gimp_line_art_binarize (data->buffer, transparent, max_value,
+                                    data->threshold, async);
+  if (! strokes)
+    return FALSE;
+
+  pixels = g_new (guchar, (gsize) extent->width * extent->height);
+  gegl_buffer_get (strokes, extent, 1.0, NULL, pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_object_unref (strokes);
+
+  stack = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  rect    = *area;
+  rect.x -= extent->x;
+  rect.y -= extent->y;
+
+  do
+    {
+      GeglRectangle border;
+      GeglRectangle bounds = rect;
+      gint          x, y;
+
+      grown = FALSE;
+
+      gegl_rectangle_intersect (&border,
+                                GEGL_RECTANGLE (rect.x - UPDATE_BORDER,
+                                                rect.y - UPDATE_BORDER,
+                                                rect.width  + 2 * UPDATE_BORDER,
+                                                rect.height + 2 * UPDATE_BORDER),
+                                GEGL_RECTANGLE (0, 0,
+                                                extent->width, extent->height));
+
+      for (y = border.y; y < border.y + border.height; y++)
+        {
+          for (x = border.x; x < border.x + border.width; x++)
+            {
+              gint index = x + y * extent->width;
+
+              if (x == rect.x && y >= rect.y && y < rect.y + rect.height)
+                {
+                  /* skip the inside of the area  */
+                  x += rect.width - 1;
+                  continue;
+                }
+
+              if (pixels[index] == 1)
+                {
+                  gimp_line_art_fill_component (pixels,
+                                                extent->width, extent->height,
+                                                index, 1, 2, stack, &bounds);
+                  grown = TRUE;
+                }
+            }
+        }
+
+      if (gimp_async_is_canceled (async))
+        {
+          gimp_async_abort (async);
+
+          complete = FALSE;
+          break;
+        }
+
+      rect = bounds;
+
+      if ((gint64) rect.width * rect.height >
+          (gint64) extent->width * extent->height / 2)
+        {
+          complete = FALSE;
+          break;
+        }
+    }
+  while (grown);
+
+  g_array_free (stack, TRUE);
+  g_free (pixels);
+
+  if (complete)
+    {
+      gegl_rectangle_set (area,
+                          extent->x + rect.x, extent->y + rect.y,
+                          rect.width, rect.height);
+    }
+
+  return complete;
+}
+
+/* Returns whether a region of @closed, the closed line art of @area,
+ * which crosses an edge of @area other than the edges of @extent, is
+ * smaller within @area than the regions the closure measures, in which
+ * case the closure may have judged it differently than it would have
+ * in the whole line art.
+ */
+static gboolean
+gimp_line_art_has_clipped_regions (GeglBuffer          *closed,
+                                   const GeglRectangle *area,
+                                   const GeglRectangle *extent)
+{
+  gint      width   = area->width;
+  gint      height  = area->height;
+  gboolean  left    = area->x > extent->x;
+  gboolean  right   = area->x + width < extent->x + extent->width;
+  gboolean  top     = area->y > extent->y;
+  gboolean  bottom  = area->y + height < extent->y + extent->height;
+  gboolean  clipped = FALSE;
+  guchar   *pixels;
+  GArray   *stack;
+  gint      x, y;
+
+  pixels = g_new (guchar, (gsize) width * height);
+  gegl_buffer_get (closed, GEGL_RECTANGLE (0, 0, width, height), 1.0,
+                   NULL, pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  stack = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  for (y = 0; y < height && ! clipped; y++)
+    {
+      for (x = 0; x < width && ! clipped; x++)
+        {
+          gint index = x + y * width;
+
+          if (! ((top    && y == 0)          ||
+                 (bottom && y == height - 1) ||
+                 (left   && x == 0)          ||
+                 (right  && x == width - 1)))
+            {
+              continue;
+            }
+
+          if (pixels[index] == 0)
+            {
+              gint64 count;
+
+              count = gimp_line_art_fill_component (pixels, width, height,
+                                                    index, 0, 4,
+                                                    stack, NULL);
+
+              clipped = count < CREATED_REGIONS_MINIMUM_AREA;
+            }
+        }
+    }
+
+  g_array_free (stack, TRUE);
+  g_free (pixels);
+
+  return clipped;
+}
+
+/* Updates the closed line art of @data->previous around @changes, by
+ * closing the line art of the part of the input which can affect the
+ * pixels within the maximum closure length of the changes, and pasting
+ * the result over the previous one.  Splines and segments are searched
+ * for between end points which can be at most the maximum closure
+ * length apart, so the closure doesn't depend on the rest of the input.
+ * The part of the input is grown until the strokes it touches are
+ * complete, and left to a full recompute if the regions crossing its
+ * edges could be measured differently by the closure.
+ *
+ * Returns: the updated result, or %NULL if the changes are too big for
+ *          the update to be any faster than closing the whole line art
+ *          again, if a region crosses the edges of the updated part, or
+ *          if @async was canceled.
+ */
+static LineArtResult *
+gimp_line_art_update (LineArtData         *data,
+                      gboolean             transparent,
+                      guchar               max_value,
+                      const GeglRectangle *changes,
+                      GimpAsync           *async)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (data->buffer);
+  GeglRectangle        area;
+  GeglRectangle        update;
+  GeglBuffer          *buffer;
+  GeglBuffer          *area_closed;
+  GeglBuffer          *closed;
+  gfloat              *distmap;
+  gint                 margin;
+
+  margin = UPDATE_MARGIN;
+
+  if (data->automatic_closure)
+    margin += MAX (data->spline_max_len, data->segment_max_len);
+
+  /* The pixels within the margin of the changes are updated, and
+   * closing them needs the pixels within the margin around them.
+   */
+  update = *changes;
+  gegl_rectangle_intersect (&update,
+                            GEGL_RECTANGLE (update.x - margin,
+                                            update.y - margin,
+                                            update.width  + 2 * margin,
+                                            update.height + 2 * margin),
+                            extent);
+
+  gegl_rectangle_intersect (&area,
+                            GEGL_RECTANGLE (update.x - margin,
+                                            update.y - margin,
+                                            update.width  + 2 * margin,
+                                            update.height + 2 * margin),
+                            extent);
+
+  if ((gint64) area.width * area.height >
+      (gint64) extent->width * extent->height / 2)
+    {
+      return NULL;
+    }
+
+  /* Strokes which cross the edges of the area would be closed
+   * differently, so the area is grown to include them.
+   */
+  if (! gimp_line_art_complete_area (data, transparent, max_value,
+                                     &area, async))
+    {
+      return NULL;
+    }
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, area.width, area.height),
+                            gegl_buffer_get_format (data->buffer));
+  gimp_gegl_buffer_copy (data->buffer, &area, GEGL_ABYSS_NONE,
+                         buffer, GEGL_RECTANGLE (0, 0, area.width, area.height));
+
+  area_closed = gimp_line_art_close_data (data, buffer,
+                                          transparent, max_value,
+                                          NULL, async);
+
+  g_object_unref (buffer);
+
+  if (gimp_async_is_stopped (async))
+    return NULL;
+
+  /* So would regions which cross them, in which case the whole line
+   * art is closed again.
+   */
+  if (gimp_line_art_has_clipped_regions (area_closed, &area, extent))
+    {
+      g_object_unref (area_closed);
+
+      return NULL;
+    }
+
+  closed = gimp_gegl_buffer_dup (data->previous->closed);
+  gimp_gegl_buffer_copy (area_closed,
+                         GEGL_RECTANGLE (update.x - area.x,
+                                         update.y - area.y,
+                                         update.width,
+                                         update.height),
+                         GEGL_ABYSS_NONE,
+                         closed, &update);
+
+  g_object_unref (area_closed);
+
+  /* Distances to the closest stroke can change anywhere, they are
+   * cheap enough to compute again.
+   */
+  distmap = gimp_line_art_distmap (closed);
+
+  return line_art_result_new (data, transparent, max_value, closed, distmap);
+}
+
+/**
+ * gimp_line_art_close:
+ * @buffer: the input #GeglBuffer.
+ * @select_transparent: whether we binarize the alpha channel or the
+ *                      luminosity.
+ * @max_value: the biggest luminosity of the whole input, which
+ *             corresponds to the background, if @select_transparent is
+ *             %FALSE.
+ * @stroke_threshold: [0-1] threshold value for detecting stroke pixels
+ *                    (higher values will detect more stroke pixels).
+ * @automatic_closure: whether the closing step should be performed or
+ *                     not. @spline_max_length and @segment_max_len are
+ *                     used only if @automatic_closure is %TRUE.
+ * @spline_max_length: the maximum length for creating splines between
+ *                     end points.
+ * @segment_max_length: the maximum length for creating segments
+ *                      between end points. Unlike splines, segments
+ *                      are straight lines.
+ * @minimal_lineart_area: the minimum size in number pixels for area to
+ *                        be considered as line art.
+ * @normal_estimate_mask_size:
+ * @end_point_rate: threshold to estimate if a curvature is an end-point
+ *                  in [0-1] range value.
+ * @spline_max_angle: the maximum angle between end point normals for
+ *                    creating splines between them.
+ * @end_point_connectivity:
+ * @spline_roundness:
+ * @allow_self_intersections: whether to allow created splines and
+ *                            segments to intersect.
+ * @created_regions_significant_area:
+ * @created_regions_minimum_area:
+ * @small_segments_from_spline_sources:
+ * @closed_distmap: a distance map of the closed line art pixels.
+ * @async: the #GimpAsync associated with the computation
+ *
+ * Creates a binarized version of the strokes of @buffer, detected either
+ * with luminosity (light means background) or alpha values depending on
+ * @select_transparent. This binary version of the strokes will have closed
+ * regions allowing adequate selection of "nearly closed regions".
+ * This algorithm is meant for digital painting (and in particular on the
+ * sketch-only step), and therefore will likely produce unexpected results on
+ * other types of input.
+ *
+ * The algorithm is the first step from the research paper "A Fast and
+ * Efficient Semi-guided Algorithm for Flat Coloring Line-arts", by Sébastian
+ * Fourey, David Tschumperlé, David Revoy.
+ * https://hal.archives-ouvertes.fr/hal-01891876
+ *
+ * Returns: a new #GeglBuffer of format "Y u8" representing the
+ *          binarized @line_art. If @lineart_distmap is not %NULL, a
+ *          newly allocated float buffer is returned, which can be used
+ *          for overflowing created masks later.
+ */
+static GeglBuffer *
+gimp_line_art_close (GeglBuffer  *buffer,
+                     gboolean     select_transparent,
+                     guchar       max_value,
+                     gdouble      stroke_threshold,
+                     gboolean     automatic_closure,
+                     gint         spline_max_length,
+                     gint         segment_max_length,
+                     gint         minimal_lineart_area,
+                     gint         normal_estimate_mask_size,
+                     gfloat       end_point_rate,
+                     gfloat       spline_max_angle,
+                     gint         end_point_connectivity,
+                     gfloat       spline_roundness,
+                     gboolean     allow_self_intersections,
+                     gint         created_regions_significant_area,
+                     gint         created_regions_minimum_area,
+                     gboolean     small_segments_from_spline_sources,
+                     gfloat     **closed_distmap,
+                     GimpAsync   *async)
+{
+  GeglBuffer *closed  = NULL;
+  GeglBuffer *strokes = NULL;
+  gint        width  = gegl_buffer_get_width (buffer);
+  gint        height = gegl_buffer_get_height (buffer);
+  gint        i;
+
+  strokes = gimp_line_art_binarize (buffer, select_transparent, max_value,
+                                    stroke_threshold, async);
+  if (! strokes)
+    return NULL;
+
   /* Denoise (remove small connected components) */
   gimp_lineart_denoise (strokes, minimal_lineart_area, async);
   if (gimp_async_is_stopped (async))
@@ -1061,16 +1899,17 @@ gimp_line_art_close (GeglBuffer  *buffer,
   if (automatic_closure &&
       (spline_max_length > 0 || segment_max_length > 0))
     {
-      GArray     *keypoints           = NULL;
-      GHashTable *visited             = NULL;
-      gfloat     *radii               = NULL;
-      gfloat     *normals             = NULL;
-      gfloat     *curvatures          = NULL;
-      gfloat     *smoothed_curvatures = NULL;
-      gfloat      threshold;
-      gfloat      clamped_threshold;
-      GList      *fill_pixels         = NULL;
-      GList      *iter;
+      GArray         *keypoints           = NULL;
+      GHashTable     *visited             = NULL;
+      gfloat         *radii               = NULL;
+      gfloat         *normals             = NULL;
+      gfloat         *curvatures          = NULL;
+      gfloat         *smoothed_curvatures = NULL;
+      gfloat          threshold;
+      gfloat          clamped_threshold;
+      GList          *fill_pixels         = NULL;
+      GList          *iter;
+      CurvaturesData  end_points;
 
       normals             = g_new0 (gfloat, width * height * 2);
       curvatures          = g_new0 (gfloat, width * height);
@@ -1089,25 +1928,25 @@ gimp_line_art_close (GeglBuffer  *buffer,
         goto end2;
       threshold = 1.0f - end_point_rate;
       clamped_threshold = MAX (0.25f, threshold);
-      for (i = 0; i < width; i++)
-        {
-          gint j;
 
-          if (gimp_async_is_canceled (async))
-            {
-              gimp_async_abort (async);
+      end_points.curvatures          = curvatures;
+      end_points.smoothed_curvatures = smoothed_curvatures;
+      end_points.radii               = radii;
+      end_points.threshold           = threshold;
+      end_points.clamped_threshold   = clamped_threshold;
+      end_points.width               = width;
+      end_points.async               = async;
 
-              goto end2;
-            }
+      gegl_parallel_distribute_range (
+        height, PIXELS_PER_THREAD / width,
+        (GeglParallelDistributeRangeFunc) gimp_lineart_end_points_threshold,
+        &end_points);
 
-          for (j = 0; j < height; j++)
-            {
-              if (smoothed_curvatures[i + j * width] >= (threshold / MAX (1.0f, radii[i + j * width])) ||
-                  curvatures[i + j * width] >= clamped_threshold)
-                curvatures[i + j * width] = 1.0;
-              else
-                curvatures[i + j * width] = 0.0;
-            }
+      if (gimp_async_is_canceled (async))
+        {
+          gimp_async_abort (async);
+
+          goto end2;
         }
       g_clear_pointer (&radii, g_free);
 
@@ -1287,74 +2126,205 @@ gimp_line_art_close (GeglBuffer  *buffer,
           Pixel *p        = iter->data;
           gint   fill_max = created_regions_significant_area - 1;
 
-          if (gimp_async_is_canceled (async))
-            {
-              gimp_async_abort (async);
+          if (gimp_async_is_canceled (async))
+            {
+              gimp_async_abort (async);
+
+              goto end2;
+            }
+
+          /* XXX A best approach would be to generalize
+           * gimp_drawable_bucket_fill() to work on any buffer (the code
+           * is already mostly there) rather than reimplementing a naive
+           * bucket fill.
+           * This is mostly a quick'n dirty first implementation which I
+           * will improve later.
+           */
+          gimp_line_art_simple_fill (closed, (gint) p->x, (gint) p->y, &fill_max);
+        }
+
+ end2:
+      g_list_free_full (fill_pixels, g_free);
+      g_free (normals);
+      g_free (curvatures);
+      g_free (smoothed_curvatures);
+      g_clear_pointer (&radii, g_free);
+      if (keypoints)
+        g_array_free (keypoints, TRUE);
+      g_clear_pointer (&visited, g_hash_table_destroy);
+
+      if (gimp_async_is_stopped (async))
+        goto end1;
+    }
+  else
+    {
+      g_clear_object (&strokes);
+    }
+
+  /* Flooding needs a distance map for closed line art. */
+  if (closed_distmap)
+    *closed_distmap = gimp_line_art_distmap (closed);
+
+ end1:
+  g_clear_object (&strokes);
+
+  if (gimp_async_is_stopped (async))
+    g_clear_object (&closed);
+
+  return closed;
+}
+
+/* Returns a "Y' u8" buffer with the extent of @buffer, where stroke
+ * pixels are 1 and background pixels 0, or %NULL if @async was
+ * canceled.
+ */
+static GeglBuffer *
+gimp_line_art_binarize (GeglBuffer *buffer,
+                        gboolean    select_transparent,
+                        guchar      max_value,
+                        gdouble     stroke_threshold,
+                        GimpAsync  *async)
+{
+  const Babl         *gray_format;
+  GeglBufferIterator *gi;
+  GeglBuffer         *strokes;
+
+  if (select_transparent)
+    /* Keep alpha channel as gray levels */
+    gray_format = babl_format ("A u8");
+  else
+    /* Keep luminance */
+    gray_format = babl_format ("Y' u8");
+
+  /* Transform the line art from any format to gray. */
+  strokes = gegl_buffer_new (gegl_buffer_get_extent (buffer),
+                             gray_format);
+  gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE, strokes, NULL);
+  gegl_buffer_set_format (strokes, babl_format ("Y' u8"));
+
+  /* Make the image binary: 1 is stroke, 0 background */
+  gi = gegl_buffer_iterator_new (strokes, NULL, 0, NULL,
+                                 GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE, 1);
+  while (gegl_buffer_iterator_next (gi))
+    {
+      guchar *data = (guchar*) gi->items[0].data;
+      gint    k;
+
+      if (gimp_async_is_canceled (async))
+        {
+          gegl_buffer_iterator_stop (gi);
+
+          gimp_async_abort (async);
+
+          g_object_unref (strokes);
+
+          return NULL;
+        }
+
+      for (k = 0; k < gi->length; k++)
+        {
+          if (! select_transparent)
+            /* Negate the value. */
+            *data = max_value - *data;
+          /* Apply a threshold. */
+          if (*data > (guchar) (255.0f * (1.0f - stroke_threshold)))
+            *data = 1;
+          else
+            *data = 0;
+          data++;
+        }
+    }
+
+  return strokes;
+}
+
+static gfloat *
+gimp_line_art_distmap (GeglBuffer *closed)
+{
+  GeglNode *graph;
+  GeglNode *input;
+  GeglNode *op;
+  gfloat   *distmap;
+
+  distmap = g_new (gfloat, gegl_buffer_get_width (closed) *
+                           gegl_buffer_get_height (closed));
+
+  graph = gegl_node_new ();
+  input = gegl_node_new_child (graph,
+                               "operation", "gegl:buffer-source",
+                               "buffer", closed,
+                               NULL);
+  op  = gegl_node_new_child (graph,
+                             "operation", "gegl:distance-transform",
+                             "metric",    GEGL_DISTANCE_METRIC_EUCLIDEAN,
+                             "normalize", FALSE,
+                             NULL);
+  gegl_node_link (input, op);
+  gegl_node_blit (op, 1.0, gegl_buffer_get_extent (closed),
+                  NULL, distmap,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+  g_object_unref (graph);
+
+  return distmap;
+}
 
-              goto end2;
-            }
+/* The connected components of the strokes are labeled with a
+ * union-find forest over the pixel indices, where the root of each
+ * tree stores the negated size of its component.
+ */
+static inline gint32
+denoise_find_root (const gint32 *parent,
+                   gint32        index)
+{
+  while (parent[index] >= 0)
+    index = parent[index];
 
-          /* XXX A best approach would be to generalize
-           * gimp_drawable_bucket_fill() to work on any buffer (the code
-           * is already mostly there) rather than reimplementing a naive
-           * bucket fill.
-           * This is mostly a quick'n dirty first implementation which I
-           * will improve later.
-           */
-          gimp_line_art_simple_fill (closed, (gint) p->x, (gint) p->y, &fill_max);
-        }
+  return index;
+}
 
- end2:
-      g_list_free_full (fill_pixels, g_free);
-      g_free (normals);
-      g_free (curvatures);
-      g_free (smoothed_curvatures);
-      g_clear_pointer (&radii, g_free);
-      if (keypoints)
-        g_array_free (keypoints, TRUE);
-      g_clear_pointer (&visited, g_hash_table_destroy);
+static inline void
+denoise_union (gint32 *parent,
+               gint32  index1,
+               gint32  index2)
+{
+  index1 = denoise_find_root (parent, index1);
+  index2 = denoise_find_root (parent, index2);
 
-      if (gimp_async_is_stopped (async))
-        goto end1;
-    }
-  else
-    {
-      g_clear_object (&strokes);
-    }
+  if (index1 == index2)
+    return;
 
-  if (closed_distmap)
+  /* Attach the smaller tree to the bigger one. */
+  if (parent[index1] > parent[index2])
     {
-      GeglNode   *graph;
-      GeglNode   *input;
-      GeglNode   *op;
-
-      /* Flooding needs a distance map for closed line art. */
-      *closed_distmap = g_new (gfloat, width * height);
-
-      graph = gegl_node_new ();
-      input = gegl_node_new_child (graph,
-                                   "operation", "gegl:buffer-source",
-                                   "buffer", closed,
-                                   NULL);
-      op  = gegl_node_new_child (graph,
-                                 "operation", "gegl:distance-transform",
-                                 "metric",    GEGL_DISTANCE_METRIC_EUCLIDEAN,
-                                 "normalize", FALSE,
-                                 NULL);
-      gegl_node_link (input, op);
-      gegl_node_blit (op, 1.0, gegl_buffer_get_extent (closed),
-                      NULL, *closed_distmap,
-                      GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
-      g_object_unref (graph);
-    }
+      gint32 tmp = index1;
 
- end1:
-  g_clear_object (&strokes);
+      index1 = index2;
+      index2 = tmp;
+    }
 
-  if (gimp_async_is_stopped (async))
-    g_clear_object (&closed);
+  parent[index1] += parent[index2];
+  parent[index2]  = index1;
+}
 
-  return closed;
+/* Joins the stroke pixel at (@x, @y) with its 8-connected neighbors on
+ * the previous row.
+ */
+static inline void
+denoise_union_above (const guchar *strokes,
+                     gint32       *parent,
+                     gint          width,
+                     gint          x,
+                     gint          y)
+{
+  gint32 index = x + y * width;
+  gint32 above = index - width;
+
+  if (x > 0 && strokes[above - 1])
+    denoise_union (parent, index, above - 1);
+  if (strokes[above])
+    denoise_union (parent, index, above);
+  if (x < width - 1 && strokes[above + 1])
+    denoise_union (parent, index, above + 1);
 }
 
 static void
@@ -1363,210 +2333,131 @@ gimp_lineart_denoise (GeglBuffer *buffer,
                       GimpAsync  *async)
 {
   /* Keep connected regions with significant area. */
-  GArray   *region;
-  GQueue   *q       = g_queue_new ();
-  gint      width   = gegl_buffer_get_width (buffer);
-  gint      height  = gegl_buffer_get_height (buffer);
-  gboolean *visited = g_new0 (gboolean, width * height);
-  gint      x, y;
+  DenoiseData data;
+  gint        width  = gegl_buffer_get_width (buffer);
+  gint        height = gegl_buffer_get_height (buffer);
+  gint        x, y;
 
-  region = g_array_sized_new (TRUE, TRUE, sizeof (Pixel *), minimum_area);
+  if (width <= 0 || height <= 0)
+    return;
 
-  for (y = 0; y < height; ++y)
-    for (x = 0; x < width; ++x)
-      {
-        guchar has_stroke;
+  data.strokes      = g_new (guchar, (gsize) width * height);
+  data.parent       = g_new (gint32, (gsize) width * height);
+  data.strip_start  = g_new0 (gboolean, height);
+  data.width        = width;
+  data.minimum_area = minimum_area;
+  data.async        = async;
 
-        if (gimp_async_is_canceled (async))
-          {
-            gimp_async_abort (async);
+  gegl_buffer_get (buffer, GEGL_RECTANGLE (0, 0, width, height), 1.0,
+                   NULL, data.strokes, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-            goto end;
-          }
+  /* Label the components within strips of rows in parallel... */
+  gegl_parallel_distribute_range (
+    height, PIXELS_PER_THREAD / width,
+    (GeglParallelDistributeRangeFunc) gimp_lineart_denoise_label,
+    &data);
 
-        gegl_buffer_sample (buffer, x, y, NULL, &has_stroke, NULL,
-                            GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-        if (has_stroke && ! visited[x + y * width])
-          {
-            Pixel *p = g_new (Pixel, 1);
-            gint   regionSize = 0;
+  if (gimp_async_is_canceled (data.async))
+    {
+      gimp_async_abort (async);
 
-            p->x = x;
-            p->y = y;
+      goto end;
+    }
 
-            g_queue_push_tail (q, p);
-            visited[x + y * width] = TRUE;
+  /* ... then join the components across the strips' borders. */
+  for (y = 1; y < height; y++)
+    {
+      const guchar *row = data.strokes + (gsize) y * width;
 
-            while (! g_queue_is_empty (q))
-              {
-                Pixel *p;
-                gint   p2x;
-                gint   p2y;
+      if (! data.strip_start[y])
+        continue;
 
-                if (gimp_async_is_canceled (async))
-                  {
-                    gimp_async_abort (async);
+      for (x = 0; x < width; x++)
+        {
+          if (row[x])
+            denoise_union_above (data.strokes, data.parent, width, x, y);
+        }
+    }
 
-                    goto end;
-                  }
+  gegl_parallel_distribute_range (
+    height, PIXELS_PER_THREAD / width,
+    (GeglParallelDistributeRangeFunc) gimp_lineart_denoise_clear,
+    &data);
 
-                p = (Pixel *) g_queue_pop_head (q);
+  if (gimp_async_is_canceled (data.async))
+    {
+      gimp_async_abort (async);
 
-                p2x = p->x + 1;
-                p2y = p->y;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+      goto end;
+    }
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x +p2y * width] = TRUE;
-                      }
-                  }
-                p2x = p->x - 1;
-                p2y = p->y;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+  gegl_buffer_set (buffer, GEGL_RECTANGLE (0, 0, width, height), 0,
+                   NULL, data.strokes, GEGL_AUTO_ROWSTRIDE);
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x + p2y * width] = TRUE;
-                      }
-                  }
-                p2x = p->x;
-                p2y = p->y - 1;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+ end:
+  g_free (data.strokes);
+  g_free (data.parent);
+  g_free (data.strip_start);
+}
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x + p2y * width] = TRUE;
-                      }
-                  }
-                p2x = p->x;
-                p2y = p->y + 1;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+static void
+gimp_lineart_denoise_label (gsize        offset,
+                            gsize        size,
+                            DenoiseData *data)
+{
+  gint width = data->width;
+  gint y;
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x + p2y * width] = TRUE;
-                      }
-                  }
-                p2x = p->x + 1;
-                p2y = p->y + 1;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+  data->strip_start[offset] = TRUE;
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x + p2y * width] = TRUE;
-                      }
-                  }
-                p2x = p->x - 1;
-                p2y = p->y - 1;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+  for (y = offset; y < (gint) (offset + size); y++)
+    {
+      const guchar *row   = data->strokes + (gsize) y * width;
+      gint32        index = y * width;
+      gint          x;
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x + p2y * width] = TRUE;
-                      }
-                  }
-                p2x = p->x - 1;
-                p2y = p->y + 1;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+      if (gimp_async_is_canceled (data->async))
+        return;
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x + p2y * width] = TRUE;
-                      }
-                  }
-                p2x = p->x + 1;
-                p2y = p->y - 1;
-                if (p2x >= 0 && p2x < width && p2y >= 0 && p2y < height)
-                  {
-                    gegl_buffer_sample (buffer, p2x, p2y, NULL, &has_stroke, NULL,
-                                        GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-                    if (has_stroke && ! visited[p2x + p2y * width])
-                      {
-                        Pixel *p2 = g_new (Pixel, 1);
+      for (x = 0; x < width; x++, index++)
+        {
+          if (! row[x])
+            continue;
 
-                        p2->x = p2x;
-                        p2->y = p2y;
-                        g_queue_push_tail (q, p2);
-                        visited[p2x + p2y * width] = TRUE;
-                      }
-                  }
+          data->parent[index] = -1;
 
-                ++regionSize;
-                if (regionSize < minimum_area)
-                  g_array_append_val (region, *p);
-                g_free (p);
-              }
-            if (regionSize < minimum_area)
-              {
-                Pixel *pixel = (Pixel *) region->data;
-                gint   i = 0;
+          if (x > 0 && row[x - 1])
+            denoise_union (data->parent, index, index - 1);
 
-                for (; i < region->len; i++)
-                  {
-                    guchar val = 0;
-                    gegl_buffer_set (buffer, GEGL_RECTANGLE (pixel->x, pixel->y, 1, 1), 0,
-                                     NULL, &val, GEGL_AUTO_ROWSTRIDE);
-                    pixel++;
-                  }
-              }
-            g_array_remove_range (region, 0, region->len);
-          }
-      }
+          /* Pixels of the strip's first row are joined with the previous
+           * strip afterwards.
+           */
+          if (y > (gint) offset)
+            denoise_union_above (data->strokes, data->parent, width, x, y);
+        }
+    }
+}
 
- end:
-  g_array_free (region, TRUE);
-  g_queue_free_full (q, g_free);
-  g_free (visited);
+static void
+gimp_lineart_denoise_clear (gsize        offset,
+                            gsize        size,
+                            DenoiseData *data)
+{
+  gint32 index = offset * data->width;
+  gint32 end   = (offset + size) * data->width;
+
+  if (gimp_async_is_canceled (data->async))
+    return;
+
+  for (; index < end; index++)
+    {
+      if (data->strokes[index] &&
+          -data->parent[denoise_find_root (data->parent, index)] <
+          data->minimum_area)
+        {
+          data->strokes[index] = 0;
+        }
+    }
 }
 
 static void
@@ -1577,11 +2468,12 @@ gimp_lineart_compute_normals_curvatures (GeglBuffer *mask,
                                          int         normal_estimate_mask_size,
                                          GimpAsync  *async)
 {
-  gfloat  *edgels_curvatures  = NULL;
-  gfloat  *smoothed_curvature;
-  GArray  *es                 = NULL;
-  Edgel  **e;
-  gint     width              = gegl_buffer_get_width (mask);
+  gfloat          *edgels_curvatures  = NULL;
+  gfloat          *smoothed_curvature;
+  GArray          *es                 = NULL;
+  Edgel          **e;
+  CurvaturesData   data;
+  gint             width              = gegl_buffer_get_width (mask);
 
   es = gimp_edgelset_new (mask, async);
   if (gimp_async_is_stopped (async))
@@ -1615,22 +2507,21 @@ gimp_lineart_compute_normals_curvatures (GeglBuffer *mask,
                                                    curvatures[(*e)->x + (*e)->y * width]);
       e++;
     }
-  for (int y = 0; y < gegl_buffer_get_height (mask); ++y)
-    {
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
 
-          goto end;
-        }
+  data.normals = normals;
+  data.width   = width;
+  data.async   = async;
 
-      for (int x = 0; x < gegl_buffer_get_width (mask); ++x)
-        {
-          const float _angle = atan2f (normals[(x + y * width) * 2 + 1],
-                                       normals[(x + y * width) * 2]);
-          normals[(x + y * width) * 2] = cosf (_angle);
-          normals[(x + y * width) * 2 + 1] = sinf (_angle);
-        }
+  gegl_parallel_distribute_range (
+    gegl_buffer_get_height (mask), PIXELS_PER_THREAD / width,
+    (GeglParallelDistributeRangeFunc) gimp_lineart_normalize_normals,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_async_abort (async);
+
+      goto end;
     }
 
   /* Smooth curvatures on edgels, then take maximum on each pixel. */
@@ -1659,39 +2550,84 @@ gimp_lineart_compute_normals_curvatures (GeglBuffer *mask,
     g_array_free (es, TRUE);
 }
 
+static void
+gimp_lineart_normalize_normals (gsize           offset,
+                                gsize           size,
+                                CurvaturesData *data)
+{
+  gfloat *normal = data->normals + offset * data->width * 2;
+  gsize   n      = size * data->width;
+
+  if (gimp_async_is_canceled (data->async))
+    return;
+
+  while (n--)
+    {
+      const float _angle = atan2f (normal[1], normal[0]);
+
+      normal[0] = cosf (_angle);
+      normal[1] = sinf (_angle);
+      normal += 2;
+    }
+}
+
 static gfloat *
 gimp_lineart_get_smooth_curvatures (GArray    *edgelset,
                                     GimpAsync *async)
 {
-  Edgel  **e;
-  gfloat  *smoothed_curvatures = g_new0 (gfloat, edgelset->len);
-  gfloat   weights[9];
-  gfloat   smoothed_curvature;
-  gfloat   weights_sum;
-  gint     idx = 0;
+  EdgelsetData  data;
+  gfloat       *smoothed_curvatures = g_new0 (gfloat, edgelset->len);
+  gfloat        weights[9];
 
   weights[0] = 1.0f;
   for (int i = 1; i <= 8; ++i)
     weights[i] = expf (-(i * i) / 30.0f);
 
-  e = (Edgel **) edgelset->data;
-  while (*e)
+  data.set                 = edgelset;
+  data.weights             = weights;
+  data.smoothed_curvatures = smoothed_curvatures;
+  data.async               = async;
+
+  gegl_parallel_distribute_range (
+    edgelset->len, EDGELS_PER_THREAD,
+    (GeglParallelDistributeRangeFunc) gimp_lineart_smooth_curvatures_func,
+    &data);
+
+  if (gimp_async_is_canceled (async))
     {
-      Edgel *edgel_before = g_array_index (edgelset, Edgel*, (*e)->previous);
-      Edgel *edgel_after  = g_array_index (edgelset, Edgel*, (*e)->next);
-      int    n = 5;
-      int    i = 1;
+      gimp_async_abort (async);
 
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
+      g_free (smoothed_curvatures);
 
-          g_free (smoothed_curvatures);
+      return NULL;
+    }
 
-          return NULL;
-        }
+  return smoothed_curvatures;
+}
+
+static void
+gimp_lineart_smooth_curvatures_func (gsize         offset,
+                                     gsize         size,
+                                     EdgelsetData *data)
+{
+  GArray       *edgelset = data->set;
+  const gfloat *weights  = data->weights;
+  gsize         idx;
 
-      smoothed_curvature = (*e)->curvature;
+  for (idx = offset; idx < offset + size; idx++)
+    {
+      Edgel  *e            = g_array_index (edgelset, Edgel*, idx);
+      Edgel  *edgel_before = g_array_index (edgelset, Edgel*, e->previous);
+      Edgel  *edgel_after  = g_array_index (edgelset, Edgel*, e->next);
+      gfloat  smoothed_curvature;
+      gfloat  weights_sum;
+      int     n = 5;
+      int     i = 1;
+
+      if ((idx - offset) % 1024 == 0 && gimp_async_is_canceled (data->async))
+        return;
+
+      smoothed_curvature = e->curvature;
       weights_sum = weights[0];
       while (n-- && (edgel_after != edgel_before))
         {
@@ -1703,12 +2639,29 @@ gimp_lineart_get_smooth_curvatures (GArray    *edgelset,
           i++;
         }
       smoothed_curvature /= weights_sum;
-      smoothed_curvatures[idx++] = smoothed_curvature;
-
-      e++;
+      data->smoothed_curvatures[idx] = smoothed_curvature;
     }
+}
 
-  return smoothed_curvatures;
+static void
+gimp_lineart_end_points_threshold (gsize           offset,
+                                   gsize           size,
+                                   CurvaturesData *data)
+{
+  gsize i   = offset * data->width;
+  gsize end = (offset + size) * data->width;
+
+  if (gimp_async_is_canceled (data->async))
+    return;
+
+  for (; i < end; i++)
+    {
+      if (data->smoothed_curvatures[i] >= (data->threshold / MAX (1.0f, data->radii[i])) ||
+          data->curvatures[i] >= data->clamped_threshold)
+        data->curvatures[i] = 1.0;
+      else
+        data->curvatures[i] = 0.0;
+    }
 }
 
 /**
@@ -2320,14 +3273,14 @@ static gfloat *
 gimp_lineart_estimate_strokes_radii (GeglBuffer *mask,
                                      GimpAsync  *async)
 {
-  GeglBufferIterator *gi;
-  gfloat             *dist;
-  gfloat             *thickness;
-  GeglNode           *graph;
-  GeglNode           *input;
-  GeglNode           *op;
-  gint                width  = gegl_buffer_get_width (mask);
-  gint                height = gegl_buffer_get_height (mask);
+  RadiiData  data;
+  gfloat    *dist;
+  gfloat    *thickness;
+  GeglNode  *graph;
+  GeglNode  *input;
+  GeglNode  *op;
+  gint       width  = gegl_buffer_get_width (mask);
+  gint       height = gegl_buffer_get_height (mask);
 
   /* Compute a distance map for the line art. */
   dist = g_new (gfloat, width * height);
@@ -2348,7 +3301,41 @@ gimp_lineart_estimate_strokes_radii (GeglBuffer *mask,
   g_object_unref (graph);
 
   thickness = g_new0 (gfloat, width * height);
-  gi = gegl_buffer_iterator_new (mask, NULL, 0, NULL,
+
+  data.mask      = mask;
+  data.dist      = dist;
+  data.thickness = thickness;
+  data.width     = width;
+  data.height    = height;
+  data.async     = async;
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (mask), PIXELS_PER_THREAD, GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) gimp_lineart_estimate_strokes_radii_area,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    gimp_async_abort (async);
+
+  g_free (dist);
+
+  if (gimp_async_is_stopped (async))
+    g_clear_pointer (&thickness, g_free);
+
+  return thickness;
+}
+
+static void
+gimp_lineart_estimate_strokes_radii_area (const GeglRectangle *area,
+                                          RadiiData           *data)
+{
+  GeglBufferIterator *gi;
+  const gfloat       *dist      = data->dist;
+  gfloat             *thickness = data->thickness;
+  gint                width     = data->width;
+  gint                height    = data->height;
+
+  gi = gegl_buffer_iterator_new (data->mask, area, 0, NULL,
                                  GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
   while (gegl_buffer_iterator_next (gi))
     {
@@ -2360,13 +3347,11 @@ gimp_lineart_estimate_strokes_radii (GeglBuffer *mask,
       gint    x;
       gint    y;
 
-      if (gimp_async_is_canceled (async))
+      if (gimp_async_is_canceled (data->async))
         {
           gegl_buffer_iterator_stop (gi);
 
-          gimp_async_abort (async);
-
-          goto end;
+          return;
         }
 
       for (y = starty; y < endy; y++)
@@ -2460,14 +3445,6 @@ gimp_lineart_estimate_strokes_radii (GeglBuffer *mask,
             m++;
           }
     }
-
- end:
-  g_free (dist);
-
-  if (gimp_async_is_stopped (async))
-    g_clear_pointer (&thickness, g_free);
-
-  return thickness;
 }
 
 static void
@@ -2815,11 +3792,10 @@ gimp_edgelset_smooth_normals (GArray    *set,
                               int        mask_size,
                               GimpAsync *async)
 {
+  EdgelsetData data;
   const gfloat sigma = mask_size * 0.775;
   const gfloat den   = 2 * sigma * sigma;
   gfloat       weights[65];
-  GimpVector2  smoothed_normal;
-  gint         i;
 
   gimp_assert (mask_size <= 65);
 
@@ -2827,31 +3803,53 @@ gimp_edgelset_smooth_normals (GArray    *set,
   for (int i = 1; i <= mask_size; ++i)
     weights[i] = expf (-(i * i) / den);
 
-  for (i = 0; i < set->len; i++)
+  data.set       = set;
+  data.weights   = weights;
+  data.mask_size = mask_size;
+  data.async     = async;
+
+  /* Each edgel's normal only depends on the directions of its
+   * neighbors, which are not modified.
+   */
+  gegl_parallel_distribute_range (
+    set->len, EDGELS_PER_THREAD,
+    (GeglParallelDistributeRangeFunc) gimp_edgelset_normals_func,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    gimp_async_abort (async);
+}
+
+static void
+gimp_edgelset_normals_func (gsize         offset,
+                            gsize         size,
+                            EdgelsetData *data)
+{
+  GArray      *set = data->set;
+  GimpVector2  smoothed_normal;
+  gsize        i;
+
+  for (i = offset; i < offset + size; i++)
     {
       Edgel *it           = g_array_index (set, Edgel*, i);
       Edgel *edgel_before = g_array_index (set, Edgel*, it->previous);
       Edgel *edgel_after  = g_array_index (set, Edgel*, it->next);
-      int    n = mask_size;
-      int    i = 1;
-
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
+      int    n = data->mask_size;
+      int    j = 1;
 
-          return;
-        }
+      if ((i - offset) % 1024 == 0 && gimp_async_is_canceled (data->async))
+        return;
 
       smoothed_normal = Direction2Normal[it->direction];
       while (n-- && (edgel_after != edgel_before))
         {
           smoothed_normal = gimp_vector2_add_val (smoothed_normal,
-                                                  gimp_vector2_mul_val (Direction2Normal[edgel_before->direction], weights[i]));
+                                                  gimp_vector2_mul_val (Direction2Normal[edgel_before->direction], data->weights[j]));
           smoothed_normal = gimp_vector2_add_val (smoothed_normal,
-                                                  gimp_vector2_mul_val (Direction2Normal[edgel_after->direction], weights[i]));
+                                                  gimp_vector2_mul_val (Direction2Normal[edgel_after->direction], data->weights[j]));
           edgel_before = g_array_index (set, Edgel *, edgel_before->previous);
           edgel_after  = g_array_index (set, Edgel *, edgel_after->next);
-          ++i;
+          ++j;
         }
       gimp_vector2_normalize (&smoothed_normal);
       it->x_normal = smoothed_normal.x;
@@ -2863,9 +3861,29 @@ static void
 gimp_edgelset_compute_curvature (GArray    *set,
                                  GimpAsync *async)
 {
-  gint i;
+  EdgelsetData data;
+
+  data.set   = set;
+  data.async = async;
+
+  gegl_parallel_distribute_range (
+    set->len, EDGELS_PER_THREAD,
+    (GeglParallelDistributeRangeFunc) gimp_edgelset_curvature_func,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    gimp_async_abort (async);
+}
+
+static void
+gimp_edgelset_curvature_func (gsize         offset,
+                              gsize         size,
+                              EdgelsetData *data)
+{
+  GArray *set = data->set;
+  gsize   i;
 
-  for (i = 0; i < set->len; i++)
+  for (i = offset; i < offset + size; i++)
     {
       Edgel       *it       = g_array_index (set, Edgel*, i);
       Edgel       *previous = g_array_index (set, Edgel *, it->previous);
@@ -2879,12 +3897,8 @@ gimp_edgelset_compute_curvature (GArray    *set,
 
       it->curvature = (crossp > 0.0f) ? c : -c;
 
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
-
-          return;
-        }
+      if ((i - offset) % 1024 == 0 && gimp_async_is_canceled (data->async))
+        return;
     }
 }
 
@@ -2894,26 +3908,48 @@ gimp_edgelset_build_graph (GArray     *set,
                            GHashTable *edgel2index,
                            GimpAsync  *async)
 {
-  Edgel edgel;
-  gint  i;
+  EdgelsetData data;
+
+  data.set         = set;
+  data.buffer      = buffer;
+  data.edgel2index = edgel2index;
+  data.async       = async;
+
+  /* Borders are closed, so each edgel is the next one of exactly one
+   * other edgel, and the edgels' links can be set in parallel.
+   */
+  gegl_parallel_distribute_range (
+    set->len, EDGELS_PER_THREAD,
+    (GeglParallelDistributeRangeFunc) gimp_edgelset_graph_func,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    gimp_async_abort (async);
+}
+
+static void
+gimp_edgelset_graph_func (gsize         offset,
+                          gsize         size,
+                          EdgelsetData *data)
+{
+  GArray *set = data->set;
+  Edgel   edgel;
+  gsize   i;
 
-  for (i = 0; i < set->len; i++)
+  for (i = offset; i < offset + size; i++)
     {
       Edgel *neighbor;
       Edgel *it = g_array_index (set, Edgel *, i);
       guint  neighbor_pos;
 
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
-
-          return;
-        }
+      if ((i - offset) % 1024 == 0 && gimp_async_is_canceled (data->async))
+        return;
 
-      gimp_edgelset_next8 (buffer, it, &edgel);
+      gimp_edgelset_next8 (data->buffer, it, &edgel);
 
-      gimp_assert (g_hash_table_contains (edgel2index, &edgel));
-      neighbor_pos = GPOINTER_TO_UINT (g_hash_table_lookup (edgel2index, &edgel));
+      gimp_assert (g_hash_table_contains (data->edgel2index, &edgel));
+      neighbor_pos = GPOINTER_TO_UINT (g_hash_table_lookup (data->edgel2index,
+                                                            &edgel));
       it->next = neighbor_pos;
       neighbor = g_array_index (set, Edgel *, neighbor_pos);
       neighbor->previous = i;
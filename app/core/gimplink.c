@@ -30,12 +30,18 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-apply-operation.h"
+
 #include "gimp.h"
+#include "gimp-priorities.h"
+#include "gimp-utils.h"
+#include "gimpasync.h"
+#include "gimpcancelable.h"
 #include "gimpimage.h"
 #include "gimplink.h"
 #include "gimpmarshal.h"
-#include "gimppickable.h"
-#include "gimpprojection.h"
+#include "gimpprojectable.h"
+#include "gimpwaitable.h"
 
 #include "file/file-open.h"
 
@@ -57,6 +63,58 @@ enum
   LAST_SIGNAL
 };
 
+/*  the proxy is rendered at 1/LINK_PROXY_SCALE of the image size, for
+ *  images of at least LINK_PROXY_MIN_AREA pixels
+ */
+#define LINK_PROXY_SCALE      8
+#define LINK_PROXY_MIN_AREA   (2048 * 2048)
+
+/*  approximate number of pixels rendered per idle iteration  */
+#define LINK_RENDER_CHUNK     (1024 * 1024)
+
+
+typedef enum
+{
+  LINK_CACHE_LOAD,
+  LINK_CACHE_PROXY,
+  LINK_CACHE_RENDER,
+  LINK_CACHE_DONE
+} LinkCacheStage;
+
+/*  a decoded file, shared by all the links to the same version of it  */
+typedef struct
+{
+  gint                 ref_count;
+  gchar               *key;        /* NULL when not in the cache */
+
+  Gimp                *gimp;
+  GFile               *file;
+  gint                 width;
+  gint                 height;
+  gboolean             keep_ratio;
+  GimpProgress        *progress;
+
+  GimpAsync           *async;
+  LinkCacheStage       stage;
+  gboolean             busy;
+  GimpImage           *image;
+  gint                 render_y;
+
+  GList               *links;      /* links waiting for the decode */
+
+  GeglBuffer          *proxy;
+  GeglBuffer          *buffer;
+  GError              *error;
+
+  gboolean             is_vector;
+  gint                 image_width;
+  gint                 image_height;
+  GimpImageBaseType    base_type;
+  GimpPrecision        precision;
+  GimpPlugInProcedure *load_proc;
+  const gchar         *mime_type;
+} GimpLinkCacheEntry;
+
 struct _GimpLinkPrivate
 {
   Gimp                *gimp;
@@ -77,33 +135,58 @@ struct _GimpLinkPrivate
   GimpPrecision        precision;
   GimpPlugInProcedure *load_proc;
   const gchar         *mime_type;
-};
 
-static void       gimp_link_finalize          (GObject           *object);
-static void       gimp_link_get_property      (GObject           *object,
-                                               guint              property_id,
-                                               GValue            *value,
-                                               GParamSpec        *pspec);
-static void       gimp_link_set_property      (GObject           *object,
-                                               guint              property_id,
-                                               const GValue      *value,
-                                               GParamSpec        *pspec);
-
-static void       gimp_link_file_changed      (GFileMonitor      *monitor,
-                                               GFile             *file,
-                                               GFile             *other_file,
-                                               GFileMonitorEvent  event_type,
-                                               GimpLink          *link);
-static gboolean   gimp_link_emit_changed      (gpointer           data);
-
-static void       gimp_link_update_buffer     (GimpLink          *link,
-                                               GimpProgress      *progress,
-                                               GError           **error);
-static void       gimp_link_start_monitoring  (GimpLink          *link);
-static gchar    * gimp_link_get_relative_path (GimpLink          *link,
-                                               GFile             *parent,
-                                               gint               n_back);
+  GimpLinkCacheEntry  *entry;
+};
 
+static void                 gimp_link_finalize            (GObject            *object);
+static void                 gimp_link_get_property        (GObject            *object,
+                                                           guint               property_id,
+                                                           GValue             *value,
+                                                           GParamSpec         *pspec);
+static void                 gimp_link_set_property        (GObject            *object,
+                                                           guint               property_id,
+                                                           const GValue       *value,
+                                                           GParamSpec         *pspec);
+
+static void                 gimp_link_file_changed        (GFileMonitor       *monitor,
+                                                           GFile              *file,
+                                                           GFile              *other_file,
+                                                           GFileMonitorEvent   event_type,
+                                                           GimpLink           *link);
+static gboolean             gimp_link_emit_changed        (gpointer            data);
+
+static void                 gimp_link_update_buffer       (GimpLink           *link,
+                                                           GimpProgress       *progress,
+                                                           GError            **error);
+static gboolean             gimp_link_update_buffer_async (GimpLink           *link);
+static void                 gimp_link_set_entry           (GimpLink           *link,
+                                                           GimpLinkCacheEntry *entry);
+static void                 gimp_link_apply_entry         (GimpLink           *link);
+static void                 gimp_link_start_monitoring    (GimpLink           *link);
+static gchar              * gimp_link_get_relative_path   (GimpLink           *link,
+                                                           GFile              *parent,
+                                                           gint                n_back);
+
+static GimpLinkCacheEntry * gimp_link_cache_lookup        (Gimp               *gimp,
+                                                           GFile              *file,
+                                                           gint                width,
+                                                           gint                height,
+                                                           gboolean            keep_ratio,
+                                                           GimpProgress       *progress,
+                                                           gboolean            synchronous);
+static gchar              * gimp_link_cache_get_key       (GFile              *file,
+                                                           gint                width,
+                                                           gint                height,
+                                                           gboolean            keep_ratio);
+static GimpLinkCacheEntry * gimp_link_cache_entry_ref     (GimpLinkCacheEntry *entry);
+static void                 gimp_link_cache_entry_unref   (GimpLinkCacheEntry *entry);
+static void                 gimp_link_cache_run           (GimpAsync          *async,
+                                                           GimpLinkCacheEntry *entry);
+static void                 gimp_link_cache_load          (GimpLinkCacheEntry *entry);
+static void                 gimp_link_cache_render_proxy  (GimpLinkCacheEntry *entry);
+static void                 gimp_link_cache_render        (GimpLinkCacheEntry *entry);
+static void                 gimp_link_cache_notify        (GimpLinkCacheEntry *entry);
 
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpLink, gimp_link, GIMP_TYPE_OBJECT)
@@ -114,6 +197,9 @@ static guint       link_signals[LAST_SIGNAL] = { 0 };
 
 static GParamSpec *link_props[N_PROPS]       = { NULL, };
 
+/*  process-wide, and weak: entries are owned by the links using them  */
+static GHashTable *link_cache                = NULL;
+
 static void
 gimp_link_class_init (GimpLinkClass *klass)
 {
@@ -161,6 +247,7 @@ gimp_link_init (GimpLink *link)
   link->p->base_type = GIMP_RGB;
   link->p->precision = GIMP_PRECISION_U8_PERCEPTUAL;
   link->p->load_proc = NULL;
+  link->p->entry     = NULL;
 
   link->p->idle_changed_source = 0;
 }
@@ -170,6 +257,14 @@ gimp_link_finalize (GObject *object)
 {
   GimpLink *link = GIMP_LINK (object);
 
+  if (link->p->idle_changed_source)
+    {
+      g_source_remove (link->p->idle_changed_source);
+      link->p->idle_changed_source = 0;
+    }
+
+  gimp_link_set_entry (link, NULL);
+
   g_clear_object (&link->p->file);
   g_clear_object (&link->p->monitor);
   g_clear_object (&link->p->buffer);
@@ -273,11 +368,14 @@ gimp_link_emit_changed (gpointer data)
 {
   GimpLink *link = GIMP_LINK (data);
 
-  gimp_link_update_buffer (link, NULL, NULL);
-
-  g_signal_emit (link, link_signals[CHANGED], 0);
   link->p->idle_changed_source = 0;
 
+  /* The file is decoded in the background. If nothing can be shown
+   * yet, "changed" is emitted by gimp_link_cache_notify() instead.
+   */
+  if (gimp_link_update_buffer_async (link))
+    g_signal_emit (link, link_signals[CHANGED], 0);
+
   return G_SOURCE_REMOVE;
 }
 
@@ -286,83 +384,148 @@ gimp_link_update_buffer (GimpLink      *link,
                          GimpProgress  *progress,
                          GError       **error)
 {
-  GeglBuffer *buffer     = NULL;
-  GError     *real_error = NULL;
+  GimpLinkCacheEntry *entry = NULL;
 
   g_return_if_fail (GIMP_IS_LINK (link));
   g_return_if_fail (error == NULL || *error == NULL);
 
-  link->p->is_vector = FALSE;
+  if (link->p->file)
+    {
+      entry = gimp_link_cache_lookup (link->p->gimp,
+                                      link->p->file,
+                                      link->p->width, link->p->height,
+                                      link->p->keep_ratio,
+                                      progress, TRUE);
+
+      /* Runs the decode to completion, unless another link finished it
+       * already.
+       */
+      gimp_waitable_wait (GIMP_WAITABLE (entry->async));
+    }
+
+  gimp_link_set_entry (link, entry);
+  gimp_link_apply_entry (link);
+
+  if (entry)
+    {
+      if (error && entry->error)
+        *error = g_error_copy (entry->error);
+
+      gimp_link_cache_entry_unref (entry);
+    }
+}
+
+/* Starts updating @link from its file without blocking. Returns TRUE if
+ * @link was updated right away, from a decode shared with other links,
+ * or from its proxy.
+ */
+static gboolean
+gimp_link_update_buffer_async (GimpLink *link)
+{
+  GimpLinkCacheEntry *entry;
+
+  if (! link->p->file)
+    {
+      gimp_link_update_buffer (link, NULL, NULL);
+
+      return TRUE;
+    }
+
+  entry = gimp_link_cache_lookup (link->p->gimp,
+                                  link->p->file,
+                                  link->p->width, link->p->height,
+                                  link->p->keep_ratio,
+                                  NULL, FALSE);
+
+  gimp_link_set_entry (link, entry);
+  gimp_link_cache_entry_unref (entry);
+
+  if (entry->stage == LINK_CACHE_DONE || entry->proxy)
+    {
+      gimp_link_apply_entry (link);
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gimp_link_set_entry (GimpLink           *link,
+                     GimpLinkCacheEntry *entry)
+{
+  if (entry == link->p->entry)
+    return;
+
+  if (link->p->entry)
+    {
+      link->p->entry->links = g_list_remove (link->p->entry->links, link);
+
+      gimp_link_cache_entry_unref (link->p->entry);
+    }
+
+  link->p->entry = entry;
+
+  if (entry)
+    {
+      gimp_link_cache_entry_ref (entry);
+
+      if (entry->stage != LINK_CACHE_DONE)
+        entry->links = g_list_prepend (entry->links, link);
+    }
+}
+
+/* Takes the current state of the link's decode: the final buffer, its
+ * proxy while it is rendered, or the error it failed with.
+ */
+static void
+gimp_link_apply_entry (GimpLink *link)
+{
+  GimpLinkCacheEntry *entry  = link->p->entry;
+  GeglBuffer         *buffer = NULL;
+
   g_clear_error (&link->p->error);
 
-  if (link->p->file)
+  link->p->is_vector = FALSE;
+  link->p->mime_type = NULL;
+
+  if (entry)
     {
-      GimpImage         *image;
-      GimpPDBStatusType  status;
-
-      link->p->mime_type = NULL;
-      image = file_open_image (link->p->gimp,
-                               gimp_get_user_context (link->p->gimp),
-                               progress,
-                               link->p->file,
-                               link->p->width, link->p->height,
-                               link->p->keep_ratio,
-                               FALSE, NULL,
-                               /* XXX We might want interactive opening
-                                * for a first opening (when done through
-                                * GUI), but not for every re-render.
-                                */
-                               GIMP_RUN_NONINTERACTIVE,
-                               &link->p->is_vector,
-                               &status, &link->p->mime_type,
-                               &real_error);
-
-      if (image && status == GIMP_PDB_SUCCESS)
+      if (entry->stage == LINK_CACHE_DONE)
+        buffer = entry->buffer;
+      else
+        buffer = entry->proxy;
+
+      link->p->is_vector = entry->is_vector;
+      link->p->mime_type = entry->mime_type;
+
+      if (buffer)
         {
-          /* If we don't flush the projection first, the buffer may be empty.
-           * I do wonder if the flushing and updating of the link could
-           * not be multi-threaded with gimp_projection_flush() instead,
-           * then notifying the update through signals. For very heavy
-           * images, would it be a better UX? XXX
-           */
-          gimp_projection_flush_now (gimp_image_get_projection (image), TRUE);
-          buffer = gimp_pickable_get_buffer (GIMP_PICKABLE (image));
-          g_object_ref (buffer);
-
-          link->p->base_type = gimp_image_get_base_type (image);
-          link->p->precision = gimp_image_get_precision (image);
-          link->p->width     = gimp_image_get_width (image);
-          link->p->height    = gimp_image_get_height (image);
-          link->p->load_proc = gimp_image_get_load_proc (image);
+          link->p->base_type = entry->base_type;
+          link->p->precision = entry->precision;
+          link->p->width     = entry->image_width;
+          link->p->height    = entry->image_height;
+          link->p->load_proc = entry->load_proc;
         }
-
-      /* Only keep the buffer, free the rest. */
-      g_clear_object (&image);
     }
 
   link->p->broken = (buffer == NULL);
   if (link->p->broken)
     {
-      if (real_error)
-        link->p->error = g_error_copy (real_error);
+      if (entry && entry->error)
+        link->p->error = g_error_copy (entry->error);
       else
         g_set_error_literal (&link->p->error,
                              G_FILE_ERROR, G_FILE_ERROR_FAILED,
                              _("No file was set"));
     }
-
-  if (error)
-    *error = real_error;
   else
-    g_clear_error (&real_error);
-
-  if (buffer)
     {
       /* Keep the old buffer if the link is broken (outdated image is
-       * better than none).
+       * better than none). Cached buffers are shared, and never
+       * written to.
        */
-      g_clear_object (&link->p->buffer);
-      link->p->buffer = buffer;
+      g_set_object (&link->p->buffer, buffer);
     }
 }
 
@@ -456,6 +619,405 @@ gimp_link_get_relative_path (GimpLink *link,
 }
 
 
+/*  decode cache  */
+
+/* Returns the link cache entry for a decode of @file at its current
+ * modification time, starting one if there is none. The decode runs in
+ * idle callbacks: the file's plug-in can only be run from the main
+ * thread, and the image is then rendered in chunks, so that the UI
+ * stays responsive.
+ *
+ * If @synchronous is TRUE, the caller is going to wait for the entry,
+ * so one which is being worked on further up the stack is not returned.
+ */
+static GimpLinkCacheEntry *
+gimp_link_cache_lookup (Gimp         *gimp,
+                        GFile        *file,
+                        gint          width,
+                        gint          height,
+                        gboolean      keep_ratio,
+                        GimpProgress *progress,
+                        gboolean      synchronous)
+{
+  GimpLinkCacheEntry *entry = NULL;
+  gchar              *key;
+
+  key = gimp_link_cache_get_key (file, width, height, keep_ratio);
+
+  if (key && link_cache)
+    {
+      entry = g_hash_table_lookup (link_cache, key);
+
+      if (entry && synchronous && entry->busy)
+        {
+          /* Forget about it, it keeps decoding for its own links. */
+          g_hash_table_remove (link_cache, key);
+          entry->key = NULL;
+          entry      = NULL;
+        }
+    }
+
+  if (entry)
+    {
+      g_free (key);
+
+      return gimp_link_cache_entry_ref (entry);
+    }
+
+  entry = g_slice_new0 (GimpLinkCacheEntry);
+
+  entry->ref_count  = 1;
+  entry->gimp       = gimp;
+  entry->file       = g_object_ref (file);
+  entry->width      = width;
+  entry->height     = height;
+  entry->keep_ratio = keep_ratio;
+  entry->progress   = progress;
+  entry->stage      = LINK_CACHE_LOAD;
+
+  if (key)
+    {
+      if (! link_cache)
+        link_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, NULL);
+
+      entry->key = key;
+      g_hash_table_insert (link_cache, key, entry);
+    }
+
+  /* The job keeps a reference until it stops. */
+  entry->async = gimp_idle_run_async_full (
+    GIMP_PRIORITY_LINK_LOAD_IDLE,
+    (GimpRunAsyncFunc) gimp_link_cache_run,
+    gimp_link_cache_entry_ref (entry),
+    (GDestroyNotify) gimp_link_cache_entry_unref);
+
+  return entry;
+}
+
+/* Returns a key identifying the current version of @file, as decoded
+ * for the given size, or %NULL if the file can't be queried.
+ */
+static gchar *
+gimp_link_cache_get_key (GFile    *file,
+                         gint      width,
+                         gint      height,
+                         gboolean  keep_ratio)
+{
+  GFileInfo *info;
+  gchar     *uri;
+  gchar     *key;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, NULL);
+
+  if (! info)
+    return NULL;
+
+  uri = g_file_get_uri (file);
+
+  key = g_strdup_printf ("%s %" G_GUINT64_FORMAT ".%06u %" G_GOFFSET_FORMAT
+                         " %dx%d%s",
+                         uri,
+                         g_file_info_get_attribute_uint64 (
+                           info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                         g_file_info_get_attribute_uint32 (
+                           info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+                         g_file_info_get_size (info),
+                         width, height,
+                         keep_ratio ? " keep-ratio" : "");
+
+  g_free (uri);
+  g_object_unref (info);
+
+  return key;
+}
+
+static GimpLinkCacheEntry *
+gimp_link_cache_entry_ref (GimpLinkCacheEntry *entry)
+{
+  entry->ref_count++;
+
+  return entry;
+}
+
+static void
+gimp_link_cache_entry_unref (GimpLinkCacheEntry *entry)
+{
+  entry->ref_count--;
+
+  if (entry->ref_count == 1 &&
+      entry->async          &&
+      ! gimp_async_is_stopped (entry->async))
+    {
+      /* Only the job is left, and nobody wants its result anymore. */
+      if (entry->key)
+        {
+          g_hash_table_remove (link_cache, entry->key);
+          entry->key = NULL;
+        }
+
+      /* May free the entry. */
+      gimp_cancelable_cancel (GIMP_CANCELABLE (entry->async));
+    }
+  else if (entry->ref_count == 0)
+    {
+      if (entry->key)
+        g_hash_table_remove (link_cache, entry->key);
+
+      g_clear_object (&entry->async);
+      g_clear_object (&entry->image);
+      g_clear_object (&entry->proxy);
+      g_clear_object (&entry->buffer);
+      g_clear_object (&entry->file);
+      g_clear_error  (&entry->error);
+      g_list_free (entry->links);
+
+      g_slice_free (GimpLinkCacheEntry, entry);
+    }
+}
+
+/* Does one step of the decode of @entry, per idle iteration: loading
+ * the file, rendering the proxy, then rendering the image chunk by
+ * chunk.
+ */
+static void
+gimp_link_cache_run (GimpAsync          *async,
+                     GimpLinkCacheEntry *entry)
+{
+  if (gimp_async_is_canceled (async))
+    {
+      /* Canceled while the plug-in was running. */
+      gimp_async_abort (async);
+      gimp_link_cache_entry_unref (entry);
+
+      return;
+    }
+
+  entry->busy = TRUE;
+
+  switch (entry->stage)
+    {
+    case LINK_CACHE_LOAD:
+      gimp_link_cache_load (entry);
+      break;
+
+    case LINK_CACHE_PROXY:
+      gimp_link_cache_render_proxy (entry);
+      break;
+
+    case LINK_CACHE_RENDER:
+      gimp_link_cache_render (entry);
+      break;
+
+    case LINK_CACHE_DONE:
+      break;
+    }
+
+  entry->busy = FALSE;
+
+  if (entry->stage == LINK_CACHE_DONE)
+    {
+      g_clear_object (&entry->image);
+      g_clear_object (&entry->proxy);
+
+      if (entry->buffer)
+        {
+          gimp_async_finish (async, NULL);
+        }
+      else
+        {
+          /* Don't keep failures around, the next change may fix it. */
+          if (entry->key)
+            {
+              g_hash_table_remove (link_cache, entry->key);
+              entry->key = NULL;
+            }
+
+          gimp_async_abort (async);
+        }
+
+      gimp_link_cache_notify (entry);
+      gimp_link_cache_entry_unref (entry);
+    }
+}
+
+static void
+gimp_link_cache_load (GimpLinkCacheEntry *entry)
+{
+  GimpImage         *image;
+  GimpPDBStatusType  status;
+
+  image = file_open_image (entry->gimp,
+                           gimp_get_user_context (entry->gimp),
+                           entry->progress,
+                           entry->file,
+                           entry->width, entry->height,
+                           entry->keep_ratio,
+                           FALSE, NULL,
+                           /* XXX We might want interactive opening
+                            * for a first opening (when done through
+                            * GUI), but not for every re-render.
+                            */
+                           GIMP_RUN_NONINTERACTIVE,
+                           &entry->is_vector,
+                           &status, &entry->mime_type,
+                           &entry->error);
+
+  entry->progress = NULL;
+
+  if (image && status == GIMP_PDB_SUCCESS)
+    {
+      entry->image        = image;
+      entry->base_type    = gimp_image_get_base_type (image);
+      entry->precision    = gimp_image_get_precision (image);
+      entry->image_width  = gimp_image_get_width (image);
+      entry->image_height = gimp_image_get_height (image);
+      entry->load_proc    = gimp_image_get_load_proc (image);
+
+      entry->buffer =
+        gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                         entry->image_width,
+                                         entry->image_height),
+                         gimp_projectable_get_format (GIMP_PROJECTABLE (image)));
+
+      /* Only worth it for big images, and when somebody shows it. */
+      if (entry->links && ! entry->is_vector &&
+          (gint64) entry->image_width *
+          (gint64) entry->image_height >= LINK_PROXY_MIN_AREA)
+        {
+          entry->stage = LINK_CACHE_PROXY;
+        }
+      else
+        {
+          entry->stage = LINK_CACHE_RENDER;
+        }
+    }
+  else
+    {
+      g_clear_object (&image);
+
+      entry->stage = LINK_CACHE_DONE;
+    }
+}
+
+/* Renders the image at a fraction of its size, which is a lot cheaper
+ * than rendering it fully for images with many layers, and scales it
+ * back up to be shown in the meantime.
+ */
+static void
+gimp_link_cache_render_proxy (GimpLinkCacheEntry *entry)
+{
+  GimpProjectable *projectable = GIMP_PROJECTABLE (entry->image);
+  const Babl      *format      = gegl_buffer_get_format (entry->buffer);
+  GeglBuffer      *buffer;
+  GeglRectangle    rect;
+  guchar          *data;
+
+  rect.x      = 0;
+  rect.y      = 0;
+  rect.width  = (entry->image_width  + LINK_PROXY_SCALE - 1) / LINK_PROXY_SCALE;
+  rect.height = (entry->image_height + LINK_PROXY_SCALE - 1) / LINK_PROXY_SCALE;
+
+  data = g_malloc ((gsize) rect.width * rect.height *
+                   babl_format_get_bytes_per_pixel (format));
+
+  gimp_projectable_begin_render (projectable);
+
+  gegl_node_blit (gimp_projectable_get_graph (projectable),
+                  1.0 / LINK_PROXY_SCALE, &rect,
+                  format, data, GEGL_AUTO_ROWSTRIDE,
+                  GEGL_BLIT_DEFAULT);
+
+  gimp_projectable_end_render (projectable);
+
+  buffer = gegl_buffer_new (&rect, format);
+  gegl_buffer_set (buffer, &rect, 0, format, data, GEGL_AUTO_ROWSTRIDE);
+  g_free (data);
+
+  entry->proxy = gegl_buffer_new (gegl_buffer_get_extent (entry->buffer),
+                                  format);
+
+  gimp_gegl_apply_scale (buffer, NULL, NULL, entry->proxy,
+                         GIMP_INTERPOLATION_LINEAR,
+                         LINK_PROXY_SCALE, LINK_PROXY_SCALE);
+
+  g_object_unref (buffer);
+
+  entry->stage = LINK_CACHE_RENDER;
+
+  gimp_link_cache_notify (entry);
+}
+
+/* Renders the next rows of tiles of the image. */
+static void
+gimp_link_cache_render (GimpLinkCacheEntry *entry)
+{
+  GimpProjectable *projectable = GIMP_PROJECTABLE (entry->image);
+  GeglRectangle    rect;
+  gint             tile_height;
+  gint             n_rows;
+
+  g_object_get (entry->buffer,
+                "tile-height", &tile_height,
+                NULL);
+
+  n_rows = LINK_RENDER_CHUNK / entry->image_width;
+  n_rows = MAX (n_rows / tile_height, 1) * tile_height;
+
+  rect.x      = 0;
+  rect.y      = entry->render_y;
+  rect.width  = entry->image_width;
+  rect.height = MIN (n_rows, entry->image_height - entry->render_y);
+
+  gimp_projectable_begin_render (projectable);
+
+  gegl_node_blit_buffer (gimp_projectable_get_graph (projectable),
+                         entry->buffer, &rect, 0, GEGL_ABYSS_NONE);
+
+  gimp_projectable_end_render (projectable);
+
+  entry->render_y += rect.height;
+
+  if (entry->render_y >= entry->image_height)
+    entry->stage = LINK_CACHE_DONE;
+}
+
+/* Updates the links waiting for @entry, with its proxy, or its final
+ * result.
+ */
+static void
+gimp_link_cache_notify (GimpLinkCacheEntry *entry)
+{
+  GList *links;
+  GList *list;
+
+  links = g_list_copy_deep (entry->links, (GCopyFunc) g_object_ref, NULL);
+
+  if (entry->stage == LINK_CACHE_DONE)
+    g_clear_pointer (&entry->links, g_list_free);
+
+  for (list = links; list; list = g_list_next (list))
+    {
+      GimpLink *link = list->data;
+
+      /* The link may have moved on while another one was updated. */
+      if (link->p->entry == entry)
+        {
+          gimp_link_apply_entry (link);
+
+          g_signal_emit (link, link_signals[CHANGED], 0);
+        }
+    }
+
+  g_list_free_full (links, g_object_unref);
+}
+
+
 /*  public functions  */
 
 /**
@@ -508,7 +1070,8 @@ gimp_link_duplicate (GimpLink *link)
   /* Copy things manually as we do not need to trigger a load. */
   new_link->p->file      = link->p->file ? g_object_ref (link->p->file) : NULL;
 
-  new_link->p->buffer    = link->p->buffer ? gegl_buffer_dup (link->p->buffer) : NULL;
+  /* Link buffers are never written to, so they can be shared. */
+  new_link->p->buffer    = link->p->buffer ? g_object_ref (link->p->buffer) : NULL;
   new_link->p->broken    = link->p->broken;
   new_link->p->error     = link->p->error ? g_error_copy (link->p->error) : NULL;
 
@@ -518,6 +1081,10 @@ gimp_link_duplicate (GimpLink *link)
   new_link->p->base_type = link->p->base_type;
   new_link->p->precision = link->p->precision;
   new_link->p->load_proc = link->p->load_proc;
+  new_link->p->mime_type = link->p->mime_type;
+
+  /* Also get the rest of a decode which is still running. */
+  gimp_link_set_entry (new_link, link->p->entry);
 
   if (new_link->p->file)
     {
@@ -33,6 +33,7 @@
 #include "config/gimpxmlparser.h"
 
 #include "gimp-utils.h"
+#include "gimpdatacache.h"
 #include "gimppalette.h"
 #include "gimppalette-load.h"
 
@@ -1698,6 +1699,102 @@ swatchbooker_load_text (GMarkupParseContext *context,
     }
 }
 
+/* serializes palettes for the palette factory's data cache, palettes
+ * restricted to a format belong to an image and are never cached.
+ */
+gboolean
+gimp_palette_save_to_cache (GimpData   *data,
+                            GByteArray *output)
+{
+  GimpPalette *palette = GIMP_PALETTE (data);
+  GList       *list;
+
+  if (G_OBJECT_TYPE (palette) != GIMP_TYPE_PALETTE || palette->format)
+    return FALSE;
+
+  gimp_data_cache_write_string (output, gimp_object_get_name (palette));
+  gimp_data_cache_write_string (output, gimp_data_get_mime_type (data));
+
+  gimp_data_cache_write_int (output, palette->n_columns);
+  gimp_data_cache_write_int (output, palette->n_colors);
+
+  for (list = palette->colors; list; list = g_list_next (list))
+    {
+      GimpPaletteEntry *entry = list->data;
+
+      gimp_data_cache_write_string (output, entry->name);
+
+      if (! gimp_data_cache_write_color (output, entry->color))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+GimpData *
+gimp_palette_load_from_cache (GimpContext         *context,
+                              GimpDataCacheReader *reader)
+{
+  GimpPalette *palette;
+  gchar       *name;
+  gchar       *mime_type = NULL;
+  gint32       n_columns;
+  gint32       n_colors;
+  gint         i;
+
+  if (! gimp_data_cache_read_string (reader, &name))
+    return NULL;
+
+  if (! name                                           ||
+      ! gimp_data_cache_read_string (reader, &mime_type) ||
+      ! gimp_data_cache_read_int    (reader, &n_columns) ||
+      ! gimp_data_cache_read_int    (reader, &n_colors)  ||
+      n_colors < 0)
+    {
+      g_free (name);
+      g_free (mime_type);
+      return NULL;
+    }
+
+  palette = g_object_new (GIMP_TYPE_PALETTE,
+                          "name",      name,
+                          "mime-type", mime_type,
+                          NULL);
+
+  g_free (name);
+  g_free (mime_type);
+
+  gimp_palette_set_columns (palette, n_columns);
+
+  for (i = 0; i < n_colors; i++)
+    {
+      gchar     *entry_name;
+      GeglColor *color = NULL;
+
+      if (! gimp_data_cache_read_string (reader, &entry_name))
+        break;
+
+      if (! gimp_data_cache_read_color (reader, &color) || ! color)
+        {
+          g_free (entry_name);
+          break;
+        }
+
+      gimp_palette_add_entry (palette, -1, entry_name, color);
+
+      g_free (entry_name);
+      g_object_unref (color);
+    }
+
+  if (i < n_colors)
+    {
+      g_object_unref (palette);
+      return NULL;
+    }
+
+  return GIMP_DATA (palette);
+}
+
 GimpPaletteFileFormat
 gimp_palette_load_detect_format (GFile        *file,
                                  GInputStream *input)
@@ -73,5 +73,10 @@ GList               * gimp_palette_load_sbz           (GimpContext   *context,
                                                        GInputStream  *input,
                                                        GError       **error);
 
+GimpData            * gimp_palette_load_from_cache    (GimpContext         *context,
+                                                       GimpDataCacheReader *reader);
+gboolean              gimp_palette_save_to_cache      (GimpData            *data,
+                                                       GByteArray          *output);
+
 GimpPaletteFileFormat gimp_palette_load_detect_format (GFile         *file,
                                                        GInputStream  *input);
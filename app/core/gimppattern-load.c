@@ -26,6 +26,7 @@
 
 #include "core-types.h"
 
+#include "gimpdatacache.h"
 #include "gimppattern.h"
 #include "gimppattern-header.h"
 #include "gimppattern-load.h"
@@ -244,6 +245,56 @@ gimp_pattern_load_pixbuf (GimpContext   *context,
   return g_list_prepend (NULL, pattern);
 }
 
+gboolean
+gimp_pattern_save_to_cache (GimpData   *data,
+                            GByteArray *output)
+{
+  GimpPattern *pattern = GIMP_PATTERN (data);
+
+  if (G_OBJECT_TYPE (pattern) != GIMP_TYPE_PATTERN)
+    return FALSE;
+
+  gimp_data_cache_write_string (output, gimp_object_get_name (pattern));
+  gimp_data_cache_write_string (output, gimp_data_get_mime_type (data));
+
+  return gimp_data_cache_write_temp_buf (output, pattern->mask);
+}
+
+GimpData *
+gimp_pattern_load_from_cache (GimpContext         *context,
+                              GimpDataCacheReader *reader)
+{
+  GimpPattern *pattern;
+  gchar       *name;
+  gchar       *mime_type = NULL;
+  GimpTempBuf *mask      = NULL;
+
+  if (! gimp_data_cache_read_string (reader, &name))
+    return NULL;
+
+  if (! name                                              ||
+      ! gimp_data_cache_read_string   (reader, &mime_type) ||
+      ! gimp_data_cache_read_temp_buf (reader, &mask)      ||
+      ! mask)
+    {
+      g_free (name);
+      g_free (mime_type);
+      return NULL;
+    }
+
+  pattern = g_object_new (GIMP_TYPE_PATTERN,
+                          "name",      name,
+                          "mime-type", mime_type,
+                          NULL);
+
+  g_free (name);
+  g_free (mime_type);
+
+  pattern->mask = mask;
+
+  return GIMP_DATA (pattern);
+}
+
 
 /* Private functions */
 #define update_last_error() if (last_error) g_clear_error (last_error); last_error = error; error = NULL;
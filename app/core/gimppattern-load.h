@@ -29,3 +29,8 @@ GList * gimp_pattern_load_pixbuf (GimpContext   *context,
                                   GFile         *file,
                                   GInputStream  *input,
                                   GError       **error);
+
+gboolean   gimp_pattern_save_to_cache   (GimpData            *data,
+                                         GByteArray          *output);
+GimpData * gimp_pattern_load_from_cache (GimpContext         *context,
+                                         GimpDataCacheReader *reader);
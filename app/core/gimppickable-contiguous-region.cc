@@ -47,6 +47,18 @@ extern "C"
 #define PIXELS_PER_THREAD \
   (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
 
+#define REGION_TILE_SIZE 256
+
+/* each thread costs as much as a part of a tile */
+#define REGION_TILE_THREAD_COST \
+  (PIXELS_PER_THREAD / (REGION_TILE_SIZE * REGION_TILE_SIZE))
+
+/* offsets of the sides of a tile in its perimeter array */
+#define REGION_TOP(width, height)    0
+#define REGION_BOTTOM(width, height) (width)
+#define REGION_LEFT(width, height)   (2 * (width))
+#define REGION_RIGHT(width, height)  (2 * (width) + (height))
+
 
 typedef struct
 {
@@ -55,6 +67,45 @@ typedef struct
   gint   level;
 } BorderPixel;
 
+typedef struct
+{
+  GeglRectangle  rect;
+  gint           col;
+  gint           row;
+  gboolean       queued;
+  gboolean       scanned;
+
+  gint           first_id;  /* global id of the first border component    */
+  gint           n_border;  /* number of components touching the perimeter */
+  gint          *perimeter; /* border component of each perimeter pixel    */
+} RegionTile;
+
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  GeglBuffer          *mask_buffer;
+  const Babl          *format;
+  const Babl          *diff_format;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gfloat               threshold;
+  gboolean             diagonal_neighbors;
+  const gfloat        *col;
+
+  gint                 seed_x;
+  gint                 seed_y;
+  gint                 seed_col;
+  gint                 seed_row;
+  gint                 seed_label;  /* seed's component in the seed tile    */
+  gint                 seed_border; /* its border index, or -1 if interior  */
+
+  GArray              *parents;     /* union-find over border components    */
+  gboolean            *keep;        /* border components in the seed region */
+} RegionContext;
+
 
 /*  local function prototypes  */
 
@@ -70,37 +121,38 @@ static gfloat   pixel_difference          (const gfloat        *col1,
                                            gboolean             has_alpha,
                                            gboolean             select_transparent,
                                            GimpSelectCriterion  select_criterion);
-static void     push_segment              (GQueue              *segment_queue,
-                                           gint                 y,
-                                           gint                 old_y,
-                                           gint                 start,
-                                           gint                 end,
-                                           gint                 new_y,
-                                           gint                 new_start,
-                                           gint                 new_end);
-static void     pop_segment               (GQueue              *segment_queue,
-                                           gint                *y,
-                                           gint                *old_y,
-                                           gint                *start,
-                                           gint                *end);
-static gboolean find_contiguous_segment   (const gfloat        *col,
-                                           GeglBuffer          *src_buffer,
-                                           GeglSampler         *src_sampler,
-                                           const GeglRectangle *src_extent,
-                                           GeglBuffer          *mask_buffer,
-                                           const Babl          *src_format,
-                                           const Babl          *mask_format,
-                                           gint                 n_components,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gfloat               threshold,
-                                           gint                 initial_x,
-                                           gint                 initial_y,
-                                           gint                *start,
-                                           gint                *end,
-                                           gfloat              *row);
+static gint     region_find               (GArray              *parents,
+                                           gint                 id);
+static void     region_union              (GArray              *parents,
+                                           gint                 id1,
+                                           gint                 id2);
+static gint     region_tile_label         (const gfloat        *diff,
+                                           gint                 width,
+                                           gint                 height,
+                                           gboolean             diagonal_neighbors,
+                                           gint                *labels,
+                                           gint                *parent);
+static gint     region_tile_border        (const gint          *labels,
+                                           gint                 width,
+                                           gint                 height,
+                                           gint                 n_labels,
+                                           gint                *label_border,
+                                           gint                *perimeter);
+static void     region_tile_difference    (RegionContext       *ctx,
+                                           const GeglRectangle *rect,
+                                           gfloat              *diff);
+static void     region_tile_scan          (RegionContext       *ctx,
+                                           RegionTile          *tile);
+static void     region_tile_merge         (RegionContext       *ctx,
+                                           const RegionTile    *tile1,
+                                           const RegionTile    *tile2);
+static gboolean region_tile_reaches       (RegionContext       *ctx,
+                                           const RegionTile    *tile,
+                                           gint                 seed_root,
+                                           gint                 dx,
+                                           gint                 dy);
+static void     region_tile_fill          (RegionContext       *ctx,
+                                           const RegionTile    *tile);
 static void     find_contiguous_region    (GeglBuffer          *src_buffer,
                                            GeglBuffer          *mask_buffer,
                                            const Babl          *format,
@@ -895,178 +947,509 @@ pixel_difference (const gfloat        *col1,
     }
 }
 
+/*  the contiguous region is found tile by tile: each tile labels the
+ *  connected components of its selected pixels on its own, and the
+ *  components which touch the tile's perimeter are then merged with the
+ *  ones of the neighboring tiles, using a union-find over all border
+ *  components.  tiles are processed in rounds, starting at the seed, and
+ *  only the tiles the seed's region reaches are ever looked at, so small
+ *  regions of huge images stay cheap.
+ */
+
+static gint
+region_find (GArray *parents,
+             gint    id)
+{
+  gint *parent = &g_array_index (parents, gint, 0);
+
+  while (parent[id] != id)
+    {
+      parent[id] = parent[parent[id]];
+      id         = parent[id];
+    }
+
+  return id;
+}
+
 static void
-push_segment (GQueue *segment_queue,
-              gint    y,
-              gint    old_y,
-              gint    start,
-              gint    end,
-              gint    new_y,
-              gint    new_start,
-              gint    new_end)
+region_union (GArray *parents,
+              gint    id1,
+              gint    id2)
 {
-  /* To avoid excessive memory allocation (y, old_y, start, end) tuples are
-   * stored in interleaved format:
-   *
-   * [y1] [old_y1] [start1] [end1] [y2] [old_y2] [start2] [end2]
-   */
+  id1 = region_find (parents, id1);
+  id2 = region_find (parents, id2);
+
+  if (id1 < id2)
+    g_array_index (parents, gint, id2) = id1;
+  else if (id2 < id1)
+    g_array_index (parents, gint, id1) = id2;
+}
 
-  if (new_y != old_y)
+static inline gint
+region_tile_label_find (gint *parent,
+                        gint  i)
+{
+  while (parent[i] != i)
     {
-      /* If the new segment's y-coordinate is different than the old (source)
-       * segment's y-coordinate, push the entire segment.
-       */
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_start));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_end));
+      parent[i] = parent[parent[i]];
+      i         = parent[i];
     }
-  else
+
+  return i;
+}
+
+static inline void
+region_tile_label_union (gint *parent,
+                         gint  i,
+                         gint  j)
+{
+  i = region_tile_label_find (parent, i);
+  j = region_tile_label_find (parent, j);
+
+  /* keep the first pixel, in scanline order, as the root, so that the
+   * labels below only depend on the tile's pixels.
+   */
+  if (i < j)
+    parent[j] = i;
+  else if (j < i)
+    parent[i] = j;
+}
+
+/* labels the connected components of the selected pixels of a tile, in
+ * scanline order.  labels[] gets the component of each pixel, starting
+ * at 1, or 0 for unselected pixels.  returns the number of components.
+ */
+static gint
+region_tile_label (const gfloat *diff,
+                   gint          width,
+                   gint          height,
+                   gboolean      diagonal_neighbors,
+                   gint         *labels,
+                   gint         *parent)
+{
+  gint n_labels = 0;
+  gint x, y;
+  gint i;
+
+  for (i = 0; i < width * height; i++)
+    parent[i] = diff[i] != 0.0f ? i : -1;
+
+  for (y = 0, i = 0; y < height; y++)
     {
-      /* Otherwise, only push the set-difference between the new segment and
-       * the source segment (since we've already scanned the source segment.)
-       * Note that the `+ 1` and `- 1` terms of the end/start coordinates below
-       * are only necessary when `diagonal_neighbors` is on (and otherwise make
-       * the segments slightly larger than necessary), but, meh...
-       */
-      if (new_start < start)
+      for (x = 0; x < width; x++, i++)
         {
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_start));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (start + 1));
+          if (parent[i] < 0)
+            continue;
+
+          if (x > 0 && parent[i - 1] >= 0)
+            region_tile_label_union (parent, i, i - 1);
+
+          if (y > 0)
+            {
+              if (parent[i - width] >= 0)
+                region_tile_label_union (parent, i, i - width);
+
+              if (diagonal_neighbors)
+                {
+                  if (x > 0 && parent[i - width - 1] >= 0)
+                    region_tile_label_union (parent, i, i - width - 1);
+
+                  if (x < width - 1 && parent[i - width + 1] >= 0)
+                    region_tile_label_union (parent, i, i - width + 1);
+                }
+            }
         }
+    }
+
+  for (i = 0; i < width * height; i++)
+    {
+      gint root;
 
-      if (new_end > end)
+      if (parent[i] < 0)
         {
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (end - 1));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_end));
+          labels[i] = 0;
+
+          continue;
         }
+
+      root = region_tile_label_find (parent, i);
+
+      /* the root precedes all the other pixels of its component */
+      if (root == i)
+        labels[i] = ++n_labels;
+      else
+        labels[i] = labels[root];
+    }
+
+  return n_labels;
+}
+
+/* numbers the components touching the tile's perimeter, in the order
+ * they're met along it, and returns their number.  label_border[] gets
+ * the border index of each label, or -1 for interior components, and, if
+ * non-NULL, perimeter[] the border index of each perimeter pixel: the
+ * top row, the bottom row, the left column and the right column, in this
+ * order.
+ */
+static gint
+region_tile_border (const gint *labels,
+                    gint        width,
+                    gint        height,
+                    gint        n_labels,
+                    gint       *label_border,
+                    gint       *perimeter)
+{
+  gint n_border = 0;
+  gint i;
+
+  for (i = 0; i <= n_labels; i++)
+    label_border[i] = -1;
+
+  auto visit = [&] (gint pixel,
+                    gint offset)
+  {
+    gint label = labels[pixel];
+    gint index = -1;
+
+    if (label)
+      {
+        if (label_border[label] < 0)
+          label_border[label] = n_border++;
+
+        index = label_border[label];
+      }
+
+    if (perimeter)
+      perimeter[offset] = index;
+  };
+
+  for (i = 0; i < width; i++)
+    {
+      visit (i,                        REGION_TOP    (width, height) + i);
+      visit ((height - 1) * width + i, REGION_BOTTOM (width, height) + i);
+    }
+
+  for (i = 0; i < height; i++)
+    {
+      visit (i * width,             REGION_LEFT  (width, height) + i);
+      visit (i * width + width - 1, REGION_RIGHT (width, height) + i);
+    }
+
+  return n_border;
+}
+
+/* returns the global id of the component of a perimeter pixel, or -1 */
+static inline gint
+region_tile_border_id (const RegionTile *tile,
+                       gint              offset)
+{
+  gint index = tile->perimeter[offset];
+
+  return index >= 0 ? tile->first_id + index : -1;
+}
+
+/* reads a tile and computes the difference of each of its pixels from
+ * the seed color.
+ */
+static void
+region_tile_difference (RegionContext       *ctx,
+                        const GeglRectangle *rect,
+                        gfloat              *diff)
+{
+  gint    size = rect->width * rect->height;
+  gfloat *src;
+  gint    i;
+
+  src = g_new (gfloat, size * ctx->n_components);
+
+  gegl_buffer_get (ctx->src_buffer, rect, 1.0, ctx->format, src,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (i = 0; i < size; i++)
+    {
+      diff[i] = pixel_difference (ctx->col, src + i * ctx->n_components,
+                                  ctx->antialias, ctx->threshold,
+                                  ctx->n_components, ctx->has_alpha,
+                                  ctx->select_transparent,
+                                  ctx->select_criterion);
     }
+
+  g_free (src);
 }
 
+/* computes the differences of a tile's pixels, and labels them.  runs
+ * on worker threads.
+ */
 static void
-pop_segment (GQueue *segment_queue,
-             gint   *y,
-             gint   *old_y,
-             gint   *start,
-             gint   *end)
+region_tile_scan (RegionContext *ctx,
+                  RegionTile    *tile)
 {
-  *y     = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *old_y = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *start = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *end   = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
+  const GeglRectangle *rect = &tile->rect;
+  gint                 size = rect->width * rect->height;
+  gfloat              *diff;
+  gint                *labels;
+  gint                *parent;
+  gint                *label_border;
+  gint                 n_labels;
+
+  diff   = g_new (gfloat, size);
+  labels = g_new (gint, size);
+  parent = g_new (gint, size);
+
+  region_tile_difference (ctx, rect, diff);
+
+  n_labels = region_tile_label (diff, rect->width, rect->height,
+                                ctx->diagonal_neighbors, labels, parent);
+
+  label_border    = g_new (gint, n_labels + 1);
+  tile->perimeter = g_new (gint, 2 * (rect->width + rect->height));
+
+  tile->n_border = region_tile_border (labels, rect->width, rect->height,
+                                       n_labels, label_border,
+                                       tile->perimeter);
+
+  if (gegl_rectangle_contains (rect,
+                               GEGL_RECTANGLE (ctx->seed_x, ctx->seed_y, 1, 1)))
+    {
+      gint label = labels[(ctx->seed_y - rect->y) * rect->width +
+                          (ctx->seed_x - rect->x)];
+
+      ctx->seed_label  = label;
+      ctx->seed_border = label_border[label];
+    }
+
+  g_free (label_border);
+  g_free (parent);
+  g_free (labels);
+  g_free (diff);
 }
 
-/* #define FETCH_ROW 1 */
+/* merges the border components of two adjacent tiles */
+static void
+region_tile_merge (RegionContext    *ctx,
+                   const RegionTile *tile1,
+                   const RegionTile *tile2)
+{
+  gint dx = tile2->col - tile1->col;
+  gint dy = tile2->row - tile1->row;
+  gint i;
+
+  if (dy < 0 || (dy == 0 && dx < 0))
+    {
+      const RegionTile *tmp = tile1;
+
+      tile1 = tile2;
+      tile2 = tmp;
+      dx    = -dx;
+      dy    = -dy;
+    }
+
+  if (dx == 1 && dy == 0)
+    {
+      gint width1  = tile1->rect.width;
+      gint width2  = tile2->rect.width;
+      gint height  = tile1->rect.height;
+      gint right   = REGION_RIGHT (width1, height);
+      gint left    = REGION_LEFT  (width2, height);
+
+      for (i = 0; i < height; i++)
+        {
+          gint id1 = region_tile_border_id (tile1, right + i);
+          gint id2;
+
+          if (id1 < 0)
+            continue;
+
+          if ((id2 = region_tile_border_id (tile2, left + i)) >= 0)
+            region_union (ctx->parents, id1, id2);
+
+          if (ctx->diagonal_neighbors)
+            {
+              if (i > 0 &&
+                  (id2 = region_tile_border_id (tile2, left + i - 1)) >= 0)
+                region_union (ctx->parents, id1, id2);
+
+              if (i < height - 1 &&
+                  (id2 = region_tile_border_id (tile2, left + i + 1)) >= 0)
+                region_union (ctx->parents, id1, id2);
+            }
+        }
+    }
+  else if (dx == 0 && dy == 1)
+    {
+      gint width   = tile1->rect.width;
+      gint bottom  = REGION_BOTTOM (width, tile1->rect.height);
+      gint top     = REGION_TOP    (width, tile2->rect.height);
+
+      for (i = 0; i < width; i++)
+        {
+          gint id1 = region_tile_border_id (tile1, bottom + i);
+          gint id2;
+
+          if (id1 < 0)
+            continue;
 
+          if ((id2 = region_tile_border_id (tile2, top + i)) >= 0)
+            region_union (ctx->parents, id1, id2);
+
+          if (ctx->diagonal_neighbors)
+            {
+              if (i > 0 &&
+                  (id2 = region_tile_border_id (tile2, top + i - 1)) >= 0)
+                region_union (ctx->parents, id1, id2);
+
+              if (i < width - 1 &&
+                  (id2 = region_tile_border_id (tile2, top + i + 1)) >= 0)
+                region_union (ctx->parents, id1, id2);
+            }
+        }
+    }
+  else if (ctx->diagonal_neighbors && dy == 1)
+    {
+      /*  the tiles only touch at a corner  */
+      gint width1 = tile1->rect.width;
+      gint width2 = tile2->rect.width;
+      gint id1;
+      gint id2;
+
+      id1 = region_tile_border_id (tile1,
+                                   REGION_BOTTOM (width1, tile1->rect.height) +
+                                   (dx > 0 ? width1 - 1 : 0));
+      id2 = region_tile_border_id (tile2,
+                                   REGION_TOP (width2, tile2->rect.height) +
+                                   (dx > 0 ? 0 : width2 - 1));
+
+      if (id1 >= 0 && id2 >= 0)
+        region_union (ctx->parents, id1, id2);
+    }
+}
+
+/* returns whether the seed's region reaches the neighbor of a tile at
+ * (dx, dy), through the tile's perimeter.
+ */
 static gboolean
-find_contiguous_segment (const gfloat        *col,
-                         GeglBuffer          *src_buffer,
-                         GeglSampler         *src_sampler,
-                         const GeglRectangle *src_extent,
-                         GeglBuffer          *mask_buffer,
-                         const Babl          *src_format,
-                         const Babl          *mask_format,
-                         gint                 n_components,
-                         gboolean             has_alpha,
-                         gboolean             select_transparent,
-                         GimpSelectCriterion  select_criterion,
-                         gboolean             antialias,
-                         gfloat               threshold,
-                         gint                 initial_x,
-                         gint                 initial_y,
-                         gint                *start,
-                         gint                *end,
-                         gfloat              *row)
+region_tile_reaches (RegionContext    *ctx,
+                     const RegionTile *tile,
+                     gint              seed_root,
+                     gint              dx,
+                     gint              dy)
 {
-  gfloat *s;
-  gfloat  mask_row_buf[src_extent->width];
-  gfloat *mask_row = mask_row_buf - src_extent->x;
-  gfloat  diff;
-
-#ifdef FETCH_ROW
-  gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, initial_y, width, 1), 1.0,
-                   src_format,
-                   row, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-  s = row + initial_x * n_components;
-#else
-  s = (gfloat *) g_alloca (n_components * sizeof (gfloat));
-
-  gegl_sampler_get (src_sampler,
-                    initial_x, initial_y, NULL, s, GEGL_ABYSS_NONE);
-#endif
-
-  diff = pixel_difference (col, s, antialias, threshold,
-                           n_components, has_alpha, select_transparent,
-                           select_criterion);
-
-  /* check the starting pixel */
-  if (! diff)
-    return FALSE;
-
-  mask_row[initial_x] = diff;
-
-  *start = initial_x - 1;
-#ifdef FETCH_ROW
-  s = row + *start * n_components;
-#endif
-
-  while (*start >= src_extent->x)
+  gint width  = tile->rect.width;
+  gint height = tile->rect.height;
+  gint offset;
+  gint length;
+  gint i;
+
+  if (dx && dy)
     {
-#ifndef FETCH_ROW
-      gegl_sampler_get (src_sampler,
-                        *start, initial_y, NULL, s, GEGL_ABYSS_NONE);
-#endif
-
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
-      if (diff == 0.0)
-        break;
+      offset = (dy > 0 ? REGION_BOTTOM (width, height) :
+                         REGION_TOP    (width, height)) +
+               (dx > 0 ? width - 1 : 0);
+      length = 1;
+    }
+  else if (dx)
+    {
+      offset = dx > 0 ? REGION_RIGHT (width, height) :
+                        REGION_LEFT  (width, height);
+      length = height;
+    }
+  else
+    {
+      offset = dy > 0 ? REGION_BOTTOM (width, height) :
+                        REGION_TOP    (width, height);
+      length = width;
+    }
 
-      mask_row[*start] = diff;
+  for (i = 0; i < length; i++)
+    {
+      gint id = region_tile_border_id (tile, offset + i);
 
-      (*start)--;
-#ifdef FETCH_ROW
-      s -= n_components;
-#endif
+      if (id >= 0 && region_find (ctx->parents, id) == seed_root)
+        return TRUE;
     }
 
-  *end = initial_x + 1;
-#ifdef FETCH_ROW
-  s = row + *end * n_components;
-#endif
+  return FALSE;
+}
 
-  while (*end < src_extent->x + src_extent->width)
+/* adds the pixels of a tile which belong to the seed's region to the
+ * mask, leaving all the other pixels of the mask alone.  the tile's
+ * differences are computed again rather than kept from the scan, so
+ * that only the tiles being worked on need memory for them.  runs on
+ * worker threads.
+ */
+static void
+region_tile_fill (RegionContext    *ctx,
+                  const RegionTile *tile)
+{
+  const GeglRectangle *rect = &tile->rect;
+  gint                 size = rect->width * rect->height;
+  gboolean             is_seed_tile;
+  gfloat              *diff;
+  gfloat              *mask;
+  gint                *labels;
+  gint                *parent;
+  gint                *label_border;
+  gint                 n_labels;
+  gint                 i;
+
+  is_seed_tile = tile->col == ctx->seed_col && tile->row == ctx->seed_row;
+
+  if (! is_seed_tile || ctx->seed_border >= 0)
     {
-#ifndef FETCH_ROW
-      gegl_sampler_get (src_sampler,
-                        *end, initial_y, NULL, s, GEGL_ABYSS_NONE);
-#endif
-
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
-      if (diff == 0.0)
-        break;
+      for (i = 0; i < tile->n_border; i++)
+        {
+          if (ctx->keep[tile->first_id + i])
+            break;
+        }
+
+      if (i == tile->n_border)
+        return;
+    }
+
+  diff   = g_new (gfloat, size);
+  mask   = g_new (gfloat, size);
+  labels = g_new (gint, size);
+  parent = g_new (gint, size);
+
+  region_tile_difference (ctx, rect, diff);
+
+  gegl_buffer_get (ctx->mask_buffer, rect, 1.0, ctx->diff_format, mask,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  /*  the same pixels give the same labels as when the tile was scanned  */
+  n_labels = region_tile_label (diff, rect->width, rect->height,
+                                ctx->diagonal_neighbors, labels, parent);
+
+  label_border = g_new (gint, n_labels + 1);
 
-      mask_row[*end] = diff;
+  region_tile_border (labels, rect->width, rect->height,
+                      n_labels, label_border, NULL);
 
-      (*end)++;
-#ifdef FETCH_ROW
-      s += n_components;
-#endif
+  for (i = 0; i < size; i++)
+    {
+      gint label = labels[i];
+      gint index;
+
+      if (! label)
+        continue;
+
+      index = label_border[label];
+
+      if (index >= 0 ? ctx->keep[tile->first_id + index] :
+                       is_seed_tile && label == ctx->seed_label)
+        {
+          mask[i] = diff[i];
+        }
     }
 
-  gegl_buffer_set (mask_buffer, GEGL_RECTANGLE (*start + 1, initial_y,
-                                                *end - *start - 1, 1),
-                   0, mask_format, &mask_row[*start + 1],
+  gegl_buffer_set (ctx->mask_buffer, rect, 0, ctx->diff_format, mask,
                    GEGL_AUTO_ROWSTRIDE);
 
-  return TRUE;
+  g_free (label_border);
+  g_free (parent);
+  g_free (labels);
+  g_free (mask);
+  g_free (diff);
 }
 
 static void
@@ -1084,107 +1467,208 @@ find_contiguous_region (GeglBuffer          *src_buffer,
                         gint                 y,
                         const gfloat        *col)
 {
-  const Babl          *mask_format = babl_format ("Y float");
-  GeglSampler         *src_sampler;
-  const GeglRectangle *src_extent;
-  gint                 old_y;
-  gint                 start, end;
-  gint                 new_start, new_end;
-  GQueue              *segment_queue;
-  gfloat              *row = NULL;
+  RegionContext  ctx    = {};
+  GeglRectangle  extent = *gegl_buffer_get_extent (src_buffer);
+  RegionTile    *tiles;
+  GArray        *frontier;
+  GArray        *open;
+  GArray        *scanned;
+  gint           n_cols;
+  gint           n_rows;
+  gint           seed_root = -1;
+  gint           i;
+
+  n_cols = (extent.width  + REGION_TILE_SIZE - 1) / REGION_TILE_SIZE;
+  n_rows = (extent.height + REGION_TILE_SIZE - 1) / REGION_TILE_SIZE;
+
+  ctx.src_buffer         = src_buffer;
+  ctx.mask_buffer        = mask_buffer;
+  ctx.format             = format;
+  ctx.diff_format        = babl_format ("Y float");
+  ctx.n_components       = n_components;
+  ctx.has_alpha          = has_alpha;
+  ctx.select_transparent = select_transparent;
+  ctx.select_criterion   = select_criterion;
+  ctx.antialias          = antialias;
+  ctx.threshold          = threshold;
+  ctx.diagonal_neighbors = diagonal_neighbors;
+  ctx.col                = col;
+  ctx.seed_x             = x;
+  ctx.seed_y             = y;
+  ctx.seed_col           = (x - extent.x) / REGION_TILE_SIZE;
+  ctx.seed_row           = (y - extent.y) / REGION_TILE_SIZE;
+  ctx.seed_border        = -1;
+  ctx.parents            = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  tiles = g_new0 (RegionTile, n_cols * n_rows);
+
+  for (i = 0; i < n_cols * n_rows; i++)
+    {
+      RegionTile *tile = &tiles[i];
+
+      tile->col         = i % n_cols;
+      tile->row         = i / n_cols;
+      tile->rect.x      = extent.x + tile->col * REGION_TILE_SIZE;
+      tile->rect.y      = extent.y + tile->row * REGION_TILE_SIZE;
+      tile->rect.width  = MIN (REGION_TILE_SIZE,
+                               extent.x + extent.width  - tile->rect.x);
+      tile->rect.height = MIN (REGION_TILE_SIZE,
+                               extent.y + extent.height - tile->rect.y);
+    }
+
+  frontier = g_array_new (FALSE, FALSE, sizeof (RegionTile *));
+  open     = g_array_new (FALSE, FALSE, sizeof (RegionTile *));
+  scanned  = g_array_new (FALSE, FALSE, sizeof (RegionTile *));
 
-  src_extent = gegl_buffer_get_extent (src_buffer);
+  auto tile_at = [&] (const RegionTile *tile,
+                      gint              dx,
+                      gint              dy) -> RegionTile *
+  {
+    gint col = tile->col + dx;
+    gint row = tile->row + dy;
 
-#ifdef FETCH_ROW
-  row = g_new (gfloat, src_extent->width * n_components);
-#endif
+    if (col < 0 || col >= n_cols || row < 0 || row >= n_rows)
+      return NULL;
 
-  src_sampler = gegl_buffer_sampler_new (src_buffer,
-                                         format, GEGL_SAMPLER_NEAREST);
+    return &tiles[row * n_cols + col];
+  };
 
-  segment_queue = g_queue_new ();
+  {
+    RegionTile *seed_tile = &tiles[ctx.seed_row * n_cols + ctx.seed_col];
 
-  push_segment (segment_queue,
-                y, /* dummy values: */ -1, 0, 0,
-                y, x - 1, x + 1);
+    seed_tile->queued = TRUE;
+    g_array_append_val (frontier, seed_tile);
+  }
 
-  do
+  while (frontier->len > 0)
     {
-      pop_segment (segment_queue,
-                   &y, &old_y, &start, &end);
+      guint j;
+
+      gegl_parallel_distribute_range (
+        frontier->len, REGION_TILE_THREAD_COST,
+        [&] (gsize offset, gsize size)
+        {
+          for (gsize k = offset; k < offset + size; k++)
+            region_tile_scan (&ctx, g_array_index (frontier, RegionTile *, k));
+        });
 
-      for (x = start + 1; x < end; x++)
+      /*  give the new border components their global ids  */
+      for (j = 0; j < frontier->len; j++)
         {
-          gfloat val;
+          RegionTile *tile = g_array_index (frontier, RegionTile *, j);
 
-          gegl_buffer_get (mask_buffer, GEGL_RECTANGLE (x, y, 1, 1), 1.0,
-                           mask_format, &val, GEGL_AUTO_ROWSTRIDE,
-                           GEGL_ABYSS_NONE);
+          tile->first_id = ctx.parents->len;
+          tile->scanned  = TRUE;
 
-          if (val != 0.0)
+          for (i = 0; i < tile->n_border; i++)
             {
-              /* If the current pixel is selected, then we've already visited
-               * the next pixel.  (Note that we assume that the maximal image
-               * width is sufficiently low that `x` won't overflow.)
-               */
-              x++;
-              continue;
+              gint id = tile->first_id + i;
+
+              g_array_append_val (ctx.parents, id);
             }
 
-          if (! find_contiguous_segment (col,
-                                         src_buffer, src_sampler, src_extent,
-                                         mask_buffer,
-                                         format, mask_format,
-                                         n_components,
-                                         has_alpha,
-                                         select_transparent, select_criterion,
-                                         antialias, threshold, x, y,
-                                         &new_start, &new_end,
-                                         row))
-            continue;
+          g_array_append_val (scanned, tile);
+          g_array_append_val (open, tile);
+        }
 
-          /* We can skip directly to `new_end + 1` on the next iteration, since
-           * we've just selected all pixels in the range `[x, new_end)`, and
-           * the pixel at `new_end` is above threshold.  (Note that we assume
-           * that the maximal image width is sufficiently low that `x` won't
-           * overflow.)
-           */
-          x = new_end;
+      /*  the seed's region doesn't reach the seed tile's perimeter  */
+      if (ctx.seed_border < 0)
+        break;
 
-          if (diagonal_neighbors)
-            {
-              if (new_start >= src_extent->x)
-                new_start--;
+      for (j = 0; j < frontier->len; j++)
+        {
+          RegionTile *tile = g_array_index (frontier, RegionTile *, j);
+          gint        dx, dy;
 
-              if (new_end < src_extent->x + src_extent->width)
-                new_end++;
-            }
+          for (dy = -1; dy <= 1; dy++)
+            for (dx = -1; dx <= 1; dx++)
+              {
+                RegionTile *neighbor = tile_at (tile, dx, dy);
 
-          if (y + 1 < src_extent->y + src_extent->height)
-            {
-              push_segment (segment_queue,
-                            y, old_y, start, end,
-                            y + 1, new_start, new_end);
-            }
+                if (neighbor && neighbor != tile && neighbor->scanned &&
+                    (diagonal_neighbors || ! dx || ! dy))
+                  {
+                    region_tile_merge (&ctx, tile, neighbor);
+                  }
+              }
+        }
 
-          if (y - 1 >= src_extent->y)
-            {
-              push_segment (segment_queue,
-                            y, old_y, start, end,
-                            y - 1, new_start, new_end);
-            }
+      seed_root = region_find (ctx.parents,
+                               tiles[ctx.seed_row * n_cols +
+                                     ctx.seed_col].first_id +
+                               ctx.seed_border);
+
+      /*  queue the tiles the region spills into  */
+      g_array_set_size (frontier, 0);
+
+      for (j = 0; j < open->len; )
+        {
+          RegionTile *tile    = g_array_index (open, RegionTile *, j);
+          gboolean    pending = FALSE;
+          gint        dx, dy;
+
+          for (dy = -1; dy <= 1; dy++)
+            for (dx = -1; dx <= 1; dx++)
+              {
+                RegionTile *neighbor = tile_at (tile, dx, dy);
 
+                if (! neighbor || neighbor->queued ||
+                    ! (diagonal_neighbors || ! dx || ! dy))
+                  {
+                    continue;
+                  }
+
+                if (region_tile_reaches (&ctx, tile, seed_root, dx, dy))
+                  {
+                    neighbor->queued = TRUE;
+                    g_array_append_val (frontier, neighbor);
+                  }
+                else
+                  {
+                    pending = TRUE;
+                  }
+              }
+
+          /*  the region may still reach the tile's remaining neighbors
+           *  later, through other tiles
+           */
+          if (pending)
+            j++;
+          else
+            g_array_remove_index_fast (open, j);
         }
     }
-  while (! g_queue_is_empty (segment_queue));
 
-  g_queue_free (segment_queue);
+  if (ctx.seed_label)
+    {
+      ctx.keep = g_new0 (gboolean, ctx.parents->len);
+
+      if (seed_root >= 0)
+        {
+          for (i = 0; i < (gint) ctx.parents->len; i++)
+            ctx.keep[i] = region_find (ctx.parents, i) == seed_root;
+        }
+
+      gegl_parallel_distribute_range (
+        scanned->len, REGION_TILE_THREAD_COST,
+        [&] (gsize offset, gsize size)
+        {
+          for (gsize k = offset; k < offset + size; k++)
+            region_tile_fill (&ctx, g_array_index (scanned, RegionTile *, k));
+        });
+
+      g_free (ctx.keep);
+    }
+
+  for (i = 0; i < n_cols * n_rows; i++)
+    g_free (tiles[i].perimeter);
 
-  g_object_unref (src_sampler);
+  g_array_free (scanned, TRUE);
+  g_array_free (open, TRUE);
+  g_array_free (frontier, TRUE);
+  g_free (tiles);
 
-#ifdef FETCH_ROW
-  g_free (row);
-#endif
+  g_array_free (ctx.parents, TRUE);
 }
 
 static void
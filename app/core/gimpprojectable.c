@@ -258,3 +258,42 @@ gimp_projectable_invalidate_preview (GimpProjectable *projectable)
   if (iface->invalidate_preview)
     iface->invalidate_preview (projectable);
 }
+
+/**
+ * gimp_projectable_set_render_cache:
+ * @projectable: a #GimpProjectable
+ * @enable:      whether to cache intermediate results
+ *
+ * Enables caching of the intermediate results of @projectable's graph
+ * which don't depend on the item being edited, so that editing it
+ * only renders what actually changed. Projectables which don't support
+ * caching ignore this.
+ **/
+void
+gimp_projectable_set_render_cache (GimpProjectable *projectable,
+                                   gboolean         enable)
+{
+  GimpProjectableInterface *iface;
+
+  g_return_if_fail (GIMP_IS_PROJECTABLE (projectable));
+
+  iface = GIMP_PROJECTABLE_GET_IFACE (projectable);
+
+  if (iface->set_render_cache)
+    iface->set_render_cache (projectable, enable);
+}
+
+gboolean
+gimp_projectable_get_render_cache (GimpProjectable *projectable)
+{
+  GimpProjectableInterface *iface;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTABLE (projectable), FALSE);
+
+  iface = GIMP_PROJECTABLE_GET_IFACE (projectable);
+
+  if (iface->get_render_cache)
+    return iface->get_render_cache (projectable);
+
+  return FALSE;
+}
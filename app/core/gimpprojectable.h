@@ -53,6 +53,9 @@ struct _GimpProjectableInterface
   void         (* begin_render)       (GimpProjectable *projectable);
   void         (* end_render)         (GimpProjectable *projectable);
   void         (* invalidate_preview) (GimpProjectable *projectable);
+  void         (* set_render_cache)   (GimpProjectable *projectable,
+                                       gboolean         enable);
+  gboolean     (* get_render_cache)   (GimpProjectable *projectable);
 };
 
 
@@ -78,3 +81,7 @@ GeglNode   * gimp_projectable_get_graph          (GimpProjectable *projectable);
 void         gimp_projectable_begin_render       (GimpProjectable *projectable);
 void         gimp_projectable_end_render         (GimpProjectable *projectable);
 void         gimp_projectable_invalidate_preview (GimpProjectable *projectable);
+
+void         gimp_projectable_set_render_cache   (GimpProjectable *projectable,
+                                                  gboolean         enable);
+gboolean     gimp_projectable_get_render_cache   (GimpProjectable *projectable);
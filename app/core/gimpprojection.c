@@ -35,6 +35,8 @@
 
 #include "gimp.h"
 #include "gimp-memsize.h"
+#include "gimp-parallel.h"
+#include "gimpasync.h"
 #include "gimpchunkiterator.h"
 #include "gimpimage.h"
 #include "gimpmarshal.h"
@@ -42,6 +44,7 @@
 #include "gimpprojectable.h"
 #include "gimpprojection.h"
 #include "gimptilehandlerprojectable.h"
+#include "gimpwaitable.h"
 
 #include "gimp-log.h"
 #include "gimp-priorities.h"
@@ -65,6 +68,15 @@ enum
 };
 
 
+typedef struct
+{
+  GeglRectangle  rect;
+  GeglBuffer    *src_buffer;
+  GeglBuffer    *dest_buffer;
+  GimpAsync     *async;
+} GimpProjectionChunk;
+
+
 struct _GimpProjectionPrivate
 {
   GimpProjectable           *projectable;
@@ -78,6 +90,7 @@ struct _GimpProjectionPrivate
   GeglRectangle              priority_rect;
   GimpChunkIterator         *iter;
   guint                      idle_id;
+  gint64                     render_start_time;
 
   gboolean                   invalidate_preview;
 };
@@ -130,6 +143,9 @@ static void        gimp_projection_chunk_render_stop     (GimpProjection  *proj,
                                                           gboolean         merge);
 static gboolean    gimp_projection_chunk_render_callback (GimpProjection  *proj);
 static gboolean    gimp_projection_chunk_render_iteration(GimpProjection  *proj);
+static void        gimp_projection_chunk_render_pipelined(GimpProjection  *proj);
+static void        gimp_projection_chunk_write           (GimpAsync       *async,
+                                                          GimpProjectionChunk *chunk);
 static void        gimp_projection_paint_area            (GimpProjection  *proj,
                                                           gboolean         now,
                                                           gint             x,
@@ -723,6 +739,9 @@ gimp_projection_chunk_render_start (GWeakRef *proj_ref)
 
       if (region && ! cairo_region_is_empty (region))
         {
+          if (! proj->priv->idle_id)
+            proj->priv->render_start_time = g_get_monotonic_time ();
+
           proj->priv->iter = gimp_chunk_iterator_new (region);
 
           gimp_projection_update_priority_rect (proj);
@@ -829,14 +848,28 @@ gimp_projection_chunk_render_iteration (GimpProjection *proj)
 {
   if (gimp_chunk_iterator_next (proj->priv->iter))
     {
-      GeglRectangle rect;
+      gint n_threads;
+
+      g_object_get (gegl_config (),
+                    "threads", &n_threads,
+                    NULL);
 
       gimp_tile_handler_validate_begin_validate (proj->priv->validate_handler);
 
-      while (gimp_chunk_iterator_get_rect (proj->priv->iter, &rect))
+      if (n_threads > 1)
         {
-          gimp_projection_paint_area (proj, TRUE,
-                                      rect.x, rect.y, rect.width, rect.height);
+          gimp_projection_chunk_render_pipelined (proj);
+        }
+      else
+        {
+          GeglRectangle rect;
+
+          while (gimp_chunk_iterator_get_rect (proj->priv->iter, &rect))
+            {
+              gimp_projection_paint_area (proj, TRUE,
+                                          rect.x, rect.y,
+                                          rect.width, rect.height);
+            }
         }
 
       gimp_tile_handler_validate_end_validate (proj->priv->validate_handler);
@@ -848,6 +881,12 @@ gimp_projection_chunk_render_iteration (GimpProjection *proj)
     {
       proj->priv->iter = NULL;
 
+      GIMP_LOG (PROJECTION, "%p: rendered in %g seconds",
+                proj,
+                (gdouble) (g_get_monotonic_time () -
+                           proj->priv->render_start_time) /
+                G_TIME_SPAN_SECOND);
+
       if (proj->priv->invalidate_preview)
         {
           /* invalidate the preview here since it is constructed from
@@ -863,6 +902,124 @@ gimp_projection_chunk_render_iteration (GimpProjection *proj)
     }
 }
 
+/* the graph is not safe to process from several threads at once, and
+ * already spreads each of its operations over the GEGL threads, so the
+ * chunks are still rendered one after the other, on the main thread,
+ * in the iterator's order.  what runs on the worker threads is the
+ * conversion of each rendered chunk to the projection's format, and
+ * writing it to the projection's buffer, while the main thread goes on
+ * rendering the next chunk.  all writes are done before the iteration
+ * returns, which keeps them inside begin/end_validate(), so that the
+ * validate handler never processes the graph from a worker.
+ */
+static void
+gimp_projection_chunk_render_pipelined (GimpProjection *proj)
+{
+  GQueue               chunks = G_QUEUE_INIT;
+  GimpProjectionChunk *chunk;
+  GeglNode            *graph;
+  GeglNode            *node;
+  const Babl          *format;
+  GeglRectangle        bounding_box;
+  GeglRectangle        rect;
+  gboolean             canceled = FALSE;
+
+  graph = gimp_projectable_get_graph (proj->priv->projectable);
+  node  = gegl_node_get_producer (gegl_node_get_output_proxy (graph, "output"),
+                                  "input", NULL);
+
+  /*  render in the graph's own format, so the blit doesn't convert  */
+  if (node)
+    format = gimp_gegl_node_get_format (node, "output");
+  else
+    format = gegl_buffer_get_format (proj->priv->buffer);
+
+  bounding_box = gimp_projectable_get_bounding_box (proj->priv->projectable);
+
+  while (gimp_chunk_iterator_get_rect (proj->priv->iter, &rect))
+    {
+      if (! gegl_rectangle_intersect (&rect, &rect, &bounding_box))
+        continue;
+
+      chunk = g_slice_new (GimpProjectionChunk);
+
+      chunk->rect        = rect;
+      chunk->src_buffer  = gegl_buffer_new (&rect, format);
+      chunk->dest_buffer = g_object_ref (proj->priv->buffer);
+
+      gimp_tile_handler_validate_render (proj->priv->validate_handler,
+                                         &rect, chunk->src_buffer);
+
+      chunk->async = gimp_parallel_run_async_full (
+        +1,
+        (GimpRunAsyncFunc) gimp_projection_chunk_write,
+        chunk, NULL);
+
+      g_queue_push_tail (&chunks, chunk);
+    }
+
+  while ((chunk = g_queue_pop_head (&chunks)))
+    {
+      gimp_waitable_wait (GIMP_WAITABLE (chunk->async));
+
+      if (gimp_async_is_finished (chunk->async))
+        {
+          gint off_x, off_y;
+
+          gimp_tile_handler_validate_undo_invalidate (
+            proj->priv->validate_handler,
+            &chunk->rect);
+
+          gimp_projectable_get_offset (proj->priv->projectable,
+                                       &off_x, &off_y);
+
+          g_signal_emit (proj, projection_signals[UPDATE], 0,
+                         TRUE,
+                         chunk->rect.x + off_x,
+                         chunk->rect.y + off_y,
+                         chunk->rect.width,
+                         chunk->rect.height);
+        }
+      else
+        {
+          /*  the write was canceled, render the chunk again later  */
+          gimp_projection_add_update_area (proj,
+                                           chunk->rect.x,
+                                           chunk->rect.y,
+                                           chunk->rect.width,
+                                           chunk->rect.height);
+
+          canceled = TRUE;
+        }
+
+      g_object_unref (chunk->async);
+      g_object_unref (chunk->src_buffer);
+      g_object_unref (chunk->dest_buffer);
+
+      g_slice_free (GimpProjectionChunk, chunk);
+    }
+
+  if (canceled)
+    gimp_projection_flush (proj);
+}
+
+static void
+gimp_projection_chunk_write (GimpAsync           *async,
+                             GimpProjectionChunk *chunk)
+{
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  gimp_gegl_buffer_copy (chunk->src_buffer, &chunk->rect, GEGL_ABYSS_NONE,
+                         chunk->dest_buffer, &chunk->rect);
+
+  gimp_async_finish (async, NULL);
+}
+
 static void
 gimp_projection_paint_area (GimpProjection *proj,
                             gboolean        now,
@@ -42,6 +42,7 @@ struct _GimpTempBuf
   gint        height;
   const Babl *format;
   guchar     *data;
+  GBytes     *bytes;
 };
 
 typedef struct
@@ -82,6 +83,46 @@ gimp_temp_buf_new (gint        width,
   temp->height    = height;
   temp->format    = format;
   temp->data      = gegl_malloc ((gsize) width * height * bpp);
+  temp->bytes     = NULL;
+
+  g_atomic_pointer_add (&gimp_temp_buf_total_memsize,
+                        +gimp_temp_buf_get_memsize (temp));
+
+  return temp;
+}
+
+/* creates a temp buf which uses the pixels in @bytes in place.  the
+ * pixels must stay writable for as long as the temp buf lives, like
+ * those of a private, writable GMappedFile, whose pages are then only
+ * read, and copied, when they are first used.
+ */
+GimpTempBuf *
+gimp_temp_buf_new_from_bytes (gint        width,
+                              gint        height,
+                              const Babl *format,
+                              GBytes     *bytes)
+{
+  GimpTempBuf *temp;
+  gint         bpp;
+
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  bpp = babl_format_get_bytes_per_pixel (format);
+
+  g_return_val_if_fail (width > 0 && height > 0 && bpp > 0, NULL);
+  g_return_val_if_fail (G_MAXSIZE / width / height / bpp > 0, NULL);
+  g_return_val_if_fail (g_bytes_get_size (bytes) ==
+                        (gsize) width * height * bpp, NULL);
+
+  temp = g_slice_new (GimpTempBuf);
+
+  temp->ref_count = 1;
+  temp->width     = width;
+  temp->height    = height;
+  temp->format    = format;
+  temp->data      = (guchar *) g_bytes_get_data (bytes, NULL);
+  temp->bytes     = g_bytes_ref (bytes);
 
   g_atomic_pointer_add (&gimp_temp_buf_total_memsize,
                         +gimp_temp_buf_get_memsize (temp));
@@ -174,7 +215,9 @@ gimp_temp_buf_unref (const GimpTempBuf *buf)
                             -gimp_temp_buf_get_memsize (buf));
 
 
-      if (buf->data)
+      if (buf->bytes)
+        g_bytes_unref (buf->bytes);
+      else if (buf->data)
         gegl_free (buf->data);
 
       g_slice_free (GimpTempBuf, (GimpTempBuf *) buf);
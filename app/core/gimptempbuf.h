@@ -21,6 +21,10 @@
 GimpTempBuf * gimp_temp_buf_new               (gint               width,
                                                gint               height,
                                                const Babl        *format) G_GNUC_WARN_UNUSED_RESULT;
+GimpTempBuf * gimp_temp_buf_new_from_bytes    (gint               width,
+                                               gint               height,
+                                               const Babl        *format,
+                                               GBytes            *bytes) G_GNUC_WARN_UNUSED_RESULT;
 GimpTempBuf * gimp_temp_buf_new_from_pixbuf   (GdkPixbuf         *pixbuf,
                                                const Babl        *f_or_null) G_GNUC_WARN_UNUSED_RESULT;
 GimpTempBuf * gimp_temp_buf_copy              (const GimpTempBuf *src) G_GNUC_WARN_UNUSED_RESULT;
@@ -90,6 +90,8 @@ static void          gimp_undo_real_pop            (GimpUndo            *undo,
                                                     GimpUndoAccumulator *accum);
 static void          gimp_undo_real_free           (GimpUndo            *undo,
                                                     GimpUndoMode         undo_mode);
+static gint64        gimp_undo_real_evict          (GimpUndo            *undo,
+                                                    GimpUndoJournal     *journal);
 
 static gboolean      gimp_undo_create_preview_idle (gpointer             data);
 static void       gimp_undo_create_preview_private (GimpUndo            *undo,
@@ -143,6 +145,7 @@ gimp_undo_class_init (GimpUndoClass *klass)
 
   klass->pop                        = gimp_undo_real_pop;
   klass->free                       = gimp_undo_real_free;
+  klass->evict                      = gimp_undo_real_evict;
 
   g_object_class_install_property (object_class, PROP_IMAGE,
                                    g_param_spec_object ("image", NULL, NULL,
@@ -347,6 +350,13 @@ gimp_undo_real_free (GimpUndo     *undo,
 {
 }
 
+static gint64
+gimp_undo_real_evict (GimpUndo        *undo,
+                      GimpUndoJournal *journal)
+{
+  return 0;
+}
+
 void
 gimp_undo_pop (GimpUndo            *undo,
                GimpUndoMode         undo_mode,
@@ -381,6 +391,19 @@ gimp_undo_free (GimpUndo     *undo,
   g_signal_emit (undo, undo_signals[FREE], 0, undo_mode);
 }
 
+/* moves the payload of @undo to @journal, and returns the number of
+ * bytes of memory this freed.
+ */
+gint64
+gimp_undo_evict (GimpUndo        *undo,
+                 GimpUndoJournal *journal)
+{
+  g_return_val_if_fail (GIMP_IS_UNDO (undo), 0);
+  g_return_val_if_fail (journal != NULL, 0);
+
+  return GIMP_UNDO_GET_CLASS (undo)->evict (undo, journal);
+}
+
 typedef struct _GimpUndoIdle GimpUndoIdle;
 
 struct _GimpUndoIdle
@@ -34,6 +34,9 @@ struct _GimpUndoAccumulator
   gboolean resolution_changed;
 
   gboolean unit_changed;
+
+  /*  set when an undo couldn't be popped, its step is then reverted  */
+  GError  *error;
 };
 
 
@@ -65,11 +68,14 @@ struct _GimpUndoClass
 {
   GimpViewableClass  parent_class;
 
-  void (* pop)  (GimpUndo            *undo,
-                 GimpUndoMode         undo_mode,
-                 GimpUndoAccumulator *accum);
-  void (* free) (GimpUndo            *undo,
-                 GimpUndoMode         undo_mode);
+  void   (* pop)   (GimpUndo            *undo,
+                    GimpUndoMode         undo_mode,
+                    GimpUndoAccumulator *accum);
+  void   (* free)  (GimpUndo            *undo,
+                    GimpUndoMode         undo_mode);
+
+  gint64 (* evict) (GimpUndo            *undo,
+                    GimpUndoJournal     *journal);
 };
 
 
@@ -80,6 +86,8 @@ void          gimp_undo_pop             (GimpUndo            *undo,
                                          GimpUndoAccumulator *accum);
 void          gimp_undo_free            (GimpUndo            *undo,
                                          GimpUndoMode         undo_mode);
+gint64        gimp_undo_evict           (GimpUndo            *undo,
+                                         GimpUndoJournal     *journal);
 
 void          gimp_undo_create_preview  (GimpUndo            *undo,
                                          GimpContext         *context,
@@ -0,0 +1,364 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpundojournal.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core-types.h"
+
+#include "gimpundojournal.h"
+
+#include "gimp-intl.h"
+
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+
+/* a file holding the pixel payloads of old undo steps, which were
+ * evicted to keep the undo stack within the undo size.  released
+ * records are kept in a list of free extents, sorted by offset and
+ * merged with their neighbors, which new records are written to
+ * first.  a free extent at the end of the file is cut off.
+ */
+typedef struct
+{
+  goffset offset;
+  goffset size;
+} GimpUndoJournalExtent;
+
+struct _GimpUndoJournal
+{
+  gint           ref_count;
+
+  GFile         *file;
+  GFileIOStream *stream;
+
+  goffset        size;
+  goffset        live;
+
+  GArray        *free_extents;
+};
+
+
+static void   gimp_undo_journal_truncate (GimpUndoJournal *journal);
+
+
+/*  public functions  */
+
+GimpUndoJournal *
+gimp_undo_journal_new (GFile   *directory,
+                       GError **error)
+{
+  GimpUndoJournal *journal;
+  GFileIOStream   *stream;
+  GFile           *file;
+  gchar           *path;
+  gint             fd;
+
+  g_return_val_if_fail (G_IS_FILE (directory), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (! g_file_query_exists (directory, NULL) &&
+      ! g_file_make_directory_with_parents (directory, NULL, error))
+    {
+      return NULL;
+    }
+
+  if (! g_file_peek_path (directory))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   _("Undo journals can only be created in local folders"));
+      return NULL;
+    }
+
+  path = g_build_filename (g_file_peek_path (directory),
+                           "gimp-undo-XXXXXX.journal", NULL);
+
+  fd = g_mkstemp_full (path, O_RDWR | O_BINARY, 0600);
+
+  if (fd == -1)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not create undo journal '%s': %s"),
+                   gimp_filename_to_utf8 (path), g_strerror (errno));
+      g_free (path);
+
+      return NULL;
+    }
+
+  g_close (fd, NULL);
+
+  file = g_file_new_for_path (path);
+  g_free (path);
+
+  stream = g_file_open_readwrite (file, NULL, error);
+
+  if (! stream)
+    {
+      g_file_delete (file, NULL, NULL);
+      g_object_unref (file);
+
+      return NULL;
+    }
+
+  journal = g_slice_new0 (GimpUndoJournal);
+
+  journal->ref_count    = 1;
+  journal->file         = file;
+  journal->stream       = stream;
+  journal->free_extents = g_array_new (FALSE, FALSE,
+                                       sizeof (GimpUndoJournalExtent));
+
+  return journal;
+}
+
+GimpUndoJournal *
+gimp_undo_journal_ref (GimpUndoJournal *journal)
+{
+  g_return_val_if_fail (journal != NULL, NULL);
+
+  journal->ref_count++;
+
+  return journal;
+}
+
+void
+gimp_undo_journal_unref (GimpUndoJournal *journal)
+{
+  g_return_if_fail (journal != NULL);
+  g_return_if_fail (journal->ref_count > 0);
+
+  journal->ref_count--;
+
+  if (journal->ref_count < 1)
+    {
+      g_io_stream_close (G_IO_STREAM (journal->stream), NULL, NULL);
+      g_object_unref (journal->stream);
+
+      g_file_delete (journal->file, NULL, NULL);
+      g_object_unref (journal->file);
+
+      g_array_free (journal->free_extents, TRUE);
+
+      g_slice_free (GimpUndoJournal, journal);
+    }
+}
+
+/* writes @size bytes of @data to the first free extent they fit in,
+ * or at the end of the journal, and returns their position in @offset.
+ */
+gboolean
+gimp_undo_journal_append (GimpUndoJournal  *journal,
+                          const guchar     *data,
+                          gsize             size,
+                          goffset          *offset,
+                          GError          **error)
+{
+  GOutputStream *output;
+  goffset        position = journal->size;
+  gint           i;
+
+  g_return_val_if_fail (journal != NULL, FALSE);
+  g_return_val_if_fail (data != NULL || size == 0, FALSE);
+  g_return_val_if_fail (offset != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  for (i = 0; i < journal->free_extents->len; i++)
+    {
+      GimpUndoJournalExtent *extent = &g_array_index (journal->free_extents,
+                                                      GimpUndoJournalExtent,
+                                                      i);
+
+      if (extent->size >= size)
+        {
+          position = extent->offset;
+          break;
+        }
+    }
+
+  output = g_io_stream_get_output_stream (G_IO_STREAM (journal->stream));
+
+  if (! g_seekable_seek (G_SEEKABLE (journal->stream),
+                         position, G_SEEK_SET, NULL, error) ||
+      ! g_output_stream_write_all (output, data, size, NULL, NULL, error))
+    {
+      return FALSE;
+    }
+
+  if (i < journal->free_extents->len)
+    {
+      GimpUndoJournalExtent *extent = &g_array_index (journal->free_extents,
+                                                      GimpUndoJournalExtent,
+                                                      i);
+
+      extent->offset += size;
+      extent->size   -= size;
+
+      if (extent->size == 0)
+        g_array_remove_index (journal->free_extents, i);
+    }
+  else
+    {
+      journal->size += size;
+    }
+
+  *offset = position;
+
+  journal->live += size;
+
+  return TRUE;
+}
+
+gboolean
+gimp_undo_journal_read (GimpUndoJournal  *journal,
+                        goffset           offset,
+                        guchar           *data,
+                        gsize             size,
+                        GError          **error)
+{
+  GInputStream *input;
+  gsize         bytes_read;
+
+  g_return_val_if_fail (journal != NULL, FALSE);
+  g_return_val_if_fail (data != NULL || size == 0, FALSE);
+  g_return_val_if_fail (offset >= 0 && offset + size <= journal->size, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  input = g_io_stream_get_input_stream (G_IO_STREAM (journal->stream));
+
+  if (! g_seekable_seek (G_SEEKABLE (journal->stream),
+                         offset, G_SEEK_SET, NULL, error) ||
+      ! g_input_stream_read_all (input, data, size, &bytes_read, NULL, error))
+    {
+      return FALSE;
+    }
+
+  if (bytes_read != size)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   _("Undo journal '%s' is truncated"),
+                   gimp_file_get_utf8_name (journal->file));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* tells the journal that the @size bytes at @offset, previously
+ * appended, are no longer needed, so they can be reused.
+ */
+void
+gimp_undo_journal_release (GimpUndoJournal *journal,
+                           goffset          offset,
+                           gsize            size)
+{
+  GimpUndoJournalExtent  extent = { offset, size };
+  GimpUndoJournalExtent *prev   = NULL;
+  GimpUndoJournalExtent *next   = NULL;
+  gint                   i;
+
+  g_return_if_fail (journal != NULL);
+  g_return_if_fail (size <= journal->live);
+  g_return_if_fail (offset >= 0 && offset + size <= journal->size);
+
+  if (size == 0)
+    return;
+
+  journal->live -= size;
+
+  for (i = 0; i < journal->free_extents->len; i++)
+    {
+      if (g_array_index (journal->free_extents,
+                         GimpUndoJournalExtent, i).offset > offset)
+        break;
+    }
+
+  if (i > 0)
+    prev = &g_array_index (journal->free_extents,
+                           GimpUndoJournalExtent, i - 1);
+
+  if (i < journal->free_extents->len)
+    next = &g_array_index (journal->free_extents,
+                           GimpUndoJournalExtent, i);
+
+  if (prev && prev->offset + prev->size == offset)
+    {
+      prev->size += size;
+
+      if (next && prev->offset + prev->size == next->offset)
+        {
+          prev->size += next->size;
+          g_array_remove_index (journal->free_extents, i);
+        }
+    }
+  else if (next && offset + size == next->offset)
+    {
+      next->offset  = offset;
+      next->size   += size;
+    }
+  else
+    {
+      g_array_insert_val (journal->free_extents, i, extent);
+    }
+
+  gimp_undo_journal_truncate (journal);
+}
+
+goffset
+gimp_undo_journal_get_size (GimpUndoJournal *journal)
+{
+  g_return_val_if_fail (journal != NULL, 0);
+
+  return journal->size;
+}
+
+
+/*  private functions  */
+
+/* cuts off the free extent at the end of the journal, if any  */
+static void
+gimp_undo_journal_truncate (GimpUndoJournal *journal)
+{
+  GimpUndoJournalExtent *last;
+  guint                  n_extents = journal->free_extents->len;
+
+  if (n_extents == 0)
+    return;
+
+  last = &g_array_index (journal->free_extents,
+                         GimpUndoJournalExtent, n_extents - 1);
+
+  if (last->offset + last->size == journal->size &&
+      g_seekable_truncate (G_SEEKABLE (journal->stream),
+                           last->offset, NULL, NULL))
+    {
+      journal->size = last->offset;
+
+      g_array_set_size (journal->free_extents, n_extents - 1);
+    }
+}
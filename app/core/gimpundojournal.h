@@ -0,0 +1,43 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpundojournal.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+GimpUndoJournal * gimp_undo_journal_new      (GFile            *directory,
+                                              GError          **error);
+
+GimpUndoJournal * gimp_undo_journal_ref      (GimpUndoJournal  *journal);
+void              gimp_undo_journal_unref    (GimpUndoJournal  *journal);
+
+gboolean          gimp_undo_journal_append   (GimpUndoJournal  *journal,
+                                              const guchar     *data,
+                                              gsize             size,
+                                              goffset          *offset,
+                                              GError          **error);
+gboolean          gimp_undo_journal_read     (GimpUndoJournal  *journal,
+                                              goffset           offset,
+                                              guchar           *data,
+                                              gsize             size,
+                                              GError          **error);
+void              gimp_undo_journal_release  (GimpUndoJournal  *journal,
+                                              goffset           offset,
+                                              gsize             size);
+
+goffset           gimp_undo_journal_get_size (GimpUndoJournal  *journal);
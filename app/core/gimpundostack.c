@@ -38,6 +38,8 @@ static void    gimp_undo_stack_pop         (GimpUndo            *undo,
                                             GimpUndoAccumulator *accum);
 static void    gimp_undo_stack_free        (GimpUndo            *undo,
                                             GimpUndoMode         undo_mode);
+static gint64  gimp_undo_stack_evict       (GimpUndo            *undo,
+                                            GimpUndoJournal     *journal);
 
 
 G_DEFINE_TYPE (GimpUndoStack, gimp_undo_stack, GIMP_TYPE_UNDO)
@@ -58,6 +60,7 @@ gimp_undo_stack_class_init (GimpUndoStackClass *klass)
 
   undo_class->pop                = gimp_undo_stack_pop;
   undo_class->free               = gimp_undo_stack_free;
+  undo_class->evict              = gimp_undo_stack_evict;
 }
 
 static void
@@ -127,6 +130,26 @@ gimp_undo_stack_free (GimpUndo     *undo,
   gimp_container_clear (stack->undos);
 }
 
+static gint64
+gimp_undo_stack_evict (GimpUndo        *undo,
+                       GimpUndoJournal *journal)
+{
+  GimpUndoStack *stack   = GIMP_UNDO_STACK (undo);
+  gint64         evicted = 0;
+  GList         *list;
+
+  for (list = GIMP_LIST (stack->undos)->queue->head;
+       list;
+       list = g_list_next (list))
+    {
+      GimpUndo *child = list->data;
+
+      evicted += gimp_undo_evict (child, journal);
+    }
+
+  return evicted;
+}
+
 GimpUndoStack *
 gimp_undo_stack_new (GimpImage *image)
 {
@@ -179,13 +179,13 @@ file_save_dialog_response (GtkWidget *dialog,
 
     case CHECK_URI_OK:
       {
-        GimpImage    *image              = file_dialog->image;
-        GimpProgress *progress           = GIMP_PROGRESS (dialog);
-        GimpDisplay  *display_to_close   = NULL;
-        gboolean      xcf_compression    = FALSE;
-        gboolean      is_save_dialog     = GIMP_IS_SAVE_DIALOG (dialog);
-        gboolean      close_after_saving = FALSE;
-        gboolean      save_a_copy        = FALSE;
+        GimpImage          *image              = file_dialog->image;
+        GimpProgress       *progress           = GIMP_PROGRESS (dialog);
+        GimpDisplay        *display_to_close   = NULL;
+        GimpXcfCompression  xcf_compression    = GIMP_XCF_COMPRESSION_NONE;
+        gboolean            is_save_dialog     = GIMP_IS_SAVE_DIALOG (dialog);
+        gboolean            close_after_saving = FALSE;
+        gboolean            save_a_copy        = FALSE;
 
         if (is_save_dialog)
           {
@@ -803,7 +803,7 @@ file_save_dialog_save_image (GimpProgress        *progress,
                              gboolean             change_saved_state,
                              gboolean             export_backward,
                              gboolean             export_forward,
-                             gboolean             xcf_compression,
+                             GimpXcfCompression   xcf_compression,
                              gboolean             verbose_cancel)
 {
   GimpPDBStatusType  status;
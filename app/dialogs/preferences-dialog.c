@@ -1250,6 +1250,10 @@ prefs_dialog_new (Gimp       *gimp,
                          GTK_GRID (grid), 5, size_group);
 #endif /* ENABLE_MP */
 
+  prefs_check_button_add (object, "render-cache",
+                          _("Cache the _layers below the selected layer"),
+                          GTK_BOX (vbox2));
+
   /*  Internet access  */
 #ifdef CHECK_UPDATE
   if (gimp_version_check_update ())
@@ -1544,6 +1548,14 @@ prefs_dialog_new (Gimp       *gimp,
                                    _("_Add an alpha channel to imported images"),
                                    GTK_BOX (vbox2));
 
+  button = prefs_check_button_add (object, "xcf-lazy-load",
+                                   _("_Load XCF layer pixels on demand"),
+                                   GTK_BOX (vbox2));
+
+  button = prefs_check_button_add (object, "xcf-incremental-save",
+                                   _("Only save _changed pixels of XCF files"),
+                                   GTK_BOX (vbox2));
+
   grid = prefs_grid_new (GTK_CONTAINER (vbox2));
   button = prefs_enum_combo_box_add (object, "color-profile-policy", 0, 0,
                                      _("Color _profile policy:"),
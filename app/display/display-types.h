@@ -44,6 +44,7 @@ typedef struct _GimpToolWidget           GimpToolWidget;
 typedef struct _GimpToolWidgetGroup      GimpToolWidgetGroup;
 
 typedef struct _GimpDisplayXfer          GimpDisplayXfer;
+typedef struct _GimpDisplayRenderTiles   GimpDisplayRenderTiles;
 typedef struct _Selection                Selection;
 
 typedef struct _GimpModifiersManager     GimpModifiersManager;
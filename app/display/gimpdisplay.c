@@ -890,4 +890,8 @@ gimp_display_paint_area (GimpDisplay *display,
   gimp_display_shell_expose_area (shell, x1, y1, x2 - x1, y2 - y1);
 
   gimp_display_shell_render_invalidate_area (shell, x1, y1, x2 - x1, y2 - y1);
+
+  gimp_display_shell_render_invalidate_tiles (shell,
+                                              rect.x, rect.y,
+                                              rect.width, rect.height);
 }
@@ -186,6 +186,11 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
                                    (fabs (sin (a)) + fabs (cos (a)));
     }
 
+  /* render the missing display tiles of the painted area at once, so
+   * that the chunks below only need to copy them
+   */
+  gimp_display_shell_render_prepare (shell, x, y, w, h, scale);
+
   /* divide the painted area to evenly-sized chunks */
   n_rows = ceil (h / floor (chunk_height));
   n_cols = ceil (w / floor (chunk_width));
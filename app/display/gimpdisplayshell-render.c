@@ -17,6 +17,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
@@ -32,6 +34,8 @@
 #include "core/gimppickable.h"
 #include "core/gimpprojectable.h"
 
+#include "gegl/gimptilehandlervalidate.h"
+
 #include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
 #include "gimpdisplayshell-transform.h"
@@ -43,6 +47,146 @@
 #define GIMP_DISPLAY_RENDER_ENABLE_SCALING 1
 #define GIMP_DISPLAY_RENDER_MAX_SCALE      4
 
+/*  the display tiles are rendered for one zoom level each, in scaled
+ *  image space, and are kept until their image area is updated, or
+ *  until the cache exceeds its size and they are the least recently
+ *  used ones.
+ */
+#define GIMP_DISPLAY_RENDER_TILE_SIZE       256
+#define GIMP_DISPLAY_RENDER_TILE_BYTES      (GIMP_DISPLAY_RENDER_TILE_SIZE * \
+                                             GIMP_DISPLAY_RENDER_TILE_SIZE * 4)
+#define GIMP_DISPLAY_RENDER_TILE_CACHE_SIZE (64 << 20)
+
+
+typedef struct _GimpDisplayRenderLevel GimpDisplayRenderLevel;
+typedef struct _GimpDisplayRenderTile  GimpDisplayRenderTile;
+
+struct _GimpDisplayRenderTiles
+{
+  GeglBuffer *buffer;       /*  the buffer the tiles were rendered from  */
+  const Babl *format;       /*  the projectable's format                 */
+  gint        flags;        /*  abyss policy and sampler filter          */
+
+  GList      *levels;       /*  most recently used first                 */
+  gint64      size;
+  guint       stamp;        /*  incremented for each drawn frame         */
+};
+
+struct _GimpDisplayRenderLevel
+{
+  gdouble     scale;
+  GHashTable *tiles;
+};
+
+struct _GimpDisplayRenderTile
+{
+  GimpDisplayRenderLevel *level;
+  gint64                  key;
+  gint                    x;
+  gint                    y;
+  guint                   stamp;
+  cairo_surface_t        *surface;
+};
+
+typedef struct
+{
+  GeglBuffer *profile_buffer;
+  guchar     *profile_data;
+  gint        profile_stride;
+
+  GeglBuffer *filter_buffer;
+  guchar     *filter_data;
+  gint        filter_stride;
+} GimpDisplayRenderScratch;
+
+typedef struct
+{
+  GimpDisplayShell *shell;
+  GeglBuffer       *buffer;
+  GeglAbyssPolicy   abyss_policy;
+  gint              filter;
+  gdouble           scale;
+  GPtrArray        *tiles;
+  gint              next_tile;
+} GimpDisplayRenderJob;
+
+
+static void     gimp_display_render_tiles_free            (GimpDisplayRenderTiles   *tiles);
+static void     gimp_display_render_level_free            (GimpDisplayRenderLevel   *level);
+static void     gimp_display_render_tile_free             (GimpDisplayRenderTile    *tile);
+
+static gboolean gimp_display_shell_render_use_tiles       (GimpDisplayShell         *shell);
+static gboolean gimp_display_shell_render_can_thread      (GimpDisplayShell         *shell,
+                                                           GeglBuffer               *buffer);
+static gboolean gimp_display_shell_render_needs_filter_buffer
+                                                          (GimpDisplayShell         *shell);
+static void     gimp_display_shell_render_get_filter      (GimpDisplayShell         *shell,
+                                                           GeglAbyssPolicy          *abyss_policy,
+                                                           gint                     *filter);
+
+static GimpDisplayRenderLevel *
+                gimp_display_shell_render_get_level       (GimpDisplayShell         *shell,
+                                                           GeglBuffer               *buffer,
+                                                           GeglAbyssPolicy           abyss_policy,
+                                                           gint                      filter,
+                                                           gdouble                   scale);
+static void     gimp_display_shell_render_collect_tiles   (GimpDisplayShell         *shell,
+                                                           GimpDisplayRenderLevel   *level,
+                                                           gint                      x,
+                                                           gint                      y,
+                                                           gint                      width,
+                                                           gint                      height,
+                                                           GPtrArray                *tiles,
+                                                           GPtrArray                *missing);
+static void     gimp_display_shell_render_tiles           (GimpDisplayShell         *shell,
+                                                           GeglBuffer               *buffer,
+                                                           GeglAbyssPolicy           abyss_policy,
+                                                           gint                      filter,
+                                                           gdouble                   scale,
+                                                           GPtrArray                *missing);
+static void     gimp_display_shell_render_tiles_func      (gint                      i,
+                                                           gint                      n,
+                                                           GimpDisplayRenderJob     *job);
+static void     gimp_display_shell_render_trim_tiles      (GimpDisplayShell         *shell);
+static void     gimp_display_shell_render_paint_tiles     (GimpDisplayShell         *shell,
+                                                           cairo_t                  *cr,
+                                                           GeglBuffer               *buffer,
+                                                           gint                      x,
+                                                           gint                      y,
+                                                           gint                      width,
+                                                           gint                      height,
+                                                           gdouble                   scale,
+                                                           GeglAbyssPolicy           abyss_policy,
+                                                           gint                      filter);
+
+static void     gimp_display_shell_render_scratch_init    (GimpDisplayShell         *shell,
+                                                           GimpDisplayRenderScratch *scratch,
+                                                           gint                      width,
+                                                           gint                      height);
+static void     gimp_display_shell_render_scratch_clear   (GimpDisplayRenderScratch *scratch);
+
+static void     gimp_display_shell_render_get             (GimpDisplayShell         *shell,
+                                                           GeglBuffer               *buffer,
+                                                           const GeglRectangle      *rect,
+                                                           gdouble                   scale,
+                                                           const Babl               *format,
+                                                           gpointer                  data,
+                                                           gint                      stride,
+                                                           GeglAbyssPolicy           abyss_policy,
+                                                           gint                      filter);
+static void     gimp_display_shell_render_pixels          (GimpDisplayShell         *shell,
+                                                           GimpDisplayRenderScratch *scratch,
+                                                           GeglBuffer               *buffer,
+                                                           const GeglRectangle      *rect,
+                                                           gdouble                   scale,
+                                                           GeglAbyssPolicy           abyss_policy,
+                                                           gint                      filter,
+                                                           guchar                   *cairo_data,
+                                                           gint                      cairo_stride);
+
+
+/*  public functions  */
+
 
 void
 gimp_display_shell_render_set_scale (GimpDisplayShell *shell,
@@ -62,14 +206,93 @@ gimp_display_shell_render_set_scale (GimpDisplayShell *shell,
 #endif
 }
 
+/*  drops both the rendered screen and the display tiles of all zoom
+ *  levels, for changes which affect the rendered pixels themselves.
+ */
 void
 gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell)
 {
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
 
+  gimp_display_shell_render_invalidate_view (shell);
+
+  g_clear_pointer (&shell->render_tiles, gimp_display_render_tiles_free);
+}
+
+/*  drops only the rendered screen, for changes of the view, like
+ *  scrolling and zooming, which can be redrawn from the display tiles.
+ */
+void
+gimp_display_shell_render_invalidate_view (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
   g_clear_pointer (&shell->render_cache_valid, cairo_region_destroy);
 }
 
+/*  drops the display tiles of all zoom levels which show the given
+ *  area, in image coordinates.
+ */
+void
+gimp_display_shell_render_invalidate_tiles (GimpDisplayShell *shell,
+                                            gint              x,
+                                            gint              y,
+                                            gint              width,
+                                            gint              height)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (! shell->render_tiles)
+    return;
+
+  for (list = shell->render_tiles->levels; list; list = g_list_next (list))
+    {
+      GimpDisplayRenderLevel *level     = list->data;
+      GHashTableIter          iter;
+      gpointer                value;
+      gint                    footprint = 1;
+      gint                    x1, y1;
+      gint                    x2, y2;
+
+      /*  zoomed-out levels are sampled from the buffer's mipmaps, so a
+       *  changed pixel spills into its whole mipmap block
+       */
+      while (footprint * level->scale < 1.0 &&
+             footprint < GIMP_DISPLAY_RENDER_TILE_SIZE)
+        {
+          footprint *= 2;
+        }
+
+      x1 = floor ((gdouble) (x - 1)          / footprint) * footprint;
+      y1 = floor ((gdouble) (y - 1)          / footprint) * footprint;
+      x2 = ceil  ((gdouble) (x + width  + 1) / footprint) * footprint;
+      y2 = ceil  ((gdouble) (y + height + 1) / footprint) * footprint;
+
+      x1 = floor (x1 * level->scale) - 1;
+      y1 = floor (y1 * level->scale) - 1;
+      x2 = ceil  (x2 * level->scale) + 1;
+      y2 = ceil  (y2 * level->scale) + 1;
+
+      g_hash_table_iter_init (&iter, level->tiles);
+
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          GimpDisplayRenderTile *tile = value;
+
+          if (tile->x < x2 && tile->x + GIMP_DISPLAY_RENDER_TILE_SIZE > x1 &&
+              tile->y < y2 && tile->y + GIMP_DISPLAY_RENDER_TILE_SIZE > y1)
+            {
+              if (tile->surface)
+                shell->render_tiles->size -= GIMP_DISPLAY_RENDER_TILE_BYTES;
+
+              g_hash_table_iter_remove (&iter);
+            }
+        }
+    }
+}
+
 void
 gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
                                            gint              x,
@@ -140,6 +363,77 @@ gimp_display_shell_render_is_valid (GimpDisplayShell *shell,
   return FALSE;
 }
 
+/*  renders the display tiles which are missing for drawing the given
+ *  screen area, before it is drawn chunk by chunk.  the tiles are
+ *  rendered by several threads at once while the GUI thread waits, so
+ *  that drawing the chunks is reduced to copying finished tiles.
+ */
+void
+gimp_display_shell_render_prepare (GimpDisplayShell *shell,
+                                   gint              x,
+                                   gint              y,
+                                   gint              width,
+                                   gint              height,
+                                   gdouble           scale)
+{
+  GimpImage              *image;
+  GeglBuffer             *buffer;
+  GimpDisplayRenderLevel *level;
+  GPtrArray              *missing;
+  GeglAbyssPolicy         abyss_policy;
+  gint                    filter;
+  gdouble                 x1, y1;
+  gdouble                 x2, y2;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+  g_return_if_fail (scale > 0.0);
+
+  image = gimp_display_get_image (shell->display);
+
+  if (! image                              ||
+      gimp_image_get_converting (image)    ||
+      ! gimp_display_shell_render_use_tiles (shell))
+    {
+      return;
+    }
+
+  if (gimp_display_shell_render_is_valid (shell, x, y, width, height))
+    return;
+
+  buffer = gimp_pickable_get_buffer (
+    gimp_display_shell_get_pickable (shell));
+
+  gimp_display_shell_render_get_filter (shell, &abyss_policy, &filter);
+
+  level = gimp_display_shell_render_get_level (shell, buffer,
+                                               abyss_policy, filter, scale);
+
+  shell->render_tiles->stamp++;
+
+  /* map area from screen space to scaled image space */
+  gimp_display_shell_untransform_bounds_with_scale (shell, scale,
+                                                    x, y,
+                                                    x + width, y + height,
+                                                    &x1, &y1,
+                                                    &x2, &y2);
+
+  missing = g_ptr_array_new ();
+
+  gimp_display_shell_render_collect_tiles (shell, level,
+                                           floor (x1),
+                                           floor (y1),
+                                           ceil (x2) - floor (x1),
+                                           ceil (y2) - floor (y1),
+                                           NULL, missing);
+
+  gimp_display_shell_render_tiles (shell, buffer, abyss_policy, filter,
+                                   scale, missing);
+
+  g_ptr_array_unref (missing);
+
+  gimp_display_shell_render_trim_tiles (shell);
+}
+
 void
 gimp_display_shell_render (GimpDisplayShell *shell,
                            cairo_t          *cr,
@@ -152,10 +446,6 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   GimpDisplayConfig *display_config;
   GimpImage         *image;
   GeglBuffer        *buffer;
-#ifdef USE_NODE_BLIT
-  GeglNode          *node;
-#endif
-
   cairo_t           *my_cr;
   gint               cairo_stride;
   guchar            *cairo_data;
@@ -166,7 +456,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   gint               width;
   gint               height;
   GeglAbyssPolicy    abyss_policy;
-  gint               filter = GEGL_BUFFER_FILTER_AUTO;
+  gint               filter;
 
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
   g_return_if_fail (cr != NULL);
@@ -194,15 +484,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
 
   display_config = shell->display->config;
 
-  if (shell->show_all)
-    abyss_policy = GEGL_ABYSS_NONE;
-  else
-    abyss_policy = GEGL_ABYSS_CLAMP;
-
-  if (display_config->zoom_quality != GIMP_ZOOM_QUALITY_HIGH)
-    {
-      filter = GEGL_BUFFER_FILTER_NEAREST;
-    }
+  gimp_display_shell_render_get_filter (shell, &abyss_policy, &filter);
 
   image  = gimp_display_get_image (shell->display);
 
@@ -216,22 +498,6 @@ gimp_display_shell_render (GimpDisplayShell *shell,
 
   buffer = gimp_pickable_get_buffer (
     gimp_display_shell_get_pickable (shell));
-#ifdef USE_NODE_BLIT
-  node   = gimp_projectable_get_graph (GIMP_PROJECTABLE (image));
-
-  gimp_projectable_begin_render (GIMP_PROJECTABLE (image));
-#endif
-
-  if (! shell->render_surface)
-    {
-      shell->render_surface =
-        cairo_surface_create_similar_image (cairo_get_target (cr),
-                                            CAIRO_FORMAT_ARGB32,
-                                            shell->render_buf_width,
-                                            shell->render_buf_height);
-    }
-
-  cairo_surface_flush (shell->render_surface);
 
   if (! shell->render_cache)
     {
@@ -260,24 +526,34 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   cairo_translate (my_cr, -shell->offset_x, -shell->offset_y);
   cairo_scale (my_cr, shell->scale_x / scale, shell->scale_y / scale);
 
-  cairo_stride = cairo_image_surface_get_stride (shell->render_surface);
-  cairo_data   = cairo_image_surface_get_data (shell->render_surface);
+  /*  SOURCE so the destination's alpha is replaced  */
+  cairo_set_operator (my_cr, CAIRO_OPERATOR_SOURCE);
 
-  if (shell->profile_transform ||
-      gimp_display_shell_has_filter (shell))
+  if (gimp_display_shell_render_use_tiles (shell))
     {
-      gboolean can_convert_to_u8;
-
-      /*  if there is a profile transform or a display filter, we need
-       *  to use temp buffers
+      /*  copy the chunk from the display tiles of the zoom level
        */
+      gimp_display_shell_render_paint_tiles (shell, my_cr, buffer,
+                                             x, y, width, height, scale,
+                                             abyss_policy, filter);
+    }
+  else
+    {
+      GimpDisplayRenderScratch scratch;
 
-      can_convert_to_u8 = gimp_display_shell_profile_can_convert_to_u8 (shell);
+      if (! shell->render_surface)
+        {
+          shell->render_surface =
+            cairo_surface_create_similar_image (cairo_get_target (cr),
+                                                CAIRO_FORMAT_ARGB32,
+                                                shell->render_buf_width,
+                                                shell->render_buf_height);
+        }
 
       /*  create the filter buffer if we have filters, or can't convert
        *  to u8 directly
        */
-      if ((gimp_display_shell_has_filter (shell) || ! can_convert_to_u8) &&
+      if (gimp_display_shell_render_needs_filter_buffer (shell) &&
           ! shell->filter_buffer)
         {
           gint fw = shell->render_buf_width;
@@ -299,42 +575,644 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                                               shell->filter_data);
         }
 
+      scratch.profile_buffer = shell->profile_buffer;
+      scratch.profile_data   = shell->profile_data;
+      scratch.profile_stride = shell->profile_stride;
+      scratch.filter_buffer  = shell->filter_buffer;
+      scratch.filter_data    = shell->filter_data;
+      scratch.filter_stride  = shell->filter_stride;
+
+      cairo_surface_flush (shell->render_surface);
+
+      cairo_stride = cairo_image_surface_get_stride (shell->render_surface);
+      cairo_data   = cairo_image_surface_get_data (shell->render_surface);
+
+#ifdef USE_NODE_BLIT
+      gimp_projectable_begin_render (GIMP_PROJECTABLE (image));
+#endif
+
+      gimp_display_shell_render_pixels (shell, &scratch, buffer,
+                                        GEGL_RECTANGLE (x, y, width, height),
+                                        scale, abyss_policy, filter,
+                                        cairo_data, cairo_stride);
+
+#ifdef USE_NODE_BLIT
+      gimp_projectable_end_render (GIMP_PROJECTABLE (image));
+#endif
+
+      cairo_surface_mark_dirty (shell->render_surface);
+
+      cairo_set_source_surface (my_cr, shell->render_surface, x, y);
+      cairo_paint (my_cr);
+    }
+
+  cairo_set_operator (my_cr, CAIRO_OPERATOR_OVER);
+
+  if (shell->mask)
+    {
+      if (! shell->mask_surface)
+        {
+          shell->mask_surface =
+            cairo_image_surface_create (CAIRO_FORMAT_A8,
+                                        shell->render_buf_width,
+                                        shell->render_buf_height);
+        }
+
+      cairo_surface_flush (shell->mask_surface);
+
+      cairo_stride = cairo_image_surface_get_stride (shell->mask_surface);
+      cairo_data   = cairo_image_surface_get_data (shell->mask_surface);
+
+      gegl_buffer_get (shell->mask,
+                       GEGL_RECTANGLE (x - floor (shell->mask_offset_x * scale),
+                                       y - floor (shell->mask_offset_y * scale),
+                                       width, height),
+                       scale,
+                       babl_format ("Y u8"),
+                       cairo_data, cairo_stride,
+                       GEGL_ABYSS_NONE | filter);
+
+      if (shell->mask_inverted)
+        {
+          gint mask_height = height;
+
+          while (mask_height--)
+            {
+              gint    mask_width = width;
+              guchar *d          = cairo_data;
+
+              while (mask_width--)
+                {
+                  guchar inv = 255 - *d;
+
+                  *d++ = inv;
+                }
+
+              cairo_data += cairo_stride;
+            }
+        }
+
+      cairo_surface_mark_dirty (shell->mask_surface);
+
+      gimp_cairo_set_source_color (my_cr, shell->mask_color,
+                                   GIMP_CORE_CONFIG (display_config)->color_management,
+                                   FALSE, GTK_WIDGET (shell));
+      cairo_mask_surface (my_cr, shell->mask_surface, x, y);
+    }
+
+  cairo_destroy (my_cr);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_display_render_tiles_free (GimpDisplayRenderTiles *tiles)
+{
+  g_list_free_full (tiles->levels,
+                    (GDestroyNotify) gimp_display_render_level_free);
+
+  g_clear_object (&tiles->buffer);
+
+  g_slice_free (GimpDisplayRenderTiles, tiles);
+}
+
+static void
+gimp_display_render_level_free (GimpDisplayRenderLevel *level)
+{
+  g_hash_table_unref (level->tiles);
+
+  g_slice_free (GimpDisplayRenderLevel, level);
+}
+
+static void
+gimp_display_render_tile_free (GimpDisplayRenderTile *tile)
+{
+  g_clear_pointer (&tile->surface, cairo_surface_destroy);
+
+  g_slice_free (GimpDisplayRenderTile, tile);
+}
+
+static gboolean
+gimp_display_shell_render_use_tiles (GimpDisplayShell *shell)
+{
+#ifdef USE_NODE_BLIT
+  return FALSE;
+#else
+  /*  the tiles are only aligned to the screen pixels when the view is
+   *  neither rotated nor flipped, and is scaled evenly
+   */
+  return (! shell->rotate_transform &&
+          shell->scale_x == shell->scale_y);
+#endif
+}
+
+static gboolean
+gimp_display_shell_render_can_thread (GimpDisplayShell *shell,
+                                      GeglBuffer       *buffer)
+{
+  GimpTileHandlerValidate *validate;
+
+  /*  display filters may keep state while converting pixels  */
+  if (gimp_display_shell_has_filter (shell))
+    return FALSE;
+
+  /*  reading dirty areas of the projection validates them on demand,
+   *  which must not happen from several threads at once
+   */
+  validate = gimp_tile_handler_validate_get_assigned (buffer);
+
+  if (validate && ! cairo_region_is_empty (validate->dirty_region))
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gimp_display_shell_render_needs_filter_buffer (GimpDisplayShell *shell)
+{
+  if (! shell->profile_transform && ! gimp_display_shell_has_filter (shell))
+    return FALSE;
+
+  return (gimp_display_shell_has_filter (shell) ||
+          ! gimp_display_shell_profile_can_convert_to_u8 (shell));
+}
+
+static void
+gimp_display_shell_render_get_filter (GimpDisplayShell *shell,
+                                      GeglAbyssPolicy  *abyss_policy,
+                                      gint             *filter)
+{
+  if (shell->show_all)
+    *abyss_policy = GEGL_ABYSS_NONE;
+  else
+    *abyss_policy = GEGL_ABYSS_CLAMP;
+
+  if (shell->display->config->zoom_quality != GIMP_ZOOM_QUALITY_HIGH)
+    *filter = GEGL_BUFFER_FILTER_NEAREST;
+  else
+    *filter = GEGL_BUFFER_FILTER_AUTO;
+}
+
+static GimpDisplayRenderLevel *
+gimp_display_shell_render_get_level (GimpDisplayShell *shell,
+                                     GeglBuffer       *buffer,
+                                     GeglAbyssPolicy   abyss_policy,
+                                     gint              filter,
+                                     gdouble           scale)
+{
+  GimpImage              *image  = gimp_display_get_image (shell->display);
+  const Babl             *format = gimp_projectable_get_format (GIMP_PROJECTABLE (image));
+  GimpDisplayRenderTiles *tiles  = shell->render_tiles;
+  GimpDisplayRenderLevel *level;
+  GList                  *list;
+
+  /*  drop all tiles if they were rendered from a different buffer, or
+   *  with different settings
+   */
+  if (tiles &&
+      (tiles->buffer != buffer ||
+       tiles->format != format ||
+       tiles->flags  != (abyss_policy | filter)))
+    {
+      g_clear_pointer (&shell->render_tiles, gimp_display_render_tiles_free);
+    }
+
+  if (! shell->render_tiles)
+    {
+      shell->render_tiles = g_slice_new0 (GimpDisplayRenderTiles);
+
+      shell->render_tiles->buffer = g_object_ref (buffer);
+      shell->render_tiles->format = format;
+      shell->render_tiles->flags  = abyss_policy | filter;
+    }
+
+  tiles = shell->render_tiles;
+
+  for (list = tiles->levels; list; list = g_list_next (list))
+    {
+      level = list->data;
+
+      if (level->scale == scale)
+        {
+          tiles->levels = g_list_remove_link (tiles->levels, list);
+          tiles->levels = g_list_concat (list, tiles->levels);
+
+          return level;
+        }
+    }
+
+  level = g_slice_new0 (GimpDisplayRenderLevel);
+
+  level->scale = scale;
+  level->tiles = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                        NULL,
+                                        (GDestroyNotify) gimp_display_render_tile_free);
+
+  tiles->levels = g_list_prepend (tiles->levels, level);
+
+  return level;
+}
+
+/*  looks up the tiles of @level covering the given area, in scaled image
+ *  space, and adds them to @tiles.  the tiles which aren't rendered yet
+ *  are created empty, and also added to @missing.
+ */
+static void
+gimp_display_shell_render_collect_tiles (GimpDisplayShell       *shell,
+                                         GimpDisplayRenderLevel *level,
+                                         gint                    x,
+                                         gint                    y,
+                                         gint                    width,
+                                         gint                    height,
+                                         GPtrArray              *tiles,
+                                         GPtrArray              *missing)
+{
+  const gint size = GIMP_DISPLAY_RENDER_TILE_SIZE;
+  gint       col1, row1;
+  gint       col2, row2;
+  gint       col, row;
+
+  col1 = floor ((gdouble) x / size);
+  row1 = floor ((gdouble) y / size);
+  col2 = ceil  ((gdouble) (x + width)  / size);
+  row2 = ceil  ((gdouble) (y + height) / size);
+
+  for (row = row1; row < row2; row++)
+    {
+      for (col = col1; col < col2; col++)
+        {
+          GimpDisplayRenderTile *tile;
+          gint64                 key;
+
+          key = ((gint64) row << 32) | (guint32) col;
+
+          tile = g_hash_table_lookup (level->tiles, &key);
+
+          if (! tile)
+            {
+              tile = g_slice_new0 (GimpDisplayRenderTile);
+
+              tile->level = level;
+              tile->key   = key;
+              tile->x     = col * size;
+              tile->y     = row * size;
+
+              g_hash_table_insert (level->tiles, &tile->key, tile);
+
+              g_ptr_array_add (missing, tile);
+            }
+
+          tile->stamp = shell->render_tiles->stamp;
+
+          if (tiles)
+            g_ptr_array_add (tiles, tile);
+        }
+    }
+}
+
+static void
+gimp_display_shell_render_tiles (GimpDisplayShell *shell,
+                                 GeglBuffer       *buffer,
+                                 GeglAbyssPolicy   abyss_policy,
+                                 gint              filter,
+                                 gdouble           scale,
+                                 GPtrArray        *missing)
+{
+  GimpDisplayRenderJob job;
+
+  if (missing->len == 0)
+    return;
+
+  job.shell        = shell;
+  job.buffer       = buffer;
+  job.abyss_policy = abyss_policy;
+  job.filter       = filter;
+  job.scale        = scale;
+  job.tiles        = missing;
+  job.next_tile    = 0;
+
+  if (missing->len > 1 &&
+      gimp_display_shell_render_can_thread (shell, buffer))
+    {
+      gegl_parallel_distribute (
+        missing->len,
+        (GeglParallelDistributeFunc) gimp_display_shell_render_tiles_func,
+        &job);
+    }
+  else
+    {
+      gimp_display_shell_render_tiles_func (0, 1, &job);
+    }
+
+  shell->render_tiles->size += (gint64) missing->len *
+                               GIMP_DISPLAY_RENDER_TILE_BYTES;
+}
+
+/*  called concurrently from several threads, each of which renders
+ *  tiles, with its own scratch buffers, until there are none left.
+ */
+static void
+gimp_display_shell_render_tiles_func (gint                  i,
+                                      gint                  n,
+                                      GimpDisplayRenderJob *job)
+{
+  GimpDisplayRenderScratch scratch;
+  gint                     t;
+
+  gimp_display_shell_render_scratch_init (job->shell, &scratch,
+                                          GIMP_DISPLAY_RENDER_TILE_SIZE,
+                                          GIMP_DISPLAY_RENDER_TILE_SIZE);
+
+  while ((t = g_atomic_int_add (&job->next_tile, 1)) < (gint) job->tiles->len)
+    {
+      GimpDisplayRenderTile *tile = g_ptr_array_index (job->tiles, t);
+
+      tile->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                  GIMP_DISPLAY_RENDER_TILE_SIZE,
+                                                  GIMP_DISPLAY_RENDER_TILE_SIZE);
+
+      gimp_display_shell_render_pixels (
+        job->shell, &scratch, job->buffer,
+        GEGL_RECTANGLE (tile->x, tile->y,
+                        GIMP_DISPLAY_RENDER_TILE_SIZE,
+                        GIMP_DISPLAY_RENDER_TILE_SIZE),
+        job->scale, job->abyss_policy, job->filter,
+        cairo_image_surface_get_data (tile->surface),
+        cairo_image_surface_get_stride (tile->surface));
+
+      cairo_surface_mark_dirty (tile->surface);
+    }
+
+  gimp_display_shell_render_scratch_clear (&scratch);
+}
+
+static gint
+gimp_display_render_tile_compare_stamp (GimpDisplayRenderTile **tile1,
+                                        GimpDisplayRenderTile **tile2)
+{
+  return ((*tile1)->stamp > (*tile2)->stamp) -
+         ((*tile1)->stamp < (*tile2)->stamp);
+}
+
+/*  drops the least recently used tiles while the cache exceeds its size,
+ *  which is at least large enough to hold the tiles of two full views.
+ *  tiles used for the current frame are never dropped.
+ */
+static void
+gimp_display_shell_render_trim_tiles (GimpDisplayShell *shell)
+{
+  GimpDisplayRenderTiles *tiles = shell->render_tiles;
+  GPtrArray              *unused;
+  GList                  *list;
+  gint64                  max_size;
+  gint                    i;
+
+  max_size = (gint64) 2 * 4 *
+             (shell->disp_width  * shell->render_scale +
+              2 * GIMP_DISPLAY_RENDER_TILE_SIZE) *
+             (shell->disp_height * shell->render_scale +
+              2 * GIMP_DISPLAY_RENDER_TILE_SIZE);
+  max_size = MAX (max_size, GIMP_DISPLAY_RENDER_TILE_CACHE_SIZE);
+
+  if (tiles->size <= max_size)
+    return;
+
+  unused = g_ptr_array_new ();
+
+  for (list = tiles->levels; list; list = g_list_next (list))
+    {
+      GimpDisplayRenderLevel *level = list->data;
+      GHashTableIter          iter;
+      gpointer                value;
+
+      g_hash_table_iter_init (&iter, level->tiles);
+
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          GimpDisplayRenderTile *tile = value;
+
+          if (tile->stamp != tiles->stamp)
+            g_ptr_array_add (unused, tile);
+        }
+    }
+
+  g_ptr_array_sort (unused,
+                    (GCompareFunc) gimp_display_render_tile_compare_stamp);
+
+  /*  trim down to three quarters, so that the next frames don't have
+   *  to trim again right away
+   */
+  for (i = 0; i < unused->len && tiles->size > max_size / 4 * 3; i++)
+    {
+      GimpDisplayRenderTile *tile = g_ptr_array_index (unused, i);
+
+      tiles->size -= GIMP_DISPLAY_RENDER_TILE_BYTES;
+
+      g_hash_table_remove (tile->level->tiles, &tile->key);
+    }
+
+  g_ptr_array_unref (unused);
+
+  for (list = tiles->levels; list; )
+    {
+      GimpDisplayRenderLevel *level = list->data;
+      GList                  *next  = g_list_next (list);
+
+      if (g_hash_table_size (level->tiles) == 0)
+        {
+          tiles->levels = g_list_delete_link (tiles->levels, list);
+
+          gimp_display_render_level_free (level);
+        }
+
+      list = next;
+    }
+}
+
+static void
+gimp_display_shell_render_paint_tiles (GimpDisplayShell *shell,
+                                       cairo_t          *cr,
+                                       GeglBuffer       *buffer,
+                                       gint              x,
+                                       gint              y,
+                                       gint              width,
+                                       gint              height,
+                                       gdouble           scale,
+                                       GeglAbyssPolicy   abyss_policy,
+                                       gint              filter)
+{
+  GimpDisplayRenderLevel *level;
+  GPtrArray              *tiles;
+  GPtrArray              *missing;
+  gint                    i;
+
+  level = gimp_display_shell_render_get_level (shell, buffer,
+                                               abyss_policy, filter, scale);
+
+  tiles   = g_ptr_array_new ();
+  missing = g_ptr_array_new ();
+
+  gimp_display_shell_render_collect_tiles (shell, level,
+                                           x, y, width, height,
+                                           tiles, missing);
+
+  /*  usually, gimp_display_shell_render_prepare() rendered all of them
+   *  already
+   */
+  gimp_display_shell_render_tiles (shell, buffer, abyss_policy, filter,
+                                   scale, missing);
+
+  for (i = 0; i < tiles->len; i++)
+    {
+      GimpDisplayRenderTile *tile = g_ptr_array_index (tiles, i);
+
+      /*  the tiles are aligned to the screen pixels, so they are
+       *  copied without any resampling
+       */
+      cairo_set_source_surface (cr, tile->surface, tile->x, tile->y);
+      cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_NEAREST);
+
+      cairo_rectangle (cr,
+                       tile->x, tile->y,
+                       GIMP_DISPLAY_RENDER_TILE_SIZE,
+                       GIMP_DISPLAY_RENDER_TILE_SIZE);
+      cairo_fill (cr);
+    }
+
+  g_ptr_array_unref (tiles);
+  g_ptr_array_unref (missing);
+}
+
+static void
+gimp_display_shell_render_scratch_init (GimpDisplayShell         *shell,
+                                        GimpDisplayRenderScratch *scratch,
+                                        gint                      width,
+                                        gint                      height)
+{
+  memset (scratch, 0, sizeof (GimpDisplayRenderScratch));
+
+  if (shell->profile_buffer)
+    {
+      const Babl *format = gegl_buffer_get_format (shell->profile_buffer);
+
+      scratch->profile_stride = width * babl_format_get_bytes_per_pixel (format);
+      scratch->profile_data   = gegl_malloc (scratch->profile_stride * height);
+
+      scratch->profile_buffer =
+        gegl_buffer_linear_new_from_data (scratch->profile_data,
+                                          format,
+                                          GEGL_RECTANGLE (0, 0, width, height),
+                                          GEGL_AUTO_ROWSTRIDE,
+                                          (GDestroyNotify) gegl_free,
+                                          scratch->profile_data);
+    }
+
+  if (gimp_display_shell_render_needs_filter_buffer (shell))
+    {
+      const Babl *format = shell->filter_format;
+
+      scratch->filter_stride = width * babl_format_get_bytes_per_pixel (format);
+      scratch->filter_data   = gegl_malloc (scratch->filter_stride * height);
+
+      scratch->filter_buffer =
+        gegl_buffer_linear_new_from_data (scratch->filter_data,
+                                          format,
+                                          GEGL_RECTANGLE (0, 0, width, height),
+                                          GEGL_AUTO_ROWSTRIDE,
+                                          (GDestroyNotify) gegl_free,
+                                          scratch->filter_data);
+    }
+}
+
+static void
+gimp_display_shell_render_scratch_clear (GimpDisplayRenderScratch *scratch)
+{
+  g_clear_object (&scratch->profile_buffer);
+  g_clear_object (&scratch->filter_buffer);
+}
+
+static void
+gimp_display_shell_render_get (GimpDisplayShell    *shell,
+                               GeglBuffer          *buffer,
+                               const GeglRectangle *rect,
+                               gdouble              scale,
+                               const Babl          *format,
+                               gpointer             data,
+                               gint                 stride,
+                               GeglAbyssPolicy      abyss_policy,
+                               gint                 filter)
+{
+#ifndef USE_NODE_BLIT
+  gegl_buffer_get (buffer,
+                   rect, scale,
+                   format, data, stride,
+                   abyss_policy | filter);
+#else
+  GimpImage *image = gimp_display_get_image (shell->display);
+
+  gegl_node_blit (gimp_projectable_get_graph (GIMP_PROJECTABLE (image)),
+                  scale, rect,
+                  format, data, stride,
+                  GEGL_BLIT_CACHE | filter);
+#endif
+}
+
+/*  renders @rect of @buffer, in scaled image space, to @cairo_data,
+ *  applying the display filters and the profile transform.  may be
+ *  called from several threads at once, with separate @scratch buffers.
+ */
+static void
+gimp_display_shell_render_pixels (GimpDisplayShell         *shell,
+                                  GimpDisplayRenderScratch *scratch,
+                                  GeglBuffer               *buffer,
+                                  const GeglRectangle      *rect,
+                                  gdouble                   scale,
+                                  GeglAbyssPolicy           abyss_policy,
+                                  gint                      filter,
+                                  guchar                   *cairo_data,
+                                  gint                      cairo_stride)
+{
+  GimpImage  *image  = gimp_display_get_image (shell->display);
+  const Babl *format = gimp_projectable_get_format (GIMP_PROJECTABLE (image));
+  gint        x      = rect->x;
+  gint        y      = rect->y;
+  gint        width  = rect->width;
+  gint        height = rect->height;
+
+  if (shell->profile_transform ||
+      gimp_display_shell_has_filter (shell))
+    {
+      gboolean can_convert_to_u8;
+
+      /*  if there is a profile transform or a display filter, we need
+       *  to use temp buffers
+       */
+
+      can_convert_to_u8 = gimp_display_shell_profile_can_convert_to_u8 (shell);
+
       if (! gimp_display_shell_has_filter (shell) || shell->filter_transform)
         {
           /*  if there are no filters, or there is a filter transform,
            *  load the projection pixels into the profile_buffer
            */
-#ifndef USE_NODE_BLIT
-          gegl_buffer_get (buffer,
-                           GEGL_RECTANGLE (x, y, width, height), scale,
-                           gimp_projectable_get_format (GIMP_PROJECTABLE (image)),
-                           shell->profile_data, shell->profile_stride,
-                           abyss_policy | filter);
-#else
-          gegl_node_blit (node,
-                          scale, GEGL_RECTANGLE (x, y, width, height),
-                          gimp_projectable_get_format (GIMP_PROJECTABLE (image)),
-                          shell->profile_data, shell->profile_stride,
-                          GEGL_BLIT_CACHE | filter);
-#endif
+          gimp_display_shell_render_get (shell, buffer,
+                                         GEGL_RECTANGLE (x, y, width, height),
+                                         scale, format,
+                                         scratch->profile_data,
+                                         scratch->profile_stride,
+                                         abyss_policy, filter);
         }
       else
         {
           /*  otherwise, load the pixels directly into the filter_buffer
            */
-#ifndef USE_NODE_BLIT
-          gegl_buffer_get (buffer,
-                           GEGL_RECTANGLE (x, y, width, height), scale,
-                           shell->filter_format,
-                           shell->filter_data, shell->filter_stride,
-                           abyss_policy | filter);
-#else
-          gegl_node_blit (node,
-                          scale, GEGL_RECTANGLE (x, y, width, height),
-                          shell->filter_format,
-                          shell->filter_data, shell->filter_stride,
-                          GEGL_BLIT_CACHE | filter);
-#endif
+          gimp_display_shell_render_get (shell, buffer,
+                                         GEGL_RECTANGLE (x, y, width, height),
+                                         scale, shell->filter_format,
+                                         scratch->filter_data,
+                                         scratch->filter_stride,
+                                         abyss_policy, filter);
         }
 
       /*  if there is a filter transform, convert the pixels from
@@ -343,10 +1221,10 @@ gimp_display_shell_render (GimpDisplayShell *shell,
       if (shell->filter_transform)
         {
           gimp_color_transform_process_buffer (shell->filter_transform,
-                                               shell->profile_buffer,
+                                               scratch->profile_buffer,
                                                GEGL_RECTANGLE (0, 0,
                                                                width, height),
-                                               shell->filter_buffer,
+                                               scratch->filter_buffer,
                                                GEGL_RECTANGLE (0, 0,
                                                                width, height));
         }
@@ -362,7 +1240,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
            *  position-dependent filters
            */
           filter_buffer = g_object_new (GEGL_TYPE_BUFFER,
-                                        "source", shell->filter_buffer,
+                                        "source", scratch->filter_buffer,
                                         "shift-x", -x,
                                         "shift-y", -y,
                                         NULL);
@@ -387,10 +1265,10 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                *  in-place
                */
               gimp_color_transform_process_buffer (shell->profile_transform,
-                                                   shell->filter_buffer,
+                                                   scratch->filter_buffer,
                                                    GEGL_RECTANGLE (0, 0,
                                                                    width, height),
-                                                   shell->filter_buffer,
+                                                   scratch->filter_buffer,
                                                    GEGL_RECTANGLE (0, 0,
                                                                    width, height));
             }
@@ -400,10 +1278,10 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                *  the pixels from the profile_buffer to the filter_buffer
                */
               gimp_color_transform_process_buffer (shell->profile_transform,
-                                                   shell->profile_buffer,
+                                                   scratch->profile_buffer,
                                                    GEGL_RECTANGLE (0, 0,
                                                                    width, height),
-                                                   shell->filter_buffer,
+                                                   scratch->filter_buffer,
                                                    GEGL_RECTANGLE (0, 0,
                                                                    width, height));
             }
@@ -421,7 +1299,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                *  the cairo_buffer
                */
               gimp_color_transform_process_buffer (shell->profile_transform,
-                                                   shell->profile_buffer,
+                                                   scratch->profile_buffer,
                                                    GEGL_RECTANGLE (0, 0,
                                                                    width, height),
                                                    buffer,
@@ -436,7 +1314,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
        */
       if (gimp_display_shell_has_filter (shell) || ! can_convert_to_u8)
         {
-          gegl_buffer_get (shell->filter_buffer,
+          gegl_buffer_get (scratch->filter_buffer,
                            GEGL_RECTANGLE (0, 0, width, height), 1.0,
                            babl_format ("cairo-ARGB32"),
                            cairo_data, cairo_stride,
@@ -448,86 +1326,10 @@ gimp_display_shell_render (GimpDisplayShell *shell,
       /*  otherwise we can copy the projection pixels straight to the
        *  cairo-ARGB32 buffer
        */
-#ifndef USE_NODE_BLIT
-      gegl_buffer_get (buffer,
-                       GEGL_RECTANGLE (x, y, width, height), scale,
-                       babl_format ("cairo-ARGB32"),
-                       cairo_data, cairo_stride,
-                       abyss_policy | filter);
-#else
-      gegl_node_blit (node,
-                      scale, GEGL_RECTANGLE (x, y, width, height),
-                      babl_format ("cairo-ARGB32"),
-                      cairo_data, cairo_stride,
-                      GEGL_BLIT_CACHE | filter);
-#endif
+      gimp_display_shell_render_get (shell, buffer,
+                                     GEGL_RECTANGLE (x, y, width, height),
+                                     scale, babl_format ("cairo-ARGB32"),
+                                     cairo_data, cairo_stride,
+                                     abyss_policy, filter);
     }
-
-#ifdef USE_NODE_BLIT
-  gimp_projectable_end_render (GIMP_PROJECTABLE (image));
-#endif
-
-  cairo_surface_mark_dirty (shell->render_surface);
-
-  /*  SOURCE so the destination's alpha is replaced  */
-  cairo_set_operator (my_cr, CAIRO_OPERATOR_SOURCE);
-
-  cairo_set_source_surface (my_cr, shell->render_surface, x, y);
-  cairo_paint (my_cr);
-
-  cairo_set_operator (my_cr, CAIRO_OPERATOR_OVER);
-
-  if (shell->mask)
-    {
-      if (! shell->mask_surface)
-        {
-          shell->mask_surface =
-            cairo_image_surface_create (CAIRO_FORMAT_A8,
-                                        shell->render_buf_width,
-                                        shell->render_buf_height);
-        }
-
-      cairo_surface_flush (shell->mask_surface);
-
-      cairo_stride = cairo_image_surface_get_stride (shell->mask_surface);
-      cairo_data   = cairo_image_surface_get_data (shell->mask_surface);
-
-      gegl_buffer_get (shell->mask,
-                       GEGL_RECTANGLE (x - floor (shell->mask_offset_x * scale),
-                                       y - floor (shell->mask_offset_y * scale),
-                                       width, height),
-                       scale,
-                       babl_format ("Y u8"),
-                       cairo_data, cairo_stride,
-                       GEGL_ABYSS_NONE | filter);
-
-      if (shell->mask_inverted)
-        {
-          gint mask_height = height;
-
-          while (mask_height--)
-            {
-              gint    mask_width = width;
-              guchar *d          = cairo_data;
-
-              while (mask_width--)
-                {
-                  guchar inv = 255 - *d;
-
-                  *d++ = inv;
-                }
-
-              cairo_data += cairo_stride;
-            }
-        }
-
-      cairo_surface_mark_dirty (shell->mask_surface);
-
-      gimp_cairo_set_source_color (my_cr, shell->mask_color,
-                                   GIMP_CORE_CONFIG (display_config)->color_management,
-                                   FALSE, GTK_WIDGET (shell));
-      cairo_mask_surface (my_cr, shell->mask_surface, x, y);
-    }
-
-  cairo_destroy (my_cr);
 }
@@ -18,32 +18,44 @@
 #pragma once
 
 
-void     gimp_display_shell_render_set_scale       (GimpDisplayShell *shell,
-                                                    gint              scale);
+void     gimp_display_shell_render_set_scale        (GimpDisplayShell *shell,
+                                                     gint              scale);
 
-void     gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell);
-void     gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
-                                                    gint              x,
-                                                    gint              y,
-                                                    gint              width,
-                                                    gint              height);
+void     gimp_display_shell_render_invalidate_full  (GimpDisplayShell *shell);
+void     gimp_display_shell_render_invalidate_view  (GimpDisplayShell *shell);
+void     gimp_display_shell_render_invalidate_area  (GimpDisplayShell *shell,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              width,
+                                                     gint              height);
+void     gimp_display_shell_render_invalidate_tiles (GimpDisplayShell *shell,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              width,
+                                                     gint              height);
 
-void     gimp_display_shell_render_validate_area   (GimpDisplayShell *shell,
-                                                    gint              x,
-                                                    gint              y,
-                                                    gint              width,
-                                                    gint              height);
+void     gimp_display_shell_render_validate_area    (GimpDisplayShell *shell,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              width,
+                                                     gint              height);
 
-gboolean gimp_display_shell_render_is_valid        (GimpDisplayShell *shell,
-                                                    gint              x,
-                                                    gint              y,
-                                                    gint              width,
-                                                    gint              height);
+gboolean gimp_display_shell_render_is_valid         (GimpDisplayShell *shell,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              width,
+                                                     gint              height);
 
-void     gimp_display_shell_render                 (GimpDisplayShell *shell,
-                                                    cairo_t          *cr,
-                                                    gint              x,
-                                                    gint              y,
-                                                    gint              width,
-                                                    gint              height,
-                                                    gdouble           scale);
+void     gimp_display_shell_render_prepare          (GimpDisplayShell *shell,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              width,
+                                                     gint              height,
+                                                     gdouble           scale);
+void     gimp_display_shell_render                  (GimpDisplayShell *shell,
+                                                     cairo_t          *cr,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              width,
+                                                     gint              height,
+                                                     gdouble           scale);
@@ -396,21 +396,35 @@ selection_zoom_segs (Selection          *selection,
 static void
 selection_generate_segs (Selection *selection)
 {
-  GimpImage          *image = gimp_display_get_image (selection->shell->display);
-  const GimpBoundSeg *segs_in;
-  const GimpBoundSeg *segs_out;
-  gint                canvas_offset_x = 0;
-  gint                canvas_offset_y = 0;
+  GimpImage     *image = gimp_display_get_image (selection->shell->display);
+  GimpBoundSeg  *segs_in;
+  GimpBoundSeg  *segs_out;
+  GeglRectangle  rect;
+  gint           canvas_offset_x = 0;
+  gint           canvas_offset_y = 0;
 
   selection_free_segs (selection);
 
+  /*  Only the part of the boundary in view is drawn, so only ask for the
+   *  segments touching it, with a pixel to spare for the segments on the
+   *  edges of the view
+   */
+  gimp_display_shell_untransform_viewport (selection->shell, FALSE,
+                                           &rect.x, &rect.y,
+                                           &rect.width, &rect.height);
+
+  rect.x      -= 1;
+  rect.y      -= 1;
+  rect.width  += 2;
+  rect.height += 2;
+
   /*  Ask the image for the boundary of its selected region...
    *  Then transform that information into a new buffer of GimpSegments
    */
-  gimp_channel_boundary (gimp_image_get_mask (image),
-                         &segs_in, &segs_out,
-                         &selection->n_segs_in, &selection->n_segs_out,
-                         0, 0, 0, 0);
+  gimp_channel_boundary_in_rect (gimp_image_get_mask (image), &rect,
+                                 &segs_in, &segs_out,
+                                 &selection->n_segs_in, &selection->n_segs_out,
+                                 0, 0, 0, 0);
 
   if (selection->n_segs_in)
     {
@@ -430,6 +444,9 @@ selection_generate_segs (Selection *selection)
                            selection->segs_out, selection->n_segs_out,
                            canvas_offset_x, canvas_offset_y);
     }
+
+  g_free (segs_in);
+  g_free (segs_out);
 }
 
 static void
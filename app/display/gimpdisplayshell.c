@@ -855,8 +855,8 @@ gimp_display_shell_dispose (GObject *object)
   g_clear_object (&shell->zoom_gesture);
   g_clear_object (&shell->rotate_gesture);
 
-  g_clear_pointer (&shell->render_cache,       cairo_surface_destroy);
-  g_clear_pointer (&shell->render_cache_valid, cairo_region_destroy);
+  g_clear_pointer (&shell->render_cache, cairo_surface_destroy);
+  gimp_display_shell_render_invalidate_full (shell);
 
   g_clear_pointer (&shell->render_surface, cairo_surface_destroy);
   g_clear_pointer (&shell->mask_surface,   cairo_surface_destroy);
@@ -2314,7 +2314,7 @@ gimp_display_shell_set_mask (GimpDisplayShell *shell,
   shell->mask_inverted = inverted;
 
   gimp_display_shell_expose_full (shell);
-  gimp_display_shell_render_invalidate_full (shell);
+  gimp_display_shell_render_invalidate_view (shell);
 }
 
 /**
@@ -173,6 +173,8 @@ struct _GimpDisplayShell
   cairo_surface_t   *render_cache;
   cairo_region_t    *render_cache_valid;
 
+  GimpDisplayRenderTiles *render_tiles; /*  per-zoom-level tile cache       */
+
   gint               render_buf_width;
   gint               render_buf_height;
 
@@ -623,6 +623,28 @@ gimp_tile_handler_validate_validate (GimpTileHandlerValidate *validate,
     }
 }
 
+/* renders @rect of the graph into @buffer, which is not the buffer the
+ * handler is assigned to, leaving the dirty region alone.  the caller
+ * is responsible for calling gimp_tile_handler_validate_undo_invalidate()
+ * once the result ends up in the assigned buffer.  must be called
+ * between gimp_tile_handler_validate_begin_validate() and
+ * gimp_tile_handler_validate_end_validate().
+ */
+void
+gimp_tile_handler_validate_render (GimpTileHandlerValidate *validate,
+                                   const GeglRectangle     *rect,
+                                   GeglBuffer              *buffer)
+{
+  g_return_if_fail (GIMP_IS_TILE_HANDLER_VALIDATE (validate));
+  g_return_if_fail (rect != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (validate->validating > 0);
+
+  GIMP_TILE_HANDLER_VALIDATE_GET_CLASS (validate)->validate_buffer (validate,
+                                                                    rect,
+                                                                    buffer);
+}
+
 gboolean
 gimp_tile_handler_validate_buffer_set_extent (GeglBuffer          *buffer,
                                               const GeglRectangle *extent)
@@ -95,6 +95,9 @@ void                      gimp_tile_handler_validate_validate          (GimpTile
                                                                         const GeglRectangle     *rect,
                                                                         gboolean                 intersect,
                                                                         gboolean                 chunked);
+void                      gimp_tile_handler_validate_render            (GimpTileHandlerValidate *validate,
+                                                                        const GeglRectangle     *rect,
+                                                                        GeglBuffer              *buffer);
 
 gboolean                  gimp_tile_handler_validate_buffer_set_extent (GeglBuffer              *buffer,
                                                                         const GeglRectangle     *extent);
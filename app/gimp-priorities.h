@@ -37,4 +37,6 @@
 
 #define GIMP_PRIORITY_VIEWABLE_IDLE (G_PRIORITY_LOW)
 
+#define GIMP_PRIORITY_LINK_LOAD_IDLE (G_PRIORITY_LOW)
+
 /* #define G_PRIORITY_LOW 300 */
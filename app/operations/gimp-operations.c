@@ -38,6 +38,7 @@
 #include "gimpoperationequalize.h"
 #include "gimpoperationfillsource.h"
 #include "gimpoperationflood.h"
+#include "gimpoperationfusedpointfilter.h"
 #include "gimpoperationgradient.h"
 #include "gimpoperationgrow.h"
 #include "gimpoperationhistogramsink.h"
@@ -93,6 +94,7 @@
 #include "layer-modes/gimpoperationerase.h"
 #include "layer-modes/gimpoperationmerge.h"
 #include "layer-modes/gimpoperationnormal.h"
+#include "layer-modes/gimpoperationnormalstack.h"
 #include "layer-modes/gimpoperationpassthrough.h"
 #include "layer-modes/gimpoperationoverwrite.h"
 #include "layer-modes/gimpoperationreplace.h"
@@ -134,6 +136,7 @@ gimp_operations_init (Gimp *gimp)
   g_type_class_ref (GIMP_TYPE_OPERATION_EQUALIZE);
   g_type_class_ref (GIMP_TYPE_OPERATION_FILL_SOURCE);
   g_type_class_ref (GIMP_TYPE_OPERATION_FLOOD);
+  g_type_class_ref (GIMP_TYPE_OPERATION_FUSED_POINT_FILTER);
   g_type_class_ref (GIMP_TYPE_OPERATION_GRADIENT);
   g_type_class_ref (GIMP_TYPE_OPERATION_GROW);
   g_type_class_ref (GIMP_TYPE_OPERATION_HISTOGRAM_SINK);
@@ -157,6 +160,7 @@ gimp_operations_init (Gimp *gimp)
   g_type_class_ref (GIMP_TYPE_OPERATION_THRESHOLD);
 
   g_type_class_ref (GIMP_TYPE_OPERATION_NORMAL);
+  g_type_class_ref (GIMP_TYPE_OPERATION_NORMAL_STACK);
   g_type_class_ref (GIMP_TYPE_OPERATION_DISSOLVE);
   g_type_class_ref (GIMP_TYPE_OPERATION_BEHIND);
   g_type_class_ref (GIMP_TYPE_OPERATION_MULTIPLY_LEGACY);
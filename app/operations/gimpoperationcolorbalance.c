@@ -35,13 +35,16 @@
 #include "gimp-intl.h"
 
 
-static void     gimp_operation_color_balance_prepare (GeglOperation       *operation);
-static gboolean gimp_operation_color_balance_process (GeglOperation       *operation,
-                                                      void                *in_buf,
-                                                      void                *out_buf,
-                                                      glong                samples,
-                                                      const GeglRectangle *roi,
-                                                      gint                 level);
+static void         gimp_operation_color_balance_prepare    (GeglOperation            *operation);
+static gboolean     gimp_operation_color_balance_process    (GeglOperation            *operation,
+                                                             void                     *in_buf,
+                                                             void                     *out_buf,
+                                                             glong                     samples,
+                                                             const GeglRectangle      *roi,
+                                                             gint                      level);
+
+static const Babl * gimp_operation_color_balance_get_format (GimpOperationPointFilter *filter,
+                                                             const Babl               *space);
 
 
 G_DEFINE_TYPE (GimpOperationColorBalance, gimp_operation_color_balance,
@@ -56,6 +59,7 @@ gimp_operation_color_balance_class_init (GimpOperationColorBalanceClass *klass)
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
 
   object_class->set_property   = gimp_operation_point_filter_set_property;
   object_class->get_property   = gimp_operation_point_filter_get_property;
@@ -70,6 +74,8 @@ gimp_operation_color_balance_class_init (GimpOperationColorBalanceClass *klass)
 
   point_class->process     = gimp_operation_color_balance_process;
 
+  filter_class->get_format = gimp_operation_color_balance_get_format;
+
   g_object_class_install_property (object_class,
                                    GIMP_OPERATION_POINT_FILTER_PROP_CONFIG,
                                    g_param_spec_object ("config",
@@ -140,6 +146,13 @@ gimp_operation_color_balance_prepare (GeglOperation *operation)
   gegl_operation_set_format (operation, "output", format);
 }
 
+static const Babl *
+gimp_operation_color_balance_get_format (GimpOperationPointFilter *filter,
+                                         const Babl               *space)
+{
+  return babl_format_with_space ("R'G'B'A float", NULL);
+}
+
 static gboolean
 gimp_operation_color_balance_process (GeglOperation       *operation,
                                       void                *in_buf,
@@ -182,7 +195,7 @@ gimp_operation_color_balance_process (GeglOperation       *operation,
   yellow_blue_highlights   = (gfloat) config->yellow_blue[GIMP_TRANSFER_HIGHLIGHTS];
 
   total      = samples * 4;
-  format     = gegl_operation_get_format (operation, "input");
+  format     = babl_format_with_space ("R'G'B'A float", NULL);
   hsl_format = babl_format_with_space ("HSLA float", NULL);
 
   hsl = g_new0 (gfloat, total);
@@ -79,6 +79,7 @@ gimp_operation_colorize_class_init (GimpOperationColorizeClass *klass)
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
   GeglColor                     *color;
   gfloat                         hsl[3]          = { 0.5f, 0.5f, 0.5f };
 
@@ -95,6 +96,9 @@ gimp_operation_colorize_class_init (GimpOperationColorizeClass *klass)
 
   point_class->process = gimp_operation_colorize_process;
 
+  /*  prepare() sets up fishes from the input space, can't run fused  */
+  filter_class->get_format = NULL;
+
   GIMP_CONFIG_PROP_DOUBLE (object_class, PROP_HUE,
                            "hue",
                            _("Hue"),
@@ -72,6 +72,7 @@ gimp_operation_desaturate_class_init (GimpOperationDesaturateClass *klass)
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
 
   object_class->set_property = gimp_operation_desaturate_set_property;
   object_class->get_property = gimp_operation_desaturate_get_property;
@@ -80,6 +81,9 @@ gimp_operation_desaturate_class_init (GimpOperationDesaturateClass *klass)
 
   point_class->process       = gimp_operation_desaturate_process;
 
+  /*  process() looks up the luminance of the input space, can't run fused  */
+  filter_class->get_format   = NULL;
+
   gegl_operation_class_set_keys (operation_class,
                                  "name",        "gimp:desaturate",
                                  "categories",  "color",
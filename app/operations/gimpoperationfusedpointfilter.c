@@ -0,0 +1,277 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationfusedpointfilter.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Runs a chain of point filters in a single pass: each block of pixels
+ * goes through all the filters while it's still in the cache, instead of
+ * each filter going over the whole buffer, with its own tiles and format
+ * conversions, in turn.  The filters' nodes aren't processed themselves,
+ * only their process() functions are called.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "operations-types.h"
+
+#include "gimpoperationpointfilter.h"
+#include "gimpoperationfusedpointfilter.h"
+
+
+/*  the number of pixels each block goes through the whole chain at once,
+ *  small enough for the block to stay in the L1 cache
+ */
+#define BLOCK_SIZE 256
+
+
+static void       gimp_operation_fused_point_filter_finalize    (GObject                       *object);
+
+static void       gimp_operation_fused_point_filter_prepare     (GeglOperation                 *operation);
+static gboolean   gimp_operation_fused_point_filter_process     (GeglOperation                 *operation,
+                                                                 void                          *in_buf,
+                                                                 void                          *out_buf,
+                                                                 glong                          samples,
+                                                                 const GeglRectangle           *roi,
+                                                                 gint                           level);
+
+static void       gimp_operation_fused_point_filter_clear       (GimpOperationFusedPointFilter *fused);
+static void       gimp_operation_fused_point_filter_invalidated (GeglNode                      *node,
+                                                                 const GeglRectangle           *rect,
+                                                                 GimpOperationFusedPointFilter *fused);
+
+
+G_DEFINE_TYPE (GimpOperationFusedPointFilter, gimp_operation_fused_point_filter,
+               GEGL_TYPE_OPERATION_POINT_FILTER)
+
+#define parent_class gimp_operation_fused_point_filter_parent_class
+
+
+static void
+gimp_operation_fused_point_filter_class_init (GimpOperationFusedPointFilterClass *klass)
+{
+  GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
+  GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+
+  object_class->finalize   = gimp_operation_fused_point_filter_finalize;
+
+  operation_class->prepare = gimp_operation_fused_point_filter_prepare;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name",        "gimp:fused-point-filter",
+                                 "categories",  "hidden",
+                                 "description", "GIMP chain of point filters run in one pass",
+                                 NULL);
+
+  point_class->process     = gimp_operation_fused_point_filter_process;
+}
+
+static void
+gimp_operation_fused_point_filter_init (GimpOperationFusedPointFilter *self)
+{
+}
+
+static void
+gimp_operation_fused_point_filter_finalize (GObject *object)
+{
+  GimpOperationFusedPointFilter *fused = GIMP_OPERATION_FUSED_POINT_FILTER (object);
+
+  gimp_operation_fused_point_filter_clear (fused);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_operation_fused_point_filter_prepare (GeglOperation *operation)
+{
+  GimpOperationFusedPointFilter *fused  = GIMP_OPERATION_FUSED_POINT_FILTER (operation);
+  const Babl                    *space  = gegl_operation_get_source_space (operation,
+                                                                           "input");
+  const Babl                    *first  = babl_format_with_space ("RGBA float",
+                                                                  space);
+  const Babl                    *last   = first;
+  gint                           i;
+
+  for (i = 0; i < fused->n_nodes; i++)
+    {
+      GeglOperation *filter = gegl_node_get_gegl_operation (fused->nodes[i]);
+      const Babl    *format;
+
+      format = gimp_operation_point_filter_get_format (
+        GIMP_OPERATION_POINT_FILTER (filter), space);
+
+      if (i == 0)
+        first = format;
+
+      fused->fishes[i] = NULL;
+
+      if (i > 0 && format != last)
+        fused->fishes[i] = babl_fish (last, format);
+
+      last = format;
+    }
+
+  gegl_operation_set_format (operation, "input",  first);
+  gegl_operation_set_format (operation, "output", last);
+}
+
+static gboolean
+gimp_operation_fused_point_filter_process (GeglOperation       *operation,
+                                           void                *in_buf,
+                                           void                *out_buf,
+                                           glong                samples,
+                                           const GeglRectangle *roi,
+                                           gint                 level)
+{
+  GimpOperationFusedPointFilter *fused = GIMP_OPERATION_FUSED_POINT_FILTER (operation);
+  gfloat                        *src   = in_buf;
+  gfloat                        *dest  = out_buf;
+  gfloat                         scratch[BLOCK_SIZE * 4];
+
+  if (fused->n_nodes == 0)
+    {
+      if (dest != src)
+        memcpy (dest, src, samples * 4 * sizeof (gfloat));
+
+      return TRUE;
+    }
+
+  while (samples > 0)
+    {
+      glong   n         = MIN (samples, BLOCK_SIZE);
+      gfloat *block_src = src;
+      gint    i;
+
+      for (i = 0; i < fused->n_nodes; i++)
+        {
+          GeglOperation                 *filter;
+          GeglOperationPointFilterClass *point_class;
+
+          filter      = gegl_node_get_gegl_operation (fused->nodes[i]);
+          point_class = GEGL_OPERATION_POINT_FILTER_GET_CLASS (filter);
+
+          if (fused->fishes[i])
+            {
+              babl_process (fused->fishes[i], block_src, scratch, n);
+
+              block_src = scratch;
+            }
+
+          point_class->process (filter, block_src, dest, n, roi, level);
+
+          block_src = dest;
+        }
+
+      src     += n * 4;
+      dest    += n * 4;
+      samples -= n;
+    }
+
+  return TRUE;
+}
+
+
+/*  public functions  */
+
+gboolean
+gimp_operation_fused_point_filter_can_fuse (GeglNode *node)
+{
+  GeglOperation *operation;
+
+  g_return_val_if_fail (GEGL_IS_NODE (node), FALSE);
+
+  operation = gegl_node_get_gegl_operation (node);
+
+  return (GIMP_IS_OPERATION_POINT_FILTER (operation) &&
+          GIMP_OPERATION_POINT_FILTER_GET_CLASS (operation)->get_format);
+}
+
+void
+gimp_operation_fused_point_filter_set_nodes (GimpOperationFusedPointFilter  *fused,
+                                             GeglNode                      **nodes,
+                                             gint                            n_nodes)
+{
+  gint i;
+
+  g_return_if_fail (GIMP_IS_OPERATION_FUSED_POINT_FILTER (fused));
+  g_return_if_fail (nodes != NULL || n_nodes == 0);
+
+  if (n_nodes == fused->n_nodes &&
+      (n_nodes == 0 ||
+       ! memcmp (nodes, fused->nodes, n_nodes * sizeof (GeglNode *))))
+    {
+      return;
+    }
+
+  for (i = 0; i < n_nodes; i++)
+    g_return_if_fail (gimp_operation_fused_point_filter_can_fuse (nodes[i]));
+
+  gimp_operation_fused_point_filter_clear (fused);
+
+  fused->nodes   = g_new  (GeglNode *,   n_nodes);
+  fused->fishes  = g_new0 (const Babl *, n_nodes);
+  fused->n_nodes = n_nodes;
+
+  /*  the filters' nodes aren't part of the rendered graph anymore, but
+   *  their properties still change the result
+   */
+  for (i = 0; i < n_nodes; i++)
+    {
+      fused->nodes[i] = g_object_ref (nodes[i]);
+
+      g_signal_connect (nodes[i], "invalidated",
+                        G_CALLBACK (gimp_operation_fused_point_filter_invalidated),
+                        fused);
+    }
+
+  gegl_operation_invalidate (GEGL_OPERATION (fused), NULL, TRUE);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_operation_fused_point_filter_clear (GimpOperationFusedPointFilter *fused)
+{
+  gint i;
+
+  for (i = 0; i < fused->n_nodes; i++)
+    {
+      g_signal_handlers_disconnect_by_func (
+        fused->nodes[i],
+        gimp_operation_fused_point_filter_invalidated,
+        fused);
+
+      g_object_unref (fused->nodes[i]);
+    }
+
+  g_clear_pointer (&fused->nodes,  g_free);
+  g_clear_pointer (&fused->fishes, g_free);
+  fused->n_nodes = 0;
+}
+
+static void
+gimp_operation_fused_point_filter_invalidated (GeglNode                      *node,
+                                               const GeglRectangle           *rect,
+                                               GimpOperationFusedPointFilter *fused)
+{
+  gegl_operation_invalidate (GEGL_OPERATION (fused), rect, TRUE);
+}
@@ -0,0 +1,57 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationfusedpointfilter.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gegl-plugin.h>
+
+
+#define GIMP_TYPE_OPERATION_FUSED_POINT_FILTER            (gimp_operation_fused_point_filter_get_type ())
+#define GIMP_OPERATION_FUSED_POINT_FILTER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_OPERATION_FUSED_POINT_FILTER, GimpOperationFusedPointFilter))
+#define GIMP_OPERATION_FUSED_POINT_FILTER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_OPERATION_FUSED_POINT_FILTER, GimpOperationFusedPointFilterClass))
+#define GIMP_IS_OPERATION_FUSED_POINT_FILTER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_OPERATION_FUSED_POINT_FILTER))
+#define GIMP_IS_OPERATION_FUSED_POINT_FILTER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_OPERATION_FUSED_POINT_FILTER))
+#define GIMP_OPERATION_FUSED_POINT_FILTER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_OPERATION_FUSED_POINT_FILTER, GimpOperationFusedPointFilterClass))
+
+
+typedef struct _GimpOperationFusedPointFilter      GimpOperationFusedPointFilter;
+typedef struct _GimpOperationFusedPointFilterClass GimpOperationFusedPointFilterClass;
+
+struct _GimpOperationFusedPointFilter
+{
+  GeglOperationPointFilter   parent_instance;
+
+  GeglNode                 **nodes;
+  const Babl               **fishes;
+  gint                       n_nodes;
+};
+
+struct _GimpOperationFusedPointFilterClass
+{
+  GeglOperationPointFilterClass  parent_class;
+};
+
+
+GType      gimp_operation_fused_point_filter_get_type  (void) G_GNUC_CONST;
+
+gboolean   gimp_operation_fused_point_filter_can_fuse  (GeglNode                      *node);
+
+void       gimp_operation_fused_point_filter_set_nodes (GimpOperationFusedPointFilter *fused,
+                                                        GeglNode                     **nodes,
+                                                        gint                           n_nodes);
@@ -35,6 +35,9 @@
 #include "gimp-intl.h"
 
 static void gimp_operation_hue_saturation_prepare (GeglOperation *operation);
+static const Babl *
+       gimp_operation_hue_saturation_get_format  (GimpOperationPointFilter *filter,
+                                                  const Babl               *space);
 
 static gboolean gimp_operation_hue_saturation_process (GeglOperation       *operation,
                                                        void                *in_buf,
@@ -56,6 +59,7 @@ gimp_operation_hue_saturation_class_init (GimpOperationHueSaturationClass *klass
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
 
   object_class->set_property   = gimp_operation_point_filter_set_property;
   object_class->get_property   = gimp_operation_point_filter_get_property;
@@ -68,6 +72,7 @@ gimp_operation_hue_saturation_class_init (GimpOperationHueSaturationClass *klass
 
   point_class->process = gimp_operation_hue_saturation_process;
   operation_class->prepare = gimp_operation_hue_saturation_prepare;
+  filter_class->get_format = gimp_operation_hue_saturation_get_format;
 
   g_object_class_install_property (object_class,
                                    GIMP_OPERATION_POINT_FILTER_PROP_CONFIG,
@@ -191,6 +196,13 @@ gimp_operation_hue_saturation_prepare (GeglOperation *operation)
   gegl_operation_set_format (operation, "output", format);
 }
 
+static const Babl *
+gimp_operation_hue_saturation_get_format (GimpOperationPointFilter *filter,
+                                          const Babl               *space)
+{
+  return babl_format_with_space ("HSLA float", NULL);
+}
+
 static gboolean
 gimp_operation_hue_saturation_process (GeglOperation       *operation,
                                        void                *in_buf,
@@ -53,16 +53,25 @@ struct _GimpOperationPointFilter
 struct _GimpOperationPointFilterClass
 {
   GeglOperationPointFilterClass  parent_class;
+
+  /*  the format process() works in, without relying on prepare(), so
+   *  the filter can run fused with others; NULL if it can't
+   */
+  const Babl * (* get_format) (GimpOperationPointFilter *filter,
+                               const Babl               *space);
 };
 
 
-GType   gimp_operation_point_filter_get_type     (void) G_GNUC_CONST;
+GType        gimp_operation_point_filter_get_type     (void) G_GNUC_CONST;
+
+const Babl * gimp_operation_point_filter_get_format   (GimpOperationPointFilter *filter,
+                                                       const Babl               *space);
 
-void    gimp_operation_point_filter_get_property (GObject      *object,
-                                                  guint         property_id,
-                                                  GValue       *value,
-                                                  GParamSpec   *pspec);
-void    gimp_operation_point_filter_set_property (GObject      *object,
-                                                  guint         property_id,
-                                                  const GValue *value,
-                                                  GParamSpec   *pspec);
+void         gimp_operation_point_filter_get_property (GObject                  *object,
+                                                       guint                     property_id,
+                                                       GValue                   *value,
+                                                       GParamSpec               *pspec);
+void         gimp_operation_point_filter_set_property (GObject                  *object,
+                                                       guint                     property_id,
+                                                       const GValue             *value,
+                                                       GParamSpec               *pspec);
@@ -52,6 +52,9 @@ static void     gimp_operation_posterize_set_property (GObject             *obje
                                                        GParamSpec          *pspec);
 
 static void gimp_operation_posterize_prepare (GeglOperation *operation);
+static const Babl *
+            gimp_operation_posterize_get_format (GimpOperationPointFilter *filter,
+                                                 const Babl               *space);
 
 static gboolean gimp_operation_posterize_process      (GeglOperation       *operation,
                                                        void                *in_buf,
@@ -73,11 +76,13 @@ gimp_operation_posterize_class_init (GimpOperationPosterizeClass *klass)
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
 
   object_class->set_property = gimp_operation_posterize_set_property;
   object_class->get_property = gimp_operation_posterize_get_property;
   operation_class->prepare   = gimp_operation_posterize_prepare;
   point_class->process       = gimp_operation_posterize_process;
+  filter_class->get_format   = gimp_operation_posterize_get_format;
 
   gegl_operation_class_set_keys (operation_class,
                                  "name",        "gimp:posterize",
@@ -148,6 +153,13 @@ gimp_operation_posterize_prepare (GeglOperation *operation)
   gegl_operation_set_format (operation, "output", format);
 }
 
+static const Babl *
+gimp_operation_posterize_get_format (GimpOperationPointFilter *filter,
+                                     const Babl               *space)
+{
+  return babl_format_with_space ("R~G~B~A float", space);
+}
+
 
 static gboolean
 gimp_operation_posterize_process (GeglOperation       *operation,
@@ -62,6 +62,9 @@ static gboolean gimp_operation_threshold_process (GeglOperation       *operation
                                                   gint                 level);
 
 static void gimp_operation_threshold_prepare (GeglOperation *operation);
+static const Babl *
+            gimp_operation_threshold_get_format (GimpOperationPointFilter *filter,
+                                                 const Babl               *space);
 
 G_DEFINE_TYPE (GimpOperationThreshold, gimp_operation_threshold,
                GIMP_TYPE_OPERATION_POINT_FILTER)
@@ -75,6 +78,7 @@ gimp_operation_threshold_class_init (GimpOperationThresholdClass *klass)
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
 
   object_class->set_property = gimp_operation_threshold_set_property;
   object_class->get_property = gimp_operation_threshold_get_property;
@@ -83,6 +87,8 @@ gimp_operation_threshold_class_init (GimpOperationThresholdClass *klass)
 
   point_class->process       = gimp_operation_threshold_process;
 
+  filter_class->get_format   = gimp_operation_threshold_get_format;
+
   gegl_operation_class_set_keys (operation_class,
                                  "name",        "gimp:threshold",
                                  "categories",  "color",
@@ -183,6 +189,13 @@ gimp_operation_threshold_prepare (GeglOperation *operation)
   gegl_operation_set_format (operation, "output", format);
 }
 
+static const Babl *
+gimp_operation_threshold_get_format (GimpOperationPointFilter *filter,
+                                     const Babl               *space)
+{
+  return babl_format_with_space ("R'G'B'A float", space);
+}
+
 static gboolean
 gimp_operation_threshold_process (GeglOperation       *operation,
                                   void                *in_buf,
@@ -24,6 +24,8 @@
 #include <glib-object.h>
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
+
 #include "../operations-types.h"
 
 #include "gegl/gimp-babl.h"
@@ -49,6 +51,14 @@ struct _GimpLayerModeInfo
   GimpLayerColorSpace       blend_space;
 };
 
+typedef struct _GimpLayerModeBlendSimd GimpLayerModeBlendSimd;
+
+struct _GimpLayerModeBlendSimd
+{
+  GimpLayerModeBlendFunc    blend_function;
+  GimpLayerModeBlendFunc    simd_function;
+};
+
 
 /*  static variables  */
 
@@ -1130,6 +1140,61 @@ static const GimpLayerMode layer_mode_groups[][2] =
 
 static GeglOperation *ops[G_N_ELEMENTS (layer_mode_infos)] = { 0 };
 
+static GimpLayerModeBlendFunc blend_functions[G_N_ELEMENTS (layer_mode_infos)] = { 0 };
+
+#if COMPILE_AVX2_INTRINISICS
+static const GimpLayerModeBlendSimd blend_functions_avx2[] =
+{
+  { gimp_operation_layer_mode_blend_addition,
+    gimp_operation_layer_mode_blend_addition_avx2      },
+  { gimp_operation_layer_mode_blend_burn,
+    gimp_operation_layer_mode_blend_burn_avx2          },
+  { gimp_operation_layer_mode_blend_darken_only,
+    gimp_operation_layer_mode_blend_darken_only_avx2   },
+  { gimp_operation_layer_mode_blend_difference,
+    gimp_operation_layer_mode_blend_difference_avx2    },
+  { gimp_operation_layer_mode_blend_divide,
+    gimp_operation_layer_mode_blend_divide_avx2        },
+  { gimp_operation_layer_mode_blend_dodge,
+    gimp_operation_layer_mode_blend_dodge_avx2         },
+  { gimp_operation_layer_mode_blend_exclusion,
+    gimp_operation_layer_mode_blend_exclusion_avx2     },
+  { gimp_operation_layer_mode_blend_grain_extract,
+    gimp_operation_layer_mode_blend_grain_extract_avx2 },
+  { gimp_operation_layer_mode_blend_grain_merge,
+    gimp_operation_layer_mode_blend_grain_merge_avx2   },
+  { gimp_operation_layer_mode_blend_hard_mix,
+    gimp_operation_layer_mode_blend_hard_mix_avx2      },
+  { gimp_operation_layer_mode_blend_hardlight,
+    gimp_operation_layer_mode_blend_hardlight_avx2     },
+  { gimp_operation_layer_mode_blend_lch_color,
+    gimp_operation_layer_mode_blend_lch_color_avx2     },
+  { gimp_operation_layer_mode_blend_lch_lightness,
+    gimp_operation_layer_mode_blend_lch_lightness_avx2 },
+  { gimp_operation_layer_mode_blend_lighten_only,
+    gimp_operation_layer_mode_blend_lighten_only_avx2  },
+  { gimp_operation_layer_mode_blend_linear_burn,
+    gimp_operation_layer_mode_blend_linear_burn_avx2   },
+  { gimp_operation_layer_mode_blend_linear_light,
+    gimp_operation_layer_mode_blend_linear_light_avx2  },
+  { gimp_operation_layer_mode_blend_multiply,
+    gimp_operation_layer_mode_blend_multiply_avx2      },
+  { gimp_operation_layer_mode_blend_overlay,
+    gimp_operation_layer_mode_blend_overlay_avx2       },
+  { gimp_operation_layer_mode_blend_pin_light,
+    gimp_operation_layer_mode_blend_pin_light_avx2     },
+  { gimp_operation_layer_mode_blend_screen,
+    gimp_operation_layer_mode_blend_screen_avx2        },
+  { gimp_operation_layer_mode_blend_softlight,
+    gimp_operation_layer_mode_blend_softlight_avx2     },
+  { gimp_operation_layer_mode_blend_subtract,
+    gimp_operation_layer_mode_blend_subtract_avx2      },
+  { gimp_operation_layer_mode_blend_vivid_light,
+    gimp_operation_layer_mode_blend_vivid_light_avx2   }
+};
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+
 /*  public functions  */
 
 void
@@ -1140,7 +1205,28 @@ gimp_layer_modes_init (void)
   for (i = 0; i < G_N_ELEMENTS (layer_mode_infos); i++)
     {
       gimp_assert ((GimpLayerMode) i == layer_mode_infos[i].layer_mode);
+
+      blend_functions[i] = layer_mode_infos[i].blend_function;
     }
+
+#if COMPILE_AVX2_INTRINISICS
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2)
+    {
+      for (i = 0; i < G_N_ELEMENTS (layer_mode_infos); i++)
+        {
+          gint j;
+
+          for (j = 0; j < G_N_ELEMENTS (blend_functions_avx2); j++)
+            {
+              if (blend_functions[i] == blend_functions_avx2[j].blend_function)
+                {
+                  blend_functions[i] = blend_functions_avx2[j].simd_function;
+                  break;
+                }
+            }
+        }
+    }
+#endif
 }
 
 void
@@ -1368,7 +1454,11 @@ gimp_layer_mode_get_blend_function (GimpLayerMode mode)
   if (! info)
     return NULL;
 
-  return info->blend_function;
+  /*  before gimp_layer_modes_init(), use the generic functions  */
+  if (! blend_functions[info->layer_mode])
+    return info->blend_function;
+
+  return blend_functions[info->layer_mode];
 }
 
 GimpLayerModeContext
@@ -0,0 +1,410 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-blend-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-blend.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 */
+#include <immintrin.h>
+
+
+#define EPSILON      1e-6f
+
+#define SAFE_DIV_MIN EPSILON
+#define SAFE_DIV_MAX (1.0f / SAFE_DIV_MIN)
+
+
+/*  each blend mode is a function blending two pixels of "in" with two
+ *  pixels of "layer" at once.  its results must be the same as the generic
+ *  function's, bit for bit: both sides of a branch are evaluated, and the
+ *  right one is selected per component, doing the same arithmetic, in the
+ *  same order.
+ *
+ *  the modes which convert to other color models (hsl, hsv, luminance) or
+ *  call into libm don't have a vectorized version.
+ */
+
+#define BLEND_FUNC_AVX2(name)                                                  \
+void                                                                           \
+gimp_operation_layer_mode_blend_##name##_avx2 (GeglOperation *operation,      \
+                                              const gfloat  *in,              \
+                                              const gfloat  *layer,           \
+                                              gfloat        *comp,            \
+                                              gint           samples)         \
+{                                                                              \
+  const __m256 v_zero = _mm256_setzero_ps ();                                  \
+                                                                               \
+  for (; samples >= 2; samples -= 2)                                           \
+    {                                                                          \
+      __m256 v_in    = _mm256_loadu_ps (in);                                   \
+      __m256 v_layer = _mm256_loadu_ps (layer);                                \
+      __m256 v_comp  = _mm256_loadu_ps (comp);                                 \
+      __m256 blend;                                                            \
+                                                                               \
+      /*  like the generic function, leave comp[RED..BLUE] alone where        \
+       *  in[ALPHA] or layer[ALPHA] are zero                                   \
+       */                                                                      \
+      blend = _mm256_and_ps (_mm256_cmp_ps (blend_alpha (v_in), v_zero,        \
+                                            _CMP_NEQ_UQ),                      \
+                             _mm256_cmp_ps (blend_alpha (v_layer), v_zero,     \
+                                            _CMP_NEQ_UQ));                     \
+                                                                               \
+      v_comp = _mm256_blendv_ps (v_comp, blend_##name (v_in, v_layer), blend); \
+                                                                               \
+      _mm256_storeu_ps (comp, _mm256_blend_ps (v_comp, v_layer, 0x88));        \
+                                                                               \
+      in    += 8;                                                              \
+      layer += 8;                                                              \
+      comp  += 8;                                                              \
+    }                                                                          \
+                                                                               \
+  if (samples)                                                                 \
+    {                                                                          \
+      gimp_operation_layer_mode_blend_##name (operation, in, layer, comp,      \
+                                              samples);                        \
+    }                                                                          \
+}
+
+
+/*  private functions  */
+
+
+/*  the alpha of each pixel, in all of its components  */
+static inline __m256
+blend_alpha (__m256 v)
+{
+  return _mm256_permute_ps (v, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+/*  returns "cond ? a : b", per component  */
+static inline __m256
+blend_select (__m256 cond,
+              __m256 a,
+              __m256 b)
+{
+  return _mm256_blendv_ps (b, a, cond);
+}
+
+static inline __m256
+blend_fabs (__m256 v)
+{
+  return _mm256_andnot_ps (_mm256_set1_ps (-0.0f), v);
+}
+
+/*  MIN() and MAX() pick the second operand when the comparison fails,
+ *  which is what these instructions do too
+ */
+static inline __m256
+blend_min (__m256 a,
+           __m256 b)
+{
+  return _mm256_min_ps (a, b);
+}
+
+static inline __m256
+blend_max (__m256 a,
+           __m256 b)
+{
+  return _mm256_max_ps (a, b);
+}
+
+/* returns a / b, clamped to [-SAFE_DIV_MAX, SAFE_DIV_MAX].
+ * if -SAFE_DIV_MIN <= a <= SAFE_DIV_MIN, returns 0.
+ */
+static inline __m256
+blend_safe_div (__m256 a,
+                __m256 b)
+{
+  const __m256 v_min = _mm256_set1_ps (SAFE_DIV_MIN);
+  const __m256 v_max = _mm256_set1_ps (SAFE_DIV_MAX);
+  __m256       result;
+
+  result = a / b;
+  result = blend_select (_mm256_cmp_ps (result, v_max, _CMP_GT_OQ),
+                         v_max,
+                         blend_select (_mm256_cmp_ps (result, -v_max,
+                                                      _CMP_LT_OQ),
+                                       -v_max, result));
+
+  return _mm256_and_ps (_mm256_cmp_ps (blend_fabs (a), v_min, _CMP_GT_OQ),
+                        result);
+}
+
+
+/*  blend modes  */
+
+
+static inline __m256 /* aka linear_dodge */
+blend_addition (__m256 in,
+                __m256 layer)
+{
+  return in + layer;
+}
+
+static inline __m256
+blend_burn (__m256 in,
+            __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+
+  return v_one - blend_safe_div (v_one - in, layer);
+}
+
+static inline __m256
+blend_darken_only (__m256 in,
+                   __m256 layer)
+{
+  return blend_min (in, layer);
+}
+
+static inline __m256
+blend_difference (__m256 in,
+                  __m256 layer)
+{
+  return blend_fabs (in - layer);
+}
+
+static inline __m256
+blend_divide (__m256 in,
+              __m256 layer)
+{
+  return blend_safe_div (in, layer);
+}
+
+static inline __m256
+blend_dodge (__m256 in,
+             __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+
+  return blend_safe_div (in, v_one - layer);
+}
+
+static inline __m256
+blend_exclusion (__m256 in,
+                 __m256 layer)
+{
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+
+  return v_half - v_two * (in - v_half) * (layer - v_half);
+}
+
+static inline __m256
+blend_grain_extract (__m256 in,
+                     __m256 layer)
+{
+  return in - layer + _mm256_set1_ps (0.5f);
+}
+
+static inline __m256
+blend_grain_merge (__m256 in,
+                   __m256 layer)
+{
+  return in + layer - _mm256_set1_ps (0.5f);
+}
+
+static inline __m256
+blend_hard_mix (__m256 in,
+                __m256 layer)
+{
+  return _mm256_andnot_ps (_mm256_cmp_ps (in + layer, _mm256_set1_ps (1.0f),
+                                          _CMP_LT_OQ),
+                           _mm256_set1_ps (1.0f));
+}
+
+static inline __m256
+blend_hardlight (__m256 in,
+                 __m256 layer)
+{
+  const __m256 v_one  = _mm256_set1_ps (1.0f);
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+  __m256       above;
+  __m256       below;
+
+  above = (v_one - in) * (v_one - (layer - v_half) * v_two);
+  above = blend_min (v_one - above, v_one);
+
+  below = in * (layer * v_two);
+  below = blend_min (below, v_one);
+
+  return blend_select (_mm256_cmp_ps (layer, v_half, _CMP_GT_OQ),
+                       above, below);
+}
+
+static inline __m256
+blend_lch_color (__m256 in,
+                 __m256 layer)
+{
+  return _mm256_blend_ps (layer, in, 0x11);
+}
+
+static inline __m256
+blend_lch_lightness (__m256 in,
+                     __m256 layer)
+{
+  return _mm256_blend_ps (in, layer, 0x11);
+}
+
+static inline __m256
+blend_lighten_only (__m256 in,
+                    __m256 layer)
+{
+  return blend_max (in, layer);
+}
+
+static inline __m256
+blend_linear_burn (__m256 in,
+                   __m256 layer)
+{
+  return in + layer - _mm256_set1_ps (1.0f);
+}
+
+static inline __m256
+blend_linear_light (__m256 in,
+                    __m256 layer)
+{
+  const __m256 v_one  = _mm256_set1_ps (1.0f);
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+
+  return blend_select (_mm256_cmp_ps (layer, v_half, _CMP_LE_OQ),
+                       in + v_two * layer - v_one,
+                       in + v_two * (layer - v_half));
+}
+
+static inline __m256
+blend_multiply (__m256 in,
+                __m256 layer)
+{
+  return in * layer;
+}
+
+static inline __m256
+blend_overlay (__m256 in,
+               __m256 layer)
+{
+  const __m256 v_one  = _mm256_set1_ps (1.0f);
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+
+  return blend_select (_mm256_cmp_ps (in, v_half, _CMP_LT_OQ),
+                       v_two * in * layer,
+                       v_one - v_two * (v_one - layer) * (v_one - in));
+}
+
+static inline __m256
+blend_pin_light (__m256 in,
+                 __m256 layer)
+{
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+
+  return blend_select (_mm256_cmp_ps (layer, v_half, _CMP_GT_OQ),
+                       blend_max (in, v_two * (layer - v_half)),
+                       blend_min (in, v_two * layer));
+}
+
+static inline __m256
+blend_screen (__m256 in,
+              __m256 layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+
+  return v_one - (v_one - in) * (v_one - layer);
+}
+
+static inline __m256
+blend_softlight (__m256 in,
+                 __m256 layer)
+{
+  const __m256 v_one    = _mm256_set1_ps (1.0f);
+  __m256       multiply = in * layer;
+  __m256       screen   = v_one - (v_one - in) * (v_one - layer);
+
+  return (v_one - in) * multiply + in * screen;
+}
+
+static inline __m256
+blend_subtract (__m256 in,
+                __m256 layer)
+{
+  return in - layer;
+}
+
+static inline __m256
+blend_vivid_light (__m256 in,
+                   __m256 layer)
+{
+  const __m256 v_one  = _mm256_set1_ps (1.0f);
+  const __m256 v_two  = _mm256_set1_ps (2.0f);
+  const __m256 v_half = _mm256_set1_ps (0.5f);
+  __m256       below;
+  __m256       above;
+
+  below = v_one - blend_safe_div (v_one - in, v_two * layer);
+  below = blend_max (below, _mm256_setzero_ps ());
+
+  above = blend_safe_div (in, v_two * (v_one - layer));
+  above = blend_min (above, v_one);
+
+  return blend_select (_mm256_cmp_ps (layer, v_half, _CMP_LE_OQ),
+                       below, above);
+}
+
+
+/*  public functions  */
+
+
+BLEND_FUNC_AVX2 (addition)
+BLEND_FUNC_AVX2 (burn)
+BLEND_FUNC_AVX2 (darken_only)
+BLEND_FUNC_AVX2 (difference)
+BLEND_FUNC_AVX2 (divide)
+BLEND_FUNC_AVX2 (dodge)
+BLEND_FUNC_AVX2 (exclusion)
+BLEND_FUNC_AVX2 (grain_extract)
+BLEND_FUNC_AVX2 (grain_merge)
+BLEND_FUNC_AVX2 (hard_mix)
+BLEND_FUNC_AVX2 (hardlight)
+BLEND_FUNC_AVX2 (lch_color)
+BLEND_FUNC_AVX2 (lch_lightness)
+BLEND_FUNC_AVX2 (lighten_only)
+BLEND_FUNC_AVX2 (linear_burn)
+BLEND_FUNC_AVX2 (linear_light)
+BLEND_FUNC_AVX2 (multiply)
+BLEND_FUNC_AVX2 (overlay)
+BLEND_FUNC_AVX2 (pin_light)
+BLEND_FUNC_AVX2 (screen)
+BLEND_FUNC_AVX2 (softlight)
+BLEND_FUNC_AVX2 (subtract)
+BLEND_FUNC_AVX2 (vivid_light)
+
+#endif /* COMPILE_AVX2_INTRINISICS */
@@ -0,0 +1,523 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-composite-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-composite.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 */
+#include <immintrin.h>
+
+
+/*  these functions process two pixels per iteration, and produce the same
+ *  results as the generic functions, bit for bit: all the branches are
+ *  evaluated, and the right result is selected per pixel, doing the same
+ *  arithmetic, in the same order.  an odd trailing pixel is passed to the
+ *  generic function.
+ */
+
+
+/*  the alpha of each pixel, in all of its components  */
+static inline __m256
+composite_alpha (__m256 v)
+{
+  return _mm256_permute_ps (v, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+/*  the mask value of each pixel, in all of its components  */
+static inline __m256
+composite_mask (const gfloat *mask)
+{
+  return _mm256_setr_ps (mask[0], mask[0], mask[0], mask[0],
+                         mask[1], mask[1], mask[1], mask[1]);
+}
+
+static inline __m256
+composite_is_zero (__m256 v)
+{
+  return _mm256_cmp_ps (v, _mm256_setzero_ps (), _CMP_EQ_OQ);
+}
+
+/*  returns "cond ? a : b", per component  */
+static inline __m256
+composite_select (__m256 cond,
+                  __m256 a,
+                  __m256 b)
+{
+  return _mm256_blendv_ps (b, a, cond);
+}
+
+/*  stores the color components of "color", and the alpha of "alpha"  */
+static inline void
+composite_store (gfloat *out,
+                 __m256  color,
+                 __m256  alpha)
+{
+  _mm256_storeu_ps (out, _mm256_blend_ps (color, alpha, 0x88));
+}
+
+
+/*  non-subtractive compositing functions.  these functions expect comp[ALPHA]
+ *  to be the same as layer[ALPHA].  when in[ALPHA] or layer[ALPHA] are zero,
+ *  the value of comp[RED..BLUE] is unconstrained (in particular, it may be
+ *  NaN).
+ */
+
+
+void
+gimp_operation_layer_mode_composite_union_avx2 (const gfloat *in,
+                                                const gfloat *layer,
+                                                const gfloat *comp,
+                                                const gfloat *mask,
+                                                gfloat        opacity,
+                                                gfloat       *out,
+                                                gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = composite_alpha (v_in);
+      __m256 layer_alpha = composite_alpha (v_layer) * v_opacity;
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = layer_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      new_alpha = layer_alpha + (v_one - layer_alpha) * in_alpha;
+
+      ratio = layer_alpha / new_alpha;
+      v_out = ratio * (in_alpha * (v_comp - v_layer) + v_layer - v_in) + v_in;
+
+      v_out = composite_select (composite_is_zero (in_alpha),
+                                v_layer, v_out);
+      v_out = composite_select (_mm256_or_ps (composite_is_zero (layer_alpha),
+                                             composite_is_zero (new_alpha)),
+                                v_in, v_out);
+
+      composite_store (out, v_out, new_alpha);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_union (in, layer, comp, mask,
+                                                 opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_backdrop_avx2 (const gfloat *in,
+                                                           const gfloat *layer,
+                                                           const gfloat *comp,
+                                                           const gfloat *mask,
+                                                           gfloat        opacity,
+                                                           gfloat       *out,
+                                                           gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = composite_alpha (v_in);
+      __m256 layer_alpha = composite_alpha (v_comp) * v_opacity;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = layer_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      v_out = v_comp * layer_alpha + v_in * (v_one - layer_alpha);
+
+      v_out = composite_select (_mm256_or_ps (composite_is_zero (in_alpha),
+                                             composite_is_zero (layer_alpha)),
+                                v_in, v_out);
+
+      composite_store (out, v_out, in_alpha);
+
+      in   += 8;
+      comp += 8;
+      out  += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_backdrop (in, layer, comp,
+                                                            mask, opacity, out,
+                                                            samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_layer_avx2 (const gfloat *in,
+                                                        const gfloat *layer,
+                                                        const gfloat *comp,
+                                                        const gfloat *mask,
+                                                        gfloat        opacity,
+                                                        gfloat       *out,
+                                                        gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = composite_alpha (v_in);
+      __m256 layer_alpha = composite_alpha (v_layer) * v_opacity;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = layer_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      v_out = v_comp * in_alpha + v_layer * (v_one - in_alpha);
+
+      v_out = composite_select (composite_is_zero (in_alpha),
+                                v_layer, v_out);
+      v_out = composite_select (composite_is_zero (layer_alpha),
+                                v_in, v_out);
+
+      composite_store (out, v_out, layer_alpha);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_layer (in, layer, comp, mask,
+                                                         opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_intersection_avx2 (const gfloat *in,
+                                                       const gfloat *layer,
+                                                       const gfloat *comp,
+                                                       const gfloat *mask,
+                                                       gfloat        opacity,
+                                                       gfloat       *out,
+                                                       gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in      = _mm256_loadu_ps (in);
+      __m256 v_comp    = _mm256_loadu_ps (comp);
+      __m256 new_alpha = composite_alpha (v_in) * composite_alpha (v_comp) *
+                         v_opacity;
+      __m256 v_out;
+
+      if (mask)
+        {
+          new_alpha = new_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      v_out = composite_select (composite_is_zero (new_alpha),
+                                v_in, v_comp);
+
+      composite_store (out, v_out, new_alpha);
+
+      in   += 8;
+      comp += 8;
+      out  += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_intersection (in, layer, comp, mask,
+                                                        opacity, out, samples);
+    }
+}
+
+/*  subtractive compositing functions.  these functions expect comp[ALPHA] to
+ *  specify the modified alpha of the overlapping content, as a fraction of the
+ *  original overlapping content (i.e., an alpha of 1.0 specifies that no
+ *  content is subtracted.)  when in[ALPHA] or layer[ALPHA] are zero, the value
+ *  of comp[RED..BLUE] is unconstrained (in particular, it may be NaN).
+ */
+
+void
+gimp_operation_layer_mode_composite_union_sub_avx2 (const gfloat *in,
+                                                    const gfloat *layer,
+                                                    const gfloat *comp,
+                                                    const gfloat *mask,
+                                                    gfloat        opacity,
+                                                    gfloat       *out,
+                                                    gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_two     = _mm256_set1_ps (2.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = composite_alpha (v_in);
+      __m256 layer_alpha = composite_alpha (v_layer) * v_opacity;
+      __m256 comp_alpha  = composite_alpha (v_comp);
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 layer_coeff;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = layer_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      new_alpha = in_alpha + layer_alpha -
+                  (v_two - comp_alpha) * in_alpha * layer_alpha;
+
+      ratio       = in_alpha / new_alpha;
+      layer_coeff = v_one / in_alpha - v_one;
+
+      v_out = ratio * (layer_alpha * (comp_alpha * v_comp + layer_coeff * v_layer - v_in) + v_in);
+
+      v_out = composite_select (composite_is_zero (in_alpha),
+                                v_layer, v_out);
+      v_out = composite_select (_mm256_or_ps (composite_is_zero (layer_alpha),
+                                             composite_is_zero (new_alpha)),
+                                v_in, v_out);
+
+      composite_store (out, v_out, new_alpha);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_union_sub (in, layer, comp, mask,
+                                                     opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_backdrop_sub_avx2 (const gfloat *in,
+                                                               const gfloat *layer,
+                                                               const gfloat *comp,
+                                                               const gfloat *mask,
+                                                               gfloat        opacity,
+                                                               gfloat       *out,
+                                                               gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = composite_alpha (v_in);
+      __m256 layer_alpha = composite_alpha (v_layer) * v_opacity;
+      __m256 comp_alpha  = composite_alpha (v_comp);
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = layer_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      comp_alpha = comp_alpha * layer_alpha;
+
+      new_alpha = v_one - layer_alpha + comp_alpha;
+
+      ratio = comp_alpha / new_alpha;
+      v_out = v_comp * ratio + v_in * (v_one - ratio);
+
+      v_out = composite_select (_mm256_or_ps (composite_is_zero (in_alpha),
+                                             composite_is_zero (comp_alpha)),
+                                v_in, v_out);
+
+      composite_store (out, v_out, new_alpha * in_alpha);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_backdrop_sub (in, layer, comp,
+                                                                mask, opacity,
+                                                                out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_layer_sub_avx2 (const gfloat *in,
+                                                            const gfloat *layer,
+                                                            const gfloat *comp,
+                                                            const gfloat *mask,
+                                                            gfloat        opacity,
+                                                            gfloat       *out,
+                                                            gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_layer     = _mm256_loadu_ps (layer);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 in_alpha    = composite_alpha (v_in);
+      __m256 layer_alpha = composite_alpha (v_layer) * v_opacity;
+      __m256 comp_alpha  = composite_alpha (v_comp);
+      __m256 new_alpha;
+      __m256 ratio;
+      __m256 v_out;
+
+      if (mask)
+        {
+          layer_alpha = layer_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      comp_alpha = comp_alpha * in_alpha;
+
+      new_alpha = v_one - in_alpha + comp_alpha;
+
+      ratio = comp_alpha / new_alpha;
+      v_out = v_comp * ratio + v_layer * (v_one - ratio);
+
+      v_out = composite_select (composite_is_zero (in_alpha),
+                                v_layer, v_out);
+      v_out = composite_select (composite_is_zero (layer_alpha),
+                                v_in, v_out);
+
+      composite_store (out, v_out, new_alpha * layer_alpha);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_layer_sub (in, layer, comp,
+                                                             mask, opacity,
+                                                             out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_intersection_sub_avx2 (const gfloat *in,
+                                                           const gfloat *layer,
+                                                           const gfloat *comp,
+                                                           const gfloat *mask,
+                                                           gfloat        opacity,
+                                                           gfloat       *out,
+                                                           gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in      = _mm256_loadu_ps (in);
+      __m256 v_layer   = _mm256_loadu_ps (layer);
+      __m256 v_comp    = _mm256_loadu_ps (comp);
+      __m256 new_alpha = composite_alpha (v_in)    *
+                         composite_alpha (v_layer) *
+                         composite_alpha (v_comp)  *
+                         v_opacity;
+      __m256 v_out;
+
+      if (mask)
+        {
+          new_alpha = new_alpha * composite_mask (mask);
+
+          mask += 2;
+        }
+
+      v_out = composite_select (composite_is_zero (new_alpha),
+                                v_in, v_comp);
+
+      composite_store (out, v_out, new_alpha);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_intersection_sub (in, layer, comp,
+                                                            mask, opacity,
+                                                            out, samples);
+    }
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
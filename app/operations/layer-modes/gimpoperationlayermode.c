@@ -210,6 +210,21 @@ gimp_operation_layer_mode_class_init (GimpOperationLayerModeClass *klass)
   if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
     composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_sse2;
 #endif
+
+#if COMPILE_AVX2_INTRINISICS
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2)
+    {
+      composite_union                = gimp_operation_layer_mode_composite_union_avx2;
+      composite_clip_to_backdrop     = gimp_operation_layer_mode_composite_clip_to_backdrop_avx2;
+      composite_clip_to_layer        = gimp_operation_layer_mode_composite_clip_to_layer_avx2;
+      composite_intersection         = gimp_operation_layer_mode_composite_intersection_avx2;
+
+      composite_union_sub            = gimp_operation_layer_mode_composite_union_sub_avx2;
+      composite_clip_to_backdrop_sub = gimp_operation_layer_mode_composite_clip_to_backdrop_sub_avx2;
+      composite_clip_to_layer_sub    = gimp_operation_layer_mode_composite_clip_to_layer_sub_avx2;
+      composite_intersection_sub     = gimp_operation_layer_mode_composite_intersection_sub_avx2;
+    }
+#endif
 }
 
 static void
@@ -0,0 +1,735 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationnormalstack.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Composites a run of NORMAL-mode layers over the input in a single
+ * pass.  Instead of one gimp:normal node per layer, each writing a
+ * whole intermediate buffer that the next one reads back, the layers'
+ * buffers are read directly, and each block of pixels goes through all
+ * of them at once, using gimp:normal's own process function.  The
+ * result is the same as chaining gimp:normal nodes in UNION mode,
+ * without masks.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "../operations-types.h"
+
+#include "gegl/gimptilehandlervalidate.h"
+
+#include "gimp-layer-modes.h"
+#include "gimpoperationnormalstack.h"
+
+
+enum
+{
+  PROP_0,
+  PROP_COMPOSITE_SPACE
+};
+
+
+typedef struct
+{
+  GeglBuffer              *buffer;
+  GimpTileHandlerValidate *validate_handler;
+  gint                     offset_x;
+  gint                     offset_y;
+  gfloat                   opacity;
+
+  /*  a gimp:normal node, whose operation the layer's pixels are
+   *  composited with
+   */
+  GeglNode                *mode_node;
+} NormalStackLayer;
+
+
+static void            gimp_operation_normal_stack_finalize     (GObject                  *object);
+static void            gimp_operation_normal_stack_set_property (GObject                  *object,
+                                                                 guint                     property_id,
+                                                                 const GValue             *value,
+                                                                 GParamSpec               *pspec);
+static void            gimp_operation_normal_stack_get_property (GObject                  *object,
+                                                                 guint                     property_id,
+                                                                 GValue                   *value,
+                                                                 GParamSpec               *pspec);
+
+static void            gimp_operation_normal_stack_prepare      (GeglOperation            *operation);
+static GeglRectangle   gimp_operation_normal_stack_get_bounding_box
+                                                                (GeglOperation            *operation);
+static gboolean        gimp_operation_normal_stack_parent_process
+                                                                (GeglOperation            *operation,
+                                                                 GeglOperationContext     *context,
+                                                                 const gchar              *output_prop,
+                                                                 const GeglRectangle      *result,
+                                                                 gint                      level);
+static gboolean        gimp_operation_normal_stack_process      (GeglOperation            *operation,
+                                                                 GeglBuffer               *input,
+                                                                 GeglBuffer               *output,
+                                                                 const GeglRectangle      *result,
+                                                                 gint                      level);
+
+static GeglRectangle   gimp_operation_normal_stack_get_layer_rect
+                                                                (NormalStackLayer         *layer,
+                                                                 const GeglRectangle      *rect,
+                                                                 gint                      level);
+static gboolean        gimp_operation_normal_stack_is_visible   (NormalStackLayer         *layer,
+                                                                 const GeglRectangle      *rect,
+                                                                 gint                      level);
+static void            gimp_operation_normal_stack_init_layer   (GimpOperationNormalStack *stack,
+                                                                 NormalStackLayer         *layer,
+                                                                 GeglBuffer               *buffer,
+                                                                 gint                      offset_x,
+                                                                 gint                      offset_y,
+                                                                 gdouble                   opacity);
+static void            gimp_operation_normal_stack_clear_layer  (GimpOperationNormalStack *stack,
+                                                                 NormalStackLayer         *layer);
+static void            gimp_operation_normal_stack_invalidate_layer
+                                                                (GimpOperationNormalStack *stack,
+                                                                 NormalStackLayer         *layer);
+static void            gimp_operation_normal_stack_remove_layers
+                                                                (GimpOperationNormalStack *stack,
+                                                                 gboolean                  invalidate);
+static void            gimp_operation_normal_stack_invalidate   (gpointer                  object,
+                                                                 const GeglRectangle      *rect,
+                                                                 GimpOperationNormalStack *stack);
+
+
+G_DEFINE_TYPE (GimpOperationNormalStack, gimp_operation_normal_stack,
+               GEGL_TYPE_OPERATION_FILTER)
+
+#define parent_class gimp_operation_normal_stack_parent_class
+
+
+static void
+gimp_operation_normal_stack_class_init (GimpOperationNormalStackClass *klass)
+{
+  GObjectClass             *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass       *operation_class = GEGL_OPERATION_CLASS (klass);
+  GeglOperationFilterClass *filter_class    = GEGL_OPERATION_FILTER_CLASS (klass);
+
+  object_class->finalize            = gimp_operation_normal_stack_finalize;
+  object_class->set_property        = gimp_operation_normal_stack_set_property;
+  object_class->get_property        = gimp_operation_normal_stack_get_property;
+
+  operation_class->prepare          = gimp_operation_normal_stack_prepare;
+  operation_class->get_bounding_box = gimp_operation_normal_stack_get_bounding_box;
+  operation_class->process          = gimp_operation_normal_stack_parent_process;
+
+  operation_class->threaded         = TRUE;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name",        "gimp:normal-stack",
+                                 "categories",  "hidden",
+                                 "description", "GIMP run of normal mode layers composited in one pass",
+                                 NULL);
+
+  filter_class->process             = gimp_operation_normal_stack_process;
+
+  g_object_class_install_property (object_class, PROP_COMPOSITE_SPACE,
+                                   g_param_spec_enum ("composite-space",
+                                                      NULL, NULL,
+                                                      GIMP_TYPE_LAYER_COLOR_SPACE,
+                                                      GIMP_LAYER_COLOR_SPACE_RGB_LINEAR,
+                                                      GIMP_PARAM_READWRITE |
+                                                      G_PARAM_CONSTRUCT));
+}
+
+static void
+gimp_operation_normal_stack_init (GimpOperationNormalStack *self)
+{
+  self->layers = g_array_new (FALSE, FALSE, sizeof (NormalStackLayer));
+}
+
+static void
+gimp_operation_normal_stack_finalize (GObject *object)
+{
+  GimpOperationNormalStack *stack = GIMP_OPERATION_NORMAL_STACK (object);
+
+  gimp_operation_normal_stack_remove_layers (stack, FALSE);
+
+  g_clear_pointer (&stack->layers, g_array_unref);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_operation_normal_stack_set_property (GObject      *object,
+                                          guint         property_id,
+                                          const GValue *value,
+                                          GParamSpec   *pspec)
+{
+  GimpOperationNormalStack *stack = GIMP_OPERATION_NORMAL_STACK (object);
+
+  switch (property_id)
+    {
+    case PROP_COMPOSITE_SPACE:
+      stack->composite_space = g_value_get_enum (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_normal_stack_get_property (GObject    *object,
+                                          guint       property_id,
+                                          GValue     *value,
+                                          GParamSpec *pspec)
+{
+  GimpOperationNormalStack *stack = GIMP_OPERATION_NORMAL_STACK (object);
+
+  switch (property_id)
+    {
+    case PROP_COMPOSITE_SPACE:
+      g_value_set_enum (value, stack->composite_space);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_normal_stack_prepare (GeglOperation *operation)
+{
+  GimpOperationNormalStack *stack            = GIMP_OPERATION_NORMAL_STACK (operation);
+  const GeglRectangle      *input_extent;
+  const Babl               *preferred_format = NULL;
+  const Babl               *format;
+
+  input_extent = gegl_operation_source_get_bounding_box (operation, "input");
+
+  /*  like gimp:normal, prefer the input's format, or the bottom layer's
+   *  when there's nothing below it
+   */
+  stack->is_last_node = ! input_extent ||
+                        gegl_rectangle_is_empty (input_extent);
+
+  if (! stack->is_last_node)
+    {
+      preferred_format = gegl_operation_get_source_format (operation, "input");
+    }
+  else if (stack->layers->len > 0)
+    {
+      NormalStackLayer *layer = &g_array_index (stack->layers,
+                                                NormalStackLayer, 0);
+
+      preferred_format = gegl_buffer_get_format (layer->buffer);
+    }
+
+  format = gimp_layer_mode_get_format (GIMP_LAYER_MODE_NORMAL,
+                                       GIMP_LAYER_COLOR_SPACE_AUTO,
+                                       stack->composite_space,
+                                       GIMP_LAYER_COMPOSITE_UNION,
+                                       preferred_format);
+
+  gegl_operation_set_format (operation, "input",  format);
+  gegl_operation_set_format (operation, "output", format);
+}
+
+static GeglRectangle
+gimp_operation_normal_stack_get_bounding_box (GeglOperation *operation)
+{
+  GimpOperationNormalStack *stack = GIMP_OPERATION_NORMAL_STACK (operation);
+  const GeglRectangle      *in_rect;
+  GeglRectangle             result = {};
+  gint                      i;
+
+  in_rect = gegl_operation_source_get_bounding_box (operation, "input");
+
+  if (in_rect)
+    result = *in_rect;
+
+  for (i = 0; i < stack->layers->len; i++)
+    {
+      NormalStackLayer *layer = &g_array_index (stack->layers,
+                                                NormalStackLayer, i);
+      GeglRectangle     extent;
+
+      if (layer->opacity == 0.0f)
+        continue;
+
+      extent    = *gegl_buffer_get_extent (layer->buffer);
+      extent.x += layer->offset_x;
+      extent.y += layer->offset_y;
+
+      gegl_rectangle_bounding_box (&result, &result, &extent);
+    }
+
+  return result;
+}
+
+static gboolean
+gimp_operation_normal_stack_parent_process (GeglOperation        *operation,
+                                            GeglOperationContext *context,
+                                            const gchar          *output_prop,
+                                            const GeglRectangle  *result,
+                                            gint                  level)
+{
+  GimpOperationNormalStack *stack = GIMP_OPERATION_NORMAL_STACK (operation);
+  gint                      i;
+
+  /*  the layers' buffers are read directly, bypassing their source nodes,
+   *  so validate them here, before the work is split between threads
+   */
+  for (i = 0; i < stack->layers->len; i++)
+    {
+      NormalStackLayer *layer = &g_array_index (stack->layers,
+                                                NormalStackLayer, i);
+      GeglRectangle     rect;
+
+      if (! layer->validate_handler)
+        continue;
+
+      rect = gimp_operation_normal_stack_get_layer_rect (layer, result,
+                                                         level);
+
+      /*  the level's pixels come from these pixels of level 0  */
+      rect.x      <<= level;
+      rect.y      <<= level;
+      rect.width  <<= level;
+      rect.height <<= level;
+
+      gegl_rectangle_align_to_buffer (&rect, &rect, layer->buffer,
+                                      GEGL_RECTANGLE_ALIGNMENT_SUPERSET);
+
+      gimp_tile_handler_validate_validate (layer->validate_handler,
+                                           layer->buffer,
+                                           &rect, TRUE, FALSE);
+    }
+
+  return GEGL_OPERATION_CLASS (parent_class)->process (operation, context,
+                                                       output_prop, result,
+                                                       level);
+}
+
+static gboolean
+gimp_operation_normal_stack_process (GeglOperation       *operation,
+                                     GeglBuffer          *input,
+                                     GeglBuffer          *output,
+                                     const GeglRectangle *result,
+                                     gint                 level)
+{
+  GimpOperationNormalStack *stack  = GIMP_OPERATION_NORMAL_STACK (operation);
+  const Babl               *format = gegl_operation_get_format (operation,
+                                                                "output");
+  GimpLayerModeFunc         function;
+  GeglBufferIterator       *iter;
+  NormalStackLayer        **layers;
+  gint                      n_layers = 0;
+  gboolean                  has_bottom;
+  gint                      first_slot;
+  gint                      i;
+
+  if (stack->is_last_node)
+    input = NULL;
+
+  /*  the same function the gimp:normal nodes use, vectorized or not  */
+  function = gimp_layer_mode_get_function (GIMP_LAYER_MODE_NORMAL);
+
+  layers = g_newa (NormalStackLayer *, stack->layers->len);
+
+  /*  only read the layers that are visible in the result  */
+  for (i = 0; i < stack->layers->len; i++)
+    {
+      NormalStackLayer *layer = &g_array_index (stack->layers,
+                                                NormalStackLayer, i);
+
+      if (layer->opacity != 0.0f &&
+          gimp_operation_normal_stack_is_visible (layer, result, level))
+        {
+          layers[n_layers++] = layer;
+        }
+    }
+
+  has_bottom = n_layers > 0 &&
+               layers[0] == &g_array_index (stack->layers,
+                                            NormalStackLayer, 0);
+
+  iter = gegl_buffer_iterator_new (output, result, level, format,
+                                   GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE,
+                                   2 + n_layers);
+
+  if (input)
+    {
+      gegl_buffer_iterator_add (iter, input, result, level, format,
+                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+    }
+
+  first_slot = input ? 2 : 1;
+
+  for (i = 0; i < n_layers; i++)
+    {
+      GeglRectangle rect;
+
+      rect = gimp_operation_normal_stack_get_layer_rect (layers[i], result,
+                                                         level);
+
+      gegl_buffer_iterator_add (iter, layers[i]->buffer, &rect, level, format,
+                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+    }
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      gfloat       *out     = iter->items[0].data;
+      const gfloat *in      = input ? iter->items[1].data : NULL;
+      const gfloat *src     = in;
+      glong         samples = iter->length;
+
+      if (n_layers == 0)
+        {
+          if (in)
+            memcpy (out, in, samples * 4 * sizeof (gfloat));
+          else
+            memset (out, 0, samples * 4 * sizeof (gfloat));
+
+          continue;
+        }
+
+      /*  when there's nothing below the layers, and the bottom layer is
+       *  outside the result, the chain's bottom node outputs nothing, and
+       *  the layers above are composited over transparency
+       */
+      if (! src && ! has_bottom)
+        {
+          memset (out, 0, samples * 4 * sizeof (gfloat));
+
+          src = out;
+        }
+
+      for (i = 0; i < n_layers; i++)
+        {
+          gfloat *layer = iter->items[first_slot + i].data;
+
+          if (src)
+            {
+              /*  gimp:normal works in place, so 'out' can be the input,
+               *  once it holds the layers below
+               */
+              function (gegl_node_get_gegl_operation (layers[i]->mode_node),
+                        (gpointer) src, layer, NULL, out,
+                        samples, &iter->items[0].roi, level);
+            }
+          else
+            {
+              gfloat  opacity = layers[i]->opacity;
+              gfloat *dest    = out;
+              glong   n       = samples;
+
+              /*  like gimp:normal, the bottom layer is copied as-is when
+               *  there's nothing below it
+               */
+              while (n--)
+                {
+                  memcpy (dest, layer, 3 * sizeof (gfloat));
+
+                  dest[ALPHA] = layer[ALPHA] * opacity;
+
+                  layer += 4;
+                  dest  += 4;
+                }
+            }
+
+          src = out;
+        }
+    }
+
+  return TRUE;
+}
+
+
+/*  public functions  */
+
+void
+gimp_operation_normal_stack_clear (GimpOperationNormalStack *stack)
+{
+  g_return_if_fail (GIMP_IS_OPERATION_NORMAL_STACK (stack));
+
+  gimp_operation_normal_stack_remove_layers (stack, TRUE);
+}
+
+/**
+ * gimp_operation_normal_stack_add_layer:
+ * @stack:    a #GimpOperationNormalStack
+ * @buffer:   the layer's pixels
+ * @offset_x: the layer's horizontal offset
+ * @offset_y: the layer's vertical offset
+ * @opacity:  the layer's opacity
+ *
+ * Adds a layer on top of the layers already in @stack.  Changes to
+ * @buffer invalidate the operation, the same as a buffer source would.
+ **/
+void
+gimp_operation_normal_stack_add_layer (GimpOperationNormalStack *stack,
+                                       GeglBuffer               *buffer,
+                                       gint                      offset_x,
+                                       gint                      offset_y,
+                                       gdouble                   opacity)
+{
+  NormalStackLayer layer;
+
+  g_return_if_fail (GIMP_IS_OPERATION_NORMAL_STACK (stack));
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+
+  gimp_operation_normal_stack_init_layer (stack, &layer,
+                                          buffer, offset_x, offset_y,
+                                          opacity);
+
+  g_array_append_val (stack->layers, layer);
+
+  gimp_operation_normal_stack_invalidate_layer (
+    stack,
+    &g_array_index (stack->layers, NormalStackLayer,
+                    stack->layers->len - 1));
+}
+
+gint
+gimp_operation_normal_stack_get_n_layers (GimpOperationNormalStack *stack)
+{
+  g_return_val_if_fail (GIMP_IS_OPERATION_NORMAL_STACK (stack), 0);
+
+  return stack->layers->len;
+}
+
+/**
+ * gimp_operation_normal_stack_set_layer:
+ * @stack:    a #GimpOperationNormalStack
+ * @index:    the index of the layer, from the bottom
+ * @buffer:   the layer's pixels
+ * @offset_x: the layer's horizontal offset
+ * @offset_y: the layer's vertical offset
+ * @opacity:  the layer's opacity
+ *
+ * Replaces a layer of @stack, invalidating only the area of the layer,
+ * and only if anything changed.
+ **/
+void
+gimp_operation_normal_stack_set_layer (GimpOperationNormalStack *stack,
+                                       gint                      index,
+                                       GeglBuffer               *buffer,
+                                       gint                      offset_x,
+                                       gint                      offset_y,
+                                       gdouble                   opacity)
+{
+  NormalStackLayer *layer;
+
+  g_return_if_fail (GIMP_IS_OPERATION_NORMAL_STACK (stack));
+  g_return_if_fail (index >= 0 && index < stack->layers->len);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+
+  layer = &g_array_index (stack->layers, NormalStackLayer, index);
+
+  if (layer->buffer   == buffer   &&
+      layer->offset_x == offset_x &&
+      layer->offset_y == offset_y &&
+      layer->opacity  == (gfloat) opacity)
+    {
+      return;
+    }
+
+  gimp_operation_normal_stack_invalidate_layer (stack, layer);
+
+  if (layer->buffer != buffer)
+    {
+      gimp_operation_normal_stack_clear_layer (stack, layer);
+      gimp_operation_normal_stack_init_layer (stack, layer,
+                                              buffer, offset_x, offset_y,
+                                              opacity);
+    }
+  else
+    {
+      layer->offset_x = offset_x;
+      layer->offset_y = offset_y;
+      layer->opacity  = opacity;
+
+      gegl_node_set (layer->mode_node,
+                     "opacity", opacity,
+                     NULL);
+    }
+
+  gimp_operation_normal_stack_invalidate_layer (stack, layer);
+}
+
+
+/*  private functions  */
+
+/*  returns @rect, at @level, in the coordinates of @layer's buffer at
+ *  the same level
+ */
+static GeglRectangle
+gimp_operation_normal_stack_get_layer_rect (NormalStackLayer    *layer,
+                                            const GeglRectangle *rect,
+                                            gint                 level)
+{
+  GeglRectangle layer_rect = *rect;
+  gdouble       scale      = 1 << level;
+
+  layer_rect.x -= floor (layer->offset_x / scale);
+  layer_rect.y -= floor (layer->offset_y / scale);
+
+  return layer_rect;
+}
+
+static gboolean
+gimp_operation_normal_stack_is_visible (NormalStackLayer    *layer,
+                                        const GeglRectangle *rect,
+                                        gint                 level)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (layer->buffer);
+  GeglRectangle        layer_rect;
+  GeglRectangle        level_extent;
+  gdouble              scale  = 1 << level;
+
+  layer_rect = gimp_operation_normal_stack_get_layer_rect (layer, rect, level);
+
+  level_extent.x      = floor (extent->x / scale);
+  level_extent.y      = floor (extent->y / scale);
+  level_extent.width  = ceil ((extent->x + extent->width)  / scale) -
+                        level_extent.x;
+  level_extent.height = ceil ((extent->y + extent->height) / scale) -
+                        level_extent.y;
+
+  return gegl_rectangle_intersect (NULL, &layer_rect, &level_extent);
+}
+
+static void
+gimp_operation_normal_stack_init_layer (GimpOperationNormalStack *stack,
+                                        NormalStackLayer         *layer,
+                                        GeglBuffer               *buffer,
+                                        gint                      offset_x,
+                                        gint                      offset_y,
+                                        gdouble                   opacity)
+{
+  layer->buffer           = g_object_ref (buffer);
+  layer->validate_handler = gimp_tile_handler_validate_get_assigned (buffer);
+  layer->offset_x         = offset_x;
+  layer->offset_y         = offset_y;
+  layer->opacity          = opacity;
+
+  layer->mode_node = gegl_node_new_child (NULL,
+                                          "operation",      "gimp:normal",
+                                          "opacity",        opacity,
+                                          "composite-mode", GIMP_LAYER_COMPOSITE_UNION,
+                                          NULL);
+
+  if (layer->validate_handler)
+    {
+      g_object_ref (layer->validate_handler);
+
+      g_signal_connect (layer->validate_handler, "invalidated",
+                        G_CALLBACK (gimp_operation_normal_stack_invalidate),
+                        stack);
+    }
+
+  gegl_buffer_signal_connect (buffer, "changed",
+                              G_CALLBACK (gimp_operation_normal_stack_invalidate),
+                              stack);
+}
+
+static void
+gimp_operation_normal_stack_clear_layer (GimpOperationNormalStack *stack,
+                                         NormalStackLayer         *layer)
+{
+  if (layer->validate_handler)
+    {
+      g_signal_handlers_disconnect_by_func (
+        layer->validate_handler,
+        gimp_operation_normal_stack_invalidate,
+        stack);
+
+      g_clear_object (&layer->validate_handler);
+    }
+
+  g_signal_handlers_disconnect_by_func (
+    layer->buffer,
+    gimp_operation_normal_stack_invalidate,
+    stack);
+
+  g_clear_object (&layer->mode_node);
+  g_clear_object (&layer->buffer);
+}
+
+static void
+gimp_operation_normal_stack_invalidate_layer (GimpOperationNormalStack *stack,
+                                              NormalStackLayer         *layer)
+{
+  GeglRectangle extent = *gegl_buffer_get_extent (layer->buffer);
+
+  extent.x += layer->offset_x;
+  extent.y += layer->offset_y;
+
+  gegl_operation_invalidate (GEGL_OPERATION (stack), &extent, FALSE);
+}
+
+static void
+gimp_operation_normal_stack_remove_layers (GimpOperationNormalStack *stack,
+                                           gboolean                  invalidate)
+{
+  gint i;
+
+  for (i = 0; i < stack->layers->len; i++)
+    {
+      NormalStackLayer *layer = &g_array_index (stack->layers,
+                                                NormalStackLayer, i);
+
+      if (invalidate)
+        gimp_operation_normal_stack_invalidate_layer (stack, layer);
+
+      gimp_operation_normal_stack_clear_layer (stack, layer);
+    }
+
+  g_array_set_size (stack->layers, 0);
+}
+
+/*  @object is either a layer's buffer, or its validate handler  */
+static void
+gimp_operation_normal_stack_invalidate (gpointer                  object,
+                                        const GeglRectangle      *rect,
+                                        GimpOperationNormalStack *stack)
+{
+  gint i;
+
+  for (i = 0; i < stack->layers->len; i++)
+    {
+      NormalStackLayer *layer = &g_array_index (stack->layers,
+                                                NormalStackLayer, i);
+
+      if (object == layer->buffer || object == layer->validate_handler)
+        {
+          GeglRectangle layer_rect = *rect;
+
+          layer_rect.x += layer->offset_x;
+          layer_rect.y += layer->offset_y;
+
+          gegl_operation_invalidate (GEGL_OPERATION (stack), &layer_rect,
+                                     FALSE);
+        }
+    }
+}
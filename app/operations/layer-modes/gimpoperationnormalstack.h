@@ -0,0 +1,67 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationnormalstack.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gegl-plugin.h>
+
+
+#define GIMP_TYPE_OPERATION_NORMAL_STACK            (gimp_operation_normal_stack_get_type ())
+#define GIMP_OPERATION_NORMAL_STACK(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_OPERATION_NORMAL_STACK, GimpOperationNormalStack))
+#define GIMP_OPERATION_NORMAL_STACK_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_OPERATION_NORMAL_STACK, GimpOperationNormalStackClass))
+#define GIMP_IS_OPERATION_NORMAL_STACK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_OPERATION_NORMAL_STACK))
+#define GIMP_IS_OPERATION_NORMAL_STACK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_OPERATION_NORMAL_STACK))
+#define GIMP_OPERATION_NORMAL_STACK_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_OPERATION_NORMAL_STACK, GimpOperationNormalStackClass))
+
+
+typedef struct _GimpOperationNormalStack      GimpOperationNormalStack;
+typedef struct _GimpOperationNormalStackClass GimpOperationNormalStackClass;
+
+struct _GimpOperationNormalStack
+{
+  GeglOperationFilter  parent_instance;
+
+  GimpLayerColorSpace  composite_space;
+  GArray              *layers;
+
+  gboolean             is_last_node;
+};
+
+struct _GimpOperationNormalStackClass
+{
+  GeglOperationFilterClass  parent_class;
+};
+
+
+GType   gimp_operation_normal_stack_get_type     (void) G_GNUC_CONST;
+
+void    gimp_operation_normal_stack_clear        (GimpOperationNormalStack *stack);
+void    gimp_operation_normal_stack_add_layer    (GimpOperationNormalStack *stack,
+                                                  GeglBuffer               *buffer,
+                                                  gint                      offset_x,
+                                                  gint                      offset_y,
+                                                  gdouble                   opacity);
+
+gint    gimp_operation_normal_stack_get_n_layers (GimpOperationNormalStack *stack);
+void    gimp_operation_normal_stack_set_layer    (GimpOperationNormalStack *stack,
+                                                  gint                      index,
+                                                  GeglBuffer               *buffer,
+                                                  gint                      offset_x,
+                                                  gint                      offset_y,
+                                                  gdouble                   opacity);
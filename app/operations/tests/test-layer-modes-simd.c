@@ -0,0 +1,330 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Checks that the vectorized layer mode functions produce the same
+ * results as the generic ones, bit for bit.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "operations/operations-types.h"
+
+#include "operations/layer-modes/gimpoperationlayermode-blend.h"
+#include "operations/layer-modes/gimpoperationlayermode-composite.h"
+
+
+/*  odd, so that the trailing pixel goes through the generic function  */
+#define N_SAMPLES 1031
+
+
+typedef struct
+{
+  const gchar            *name;
+  GimpLayerModeBlendFunc  blend_function;
+  GimpLayerModeBlendFunc  simd_function;
+} BlendTest;
+
+typedef void (* CompositeFunc) (const gfloat *in,
+                                const gfloat *layer,
+                                const gfloat *comp,
+                                const gfloat *mask,
+                                gfloat        opacity,
+                                gfloat       *out,
+                                gint          samples);
+
+typedef struct
+{
+  const gchar   *name;
+  CompositeFunc  composite_function;
+  CompositeFunc  simd_function;
+} CompositeTest;
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+#define BLEND_TEST(name) \
+  { #name, \
+    gimp_operation_layer_mode_blend_##name, \
+    gimp_operation_layer_mode_blend_##name##_avx2 }
+
+#define COMPOSITE_TEST(name) \
+  { #name, \
+    gimp_operation_layer_mode_composite_##name, \
+    gimp_operation_layer_mode_composite_##name##_avx2 }
+
+static const BlendTest blend_tests_avx2[] =
+{
+  BLEND_TEST (addition),
+  BLEND_TEST (burn),
+  BLEND_TEST (darken_only),
+  BLEND_TEST (difference),
+  BLEND_TEST (divide),
+  BLEND_TEST (dodge),
+  BLEND_TEST (exclusion),
+  BLEND_TEST (grain_extract),
+  BLEND_TEST (grain_merge),
+  BLEND_TEST (hard_mix),
+  BLEND_TEST (hardlight),
+  BLEND_TEST (lch_color),
+  BLEND_TEST (lch_lightness),
+  BLEND_TEST (lighten_only),
+  BLEND_TEST (linear_burn),
+  BLEND_TEST (linear_light),
+  BLEND_TEST (multiply),
+  BLEND_TEST (overlay),
+  BLEND_TEST (pin_light),
+  BLEND_TEST (screen),
+  BLEND_TEST (softlight),
+  BLEND_TEST (subtract),
+  BLEND_TEST (vivid_light)
+};
+
+static const CompositeTest composite_tests_avx2[] =
+{
+  COMPOSITE_TEST (union),
+  COMPOSITE_TEST (clip_to_backdrop),
+  COMPOSITE_TEST (clip_to_layer),
+  COMPOSITE_TEST (intersection),
+  COMPOSITE_TEST (union_sub),
+  COMPOSITE_TEST (clip_to_backdrop_sub),
+  COMPOSITE_TEST (clip_to_layer_sub),
+  COMPOSITE_TEST (intersection_sub)
+};
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+
+/*  values the blend modes treat specially, besides random ones  */
+static const gfloat special_values[] =
+{
+  0.0f, -0.0f, 1.0f, 0.5f, 0.25f, 0.75f, 1e-7f, -1e-7f, 1.0f - 1e-7f,
+  -0.25f, 1.25f, 2.0f, -1.0f
+};
+
+
+/* fills the buffer with a mix of random and special values.  one pixel
+ * in four has a zero alpha.
+ */
+static void
+fill_pixels (GRand  *rand,
+             gfloat *pixels,
+             gint    n_pixels)
+{
+  gint i;
+
+  for (i = 0; i < n_pixels * 4; i++)
+    {
+      if (g_rand_boolean (rand))
+        {
+          pixels[i] = g_rand_double_range (rand, -0.5, 1.5);
+        }
+      else
+        {
+          pixels[i] = special_values[g_rand_int_range (
+                                       rand, 0, G_N_ELEMENTS (special_values))];
+        }
+
+      if (i % 4 == 3)
+        {
+          if (g_rand_int_range (rand, 0, 4) == 0)
+            pixels[i] = 0.0f;
+          else
+            pixels[i] = CLAMP (pixels[i], 0.0f, 1.0f);
+        }
+    }
+}
+
+static void
+test_blend (gconstpointer data)
+{
+  const BlendTest *test = data;
+  GRand           *rand;
+  gfloat          *in;
+  gfloat          *layer;
+  gfloat          *comp;
+  gfloat          *simd_comp;
+  gint             offset;
+
+  rand = g_rand_new_with_seed (1);
+
+  in        = g_new (gfloat, (N_SAMPLES + 1) * 4);
+  layer     = g_new (gfloat, (N_SAMPLES + 1) * 4);
+  comp      = g_new (gfloat, (N_SAMPLES + 1) * 4);
+  simd_comp = g_new (gfloat, (N_SAMPLES + 1) * 4);
+
+  fill_pixels (rand, in,    N_SAMPLES + 1);
+  fill_pixels (rand, layer, N_SAMPLES + 1);
+
+  /*  the output is left alone where an alpha is zero, so start from the
+   *  same garbage
+   */
+  fill_pixels (rand, comp, N_SAMPLES + 1);
+  memcpy (simd_comp, comp, (N_SAMPLES + 1) * 4 * sizeof (gfloat));
+
+  /*  and try misaligned buffers too  */
+  for (offset = 0; offset <= 1; offset++)
+    {
+      test->blend_function (NULL,
+                            in    + offset * 4,
+                            layer + offset * 4,
+                            comp  + offset * 4,
+                            N_SAMPLES);
+      test->simd_function (NULL,
+                           in        + offset * 4,
+                           layer     + offset * 4,
+                           simd_comp + offset * 4,
+                           N_SAMPLES);
+
+      g_assert_cmpmem (simd_comp, (N_SAMPLES + 1) * 4 * sizeof (gfloat),
+                       comp,      (N_SAMPLES + 1) * 4 * sizeof (gfloat));
+    }
+
+  g_free (simd_comp);
+  g_free (comp);
+  g_free (layer);
+  g_free (in);
+
+  g_rand_free (rand);
+}
+
+static void
+test_composite (gconstpointer data)
+{
+  const CompositeTest *test = data;
+  GRand               *rand;
+  gfloat              *in;
+  gfloat              *layer;
+  gfloat              *comp;
+  gfloat              *mask;
+  gfloat              *out;
+  gfloat              *simd_out;
+  const gfloat         opacities[] = { 1.0f, 0.6f, 0.0f };
+  gint                 i;
+
+  rand = g_rand_new_with_seed (2);
+
+  in       = g_new (gfloat, N_SAMPLES * 4);
+  layer    = g_new (gfloat, N_SAMPLES * 4);
+  comp     = g_new (gfloat, N_SAMPLES * 4);
+  mask     = g_new (gfloat, N_SAMPLES);
+  out      = g_new (gfloat, N_SAMPLES * 4);
+  simd_out = g_new (gfloat, N_SAMPLES * 4);
+
+  fill_pixels (rand, in,    N_SAMPLES);
+  fill_pixels (rand, layer, N_SAMPLES);
+  fill_pixels (rand, comp,  N_SAMPLES);
+
+  for (i = 0; i < N_SAMPLES; i++)
+    {
+      if (g_rand_int_range (rand, 0, 4) == 0)
+        mask[i] = 0.0f;
+      else
+        mask[i] = g_rand_double (rand);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (opacities) * 2; i++)
+    {
+      const gfloat *m       = i % 2 ? mask : NULL;
+      gfloat        opacity = opacities[i / 2];
+
+      test->composite_function (in, layer, comp, m, opacity, out, N_SAMPLES);
+      test->simd_function (in, layer, comp, m, opacity, simd_out, N_SAMPLES);
+
+      g_assert_cmpmem (simd_out, N_SAMPLES * 4 * sizeof (gfloat),
+                       out,      N_SAMPLES * 4 * sizeof (gfloat));
+    }
+
+  g_free (simd_out);
+  g_free (out);
+  g_free (mask);
+  g_free (comp);
+  g_free (layer);
+  g_free (in);
+
+  g_rand_free (rand);
+}
+
+static void
+test_unsupported (gconstpointer data)
+{
+  g_test_skip (data);
+}
+
+static void
+add_tests (const gchar         *isa,
+           gboolean             supported,
+           const BlendTest     *blend_tests,
+           gint                 n_blend_tests,
+           const CompositeTest *composite_tests,
+           gint                 n_composite_tests)
+{
+  gint i;
+
+  for (i = 0; i < n_blend_tests; i++)
+    {
+      gchar *path = g_strdup_printf ("/layer-modes-simd/%s/blend/%s",
+                                     isa, blend_tests[i].name);
+
+      if (supported)
+        g_test_add_data_func (path, &blend_tests[i], test_blend);
+      else
+        g_test_add_data_func (path, "not supported by the CPU",
+                              test_unsupported);
+
+      g_free (path);
+    }
+
+  for (i = 0; i < n_composite_tests; i++)
+    {
+      gchar *path = g_strdup_printf ("/layer-modes-simd/%s/composite/%s",
+                                     isa, composite_tests[i].name);
+
+      if (supported)
+        g_test_add_data_func (path, &composite_tests[i], test_composite);
+      else
+        g_test_add_data_func (path, "not supported by the CPU",
+                              test_unsupported);
+
+      g_free (path);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+#if COMPILE_AVX2_INTRINISICS
+  add_tests ("avx2",
+             gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2,
+             blend_tests_avx2,     G_N_ELEMENTS (blend_tests_avx2),
+             composite_tests_avx2, G_N_ELEMENTS (composite_tests_avx2));
+#else
+  add_tests ("avx2", FALSE, NULL, 0, NULL, 0);
+#endif
+
+  return g_test_run ();
+}
@@ -28,9 +28,12 @@
 
 #include "operations/layer-modes/gimp-layer-modes.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-loops.h"
 
+#include "core/gimp.h"
 #include "core/gimpbrush-header.h"
 #include "core/gimpbrushgenerated.h"
 #include "core/gimpdrawable.h"
@@ -324,6 +327,10 @@ gimp_brush_core_pre_paint (GimpPaintCore    *paint_core,
           core->brush = gimp_brush_select_brush (core->main_brush,
                                                  &last_coords,
                                                  &current_coords);
+
+          /*  the brushes of a pipe follow the pipe's tolerance  */
+          gimp_brush_set_cache_tolerance (core->brush,
+                                          gimp_brush_get_cache_tolerance (core->main_brush));
         }
       if ((! GIMP_IS_BRUSH_GENERATED(core->main_brush)) &&
           (paint_options->brush_hardness != gimp_brush_get_blur_hardness(core->main_brush)))
@@ -391,6 +398,9 @@ gimp_brush_core_start (GimpPaintCore     *paint_core,
       return FALSE;
     }
 
+  gimp_brush_set_cache_tolerance (core->main_brush,
+                                  context->gimp->config->brush_cache_tolerance);
+
   for (GList *iter = drawables; iter; iter = iter->next)
     if (image == NULL)
       image = gimp_item_get_image (GIMP_ITEM (iter->data));
@@ -22,11 +22,13 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include <cairo.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 #include "libgimpconfig/gimpconfig.h"
 #include "libgimpmath/gimpmath.h"
@@ -34,6 +36,7 @@
 #include "path-types.h"
 
 #include "core/gimp.h"
+#include "core/gimpbezierdesc.h"
 #include "core/gimpdrawable-fill.h"
 #include "core/gimpdrawable-stroke.h"
 #include "core/gimpimage.h"
@@ -42,14 +45,22 @@
 #include "core/gimpimage-undo-push.h"
 #include "core/gimpstrokeoptions.h"
 #include "core/gimpparasitelist.h"
+#include "core/gimpscanconvert.h"
+
+#include "gegl/gimp-gegl-loops.h"
 
 #include "gimpvectorlayer.h"
 #include "gimpvectorlayeroptions.h"
 #include "gimppath.h"
+#include "gimpstroke.h"
 
 #include "gimp-intl.h"
 
 
+/*  above this, the dirty region is rendered as a single rectangle  */
+#define MAX_DIRTY_RECTS 16
+
+
 enum
 {
   PROP_0,
@@ -58,6 +69,13 @@ enum
 };
 
 
+typedef struct
+{
+  GimpBezierDesc        *bezier;
+  cairo_rectangle_int_t  bounds;
+} GimpVectorLayerStroke;
+
+
 /* local function declarations */
 
 static void       gimp_vector_layer_finalize        (GObject                *object);
@@ -124,7 +142,33 @@ static void       gimp_vector_layer_transform       (GimpItem               *ite
 
 static gboolean   gimp_vector_layer_render          (GimpVectorLayer        *layer);
 static void       gimp_vector_layer_render_path     (GimpVectorLayer        *layer);
-static void       gimp_vector_layer_changed_options (GimpVectorLayer        *layer);
+static gboolean   gimp_vector_layer_render_changes  (GimpVectorLayer        *layer);
+static void       gimp_vector_layer_render_region   (GimpVectorLayer        *layer,
+                                                     cairo_region_t         *region);
+static void       gimp_vector_layer_changed_options (GimpVectorLayer        *layer,
+                                                     GParamSpec             *pspec);
+
+static GHashTable * gimp_vector_layer_get_strokes   (GimpVectorLayer        *layer);
+static gint       gimp_vector_layer_get_margin      (GimpVectorLayer        *layer);
+static void       gimp_vector_layer_stroke_free     (GimpVectorLayerStroke  *stroke);
+static gboolean   gimp_vector_layer_stroke_equal    (GimpVectorLayerStroke  *stroke1,
+                                                     GimpVectorLayerStroke  *stroke2);
+static void       gimp_vector_layer_stroke_dirty    (GimpVectorLayerStroke  *stroke,
+                                                     gint                    margin,
+                                                     cairo_region_t         *region);
+static void       gimp_vector_layer_stroke_dirty_changes
+                                                    (GimpVectorLayerStroke  *old_stroke,
+                                                     GimpVectorLayerStroke  *stroke,
+                                                     gint                    margin,
+                                                     cairo_region_t         *region);
+static gint     * gimp_vector_layer_bezier_elements (const GimpBezierDesc   *bezier,
+                                                     gint                   *n_elements);
+static gboolean   gimp_vector_layer_element_equal   (const cairo_path_data_t *data1,
+                                                     const cairo_path_data_t *data2);
+static void       gimp_vector_layer_extents_add     (gdouble                *extents,
+                                                     const cairo_path_data_t *data,
+                                                     gint                    first,
+                                                     gint                    last);
 
 static void       gimp_vector_layer_removed         (GimpItem               *item);
 
@@ -193,6 +237,7 @@ gimp_vector_layer_init (GimpVectorLayer *layer)
 {
   layer->options  = NULL;
   layer->modified = FALSE;
+  layer->strokes  = NULL;
 }
 
 static void
@@ -206,6 +251,8 @@ gimp_vector_layer_finalize (GObject *object)
       layer->options = NULL;
     }
 
+  g_clear_pointer (&layer->strokes, g_hash_table_unref);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -277,7 +324,7 @@ gimp_vector_layer_set_vector_options (GimpVectorLayer        *layer,
   if (options)
     g_set_object (&layer->options, options);
 
-  gimp_vector_layer_changed_options (layer);
+  gimp_vector_layer_changed_options (layer, NULL);
 
   if (layer->options)
     {
@@ -304,6 +351,9 @@ gimp_vector_layer_set_buffer (GimpDrawable        *drawable,
   GimpVectorLayer *layer = GIMP_VECTOR_LAYER (drawable);
   GimpImage       *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  /*  the strokes no longer describe the layer's pixels  */
+  g_clear_pointer (&layer->strokes, g_hash_table_unref);
+
   if (push_undo && ! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE_MOD,
                                  undo_desc);
@@ -334,6 +384,8 @@ gimp_vector_layer_push_undo (GimpDrawable *drawable,
   GimpVectorLayer *layer = GIMP_VECTOR_LAYER (drawable);
   GimpImage       *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  g_clear_pointer (&layer->strokes, g_hash_table_unref);
+
   if (! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE, undo_desc);
 
@@ -750,6 +802,12 @@ gimp_vector_layer_render (GimpVectorLayer *layer)
   /* render path to the layer */
   gimp_vector_layer_render_path (layer);
 
+  /* remember what was rendered, so that edits of the path can only
+   * render what they change
+   */
+  g_clear_pointer (&layer->strokes, g_hash_table_unref);
+  layer->strokes = gimp_vector_layer_get_strokes (layer);
+
   g_object_thaw_notify (G_OBJECT (drawable));
 
   return TRUE;
@@ -811,13 +869,569 @@ gimp_vector_layer_render_path (GimpVectorLayer *layer)
   gimp_selection_resume (GIMP_SELECTION (selection));
 }
 
+/* renders only the parts of the layer touched by the strokes that
+ * changed since the last render.  returns FALSE if the whole layer has
+ * to be rendered instead.
+ */
+static gboolean
+gimp_vector_layer_render_changes (GimpVectorLayer *layer)
+{
+  GimpDrawable           *drawable = GIMP_DRAWABLE (layer);
+  GimpItem               *item     = GIMP_ITEM (layer);
+  GimpVectorLayerOptions *options  = layer->options;
+  GHashTable             *strokes;
+  GimpVectorLayerStroke  *stroke;
+  GimpVectorLayerStroke  *old_stroke;
+  GHashTableIter          iter;
+  gpointer                key;
+  cairo_region_t         *region;
+  cairo_region_t         *aligned;
+  cairo_rectangle_int_t   old_rect;
+  cairo_rectangle_int_t   new_rect;
+  cairo_rectangle_int_t   rect;
+  gdouble                 stroke_width = 0;
+  gint                    margin;
+  gint                    x, y, width, height;
+  gint                    i;
+
+  if (! layer->strokes  ||
+      layer->modified    ||
+      ! options->path    ||
+      ! gimp_item_is_attached (GIMP_ITEM (options->path)) ||
+      gimp_item_is_content_locked (item, NULL))
+    return FALSE;
+
+  /* paint methods can't be limited to a part of the layer */
+  if (options->enable_stroke &&
+      gimp_stroke_options_get_method (options->stroke_options) !=
+      GIMP_STROKE_LINE)
+    return FALSE;
+
+  if (options->enable_stroke)
+    stroke_width = gimp_stroke_options_get_width (options->stroke_options);
+
+  /* the layer's new extent, like gimp_vector_layer_render() sets it */
+  gimp_item_bounds (GIMP_ITEM (options->path), &x, &y, &width, &height);
+
+  new_rect.x      = x - (stroke_width / 2);
+  new_rect.y      = y - (stroke_width / 2);
+  new_rect.width  = (gint) ceil (width  + stroke_width);
+  new_rect.height = (gint) ceil (height + stroke_width);
+
+  gimp_item_get_offset (item, &old_rect.x, &old_rect.y);
+  old_rect.width  = gimp_item_get_width  (item);
+  old_rect.height = gimp_item_get_height (item);
+
+  /* collect the old and new bounds of the parts of all strokes that
+   * changed, in image coordinates
+   */
+  strokes = gimp_vector_layer_get_strokes (layer);
+  margin  = gimp_vector_layer_get_margin (layer);
+  region  = cairo_region_create ();
+
+  g_hash_table_iter_init (&iter, strokes);
+  while (g_hash_table_iter_next (&iter, &key, (gpointer *) &stroke))
+    {
+      old_stroke = g_hash_table_lookup (layer->strokes, key);
+
+      if (! old_stroke)
+        gimp_vector_layer_stroke_dirty (stroke, margin, region);
+      else if (! gimp_vector_layer_stroke_equal (old_stroke, stroke))
+        gimp_vector_layer_stroke_dirty_changes (old_stroke, stroke,
+                                                margin, region);
+    }
+
+  g_hash_table_iter_init (&iter, layer->strokes);
+  while (g_hash_table_iter_next (&iter, &key, (gpointer *) &old_stroke))
+    {
+      if (! g_hash_table_contains (strokes, key))
+        gimp_vector_layer_stroke_dirty (old_stroke, margin, region);
+    }
+
+  if (old_rect.x     != new_rect.x     || old_rect.y      != new_rect.y ||
+      old_rect.width != new_rect.width || old_rect.height != new_rect.height)
+    {
+      GeglBuffer     *buffer;
+      cairo_region_t *exposed;
+
+      /* the parts the layer didn't cover before have to be rendered
+       * completely, the rest is kept
+       */
+      exposed = cairo_region_create_rectangle (&new_rect);
+      cairo_region_subtract_rectangle (exposed, &old_rect);
+      cairo_region_union (region, exposed);
+      cairo_region_destroy (exposed);
+
+      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                new_rect.width,
+                                                new_rect.height),
+                                gimp_drawable_get_format (drawable));
+
+      gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable), NULL,
+                             GEGL_ABYSS_NONE,
+                             buffer,
+                             GEGL_RECTANGLE (old_rect.x - new_rect.x,
+                                             old_rect.y - new_rect.y,
+                                             0, 0));
+
+      g_object_freeze_notify (G_OBJECT (drawable));
+
+      gimp_drawable_set_buffer (drawable, FALSE, NULL, buffer);
+      g_object_unref (buffer);
+
+      gimp_item_set_offset (item, new_rect.x, new_rect.y);
+
+      g_object_thaw_notify (G_OBJECT (drawable));
+    }
+
+  /* render whole tiles, in layer coordinates */
+  cairo_region_translate (region, -new_rect.x, -new_rect.y);
+
+  aligned = cairo_region_create ();
+
+  for (i = 0; i < cairo_region_num_rectangles (region); i++)
+    {
+      GeglRectangle tiles;
+
+      cairo_region_get_rectangle (region, i, &rect);
+
+      gegl_rectangle_align_to_buffer (&tiles,
+                                      GEGL_RECTANGLE (rect.x, rect.y,
+                                                      rect.width, rect.height),
+                                      gimp_drawable_get_buffer (drawable),
+                                      GEGL_RECTANGLE_ALIGNMENT_SUPERSET);
+
+      cairo_region_union_rectangle (aligned,
+                                    (cairo_rectangle_int_t *) &tiles);
+    }
+
+  cairo_region_destroy (region);
+
+  cairo_region_intersect_rectangle (aligned,
+                                    (cairo_rectangle_int_t *)
+                                    GEGL_RECTANGLE (0, 0,
+                                                    new_rect.width,
+                                                    new_rect.height));
+
+  if (cairo_region_num_rectangles (aligned) > MAX_DIRTY_RECTS)
+    {
+      cairo_region_get_extents (aligned, &rect);
+      cairo_region_destroy (aligned);
+
+      aligned = cairo_region_create_rectangle (&rect);
+    }
+
+  if (! cairo_region_is_empty (aligned))
+    gimp_vector_layer_render_region (layer, aligned);
+
+  cairo_region_destroy (aligned);
+
+  g_clear_pointer (&layer->strokes, g_hash_table_unref);
+  layer->strokes = strokes;
+
+  return TRUE;
+}
+
+static void
+gimp_vector_layer_render_region (GimpVectorLayer *layer,
+                                 cairo_region_t  *region)
+{
+  GimpDrawable           *drawable  = GIMP_DRAWABLE (layer);
+  GimpImage              *image     = gimp_item_get_image (GIMP_ITEM (layer));
+  GimpVectorLayerOptions *options   = layer->options;
+  GimpChannel            *selection = gimp_image_get_mask (image);
+  const GimpBezierDesc   *bezier;
+  gint                    i;
+
+  bezier = gimp_path_get_bezier (options->path);
+
+  /* Don't mask these fill/stroke operations  */
+  gimp_selection_suspend (GIMP_SELECTION (selection));
+
+  for (i = 0; i < cairo_region_num_rectangles (region); i++)
+    {
+      GeglRectangle    rect;
+      GimpScanConvert *scan_convert;
+
+      cairo_region_get_rectangle (region, i, (cairo_rectangle_int_t *) &rect);
+
+      gegl_buffer_clear (gimp_drawable_get_buffer (drawable), &rect);
+      gimp_drawable_update (drawable,
+                            rect.x, rect.y, rect.width, rect.height);
+
+      /* the same calls gimp_drawable_fill_path() and
+       * gimp_drawable_stroke_path() end up in, limited to the rectangle
+       */
+      if (options->enable_fill && bezier && bezier->num_data > 4)
+        {
+          scan_convert = gimp_scan_convert_new ();
+
+          gimp_scan_convert_add_bezier (scan_convert, bezier);
+          gimp_drawable_fill_scan_convert_rect (drawable,
+                                                options->fill_options,
+                                                scan_convert, &rect, FALSE);
+
+          gimp_scan_convert_free (scan_convert);
+        }
+
+      if (options->enable_stroke && bezier && bezier->num_data >= 2)
+        {
+          scan_convert = gimp_scan_convert_new ();
+
+          gimp_scan_convert_add_bezier (scan_convert, bezier);
+          gimp_drawable_stroke_scan_convert_rect (drawable,
+                                                  options->stroke_options,
+                                                  scan_convert, &rect, FALSE);
+
+          gimp_scan_convert_free (scan_convert);
+        }
+    }
+
+  gimp_selection_resume (GIMP_SELECTION (selection));
+}
+
 static void
-gimp_vector_layer_changed_options (GimpVectorLayer *layer)
+gimp_vector_layer_changed_options (GimpVectorLayer *layer,
+                                   GParamSpec      *pspec)
 {
   GimpItem *item = GIMP_ITEM (layer);
 
   if (layer->options && ! layer->options->path)
-    gimp_vector_layer_discard (layer);
+    {
+      gimp_vector_layer_discard (layer);
+    }
   else if (gimp_item_is_attached (item))
-    gimp_vector_layer_refresh (layer);
+    {
+      /* edits of the path only need the strokes they touch rendered
+       * again, everything else changes the whole layer
+       */
+      if (pspec && ! strcmp (pspec->name, "path") &&
+          gimp_vector_layer_render_changes (layer))
+        return;
+
+      gimp_vector_layer_refresh (layer);
+    }
+}
+
+static GHashTable *
+gimp_vector_layer_get_strokes (GimpVectorLayer *layer)
+{
+  GHashTable *strokes;
+  GimpStroke *stroke;
+
+  strokes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                   (GDestroyNotify) gimp_vector_layer_stroke_free);
+
+  if (! layer->options || ! layer->options->path)
+    return strokes;
+
+  for (stroke = gimp_path_stroke_get_next (layer->options->path, NULL);
+       stroke;
+       stroke = gimp_path_stroke_get_next (layer->options->path, stroke))
+    {
+      GimpVectorLayerStroke *layer_stroke = g_slice_new0 (GimpVectorLayerStroke);
+      GimpBezierDesc        *bezier       = gimp_stroke_make_bezier (stroke);
+      gdouble                x1           = G_MAXDOUBLE;
+      gdouble                y1           = G_MAXDOUBLE;
+      gdouble                x2           = -G_MAXDOUBLE;
+      gdouble                y2           = -G_MAXDOUBLE;
+      gint                   i, j;
+
+      layer_stroke->bezier = bezier;
+
+      /* the control points enclose the curve */
+      for (i = 0; bezier && i < bezier->num_data; i += bezier->data[i].header.length)
+        {
+          for (j = 1; j < bezier->data[i].header.length; j++)
+            {
+              x1 = MIN (x1, bezier->data[i + j].point.x);
+              y1 = MIN (y1, bezier->data[i + j].point.y);
+              x2 = MAX (x2, bezier->data[i + j].point.x);
+              y2 = MAX (y2, bezier->data[i + j].point.y);
+            }
+        }
+
+      if (x1 <= x2 && y1 <= y2)
+        {
+          layer_stroke->bounds.x      = floor (x1);
+          layer_stroke->bounds.y      = floor (y1);
+          layer_stroke->bounds.width  = ceil (x2) - layer_stroke->bounds.x;
+          layer_stroke->bounds.height = ceil (y2) - layer_stroke->bounds.y;
+        }
+
+      g_hash_table_insert (strokes,
+                           GINT_TO_POINTER (gimp_stroke_get_id (stroke)),
+                           layer_stroke);
+    }
+
+  return strokes;
+}
+
+/* returns how far the rendered fill and stroke can reach out of the
+ * strokes' control points
+ */
+static gint
+gimp_vector_layer_get_margin (GimpVectorLayer *layer)
+{
+  GimpVectorLayerOptions *options = layer->options;
+  gdouble                 margin  = 1.0; /* antialiasing */
+
+  if (options->enable_stroke)
+    {
+      GimpStrokeOptions *stroke_options = options->stroke_options;
+      gdouble            width;
+      gdouble            ratio          = 1.0;
+      GimpUnit          *unit;
+
+      width = gimp_stroke_options_get_width (stroke_options);
+      unit  = gimp_stroke_options_get_unit (stroke_options);
+
+      if (unit != gimp_unit_pixel ())
+        {
+          GimpImage *image = gimp_item_get_image (GIMP_ITEM (layer));
+          gdouble    xres;
+          gdouble    yres;
+
+          gimp_image_get_resolution (image, &xres, &yres);
+
+          ratio = yres / xres;
+          width = gimp_units_to_pixels (width, unit, yres);
+        }
+
+      /* miter joins reach out up to miter-limit half widths, square
+       * caps up to sqrt(2) half widths
+       */
+      if (gimp_stroke_options_get_join_style (stroke_options) == GIMP_JOIN_MITER)
+        width *= MAX (gimp_stroke_options_get_miter_limit (stroke_options),
+                      G_SQRT2);
+      else
+        width *= G_SQRT2;
+
+      margin += width / 2.0 * MAX (ratio, 1.0);
+    }
+
+  return (gint) ceil (margin);
+}
+
+static void
+gimp_vector_layer_stroke_free (GimpVectorLayerStroke *stroke)
+{
+  if (stroke->bezier)
+    gimp_bezier_desc_free (stroke->bezier);
+
+  g_slice_free (GimpVectorLayerStroke, stroke);
+}
+
+static gboolean
+gimp_vector_layer_stroke_equal (GimpVectorLayerStroke *stroke1,
+                                GimpVectorLayerStroke *stroke2)
+{
+  const GimpBezierDesc *bezier1 = stroke1->bezier;
+  const GimpBezierDesc *bezier2 = stroke2->bezier;
+  gint                  i;
+
+  if (! bezier1 || ! bezier2)
+    return bezier1 == bezier2;
+
+  if (bezier1->num_data != bezier2->num_data)
+    return FALSE;
+
+  for (i = 0; i < bezier1->num_data; i += bezier1->data[i].header.length)
+    {
+      if (! gimp_vector_layer_element_equal (&bezier1->data[i],
+                                             &bezier2->data[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gimp_vector_layer_stroke_dirty (GimpVectorLayerStroke *stroke,
+                                gint                   margin,
+                                cairo_region_t        *region)
+{
+  cairo_rectangle_int_t rect;
+
+  if (! stroke->bezier)
+    return;
+
+  rect.x      = stroke->bounds.x      - margin;
+  rect.y      = stroke->bounds.y      - margin;
+  rect.width  = stroke->bounds.width  + 2 * margin;
+  rect.height = stroke->bounds.height + 2 * margin;
+
+  cairo_region_union_rectangle (region, &rect);
+}
+
+/* returns the offsets of the elements of @bezier in its data */
+static gint *
+gimp_vector_layer_bezier_elements (const GimpBezierDesc *bezier,
+                                   gint                 *n_elements)
+{
+  gint *elements = g_new (gint, bezier->num_data);
+  gint  i;
+
+  *n_elements = 0;
+
+  for (i = 0; i < bezier->num_data; i += bezier->data[i].header.length)
+    elements[(*n_elements)++] = i;
+
+  return elements;
+}
+
+static gboolean
+gimp_vector_layer_element_equal (const cairo_path_data_t *data1,
+                                 const cairo_path_data_t *data2)
+{
+  gint j;
+
+  if (data1->header.type   != data2->header.type ||
+      data1->header.length != data2->header.length)
+    return FALSE;
+
+  for (j = 1; j < data1->header.length; j++)
+    {
+      if (data1[j].point.x != data2[j].point.x ||
+          data1[j].point.y != data2[j].point.y)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gimp_vector_layer_extents_add (gdouble                 *extents,
+                               const cairo_path_data_t *data,
+                               gint                     first,
+                               gint                     last)
+{
+  gint j;
+
+  for (j = first; j <= last; j++)
+    {
+      extents[0] = MIN (extents[0], data[j].point.x);
+      extents[1] = MIN (extents[1], data[j].point.y);
+      extents[2] = MAX (extents[2], data[j].point.x);
+      extents[3] = MAX (extents[3], data[j].point.y);
+    }
+}
+
+/* dirties only the segments which differ between @old_stroke and
+ * @stroke: the elements between their common beginning and their
+ * common end, together with the points they start from, and the
+ * stroke's start when the implicit closing segment moved.  a segment
+ * and the fill it changes stay within its control points, joins and
+ * caps within @margin of them.
+ */
+static void
+gimp_vector_layer_stroke_dirty_changes (GimpVectorLayerStroke *old_stroke,
+                                        GimpVectorLayerStroke *stroke,
+                                        gint                   margin,
+                                        cairo_region_t        *region)
+{
+  const GimpBezierDesc    *bezier1 = old_stroke->bezier;
+  const GimpBezierDesc    *bezier2 = stroke->bezier;
+  const cairo_path_data_t *data;
+  gint                    *elements1;
+  gint                    *elements2;
+  gint                     n1, n2;
+  gint                     n;
+  gint                     p, q;
+  gint                     i;
+  gdouble                  extents[4] = { G_MAXDOUBLE,  G_MAXDOUBLE,
+                                          -G_MAXDOUBLE, -G_MAXDOUBLE };
+  cairo_rectangle_int_t    rect;
+
+  if (! bezier1 || ! bezier2)
+    {
+      gimp_vector_layer_stroke_dirty (old_stroke, margin, region);
+      gimp_vector_layer_stroke_dirty (stroke,     margin, region);
+
+      return;
+    }
+
+  elements1 = gimp_vector_layer_bezier_elements (bezier1, &n1);
+  elements2 = gimp_vector_layer_bezier_elements (bezier2, &n2);
+
+  n = MIN (n1, n2);
+
+  for (p = 0; p < n; p++)
+    {
+      if (! gimp_vector_layer_element_equal (&bezier1->data[elements1[p]],
+                                             &bezier2->data[elements2[p]]))
+        break;
+    }
+
+  /* the stroke's start moved, e.g. the path was moved as a whole */
+  if (p == 0)
+    {
+      g_free (elements1);
+      g_free (elements2);
+
+      gimp_vector_layer_stroke_dirty (old_stroke, margin, region);
+      gimp_vector_layer_stroke_dirty (stroke,     margin, region);
+
+      return;
+    }
+
+  for (q = 0; p + q < n; q++)
+    {
+      if (! gimp_vector_layer_element_equal (&bezier1->data[elements1[n1 - 1 - q]],
+                                             &bezier2->data[elements2[n2 - 1 - q]]))
+        break;
+    }
+
+  /* the first changed segment starts where the last kept one ends */
+  data = &bezier2->data[elements2[p - 1]];
+
+  if (data->header.length > 1)
+    gimp_vector_layer_extents_add (extents, data,
+                                   data->header.length - 1,
+                                   data->header.length - 1);
+  else
+    gimp_vector_layer_extents_add (extents, bezier2->data, 1, 1);
+
+  /* the changed elements, and the first kept one after them, whose
+   * start point moved
+   */
+  for (i = p; i <= n1 - q && i < n1; i++)
+    {
+      data = &bezier1->data[elements1[i]];
+
+      gimp_vector_layer_extents_add (extents, data,
+                                     1, data->header.length - 1);
+    }
+
+  for (i = p; i <= n2 - q && i < n2; i++)
+    {
+      data = &bezier2->data[elements2[i]];
+
+      gimp_vector_layer_extents_add (extents, data,
+                                     1, data->header.length - 1);
+    }
+
+  /* the segment closing the stroke, implicitly for the fill, ends at
+   * the stroke's start
+   */
+  if (q == 0 ||
+      bezier2->data[elements2[n2 - q]].header.type == CAIRO_PATH_CLOSE_PATH)
+    {
+      gimp_vector_layer_extents_add (extents, bezier2->data, 1, 1);
+    }
+
+  g_free (elements1);
+  g_free (elements2);
+
+  rect.x      = floor (extents[0]);
+  rect.y      = floor (extents[1]);
+  rect.width  = ceil (extents[2]) - rect.x;
+  rect.height = ceil (extents[3]) - rect.y;
+
+  rect.x      -= margin;
+  rect.y      -= margin;
+  rect.width  += 2 * margin;
+  rect.height += 2 * margin;
+
+  cairo_region_union_rectangle (region, &rect);
 }
@@ -42,6 +42,9 @@ struct _GimpVectorLayer
 
   GimpVectorLayerOptions *options;
   gboolean                modified;
+
+  /*  the strokes of the last render, by stroke ID  */
+  GHashTable             *strokes;
 };
 
 struct _GimpVectorLayerClass
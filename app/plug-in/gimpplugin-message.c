@@ -63,8 +63,13 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static GimpValueArray *
+            gimp_plug_in_run_proc                (GimpPlugIn      *plug_in,
+                                                  GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
+static void gimp_plug_in_handle_proc_batch_run   (GimpPlugIn      *plug_in,
+                                                  GPProcBatchRun  *proc_batch_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
                                                   GPProcReturn    *proc_return);
 static void gimp_plug_in_handle_temp_proc_return (GimpPlugIn      *plug_in,
@@ -160,6 +165,19 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_PROC_BATCH_RUN:
+      gimp_plug_in_handle_proc_batch_run (plug_in, msg->data);
+      break;
+
+    case GP_PROC_BATCH_RETURN:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "sent a PROC_BATCH_RETURN message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
     }
 }
 
@@ -202,7 +220,8 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
   tile_data.bpp         = 0;
   tile_data.width       = 0;
   tile_data.height      = 0;
-  tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  tile_data.use_shm     = (plug_in->shm != NULL);
+  tile_data.slot        = 0;
   tile_data.data        = NULL;
 
   if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
@@ -318,9 +337,28 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
 
   if (tile_data.use_shm)
     {
+      guchar *slot = gimp_plug_in_shm_get_slot (plug_in->shm,
+                                                tile_info->slot);
+
+      if (! slot)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-in \"%s\"\n(%s)\n\n"
+                        "sent tile data in invalid slot %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_file_get_utf8_name (plug_in->file),
+                        tile_info->slot);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      /*  the slot is laid out like the plug-in's tile, so it can write
+       *  its tiles without repacking them first
+       */
       gegl_buffer_set (buffer, &tile_rect, 0, format,
-                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
-                       GEGL_AUTO_ROWSTRIDE);
+                       slot,
+                       GIMP_PLUG_IN_TILE_WIDTH *
+                       babl_format_get_bytes_per_pixel (format));
     }
   else
     {
@@ -351,6 +389,7 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   const Babl      *format;
   GeglRectangle    tile_rect;
   gint             tile_size;
+  guchar          *slot = NULL;
 
   drawable = (GimpDrawable *) gimp_item_get_by_id (plug_in->manager->gimp,
                                                    request->drawable_id);
@@ -379,6 +418,23 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
       return;
     }
 
+  if (plug_in->shm)
+    {
+      slot = gimp_plug_in_shm_get_slot (plug_in->shm, request->slot);
+
+      if (! slot)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-in \"%s\"\n(%s)\n\n"
+                        "requested tile in invalid slot %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_file_get_utf8_name (plug_in->file),
+                        request->slot);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+    }
+
   if (request->shadow)
     {
       buffer = gimp_drawable_get_shadow_buffer (drawable);
@@ -417,13 +473,16 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   tile_data.bpp         = babl_format_get_bytes_per_pixel (format);
   tile_data.width       = tile_rect.width;
   tile_data.height      = tile_rect.height;
-  tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  tile_data.use_shm     = (slot != NULL);
+  tile_data.slot        = request->slot;
 
   if (tile_data.use_shm)
     {
+      /*  the plug-in uses the slot as its tile's storage  */
       gegl_buffer_get (buffer, &tile_rect, 1.0, format,
-                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+                       slot,
+                       GIMP_PLUG_IN_TILE_WIDTH * tile_data.bpp,
+                       GEGL_ABYSS_NONE);
     }
   else
     {
@@ -496,9 +555,9 @@ gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
     }
 }
 
-static void
-gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
-                              GPProcRun  *proc_run)
+static GimpValueArray *
+gimp_plug_in_run_proc (GimpPlugIn *plug_in,
+                       GPProcRun  *proc_run)
 {
   GimpPlugInProcFrame *proc_frame;
   gchar               *canonical;
@@ -508,9 +567,6 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
   GimpValueArray      *return_vals = NULL;
   GError              *error       = NULL;
 
-  g_return_if_fail (proc_run != NULL);
-  g_return_if_fail (proc_run->name != NULL);
-
   canonical = gimp_canonicalize_identifier (proc_run->name);
 
   proc_frame = gimp_plug_in_get_proc_frame (plug_in);
@@ -602,6 +658,20 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
 
   g_free (canonical);
 
+  return return_vals;
+}
+
+static void
+gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
+                              GPProcRun  *proc_run)
+{
+  GimpValueArray *return_vals;
+
+  g_return_if_fail (proc_run != NULL);
+  g_return_if_fail (proc_run->name != NULL);
+
+  return_vals = gimp_plug_in_run_proc (plug_in, proc_run);
+
   /*  Don't bother to send the return value if executing the procedure
    *  closed the plug-in (e.g. if the procedure is gimp-quit)
    */
@@ -630,6 +700,73 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
   gimp_value_array_unref (return_vals);
 }
 
+/*  runs the procedures of the batch in order, like the same number of
+ *  GP_PROC_RUN messages would, and sends all their return values back
+ *  at once.
+ */
+static void
+gimp_plug_in_handle_proc_batch_run (GimpPlugIn     *plug_in,
+                                    GPProcBatchRun *proc_batch_run)
+{
+  GPProcBatchReturn proc_batch_return;
+  guint             i;
+
+  g_return_if_fail (proc_batch_run != NULL);
+
+  proc_batch_return.n_procs = 0;
+  proc_batch_return.procs   = g_new0 (GPProcReturn, proc_batch_run->n_procs);
+
+  for (i = 0; i < proc_batch_run->n_procs && plug_in->open; i++)
+    {
+      GPProcRun      *proc_run    = &proc_batch_run->procs[i];
+      GPProcReturn   *proc_return = &proc_batch_return.procs[i];
+      GimpValueArray *return_vals;
+
+      if (! proc_run->name)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-in \"%s\"\n(%s)\n\n"
+                        "sent a procedure batch with an invalid "
+                        "procedure name (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_file_get_utf8_name (plug_in->file));
+          gimp_plug_in_close (plug_in, TRUE);
+          break;
+        }
+
+      return_vals = gimp_plug_in_run_proc (plug_in, proc_run);
+
+      proc_return->name     = proc_run->name;
+      proc_return->n_params = gimp_value_array_length (return_vals);
+      proc_return->params   = _gimp_value_array_to_gp_params (return_vals,
+                                                              FALSE);
+
+      proc_batch_return.n_procs++;
+
+      gimp_value_array_unref (return_vals);
+    }
+
+  /*  Don't bother to send the return values if executing a procedure
+   *  closed the plug-in (e.g. if the procedure is gimp-quit)
+   */
+  if (plug_in->open)
+    {
+      if (! gp_proc_batch_return_write (plug_in->my_write,
+                                        &proc_batch_return, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "%s: ERROR", G_STRFUNC);
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+    }
+
+  for (i = 0; i < proc_batch_return.n_procs; i++)
+    _gimp_gp_params_free (proc_batch_return.procs[i].params,
+                          proc_batch_return.procs[i].n_params, FALSE);
+
+  g_free (proc_batch_return.procs);
+}
+
 static void
 gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                  GPProcReturn *proc_return)
@@ -94,6 +94,7 @@
 #include "gimpplugindef.h"
 #include "gimppluginmanager.h"
 #include "gimppluginmanager-help-domain.h"
+#include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 
 #include "gimp-intl.h"
@@ -825,6 +826,11 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
   g_clear_pointer (&plug_in->his_read,  g_io_channel_unref);
   g_clear_pointer (&plug_in->his_write, g_io_channel_unref);
 
+  /*  need to detach from shared memory, we can't rely on exit()
+   *  cleaning up behind us (see bug #609026)
+   */
+  g_clear_pointer (&plug_in->shm, gimp_plug_in_shm_free);
+
   gimp_wire_clear_error ();
 
   while (plug_in->temp_proc_frames)
@@ -53,6 +53,8 @@ struct _GimpPlugIn
   GIOChannel          *his_read;        /*  Plug-in's read and write channels */
   GIOChannel          *his_write;
 
+  GimpPlugInShm       *shm;             /*  Shared memory tile slots          */
+
   guint                input_id;        /*  Id of input proc                  */
 
   gchar                write_buffer[WRITE_BUFFER_SIZE]; /* Buffer for writing */
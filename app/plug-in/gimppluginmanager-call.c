@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
@@ -70,47 +72,93 @@ gimp_allow_set_foreground_window (GimpPlugIn *plug_in)
 #endif
 }
 
+static gboolean
+gimp_plug_in_manager_query_recv (GIOChannel   *channel,
+                                 GIOCondition  cond,
+                                 GimpPlugIn   *plug_in)
+{
+#ifdef G_OS_WIN32
+  /* Workaround for GLib bug #137968, see gimp_plug_in_recv_message()
+   */
+  if (cond == 0)
+    return G_SOURCE_CONTINUE;
+#endif
+
+  if (cond & (G_IO_IN | G_IO_PRI))
+    {
+      GimpWireMessage msg;
+
+      memset (&msg, 0, sizeof (GimpWireMessage));
+
+      if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+        {
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+      else
+        {
+          gimp_plug_in_handle_message (plug_in, &msg);
+          gimp_wire_destroy (&msg);
+        }
+    }
+  else if (cond & (G_IO_ERR | G_IO_HUP))
+    {
+      if (cond & G_IO_HUP)
+        plug_in->hup = TRUE;
+
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+
+  return plug_in->open ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
 
 /*  public functions  */
 
-void
+GimpPlugIn *
 gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
                                  GimpContext       *context,
-                                 GimpPlugInDef     *plug_in_def)
+                                 GimpPlugInDef     *plug_in_def,
+                                 GMainContext      *main_context)
 {
   GimpPlugIn *plug_in;
+  GSource    *source;
 
-  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
-  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
-  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def), NULL);
+  g_return_val_if_fail (main_context != NULL, NULL);
 
   plug_in = gimp_plug_in_new (manager, context, NULL,
                               NULL, plug_in_def->file, NULL);
 
-  if (plug_in)
-    {
-      plug_in->plug_in_def = plug_in_def;
-
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
-        {
-          while (plug_in->open)
-            {
-              GimpWireMessage msg;
+  if (! plug_in)
+    return NULL;
 
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
-        }
+  plug_in->plug_in_def = plug_in_def;
 
+  /*  open the plug-in synchronously, so its messages aren't dispatched
+   *  from the default main context, and watch it in main_context
+   *  instead, which lets the caller query several plug-ins at once
+   */
+  if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
+    {
       g_object_unref (plug_in);
+
+      return NULL;
     }
+
+  source = g_io_create_watch (plug_in->my_read,
+                              G_IO_IN  | G_IO_PRI | G_IO_ERR | G_IO_HUP);
+
+  g_source_set_callback (source,
+                         (GSourceFunc) gimp_plug_in_manager_query_recv,
+                         g_object_ref (plug_in),
+                         (GDestroyNotify) g_object_unref);
+
+  g_source_attach (source, main_context);
+  g_source_unref (source);
+
+  return plug_in;
 }
 
 void
@@ -209,14 +257,21 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
           return return_vals;
         }
 
+      /*  allocate the plug-in's tile slots. if we can't allocate a
+       *  piece of shared memory then we'll fall back on sending the
+       *  data over the pipe.
+       */
+      if (manager->gimp->use_shm)
+        plug_in->shm = gimp_plug_in_shm_new ();
+
       display_id = display ? gimp_display_get_id (display) : -1;
 
       icon_theme_dir = gimp_get_icon_theme_dir (manager->gimp);
 
       config.tile_width           = GIMP_PLUG_IN_TILE_WIDTH;
       config.tile_height          = GIMP_PLUG_IN_TILE_HEIGHT;
-      config.shm_id               = (manager->shm ?
-                                     gimp_plug_in_shm_get_id (manager->shm) :
+      config.shm_id               = (plug_in->shm ?
+                                     gimp_plug_in_shm_get_id (plug_in->shm) :
                                      -1);
       config.check_size           = display_config->transparency_size;
       config.check_type           = display_config->transparency_type;
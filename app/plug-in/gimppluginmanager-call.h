@@ -24,11 +24,13 @@
 #endif
 
 
-/*  Call the plug-in's query() function
+/*  Call the plug-in's query() function, the plug-in's messages are
+ *  dispatched from main_context, and it is closed once it is done
  */
-void             gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
+GimpPlugIn     * gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
                                                      GimpContext            *context,
-                                                     GimpPlugInDef          *plug_in_def);
+                                                     GimpPlugInDef          *plug_in_def,
+                                                     GMainContext           *main_context);
 
 /*  Call the plug-in's init() function
  */
@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -38,6 +39,7 @@
 #include "pdb/gimppdbcontext.h"
 
 #include "gimpinterpreterdb.h"
+#include "gimpplugin.h"
 #include "gimpplugindef.h"
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
@@ -51,6 +53,17 @@
 #include "gimp-intl.h"
 
 
+typedef struct _GimpPlugInQuery GimpPlugInQuery;
+
+struct _GimpPlugInQuery
+{
+  GimpPlugInDef *plug_in_def;
+  GimpPlugIn    *plug_in;
+  gint64         start_time;
+  gint64         time;
+};
+
+
 static void    gimp_plug_in_manager_search            (GimpPlugInManager    *manager,
                                                        GimpInitStatusFunc    status_callback);
 static void    gimp_plug_in_manager_search_directory  (GimpPlugInManager    *manager,
@@ -62,6 +75,13 @@ static void    gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager    *man
 static void    gimp_plug_in_manager_query_new         (GimpPlugInManager    *manager,
                                                        GimpContext          *context,
                                                        GimpInitStatusFunc    status_callback);
+static void    gimp_plug_in_manager_query_start       (GimpPlugInManager    *manager,
+                                                       GimpContext          *context,
+                                                       GimpPlugInQuery      *query,
+                                                       GMainContext         *main_context);
+static void    gimp_plug_in_manager_query_finish      (GimpPlugInQuery      *query);
+static gint    gimp_plug_in_manager_query_compare     (gconstpointer         a,
+                                                       gconstpointer         b);
 static void    gimp_plug_in_manager_init_plug_ins     (GimpPlugInManager    *manager,
                                                        GimpContext          *context,
                                                        GimpInitStatusFunc    status_callback);
@@ -436,7 +456,11 @@ gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
     }
 }
 
-/* query any plug-ins that changed since we last wrote out pluginrc */
+/* query any plug-ins that changed since we last wrote out pluginrc,
+ * as many at a time as there are processors.  The plug-ins register
+ * their procedures with their own GimpPlugInDef, so pluginrc is written
+ * the same, no matter in which order they finish.
+ */
 static void
 gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
                                 GimpContext        *context,
@@ -460,36 +484,153 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
+      GMainContext     *main_context;
+      GimpPlugInQuery  *queries;
+      GimpPlugInQuery **running;
+      gint64            start_time;
+      gint              n_slots;
+      gint              n_started  = 0;
+      gint              n_finished = 0;
+      gint              i;
 
       manager->write_pluginrc = TRUE;
 
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
+      queries = g_new0 (GimpPlugInQuery, n_plugins);
+
+      for (list = manager->plug_in_defs, i = 0; list; list = list->next)
         {
           GimpPlugInDef *plug_in_def = list->data;
 
           if (plug_in_def->needs_query)
+            queries[i++].plug_in_def = plug_in_def;
+        }
+
+      n_slots = GIMP_GEGL_CONFIG (manager->gimp->config)->num_processors;
+      n_slots = CLAMP (n_slots, 1, n_plugins);
+
+      running = g_new0 (GimpPlugInQuery *, n_slots);
+
+      /*  the plug-ins' messages are dispatched from a main context of
+       *  our own, so nothing else runs while they are queried
+       */
+      main_context = g_main_context_new ();
+
+      start_time = g_get_monotonic_time ();
+
+      while (n_finished < n_plugins)
+        {
+          gboolean any_running = FALSE;
+
+          for (i = 0; i < n_slots; i++)
             {
-              gchar *basename;
+              if (running[i] && ! running[i]->plug_in->open)
+                {
+                  gimp_plug_in_manager_query_finish (running[i]);
 
-              basename =
-                g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
+                  running[i] = NULL;
+                  n_finished++;
+                }
 
-              if (manager->gimp->be_verbose)
-                g_print ("Querying plug-in: '%s'\n",
-                         gimp_file_get_utf8_name (plug_in_def->file));
+              if (! running[i] && n_started < n_plugins)
+                {
+                  GimpPlugInQuery *query = &queries[n_started++];
+                  gchar           *basename;
+
+                  basename =
+                    g_path_get_basename (gimp_file_get_utf8_name (query->plug_in_def->file));
+                  status_callback (NULL, basename,
+                                   (gdouble) n_finished / (gdouble) n_plugins);
+                  g_free (basename);
+
+                  gimp_plug_in_manager_query_start (manager, context, query,
+                                                    main_context);
 
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
+                  if (query->plug_in)
+                    {
+                      running[i] = query;
+                    }
+                  else
+                    {
+                      gimp_plug_in_manager_query_finish (query);
+
+                      n_finished++;
+                    }
+                }
+
+              if (running[i])
+                any_running = TRUE;
             }
+
+          if (any_running)
+            g_main_context_iteration (main_context, TRUE);
         }
+
+      g_main_context_unref (main_context);
+      g_free (running);
+
+      if (manager->gimp->be_verbose)
+        {
+          g_print ("Queried %d plug-ins in %.3f seconds, %d at a time\n",
+                   n_plugins,
+                   (g_get_monotonic_time () - start_time) / 1000000.0,
+                   n_slots);
+
+          /*  list the slowest plug-ins first  */
+          qsort (queries, n_plugins, sizeof (GimpPlugInQuery),
+                 gimp_plug_in_manager_query_compare);
+
+          for (i = 0; i < n_plugins; i++)
+            g_print ("  %8.3f s  %s\n",
+                     queries[i].time / 1000000.0,
+                     gimp_file_get_utf8_name (queries[i].plug_in_def->file));
+        }
+
+      g_free (queries);
     }
 
   status_callback (NULL, "", 1.0);
 }
 
+static void
+gimp_plug_in_manager_query_start (GimpPlugInManager *manager,
+                                  GimpContext       *context,
+                                  GimpPlugInQuery   *query,
+                                  GMainContext      *main_context)
+{
+  if (manager->gimp->be_verbose)
+    g_print ("Querying plug-in: '%s'\n",
+             gimp_file_get_utf8_name (query->plug_in_def->file));
+
+  query->start_time = g_get_monotonic_time ();
+
+  query->plug_in = gimp_plug_in_manager_call_query (manager, context,
+                                                    query->plug_in_def,
+                                                    main_context);
+}
+
+static void
+gimp_plug_in_manager_query_finish (GimpPlugInQuery *query)
+{
+  query->time = g_get_monotonic_time () - query->start_time;
+
+  g_clear_object (&query->plug_in);
+}
+
+static gint
+gimp_plug_in_manager_query_compare (gconstpointer a,
+                                    gconstpointer b)
+{
+  const GimpPlugInQuery *query_a = a;
+  const GimpPlugInQuery *query_b = b;
+
+  if (query_a->time > query_b->time)
+    return -1;
+  else if (query_a->time < query_b->time)
+    return 1;
+
+  return 0;
+}
+
 /* initialize the plug-ins */
 static void
 gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
@@ -47,7 +47,6 @@
 #include "gimppluginmanager-data.h"
 #include "gimppluginmanager-help-domain.h"
 #include "gimppluginmanager-menu-branch.h"
-#include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 
 #include "gimp-intl.h"
@@ -198,7 +197,6 @@ gimp_plug_in_manager_get_memsize (GimpObject *object,
                                                gui_size);
   memsize += gimp_g_slist_get_memsize (manager->plug_in_stack, 0);
 
-  memsize += 0; /* FIXME manager->shm */
   memsize += /* FIXME */ gimp_g_object_get_memsize (G_OBJECT (manager->interpreter_db));
   memsize += /* FIXME */ gimp_g_object_get_memsize (G_OBJECT (manager->environ_table));
   memsize += 0; /* FIXME manager->plug_in_debug */
@@ -254,13 +252,6 @@ gimp_plug_in_manager_initialize (GimpPlugInManager  *manager,
   gimp_environ_table_load (manager->environ_table, path);
   g_list_free_full (path, (GDestroyNotify) g_object_unref);
 
-  /*  allocate a piece of shared memory for use in transporting tiles
-   *  to plug-ins. if we can't allocate a piece of shared memory then
-   *  we'll fall back on sending the data over the pipe.
-   */
-  if (manager->gimp->use_shm)
-    manager->shm = gimp_plug_in_shm_new ();
-
   manager->debug = gimp_plug_in_debug_new ();
 }
 
@@ -271,15 +262,6 @@ gimp_plug_in_manager_exit (GimpPlugInManager *manager)
 
   while (manager->open_plug_ins)
     gimp_plug_in_close (manager->open_plug_ins->data, TRUE);
-
-  /*  need to detach from shared memory, we can't rely on exit()
-   *  cleaning up behind us (see bug #609026)
-   */
-  if (manager->shm)
-    {
-      gimp_plug_in_shm_free (manager->shm);
-      manager->shm = NULL;
-    }
 }
 
 void
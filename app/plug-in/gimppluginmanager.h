@@ -60,7 +60,6 @@ struct _GimpPlugInManager
   GSList            *open_plug_ins;
   GSList            *plug_in_stack;
 
-  GimpPlugInShm     *shm;
   GimpInterpreterDB *interpreter_db;
   GimpEnvironTable  *environ_table;
   GimpPlugInDebug   *debug;
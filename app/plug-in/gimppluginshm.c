@@ -62,16 +62,20 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
-#include "plug-in-types.h"
+#include "libgimpbase/gimpprotocol.h"
 
-#include "core/gimp-utils.h"
+#include "plug-in-types.h"
 
 #include "gimppluginshm.h"
 
 #include "gimp-log.h"
 
 
-#define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 32)
+#define TILE_SLOT_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 32)
+#define TILE_MAP_SIZE  (TILE_SLOT_SIZE * GP_TILE_SHM_N_SLOTS)
+
+/* the number of names tried before giving up on a named segment */
+#define N_NAME_TRIES   8
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
@@ -91,8 +95,11 @@ GimpPlugInShm *
 gimp_plug_in_shm_new (void)
 {
   /* allocate a piece of shared memory for use in transporting tiles
-   *  to plug-ins. if we can't allocate a piece of shared memory then
+   *  to a plug-in. if we can't allocate a piece of shared memory then
    *  we'll fall back on sending the data over the pipe.
+   *
+   *  every plug-in gets its own segment, because the plug-in keeps
+   *  using the tiles in the segment's slots between tile requests.
    */
 
   GimpPlugInShm *shm = g_slice_new0 (GimpPlugInShm);
@@ -133,26 +140,38 @@ gimp_plug_in_shm_new (void)
 
   /* Use Win32 shared memory mechanisms for transferring tile data. */
   {
-    gint     pid;
+    gint     id = 0;
     gchar    fileMapName[MAX_PATH];
     wchar_t *w_fileMapName         = NULL;
+    gint     i;
+
+    for (i = 0; i < N_NAME_TRIES; i++)
+      {
+        /* Our shared memory id is a random number, there can be
+         * several segments per process
+         */
+        id = g_random_int_range (1, G_MAXINT32);
 
-    /* Our shared memory id will be our process ID */
-    pid = GetCurrentProcessId ();
+        /* From the id, derive the file map name */
+        g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", id);
 
-    /* From the id, derive the file map name */
-    g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", pid);
+        w_fileMapName = g_utf8_to_utf16 (fileMapName, -1, NULL, NULL, NULL);
 
-    w_fileMapName = g_utf8_to_utf16 (fileMapName, -1, NULL, NULL, NULL);
+        /* Create the file mapping into paging space */
+        shm->shm_handle = CreateFileMappingW (INVALID_HANDLE_VALUE, NULL,
+                                              PAGE_READWRITE, 0,
+                                              TILE_MAP_SIZE,
+                                              w_fileMapName);
 
-    /* Create the file mapping into paging space */
-    shm->shm_handle = CreateFileMappingW (INVALID_HANDLE_VALUE, NULL,
-                                          PAGE_READWRITE, 0,
-                                          TILE_MAP_SIZE,
-                                          w_fileMapName);
+        g_free (w_fileMapName);
+        w_fileMapName = NULL;
 
-    g_free (w_fileMapName);
-    w_fileMapName = NULL;
+        if (! shm->shm_handle || GetLastError () != ERROR_ALREADY_EXISTS)
+          break;
+
+        CloseHandle (shm->shm_handle);
+        shm->shm_handle = NULL;
+      }
 
     if (shm->shm_handle)
       {
@@ -164,12 +183,14 @@ gimp_plug_in_shm_new (void)
         /* Verify that we mapped our view */
         if (shm->shm_addr)
           {
-            shm->shm_id = pid;
+            shm->shm_id = id;
           }
         else
           {
             g_printerr ("MapViewOfFile error: %u... " ERRMSG_SHM_DISABLE,
                         (unsigned) GetLastError ());
+
+            CloseHandle (shm->shm_handle);
           }
       }
     else
@@ -183,18 +204,27 @@ gimp_plug_in_shm_new (void)
 
   /* Use POSIX shared memory mechanisms for transferring tile data. */
   {
-    gint  pid;
+    gint  id = 0;
     gchar shm_handle[32];
-    gint  shm_fd;
+    gint  shm_fd = -1;
+    gint  i;
+
+    for (i = 0; i < N_NAME_TRIES && shm_fd == -1; i++)
+      {
+        /* Our shared memory id is a random number, there can be
+         * several segments per process
+         */
+        id = g_random_int_range (1, G_MAXINT32);
 
-    /* Our shared memory id will be our process ID */
-    pid = gimp_get_pid ();
+        /* From the id, derive the file map name */
+        g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d", id);
 
-    /* From the id, derive the file map name */
-    g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d", pid);
+        /* Create the file mapping into paging space */
+        shm_fd = shm_open (shm_handle, O_RDWR | O_CREAT | O_EXCL, 0600);
 
-    /* Create the file mapping into paging space */
-    shm_fd = shm_open (shm_handle, O_RDWR | O_CREAT, 0600);
+        if (shm_fd == -1 && errno != EEXIST)
+          break;
+      }
 
     if (shm_fd != -1)
       {
@@ -208,7 +238,7 @@ gimp_plug_in_shm_new (void)
             /* Verify that we mapped our view */
             if (shm->shm_addr != MAP_FAILED)
               {
-                shm->shm_id = pid;
+                shm->shm_id = id;
               }
             else
               {
@@ -305,3 +335,18 @@ gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
 
   return shm->shm_addr;
 }
+
+/* returns the tile slot @slot of the segment, or NULL if the plug-in
+ * sent an invalid slot number.
+ */
+guchar *
+gimp_plug_in_shm_get_slot (GimpPlugInShm *shm,
+                           guint          slot)
+{
+  g_return_val_if_fail (shm != NULL, NULL);
+
+  if (slot >= GP_TILE_SHM_N_SLOTS)
+    return NULL;
+
+  return shm->shm_addr + (gsize) slot * TILE_SLOT_SIZE;
+}
@@ -25,3 +25,5 @@ void            gimp_plug_in_shm_free     (GimpPlugInShm *shm);
 
 gint            gimp_plug_in_shm_get_id   (GimpPlugInShm *shm);
 guchar        * gimp_plug_in_shm_get_addr (GimpPlugInShm *shm);
+guchar        * gimp_plug_in_shm_get_slot (GimpPlugInShm *shm,
+                                           guint          slot);
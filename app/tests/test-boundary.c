@@ -0,0 +1,318 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpboundary.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE   2048
+#define CELL_SIZE    8
+#define N_EDITS      16
+#define N_QUERIES    64
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-boundary/" #function, gimp, function);
+
+
+/* returns a new mask made of cells which are selected, partially
+ * selected or not at all, which makes for a long, winding boundary.
+ */
+static GeglBuffer *
+boundary_new_mask (GRand *rand)
+{
+  GeglBuffer *buffer;
+  gfloat     *row;
+  gfloat     *cells;
+  gint        n_cells = IMAGE_SIZE / CELL_SIZE;
+  gint        x, y;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, IMAGE_SIZE, IMAGE_SIZE),
+                            babl_format ("Y float"));
+
+  cells = g_new (gfloat, n_cells * n_cells);
+
+  for (x = 0; x < n_cells * n_cells; x++)
+    cells[x] = g_rand_int_range (rand, 0, 3) / 2.0f;
+
+  row = g_new (gfloat, IMAGE_SIZE);
+
+  for (y = 0; y < IMAGE_SIZE; y++)
+    {
+      for (x = 0; x < IMAGE_SIZE; x++)
+        row[x] = cells[(y / CELL_SIZE) * n_cells + x / CELL_SIZE];
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, IMAGE_SIZE, 1), 0,
+                       babl_format ("Y float"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+  g_free (cells);
+
+  return buffer;
+}
+
+static gint
+boundary_seg_compare (const void *a,
+                      const void *b)
+{
+  const GimpBoundSeg *seg1 = a;
+  const GimpBoundSeg *seg2 = b;
+
+  if (seg1->x1 != seg2->x1)
+    return seg1->x1 - seg2->x1;
+
+  if (seg1->y1 != seg2->y1)
+    return seg1->y1 - seg2->y1;
+
+  if (seg1->x2 != seg2->x2)
+    return seg1->x2 - seg2->x2;
+
+  if (seg1->y2 != seg2->y2)
+    return seg1->y2 - seg2->y2;
+
+  return (gint) seg1->open - (gint) seg2->open;
+}
+
+/* checks that both arrays hold the same segments, in the same order */
+static void
+boundary_assert_equal (const GimpBoundSeg *segs,
+                       gint                num_segs,
+                       const GimpBoundSeg *expected,
+                       gint                num_expected)
+{
+  gint i;
+
+  g_assert_cmpint (num_segs, ==, num_expected);
+
+  for (i = 0; i < num_segs; i++)
+    g_assert_cmpint (boundary_seg_compare (&segs[i], &expected[i]), ==, 0);
+}
+
+/* checks that both arrays hold the same segments, in any order */
+static void
+boundary_assert_same (GimpBoundSeg *segs,
+                      gint          num_segs,
+                      GimpBoundSeg *expected,
+                      gint          num_expected)
+{
+  g_assert_cmpint (num_segs, ==, num_expected);
+
+  if (num_segs == 0)
+    return;
+
+  qsort (segs,     num_segs,     sizeof (GimpBoundSeg), boundary_seg_compare);
+  qsort (expected, num_expected, sizeof (GimpBoundSeg), boundary_seg_compare);
+
+  boundary_assert_equal (segs, num_segs, expected, num_expected);
+}
+
+/* edits random areas of a mask, and checks that the cached boundary
+ * matches the one found from scratch after each edit, segment for
+ * segment.
+ */
+static void
+boundary_compare (GimpBoundaryType type)
+{
+  GimpBoundaryCache   *cache;
+  GeglBuffer          *buffer;
+  GRand               *rand;
+  const GeglRectangle *region = NULL;
+  gint                 x1 = IMAGE_SIZE / 8;
+  gint                 y1 = IMAGE_SIZE / 8;
+  gint                 x2 = IMAGE_SIZE - IMAGE_SIZE / 8;
+  gint                 y2 = IMAGE_SIZE - IMAGE_SIZE / 8;
+  gint                 i;
+
+  rand   = g_rand_new_with_seed (1995);
+  buffer = boundary_new_mask (rand);
+  cache  = gimp_boundary_cache_new ();
+
+  if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
+    region = gegl_buffer_get_extent (buffer);
+
+  for (i = 0; i <= N_EDITS; i++)
+    {
+      GimpBoundSeg *segs;
+      GimpBoundSeg *expected;
+      gint          num_segs;
+      gint          num_expected;
+
+      if (i > 0)
+        {
+          GeglRectangle rect;
+          gfloat        value = g_rand_int_range (rand, 0, 3) / 2.0f;
+
+          rect.x      = g_rand_int_range (rand, -64, IMAGE_SIZE);
+          rect.y      = g_rand_int_range (rand, -64, IMAGE_SIZE);
+          rect.width  = g_rand_int_range (rand, 1, 200);
+          rect.height = g_rand_int_range (rand, 1, 200);
+
+          gegl_rectangle_intersect (&rect, &rect,
+                                    gegl_buffer_get_extent (buffer));
+
+          gegl_buffer_set_color_from_pixel (buffer, &rect, &value,
+                                            babl_format ("Y float"));
+
+          gimp_boundary_cache_invalidate (cache, &rect);
+        }
+
+      expected = gimp_boundary_find (buffer, region,
+                                     babl_format ("Y float"), type,
+                                     x1, y1, x2, y2,
+                                     GIMP_BOUNDARY_HALF_WAY,
+                                     &num_expected);
+
+      segs = gimp_boundary_cache_find (cache, buffer, region,
+                                       babl_format ("Y float"), type,
+                                       x1, y1, x2, y2,
+                                       GIMP_BOUNDARY_HALF_WAY,
+                                       &num_segs);
+
+      boundary_assert_equal (segs, num_segs, expected, num_expected);
+
+      g_free (segs);
+      g_free (expected);
+    }
+
+  gimp_boundary_cache_free (cache);
+  g_object_unref (buffer);
+  g_rand_free (rand);
+}
+
+static void
+within_bounds_matches_find (gconstpointer data)
+{
+  boundary_compare (GIMP_BOUNDARY_WITHIN_BOUNDS);
+}
+
+static void
+ignore_bounds_matches_find (gconstpointer data)
+{
+  boundary_compare (GIMP_BOUNDARY_IGNORE_BOUNDS);
+}
+
+/**
+ * index_matches_brute_force:
+ * @data:
+ *
+ * Test that looking up the segments in an area with the spatial index
+ * finds the same segments as going over all of them.
+ **/
+static void
+index_matches_brute_force (gconstpointer data)
+{
+  GimpBoundaryIndex *index;
+  GeglBuffer        *buffer;
+  GRand             *rand;
+  GimpBoundSeg      *segs;
+  gint               num_segs;
+  gint               i;
+
+  rand   = g_rand_new_with_seed (1995);
+  buffer = boundary_new_mask (rand);
+
+  segs = gimp_boundary_find (buffer, NULL,
+                             babl_format ("Y float"),
+                             GIMP_BOUNDARY_WITHIN_BOUNDS,
+                             0, 0, IMAGE_SIZE, IMAGE_SIZE,
+                             GIMP_BOUNDARY_HALF_WAY,
+                             &num_segs);
+
+  index = gimp_boundary_index_new (segs, num_segs);
+
+  for (i = 0; i < N_QUERIES; i++)
+    {
+      GimpBoundSeg  *rect_segs;
+      GimpBoundSeg  *expected;
+      GeglRectangle  rect;
+      gint           num_rect_segs;
+      gint           num_expected = 0;
+      gint           j;
+
+      rect.x      = g_rand_int_range (rand, -256, IMAGE_SIZE);
+      rect.y      = g_rand_int_range (rand, -256, IMAGE_SIZE);
+      rect.width  = g_rand_int_range (rand, 0, 1024);
+      rect.height = g_rand_int_range (rand, 0, 1024);
+
+      rect_segs = gimp_boundary_index_query (index, &rect, &num_rect_segs);
+
+      expected = g_new (GimpBoundSeg, num_segs);
+
+      for (j = 0; j < num_segs; j++)
+        {
+          if (MAX (segs[j].x1, segs[j].x2) >= rect.x               &&
+              MIN (segs[j].x1, segs[j].x2) <= rect.x + rect.width  &&
+              MAX (segs[j].y1, segs[j].y2) >= rect.y               &&
+              MIN (segs[j].y1, segs[j].y2) <= rect.y + rect.height)
+            {
+              expected[num_expected++] = segs[j];
+            }
+        }
+
+      boundary_assert_same (rect_segs, num_rect_segs,
+                            expected, num_expected);
+
+      g_free (rect_segs);
+      g_free (expected);
+    }
+
+  gimp_boundary_index_free (index);
+  g_free (segs);
+  g_object_unref (buffer);
+  g_rand_free (rand);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (within_bounds_matches_find);
+  ADD_TEST (ignore_bounds_matches_find);
+  ADD_TEST (index_matches_brute_force);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
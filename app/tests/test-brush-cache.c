@@ -0,0 +1,267 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimpbrushcache.h"
+#include "core/gimpbrushgenerated.h"
+
+#include "gimp-app-test-utils.h"
+#include "tests.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-brush-cache/" #function, gimp, function);
+
+#define UNIT_SIZE 1000
+
+
+static gsize
+unit_size (gconstpointer data)
+{
+  return UNIT_SIZE;
+}
+
+static GimpBrushCache *
+brush_cache_new (void)
+{
+  return gimp_brush_cache_new (g_free, unit_size, 'H', 'm');
+}
+
+static void
+brush_cache_add (GimpBrushCache *cache,
+                 gint            width)
+{
+  gimp_brush_cache_add (cache, g_strdup_printf ("%d", width),
+                        width, width, 1.0, 0.0, 0.0, FALSE, 1.0);
+}
+
+static const gchar *
+brush_cache_get (GimpBrushCache *cache,
+                 gint            width)
+{
+  return gimp_brush_cache_get (cache,
+                               width, width, 1.0, 0.0, 0.0, FALSE, 1.0);
+}
+
+/**
+ * brush_cache_hits:
+ * @data:
+ *
+ * Only units whose parameters all match are returned.
+ **/
+static void
+brush_cache_hits (gconstpointer data)
+{
+  GimpBrushCache *cache = brush_cache_new ();
+  const gchar    *unit;
+
+  g_assert_null (brush_cache_get (cache, 10));
+
+  brush_cache_add (cache, 10);
+
+  unit = brush_cache_get (cache, 10);
+  g_assert_cmpstr (unit, ==, "10");
+  g_assert_true (brush_cache_get (cache, 10) == unit);
+
+  g_assert_null (brush_cache_get (cache, 11));
+  g_assert_null (gimp_brush_cache_get (cache,
+                                       10, 10, 1.0, 0.0, 0.0, TRUE, 1.0));
+  g_assert_null (gimp_brush_cache_get (cache,
+                                       10, 10, 1.0, 0.0, 0.0, FALSE, 0.5));
+
+  g_assert_cmpint (cache->n_hits,   ==, 2);
+  g_assert_cmpint (cache->n_misses, ==, 4);
+
+  gimp_brush_cache_clear (cache);
+
+  g_assert_null (brush_cache_get (cache, 10));
+
+  g_object_unref (cache);
+}
+
+/**
+ * brush_cache_lru_eviction:
+ * @data:
+ *
+ * Once the units don't fit into "max-memsize" any more, the least
+ * recently used ones are evicted.
+ **/
+static void
+brush_cache_lru_eviction (gconstpointer data)
+{
+  GimpBrushCache *cache = brush_cache_new ();
+
+  g_object_set (cache,
+                "max-memsize", (guint64) 3 * UNIT_SIZE,
+                NULL);
+
+  brush_cache_add (cache, 1);
+  brush_cache_add (cache, 2);
+  brush_cache_add (cache, 3);
+
+  g_assert_cmpuint (cache->memsize, ==, 3 * UNIT_SIZE);
+
+  /*  make 1 more recently used than 2  */
+  g_assert_nonnull (brush_cache_get (cache, 1));
+
+  brush_cache_add (cache, 4);
+
+  g_assert_cmpint (cache->n_evictions, ==, 1);
+  g_assert_cmpuint (cache->memsize, ==, 3 * UNIT_SIZE);
+
+  g_assert_null    (brush_cache_get (cache, 2));
+  g_assert_nonnull (brush_cache_get (cache, 1));
+  g_assert_nonnull (brush_cache_get (cache, 3));
+  g_assert_nonnull (brush_cache_get (cache, 4));
+
+  /*  a unit bigger than the cache is still kept  */
+  g_object_set (cache,
+                "max-memsize", (guint64) UNIT_SIZE / 2,
+                NULL);
+
+  brush_cache_add (cache, 5);
+
+  g_assert_cmpint (cache->n_evictions, ==, 4);
+  g_assert_cmpuint (cache->memsize, ==, UNIT_SIZE);
+  g_assert_nonnull (brush_cache_get (cache, 5));
+
+  g_object_unref (cache);
+}
+
+/**
+ * brush_cache_quantize:
+ * @data:
+ *
+ * The parameters are only snapped when a tolerance is set, and then
+ * move the brush's outline by no more than the tolerance.
+ **/
+static void
+brush_cache_quantize (gconstpointer data)
+{
+  Gimp           *gimp  = GIMP (data);
+  GimpBrushCache *cache = brush_cache_new ();
+  gdouble         size  = 41.0;
+  gdouble         scale = 1.2345;
+  gdouble         aspect_ratio;
+  gdouble         angle;
+  gdouble         hardness;
+
+  g_assert_cmpfloat (gimp->config->brush_cache_tolerance, ==, 0.0);
+  g_assert_cmpfloat (cache->tolerance, ==, 0.0);
+
+  aspect_ratio = 1.2345;
+  angle        = 0.12345;
+  hardness     = 0.12345;
+
+  gimp_brush_cache_quantize (cache, size,
+                             &scale, &aspect_ratio, &angle, &hardness);
+
+  g_assert_cmpfloat (scale,        ==, 1.2345);
+  g_assert_cmpfloat (aspect_ratio, ==, 1.2345);
+  g_assert_cmpfloat (angle,        ==, 0.12345);
+  g_assert_cmpfloat (hardness,     ==, 0.12345);
+
+  g_object_set (cache,
+                "tolerance", 0.25,
+                NULL);
+
+  gimp_brush_cache_quantize (cache, size,
+                             &scale, &aspect_ratio, &angle, &hardness);
+
+  g_assert_cmpfloat (fabs (scale * size - 1.2345 * size), <=, 0.125);
+  g_assert_cmpfloat (fabs (angle - 0.12345) * G_PI * scale * size, <=, 0.125);
+  g_assert_cmpfloat (fabs (hardness - 0.12345) * scale * size, <=, 0.25);
+
+  g_object_unref (cache);
+}
+
+/**
+ * brush_cache_tolerance:
+ * @data:
+ *
+ * By default every scale gets its own transformed brush, with a
+ * tolerance nearby scales share one.
+ **/
+static void
+brush_cache_tolerance (gconstpointer data)
+{
+  GimpBrush         *brush;
+  const GimpTempBuf *mask1;
+  const GimpTempBuf *mask2;
+
+  brush = GIMP_BRUSH (gimp_brush_generated_new ("Test",
+                                                GIMP_BRUSH_GENERATED_CIRCLE,
+                                                20.0, 2, 0.5, 1.0, 0.0));
+
+  gimp_brush_begin_use (brush);
+
+  mask1 = gimp_brush_transform_mask (brush, 1.5,    0.0, 0.0, FALSE, 1.0);
+  mask2 = gimp_brush_transform_mask (brush, 1.5001, 0.0, 0.0, FALSE, 1.0);
+
+  g_assert_true (mask1 != mask2);
+
+  gimp_brush_set_cache_tolerance (brush, 0.25);
+
+  mask1 = gimp_brush_transform_mask (brush, 1.5,    0.0, 0.0, FALSE, 1.0);
+  mask2 = gimp_brush_transform_mask (brush, 1.5001, 0.0, 0.0, FALSE, 1.0);
+
+  g_assert_true (mask1 == mask2);
+
+  gimp_brush_end_use (brush);
+
+  g_object_unref (brush);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (brush_cache_hits);
+  ADD_TEST (brush_cache_lru_eviction);
+  ADD_TEST (brush_cache_quantize);
+  ADD_TEST (brush_cache_tolerance);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,341 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimppickable.h"
+#include "core/gimppickable-contiguous-region.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE   2048
+#define CELL_SIZE    8
+#define N_THREADS    4
+
+/* thresholds which don't fall on a u8 step, so that by-color, which
+ * pads the threshold a bit, selects the same pixels
+ */
+#define LOW_THRESHOLD  0.1
+#define HIGH_THRESHOLD 0.55
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-contiguous-region/" #function, gimp, function);
+
+
+/* returns a new image, whose layer is made of gray cells of random
+ * values, which makes for winding regions at any threshold.
+ */
+static GimpImage *
+contiguous_region_new_image (Gimp *gimp)
+{
+  GimpImage  *image;
+  GimpLayer  *layer;
+  GeglBuffer *buffer;
+  GRand      *rand;
+  guchar     *cells;
+  guchar     *row;
+  gint        n_cells = IMAGE_SIZE / CELL_SIZE;
+  gint        x, y;
+
+  image = gimp_image_new (gimp, IMAGE_SIZE, IMAGE_SIZE,
+                          GIMP_RGB, GIMP_PRECISION_U8_NON_LINEAR);
+
+  layer = gimp_layer_new (image, IMAGE_SIZE, IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Region Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  rand  = g_rand_new_with_seed (1995);
+  cells = g_new (guchar, n_cells * n_cells);
+
+  for (x = 0; x < n_cells * n_cells; x++)
+    cells[x] = g_rand_int_range (rand, 0, 256);
+
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  row    = g_new (guchar, IMAGE_SIZE * 4);
+
+  for (y = 0; y < IMAGE_SIZE; y++)
+    {
+      for (x = 0; x < IMAGE_SIZE; x++)
+        {
+          guchar value = cells[(y / CELL_SIZE) * n_cells + x / CELL_SIZE];
+
+          row[x * 4 + 0] = value;
+          row[x * 4 + 1] = value;
+          row[x * 4 + 2] = value;
+          row[x * 4 + 3] = 255;
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, IMAGE_SIZE, 1), 0,
+                       babl_format ("R'G'B'A u8"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+  g_free (cells);
+  g_rand_free (rand);
+
+  return image;
+}
+
+/* finds the region of the seed the slow way: a breadth-first search
+ * over the pixels selected by color.
+ */
+static gfloat *
+contiguous_region_reference (GimpLayer *layer,
+                             gfloat     threshold,
+                             gboolean   diagonal_neighbors,
+                             gint       seed_x,
+                             gint       seed_y)
+{
+  GeglBuffer *mask_buffer;
+  GeglColor  *color;
+  gfloat     *selected;
+  gfloat     *mask;
+  gint       *queue;
+  gint        head = 0;
+  gint        tail = 0;
+
+  color = gimp_pickable_get_color_at (GIMP_PICKABLE (layer),
+                                      seed_x, seed_y);
+
+  mask_buffer = gimp_pickable_contiguous_region_by_color (
+    GIMP_PICKABLE (layer), FALSE, threshold, FALSE,
+    GIMP_SELECT_CRITERION_COMPOSITE, color);
+
+  selected = g_new (gfloat, IMAGE_SIZE * IMAGE_SIZE);
+  mask     = g_new0 (gfloat, IMAGE_SIZE * IMAGE_SIZE);
+  queue    = g_new (gint, IMAGE_SIZE * IMAGE_SIZE);
+
+  gegl_buffer_get (mask_buffer, NULL, 1.0, babl_format ("Y float"), selected,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  queue[tail++] = seed_y * IMAGE_SIZE + seed_x;
+  mask[queue[0]] = selected[queue[0]];
+
+  while (head < tail)
+    {
+      gint x = queue[head] % IMAGE_SIZE;
+      gint y = queue[head] / IMAGE_SIZE;
+      gint dx, dy;
+
+      head++;
+
+      for (dy = -1; dy <= 1; dy++)
+        for (dx = -1; dx <= 1; dx++)
+          {
+            gint i;
+
+            if ((! dx && ! dy) || (dx && dy && ! diagonal_neighbors))
+              continue;
+
+            if (x + dx < 0 || x + dx >= IMAGE_SIZE ||
+                y + dy < 0 || y + dy >= IMAGE_SIZE)
+              continue;
+
+            i = (y + dy) * IMAGE_SIZE + x + dx;
+
+            if (selected[i] != 0.0f && mask[i] == 0.0f)
+              {
+                mask[i]       = selected[i];
+                queue[tail++] = i;
+              }
+          }
+    }
+
+  g_free (queue);
+  g_free (selected);
+  g_object_unref (mask_buffer);
+  g_object_unref (color);
+
+  return mask;
+}
+
+/* selects the region of the seed on n_threads threads, and returns the
+ * time it took, in seconds.
+ */
+static gdouble
+contiguous_region_run (GimpLayer   *layer,
+                       gfloat       threshold,
+                       gboolean     diagonal_neighbors,
+                       gint         n_threads,
+                       gint         seed_x,
+                       gint         seed_y,
+                       GeglBuffer **mask_buffer)
+{
+  gint64 start;
+  gint64 end;
+
+  g_object_set (gegl_config (),
+                "threads", n_threads,
+                NULL);
+
+  start = g_get_monotonic_time ();
+
+  *mask_buffer = gimp_pickable_contiguous_region_by_seed (
+    GIMP_PICKABLE (layer), FALSE, threshold, FALSE,
+    GIMP_SELECT_CRITERION_COMPOSITE, diagonal_neighbors,
+    seed_x, seed_y);
+
+  end = g_get_monotonic_time ();
+
+  return (end - start) / (gdouble) G_TIME_SPAN_SECOND;
+}
+
+/* selects a region on a single thread and on several threads, and checks
+ * that both match the reference.  with -m perf, the time both take is
+ * reported.
+ */
+static void
+contiguous_region_compare (Gimp     *gimp,
+                           gfloat    threshold,
+                           gboolean  diagonal_neighbors)
+{
+  GimpImage  *image;
+  GimpLayer  *layer;
+  GeglBuffer *single_buffer;
+  GeglBuffer *multi_buffer;
+  gfloat     *expected;
+  gfloat     *mask;
+  gint        n_threads;
+  gint        seed_x = IMAGE_SIZE / 2 + CELL_SIZE / 2;
+  gint        seed_y = IMAGE_SIZE / 2 + CELL_SIZE / 2;
+  gint        n_selected;
+  gint        i;
+  gdouble     single_time;
+  gdouble     multi_time;
+
+  image = contiguous_region_new_image (gimp);
+  layer = gimp_image_get_layer_iter (image)->data;
+
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  single_time = contiguous_region_run (layer, threshold, diagonal_neighbors,
+                                       1, seed_x, seed_y, &single_buffer);
+  multi_time  = contiguous_region_run (layer, threshold, diagonal_neighbors,
+                                       N_THREADS, seed_x, seed_y, &multi_buffer);
+
+  g_object_set (gegl_config (),
+                "threads", n_threads,
+                NULL);
+
+  expected = contiguous_region_reference (layer, threshold, diagonal_neighbors,
+                                          seed_x, seed_y);
+  mask     = g_new (gfloat, IMAGE_SIZE * IMAGE_SIZE);
+
+  gegl_buffer_get (single_buffer, NULL, 1.0, babl_format ("Y float"), mask,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  g_assert_true (memcmp (mask, expected,
+                         IMAGE_SIZE * IMAGE_SIZE * sizeof (gfloat)) == 0);
+
+  gegl_buffer_get (multi_buffer, NULL, 1.0, babl_format ("Y float"), mask,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  g_assert_true (memcmp (mask, expected,
+                         IMAGE_SIZE * IMAGE_SIZE * sizeof (gfloat)) == 0);
+
+  for (i = 0, n_selected = 0; i < IMAGE_SIZE * IMAGE_SIZE; i++)
+    n_selected += expected[i] != 0.0f;
+
+  g_assert_cmpint (n_selected, >, 0);
+
+  if (g_test_perf ())
+    {
+      g_test_minimized_result (single_time,
+                               "contiguous region, 1 thread: %g s",
+                               single_time);
+      g_test_minimized_result (multi_time,
+                               "contiguous region, %d threads: %g s",
+                               N_THREADS, multi_time);
+    }
+
+  g_free (mask);
+  g_free (expected);
+  g_object_unref (single_buffer);
+  g_object_unref (multi_buffer);
+  g_object_unref (image);
+}
+
+static void
+low_threshold_matches_reference (gconstpointer data)
+{
+  contiguous_region_compare (GIMP (data), LOW_THRESHOLD, FALSE);
+}
+
+static void
+low_threshold_diagonal_matches_reference (gconstpointer data)
+{
+  contiguous_region_compare (GIMP (data), LOW_THRESHOLD, TRUE);
+}
+
+static void
+high_threshold_matches_reference (gconstpointer data)
+{
+  contiguous_region_compare (GIMP (data), HIGH_THRESHOLD, FALSE);
+}
+
+static void
+high_threshold_diagonal_matches_reference (gconstpointer data)
+{
+  contiguous_region_compare (GIMP (data), HIGH_THRESHOLD, TRUE);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (low_threshold_matches_reference);
+  ADD_TEST (low_threshold_diagonal_matches_reference);
+  ADD_TEST (high_threshold_matches_reference);
+  ADD_TEST (high_threshold_diagonal_matches_reference);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
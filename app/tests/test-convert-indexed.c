@@ -0,0 +1,416 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-colormap.h"
+#include "core/gimpimage-convert-indexed.h"
+#include "core/gimplayer.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE   1024
+#define N_COLORS     64
+#define N_THREADS    4
+
+/* the L*a*b* cells and distances of the nearest color search, as in
+ * gimpimage-convert-indexed.c
+ */
+#define LOWA         (-86.181F)
+#define LOWB         (-107.858F)
+#define HIGHA        (98.237F)
+#define HIGHB        (94.480F)
+#define LRAT         (2.55F)
+#define ARAT         (255.0F / (HIGHA - LOWA))
+#define BRAT         (255.0F / (HIGHB - LOWB))
+#define R_SCALE      13
+#define G_SCALE      24
+#define B_SCALE      26
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-convert-indexed/" #function, gimp, function);
+
+
+static GimpImage *
+convert_indexed_new_image (Gimp *gimp)
+{
+  GimpImage  *image;
+  GimpLayer  *layer;
+  GeglBuffer *buffer;
+  guchar     *row;
+  gint        x, y;
+
+  image = gimp_image_new (gimp, IMAGE_SIZE, IMAGE_SIZE,
+                          GIMP_RGB, GIMP_PRECISION_U8_NON_LINEAR);
+
+  layer = gimp_layer_new (image, IMAGE_SIZE, IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Convert Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  /*  smooth ramps, which dithering has to work on, and partial alpha,
+   *  which is dithered too
+   */
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  row    = g_new (guchar, IMAGE_SIZE * 4);
+
+  for (y = 0; y < IMAGE_SIZE; y++)
+    {
+      for (x = 0; x < IMAGE_SIZE; x++)
+        {
+          row[x * 4 + 0] = x / 4;
+          row[x * 4 + 1] = y / 4;
+          row[x * 4 + 2] = (x + y) / 8;
+          row[x * 4 + 3] = 255 - ((x ^ y) & 0x7f);
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, IMAGE_SIZE, 1), 0,
+                       babl_format ("R'G'B'A u8"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+
+  return image;
+}
+
+/* converts a new image on n_threads threads  */
+static GimpImage *
+convert_indexed_run (Gimp                  *gimp,
+                     GimpConvertDitherType  dither_type,
+                     gint                   n_threads)
+{
+  GimpImage *image;
+  GError    *error = NULL;
+
+  g_object_set (gegl_config (),
+                "threads", n_threads,
+                NULL);
+
+  image = convert_indexed_new_image (gimp);
+
+  g_assert_true (gimp_image_convert_indexed (image,
+                                             GIMP_CONVERT_PALETTE_GENERATE,
+                                             N_COLORS, FALSE,
+                                             dither_type, TRUE, FALSE,
+                                             NULL, NULL, &error));
+  g_assert_no_error (error);
+
+  return image;
+}
+
+static void
+convert_indexed_assert_equal (GimpImage *image,
+                              GimpImage *expected)
+{
+  GimpLayer *layer1 = gimp_image_get_layer_iter (image)->data;
+  GimpLayer *layer2 = gimp_image_get_layer_iter (expected)->data;
+  guchar    *colormap1;
+  guchar    *colormap2;
+  guchar    *pixels1;
+  guchar    *pixels2;
+  gint       n_colors1;
+  gint       n_colors2;
+  gint       bpp;
+
+  colormap1 = _gimp_image_get_colormap (image,    &n_colors1);
+  colormap2 = _gimp_image_get_colormap (expected, &n_colors2);
+
+  g_assert_cmpint (n_colors1, ==, n_colors2);
+  g_assert_true (memcmp (colormap1, colormap2, n_colors1 * 3) == 0);
+
+  bpp = babl_format_get_bytes_per_pixel (
+    gimp_drawable_get_format (GIMP_DRAWABLE (layer2)));
+
+  pixels1 = g_malloc (IMAGE_SIZE * IMAGE_SIZE * bpp);
+  pixels2 = g_malloc (IMAGE_SIZE * IMAGE_SIZE * bpp);
+
+  /*  compare the raw indices  */
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer1)),
+                   NULL, 1.0, NULL, pixels1,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer2)),
+                   NULL, 1.0, NULL, pixels2,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert_true (memcmp (pixels1, pixels2, IMAGE_SIZE * IMAGE_SIZE * bpp) == 0);
+
+  g_free (pixels1);
+  g_free (pixels2);
+  g_free (colormap1);
+  g_free (colormap2);
+}
+
+/* converts the same image on a single thread and on several threads,
+ * and checks that the results are the same.
+ */
+static void
+convert_indexed_compare (Gimp                  *gimp,
+                         GimpConvertDitherType  dither_type)
+{
+  GimpImage *image;
+  GimpImage *expected;
+  gint       n_threads;
+
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  expected = convert_indexed_run (gimp, dither_type, 1);
+  image    = convert_indexed_run (gimp, dither_type, N_THREADS);
+
+  g_object_set (gegl_config (),
+                "threads", n_threads,
+                NULL);
+
+  convert_indexed_assert_equal (image, expected);
+
+  g_object_unref (image);
+  g_object_unref (expected);
+}
+
+/* converts @n_pixels "R'G'B'A u8" pixels to the scaled L*a*b* points
+ * the nearest colors are searched for with.
+ */
+static gint *
+convert_indexed_points (const guchar *pixels,
+                        gint          n_pixels)
+{
+  gfloat *rgb    = g_new (gfloat, n_pixels * 3);
+  gfloat *lab    = g_new (gfloat, n_pixels * 3);
+  gint   *points = g_new (gint, n_pixels * 3);
+  gint    i;
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      rgb[i * 3 + 0] = pixels[i * 4 + 0] / 255.0;
+      rgb[i * 3 + 1] = pixels[i * 4 + 1] / 255.0;
+      rgb[i * 3 + 2] = pixels[i * 4 + 2] / 255.0;
+    }
+
+  babl_process (babl_fish (babl_format ("R'G'B' float"),
+                           babl_format ("CIE Lab float")),
+                rgb, lab, n_pixels);
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      gint l = RINT (lab[i * 3 + 0] * LRAT);
+      gint a = RINT ((lab[i * 3 + 1] - LOWA) * ARAT);
+      gint b = RINT ((lab[i * 3 + 2] - LOWB) * BRAT);
+
+      points[i * 3 + 0] = CLAMP (l, 0, 255) * R_SCALE;
+      points[i * 3 + 1] = CLAMP (a, 0, 255) * G_SCALE;
+      points[i * 3 + 2] = CLAMP (b, 0, 255) * B_SCALE;
+    }
+
+  g_free (rgb);
+  g_free (lab);
+
+  return points;
+}
+
+static gint
+convert_indexed_distance (const gint *point1,
+                          const gint *point2)
+{
+  gint dist = 0;
+  gint c;
+
+  for (c = 0; c < 3; c++)
+    dist += (point1[c] - point2[c]) * (point1[c] - point2[c]);
+
+  return dist;
+}
+
+/**
+ * no_dither_matches_reference:
+ * @data:
+ *
+ * Without dithering, every pixel is mapped to a colormap entry nearest
+ * to it, which is checked against a search through the whole colormap.
+ **/
+static void
+no_dither_matches_reference (gconstpointer data)
+{
+  Gimp       *gimp = GIMP (data);
+  GimpImage  *image;
+  GimpLayer  *layer;
+  GError     *error = NULL;
+  guchar     *colormap;
+  guchar     *pixels;
+  guchar     *indices;
+  gint       *points;
+  gint       *cmap_points;
+  gint        n_colors;
+  gint        n_threads;
+  gint        i, j;
+
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+  g_object_set (gegl_config (),
+                "threads", N_THREADS,
+                NULL);
+
+  image = convert_indexed_new_image (gimp);
+  layer = gimp_image_get_layer_iter (image)->data;
+
+  pixels = g_new (guchar, IMAGE_SIZE * IMAGE_SIZE * 4);
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                   NULL, 1.0, babl_format ("R'G'B'A u8"), pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert_true (gimp_image_convert_indexed (image,
+                                             GIMP_CONVERT_PALETTE_GENERATE,
+                                             N_COLORS, FALSE,
+                                             GIMP_CONVERT_DITHER_NONE,
+                                             FALSE, FALSE,
+                                             NULL, NULL, &error));
+  g_assert_no_error (error);
+
+  g_object_set (gegl_config (),
+                "threads", n_threads,
+                NULL);
+
+  layer    = gimp_image_get_layer_iter (image)->data;
+  colormap = _gimp_image_get_colormap (image, &n_colors);
+
+  /*  the index and alpha of every pixel  */
+  indices = g_new (guchar, IMAGE_SIZE * IMAGE_SIZE * 2);
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                   NULL, 1.0, NULL, indices,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  points = convert_indexed_points (pixels, IMAGE_SIZE * IMAGE_SIZE);
+
+  /*  the colormap's points, from its entries as opaque pixels  */
+  {
+    guchar *cmap_pixels = g_new (guchar, n_colors * 4);
+
+    for (i = 0; i < n_colors; i++)
+      {
+        cmap_pixels[i * 4 + 0] = colormap[i * 3 + 0];
+        cmap_pixels[i * 4 + 1] = colormap[i * 3 + 1];
+        cmap_pixels[i * 4 + 2] = colormap[i * 3 + 2];
+        cmap_pixels[i * 4 + 3] = 255;
+      }
+
+    cmap_points = convert_indexed_points (cmap_pixels, n_colors);
+
+    g_free (cmap_pixels);
+  }
+
+  for (i = 0; i < IMAGE_SIZE * IMAGE_SIZE; i++)
+    {
+      gint index = indices[i * 2 + 0];
+      gint best  = G_MAXINT;
+
+      /*  transparent pixels keep whatever index  */
+      if (indices[i * 2 + 1] == 0)
+        continue;
+
+      g_assert_cmpint (index, <, n_colors);
+
+      for (j = 0; j < n_colors; j++)
+        {
+          best = MIN (best, convert_indexed_distance (&points[i * 3],
+                                                      &cmap_points[j * 3]));
+        }
+
+      g_assert_cmpint (convert_indexed_distance (&points[i * 3],
+                                                 &cmap_points[index * 3]),
+                       ==, best);
+    }
+
+  g_free (cmap_points);
+  g_free (points);
+  g_free (indices);
+  g_free (pixels);
+  g_free (colormap);
+  g_object_unref (image);
+}
+
+static void
+no_dither_matches_single_thread (gconstpointer data)
+{
+  convert_indexed_compare (GIMP (data), GIMP_CONVERT_DITHER_NONE);
+}
+
+static void
+fixed_dither_matches_single_thread (gconstpointer data)
+{
+  convert_indexed_compare (GIMP (data), GIMP_CONVERT_DITHER_FIXED);
+}
+
+static void
+fs_dither_matches_single_thread (gconstpointer data)
+{
+  convert_indexed_compare (GIMP (data), GIMP_CONVERT_DITHER_FS);
+}
+
+static void
+fs_lowbleed_dither_matches_single_thread (gconstpointer data)
+{
+  convert_indexed_compare (GIMP (data), GIMP_CONVERT_DITHER_FS_LOWBLEED);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (no_dither_matches_reference);
+  ADD_TEST (no_dither_matches_single_thread);
+  ADD_TEST (fixed_dither_matches_single_thread);
+  ADD_TEST (fs_dither_matches_single_thread);
+  ADD_TEST (fs_lowbleed_dither_matches_single_thread);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
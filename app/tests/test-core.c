@@ -15,6 +15,8 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
@@ -23,10 +25,16 @@
 #include "widgets/gimpuimanager.h"
 
 #include "core/gimp.h"
+#include "core/gimpasync.h"
 #include "core/gimpcontext.h"
+#include "core/gimpdrawableundo.h"
 #include "core/gimpimage.h"
+#include "core/gimpimage-undo.h"
 #include "core/gimplayer.h"
 #include "core/gimplayer-new.h"
+#include "core/gimpundojournal.h"
+#include "core/gimpundostack.h"
+#include "core/gimpwaitable.h"
 
 #include "operations/gimplevelsconfig.h"
 
@@ -36,6 +44,7 @@
 
 
 #define GIMP_TEST_IMAGE_SIZE 100
+#define GIMP_TEST_UNDO_SIZE  1024
 
 #define ADD_IMAGE_TEST(function) \
   g_test_add ("/gimp-core/" #function, \
@@ -263,6 +272,396 @@ white_graypoint_in_red_levels (GimpTestFixture *fixture,
   g_clear_object (&white);
 }
 
+/**
+ * drawable_undo_check:
+ * @fixture:
+ * @evict:
+ *
+ * Pushes an undo for a large layer, changes a small part of the layer,
+ * and makes sure the undo only keeps the changed tile, optionally
+ * evicts it to an undo journal, and still restores the layer
+ * correctly when undone and redone.  With @truncate, the journal is
+ * cut short before undoing, which must leave the image and the undo
+ * intact until the journal is restored.
+ **/
+static void
+drawable_undo_check (GimpTestFixture *fixture,
+                     gboolean         evict,
+                     gboolean         truncate)
+{
+  GimpImage        *image   = fixture->image;
+  const Babl       *format  = babl_format ("R'G'B'A u8");
+  GeglColor        *color   = gegl_color_new ("rgba(0.2, 0.4, 0.6, 1.0)");
+  GeglColor        *paint   = gegl_color_new ("rgba(1.0, 0.0, 0.0, 1.0)");
+  GimpUndoJournal  *journal   = NULL;
+  GFile            *directory = NULL;
+  GFile            *file      = NULL;
+  gchar            *contents  = NULL;
+  gsize             length    = 0;
+  GimpLayer        *layer;
+  GimpDrawable     *drawable;
+  GimpDrawableUndo *undo;
+  guchar            before[4];
+  guchar            after[4];
+  guchar            pixel[4];
+  gint64            full_size;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_UNDO_SIZE,
+                          GIMP_TEST_UNDO_SIZE,
+                          format,
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image, layer, GIMP_IMAGE_ACTIVE_PARENT, 0, FALSE);
+
+  drawable = GIMP_DRAWABLE (layer);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable), NULL, color);
+
+  gimp_drawable_push_undo (drawable, "Test",
+                           NULL, 0, 0,
+                           GIMP_TEST_UNDO_SIZE, GIMP_TEST_UNDO_SIZE);
+
+  gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                   GEGL_RECTANGLE (15, 15, 1, 1), 1.0, format, before,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (10, 10, 20, 20), paint);
+  gimp_drawable_update (drawable, 10, 10, 20, 20);
+
+  gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                   GEGL_RECTANGLE (15, 15, 1, 1), 1.0, format, after,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  undo = GIMP_DRAWABLE_UNDO (
+    gimp_undo_stack_peek (gimp_image_get_undo_stack (image)));
+
+  full_size = gimp_object_get_memsize (GIMP_OBJECT (undo), NULL);
+
+  while (! undo->compress_async)
+    g_main_context_iteration (NULL, TRUE);
+
+  gimp_waitable_wait (GIMP_WAITABLE (undo->compress_async));
+
+  /* a single changed tile out of many */
+  g_assert_cmpint (undo->tiles->len, ==, 1);
+  g_assert_cmpint (gimp_object_get_memsize (GIMP_OBJECT (undo), NULL),
+                   <, full_size / 16);
+
+  if (evict)
+    {
+      gchar  *path;
+      GError *error = NULL;
+      gint64  size;
+
+      /* a folder of its own, so the journal's file can be found  */
+      path = g_dir_make_tmp ("gimp-test-XXXXXX", &error);
+      g_assert_no_error (error);
+
+      directory = g_file_new_for_path (path);
+
+      journal = gimp_undo_journal_new (directory, &error);
+      g_assert_no_error (error);
+
+      size = gimp_object_get_memsize (GIMP_OBJECT (undo), NULL);
+
+      g_assert_cmpint (gimp_undo_evict (GIMP_UNDO (undo), journal), >, 0);
+      g_assert_cmpint (gimp_object_get_memsize (GIMP_OBJECT (undo), NULL),
+                       <, size);
+
+      /* nothing left to evict */
+      g_assert_cmpint (gimp_undo_evict (GIMP_UNDO (undo), journal), ==, 0);
+
+      if (truncate)
+        {
+          GDir *dir = g_dir_open (path, 0, &error);
+
+          g_assert_no_error (error);
+
+          file = g_file_get_child (directory, g_dir_read_name (dir));
+          g_assert_null (g_dir_read_name (dir));
+
+          g_file_load_contents (file, NULL, &contents, &length, NULL,
+                                &error);
+          g_assert_no_error (error);
+          g_assert_cmpuint (length, >, 0);
+
+          g_dir_close (dir);
+        }
+
+      g_free (path);
+    }
+
+  if (truncate)
+    {
+      GFileIOStream *stream;
+      GError        *error = NULL;
+
+      stream = g_file_open_readwrite (file, NULL, &error);
+      g_assert_no_error (error);
+
+      g_seekable_truncate (G_SEEKABLE (stream), length / 2, NULL, &error);
+      g_assert_no_error (error);
+
+      g_assert_false (gimp_image_undo (image));
+
+      /* the layer is untouched, and the undo still there  */
+      gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                       GEGL_RECTANGLE (15, 15, 1, 1), 1.0, format, pixel,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      g_assert_cmpmem (pixel, sizeof (pixel), after, sizeof (after));
+
+      g_assert_true (gimp_undo_stack_peek (gimp_image_get_undo_stack (image)) ==
+                     GIMP_UNDO (undo));
+
+      g_seekable_seek (G_SEEKABLE (stream), 0, G_SEEK_SET, NULL, &error);
+      g_assert_no_error (error);
+
+      g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (stream)),
+                                 contents, length, NULL, NULL, &error);
+      g_assert_no_error (error);
+
+      g_io_stream_close (G_IO_STREAM (stream), NULL, NULL);
+      g_object_unref (stream);
+      g_free (contents);
+    }
+
+  g_assert_true (gimp_image_undo (image));
+
+  gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                   GEGL_RECTANGLE (15, 15, 1, 1), 1.0, format, pixel,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  g_assert_cmpmem (pixel, sizeof (pixel), before, sizeof (before));
+
+  gimp_image_redo (image);
+
+  gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                   GEGL_RECTANGLE (15, 15, 1, 1), 1.0, format, pixel,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  g_assert_cmpmem (pixel, sizeof (pixel), after, sizeof (after));
+
+  if (journal)
+    gimp_undo_journal_unref (journal);
+
+  if (directory)
+    {
+      g_file_delete (directory, NULL, NULL);
+      g_object_unref (directory);
+    }
+
+  g_clear_object (&file);
+
+  g_object_unref (color);
+  g_object_unref (paint);
+}
+
+/**
+ * drawable_undo_compression:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure a drawable undo only keeps the tiles which changed.
+ **/
+static void
+drawable_undo_compression (GimpTestFixture *fixture,
+                           gconstpointer    data)
+{
+  drawable_undo_check (fixture, FALSE, FALSE);
+}
+
+/**
+ * drawable_undo_journal:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure a drawable undo can be evicted to an undo journal, and
+ * read back from it.
+ **/
+static void
+drawable_undo_journal (GimpTestFixture *fixture,
+                       gconstpointer    data)
+{
+  drawable_undo_check (fixture, TRUE, FALSE);
+}
+
+/**
+ * drawable_undo_journal_read_error:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure a drawable undo whose journal can't be read back fails
+ * without losing any pixels, and can be undone once the journal is
+ * readable again.
+ **/
+static void
+drawable_undo_journal_read_error (GimpTestFixture *fixture,
+                                  gconstpointer    data)
+{
+  drawable_undo_check (fixture, TRUE, TRUE);
+}
+
+/**
+ * drawable_undo_unshared_tiles:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure the tiles a drawable undo shares with the drawable are
+ * counted in its size once the drawable changes them.
+ **/
+static void
+drawable_undo_unshared_tiles (GimpTestFixture *fixture,
+                              gconstpointer    data)
+{
+  GimpImage        *image  = fixture->image;
+  const Babl       *format = babl_format ("R'G'B'A u8");
+  GeglColor        *color  = gegl_color_new ("rgba(0.2, 0.4, 0.6, 1.0)");
+  GeglColor        *paint  = gegl_color_new ("rgba(1.0, 0.0, 0.0, 1.0)");
+  GimpLayer        *layer;
+  GimpDrawable     *drawable;
+  GimpDrawableUndo *undo;
+  gint64            full_size;
+  gint64            size;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_UNDO_SIZE,
+                          GIMP_TEST_UNDO_SIZE,
+                          format,
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image, layer, GIMP_IMAGE_ACTIVE_PARENT, 0, FALSE);
+
+  drawable = GIMP_DRAWABLE (layer);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable), NULL, color);
+
+  gimp_drawable_push_undo (drawable, "Test",
+                           NULL, 0, 0,
+                           GIMP_TEST_UNDO_SIZE, GIMP_TEST_UNDO_SIZE);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (10, 10, 20, 20), paint);
+
+  undo = GIMP_DRAWABLE_UNDO (
+    gimp_undo_stack_peek (gimp_image_get_undo_stack (image)));
+
+  full_size = gimp_object_get_memsize (GIMP_OBJECT (undo), NULL);
+
+  while (! undo->compress_async)
+    g_main_context_iteration (NULL, TRUE);
+
+  gimp_waitable_wait (GIMP_WAITABLE (undo->compress_async));
+
+  g_assert_cmpint (gimp_object_get_memsize (GIMP_OBJECT (undo), NULL),
+                   <, full_size / 16);
+
+  /* the top half of the tiles now belong to the undo alone */
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (0, 0,
+                                         GIMP_TEST_UNDO_SIZE,
+                                         GIMP_TEST_UNDO_SIZE / 2),
+                         paint);
+
+  size = gimp_object_get_memsize (GIMP_OBJECT (undo), NULL);
+  g_assert_cmpint (size, >, full_size / 4);
+  g_assert_cmpint (size, <, full_size * 3 / 4);
+
+  /* and then all of them */
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (0, GIMP_TEST_UNDO_SIZE / 2,
+                                         GIMP_TEST_UNDO_SIZE,
+                                         GIMP_TEST_UNDO_SIZE / 2),
+                         paint);
+
+  size = gimp_object_get_memsize (GIMP_OBJECT (undo), NULL);
+  g_assert_cmpint (size, >, full_size * 3 / 4);
+
+  g_object_unref (color);
+  g_object_unref (paint);
+}
+
+/**
+ * undo_journal_reuse:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure released journal records are written over by later
+ * ones, and that the journal shrinks when its last records are
+ * released.
+ **/
+static void
+undo_journal_reuse (GimpTestFixture *fixture,
+                    gconstpointer    data)
+{
+  GFile           *directory = g_file_new_for_path (g_get_tmp_dir ());
+  GimpUndoJournal *journal;
+  GError          *error     = NULL;
+  guchar           record[100];
+  guchar           buf[100];
+  goffset          offsets[3];
+  goffset          offset;
+  gint             i;
+
+  journal = gimp_undo_journal_new (directory, &error);
+  g_assert_no_error (error);
+
+  for (i = 0; i < 3; i++)
+    {
+      memset (record, i, sizeof (record));
+
+      g_assert_true (gimp_undo_journal_append (journal,
+                                               record, sizeof (record),
+                                               &offsets[i], &error));
+      g_assert_no_error (error);
+    }
+
+  g_assert_cmpint (gimp_undo_journal_get_size (journal), ==,
+                   3 * sizeof (record));
+
+  /* a smaller record goes into the released one in the middle  */
+  gimp_undo_journal_release (journal, offsets[1], sizeof (record));
+
+  memset (record, 3, sizeof (record));
+
+  g_assert_true (gimp_undo_journal_append (journal, record, 60,
+                                           &offset, &error));
+  g_assert_cmpint (offset, ==, offsets[1]);
+  g_assert_cmpint (gimp_undo_journal_get_size (journal), ==,
+                   3 * sizeof (record));
+
+  /* a bigger one doesn't fit into what's left of it  */
+  g_assert_true (gimp_undo_journal_append (journal, record, 50,
+                                           &offset, &error));
+  g_assert_cmpint (offset, ==, 3 * sizeof (record));
+
+  g_assert_true (gimp_undo_journal_read (journal, offsets[2],
+                                         buf, sizeof (buf), &error));
+  memset (record, 2, sizeof (record));
+  g_assert_cmpmem (buf, sizeof (buf), record, sizeof (record));
+
+  /* releasing the records at the end shrinks the journal, down to
+   * the last record still in use
+   */
+  gimp_undo_journal_release (journal, offset, 50);
+  g_assert_cmpint (gimp_undo_journal_get_size (journal), ==,
+                   3 * sizeof (record));
+
+  gimp_undo_journal_release (journal, offsets[2], sizeof (record));
+  g_assert_cmpint (gimp_undo_journal_get_size (journal), ==,
+                   offsets[1] + 60);
+
+  gimp_undo_journal_release (journal, offsets[1], 60);
+  gimp_undo_journal_release (journal, offsets[0], sizeof (record));
+  g_assert_cmpint (gimp_undo_journal_get_size (journal), ==, 0);
+
+  gimp_undo_journal_unref (journal);
+  g_object_unref (directory);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -282,6 +681,11 @@ main (int    argc,
   ADD_IMAGE_TEST (add_layer);
   ADD_IMAGE_TEST (remove_layer);
   ADD_IMAGE_TEST (rotate_non_overlapping);
+  ADD_IMAGE_TEST (drawable_undo_compression);
+  ADD_IMAGE_TEST (drawable_undo_journal);
+  ADD_IMAGE_TEST (drawable_undo_journal_read_error);
+  ADD_IMAGE_TEST (drawable_undo_unshared_tiles);
+  ADD_TEST (undo_journal_reuse);
   ADD_TEST (white_graypoint_in_red_levels);
 
   /* Run the tests */
@@ -0,0 +1,375 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpwidgets/gimpwidgets.h"
+
+#include "display/display-types.h"
+
+#include "display/gimpdisplay.h"
+#include "display/gimpdisplayshell.h"
+#include "display/gimpdisplayshell-draw.h"
+#include "display/gimpdisplayshell-render.h"
+#include "display/gimpdisplayshell-scale.h"
+#include "display/gimpdisplayshell-scroll.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimpprojection.h"
+
+#include "gimpcoreapp.h"
+
+#include "gimp-app-test-utils.h"
+#include "tests.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-display-render/" #function, gimp, function);
+
+#define IMAGE_SIZE  4096
+#define PAN_STEPS   16
+#define PAN_X       48
+#define PAN_Y       24
+
+
+static const gdouble zoom_levels[] = { 1.0, 0.5, 0.25, 2.0, 0.125, 1.0 };
+
+
+static GimpDisplayShell *
+get_only_shell (Gimp *gimp)
+{
+  GList *iter = gimp_get_display_iter (gimp);
+
+  g_assert_true (g_list_length (iter) == 1);
+
+  return gimp_display_get_shell (GIMP_DISPLAY (iter->data));
+}
+
+static GimpImage *
+get_only_image (Gimp *gimp)
+{
+  GList *iter = gimp_get_image_iter (gimp);
+
+  g_assert_true (g_list_length (iter) == 1);
+
+  return GIMP_IMAGE (iter->data);
+}
+
+/* waits until the projection is rendered, and the display received all
+ * its updates.
+ */
+static void
+display_render_flush (GimpImage *image)
+{
+  gimp_test_run_mainloop_until_idle ();
+
+  gimp_projection_finish_draw (gimp_image_get_projection (image));
+
+  gimp_test_run_mainloop_until_idle ();
+}
+
+static void
+display_render_fill (GimpImage *image)
+{
+  GimpLayer  *layer  = GIMP_LAYER (gimp_image_get_layer_iter (image)->data);
+  GeglBuffer *buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  guchar     *row;
+  gint        x, y;
+
+  /*  fill the layer with something which doesn't compress into uniform
+   *  tiles, so each rendered tile costs the same
+   */
+  row = g_new (guchar, IMAGE_SIZE * 4);
+
+  for (y = 0; y < IMAGE_SIZE; y++)
+    {
+      for (x = 0; x < IMAGE_SIZE; x++)
+        {
+          row[x * 4 + 0] = x;
+          row[x * 4 + 1] = y;
+          row[x * 4 + 2] = x ^ y;
+          row[x * 4 + 3] = 255 - ((x + y) & 0x3f);
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, IMAGE_SIZE, 1), 0,
+                       babl_format ("R'G'B'A u8"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+
+  gimp_drawable_update (GIMP_DRAWABLE (layer), 0, 0, IMAGE_SIZE, IMAGE_SIZE);
+
+  display_render_flush (image);
+}
+
+/* draws the whole view, the way the canvas' draw handler does, and
+ * returns the time it took, in seconds.
+ */
+static gdouble
+display_render_frame (GimpDisplayShell  *shell,
+                      cairo_surface_t  **surface)
+{
+  cairo_t *cr;
+  gint64   start;
+  gint64   end;
+
+  if (*surface &&
+      (cairo_image_surface_get_width  (*surface) != shell->disp_width ||
+       cairo_image_surface_get_height (*surface) != shell->disp_height))
+    {
+      g_clear_pointer (surface, cairo_surface_destroy);
+    }
+
+  if (! *surface)
+    *surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                           shell->disp_width,
+                                           shell->disp_height);
+
+  cr = cairo_create (*surface);
+
+  start = g_get_monotonic_time ();
+
+  gimp_display_shell_draw_image (shell, cr,
+                                 0, 0, shell->disp_width, shell->disp_height);
+  cairo_surface_flush (*surface);
+
+  end = g_get_monotonic_time ();
+
+  cairo_destroy (cr);
+
+  return (end - start) / (gdouble) G_TIME_SPAN_SECOND;
+}
+
+static void
+display_render_assert_equal (cairo_surface_t *surface,
+                             cairo_surface_t *expected)
+{
+  gint width  = cairo_image_surface_get_width  (expected);
+  gint height = cairo_image_surface_get_height (expected);
+  gint y;
+
+  g_assert_cmpint (cairo_image_surface_get_width  (surface), ==, width);
+  g_assert_cmpint (cairo_image_surface_get_height (surface), ==, height);
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *row1 = cairo_image_surface_get_data (surface) +
+                           y * cairo_image_surface_get_stride (surface);
+      const guchar *row2 = cairo_image_surface_get_data (expected) +
+                           y * cairo_image_surface_get_stride (expected);
+
+      g_assert_true (memcmp (row1, row2, width * 4) == 0);
+    }
+}
+
+/**
+ * cached_tiles_match_fresh_render:
+ * @data:
+ *
+ * Test that drawing a view from the cached display tiles, also after
+ * part of the image was changed, gives the same pixels as rendering it
+ * from scratch.
+ **/
+static void
+cached_tiles_match_fresh_render (gconstpointer data)
+{
+  Gimp             *gimp = GIMP (data);
+  GimpDisplayShell *shell;
+  GimpImage        *image;
+  GimpLayer        *layer;
+  GeglColor        *color;
+  gint              i;
+
+  gimp_test_utils_create_image (gimp, IMAGE_SIZE, IMAGE_SIZE);
+  gimp_test_run_mainloop_until_idle ();
+
+  shell = get_only_shell (gimp);
+  image = get_only_image (gimp);
+  layer = GIMP_LAYER (gimp_image_get_layer_iter (image)->data);
+
+  display_render_fill (image);
+
+  color = gegl_color_new ("rgba(0.2, 0.4, 0.8, 0.6)");
+
+  for (i = 0; i < G_N_ELEMENTS (zoom_levels); i++)
+    {
+      cairo_surface_t *cached   = NULL;
+      cairo_surface_t *expected = NULL;
+      GeglRectangle    rect;
+
+      gimp_display_shell_scale (shell, GIMP_ZOOM_TO, zoom_levels[i],
+                                GIMP_ZOOM_FOCUS_IMAGE_CENTER);
+      gimp_test_run_mainloop_until_idle ();
+
+      /*  render the tiles, then draw the view again from them  */
+      display_render_frame (shell, &cached);
+      gimp_display_shell_render_invalidate_view (shell);
+      display_render_frame (shell, &cached);
+
+      gimp_display_shell_render_invalidate_full (shell);
+      display_render_frame (shell, &expected);
+
+      display_render_assert_equal (cached, expected);
+
+      /*  change an odd-sized area in the middle of the view, which
+       *  must drop the affected tiles only
+       */
+      rect.x      = IMAGE_SIZE / 2 - 37 * (i + 1);
+      rect.y      = IMAGE_SIZE / 2 - 29 * (i + 1);
+      rect.width  = 61 * (i + 1);
+      rect.height = 43 * (i + 1);
+
+      gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                             &rect, color);
+      gimp_drawable_update (GIMP_DRAWABLE (layer),
+                            rect.x, rect.y, rect.width, rect.height);
+
+      display_render_flush (image);
+
+      gimp_display_shell_render_invalidate_view (shell);
+      display_render_frame (shell, &cached);
+
+      gimp_display_shell_render_invalidate_full (shell);
+      display_render_frame (shell, &expected);
+
+      display_render_assert_equal (cached, expected);
+
+      cairo_surface_destroy (cached);
+      cairo_surface_destroy (expected);
+    }
+
+  g_object_unref (color);
+
+  gimp_display_delete (gimp_get_display_iter (gimp)->data);
+  gimp_test_run_mainloop_until_idle ();
+}
+
+/**
+ * pan_zoom_matches_fresh_render:
+ * @data:
+ *
+ * Pans back and forth across the image at several zoom levels, the way
+ * scrolling the canvas does, and makes sure the view drawn from the
+ * cached display tiles after panning back is the same as rendering it
+ * from scratch.  With -m perf, the time it takes to draw each panned
+ * frame is reported.
+ **/
+static void
+pan_zoom_matches_fresh_render (gconstpointer data)
+{
+  Gimp             *gimp     = GIMP (data);
+  GimpDisplayShell *shell;
+  GimpImage        *image;
+  gdouble           total    = 0.0;
+  gdouble           max      = 0.0;
+  gint              n_frames = 0;
+  gint              i;
+
+  gimp_test_utils_create_image (gimp, IMAGE_SIZE, IMAGE_SIZE);
+  gimp_test_run_mainloop_until_idle ();
+
+  shell = get_only_shell (gimp);
+  image = get_only_image (gimp);
+
+  display_render_fill (image);
+
+  for (i = 0; i < G_N_ELEMENTS (zoom_levels); i++)
+    {
+      cairo_surface_t *surface  = NULL;
+      cairo_surface_t *expected = NULL;
+      gint             step;
+
+      gimp_display_shell_scale (shell, GIMP_ZOOM_TO, zoom_levels[i],
+                                GIMP_ZOOM_FOCUS_IMAGE_CENTER);
+
+      display_render_frame (shell, &surface);
+
+      /*  pan away, and back over the area drawn before  */
+      for (step = 0; step < 2 * PAN_STEPS; step++)
+        {
+          gdouble time;
+
+          if (step < PAN_STEPS)
+            gimp_display_shell_scroll (shell,  PAN_X,  PAN_Y);
+          else
+            gimp_display_shell_scroll (shell, -PAN_X, -PAN_Y);
+
+          time = display_render_frame (shell, &surface);
+
+          total += time;
+          max    = MAX (max, time);
+          n_frames++;
+        }
+
+      gimp_display_shell_render_invalidate_full (shell);
+      display_render_frame (shell, &expected);
+
+      display_render_assert_equal (surface, expected);
+
+      cairo_surface_destroy (surface);
+      cairo_surface_destroy (expected);
+    }
+
+  if (g_test_perf ())
+    {
+      g_test_minimized_result (total / n_frames,
+                               "pan/zoom frame time: %g s",
+                               total / n_frames);
+      g_test_minimized_result (max,
+                               "slowest pan/zoom frame: %g s",
+                               max);
+    }
+
+  gimp_display_delete (gimp_get_display_iter (gimp)->data);
+  gimp_test_run_mainloop_until_idle ();
+}
+
+int main(int argc, char **argv)
+{
+  Gimp *gimp   = NULL;
+  gint  result = -1;
+
+  gimp_test_bail_if_no_display ();
+  gtk_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_setup_menus_path ();
+
+  /* Start up GIMP */
+  gimp = gimp_init_for_gui_testing (TRUE /*show_gui*/);
+  gimp_test_run_mainloop_until_idle ();
+
+  ADD_TEST (cached_tiles_match_fresh_render);
+  ADD_TEST (pan_zoom_matches_fresh_render);
+
+  /* Run the tests and return status */
+  g_application_run (gimp->app, 0, NULL);
+  result = gimp_core_app_get_exit_status (GIMP_CORE_APP (gimp->app));
+
+  g_application_quit (G_APPLICATION (gimp->app));
+  g_clear_object (&gimp->app);
+
+  return result;
+}
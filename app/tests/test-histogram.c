@@ -0,0 +1,314 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "gegl/gimp-gegl-utils.h"
+
+#include "core/gimp.h"
+#include "core/gimpchannel.h"
+#include "core/gimpchannel-select.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpdrawable-histogram.h"
+#include "core/gimphistogram.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE   1024
+#define DAB_SIZE     48
+#define N_DABS       64
+#define N_STROKES    2
+
+
+typedef struct
+{
+  GimpImage *image;
+  GimpLayer *layer;
+} HistogramFixture;
+
+
+#define ADD_IMAGE_TEST(function) \
+  g_test_add ("/gimp-histogram/" #function, \
+              HistogramFixture, \
+              gimp, \
+              histogram_setup, \
+              function, \
+              histogram_teardown)
+
+
+static void histogram_setup                 (HistogramFixture *fixture,
+                                             gconstpointer     data);
+static void histogram_teardown              (HistogramFixture *fixture,
+                                             gconstpointer     data);
+
+static void histogram_paint_dab             (HistogramFixture *fixture,
+                                             gint              dab,
+                                             GeglColor        *color,
+                                             GeglRectangle    *rect);
+static void histogram_assert_equal          (GimpHistogram    *histogram,
+                                             GimpHistogram    *expected);
+static void histogram_run_strokes           (HistogramFixture *fixture);
+
+static void test_histogram_update           (HistogramFixture *fixture,
+                                             gconstpointer     data);
+static void test_histogram_update_selection (HistogramFixture *fixture,
+                                             gconstpointer     data);
+
+
+static void
+histogram_setup (HistogramFixture *fixture,
+                 gconstpointer     data)
+{
+  Gimp       *gimp = GIMP (data);
+  GeglBuffer *buffer;
+  guchar     *row;
+  gint        x, y;
+
+  fixture->image = gimp_image_new (gimp,
+                                   IMAGE_SIZE,
+                                   IMAGE_SIZE,
+                                   GIMP_RGB,
+                                   GIMP_PRECISION_U8_NON_LINEAR);
+
+  fixture->layer = gimp_layer_new (fixture->image,
+                                   IMAGE_SIZE,
+                                   IMAGE_SIZE,
+                                   babl_format ("R'G'B'A u8"),
+                                   "Histogram Layer",
+                                   GIMP_OPACITY_OPAQUE,
+                                   GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (fixture->image, fixture->layer, NULL, 0, FALSE);
+
+  /*  fill the layer with ramps, so all bins are populated  */
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (fixture->layer));
+  row    = g_new (guchar, IMAGE_SIZE * 4);
+
+  for (y = 0; y < IMAGE_SIZE; y++)
+    {
+      for (x = 0; x < IMAGE_SIZE; x++)
+        {
+          row[x * 4 + 0] = x;
+          row[x * 4 + 1] = y;
+          row[x * 4 + 2] = x + y;
+          row[x * 4 + 3] = 255 - ((x ^ y) & 0x7f);
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, IMAGE_SIZE, 1), 0,
+                       babl_format ("R'G'B'A u8"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+}
+
+static void
+histogram_teardown (HistogramFixture *fixture,
+                    gconstpointer     data)
+{
+  g_clear_object (&fixture->image);
+}
+
+/* paints a dab of a stroke going diagonally across the layer, the way
+ * the paint core updates the drawable.
+ */
+static void
+histogram_paint_dab (HistogramFixture *fixture,
+                     gint              dab,
+                     GeglColor        *color,
+                     GeglRectangle    *rect)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (fixture->layer);
+
+  rect->x      = dab * (IMAGE_SIZE - DAB_SIZE) / (N_DABS - 1);
+  rect->y      = rect->x / 2 + DAB_SIZE;
+  rect->width  = DAB_SIZE;
+  rect->height = DAB_SIZE;
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable), rect, color);
+
+  gimp_drawable_update (drawable,
+                        rect->x, rect->y, rect->width, rect->height);
+}
+
+static void
+histogram_assert_equal (GimpHistogram *histogram,
+                        GimpHistogram *expected)
+{
+  const GimpHistogramChannel channels[] =
+    {
+      GIMP_HISTOGRAM_VALUE,
+      GIMP_HISTOGRAM_RED,
+      GIMP_HISTOGRAM_GREEN,
+      GIMP_HISTOGRAM_BLUE,
+      GIMP_HISTOGRAM_ALPHA,
+      GIMP_HISTOGRAM_LUMINANCE
+    };
+  gint n_bins = gimp_histogram_n_bins (expected);
+  gint i;
+  gint bin;
+
+  g_assert_cmpint (gimp_histogram_n_bins (histogram), ==, n_bins);
+  g_assert_cmpint (gimp_histogram_n_components (histogram), ==,
+                   gimp_histogram_n_components (expected));
+
+  for (i = 0; i < G_N_ELEMENTS (channels); i++)
+    {
+      for (bin = 0; bin < n_bins; bin++)
+        {
+          gdouble value  = gimp_histogram_get_value (histogram,
+                                                     channels[i], bin);
+          gdouble result = gimp_histogram_get_value (expected,
+                                                     channels[i], bin);
+
+          /*  the weights are summed in a different order  */
+          g_assert_cmpfloat_with_epsilon (value, result,
+                                          1e-6 * MAX (result, 1.0));
+        }
+    }
+}
+
+/* paints strokes, updating one histogram incrementally after every dab,
+ * and calculating another one from scratch after every stroke, and
+ * checks that they match.  with -m perf, the time both take is
+ * reported.
+ */
+static void
+histogram_run_strokes (HistogramFixture *fixture)
+{
+  GimpDrawable  *drawable    = GIMP_DRAWABLE (fixture->layer);
+  GimpHistogram *histogram   = gimp_histogram_new (GIMP_TRC_NON_LINEAR);
+  GimpHistogram *expected    = gimp_histogram_new (GIMP_TRC_NON_LINEAR);
+  GeglColor     *colors[2];
+  GeglBuffer    *snapshot;
+  GTimer        *timer       = g_timer_new ();
+  gdouble        update_time = 0.0;
+  gdouble        full_time   = 0.0;
+  gint           stroke;
+
+  colors[0] = gegl_color_new ("rgba(1.0, 0.5, 0.25, 0.75)");
+  colors[1] = gegl_color_new ("rgba(0.1, 0.2, 0.9, 1.0)");
+
+  gimp_drawable_calculate_histogram (drawable, histogram, FALSE);
+
+  snapshot = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  for (stroke = 0; stroke < N_STROKES; stroke++)
+    {
+      GeglRectangle rect;
+      gint          dab;
+
+      /*  apply every dab on its own, the histogram dialog merges the
+       *  updates until painting pauses, so this is its worst case.
+       */
+      for (dab = 0; dab < N_DABS; dab++)
+        {
+          histogram_paint_dab (fixture, dab, colors[stroke % 2], &rect);
+
+          g_timer_start (timer);
+
+          g_assert_true (gimp_drawable_update_histogram (drawable, histogram,
+                                                         snapshot, &rect));
+
+          update_time += g_timer_elapsed (timer, NULL);
+        }
+
+      g_timer_start (timer);
+
+      gimp_drawable_calculate_histogram (drawable, expected, FALSE);
+
+      full_time += g_timer_elapsed (timer, NULL);
+
+      histogram_assert_equal (histogram, expected);
+    }
+
+  if (g_test_perf ())
+    {
+      g_test_minimized_result (update_time / N_STROKES,
+                               "incremental update per stroke: %g s",
+                               update_time / N_STROKES);
+      g_test_minimized_result (full_time / N_STROKES,
+                               "full recalculation per stroke: %g s",
+                               full_time / N_STROKES);
+    }
+
+  g_object_unref (colors[0]);
+  g_object_unref (colors[1]);
+  g_object_unref (snapshot);
+  g_object_unref (histogram);
+  g_object_unref (expected);
+  g_timer_destroy (timer);
+}
+
+static void
+test_histogram_update (HistogramFixture *fixture,
+                       gconstpointer     data)
+{
+  histogram_run_strokes (fixture);
+}
+
+static void
+test_histogram_update_selection (HistogramFixture *fixture,
+                                 gconstpointer     data)
+{
+  GimpChannel *mask = gimp_image_get_mask (fixture->image);
+
+  /*  a feathered selection, so the mask weights pixels partially  */
+  gimp_channel_select_rectangle (mask,
+                                 IMAGE_SIZE / 8, IMAGE_SIZE / 8,
+                                 IMAGE_SIZE / 2, IMAGE_SIZE / 2,
+                                 GIMP_CHANNEL_OP_REPLACE,
+                                 TRUE, 16.0, 16.0,
+                                 FALSE);
+
+  histogram_run_strokes (fixture);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_IMAGE_TEST (test_histogram_update);
+  ADD_IMAGE_TEST (test_histogram_update_selection);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,256 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimplineart.h"
+#include "core/gimppickable.h"
+#include "core/gimpviewable.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE   1024
+#define SHAPE_SIZE   60
+#define SHAPE_STEP   160
+#define STROKE_WIDTH 3
+#define GAP_SIZE     12
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-line-art/" #function, gimp, function);
+
+
+/* draws the outline of a square at (@x, @y), with a gap in its top
+ * side, which the closure fills.
+ */
+static void
+line_art_draw_shape (GimpLayer *layer,
+                     GeglColor *color,
+                     gint       x,
+                     gint       y)
+{
+  GeglBuffer *buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  gint        half   = (SHAPE_SIZE - GAP_SIZE) / 2;
+
+  gegl_buffer_set_color (buffer,
+                         GEGL_RECTANGLE (x, y, half, STROKE_WIDTH),
+                         color);
+  gegl_buffer_set_color (buffer,
+                         GEGL_RECTANGLE (x + SHAPE_SIZE - half, y,
+                                         half, STROKE_WIDTH),
+                         color);
+  gegl_buffer_set_color (buffer,
+                         GEGL_RECTANGLE (x, y + SHAPE_SIZE - STROKE_WIDTH,
+                                         SHAPE_SIZE, STROKE_WIDTH),
+                         color);
+  gegl_buffer_set_color (buffer,
+                         GEGL_RECTANGLE (x, y, STROKE_WIDTH, SHAPE_SIZE),
+                         color);
+  gegl_buffer_set_color (buffer,
+                         GEGL_RECTANGLE (x + SHAPE_SIZE - STROKE_WIDTH, y,
+                                         STROKE_WIDTH, SHAPE_SIZE),
+                         color);
+
+  gimp_drawable_update (GIMP_DRAWABLE (layer),
+                        x, y, SHAPE_SIZE, SHAPE_SIZE);
+}
+
+/* returns a new image, whose layer has a grid of nearly closed shapes
+ * on a white background, and a line across its bottom.
+ */
+static GimpImage *
+line_art_new_image (Gimp *gimp)
+{
+  GimpImage *image;
+  GimpLayer *layer;
+  GeglColor *white = gegl_color_new ("white");
+  GeglColor *black = gegl_color_new ("black");
+  gint       x, y;
+
+  image = gimp_image_new (gimp, IMAGE_SIZE, IMAGE_SIZE,
+                          GIMP_RGB, GIMP_PRECISION_U8_NON_LINEAR);
+
+  layer = gimp_layer_new (image, IMAGE_SIZE, IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Line Art Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                         NULL, white);
+
+  for (y = 40; y + SHAPE_SIZE < IMAGE_SIZE - 200; y += SHAPE_STEP)
+    for (x = 40; x + SHAPE_SIZE < IMAGE_SIZE; x += SHAPE_STEP)
+      line_art_draw_shape (layer, black, x, y);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                         GEGL_RECTANGLE (20, IMAGE_SIZE - 100,
+                                         IMAGE_SIZE - 40, STROKE_WIDTH),
+                         black);
+
+  g_object_unref (white);
+  g_object_unref (black);
+
+  return image;
+}
+
+static void
+line_art_assert_equal (GeglBuffer *closed,
+                       GeglBuffer *expected)
+{
+  guchar *pixels1 = g_new (guchar, IMAGE_SIZE * IMAGE_SIZE);
+  guchar *pixels2 = g_new (guchar, IMAGE_SIZE * IMAGE_SIZE);
+
+  gegl_buffer_get (closed, GEGL_RECTANGLE (0, 0, IMAGE_SIZE, IMAGE_SIZE),
+                   1.0, NULL, pixels1,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (expected, GEGL_RECTANGLE (0, 0, IMAGE_SIZE, IMAGE_SIZE),
+                   1.0, NULL, pixels2,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert_true (memcmp (pixels1, pixels2, IMAGE_SIZE * IMAGE_SIZE) == 0);
+
+  g_free (pixels1);
+  g_free (pixels2);
+}
+
+/* closes the line art of an image, changes the image around (@x, @y),
+ * and checks that updating the closed line art gives the same result
+ * as closing the changed image from scratch.
+ */
+static void
+line_art_compare (Gimp     *gimp,
+                  gint      x,
+                  gint      y,
+                  gboolean  erase)
+{
+  GimpImage   *image;
+  GimpLayer   *layer;
+  GimpLineArt *line_art;
+  GimpLineArt *expected;
+  GeglColor   *color;
+
+  image = line_art_new_image (gimp);
+  layer = gimp_image_get_layer_iter (image)->data;
+
+  line_art = gimp_line_art_new ();
+  gimp_line_art_set_input (line_art, GIMP_PICKABLE (layer));
+
+  g_assert_nonnull (gimp_line_art_get (line_art, NULL));
+
+  color = gegl_color_new (erase ? "white" : "black");
+
+  line_art_draw_shape (layer, color, x, y);
+
+  g_object_unref (color);
+
+  /*  let the line art notice the change, and update its result  */
+  gimp_viewable_invalidate_preview (GIMP_VIEWABLE (layer));
+
+  while (g_main_context_pending (NULL))
+    g_main_context_iteration (NULL, FALSE);
+
+  expected = gimp_line_art_new ();
+  gimp_line_art_set_input (expected, GIMP_PICKABLE (layer));
+
+  line_art_assert_equal (gimp_line_art_get (line_art, NULL),
+                         gimp_line_art_get (expected, NULL));
+
+  g_object_unref (expected);
+  g_object_unref (line_art);
+  g_object_unref (image);
+}
+
+/**
+ * update_matches_full:
+ * @data:
+ *
+ * A shape drawn away from the other strokes is closed the same by an
+ * update as by closing the whole line art.
+ **/
+static void
+update_matches_full (gconstpointer data)
+{
+  line_art_compare (GIMP (data), 120, 120, FALSE);
+}
+
+/**
+ * update_erase_matches_full:
+ * @data:
+ *
+ * Same for erasing one of the shapes.
+ **/
+static void
+update_erase_matches_full (gconstpointer data)
+{
+  line_art_compare (GIMP (data), 40 + SHAPE_STEP, 40 + SHAPE_STEP, TRUE);
+}
+
+/**
+ * update_across_stroke_matches_full:
+ * @data:
+ *
+ * A shape drawn over a stroke which reaches far beyond the updated
+ * area, and the regions it encloses, is closed the same as well.
+ **/
+static void
+update_across_stroke_matches_full (gconstpointer data)
+{
+  line_art_compare (GIMP (data), IMAGE_SIZE / 2, IMAGE_SIZE - 130, FALSE);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (update_matches_full);
+  ADD_TEST (update_erase_matches_full);
+  ADD_TEST (update_across_stroke_matches_full);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
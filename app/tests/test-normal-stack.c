@@ -0,0 +1,372 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "operations/operations-types.h"
+#include "operations/layer-modes/gimpoperationnormalstack.h"
+
+#include "core/gimp.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE   512
+#define LAYER_SIZE   300
+#define N_LAYERS     6
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-normal-stack/" #function, gimp, function);
+
+
+typedef struct
+{
+  GeglNode   *graph;
+  GeglNode   *chain;
+  GeglNode   *stack;
+  GeglNode   *modes[N_LAYERS];
+  GeglBuffer *buffers[N_LAYERS];
+} StackGraph;
+
+
+static const gint    offsets[N_LAYERS][2] =
+{
+  {    0,    0 },
+  {  -50,   80 },
+  {  120,  -30 },
+  {  250,  250 },
+  {   33,  190 },
+  {  300,    7 }
+};
+
+static const gdouble opacities[N_LAYERS] =
+{
+  1.0, 0.5, 0.8, 0.0, 1.0, 0.25
+};
+
+
+/* returns a new buffer of ramps that differ for each @seed, with partial
+ * and zero alpha
+ */
+static GeglBuffer *
+stack_new_buffer (gint size,
+                  gint seed)
+{
+  GeglBuffer *buffer;
+  gfloat     *row;
+  gint        x, y;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, size, size),
+                            babl_format ("R'G'B'A float"));
+
+  row = g_new (gfloat, size * 4);
+
+  for (y = 0; y < size; y++)
+    {
+      for (x = 0; x < size; x++)
+        {
+          row[x * 4 + 0] = (gfloat) ((x + seed * 37) % size) / size;
+          row[x * 4 + 1] = (gfloat) ((y + seed * 71) % size) / size;
+          row[x * 4 + 2] = (gfloat) ((x + y) % size) / size;
+          row[x * 4 + 3] = ((x ^ y ^ seed) & 0x1f) == 0 ?
+                           0.0f : 1.0f - (gfloat) ((x * seed + y) & 0x7f) / 255.0f;
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, size, 1), 0,
+                       babl_format ("R'G'B'A float"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+
+  return buffer;
+}
+
+/* composites the same layers over @background twice: once as a chain of
+ * gimp:normal nodes, and once with a single gimp:normal-stack node.
+ */
+static void
+stack_graph_init (StackGraph *graph,
+                  GeglBuffer *background)
+{
+  GimpOperationNormalStack *stack;
+  GeglNode                 *input = NULL;
+  GeglNode                 *previous;
+  gint                      i;
+
+  graph->graph = gegl_node_new ();
+
+  if (background)
+    {
+      input = gegl_node_new_child (graph->graph,
+                                   "operation", "gegl:buffer-source",
+                                   "buffer",    background,
+                                   NULL);
+    }
+
+  graph->stack = gegl_node_new_child (graph->graph,
+                                      "operation",       "gimp:normal-stack",
+                                      "composite-space", GIMP_LAYER_COLOR_SPACE_RGB_LINEAR,
+                                      NULL);
+
+  if (input)
+    gegl_node_link (input, graph->stack);
+
+  stack = GIMP_OPERATION_NORMAL_STACK (
+    gegl_node_get_gegl_operation (graph->stack));
+
+  previous = input;
+
+  for (i = 0; i < N_LAYERS; i++)
+    {
+      GeglNode *source;
+      GeglNode *translate;
+      GeglNode *mode;
+
+      graph->buffers[i] = stack_new_buffer (LAYER_SIZE, i + 1);
+
+      source = gegl_node_new_child (graph->graph,
+                                    "operation", "gegl:buffer-source",
+                                    "buffer",    graph->buffers[i],
+                                    NULL);
+      translate = gegl_node_new_child (graph->graph,
+                                       "operation", "gegl:translate",
+                                       "x",         (gdouble) offsets[i][0],
+                                       "y",         (gdouble) offsets[i][1],
+                                       NULL);
+      mode = gegl_node_new_child (graph->graph,
+                                  "operation",       "gimp:normal",
+                                  "opacity",         opacities[i],
+                                  "composite-space", GIMP_LAYER_COLOR_SPACE_RGB_LINEAR,
+                                  "composite-mode",  GIMP_LAYER_COMPOSITE_UNION,
+                                  NULL);
+
+      gegl_node_link (source, translate);
+      gegl_node_connect (translate, "output", mode, "aux");
+
+      if (previous)
+        gegl_node_link (previous, mode);
+
+      previous = mode;
+
+      graph->modes[i] = mode;
+
+      gimp_operation_normal_stack_add_layer (stack, graph->buffers[i],
+                                             offsets[i][0], offsets[i][1],
+                                             opacities[i]);
+    }
+
+  graph->chain = previous;
+}
+
+static void
+stack_graph_clear (StackGraph *graph)
+{
+  gint i;
+
+  g_object_unref (graph->graph);
+
+  for (i = 0; i < N_LAYERS; i++)
+    g_object_unref (graph->buffers[i]);
+}
+
+static void
+stack_render (GeglNode *node,
+              gfloat   *pixels)
+{
+  gegl_node_blit (node, 1.0, GEGL_RECTANGLE (0, 0, IMAGE_SIZE, IMAGE_SIZE),
+                  babl_format ("RGBA float"), pixels,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+}
+
+/* renders the chain and the stack node, and checks that they match
+ * exactly, since both composite with gimp:normal's process function
+ */
+static void
+stack_compare (StackGraph *graph)
+{
+  gfloat *expected;
+  gfloat *pixels;
+  gint    i;
+
+  expected = g_new (gfloat, IMAGE_SIZE * IMAGE_SIZE * 4);
+  pixels   = g_new (gfloat, IMAGE_SIZE * IMAGE_SIZE * 4);
+
+  stack_render (graph->chain, expected);
+  stack_render (graph->stack, pixels);
+
+  for (i = 0; i < IMAGE_SIZE * IMAGE_SIZE * 4; i++)
+    g_assert_cmpfloat (pixels[i], ==, expected[i]);
+
+  g_free (pixels);
+  g_free (expected);
+}
+
+static void
+stack_matches_chain (gconstpointer data)
+{
+  StackGraph  graph;
+  GeglBuffer *background;
+
+  background = stack_new_buffer (IMAGE_SIZE, 0);
+
+  stack_graph_init (&graph, background);
+
+  stack_compare (&graph);
+
+  stack_graph_clear (&graph);
+  g_object_unref (background);
+}
+
+/**
+ * stack_matches_chain_without_input:
+ * @data:
+ *
+ * Test that the bottom layer is composited like the last node of the
+ * chain, when there is nothing below it.
+ **/
+static void
+stack_matches_chain_without_input (gconstpointer data)
+{
+  StackGraph graph;
+
+  stack_graph_init (&graph, NULL);
+
+  stack_compare (&graph);
+
+  stack_graph_clear (&graph);
+}
+
+/**
+ * stack_follows_changes:
+ * @data:
+ *
+ * Test that the stack node picks up changes to the layers' buffers,
+ * after it has rendered once.
+ **/
+static void
+stack_follows_changes (gconstpointer data)
+{
+  StackGraph  graph;
+  GeglBuffer *background;
+  GeglColor  *color;
+
+  background = stack_new_buffer (IMAGE_SIZE, 0);
+
+  stack_graph_init (&graph, background);
+
+  stack_compare (&graph);
+
+  color = gegl_color_new ("rgba(0.2, 0.9, 0.4, 0.7)");
+
+  gegl_buffer_set_color (graph.buffers[2],
+                         GEGL_RECTANGLE (20, 40, 100, 60), color);
+  gegl_buffer_set_color (graph.buffers[N_LAYERS - 1],
+                         GEGL_RECTANGLE (0, 0, 10, LAYER_SIZE), color);
+
+  g_object_unref (color);
+
+  stack_compare (&graph);
+
+  stack_graph_clear (&graph);
+  g_object_unref (background);
+}
+
+/**
+ * stack_follows_layer_changes:
+ * @data:
+ *
+ * Test that the stack node picks up a layer's new opacity and offset,
+ * set without rebuilding the stack.
+ **/
+static void
+stack_follows_layer_changes (gconstpointer data)
+{
+  StackGraph                graph;
+  GimpOperationNormalStack *stack;
+  GeglBuffer               *background;
+  GeglNode                 *translate;
+
+  background = stack_new_buffer (IMAGE_SIZE, 0);
+
+  stack_graph_init (&graph, background);
+
+  stack_compare (&graph);
+
+  stack = GIMP_OPERATION_NORMAL_STACK (
+    gegl_node_get_gegl_operation (graph.stack));
+
+  gegl_node_set (graph.modes[1],
+                 "opacity", 0.3,
+                 NULL);
+  gimp_operation_normal_stack_set_layer (stack, 1, graph.buffers[1],
+                                         offsets[1][0], offsets[1][1],
+                                         0.3);
+
+  stack_compare (&graph);
+
+  translate = gegl_node_get_producer (graph.modes[4], "aux", NULL);
+
+  gegl_node_set (translate,
+                 "x", 140.0,
+                 "y", 60.0,
+                 NULL);
+  gimp_operation_normal_stack_set_layer (stack, 4, graph.buffers[4],
+                                         140, 60, opacities[4]);
+
+  stack_compare (&graph);
+
+  stack_graph_clear (&graph);
+  g_object_unref (background);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (stack_matches_chain);
+  ADD_TEST (stack_matches_chain_without_input);
+  ADD_TEST (stack_follows_changes);
+  ADD_TEST (stack_follows_layer_changes);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,276 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "operations/operations-types.h"
+#include "operations/gimpbrightnesscontrastconfig.h"
+#include "operations/gimphuesaturationconfig.h"
+#include "operations/gimpoperationfusedpointfilter.h"
+
+#include "core/gimp.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE   1024
+#define N_FILTERS    3
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-point-filter-fusion/" #function, gimp, function);
+
+
+typedef struct
+{
+  GeglNode   *graph;
+  GeglNode   *chain;
+  GeglNode   *fused;
+  GeglNode   *filters[N_FILTERS];
+  GObject    *brightness_contrast;
+  GObject    *hue_saturation;
+} FusionGraph;
+
+
+/* returns a new buffer of smooth ramps, with partial alpha */
+static GeglBuffer *
+fusion_new_buffer (void)
+{
+  GeglBuffer *buffer;
+  gfloat     *row;
+  gint        x, y;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, IMAGE_SIZE, IMAGE_SIZE),
+                            babl_format ("R'G'B'A float"));
+
+  row = g_new (gfloat, IMAGE_SIZE * 4);
+
+  for (y = 0; y < IMAGE_SIZE; y++)
+    {
+      for (x = 0; x < IMAGE_SIZE; x++)
+        {
+          row[x * 4 + 0] = (gfloat) x / IMAGE_SIZE;
+          row[x * 4 + 1] = (gfloat) y / IMAGE_SIZE;
+          row[x * 4 + 2] = (gfloat) ((x + y) % IMAGE_SIZE) / IMAGE_SIZE;
+          row[x * 4 + 3] = 1.0f - (gfloat) ((x ^ y) & 0x7f) / 255.0f;
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, IMAGE_SIZE, 1), 0,
+                       babl_format ("R'G'B'A float"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+
+  return buffer;
+}
+
+/* builds brightness-contrast -> hue-saturation -> posterize twice on
+ * the same buffer: once as a chain of nodes, and once fused into a
+ * single node.
+ */
+static void
+fusion_graph_init (FusionGraph *graph,
+                   GeglBuffer  *buffer)
+{
+  GeglNode *source;
+  gint      i;
+
+  graph->brightness_contrast =
+    g_object_new (GIMP_TYPE_BRIGHTNESS_CONTRAST_CONFIG,
+                  "brightness", 0.2,
+                  "contrast",   0.3,
+                  NULL);
+
+  graph->hue_saturation =
+    g_object_new (GIMP_TYPE_HUE_SATURATION_CONFIG,
+                  "hue",        0.25,
+                  "saturation", 0.4,
+                  NULL);
+
+  graph->graph = gegl_node_new ();
+
+  source = gegl_node_new_child (graph->graph,
+                                "operation", "gegl:buffer-source",
+                                "buffer",    buffer,
+                                NULL);
+
+  graph->filters[0] = gegl_node_new_child (graph->graph,
+                                           "operation", "gimp:brightness-contrast",
+                                           "config",    graph->brightness_contrast,
+                                           NULL);
+  graph->filters[1] = gegl_node_new_child (graph->graph,
+                                           "operation", "gimp:hue-saturation",
+                                           "config",    graph->hue_saturation,
+                                           NULL);
+  graph->filters[2] = gegl_node_new_child (graph->graph,
+                                           "operation", "gimp:posterize",
+                                           "levels",    8,
+                                           NULL);
+
+  gegl_node_link (source, graph->filters[0]);
+
+  for (i = 1; i < N_FILTERS; i++)
+    gegl_node_link (graph->filters[i - 1], graph->filters[i]);
+
+  graph->chain = graph->filters[N_FILTERS - 1];
+
+  graph->fused = gegl_node_new_child (graph->graph,
+                                      "operation", "gimp:fused-point-filter",
+                                      NULL);
+
+  gegl_node_link (source, graph->fused);
+
+  for (i = 0; i < N_FILTERS; i++)
+    g_assert_true (gimp_operation_fused_point_filter_can_fuse (graph->filters[i]));
+
+  gimp_operation_fused_point_filter_set_nodes (
+    GIMP_OPERATION_FUSED_POINT_FILTER (gegl_node_get_gegl_operation (graph->fused)),
+    graph->filters, N_FILTERS);
+}
+
+static void
+fusion_graph_clear (FusionGraph *graph)
+{
+  g_object_unref (graph->graph);
+  g_object_unref (graph->brightness_contrast);
+  g_object_unref (graph->hue_saturation);
+}
+
+static void
+fusion_render (GeglNode *node,
+               gfloat   *pixels)
+{
+  gegl_node_blit (node, 1.0, GEGL_RECTANGLE (0, 0, IMAGE_SIZE, IMAGE_SIZE),
+                  babl_format ("R'G'B'A float"), pixels,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+}
+
+/* renders the chain and the fused node, and checks that they're the
+ * same.
+ */
+static void
+fusion_compare (FusionGraph *graph)
+{
+  gfloat *expected;
+  gfloat *pixels;
+
+  expected = g_new (gfloat, IMAGE_SIZE * IMAGE_SIZE * 4);
+  pixels   = g_new (gfloat, IMAGE_SIZE * IMAGE_SIZE * 4);
+
+  fusion_render (graph->chain, expected);
+  fusion_render (graph->fused, pixels);
+
+  g_assert_true (memcmp (pixels, expected,
+                         IMAGE_SIZE * IMAGE_SIZE * 4 * sizeof (gfloat)) == 0);
+
+  g_free (pixels);
+  g_free (expected);
+}
+
+static void
+fused_matches_chain (gconstpointer data)
+{
+  FusionGraph  graph;
+  GeglBuffer  *buffer;
+
+  buffer = fusion_new_buffer ();
+
+  fusion_graph_init (&graph, buffer);
+
+  fusion_compare (&graph);
+
+  fusion_graph_clear (&graph);
+  g_object_unref (buffer);
+}
+
+/**
+ * fused_follows_changes:
+ * @data:
+ *
+ * Test that the fused node picks up changes to the filters it runs,
+ * after it has rendered once.
+ **/
+static void
+fused_follows_changes (gconstpointer data)
+{
+  FusionGraph  graph;
+  GeglBuffer  *buffer;
+
+  buffer = fusion_new_buffer ();
+
+  fusion_graph_init (&graph, buffer);
+
+  fusion_compare (&graph);
+
+  /*  like the filter tools, set the changed config on the node again  */
+  g_object_set (graph.brightness_contrast,
+                "contrast", -0.2,
+                NULL);
+  g_object_set (graph.hue_saturation,
+                "lightness", -0.3,
+                NULL);
+
+  gegl_node_set (graph.filters[0],
+                 "config", graph.brightness_contrast,
+                 NULL);
+  gegl_node_set (graph.filters[1],
+                 "config", graph.hue_saturation,
+                 NULL);
+  gegl_node_set (graph.filters[2],
+                 "levels", 3,
+                 NULL);
+
+  fusion_compare (&graph);
+
+  fusion_graph_clear (&graph);
+  g_object_unref (buffer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (fused_matches_chain);
+  ADD_TEST (fused_follows_changes);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,252 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimppickable.h"
+#include "core/gimpprojectable.h"
+#include "core/gimpprojection.h"
+
+#include "gimp-app-test-utils.h"
+#include "tests.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-projection/" #function, gimp, function);
+
+#define IMAGE_WIDTH  1031
+#define IMAGE_HEIGHT 777
+#define N_LAYERS     3
+#define N_THREADS    4
+
+
+static const GimpLayerMode modes[N_LAYERS] =
+{
+  GIMP_LAYER_MODE_NORMAL,
+  GIMP_LAYER_MODE_MULTIPLY,
+  GIMP_LAYER_MODE_OVERLAY
+};
+
+
+static void
+projection_fill (GimpLayer *layer,
+                 gint       seed)
+{
+  GeglBuffer *buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  gint        width  = gegl_buffer_get_width (buffer);
+  gint        height = gegl_buffer_get_height (buffer);
+  guchar     *row;
+  gint        x, y;
+
+  row = g_new (guchar, width * 4);
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          row[x * 4 + 0] = x * (seed + 1);
+          row[x * 4 + 1] = y + seed * 40;
+          row[x * 4 + 2] = x ^ (y + seed);
+          row[x * 4 + 3] = 255 - ((x + y + seed * 17) & 0x7f);
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, y, width, 1), 0,
+                       babl_format ("R'G'B'A u8"), row,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row);
+
+  gimp_drawable_update (GIMP_DRAWABLE (layer), 0, 0, width, height);
+}
+
+static GimpImage *
+projection_new_image (Gimp *gimp)
+{
+  GimpImage *image;
+  gint       i;
+
+  image = gimp_image_new (gimp, IMAGE_WIDTH, IMAGE_HEIGHT,
+                          GIMP_RGB, GIMP_PRECISION_U8_NON_LINEAR);
+
+  for (i = 0; i < N_LAYERS; i++)
+    {
+      GimpLayer *layer;
+
+      layer = gimp_layer_new (image,
+                              IMAGE_WIDTH - i * 101, IMAGE_HEIGHT - i * 67,
+                              gimp_image_get_layer_format (image, TRUE),
+                              "Layer", 1.0 - i * 0.2, modes[i]);
+
+      gimp_item_set_offset (GIMP_ITEM (layer), i * 53, i * 31);
+
+      gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+      projection_fill (layer, i);
+    }
+
+  return image;
+}
+
+/* renders the projection through the idle renderer, the way the display
+ * does, and checks that it matches a single render of the whole graph
+ */
+static void
+projection_check (GimpImage *image)
+{
+  GimpProjection *proj   = gimp_image_get_projection (image);
+  const Babl     *format = gimp_pickable_get_format (GIMP_PICKABLE (proj));
+  GeglBuffer     *buffer;
+  guchar         *expected;
+  guchar         *pixels;
+  gsize           size;
+
+  buffer = gimp_pickable_get_buffer (GIMP_PICKABLE (proj));
+
+  gimp_projection_flush (proj);
+  gimp_test_run_mainloop_until_idle ();
+  gimp_projection_finish_draw (proj);
+
+  size = (gsize) IMAGE_WIDTH * IMAGE_HEIGHT *
+         babl_format_get_bytes_per_pixel (format);
+
+  expected = g_malloc (size);
+  pixels   = g_malloc (size);
+
+  gegl_node_blit (gimp_projectable_get_graph (GIMP_PROJECTABLE (image)), 1.0,
+                  GEGL_RECTANGLE (0, 0, IMAGE_WIDTH, IMAGE_HEIGHT),
+                  format, expected,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+
+  gegl_buffer_get (buffer,
+                   GEGL_RECTANGLE (0, 0, IMAGE_WIDTH, IMAGE_HEIGHT), 1.0,
+                   format, pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert_true (memcmp (pixels, expected, size) == 0);
+
+  g_free (pixels);
+  g_free (expected);
+}
+
+/**
+ * projection_matches_graph:
+ * @data:
+ *
+ * Test that the projection, rendered in chunks with several GEGL
+ * threads, matches the projectable's graph.
+ **/
+static void
+projection_matches_graph (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+
+  image = projection_new_image (gimp);
+
+  projection_check (image);
+
+  g_object_unref (image);
+}
+
+/**
+ * projection_follows_changes:
+ * @data:
+ *
+ * Test that changes made while the projection is being rendered, in
+ * and out of the priority rect, end up in the projection.
+ **/
+static void
+projection_follows_changes (gconstpointer data)
+{
+  Gimp           *gimp = GIMP (data);
+  GimpImage      *image;
+  GimpProjection *proj;
+  GList          *layers;
+  GeglColor      *color;
+
+  image  = projection_new_image (gimp);
+  proj   = gimp_image_get_projection (image);
+  layers = gimp_image_get_layer_list (image);
+
+  projection_check (image);
+
+  color = gegl_color_new ("rgba(0.2, 0.9, 0.4, 0.7)");
+
+  /*  start rendering a change, and make another one before it's done  */
+  gimp_projection_set_priority_rect (proj, 200, 100, 300, 200);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (layers->data),
+                         GEGL_RECTANGLE (150, 50, 400, 300), color);
+  gimp_drawable_update (layers->data, 150, 50, 400, 300);
+
+  gimp_projection_flush (proj);
+  gimp_test_run_temp_mainloop (1);
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (layers->next->data),
+                         GEGL_RECTANGLE (0, 0, 60, IMAGE_HEIGHT), color);
+  gimp_drawable_update (layers->next->data, 0, 0, 60, IMAGE_HEIGHT);
+
+  projection_check (image);
+
+  g_object_unref (color);
+  g_list_free (layers);
+  g_object_unref (image);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  g_object_set (gegl_config (),
+                "threads", N_THREADS,
+                NULL);
+
+  ADD_TEST (projection_matches_graph);
+  ADD_TEST (projection_follows_changes);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,340 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimpchannel.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpfilterstack.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimpprojectable.h"
+
+#include "gimp-app-test-utils.h"
+#include "tests.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-render-cache/" #function, gimp, function);
+
+#define IMAGE_SIZE 256
+#define N_LAYERS   4
+
+
+typedef struct
+{
+  GimpImage *image;
+  GimpLayer *layers[N_LAYERS];  /*  bottom to top  */
+} RenderCache;
+
+
+static void
+render_cache_init (RenderCache *cache,
+                   Gimp        *gimp)
+{
+  GeglColor *color = gegl_color_new (NULL);
+  gint       i;
+
+  cache->image = gimp_image_new (gimp, IMAGE_SIZE, IMAGE_SIZE,
+                                 GIMP_RGB, GIMP_PRECISION_FLOAT_LINEAR);
+
+  for (i = 0; i < N_LAYERS; i++)
+    {
+      GimpLayer *layer;
+
+      layer = gimp_layer_new (cache->image, IMAGE_SIZE, IMAGE_SIZE,
+                              gimp_image_get_layer_format (cache->image, TRUE),
+                              "Layer", 0.75,
+                              i % 2 ? GIMP_LAYER_MODE_MULTIPLY :
+                                      GIMP_LAYER_MODE_NORMAL);
+
+      gimp_image_add_layer (cache->image, layer, NULL, 0, FALSE);
+
+      gegl_color_set_rgba (color, 0.2 * i, 1.0 - 0.2 * i, 0.5, 0.8);
+      gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                             GEGL_RECTANGLE (i * 20, i * 30, 150, 150),
+                             color);
+
+      cache->layers[i] = layer;
+    }
+
+  g_object_unref (color);
+}
+
+static void
+render_cache_clear (RenderCache *cache)
+{
+  g_object_set (cache->image->gimp->config,
+                "render-cache", FALSE,
+                NULL);
+
+  g_object_unref (cache->image);
+}
+
+static void
+render_cache_select (RenderCache *cache,
+                     GimpLayer   *layer)
+{
+  GList list = { layer, NULL, NULL };
+
+  gimp_image_set_selected_layers (cache->image, &list);
+}
+
+static GimpFilter *
+render_cache_get_filter (RenderCache *cache)
+{
+  GimpContainer *layers = gimp_image_get_layers (cache->image);
+
+  return gimp_filter_stack_get_cache_filter (GIMP_FILTER_STACK (layers));
+}
+
+static gfloat *
+render_cache_render (RenderCache *cache)
+{
+  GeglNode *graph  = gimp_projectable_get_graph (GIMP_PROJECTABLE (cache->image));
+  gfloat   *pixels = g_new (gfloat, IMAGE_SIZE * IMAGE_SIZE * 4);
+
+  gegl_node_blit (graph, 1.0,
+                  GEGL_RECTANGLE (0, 0, IMAGE_SIZE, IMAGE_SIZE),
+                  babl_format ("RGBA float"), pixels,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+
+  return pixels;
+}
+
+/**
+ * render_cache_off_by_default:
+ * @data:
+ *
+ * Test that images don't cache anything unless the preference is on,
+ * and follow the preference when it changes.
+ **/
+static void
+render_cache_off_by_default (gconstpointer data)
+{
+  Gimp        *gimp = GIMP (data);
+  RenderCache  cache;
+
+  g_assert_false (gimp->config->render_cache);
+
+  render_cache_init (&cache, gimp);
+  render_cache_select (&cache, cache.layers[2]);
+
+  g_assert_null (render_cache_get_filter (&cache));
+
+  g_object_set (gimp->config,
+                "render-cache", TRUE,
+                NULL);
+
+  g_assert_true (render_cache_get_filter (&cache) ==
+                 GIMP_FILTER (cache.layers[2]));
+
+  g_object_set (gimp->config,
+                "render-cache", FALSE,
+                NULL);
+
+  g_assert_null (render_cache_get_filter (&cache));
+
+  render_cache_clear (&cache);
+}
+
+/**
+ * render_cache_kept_for_channels:
+ * @data:
+ *
+ * Test that selecting a channel, which deselects all layers, doesn't
+ * rewire the graph, and that selecting another layer does.
+ **/
+static void
+render_cache_kept_for_channels (gconstpointer data)
+{
+  Gimp        *gimp = GIMP (data);
+  RenderCache  cache;
+  GimpChannel *channel;
+  GeglColor   *color;
+  GList        list = { NULL, };
+
+  render_cache_init (&cache, gimp);
+
+  g_object_set (gimp->config,
+                "render-cache", TRUE,
+                NULL);
+
+  render_cache_select (&cache, cache.layers[1]);
+
+  color   = gegl_color_new ("red");
+  channel = gimp_channel_new (cache.image, IMAGE_SIZE, IMAGE_SIZE,
+                              "Channel", color);
+  g_object_unref (color);
+
+  gimp_image_add_channel (cache.image, channel, NULL, 0, FALSE);
+
+  list.data = channel;
+  gimp_image_set_selected_channels (cache.image, &list);
+
+  g_assert_null (gimp_image_get_selected_layers (cache.image));
+  g_assert_true (render_cache_get_filter (&cache) ==
+                 GIMP_FILTER (cache.layers[1]));
+
+  render_cache_select (&cache, cache.layers[3]);
+
+  g_assert_true (render_cache_get_filter (&cache) ==
+                 GIMP_FILTER (cache.layers[3]));
+
+  render_cache_clear (&cache);
+}
+
+/**
+ * render_cache_bounded:
+ * @data:
+ *
+ * Test that nothing is cached when the composite doesn't fit in a
+ * quarter of the tile cache.
+ **/
+static void
+render_cache_bounded (gconstpointer data)
+{
+  Gimp        *gimp = GIMP (data);
+  RenderCache  cache;
+  guint64      tile_cache_size;
+
+  g_object_get (gimp->config,
+                "tile-cache-size", &tile_cache_size,
+                NULL);
+
+  render_cache_init (&cache, gimp);
+  render_cache_select (&cache, cache.layers[2]);
+
+  g_object_set (gimp->config,
+                "tile-cache-size", (guint64) IMAGE_SIZE * IMAGE_SIZE * 4 *
+                                   sizeof (gfloat),
+                "render-cache",    TRUE,
+                NULL);
+
+  g_assert_null (render_cache_get_filter (&cache));
+
+  g_object_set (gimp->config,
+                "tile-cache-size", tile_cache_size,
+                NULL);
+
+  g_assert_true (render_cache_get_filter (&cache) ==
+                 GIMP_FILTER (cache.layers[2]));
+
+  render_cache_clear (&cache);
+}
+
+/**
+ * render_cache_matches_graph:
+ * @data:
+ *
+ * Test that the cached graph renders like the uncached one, after
+ * changes above and below the cached layer, and that the rendered
+ * cache is counted in the image's memsize.
+ **/
+static void
+render_cache_matches_graph (gconstpointer data)
+{
+  Gimp        *gimp = GIMP (data);
+  RenderCache  cache;
+  GeglColor   *color;
+  gfloat      *expected;
+  gfloat      *pixels;
+  gint64       gui_size_uncached = 0;
+  gint64       gui_size_cached   = 0;
+  gint         i;
+
+  render_cache_init (&cache, gimp);
+  render_cache_select (&cache, cache.layers[2]);
+
+  color = gegl_color_new ("rgba(0.1, 0.3, 0.9, 0.6)");
+
+  for (i = 0; i < N_LAYERS; i++)
+    {
+      gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (cache.layers[i])),
+                             GEGL_RECTANGLE (100, 10 + i * 50, 80, 40),
+                             color);
+
+      g_object_set (gimp->config,
+                    "render-cache", FALSE,
+                    NULL);
+
+      expected = render_cache_render (&cache);
+
+      gimp_object_get_memsize (GIMP_OBJECT (cache.image), &gui_size_uncached);
+
+      g_object_set (gimp->config,
+                    "render-cache", TRUE,
+                    NULL);
+
+      /*  once to fill the cache, and once to read from it  */
+      g_free (render_cache_render (&cache));
+      pixels = render_cache_render (&cache);
+
+      gimp_object_get_memsize (GIMP_OBJECT (cache.image), &gui_size_cached);
+
+      g_assert_true (memcmp (pixels, expected,
+                             IMAGE_SIZE * IMAGE_SIZE * 4 * sizeof (gfloat)) == 0);
+      g_assert_cmpint (gui_size_cached, >, gui_size_uncached);
+
+      g_free (pixels);
+      g_free (expected);
+    }
+
+  g_object_unref (color);
+
+  render_cache_clear (&cache);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (render_cache_off_by_default);
+  ADD_TEST (render_cache_kept_for_channels);
+  ADD_TEST (render_cache_bounded);
+  ADD_TEST (render_cache_matches_graph);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
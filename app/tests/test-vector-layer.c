@@ -0,0 +1,265 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+
+#include "path/gimpanchor.h"
+#include "path/gimpbezierstroke.h"
+#include "path/gimppath.h"
+#include "path/gimpvectorlayer.h"
+
+#include "gimp-app-test-utils.h"
+
+#include "tests.h"
+
+
+#define IMAGE_SIZE 512
+#define N_POINTS   8
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-vector-layer/" #function, gimp, function);
+
+
+/* the corners and the middles of the sides of a square, as a single
+ * closed stroke
+ */
+static const GimpCoords points[N_POINTS] =
+{
+  {  40.0,  40.0, 0.0, 0.0 },
+  { 256.0,  40.0, 0.0, 0.0 },
+  { 472.0,  40.0, 0.0, 0.0 },
+  { 472.0, 256.0, 0.0, 0.0 },
+  { 472.0, 472.0, 0.0, 0.0 },
+  { 256.0, 472.0, 0.0, 0.0 },
+  {  40.0, 472.0, 0.0, 0.0 },
+  {  40.0, 256.0, 0.0, 0.0 }
+};
+
+
+static void
+vector_layer_update (GimpDrawable   *drawable,
+                     gint            x,
+                     gint            y,
+                     gint            width,
+                     gint            height,
+                     cairo_region_t *region)
+{
+  cairo_region_union_rectangle (region,
+                                &(cairo_rectangle_int_t) { x, y,
+                                                           width, height });
+}
+
+static guchar *
+vector_layer_get_pixels (GimpVectorLayer *layer)
+{
+  GimpItem *item   = GIMP_ITEM (layer);
+  gint      width  = gimp_item_get_width  (item);
+  gint      height = gimp_item_get_height (item);
+  guchar   *pixels = g_new (guchar, width * height * 4);
+
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                   GEGL_RECTANGLE (0, 0, width, height),
+                   1.0, babl_format ("R'G'B'A u8"), pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  return pixels;
+}
+
+/* moves the @index'th point of a single stroke vector layer to
+ * (@x, @y), and checks that only a part of the layer is rendered
+ * again, which looks the same as rendering the whole layer.
+ */
+static void
+vector_layer_compare (Gimp    *gimp,
+                      gint     index,
+                      gdouble  x,
+                      gdouble  y)
+{
+  GimpImage       *image;
+  GimpContext     *context;
+  GimpPath        *path;
+  GimpStroke      *stroke;
+  GimpAnchor      *anchor;
+  GimpVectorLayer *layer;
+  GimpCoords       coords = points[index];
+  cairo_region_t  *region;
+  GimpItem        *item;
+  guchar          *pixels1;
+  guchar          *pixels2;
+  gint             offset_x, offset_y;
+  gint             x1, y1;
+  gint             width, height;
+  gint             i;
+
+  image = gimp_image_new (gimp, IMAGE_SIZE, IMAGE_SIZE,
+                          GIMP_RGB, GIMP_PRECISION_U8_NON_LINEAR);
+  context = gimp_context_new (gimp, "Vector Layer", NULL);
+
+  path = gimp_path_new (image, "Vector Layer");
+
+  stroke = gimp_bezier_stroke_new_moveto (&points[0]);
+  for (i = 1; i < N_POINTS; i++)
+    gimp_bezier_stroke_lineto (stroke, &points[i]);
+  gimp_stroke_close (stroke);
+
+  gimp_path_stroke_add (path, stroke);
+  g_object_unref (stroke);
+
+  gimp_image_add_path (image, path, NULL, -1, FALSE);
+
+  layer = gimp_vector_layer_new (image, path, context);
+  item  = GIMP_ITEM (layer);
+
+  gimp_image_add_layer (image, GIMP_LAYER (layer), NULL, -1, FALSE);
+  gimp_vector_layer_refresh (layer);
+
+  gimp_item_get_offset (item, &offset_x, &offset_y);
+  width  = gimp_item_get_width  (item);
+  height = gimp_item_get_height (item);
+
+  region = cairo_region_create ();
+
+  g_signal_connect (layer, "update",
+                    G_CALLBACK (vector_layer_update),
+                    region);
+
+  for (anchor = gimp_stroke_anchor_get_next (stroke, NULL);
+       anchor;
+       anchor = gimp_stroke_anchor_get_next (stroke, anchor))
+    {
+      if (anchor->type       == GIMP_ANCHOR_ANCHOR &&
+          anchor->position.x == coords.x           &&
+          anchor->position.y == coords.y)
+        break;
+    }
+
+  g_assert_nonnull (anchor);
+
+  coords.x = x;
+  coords.y = y;
+
+  gimp_path_freeze (path);
+  gimp_stroke_anchor_move_absolute (stroke, anchor, &coords,
+                                    GIMP_ANCHOR_FEATURE_NONE);
+  gimp_path_thaw (path);
+
+  g_signal_handlers_disconnect_by_func (layer,
+                                        G_CALLBACK (vector_layer_update),
+                                        region);
+
+  /*  the layer kept its extent, and only its changed part was updated  */
+  gimp_item_get_offset (item, &x1, &y1);
+
+  g_assert_cmpint (x1, ==, offset_x);
+  g_assert_cmpint (y1, ==, offset_y);
+  g_assert_cmpint (gimp_item_get_width  (item), ==, width);
+  g_assert_cmpint (gimp_item_get_height (item), ==, height);
+
+  g_assert_false (cairo_region_is_empty (region));
+  g_assert_cmpint (cairo_region_contains_rectangle (region,
+                                                    &(cairo_rectangle_int_t)
+                                                    { 0, 0, width, height }),
+                   !=, CAIRO_REGION_OVERLAP_IN);
+
+  pixels1 = vector_layer_get_pixels (layer);
+
+  gimp_vector_layer_refresh (layer);
+
+  gimp_item_get_offset (item, &x1, &y1);
+
+  g_assert_cmpint (x1, ==, offset_x);
+  g_assert_cmpint (y1, ==, offset_y);
+  g_assert_cmpint (gimp_item_get_width  (item), ==, width);
+  g_assert_cmpint (gimp_item_get_height (item), ==, height);
+
+  pixels2 = vector_layer_get_pixels (layer);
+
+  g_assert_true (memcmp (pixels1, pixels2, width * height * 4) == 0);
+
+  g_free (pixels1);
+  g_free (pixels2);
+
+  cairo_region_destroy (region);
+
+  g_object_unref (path);
+  g_object_unref (context);
+  g_object_unref (image);
+}
+
+/**
+ * move_point_matches_full:
+ * @data:
+ *
+ * Moving a point in the middle of a single stroke renders only the
+ * segments next to it, the same as rendering the whole layer.
+ **/
+static void
+move_point_matches_full (gconstpointer data)
+{
+  vector_layer_compare (GIMP (data), 5, 256.0, 360.0);
+}
+
+/**
+ * move_last_point_matches_full:
+ * @data:
+ *
+ * Same for the last point, whose segment closes the stroke.
+ **/
+static void
+move_last_point_matches_full (gconstpointer data)
+{
+  vector_layer_compare (GIMP (data), N_POINTS - 1, 160.0, 256.0);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (move_point_matches_full);
+  ADD_TEST (move_last_point_matches_full);
+
+  result = g_test_run ();
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -64,6 +64,10 @@
 #include "file/file-open.h"
 #include "file/file-save.h"
 
+#include "xcf/xcf.h"
+#include "xcf/xcf-private.h"
+#include "xcf/xcf-predictor.h"
+
 #include "tests.h"
 
 #include "gimp-app-test-utils.h"
@@ -151,6 +155,15 @@
                                           { 921.0, 922.0, /* pad zeroes */ },\
                                           { 931.0, 932.0, /* pad zeroes */ }, }
 
+/* not a multiple of the tile size, so there are partial tiles */
+#define GIMP_PIXELIMAGE_WIDTH           150
+#define GIMP_PIXELIMAGE_HEIGHT          140
+#define GIMP_PIXELIMAGE_N_LAYERS        3
+
+#define GIMP_PREDICTOR_TILE_WIDTH       37
+#define GIMP_PREDICTOR_TILE_HEIGHT      23
+#define GIMP_PREDICTOR_N_COMPONENTS     4
+
 #define ADD_TEST(function) \
   g_test_add_data_func ("/gimp-xcf/" #function, gimp, function);
 
@@ -169,6 +182,17 @@ static void        gimp_assert_mainimage                       (GimpImage
                                                                 gboolean         with_unusual_stuff,
                                                                 gboolean         compat_paths,
                                                                 gboolean         use_gimp_2_8_features);
+static GFile     * gimp_test_new_file                          (void);
+static void        gimp_test_save_image                        (Gimp            *gimp,
+                                                                GimpImage       *image,
+                                                                GFile           *file);
+static void        gimp_write_and_read_pixelimage              (Gimp            *gimp,
+                                                                GimpPrecision    precision,
+                                                                GimpXcfCompression compression);
+static GimpImage * gimp_create_pixelimage                      (Gimp            *gimp,
+                                                                GimpPrecision    precision);
+static void        gimp_assert_same_pixels                     (GimpImage       *image,
+                                                                GimpImage       *loaded_image);
 
 
 /**
@@ -262,6 +286,309 @@ write_and_read_gimp_2_8_format (gconstpointer data)
                             TRUE /*use_gimp_2_8_features*/);
 }
 
+/**
+ * write_and_read_zlib_pixels:
+ * @data:
+ *
+ * Writes a zlib compressed image, then reads the file and makes sure
+ * it is still zlib compressed and holds the same pixels.
+ **/
+static void
+write_and_read_zlib_pixels (gconstpointer data)
+{
+  Gimp *gimp = GIMP (data);
+
+  gimp_write_and_read_pixelimage (gimp,
+                                  GIMP_PRECISION_U8_NON_LINEAR,
+                                  GIMP_XCF_COMPRESSION_ZLIB);
+}
+
+/**
+ * write_and_read_zstd_every_precision:
+ * @data:
+ *
+ * Writes zstd compressed images of every precision, whose layers
+ * hold a gradient, a ramp and noise, so that different tile
+ * predictors get picked, and makes sure the loaded pixels are the
+ * same bits.
+ **/
+static void
+write_and_read_zstd_every_precision (gconstpointer data)
+{
+  Gimp                *gimp         = GIMP (data);
+  const GimpPrecision  precisions[] =
+  {
+    GIMP_PRECISION_U8_LINEAR,
+    GIMP_PRECISION_U8_NON_LINEAR,
+    GIMP_PRECISION_U16_LINEAR,
+    GIMP_PRECISION_U16_NON_LINEAR,
+    GIMP_PRECISION_U32_LINEAR,
+    GIMP_PRECISION_U32_NON_LINEAR,
+    GIMP_PRECISION_HALF_LINEAR,
+    GIMP_PRECISION_HALF_NON_LINEAR,
+    GIMP_PRECISION_FLOAT_LINEAR,
+    GIMP_PRECISION_FLOAT_NON_LINEAR,
+    GIMP_PRECISION_DOUBLE_LINEAR,
+    GIMP_PRECISION_DOUBLE_NON_LINEAR
+  };
+  gint                 i;
+
+  for (i = 0; i < G_N_ELEMENTS (precisions); i++)
+    gimp_write_and_read_pixelimage (gimp,
+                                    precisions[i],
+                                    GIMP_XCF_COMPRESSION_ZSTD);
+}
+
+/**
+ * predict_and_restore_every_predictor:
+ * @data:
+ *
+ * Filters random tile data with every predictor for 1, 2, 4 and 8
+ * bytes per component, and makes sure decoding the byte planes gives
+ * back the same data.  Paeth can't be decoded for 8 bytes per
+ * component, and unknown predictors can't be decoded at all.
+ **/
+static void
+predict_and_restore_every_predictor (gconstpointer data)
+{
+  const gint  bpcs[] = { 1, 2, 4, 8 };
+  gint        width  = GIMP_PREDICTOR_TILE_WIDTH;
+  gint        height = GIMP_PREDICTOR_TILE_HEIGHT;
+  GRand      *rand;
+  gint        i;
+
+  rand = g_rand_new_with_seed (42);
+
+  for (i = 0; i < G_N_ELEMENTS (bpcs); i++)
+    {
+      gint              bpc  = bpcs[i];
+      gsize             size = (gsize) width * height * bpc *
+                               GIMP_PREDICTOR_N_COMPONENTS;
+      guchar           *pixels;
+      guchar           *tile;
+      guchar           *planes;
+      XcfPredictorType  predictor;
+      gsize             j;
+
+      pixels = g_malloc (size);
+      tile   = g_malloc (size);
+      planes = g_malloc (size);
+
+      for (j = 0; j < size; j++)
+        pixels[j] = g_rand_int_range (rand, 0, 256);
+
+      predictor = xcf_predictor_choose (pixels, width, height, bpc,
+                                        GIMP_PREDICTOR_N_COMPONENTS);
+
+      g_assert_true (predictor == XCF_PREDICTOR_NONE ||
+                     predictor == XCF_PREDICTOR_SUB  ||
+                     (predictor == XCF_PREDICTOR_PAETH && bpc <= 4));
+
+      for (predictor = XCF_PREDICTOR_NONE;
+           predictor <= XCF_PREDICTOR_PAETH;
+           predictor++)
+        {
+          if (predictor == XCF_PREDICTOR_PAETH && bpc > 4)
+            {
+              g_assert_false (xcf_predictor_decode (predictor, planes, tile,
+                                                    width, height, bpc,
+                                                    GIMP_PREDICTOR_N_COMPONENTS));
+              continue;
+            }
+
+          memcpy (tile, pixels, size);
+
+          xcf_predictor_encode (predictor, tile, planes,
+                                width, height, bpc,
+                                GIMP_PREDICTOR_N_COMPONENTS);
+
+          memset (tile, 0, size);
+
+          g_assert_true (xcf_predictor_decode (predictor, planes, tile,
+                                               width, height, bpc,
+                                               GIMP_PREDICTOR_N_COMPONENTS));
+          g_assert_true (memcmp (tile, pixels, size) == 0);
+        }
+
+      g_assert_false (xcf_predictor_decode (XCF_PREDICTOR_PAETH + 1,
+                                            planes, tile,
+                                            width, height, bpc,
+                                            GIMP_PREDICTOR_N_COMPONENTS));
+
+      g_free (pixels);
+      g_free (tile);
+      g_free (planes);
+    }
+
+  g_rand_free (rand);
+}
+
+/**
+ * append_and_compact:
+ * @data:
+ *
+ * With incremental saving, saves an image, then changes a few tiles
+ * and saves it twice more.  Makes sure these saves are appended to
+ * the file without touching what was already written, that the file
+ * loads with the latest pixels each time, and that compacting it
+ * shrinks it and still loads the same pixels.
+ **/
+static void
+append_and_compact (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  GimpImage *loaded_image;
+  GFile     *file;
+  GList     *iter;
+  gchar     *contents;
+  gsize      size;
+  gsize      compact_size;
+  gint       i;
+
+  g_object_set (gimp->config,
+                "xcf-incremental-save", TRUE,
+                NULL);
+
+  image = gimp_create_pixelimage (gimp, GIMP_PRECISION_U16_NON_LINEAR);
+  gimp_image_set_xcf_compression (image, GIMP_XCF_COMPRESSION_ZSTD);
+
+  file = gimp_test_new_file ();
+  gimp_test_save_image (gimp, image, file);
+
+  g_assert_true (g_file_load_contents (file, NULL, &contents, &size,
+                                       NULL, NULL));
+
+  for (i = 0, iter = gimp_image_get_layer_iter (image);
+       iter;
+       i++, iter = g_list_next (iter))
+    {
+      GeglColor *color = gegl_color_new ("red");
+      gchar     *new_contents;
+      gsize      new_size;
+
+      gegl_buffer_set_color (gimp_drawable_get_buffer (iter->data),
+                             GEGL_RECTANGLE (10 + 50 * i, 20, 10, 10),
+                             color);
+      g_object_unref (color);
+
+      gimp_test_save_image (gimp, image, file);
+
+      g_assert_true (g_file_load_contents (file, NULL,
+                                           &new_contents, &new_size,
+                                           NULL, NULL));
+
+      /*  only a few tiles and the header were appended, and the
+       *  file's previous contents, after the commit slots, are intact
+       */
+      g_assert_cmpuint (new_size, >, size);
+      g_assert_cmpuint (new_size - size, <, size / 2);
+      g_assert_true (memcmp (contents     + XCF_COMMIT_SLOTS_END,
+                             new_contents + XCF_COMMIT_SLOTS_END,
+                             size - XCF_COMMIT_SLOTS_END) == 0);
+
+      g_free (contents);
+      contents = new_contents;
+      size     = new_size;
+
+      loaded_image = gimp_test_load_image (gimp, file);
+      g_assert_nonnull (loaded_image);
+      gimp_assert_same_pixels (image, loaded_image);
+      g_object_unref (loaded_image);
+    }
+
+  g_free (contents);
+
+  /*  what "Compact" in the File menu does  */
+  xcf_drop_incremental_state (image);
+  gimp_test_save_image (gimp, image, file);
+
+  g_assert_true (g_file_load_contents (file, NULL, &contents, &compact_size,
+                                       NULL, NULL));
+  g_assert_cmpuint (compact_size, <, size);
+  g_free (contents);
+
+  loaded_image = gimp_test_load_image (gimp, file);
+  g_assert_nonnull (loaded_image);
+  gimp_assert_same_pixels (image, loaded_image);
+  g_object_unref (loaded_image);
+
+  g_object_set (gimp->config,
+                "xcf-incremental-save", FALSE,
+                NULL);
+
+  g_object_unref (image);
+
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+}
+
+/**
+ * lazy_load_matches_eager_load:
+ * @data:
+ *
+ * Loads the same RLE, zlib and zstd files once right away and once
+ * lazily, i.e. mapping the file and decoding tiles only when they are
+ * read, and makes sure the layers hold the same pixels.
+ **/
+static void
+lazy_load_matches_eager_load (gconstpointer data)
+{
+  Gimp                     *gimp           = GIMP (data);
+  const GimpXcfCompression  compressions[] =
+  {
+    GIMP_XCF_COMPRESSION_NONE,
+    GIMP_XCF_COMPRESSION_ZLIB,
+    GIMP_XCF_COMPRESSION_ZSTD
+  };
+  gboolean                  lazy_load;
+  gint                      i;
+
+  g_object_get (gimp->config,
+                "xcf-lazy-load", &lazy_load,
+                NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (compressions); i++)
+    {
+      GimpImage *image;
+      GimpImage *eager_image;
+      GimpImage *lazy_image;
+      GFile     *file;
+
+      image = gimp_create_pixelimage (gimp, GIMP_PRECISION_FLOAT_LINEAR);
+      gimp_image_set_xcf_compression (image, compressions[i]);
+
+      file = gimp_test_new_file ();
+      gimp_test_save_image (gimp, image, file);
+
+      g_object_set (gimp->config,
+                    "xcf-lazy-load", FALSE,
+                    NULL);
+      eager_image = gimp_test_load_image (gimp, file);
+      g_assert_nonnull (eager_image);
+
+      g_object_set (gimp->config,
+                    "xcf-lazy-load", TRUE,
+                    NULL);
+      lazy_image = gimp_test_load_image (gimp, file);
+      g_assert_nonnull (lazy_image);
+
+      gimp_assert_same_pixels (eager_image, lazy_image);
+      gimp_assert_same_pixels (image, lazy_image);
+
+      g_object_unref (lazy_image);
+      g_object_unref (eager_image);
+      g_object_unref (image);
+
+      g_file_delete (file, NULL, NULL);
+      g_object_unref (file);
+    }
+
+  g_object_set (gimp->config,
+                "xcf-lazy-load", lazy_load,
+                NULL);
+}
+
 GimpImage *
 gimp_test_load_image (Gimp  *gimp,
                       GFile *file)
@@ -362,6 +689,242 @@ gimp_write_and_read_file (Gimp     *gimp,
   g_object_unref (file);
 }
 
+/**
+ * gimp_test_new_file:
+ *
+ * Returns: A #GFile for a new, empty temporary XCF file
+ **/
+static GFile *
+gimp_test_new_file (void)
+{
+  gchar *filename = NULL;
+  gint   file_handle;
+  GFile *file;
+
+  file_handle = g_file_open_tmp ("gimp-test-XXXXXX.xcf", &filename, NULL);
+  g_assert_true (file_handle != -1);
+  close (file_handle);
+  file = g_file_new_for_path (filename);
+  g_free (filename);
+
+  return file;
+}
+
+static void
+gimp_test_save_image (Gimp      *gimp,
+                      GimpImage *image,
+                      GFile     *file)
+{
+  GimpPlugInProcedure *proc;
+  GimpPDBStatusType    status;
+
+  proc = gimp_plug_in_manager_file_procedure_find (gimp->plug_in_manager,
+                                                   GIMP_FILE_PROCEDURE_GROUP_SAVE,
+                                                   file,
+                                                   NULL /*error*/);
+  status = file_save (gimp,
+                      image,
+                      NULL /*progress*/,
+                      file,
+                      proc,
+                      GIMP_RUN_NONINTERACTIVE,
+                      FALSE /*change_saved_state*/,
+                      FALSE /*export_backward*/,
+                      FALSE /*export_forward*/,
+                      NULL /*error*/);
+
+  g_assert_cmpint (status, ==, GIMP_PDB_SUCCESS);
+}
+
+/**
+ * gimp_write_and_read_pixelimage:
+ *
+ * Constructs the pixel test image with @precision, writes it to a
+ * file with @compression, reads it back, and asserts that the loaded
+ * image has the same compression and pixels.
+ **/
+static void
+gimp_write_and_read_pixelimage (Gimp               *gimp,
+                                GimpPrecision       precision,
+                                GimpXcfCompression  compression)
+{
+  GimpImage *image;
+  GimpImage *loaded_image;
+  GFile     *file;
+
+  image = gimp_create_pixelimage (gimp, precision);
+  gimp_image_set_xcf_compression (image, compression);
+
+  file = gimp_test_new_file ();
+  gimp_test_save_image (gimp, image, file);
+
+  loaded_image = gimp_test_load_image (gimp, file);
+  g_assert_nonnull (loaded_image);
+
+  g_assert_cmpint (gimp_image_get_xcf_compression (loaded_image), ==,
+                   compression);
+  gimp_assert_same_pixels (image, loaded_image);
+
+  g_object_unref (loaded_image);
+  g_object_unref (image);
+
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+}
+
+/**
+ * gimp_create_pixelimage:
+ *
+ * Creates an image with @precision whose layers hold a smooth 2D
+ * gradient, a horizontal ramp and noise, for testing how the pixels
+ * are stored.
+ *
+ * Returns: The #GimpImage
+ **/
+static GimpImage *
+gimp_create_pixelimage (Gimp          *gimp,
+                        GimpPrecision  precision)
+{
+  const gchar *names[GIMP_PIXELIMAGE_N_LAYERS] =
+  {
+    "gradient", "ramp", "noise"
+  };
+  GimpImage   *image;
+  GRand       *rand;
+  gdouble     *pixels;
+  gint         width  = GIMP_PIXELIMAGE_WIDTH;
+  gint         height = GIMP_PIXELIMAGE_HEIGHT;
+  gint         i;
+
+  image = gimp_image_new (gimp, width, height, GIMP_RGB, precision);
+
+  rand   = g_rand_new_with_seed (precision);
+  pixels = g_new (gdouble, width * height * 4);
+
+  for (i = 0; i < GIMP_PIXELIMAGE_N_LAYERS; i++)
+    {
+      GimpLayer *layer;
+      gdouble   *p = pixels;
+      gint       x, y;
+
+      for (y = 0; y < height; y++)
+        {
+          for (x = 0; x < width; x++, p += 4)
+            {
+              gdouble u = (gdouble) x / (width  - 1);
+              gdouble v = (gdouble) y / (height - 1);
+
+              switch (i)
+                {
+                case 0:
+                  p[0] = u;
+                  p[1] = v;
+                  p[2] = (u + v) / 2.0;
+                  p[3] = 1.0 - u / 2.0;
+                  break;
+
+                case 1:
+                  p[0] = p[1] = p[2] = u;
+                  p[3] = 1.0;
+                  break;
+
+                default:
+                  p[0] = g_rand_double (rand);
+                  p[1] = g_rand_double (rand);
+                  p[2] = g_rand_double (rand);
+                  p[3] = g_rand_double (rand);
+                  break;
+                }
+            }
+        }
+
+      layer = gimp_layer_new (image,
+                              width,
+                              height,
+                              gimp_image_get_layer_format (image, TRUE),
+                              names[i],
+                              GIMP_OPACITY_OPAQUE,
+                              GIMP_LAYER_MODE_NORMAL);
+
+      gegl_buffer_set (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                       GEGL_RECTANGLE (0, 0, width, height), 0,
+                       babl_format ("RGBA double"), pixels,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      gimp_image_add_layer (image,
+                            layer,
+                            NULL,
+                            0,
+                            FALSE/*push_undo*/);
+    }
+
+  g_free (pixels);
+  g_rand_free (rand);
+
+  return image;
+}
+
+/**
+ * gimp_assert_same_pixels:
+ *
+ * Asserts that the layers of @loaded_image have the same size, format
+ * and pixels, bit for bit, as the layers of @image.
+ **/
+static void
+gimp_assert_same_pixels (GimpImage *image,
+                         GimpImage *loaded_image)
+{
+  GList *iter;
+  GList *loaded_iter;
+
+  g_assert_cmpint (gimp_image_get_precision (loaded_image), ==,
+                   gimp_image_get_precision (image));
+  g_assert_cmpint (gimp_image_get_n_layers (loaded_image), ==,
+                   gimp_image_get_n_layers (image));
+
+  for (iter = gimp_image_get_layer_iter (image),
+       loaded_iter = gimp_image_get_layer_iter (loaded_image);
+       iter && loaded_iter;
+       iter = g_list_next (iter), loaded_iter = g_list_next (loaded_iter))
+    {
+      GimpDrawable *drawable        = iter->data;
+      GimpDrawable *loaded_drawable = loaded_iter->data;
+      const Babl   *format          = gimp_drawable_get_format (drawable);
+      gint          width           = gimp_item_get_width  (GIMP_ITEM (drawable));
+      gint          height          = gimp_item_get_height (GIMP_ITEM (drawable));
+      gsize         size;
+      guchar       *pixels;
+      guchar       *loaded_pixels;
+
+      g_assert_cmpstr (gimp_object_get_name (loaded_drawable), ==,
+                       gimp_object_get_name (drawable));
+      g_assert_true (gimp_drawable_get_format (loaded_drawable) == format);
+      g_assert_cmpint (gimp_item_get_width  (GIMP_ITEM (loaded_drawable)), ==,
+                       width);
+      g_assert_cmpint (gimp_item_get_height (GIMP_ITEM (loaded_drawable)), ==,
+                       height);
+
+      size = (gsize) width * height * babl_format_get_bytes_per_pixel (format);
+
+      pixels        = g_malloc (size);
+      loaded_pixels = g_malloc (size);
+
+      gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                       GEGL_RECTANGLE (0, 0, width, height),
+                       1.0, format, pixels,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      gegl_buffer_get (gimp_drawable_get_buffer (loaded_drawable),
+                       GEGL_RECTANGLE (0, 0, width, height),
+                       1.0, format, loaded_pixels,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      g_assert_true (memcmp (pixels, loaded_pixels, size) == 0);
+
+      g_free (pixels);
+      g_free (loaded_pixels);
+    }
+}
+
 /**
  * gimp_create_mainimage:
  *
@@ -1101,6 +1664,11 @@ main (int    argc,
   ADD_TEST (write_and_read_gimp_2_6_format_unusual);
   ADD_TEST (load_gimp_2_6_file);
   ADD_TEST (write_and_read_gimp_2_8_format);
+  ADD_TEST (write_and_read_zlib_pixels);
+  ADD_TEST (write_and_read_zstd_every_precision);
+  ADD_TEST (predict_and_restore_every_predictor);
+  ADD_TEST (append_and_compact);
+  ADD_TEST (lazy_load_matches_eager_load);
 
   /* Don't write files to the source dir */
   gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
@@ -34,6 +34,7 @@
 #define GIMP_HELP_FILE_SAVE_AS                    "gimp-file-save-as"
 #define GIMP_HELP_FILE_SAVE_A_COPY                "gimp-file-save-a-copy"
 #define GIMP_HELP_FILE_SAVE_BY_EXTENSION          "gimp-file-save-by-extension"
+#define GIMP_HELP_FILE_COMPACT                    "gimp-file-compact"
 #define GIMP_HELP_FILE_EXPORT                     "gimp-file-export"
 #define GIMP_HELP_FILE_EXPORT_AS                  "gimp-file-export-as"
 #define GIMP_HELP_FILE_OVERWRITE                  "gimp-file-overwrite"
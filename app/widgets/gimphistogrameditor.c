@@ -26,12 +26,15 @@
 
 #include "widgets-types.h"
 
+#include "gegl/gimp-gegl-utils.h"
+
 #include "core/gimp.h"
 #include "core/gimpasync.h"
 #include "core/gimpdrawable.h"
 #include "core/gimpdrawable-histogram.h"
 #include "core/gimphistogram.h"
 #include "core/gimpimage.h"
+#include "core/gimpwaitable.h"
 
 #include "gimpdocked.h"
 #include "gimphelp-ids.h"
@@ -88,7 +91,17 @@ static void     gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor
                                                      const GParamSpec    *pspec);
 static void     gimp_histogram_editor_buffer_update (GimpHistogramEditor *editor,
                                                      const GParamSpec    *pspec);
+static void     gimp_histogram_editor_drawable_update
+                                                    (GimpDrawable        *drawable,
+                                                     gint                 x,
+                                                     gint                 y,
+                                                     gint                 width,
+                                                     gint                 height,
+                                                     GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_invalidate    (GimpHistogramEditor *editor);
 static void     gimp_histogram_editor_update        (GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_clear_snapshot
+                                                    (GimpHistogramEditor *editor);
 
 static gboolean gimp_histogram_editor_idle_update   (GimpHistogramEditor *editor);
 static gboolean gimp_histogram_menu_sensitivity     (gint                 value,
@@ -153,6 +166,8 @@ gimp_histogram_editor_init (GimpHistogramEditor *editor)
       N_("Percentile: ")
     };
 
+  editor->dirty_region = cairo_region_create ();
+
   editor->box = gimp_histogram_box_new ();
 
   gimp_editor_set_show_name (GIMP_EDITOR (editor), TRUE);
@@ -279,8 +294,13 @@ gimp_histogram_editor_docked_iface_init (GimpDockedInterface *docked_iface)
 static void
 gimp_histogram_editor_finalize (GObject *object)
 {
-  if (GIMP_HISTOGRAM_EDITOR (object)->idle_id)
-    g_source_remove (GIMP_HISTOGRAM_EDITOR (object)->idle_id);
+  GimpHistogramEditor *editor = GIMP_HISTOGRAM_EDITOR (object);
+
+  if (editor->idle_id)
+    g_source_remove (editor->idle_id);
+
+  g_clear_object (&editor->snapshot);
+  g_clear_pointer (&editor->dirty_region, cairo_region_destroy);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -299,6 +319,8 @@ gimp_histogram_editor_set_property (GObject      *object,
     case PROP_TRC:
       editor->trc = g_value_get_enum (value);
 
+      gimp_histogram_editor_clear_snapshot (editor);
+
       if (editor->histogram)
         {
           g_clear_object (&editor->histogram);
@@ -389,7 +411,7 @@ gimp_histogram_editor_set_image (GimpImageEditor *image_editor,
       editor->update_pending = FALSE;
 
       g_signal_handlers_disconnect_by_func (image_editor->image,
-                                            gimp_histogram_editor_update,
+                                            gimp_histogram_editor_invalidate,
                                             editor);
       g_signal_handlers_disconnect_by_func (image_editor->image,
                                             gimp_histogram_editor_layer_changed,
@@ -422,7 +444,7 @@ gimp_histogram_editor_set_image (GimpImageEditor *image_editor,
                                G_CALLBACK (gimp_histogram_editor_layer_changed),
                                editor, 0);
       g_signal_connect_object (image, "mask-changed",
-                               G_CALLBACK (gimp_histogram_editor_update),
+                               G_CALLBACK (gimp_histogram_editor_invalidate),
                                editor, G_CONNECT_SWAPPED);
     }
 
@@ -443,6 +465,8 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
     {
       GimpHistogramView *view = GIMP_HISTOGRAM_BOX (editor->box)->view;
 
+      gimp_histogram_editor_clear_snapshot (editor);
+
       if (editor->histogram)
         {
           g_clear_object (&editor->histogram);
@@ -462,7 +486,10 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                             gimp_histogram_editor_menu_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
-                                            gimp_histogram_editor_update,
+                                            gimp_histogram_editor_drawable_update,
+                                            editor);
+      g_signal_handlers_disconnect_by_func (editor->drawable,
+                                            gimp_histogram_editor_invalidate,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
                                             gimp_histogram_editor_buffer_update,
@@ -500,7 +527,13 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                G_CALLBACK (gimp_histogram_editor_buffer_update),
                                editor, G_CONNECT_SWAPPED);
       g_signal_connect_object (editor->drawable, "update",
-                               G_CALLBACK (gimp_histogram_editor_update),
+                               G_CALLBACK (gimp_histogram_editor_drawable_update),
+                               editor, 0);
+      g_signal_connect_object (editor->drawable, "notify::offset-x",
+                               G_CALLBACK (gimp_histogram_editor_invalidate),
+                               editor, G_CONNECT_SWAPPED);
+      g_signal_connect_object (editor->drawable, "notify::offset-y",
+                               G_CALLBACK (gimp_histogram_editor_invalidate),
                                editor, G_CONNECT_SWAPPED);
       g_signal_connect_object (editor->drawable, "alpha-changed",
                                G_CALLBACK (gimp_histogram_editor_menu_update),
@@ -540,6 +573,11 @@ gimp_histogram_editor_calculate_async_callback (GimpAsync           *async,
 
       gimp_histogram_editor_info_update (editor);
     }
+  else
+    {
+      /*  the snapshot doesn't match the histogram's values  */
+      gimp_histogram_editor_clear_snapshot (editor);
+    }
 
   editor->bg_pending = FALSE;
 
@@ -547,6 +585,42 @@ gimp_histogram_editor_calculate_async_callback (GimpAsync           *async,
     gimp_histogram_editor_update (editor);
 }
 
+/* applies the changes of the drawable since the snapshot was taken to
+ * the histogram, instead of recalculating it.
+ */
+static gboolean
+gimp_histogram_editor_apply_dirty (GimpHistogramEditor *editor)
+{
+  gboolean success = TRUE;
+  gint     n_rects;
+  gint     i;
+
+  if (editor->calculate_async)
+    gimp_waitable_wait (GIMP_WAITABLE (editor->calculate_async));
+
+  if (! editor->snapshot || ! editor->histogram)
+    return FALSE;
+
+  n_rects = cairo_region_num_rectangles (editor->dirty_region);
+
+  for (i = 0; success && i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (editor->dirty_region, i, &rect);
+
+      success = gimp_drawable_update_histogram (editor->drawable,
+                                                editor->histogram,
+                                                editor->snapshot,
+                                                (GeglRectangle *) &rect);
+    }
+
+  cairo_region_destroy (editor->dirty_region);
+  editor->dirty_region = cairo_region_create ();
+
+  return success;
+}
+
 static gboolean
 gimp_histogram_editor_validate (GimpHistogramEditor *editor)
 {
@@ -566,6 +640,15 @@ gimp_histogram_editor_validate (GimpHistogramEditor *editor)
         {
           GimpAsync *async;
 
+          if (gimp_histogram_editor_apply_dirty (editor))
+            {
+              gimp_histogram_editor_info_update (editor);
+
+              goto done;
+            }
+
+          gimp_histogram_editor_clear_snapshot (editor);
+
           if (! editor->histogram)
             {
               GimpHistogramView *view = GIMP_HISTOGRAM_BOX (editor->box)->view;
@@ -580,6 +663,14 @@ gimp_histogram_editor_validate (GimpHistogramEditor *editor)
               gimp_histogram_view_set_histogram (view, editor->histogram);
             }
 
+          /*  the histogram of the drawable's buffer as it is now can
+           *  be updated incrementally afterwards.  the copy is cheap,
+           *  since the tiles are shared until they are written to.
+           */
+          if (! gimp_drawable_has_visible_filters (editor->drawable))
+            editor->snapshot =
+              gimp_gegl_buffer_dup (gimp_drawable_get_buffer (editor->drawable));
+
           async = gimp_drawable_calculate_histogram_async (editor->drawable,
                                                            editor->histogram,
                                                            TRUE);
@@ -595,11 +686,14 @@ gimp_histogram_editor_validate (GimpHistogramEditor *editor)
         }
       else if (editor->histogram)
         {
+          gimp_histogram_editor_clear_snapshot (editor);
+
           gimp_histogram_clear_values (editor->histogram, 0);
 
           gimp_histogram_editor_info_update (editor);
         }
 
+    done:
       editor->recompute = FALSE;
 
       if (editor->idle_id)
@@ -672,6 +766,8 @@ static void
 gimp_histogram_editor_buffer_update (GimpHistogramEditor *editor,
                                      const GParamSpec    *pspec)
 {
+  gimp_histogram_editor_clear_snapshot (editor);
+
   g_object_set (editor,
                 "trc", gimp_drawable_get_trc (editor->drawable),
                 NULL);
@@ -689,7 +785,8 @@ gimp_histogram_editor_update (GimpHistogramEditor *editor)
 
   editor->update_pending = FALSE;
 
-  if (editor->calculate_async)
+  /*  a calculation with a snapshot can be updated once it's done  */
+  if (editor->calculate_async && ! editor->snapshot)
     gimp_async_cancel_and_wait (editor->calculate_async);
 
   if (editor->idle_id)
@@ -703,6 +800,44 @@ gimp_histogram_editor_update (GimpHistogramEditor *editor)
                         NULL);
 }
 
+static void
+gimp_histogram_editor_drawable_update (GimpDrawable        *drawable,
+                                       gint                 x,
+                                       gint                 y,
+                                       gint                 width,
+                                       gint                 height,
+                                       GimpHistogramEditor *editor)
+{
+  if (editor->snapshot)
+    {
+      cairo_region_union_rectangle (editor->dirty_region,
+                                    &(cairo_rectangle_int_t) { x, y,
+                                                               width, height });
+    }
+
+  gimp_histogram_editor_update (editor);
+}
+
+static void
+gimp_histogram_editor_invalidate (GimpHistogramEditor *editor)
+{
+  gimp_histogram_editor_clear_snapshot (editor);
+
+  gimp_histogram_editor_update (editor);
+}
+
+static void
+gimp_histogram_editor_clear_snapshot (GimpHistogramEditor *editor)
+{
+  g_clear_object (&editor->snapshot);
+
+  if (! cairo_region_is_empty (editor->dirty_region))
+    {
+      cairo_region_destroy (editor->dirty_region);
+      editor->dirty_region = cairo_region_create ();
+    }
+}
+
 static gboolean
 gimp_histogram_editor_idle_update (GimpHistogramEditor *editor)
 {
@@ -47,6 +47,9 @@ struct _GimpHistogramEditor
   gboolean              bg_pending;
   gboolean              update_pending;
 
+  GeglBuffer           *snapshot;
+  cairo_region_t       *dirty_region;
+
   GtkWidget            *menu;
   GtkWidget            *box;
   GtkWidget            *labels[7];
@@ -0,0 +1,415 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Incremental saving appends the tiles which changed since the last
+ * save to the end of the file it was saved to, followed by a new image
+ * header whose level tables point at the previously written data of
+ * all other tiles.  Nothing written by earlier saves is touched, except
+ * for one of the two fixed-size commit slots after the version tag,
+ * which is pointed at the new header once everything else is on the
+ * disk (see xcf_save_commit()).  An interrupted save therefore leaves
+ * the previous header in effect.
+ *
+ * The state of the last save is kept per image, and the location of
+ * every saved tile is kept per GeglBuffer, along with a bitmap of the
+ * tiles written to since, which is maintained from the buffer's
+ * "changed" signal.  A record only describes the file written by the
+ * save with the same generation, anything else is saved from scratch.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "gegl/gimp-gegl-tile-compat.h"
+#include "gegl/gimptilehandlervalidate.h"
+
+#include "core/gimpimage.h"
+
+#include "xcf-private.h"
+#include "xcf-incremental.h"
+
+#include "gimp-log.h"
+
+
+#define XCF_INCREMENTAL_KEY  "gimp-xcf-incremental"
+#define XCF_TILE_RECORD_KEY  "gimp-xcf-tile-record"
+
+#define XCF_FILE_ATTRIBUTES  G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+                             G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+                             G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+
+typedef struct
+{
+  GMutex      mutex;
+
+  guint       generation;
+  const Babl *format;
+  gint        width;
+  gint        height;
+  gint        n_tile_cols;
+  gint        n_tiles;
+  goffset    *offsets;
+  gint       *data_lengths;
+  guint8     *dirty;
+} XcfTileRecord;
+
+
+static void       xcf_incremental_free          (XcfIncremental      *incremental);
+static gboolean   xcf_incremental_query_file    (GFile               *file,
+                                                 guint64             *file_size,
+                                                 guint64             *mtime,
+                                                 guint32             *mtime_usec);
+
+static void       xcf_tile_record_free          (XcfTileRecord       *record);
+static void       xcf_tile_record_changed       (GeglBuffer          *buffer,
+                                                 const GeglRectangle *rect,
+                                                 XcfTileRecord       *record);
+
+
+static guint xcf_incremental_generation = 0;
+
+
+/*  public functions  */
+
+guint
+xcf_incremental_new_generation (void)
+{
+  /* 0 means "not tracked" */
+  if (++xcf_incremental_generation == 0)
+    xcf_incremental_generation = 1;
+
+  return xcf_incremental_generation;
+}
+
+XcfIncremental *
+xcf_incremental_get (GimpImage *image)
+{
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+
+  return g_object_get_data (G_OBJECT (image), XCF_INCREMENTAL_KEY);
+}
+
+void
+xcf_incremental_set (GimpImage          *image,
+                     GFile              *file,
+                     guint               generation,
+                     gint                file_version,
+                     XcfCompressionType  compression,
+                     guint32             sequence,
+                     goffset             live_bytes)
+{
+  XcfIncremental *incremental;
+
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (generation != 0);
+
+  incremental = g_slice_new0 (XcfIncremental);
+
+  if (! xcf_incremental_query_file (file,
+                                    &incremental->file_size,
+                                    &incremental->mtime,
+                                    &incremental->mtime_usec))
+    {
+      g_slice_free (XcfIncremental, incremental);
+      xcf_incremental_clear (image);
+
+      return;
+    }
+
+  incremental->file         = g_object_ref (file);
+  incremental->generation   = generation;
+  incremental->file_version = file_version;
+  incremental->compression  = compression;
+  incremental->sequence     = sequence;
+  incremental->live_bytes   = live_bytes;
+
+  GIMP_LOG (XCF, "'%s': %" G_GUINT64_FORMAT " bytes, "
+            "%" G_GOFFSET_FORMAT " bytes live",
+            gimp_file_get_utf8_name (file),
+            incremental->file_size, live_bytes);
+
+  g_object_set_data_full (G_OBJECT (image), XCF_INCREMENTAL_KEY,
+                          incremental,
+                          (GDestroyNotify) xcf_incremental_free);
+}
+
+void
+xcf_incremental_clear (GimpImage *image)
+{
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  g_object_set_data (G_OBJECT (image), XCF_INCREMENTAL_KEY, NULL);
+}
+
+gboolean
+xcf_incremental_can_append (XcfIncremental     *incremental,
+                            GFile              *file,
+                            gint                file_version,
+                            XcfCompressionType  compression)
+{
+  guint64 file_size;
+  guint64 mtime;
+  guint32 mtime_usec;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+  if (! incremental                              ||
+      ! g_file_equal (incremental->file, file)   ||
+      incremental->file_version != file_version  ||
+      incremental->compression  != compression)
+    {
+      return FALSE;
+    }
+
+  /*  don't touch a file which was modified behind our back  */
+  if (! xcf_incremental_query_file (file, &file_size, &mtime, &mtime_usec) ||
+      file_size  != incremental->file_size                                 ||
+      mtime      != incremental->mtime                                     ||
+      mtime_usec != incremental->mtime_usec)
+    {
+      GIMP_LOG (XCF, "'%s' changed on disk, saving it from scratch",
+                gimp_file_get_utf8_name (file));
+
+      return FALSE;
+    }
+
+  /*  compact the file once it holds more garbage than live data  */
+  if (file_size - incremental->live_bytes > incremental->live_bytes)
+    {
+      GIMP_LOG (XCF, "'%s' has %" G_GOFFSET_FORMAT " unused bytes, "
+                "compacting it",
+                gimp_file_get_utf8_name (file),
+                (goffset) (file_size - incremental->live_bytes));
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+gboolean
+xcf_incremental_lookup_tiles (GeglBuffer *buffer,
+                              guint       generation,
+                              goffset    *offsets,
+                              gint       *data_lengths,
+                              gint        n_tiles)
+{
+  XcfTileRecord *record;
+  gint           n_clean = 0;
+  gint           i;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (offsets != NULL, FALSE);
+  g_return_val_if_fail (data_lengths != NULL, FALSE);
+
+  record = g_object_get_data (G_OBJECT (buffer), XCF_TILE_RECORD_KEY);
+
+  if (! record || generation == 0)
+    return FALSE;
+
+  g_mutex_lock (&record->mutex);
+
+  if (record->generation == generation                           &&
+      record->format     == gegl_buffer_get_format (buffer)      &&
+      record->width      == gegl_buffer_get_width (buffer)       &&
+      record->height     == gegl_buffer_get_height (buffer)      &&
+      record->n_tiles    == n_tiles)
+    {
+      for (i = 0; i < n_tiles; i++)
+        {
+          if (! record->dirty[i])
+            {
+              offsets[i]      = record->offsets[i];
+              data_lengths[i] = record->data_lengths[i];
+
+              n_clean++;
+            }
+        }
+    }
+
+  g_mutex_unlock (&record->mutex);
+
+  GIMP_LOG (XCF, "reusing %d of %d tiles", n_clean, n_tiles);
+
+  return n_clean > 0;
+}
+
+void
+xcf_incremental_track_tiles (GeglBuffer    *buffer,
+                             guint          generation,
+                             const goffset *offsets,
+                             const gint    *data_lengths,
+                             gint           n_tiles)
+{
+  XcfTileRecord *record;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (offsets != NULL);
+  g_return_if_fail (data_lengths != NULL);
+
+  /*  the contents of projection buffers change without the buffer
+   *  noticing, so they are always saved from scratch.
+   */
+  if (generation == 0 || gimp_tile_handler_validate_get_assigned (buffer))
+    return;
+
+  record = g_object_get_data (G_OBJECT (buffer), XCF_TILE_RECORD_KEY);
+
+  if (! record)
+    {
+      record = g_slice_new0 (XcfTileRecord);
+
+      g_mutex_init (&record->mutex);
+
+      g_object_set_data_full (G_OBJECT (buffer), XCF_TILE_RECORD_KEY,
+                              record,
+                              (GDestroyNotify) xcf_tile_record_free);
+
+      gegl_buffer_signal_connect (buffer, "changed",
+                                  G_CALLBACK (xcf_tile_record_changed),
+                                  record);
+    }
+
+  g_mutex_lock (&record->mutex);
+
+  if (record->n_tiles != n_tiles)
+    {
+      g_free (record->offsets);
+      g_free (record->data_lengths);
+      g_free (record->dirty);
+
+      record->offsets      = g_new  (goffset, n_tiles);
+      record->data_lengths = g_new  (gint,    n_tiles);
+      record->dirty        = g_new0 (guint8,  n_tiles);
+      record->n_tiles      = n_tiles;
+    }
+  else
+    {
+      memset (record->dirty, 0, n_tiles);
+    }
+
+  record->generation  = generation;
+  record->format      = gegl_buffer_get_format (buffer);
+  record->width       = gegl_buffer_get_width (buffer);
+  record->height      = gegl_buffer_get_height (buffer);
+  record->n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer,
+                                                          XCF_TILE_WIDTH);
+
+  memcpy (record->offsets,      offsets,      n_tiles * sizeof (goffset));
+  memcpy (record->data_lengths, data_lengths, n_tiles * sizeof (gint));
+
+  g_mutex_unlock (&record->mutex);
+}
+
+
+/*  private functions  */
+
+static void
+xcf_incremental_free (XcfIncremental *incremental)
+{
+  g_clear_object (&incremental->file);
+
+  g_slice_free (XcfIncremental, incremental);
+}
+
+static gboolean
+xcf_incremental_query_file (GFile   *file,
+                            guint64 *file_size,
+                            guint64 *mtime,
+                            guint32 *mtime_usec)
+{
+  GFileInfo *info;
+
+  info = g_file_query_info (file, XCF_FILE_ATTRIBUTES,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, NULL);
+
+  if (! info)
+    return FALSE;
+
+  *file_size  = g_file_info_get_attribute_uint64 (info,
+                                                  G_FILE_ATTRIBUTE_STANDARD_SIZE);
+  *mtime      = g_file_info_get_attribute_uint64 (info,
+                                                  G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  *mtime_usec = g_file_info_get_attribute_uint32 (info,
+                                                  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+static void
+xcf_tile_record_free (XcfTileRecord *record)
+{
+  g_mutex_clear (&record->mutex);
+
+  g_free (record->offsets);
+  g_free (record->data_lengths);
+  g_free (record->dirty);
+
+  g_slice_free (XcfTileRecord, record);
+}
+
+/* may be called from any thread writing to the buffer */
+static void
+xcf_tile_record_changed (GeglBuffer          *buffer,
+                         const GeglRectangle *rect,
+                         XcfTileRecord       *record)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer);
+  GeglRectangle        area;
+  gint                 col, row;
+
+  if (! gegl_rectangle_intersect (&area, rect, extent))
+    return;
+
+  area.x -= extent->x;
+  area.y -= extent->y;
+
+  g_mutex_lock (&record->mutex);
+
+  if (record->n_tile_cols > 0)
+    {
+      for (row = area.y / XCF_TILE_HEIGHT;
+           row * XCF_TILE_HEIGHT < area.y + area.height;
+           row++)
+        {
+          for (col = area.x / XCF_TILE_WIDTH;
+               col * XCF_TILE_WIDTH < area.x + area.width;
+               col++)
+            {
+              gint i = row * record->n_tile_cols + col;
+
+              if (i < record->n_tiles)
+                record->dirty[i] = TRUE;
+            }
+        }
+    }
+
+  g_mutex_unlock (&record->mutex);
+}
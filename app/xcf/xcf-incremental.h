@@ -0,0 +1,65 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+typedef struct _XcfIncremental XcfIncremental;
+
+struct _XcfIncremental
+{
+  GFile              *file;
+  guint64             file_size;
+  guint64             mtime;
+  guint32             mtime_usec;
+
+  guint               generation;
+  gint                file_version;
+  XcfCompressionType  compression;
+
+  guint32             sequence;     /* of the last save's commit slot    */
+  goffset             live_bytes;   /* bytes referenced by the last save */
+};
+
+
+guint            xcf_incremental_new_generation (void);
+
+XcfIncremental * xcf_incremental_get            (GimpImage          *image);
+void             xcf_incremental_set            (GimpImage          *image,
+                                                 GFile              *file,
+                                                 guint               generation,
+                                                 gint                file_version,
+                                                 XcfCompressionType  compression,
+                                                 guint32             sequence,
+                                                 goffset             live_bytes);
+void             xcf_incremental_clear          (GimpImage          *image);
+
+gboolean         xcf_incremental_can_append     (XcfIncremental     *incremental,
+                                                 GFile              *file,
+                                                 gint                file_version,
+                                                 XcfCompressionType  compression);
+
+gboolean         xcf_incremental_lookup_tiles   (GeglBuffer         *buffer,
+                                                 guint               generation,
+                                                 goffset            *offsets,
+                                                 gint               *data_lengths,
+                                                 gint                n_tiles);
+void             xcf_incremental_track_tiles    (GeglBuffer         *buffer,
+                                                 guint               generation,
+                                                 const goffset      *offsets,
+                                                 const gint         *data_lengths,
+                                                 gint                n_tiles);
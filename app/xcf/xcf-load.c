@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <zlib.h>
+#include <zstd.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -89,8 +90,10 @@
 
 #include "xcf-private.h"
 #include "xcf-load.h"
+#include "xcf-predictor.h"
 #include "xcf-read.h"
 #include "xcf-seek.h"
+#include "xcf-tile-handler.h"
 #include "xcf-utils.h"
 
 #include "gimp-log.h"
@@ -156,9 +159,32 @@ typedef struct
   GimpMatrix3           matrix;
 } LayerTransformData;
 
+/* Per thread data for xcf_load_tile_parallel */
+typedef struct
+{
+  /* Common to all jobs. */
+  GeglBuffer         *buffer;
+  gint                file_version;
+  XcfCompressionType  compression;
+  gint                max_in_data_len;
+
+  /* Job specific. */
+  gint                tile;
+  gint                batch_size;
+  guchar             *in_data;
+  gint                in_data_len[XCF_TILE_LOAD_BATCH_SIZE];
+
+  /* Temp data to avoid too many allocations. */
+  guchar             *tile_data;
+
+  /* Return data. */
+  gboolean            failed;
+} XcfLoadJobData;
+
 static void            xcf_load_add_masks     (GimpImage     *image);
 static void            xcf_load_add_effects   (XcfInfo       *info,
                                                GimpImage     *image);
+static gboolean        xcf_load_find_header   (XcfInfo       *info);
 static gboolean        xcf_load_image_props   (XcfInfo       *info,
                                                GimpImage     *image);
 static gboolean        xcf_load_layer_props   (XcfInfo       *info,
@@ -217,16 +243,31 @@ static gboolean        xcf_load_tile          (XcfInfo       *info,
                                                GeglBuffer    *buffer,
                                                GeglRectangle *tile_rect,
                                                const Babl    *format);
-static gboolean        xcf_load_tile_rle      (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
+static void            xcf_load_free_job_data (XcfLoadJobData *data);
+static void            xcf_load_tile_parallel (XcfLoadJobData *job_data,
+                                               GAsyncQueue    *queue);
+static gboolean        xcf_load_tile_rle      (GeglRectangle *tile_rect,
+                                               const guchar  *xcfdata,
+                                               gint           data_length,
                                                const Babl    *format,
-                                               gint           data_length);
-static gboolean        xcf_load_tile_zlib     (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
+                                               guchar        *tile_data,
+                                               gboolean      *nonzero_ptr);
+static gboolean        xcf_load_tile_zlib     (GeglRectangle *tile_rect,
+                                               const guchar  *xcfdata,
+                                               gint           data_length,
                                                const Babl    *format,
-                                               gint           data_length);
+                                               guchar        *tile_data);
+static gboolean        xcf_load_tile_zstd     (GeglRectangle *tile_rect,
+                                               const guchar  *xcfdata,
+                                               gint           data_length,
+                                               const Babl    *format,
+                                               guchar        *tile_data);
+static gboolean        xcf_load_tile_zstd_predict
+                                              (GeglRectangle *tile_rect,
+                                               const guchar  *xcfdata,
+                                               gint           data_length,
+                                               const Babl    *format,
+                                               guchar        *tile_data);
 static GimpParasite  * xcf_load_parasite      (XcfInfo       *info);
 static gboolean        xcf_load_old_paths     (XcfInfo       *info,
                                                GimpImage     *image);
@@ -281,6 +322,10 @@ xcf_load_image (Gimp     *gimp,
   GList              *syms;
   GList              *iter;
 
+  /* since version 27, the header is wherever the last save put it */
+  if (info->file_version >= 27 && ! xcf_load_find_header (info))
+    goto hard_error;
+
   /* read in the image width, height and type */
   xcf_read_int32 (info, (guint32 *) &width, 1);
   xcf_read_int32 (info, (guint32 *) &height, 1);
@@ -1316,6 +1361,82 @@ xcf_load_add_effects (XcfInfo   *info,
   g_list_free (layers);
 }
 
+/* reads the commit slots following the version tag, and seeks to the
+ * header of the valid slot with the highest sequence number.  a slot is
+ * valid if both its own and its header's checksum match, so a save
+ * interrupted before its slot was completely written falls back to the
+ * header of the previous save.
+ */
+static gboolean
+xcf_load_find_header (XcfInfo *info)
+{
+  guint8   slots[XCF_N_COMMIT_SLOTS][XCF_COMMIT_SLOT_SIZE];
+  goffset  header_pos  = 0;
+  guint32  sequence    = 0;
+  gboolean found       = FALSE;
+  gint     i;
+
+  if (xcf_read_int8 (info, (guint8 *) slots, sizeof (slots)) != sizeof (slots))
+    return FALSE;
+
+  for (i = 0; i < XCF_N_COMMIT_SLOTS; i++)
+    {
+      guint32  value32;
+      guint64  value64;
+      guint32  slot_sequence;
+      guint64  pos;
+      guint64  size;
+      guint32  crc;
+      guint8  *data;
+
+      memcpy (&value32, slots[i], 4);
+      if (GUINT32_FROM_BE (value32) != XCF_COMMIT_MAGIC)
+        continue;
+
+      memcpy (&value32, slots[i] + 28, 4);
+      if (GUINT32_FROM_BE (value32) != crc32 (0, slots[i], 28))
+        continue;
+
+      memcpy (&value32, slots[i] + 4, 4);
+      slot_sequence = GUINT32_FROM_BE (value32);
+      memcpy (&value64, slots[i] + 8, 8);
+      pos = GUINT64_FROM_BE (value64);
+      memcpy (&value64, slots[i] + 16, 8);
+      size = GUINT64_FROM_BE (value64);
+      memcpy (&value32, slots[i] + 24, 4);
+      crc = GUINT32_FROM_BE (value32);
+
+      if ((found && slot_sequence <= sequence) ||
+          pos < XCF_COMMIT_SLOTS_END           ||
+          size == 0 || size > G_MAXINT)
+        continue;
+
+      if (! xcf_seek_pos (info, pos, NULL))
+        continue;
+
+      data = g_try_malloc (size);
+
+      if (data &&
+          xcf_read_int8 (info, data, (gint) size) == size &&
+          crc32 (0, data, size) == crc)
+        {
+          header_pos = pos;
+          sequence   = slot_sequence;
+          found      = TRUE;
+        }
+
+      g_free (data);
+    }
+
+  if (! found)
+    return FALSE;
+
+  GIMP_LOG (XCF, "header at %" G_GOFFSET_FORMAT ", sequence %u",
+            header_pos, sequence);
+
+  return xcf_seek_pos (info, header_pos, NULL);
+}
+
 static gboolean
 xcf_load_image_props (XcfInfo   *info,
                       GimpImage *image)
@@ -1394,7 +1515,8 @@ xcf_load_image_props (XcfInfo   *info,
             if ((compression != COMPRESS_NONE) &&
                 (compression != COMPRESS_RLE) &&
                 (compression != COMPRESS_ZLIB) &&
-                (compression != COMPRESS_FRACTAL))
+                (compression != COMPRESS_FRACTAL) &&
+                (compression != COMPRESS_ZSTD))
               {
                 gimp_message (info->gimp, G_OBJECT (info->progress),
                               GIMP_MESSAGE_ERROR,
@@ -1405,8 +1527,23 @@ xcf_load_image_props (XcfInfo   *info,
 
             info->compression = compression;
 
-            gimp_image_set_xcf_compression (image,
-                                            compression >= COMPRESS_ZLIB);
+            switch (compression)
+              {
+              case COMPRESS_ZLIB:
+                gimp_image_set_xcf_compression (image,
+                                                GIMP_XCF_COMPRESSION_ZLIB);
+                break;
+
+              case COMPRESS_ZSTD:
+                gimp_image_set_xcf_compression (image,
+                                                GIMP_XCF_COMPRESSION_ZSTD);
+                break;
+
+              default:
+                gimp_image_set_xcf_compression (image,
+                                                GIMP_XCF_COMPRESSION_NONE);
+                break;
+              }
 
             GIMP_LOG (XCF, "prop compression=%d", compression);
           }
@@ -4336,9 +4473,9 @@ xcf_load_level (XcfInfo    *info,
 {
   const Babl *format;
   gint        bpp;
-  goffset     saved_pos;
   goffset     offset;
-  goffset     offset2;
+  goffset    *offsets;
+  gint       *data_lengths;
   goffset     max_data_length;
   gint        n_tile_rows;
   gint        n_tile_cols;
@@ -4346,7 +4483,7 @@ xcf_load_level (XcfInfo    *info,
   gint        width;
   gint        height;
   gint        i;
-  gint        fail;
+  gboolean    success = TRUE;
 
   format = gegl_buffer_get_format (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
@@ -4378,123 +4515,300 @@ xcf_load_level (XcfInfo    *info,
   if (offset == 0)
     return TRUE;
 
+  switch (info->compression)
+    {
+    case COMPRESS_NONE:
+    case COMPRESS_RLE:
+    case COMPRESS_ZLIB:
+    case COMPRESS_ZSTD:
+      break;
+    case COMPRESS_FRACTAL:
+      g_printerr ("xcf: fractal compression unimplemented. "
+                  "Possibly corrupt XCF file.");
+      return FALSE;
+    default:
+      g_printerr ("xcf: unknown compression. "
+                  "Possibly corrupt XCF file.");
+      return FALSE;
+    }
+
   n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
   ntiles = n_tile_rows * n_tile_cols;
-  for (i = 0; i < ntiles; i++)
+
+  /* read the whole offset table up front, so the tile data can be
+   * fetched in batches without seeking back after each tile.  the
+   * table has ntiles + 1 slots because a zero offset indicates the
+   * offset table's end.  Do not use g_alloca since it may cause Stack
+   * Overflow on large images, see issue #6138.
+   */
+  offsets      = g_new (goffset, ntiles + 1);
+  data_lengths = g_new (gint, ntiles);
+
+  offsets[0] = offset;
+
+  for (i = 1; i <= ntiles; i += XCF_TILE_LOAD_BATCH_SIZE)
     {
-      GeglRectangle rect;
+      gint count = MIN (XCF_TILE_LOAD_BATCH_SIZE, ntiles + 1 - i);
 
-      fail = FALSE;
+      if (xcf_read_offset (info, offsets + i, count) <
+          count * info->bytes_per_offset)
+        {
+          GIMP_LOG (XCF, "Failed to read tile offset"
+                    " at offset: %" G_GOFFSET_FORMAT, info->cp);
+          success = FALSE;
+          goto out;
+        }
+    }
 
-      if (offset == 0)
+  if (offsets[ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %" G_GOFFSET_FORMAT,
+                    offsets[ntiles]);
+      success = FALSE;
+      goto out;
+    }
+
+  /* since version 27, the offset table is followed by the tiles' data
+   * lengths.  incrementally saved files refer to the data of unchanged
+   * tiles from earlier saves, so their offsets are not ordered.
+   */
+  if (info->file_version >= 27 &&
+      xcf_read_int32 (info, (guint32 *) data_lengths, ntiles) < ntiles * 4)
+    {
+      GIMP_LOG (XCF, "Failed to read tile data lengths"
+                " at offset: %" G_GOFFSET_FORMAT, info->cp);
+      success = FALSE;
+      goto out;
+    }
+
+  for (i = 0; i < ntiles; i++)
+    {
+      goffset offset2;
+
+      if (offsets[i] == 0)
         {
           gimp_message_literal (info->gimp, G_OBJECT (info->progress),
                                 GIMP_MESSAGE_ERROR,
                                 "not enough tiles found in level");
-          return FALSE;
+          success = FALSE;
+          goto out;
         }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
-       */
-      saved_pos = info->cp;
-
-      /* read in the offset of the next tile so we can calculate the amount
-       * of data needed for this tile
-       */
-      if (xcf_read_offset (info, &offset2, 1) < info->bytes_per_offset)
+      if (info->file_version >= 27)
         {
-          GIMP_LOG (XCF, "Failed to read tile offset"
-                    " at offset: %" G_GOFFSET_FORMAT, info->cp);
-          return FALSE;
+          offset2 = offsets[i] + data_lengths[i];
+        }
+      else
+        {
+          /* if the next offset is 0 then we need to read in the maximum
+           * possible allowing for negative compression
+           */
+          offset2 = offsets[i + 1];
+          if (offset2 == 0)
+            offset2 = offsets[i] + max_data_length;
         }
 
-      /* if the offset is 0 then we need to read in the maximum possible
-       * allowing for negative compression
-       */
-      if (offset2 == 0)
-        offset2 = offset + max_data_length;
-
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
-
-      if (offset2 < offset || offset2 - offset > max_data_length)
+      if (offset2 < offsets[i] || offset2 - offsets[i] > max_data_length)
         {
           gimp_message (info->gimp, G_OBJECT (info->progress),
                         GIMP_MESSAGE_ERROR,
                         "invalid tile data length: %" G_GOFFSET_FORMAT,
-                        offset2 - offset);
-          return FALSE;
+                        offset2 - offsets[i]);
+          success = FALSE;
+          goto out;
         }
 
-      /* get buffer rectangle to write to */
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+      data_lengths[i] = offset2 - offsets[i];
+    }
+
+  if (info->mapping)
+    {
+      gsize file_size;
 
-      GIMP_LOG (XCF, "loading tile %d/%d", i + 1, ntiles);
+      file_size = g_bytes_get_size (xcf_mapping_get_bytes (info->mapping));
 
-      /* read in the tile */
-      switch (info->compression)
+      /* only defer decoding if all the tile data is inside the mapped
+       * file, a corrupt file is rather reported by loading it right
+       * away.  the last tile's data length of older files is a guess,
+       * which may reach past the end of the file.
+       */
+      for (i = 0; i < ntiles; i++)
         {
-        case COMPRESS_NONE:
-          if (! xcf_load_tile (info, buffer, &rect, format))
-            fail = TRUE;
-          break;
-        case COMPRESS_RLE:
-          if (! xcf_load_tile_rle (info, buffer, &rect, format,
-                                   offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_ZLIB:
-          if (! xcf_load_tile_zlib (info, buffer, &rect, format,
-                                    offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_FRACTAL:
-          g_printerr ("xcf: fractal compression unimplemented. "
-                      "Possibly corrupt XCF file.");
-          fail = TRUE;
-          break;
-        default:
-          g_printerr ("xcf: unknown compression. "
-                      "Possibly corrupt XCF file.");
-          fail = TRUE;
-          break;
+          if (offsets[i] + data_lengths[i] <= file_size)
+            continue;
+
+          if (i == ntiles - 1         &&
+              info->file_version < 27 &&
+              offsets[i] < file_size)
+            {
+              data_lengths[i] = file_size - offsets[i];
+            }
+          else
+            {
+              GIMP_LOG (XCF, "tile %d is outside of the mapped file, "
+                        "not deferring decoding", i);
+              break;
+            }
         }
 
-      if (fail)
-        return FALSE;
+      if (i == ntiles)
+        {
+          GeglTileHandler *handler;
 
-      GIMP_LOG (XCF, "loaded tile %d/%d", i + 1, ntiles);
+          GIMP_LOG (XCF, "deferring decoding of %d tiles", ntiles);
 
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+          handler = gimp_tile_handler_xcf_new (info->mapping,
+                                               info->compression,
+                                               info->file_version,
+                                               format, width, height,
+                                               offsets, data_lengths);
+          gimp_tile_handler_xcf_assign (GIMP_TILE_HANDLER_XCF (handler),
+                                        buffer);
+          g_object_unref (handler);
 
-      /* read in the offset of the next tile */
-      if (xcf_read_offset (info, &offset, 1) < info->bytes_per_offset)
-        {
-          GIMP_LOG (XCF, "Failed to read tile offset"
-                    " at offset: %" G_GOFFSET_FORMAT, info->cp);
-          return FALSE;
+          /* the handler took ownership of the tables */
+          return TRUE;
         }
     }
 
-  if (offset != 0)
+  if (info->compression == COMPRESS_NONE)
     {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %" G_GOFFSET_FORMAT,
-                    offset);
-      return FALSE;
+      /* non parallel implementation, there is nothing to decode */
+      for (i = 0; i < ntiles && success; i++)
+        {
+          GeglRectangle rect;
+
+          if (! xcf_seek_pos (info, offsets[i], NULL))
+            {
+              success = FALSE;
+              break;
+            }
+
+          /* get buffer rectangle to write to */
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          i, &rect);
+
+          GIMP_LOG (XCF, "loading tile %d/%d", i + 1, ntiles);
+
+          success = xcf_load_tile (info, buffer, &rect, format);
+        }
     }
+  else
+    {
+      /* parallel implementation */
+      XcfLoadJobData *job_data;
+      GThreadPool    *pool;
+      GAsyncQueue    *queue;
+      gint            num_processors;
+      gint            num_tasks;
+      gint            n_jobs    = 0;
+      gint            tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+      gint            k;
+
+      num_processors = GIMP_GEGL_CONFIG (info->gimp->config)->num_processors;
+
+      /* We keep more tasks around than there are threads, ensuring threads
+       * always have something to do while the next batch is being read.
+       * This also bounds the amount of compressed data held in memory.
+       */
+      num_tasks = num_processors * 2;
 
-  return TRUE;
+      queue = g_async_queue_new ();
+      pool  = g_thread_pool_new ((GFunc) xcf_load_tile_parallel,
+                                 queue, num_processors, TRUE, NULL);
+
+      i = 0;
+      while (i < ntiles)
+        {
+          if (n_jobs < num_tasks)
+            {
+              job_data = g_new (XcfLoadJobData, 1);
+              job_data->buffer          = buffer;
+              job_data->file_version    = info->file_version;
+              job_data->compression     = info->compression;
+              job_data->max_in_data_len = max_data_length;
+              job_data->tile_data       = g_malloc (tile_size);
+              job_data->in_data         = g_malloc (max_data_length *
+                                                    XCF_TILE_LOAD_BATCH_SIZE);
+              n_jobs++;
+            }
+          else
+            {
+              /* Recycle a finished job. */
+              job_data = g_async_queue_pop (queue);
+
+              if (job_data->failed)
+                {
+                  xcf_load_free_job_data (job_data);
+                  success = FALSE;
+                  break;
+                }
+            }
+
+          job_data->tile       = i;
+          job_data->batch_size = MIN (XCF_TILE_LOAD_BATCH_SIZE, ntiles - i);
+          job_data->failed     = FALSE;
+
+          GIMP_LOG (XCF, "reading tiles %d-%d/%d",
+                    i + 1, i + job_data->batch_size, ntiles);
+
+          for (k = 0; k < job_data->batch_size; k++)
+            {
+              gsize bytes_read;
+
+              if (! xcf_seek_pos (info, offsets[i + k], NULL))
+                {
+                  success = FALSE;
+                  break;
+                }
+
+              /* we have to read directly instead of xcf_read_* because we
+               * may be reading past the end of the file here
+               */
+              g_input_stream_read_all (info->input,
+                                       job_data->in_data +
+                                       job_data->max_in_data_len * k,
+                                       data_lengths[i + k],
+                                       &bytes_read, NULL, NULL);
+              info->cp += bytes_read;
+
+              job_data->in_data_len[k] = bytes_read;
+            }
+
+          if (! success)
+            {
+              xcf_load_free_job_data (job_data);
+              break;
+            }
+
+          i += job_data->batch_size;
+
+          g_thread_pool_push (pool, job_data, NULL);
+        }
+
+      /* Wait for all remaining tasks to finish decoding. */
+      g_thread_pool_free (pool, FALSE, TRUE);
+
+      while ((job_data = g_async_queue_try_pop (queue)))
+        {
+          if (job_data->failed)
+            success = FALSE;
+
+          xcf_load_free_job_data (job_data);
+        }
+
+      g_async_queue_unref (queue);
+    }
+
+ out:
+  g_free (data_lengths);
+  g_free (offsets);
+
+  return success;
 }
 
 static gboolean
@@ -4528,22 +4842,71 @@ xcf_load_tile (XcfInfo       *info,
   return TRUE;
 }
 
-static gboolean
-xcf_load_tile_rle (XcfInfo       *info,
-                   GeglBuffer    *buffer,
-                   GeglRectangle *tile_rect,
-                   const Babl    *format,
-                   gint           data_length)
+static void
+xcf_load_free_job_data (XcfLoadJobData *data)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  guchar  nonzero   = FALSE;
-  gsize   bytes_read;
-  gint    i;
-  guchar *xcfdata;
-  guchar *xcfodata;
-  guchar *xcfdatalimit;
+  g_free (data->in_data);
+  g_free (data->tile_data);
+  g_free (data);
+}
+
+static void
+xcf_load_tile_parallel (XcfLoadJobData *job_data,
+                        GAsyncQueue    *queue)
+{
+  const Babl    *format;
+  GeglRectangle  tile_rect;
+
+  format = gegl_buffer_get_format (job_data->buffer);
+
+  for (gint i = 0; i < job_data->batch_size; ++i)
+    {
+      gboolean has_data;
+
+      gimp_gegl_buffer_get_tile_rect (job_data->buffer,
+                                      XCF_TILE_WIDTH,
+                                      XCF_TILE_HEIGHT,
+                                      job_data->tile + i,
+                                      &tile_rect);
+
+      if (! xcf_load_tile_decode (job_data->compression,
+                                  job_data->file_version,
+                                  &tile_rect, format,
+                                  job_data->in_data +
+                                  job_data->max_in_data_len * i,
+                                  job_data->in_data_len[i],
+                                  job_data->tile_data,
+                                  &has_data))
+        {
+          job_data->failed = TRUE;
+          break;
+        }
+
+      /* each job covers distinct tiles, so the threads never write to
+       * the same area of the buffer.
+       */
+      if (has_data)
+        gegl_buffer_set (job_data->buffer, &tile_rect, 0, format,
+                         job_data->tile_data, GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_async_queue_push (queue, job_data);
+}
+
+gboolean
+xcf_load_tile_decode (XcfCompressionType  compression,
+                      gint                file_version,
+                      GeglRectangle      *tile_rect,
+                      const Babl         *format,
+                      const guchar       *xcfdata,
+                      gint                data_length,
+                      guchar             *tile_data,
+                      gboolean           *has_data)
+{
+  gint bpp       = babl_format_get_bytes_per_pixel (format);
+  gint tile_size = bpp * tile_rect->width * tile_rect->height;
+
+  *has_data = FALSE;
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
    * this tile (return TRUE without storing data) as if it did not
@@ -4554,19 +4917,76 @@ xcf_load_tile_rle (XcfInfo       *info,
   if (data_length <= 0)
     return TRUE;
 
-  xcfdata = xcfodata = g_alloca (data_length);
+  switch (compression)
+    {
+    case COMPRESS_NONE:
+      if (data_length < tile_size)
+        return FALSE;
 
-  /* we have to read directly instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
-                           &bytes_read, NULL, NULL);
-  info->cp += bytes_read;
+      memcpy (tile_data, xcfdata, tile_size);
 
-  if (bytes_read == 0)
-    return TRUE;
+      *has_data = ! xcf_data_is_zero (tile_data, tile_size);
+      break;
+
+    case COMPRESS_RLE:
+      if (! xcf_load_tile_rle (tile_rect, xcfdata, data_length, format,
+                               tile_data, has_data))
+        return FALSE;
+      break;
+
+    case COMPRESS_ZLIB:
+      if (! xcf_load_tile_zlib (tile_rect, xcfdata, data_length, format,
+                                tile_data))
+        return FALSE;
+
+      *has_data = ! xcf_data_is_zero (tile_data, tile_size);
+      break;
 
-  xcfdatalimit = &xcfodata[bytes_read - 1];
+    case COMPRESS_ZSTD:
+      if (file_version >= 28)
+        {
+          if (! xcf_load_tile_zstd_predict (tile_rect, xcfdata, data_length,
+                                            format, tile_data))
+            return FALSE;
+        }
+      else if (! xcf_load_tile_zstd (tile_rect, xcfdata, data_length, format,
+                                     tile_data))
+        {
+          return FALSE;
+        }
+
+      *has_data = ! xcf_data_is_zero (tile_data, tile_size);
+      break;
+
+    default:
+      g_return_val_if_reached (FALSE);
+    }
+
+  if (*has_data && file_version >= 12)
+    {
+      gint n_components = babl_format_get_n_components (format);
+
+      xcf_read_from_be (bpp / n_components, tile_data,
+                        tile_size / bpp * n_components);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+xcf_load_tile_rle (GeglRectangle *tile_rect,
+                   const guchar  *xcfdata,
+                   gint           data_length,
+                   const Babl    *format,
+                   guchar        *tile_data,
+                   gboolean      *nonzero_ptr)
+{
+  gint          bpp     = babl_format_get_bytes_per_pixel (format);
+  guchar        nonzero = FALSE;
+  gint          i;
+  const guchar *xcfdatalimit;
+
+  xcfdatalimit = &xcfdata[data_length - 1];
 
   for (i = 0; i < bpp; i++)
     {
@@ -4660,19 +5080,7 @@ xcf_load_tile_rle (XcfInfo       *info,
         }
     }
 
-  if (nonzero)
-    {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
-
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
-        }
-
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
-    }
+  *nonzero_ptr = nonzero;
 
   return TRUE;
 
@@ -4681,41 +5089,17 @@ xcf_load_tile_rle (XcfInfo       *info,
 }
 
 static gboolean
-xcf_load_tile_zlib (XcfInfo       *info,
-                    GeglBuffer    *buffer,
-                    GeglRectangle *tile_rect,
+xcf_load_tile_zlib (GeglRectangle *tile_rect,
+                    const guchar  *xcfdata,
+                    gint           data_length,
                     const Babl    *format,
-                    gint           data_length)
+                    guchar        *tile_data)
 {
   z_stream  strm;
   int       action;
   int       status;
   gint      bpp       = babl_format_get_bytes_per_pixel (format);
   gint      tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar   *tile_data = g_alloca (tile_size);
-  gsize     bytes_read;
-  guchar   *xcfdata;
-
-  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
-   */
-  if (data_length <= 0)
-    return TRUE;
-
-  xcfdata = g_alloca (data_length);
-
-  /* we have to read directly instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
-                           &bytes_read, NULL, NULL);
-  info->cp += bytes_read;
-
-  if (bytes_read == 0)
-    return TRUE;
 
   strm.next_out  = tile_data;
   strm.avail_out = tile_size;
@@ -4723,8 +5107,8 @@ xcf_load_tile_zlib (XcfInfo       *info,
   strm.zalloc    = Z_NULL;
   strm.zfree     = Z_NULL;
   strm.opaque    = Z_NULL;
-  strm.next_in   = xcfdata;
-  strm.avail_in  = bytes_read;
+  strm.next_in   = (Bytef *) xcfdata;
+  strm.avail_in  = data_length;
 
   /* Initialize the stream decompression. */
   status = inflateInit (&strm);
@@ -4761,25 +5145,85 @@ xcf_load_tile_zlib (XcfInfo       *info,
         }
     }
 
-  if (! xcf_data_is_zero (tile_data, tile_size))
-    {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
+  inflateEnd (&strm);
 
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
-        }
+  return TRUE;
+}
 
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
+static gboolean
+xcf_load_tile_zstd (GeglRectangle *tile_rect,
+                    const guchar  *xcfdata,
+                    gint           data_length,
+                    const Babl    *format,
+                    guchar        *tile_data)
+{
+  gint   bpp       = babl_format_get_bytes_per_pixel (format);
+  gint   tile_size = bpp * tile_rect->width * tile_rect->height;
+  size_t frame_size;
+  size_t size;
+
+  /* the data length of the last tile may reach past the end of the
+   * frame, so only hand the frame itself to the decoder.
+   */
+  frame_size = ZSTD_findFrameCompressedSize (xcfdata, data_length);
+  if (ZSTD_isError (frame_size))
+    {
+      g_printerr ("xcf: tile decompression failed: %s",
+                  ZSTD_getErrorName (frame_size));
+      return FALSE;
     }
 
-  inflateEnd (&strm);
+  size = ZSTD_decompress (tile_data, tile_size, xcfdata, frame_size);
+  if (ZSTD_isError (size))
+    {
+      g_printerr ("xcf: tile decompression failed: %s",
+                  ZSTD_getErrorName (size));
+      return FALSE;
+    }
+  else if (size != tile_size)
+    {
+      g_printerr ("xcf: decompressed tile size doesn't match the expected size.");
+      return FALSE;
+    }
 
   return TRUE;
 }
 
+static gboolean
+xcf_load_tile_zstd_predict (GeglRectangle *tile_rect,
+                            const guchar  *xcfdata,
+                            gint           data_length,
+                            const Babl    *format,
+                            guchar        *tile_data)
+{
+  gint     bpp          = babl_format_get_bytes_per_pixel (format);
+  gint     n_components = babl_format_get_n_components (format);
+  gint     tile_size    = bpp * tile_rect->width * tile_rect->height;
+  guchar  *planes;
+  gboolean success;
+
+  if (data_length < 2)
+    return FALSE;
+
+  planes = g_malloc (tile_size);
+
+  success = xcf_load_tile_zstd (tile_rect, xcfdata + 1, data_length - 1,
+                                format, planes);
+
+  if (success &&
+      ! xcf_predictor_decode (xcfdata[0], planes, tile_data,
+                              tile_rect->width, tile_rect->height,
+                              bpp / n_components, n_components))
+    {
+      g_printerr ("xcf: unknown tile predictor %d.", xcfdata[0]);
+      success = FALSE;
+    }
+
+  g_free (planes);
+
+  return success;
+}
+
 static GimpParasite *
 xcf_load_parasite (XcfInfo *info)
 {
@@ -18,6 +18,15 @@
 #pragma once
 
 
-GimpImage * xcf_load_image (Gimp     *gimp,
-                            XcfInfo  *info,
-                            GError  **error);
+GimpImage * xcf_load_image       (Gimp                *gimp,
+                                  XcfInfo             *info,
+                                  GError             **error);
+
+gboolean    xcf_load_tile_decode (XcfCompressionType   compression,
+                                  gint                 file_version,
+                                  GeglRectangle       *tile_rect,
+                                  const Babl          *format,
+                                  const guchar        *xcfdata,
+                                  gint                 data_length,
+                                  guchar              *tile_data,
+                                  gboolean            *has_data);
@@ -0,0 +1,315 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Tile predictors, applied to the big-endian tile data before it is
+ * zstd compressed.
+ *
+ * Every component is replaced by its difference to a prediction made
+ * from the already seen neighbor components of the same channel, like
+ * PNG's "Sub" and "Paeth" filters do for bytes, modulo the component
+ * size.  The result is then split into byte planes, so that the mostly
+ * zero high bytes of the differences end up next to each other, which
+ * is what makes noisy high bit-depth data compressible at all.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "core/core-types.h"
+
+#include "xcf-private.h"
+#include "xcf-predictor.h"
+
+
+static inline guint64
+xcf_predictor_get (const guchar *p,
+                   gint          bpc)
+{
+  switch (bpc)
+    {
+    case 1:
+      return p[0];
+    case 2:
+      return ((guint64) p[0] << 8) | p[1];
+    case 4:
+      return ((guint64) p[0] << 24) | ((guint64) p[1] << 16) |
+             ((guint64) p[2] <<  8) |            p[3];
+    default:
+      {
+        guint64 v = 0;
+        gint    i;
+
+        for (i = 0; i < bpc; i++)
+          v = (v << 8) | p[i];
+
+        return v;
+      }
+    }
+}
+
+static inline void
+xcf_predictor_put (guchar  *p,
+                   gint     bpc,
+                   guint64  v)
+{
+  gint i;
+
+  for (i = bpc - 1; i >= 0; i--)
+    {
+      p[i] = v & 0xff;
+      v >>= 8;
+    }
+}
+
+static inline guint64
+xcf_predictor_paeth (guint64 a,
+                     guint64 b,
+                     guint64 c)
+{
+  /* only used for components of up to 32 bits */
+  gint64 p  = (gint64) a + (gint64) b - (gint64) c;
+  gint64 pa = ABS (p - (gint64) a);
+  gint64 pb = ABS (p - (gint64) b);
+  gint64 pc = ABS (p - (gint64) c);
+
+  if (pa <= pb && pa <= pc)
+    return a;
+  else if (pb <= pc)
+    return b;
+  else
+    return c;
+}
+
+static inline guint64
+xcf_predictor_predict (XcfPredictorType  predictor,
+                       const guchar     *p,
+                       gint              x,
+                       gint              y,
+                       gint              bpc,
+                       gint              bpp,
+                       gint              stride)
+{
+  guint64 a = 0;
+  guint64 b = 0;
+  guint64 c = 0;
+
+  if (x > 0)
+    a = xcf_predictor_get (p - bpp, bpc);
+
+  if (predictor == XCF_PREDICTOR_SUB)
+    return a;
+
+  if (y > 0)
+    {
+      b = xcf_predictor_get (p - stride, bpc);
+
+      if (x > 0)
+        c = xcf_predictor_get (p - stride - bpp, bpc);
+    }
+
+  return xcf_predictor_paeth (a, b, c);
+}
+
+
+/*  public functions  */
+
+/* picks the predictor whose differences have the smallest sum of
+ * magnitudes of their high bytes, the heuristic PNG encoders use.
+ */
+XcfPredictorType
+xcf_predictor_choose (const guchar *data,
+                      gint          width,
+                      gint          height,
+                      gint          bpc,
+                      gint          n_components)
+{
+  gint    bpp     = bpc * n_components;
+  gint    stride  = bpp * width;
+  gint    shift   = 8 * (bpc - 1);
+  guint64 mask    = bpc < 8 ? ((guint64) 1 << (8 * bpc)) - 1 : G_MAXUINT64;
+  guint64 sums[3] = { 0, };
+  gint    x, y, i;
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *p = data + y * stride;
+
+      for (x = 0; x < width; x++)
+        {
+          for (i = 0; i < n_components; i++, p += bpc)
+            {
+              guint64 v = xcf_predictor_get (p, bpc);
+              guint64 a = 0;
+
+              if (x > 0)
+                a = xcf_predictor_get (p - bpp, bpc);
+
+              sums[XCF_PREDICTOR_NONE] += ABS ((gint8) (v >> shift));
+              sums[XCF_PREDICTOR_SUB]  += ABS ((gint8) (((v - a) & mask) >>
+                                                        shift));
+
+              if (bpc <= 4)
+                {
+                  guint64 pred;
+
+                  pred = xcf_predictor_predict (XCF_PREDICTOR_PAETH, p, x, y,
+                                                bpc, bpp, stride);
+
+                  pred = ((v - pred) & mask) >> shift;
+
+                  sums[XCF_PREDICTOR_PAETH] += ABS ((gint8) pred);
+                }
+            }
+        }
+    }
+
+  if (bpc > 4)
+    sums[XCF_PREDICTOR_PAETH] = G_MAXUINT64;
+
+  if (sums[XCF_PREDICTOR_PAETH] < sums[XCF_PREDICTOR_SUB] &&
+      sums[XCF_PREDICTOR_PAETH] < sums[XCF_PREDICTOR_NONE])
+    return XCF_PREDICTOR_PAETH;
+  else if (sums[XCF_PREDICTOR_SUB] < sums[XCF_PREDICTOR_NONE])
+    return XCF_PREDICTOR_SUB;
+
+  return XCF_PREDICTOR_NONE;
+}
+
+/* replaces @data by the predictor's differences, and stores their byte
+ * planes in @planes.
+ */
+void
+xcf_predictor_encode (XcfPredictorType  predictor,
+                      guchar           *data,
+                      guchar           *planes,
+                      gint              width,
+                      gint              height,
+                      gint              bpc,
+                      gint              n_components)
+{
+  gint bpp      = bpc * n_components;
+  gint stride   = bpp * width;
+  gint n_pixels = width * height;
+  gint x, y, i;
+
+  g_return_if_fail (predictor != XCF_PREDICTOR_PAETH || bpc <= 4);
+
+  if (predictor != XCF_PREDICTOR_NONE)
+    {
+      guint64 mask = bpc < 8 ? ((guint64) 1 << (8 * bpc)) - 1 : G_MAXUINT64;
+
+      /* go backwards, so the neighbors are still the original values */
+      for (y = height - 1; y >= 0; y--)
+        {
+          for (x = width - 1; x >= 0; x--)
+            {
+              guchar *p = data + y * stride + x * bpp;
+
+              for (i = 0; i < n_components; i++, p += bpc)
+                {
+                  guint64 pred = xcf_predictor_predict (predictor, p, x, y,
+                                                        bpc, bpp, stride);
+
+                  xcf_predictor_put (p, bpc,
+                                     (xcf_predictor_get (p, bpc) - pred) &
+                                     mask);
+                }
+            }
+        }
+    }
+
+  for (i = 0; i < bpp; i++)
+    {
+      const guchar *src = data + i;
+      guchar       *dest = planes + i * n_pixels;
+      gint          n;
+
+      for (n = 0; n < n_pixels; n++, src += bpp)
+        *dest++ = *src;
+    }
+}
+
+/* the inverse of xcf_predictor_encode(), reassembles the pixels from
+ * @planes into @data and undoes the prediction.
+ */
+gboolean
+xcf_predictor_decode (XcfPredictorType  predictor,
+                      const guchar     *planes,
+                      guchar           *data,
+                      gint              width,
+                      gint              height,
+                      gint              bpc,
+                      gint              n_components)
+{
+  gint bpp      = bpc * n_components;
+  gint stride   = bpp * width;
+  gint n_pixels = width * height;
+  gint x, y, i;
+
+  switch (predictor)
+    {
+    case XCF_PREDICTOR_NONE:
+    case XCF_PREDICTOR_SUB:
+      break;
+
+    case XCF_PREDICTOR_PAETH:
+      if (bpc > 4)
+        return FALSE;
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  for (i = 0; i < bpp; i++)
+    {
+      const guchar *src  = planes + i * n_pixels;
+      guchar       *dest = data + i;
+      gint          n;
+
+      for (n = 0; n < n_pixels; n++, dest += bpp)
+        *dest = *src++;
+    }
+
+  if (predictor != XCF_PREDICTOR_NONE)
+    {
+      guint64 mask = bpc < 8 ? ((guint64) 1 << (8 * bpc)) - 1 : G_MAXUINT64;
+
+      for (y = 0; y < height; y++)
+        {
+          guchar *p = data + y * stride;
+
+          for (x = 0; x < width; x++)
+            {
+              for (i = 0; i < n_components; i++, p += bpc)
+                {
+                  guint64 pred = xcf_predictor_predict (predictor, p, x, y,
+                                                        bpc, bpp, stride);
+
+                  xcf_predictor_put (p, bpc,
+                                     (xcf_predictor_get (p, bpc) + pred) &
+                                     mask);
+                }
+            }
+        }
+    }
+
+  return TRUE;
+}
@@ -0,0 +1,40 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+XcfPredictorType   xcf_predictor_choose (const guchar     *data,
+                                         gint              width,
+                                         gint              height,
+                                         gint              bpc,
+                                         gint              n_components);
+
+void               xcf_predictor_encode (XcfPredictorType  predictor,
+                                         guchar           *data,
+                                         guchar           *planes,
+                                         gint              width,
+                                         gint              height,
+                                         gint              bpc,
+                                         gint              n_components);
+gboolean           xcf_predictor_decode (XcfPredictorType  predictor,
+                                         const guchar     *planes,
+                                         guchar           *data,
+                                         gint              width,
+                                         gint              height,
+                                         gint              bpc,
+                                         gint              n_components);
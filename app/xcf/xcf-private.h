@@ -22,6 +22,20 @@
 #define XCF_TILE_HEIGHT                 64
 #define XCF_TILE_MAX_DATA_LENGTH_FACTOR 1.5
 #define XCF_TILE_SAVE_BATCH_SIZE        128
+#define XCF_TILE_LOAD_BATCH_SIZE        128
+
+/* since version 27, the version tag is followed by two fixed-size
+ * commit slots, each of them pointing at an image header written
+ * after the data it refers to.  a slot holds, big-endian, the magic,
+ * a sequence number, the offset and size of the header, the crc32 of
+ * the header and the crc32 of the slot's first 28 bytes.
+ */
+#define XCF_COMMIT_MAGIC                0x78636663 /* "xcfc" */
+#define XCF_COMMIT_SLOT_SIZE            32
+#define XCF_N_COMMIT_SLOTS              2
+#define XCF_COMMIT_SLOTS_POS            14
+#define XCF_COMMIT_SLOTS_END            (XCF_COMMIT_SLOTS_POS + \
+                                         XCF_COMMIT_SLOT_SIZE * XCF_N_COMMIT_SLOTS)
 
 typedef enum
 {
@@ -81,10 +95,21 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
-  COMPRESS_FRACTAL           =  3   /* unused */
+  COMPRESS_ZLIB              =  2,
+  COMPRESS_FRACTAL           =  3,  /* unused */
+  COMPRESS_ZSTD              =  4
 } XcfCompressionType;
 
+/* since version 28, zstd compressed tiles start with the predictor
+ * applied to the tile data, see xcf-predictor.c
+ */
+typedef enum
+{
+  XCF_PREDICTOR_NONE         =  0,
+  XCF_PREDICTOR_SUB          =  1,
+  XCF_PREDICTOR_PAETH        =  2
+} XcfPredictorType;
+
 typedef enum
 {
   XCF_ORIENTATION_HORIZONTAL = 1,
@@ -115,7 +140,8 @@ typedef enum
   FILTER_PROP_COLOR   = 8,
 } FilterPropType;
 
-typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfInfo    XcfInfo;
+typedef struct _XcfMapping XcfMapping;
 
 struct _XcfInfo
 {
@@ -148,4 +174,14 @@ struct _XcfInfo
   goffset             floating_sel_offset;
   XcfCompressionType  compression;
   gint                file_version;
+
+  /* the whole file, when lazily loading from a memory-mapped file */
+  XcfMapping         *mapping;
+
+  /* incremental saving, see xcf-incremental.c */
+  guint               generation;      /* tags the tile records of this save */
+  guint               prev_generation; /* the save appended to               */
+  gboolean            append;
+  guint32             commit_sequence; /* the commit slot's sequence        */
+  goffset             reused_bytes;
 };
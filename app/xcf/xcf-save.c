@@ -17,13 +17,23 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <string.h>
 #include <zlib.h>
+#include <zstd.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#ifdef G_OS_UNIX
+#include <gio/gfiledescriptorbased.h>
+#endif
+
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 #include "libgimpconfig/gimpconfig.h"
@@ -80,13 +90,23 @@
 #include "text/gimptextlayer-xcf.h"
 
 #include "xcf-private.h"
+#include "xcf-incremental.h"
+#include "xcf-predictor.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
 #include "xcf-seek.h"
 #include "xcf-write.h"
 
+#include "gimp-log.h"
+
 #include "gimp-intl.h"
 
+
+/* zstd's default level, it compresses about as well as zlib while
+ * being several times faster
+ */
+#define XCF_ZSTD_COMPRESSION_LEVEL 3
+
 typedef void (* CompressTileFunc) (GeglRectangle  *tile_rect,
                                    guchar         *tile_data,
                                    const Babl     *format,
@@ -102,6 +122,7 @@ typedef struct
   gint              file_version;
   gint              max_out_data_len;
   CompressTileFunc  compress;
+  const goffset    *reused_offsets;
 
   /* Job specific. */
   gint              tile;
@@ -115,6 +136,13 @@ typedef struct
   gint              out_data_len[XCF_TILE_SAVE_BATCH_SIZE];
 } XcfJobData;
 
+static gboolean xcf_save_sync          (XcfInfo           *info,
+                                        GError           **error);
+static gboolean xcf_save_commit        (XcfInfo           *info,
+                                        goffset            header_pos,
+                                        const guint8      *header_data,
+                                        gsize              header_size,
+                                        GError           **error);
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -195,6 +223,19 @@ static void     xcf_save_tile_zlib     (GeglRectangle     *tile_rect,
                                         guchar            *zlib_data,
                                         gint               zlib_data_max_len,
                                         gint              *lenptr);
+static void     xcf_save_tile_zstd     (GeglRectangle     *tile_rect,
+                                        guchar            *tile_data,
+                                        const Babl        *format,
+                                        guchar            *zstd_data,
+                                        gint               zstd_data_max_len,
+                                        gint              *lenptr);
+static void     xcf_save_tile_zstd_predict
+                                       (GeglRectangle     *tile_rect,
+                                        guchar            *tile_data,
+                                        const Babl        *format,
+                                        guchar            *zstd_data,
+                                        gint               zstd_data_max_len,
+                                        gint              *lenptr);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
                                         GError           **error);
@@ -307,49 +348,89 @@ xcf_save_image (XcfInfo    *info,
                 GimpImage  *image,
                 GError    **error)
 {
-  GList   *all_layers;
-  GList   *all_channels;
-  GList   *all_paths = NULL;
-  GList   *list;
-  goffset  saved_pos;
-  goffset  offset;
-  guint32  value;
-  guint    n_layers;
-  guint    n_channels;
-  guint    n_paths  = 0;
-  guint    progress = 0;
-  guint    max_progress;
-  gchar    version_tag[16];
-  gboolean write_paths = FALSE;
-  GError  *tmp_error   = NULL;
-
-  /* write out the tag information for the image */
-  if (info->file_version > 0)
-    {
-      g_snprintf (version_tag, sizeof (version_tag),
-                  "gimp xcf v%03d", info->file_version);
-    }
-  else
+  GList         *all_layers;
+  GList         *all_channels;
+  GList         *all_paths = NULL;
+  GList         *list;
+  GOutputStream *file_output   = NULL;
+  GSeekable     *file_seekable = NULL;
+  GOutputStream *header        = NULL;
+  goffset       *offset_table;
+  goffset        table_pos;
+  goffset        end_pos       = 0;
+  guint32        value;
+  guint          n_layers;
+  guint          n_channels;
+  guint          n_paths  = 0;
+  guint          n_offsets;
+  guint          slot     = 0;
+  guint          progress = 0;
+  guint          max_progress;
+  gchar          version_tag[16];
+  gboolean       write_paths = FALSE;
+  GError        *tmp_error   = NULL;
+
+  /* write out the tag information for the image, unless appending to
+   * a file which already has it
+   */
+  if (! info->append)
     {
-      strcpy (version_tag, "gimp xcf file");
+      if (info->file_version > 0)
+        {
+          g_snprintf (version_tag, sizeof (version_tag),
+                      "gimp xcf v%03d", info->file_version);
+        }
+      else
+        {
+          strcpy (version_tag, "gimp xcf file");
+        }
+
+      xcf_write_int8_check_error (info, (guint8 *) version_tag, 14, ;);
+
+      /* followed by the commit slots since version 27 */
+      if (info->file_version >= 27)
+        {
+          guint8 slots[XCF_COMMIT_SLOT_SIZE * XCF_N_COMMIT_SLOTS] = { 0, };
+
+          xcf_write_int8_check_error (info, slots, sizeof (slots), ;);
+        }
     }
 
-  xcf_write_int8_check_error (info, (guint8 *) version_tag, 14, ;);
+  if (info->file_version >= 27)
+    {
+      /* since version 27, the header is assembled in memory, written
+       * after everything it refers to, and only then committed, see
+       * xcf_save_commit().
+       */
+      header = g_memory_output_stream_new_resizable ();
+
+      file_output   = info->output;
+      file_seekable = info->seekable;
+      end_pos       = info->cp;
+
+      info->output   = header;
+      info->seekable = G_SEEKABLE (header);
+      info->cp       = 0;
+    }
 
   /* write out the width, height and image type information for the image */
   value = gimp_image_get_width (image);
-  xcf_write_int32_check_error (info, (guint32 *) &value, 1, ;);
+  xcf_write_int32_check_error (info, (guint32 *) &value, 1,
+                               g_clear_object (&header));
 
   value = gimp_image_get_height (image);
-  xcf_write_int32_check_error (info, (guint32 *) &value, 1, ;);
+  xcf_write_int32_check_error (info, (guint32 *) &value, 1,
+                               g_clear_object (&header));
 
   value = gimp_image_get_base_type (image);
-  xcf_write_int32_check_error (info, &value, 1, ;);
+  xcf_write_int32_check_error (info, &value, 1,
+                               g_clear_object (&header));
 
   if (info->file_version >= 4)
     {
       value = gimp_image_get_precision (image);
-      xcf_write_int32_check_error (info, &value, 1, ;);
+      xcf_write_int32_check_error (info, &value, 1,
+                                   g_clear_object (&header));
     }
 
   if (info->file_version >= 18)
@@ -376,41 +457,54 @@ xcf_save_image (XcfInfo    *info,
 
   max_progress = 1 + n_layers + n_channels + n_paths;
 
+  /* the offset table has a '0' after the layer, channel and path
+   * offsets each
+   */
+  n_offsets = n_layers + n_channels + 2 + (write_paths ? n_paths + 1 : 0);
+
+  offset_table = g_new0 (goffset, n_offsets);
+
+#define xcf_save_image_cleanup           \
+  g_clear_object (&header);              \
+  g_free (offset_table);                 \
+  g_list_free (all_layers);              \
+  g_list_free (all_channels);            \
+  g_list_free (all_paths)
+
   /* write the property information for the image */
-  xcf_check_error (xcf_save_image_props (info, image, error), ;);
+  xcf_check_error (xcf_save_image_props (info, image, error),
+                   xcf_save_image_cleanup);
 
   xcf_progress_update (info);
 
-  /* 'saved_pos' is the next slot in the offset table */
-  saved_pos = info->cp;
+  /* 'table_pos' is the offset of the offset table */
+  table_pos = info->cp;
 
   /* write an empty offset table */
-  xcf_write_zero_offset_check_error (info,
-                                     n_layers + n_channels + 2 +
-                                     (write_paths ? n_paths + 1 : 0), ;);
+  xcf_write_zero_offset_check_error (info, n_offsets,
+                                     xcf_save_image_cleanup);
 
-  /* 'offset' is where we will write the next layer or channel */
-  offset = info->cp;
+  if (header)
+    {
+      /* the layers and channels go after the commit slots, or after
+       * the end of the file appended to
+       */
+      info->output   = file_output;
+      info->seekable = file_seekable;
+      info->cp       = end_pos;
+    }
 
   for (list = all_layers; list; list = g_list_next (list))
     {
       GimpLayer *layer = list->data;
 
-      /* seek back to the next slot in the offset table and write the
-       * offset of the layer
+      /* remember the layer offset for the offset table and save the
+       * layer
        */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error), ;);
-      xcf_write_offset_check_error (info, &offset, 1, ;);
-
-      /* remember the next slot in the offset table */
-      saved_pos = info->cp;
-
-      /* seek to the layer offset and save the layer */
-      xcf_check_error (xcf_seek_pos (info, offset, error), ;);
-      xcf_check_error (xcf_save_layer (info, image, layer, error), ;);
+      offset_table[slot++] = info->cp;
 
-      /* the next layer's offset is after the layer we just wrote */
-      offset = info->cp;
+      xcf_check_error (xcf_save_layer (info, image, layer, error),
+                       xcf_save_image_cleanup);
 
       xcf_progress_update (info);
     }
@@ -418,27 +512,19 @@ xcf_save_image (XcfInfo    *info,
   /* skip a '0' in the offset table to indicate the end of the layer
    * offsets
    */
-  saved_pos += info->bytes_per_offset;
+  slot++;
 
   for (list = all_channels; list; list = g_list_next (list))
     {
       GimpChannel *channel = list->data;
 
-      /* seek back to the next slot in the offset table and write the
-       * offset of the channel
+      /* remember the channel offset for the offset table and save the
+       * channel
        */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error), ;);
-      xcf_write_offset_check_error (info, &offset, 1, ;);
+      offset_table[slot++] = info->cp;
 
-      /* remember the next slot in the offset table */
-      saved_pos = info->cp;
-
-      /* seek to the channel offset and save the channel */
-      xcf_check_error (xcf_seek_pos (info, offset, error), ;);
-      xcf_check_error (xcf_save_channel (info, image, channel, error), ;);
-
-      /* the next channels's offset is after the channel we just wrote */
-      offset = info->cp;
+      xcf_check_error (xcf_save_channel (info, image, channel, error),
+                       xcf_save_image_cleanup);
 
       xcf_progress_update (info);
     }
@@ -448,27 +534,19 @@ xcf_save_image (XcfInfo    *info,
       /* skip a '0' in the offset table to indicate the end of the channel
        * offsets
        */
-      saved_pos += info->bytes_per_offset;
+      slot++;
 
       for (list = all_paths; list; list = g_list_next (list))
         {
           GimpPath *path = list->data;
 
-          /* seek back to the next slot in the offset table and write the
-           * offset of the channel
+          /* remember the path offset for the offset table and save the
+           * path
            */
-          xcf_check_error (xcf_seek_pos (info, saved_pos, error), ;);
-          xcf_write_offset_check_error (info, &offset, 1, ;);
-
-          /* remember the next slot in the offset table */
-          saved_pos = info->cp;
+          offset_table[slot++] = info->cp;
 
-          /* seek to the channel offset and save the channel */
-          xcf_check_error (xcf_seek_pos (info, offset, error), ;);
-          xcf_check_error (xcf_save_path (info, image, path, error), ;);
-
-          /* the next channels's offset is after the channel we just wrote */
-          offset = info->cp;
+          xcf_check_error (xcf_save_path (info, image, path, error),
+                           xcf_save_image_cleanup);
 
           xcf_progress_update (info);
         }
@@ -478,13 +556,133 @@ xcf_save_image (XcfInfo    *info,
    * the end of the channel offsets
    */
 
-  g_list_free (all_layers);
-  g_list_free (all_channels);
-  g_list_free (all_paths);
+  end_pos = info->cp;
+
+  if (header)
+    {
+      const guint8 *data;
+      gsize         size;
+
+      /* fill in the offset table of the header in memory */
+      info->output   = header;
+      info->seekable = G_SEEKABLE (header);
+      info->cp       = g_seekable_tell (G_SEEKABLE (header));
+
+      xcf_check_error (xcf_seek_pos (info, table_pos, error),
+                       xcf_save_image_cleanup);
+      xcf_write_offset_check_error (info, offset_table, n_offsets,
+                                    xcf_save_image_cleanup);
+
+      info->output   = file_output;
+      info->seekable = file_seekable;
+      info->cp       = end_pos;
+
+      data = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (header));
+      size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (header));
+
+      xcf_check_error (xcf_save_commit (info, end_pos, data, size, error),
+                       xcf_save_image_cleanup);
+
+      end_pos += size;
+    }
+  else
+    {
+      /* seek back to the offset table and write it */
+      xcf_check_error (xcf_seek_pos (info, table_pos, error),
+                       xcf_save_image_cleanup);
+      xcf_write_offset_check_error (info, offset_table, n_offsets,
+                                    xcf_save_image_cleanup);
+    }
+
+  /* seek to the end of the file */
+  xcf_check_error (xcf_seek_pos (info, end_pos, error),
+                   xcf_save_image_cleanup);
+
+  xcf_save_image_cleanup;
+
+#undef xcf_save_image_cleanup
 
   return ! g_output_stream_is_closed (info->output);
 }
 
+/* makes sure everything written so far reached the disk */
+static gboolean
+xcf_save_sync (XcfInfo  *info,
+               GError  **error)
+{
+  if (! g_output_stream_flush (info->output, NULL, error))
+    return FALSE;
+
+#if defined (G_OS_UNIX) && defined (HAVE_FSYNC)
+  if (G_IS_FILE_DESCRIPTOR_BASED (info->output))
+    {
+      gint fd = g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (info->output));
+
+      if (fsync (fd) != 0)
+        {
+          g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                       _("Error writing XCF: %s"), g_strerror (errno));
+          return FALSE;
+        }
+    }
+#endif
+
+  return TRUE;
+}
+
+/* writes the image header at @header_pos, and points the commit slot
+ * not used by the previous save at it.  the slot is only written once
+ * the header and everything it refers to are on the disk, so a file
+ * whose save was interrupted still has a valid slot pointing at the
+ * previous header.  the loader picks the valid slot with the highest
+ * sequence number, see xcf_load_find_header().
+ */
+static gboolean
+xcf_save_commit (XcfInfo       *info,
+                 goffset        header_pos,
+                 const guint8  *header_data,
+                 gsize          header_size,
+                 GError       **error)
+{
+  guint8  slot[XCF_COMMIT_SLOT_SIZE];
+  guint32 value32;
+  guint64 value64;
+  GError *tmp_error = NULL;
+
+  xcf_check_error (xcf_seek_pos (info, header_pos, error), ;);
+  xcf_write_int8_check_error (info, header_data, (gint) header_size, ;);
+
+  xcf_check_error (xcf_save_sync (info, error), ;);
+
+  value32 = GUINT32_TO_BE (XCF_COMMIT_MAGIC);
+  memcpy (slot, &value32, 4);
+  value32 = GUINT32_TO_BE (info->commit_sequence);
+  memcpy (slot + 4, &value32, 4);
+  value64 = GUINT64_TO_BE (header_pos);
+  memcpy (slot + 8, &value64, 8);
+  value64 = GUINT64_TO_BE (header_size);
+  memcpy (slot + 16, &value64, 8);
+  value32 = GUINT32_TO_BE (crc32 (0, header_data, header_size));
+  memcpy (slot + 24, &value32, 4);
+  value32 = GUINT32_TO_BE (crc32 (0, slot, 28));
+  memcpy (slot + 28, &value32, 4);
+
+  xcf_check_error (xcf_seek_pos (info,
+                                 XCF_COMMIT_SLOTS_POS +
+                                 XCF_COMMIT_SLOT_SIZE *
+                                 (info->commit_sequence % XCF_N_COMMIT_SLOTS),
+                                 error), ;);
+  xcf_write_int8_check_error (info, slot, XCF_COMMIT_SLOT_SIZE, ;);
+
+  xcf_check_error (xcf_save_sync (info, error), ;);
+
+  GIMP_LOG (XCF, "committed header of %" G_GSIZE_FORMAT " bytes at %"
+            G_GOFFSET_FORMAT ", sequence %u",
+            header_size, header_pos, info->commit_sequence);
+
+  return TRUE;
+}
+
 static gboolean
 xcf_save_image_props (XcfInfo    *info,
                       GimpImage  *image,
@@ -2579,6 +2777,8 @@ xcf_save_level (XcfInfo     *info,
   const Babl *format;
   goffset    *offset_table;
   goffset    *next_offset;
+  gint       *data_lengths;
+  gboolean    reuse = FALSE;
   goffset     saved_pos;
   goffset     offset;
   goffset     max_data_length;
@@ -2626,29 +2826,71 @@ xcf_save_level (XcfInfo     *info,
   offset_table = g_malloc0 ((ntiles + 1) * sizeof (goffset));
   next_offset = offset_table;
 
+  /* since version 27, the offset table is followed by a table of the
+   * tiles' data lengths, so tiles don't need to be stored in order.
+   */
+  data_lengths = g_new0 (gint, ntiles);
+
+  /* when appending to a file, the tiles which didn't change since the
+   * last save keep their previous data, their slots in the tables are
+   * filled in up front and skipped below.
+   */
+  if (info->append)
+    reuse = xcf_incremental_lookup_tiles (buffer, info->prev_generation,
+                                          offset_table, data_lengths,
+                                          ntiles);
+
   /* 'saved_pos' is the offset of the tile offset table  */
   saved_pos = info->cp;
 
   /* write an empty offset table */
-  xcf_write_zero_offset_check_error (info, ntiles + 1, ;);
+  xcf_write_zero_offset_check_error (info, ntiles + 1,
+                                     g_free (offset_table);
+                                     g_free (data_lengths));
+
+  /* and room for the data length table, it is written along with the
+   * offset table once all tiles are done
+   */
+  if (info->file_version >= 27)
+    xcf_write_int32_check_error (info, (guint32 *) data_lengths, ntiles,
+                                 g_free (offset_table);
+                                 g_free (data_lengths));
 
   /* 'offset' is where we will write the next tile */
   offset = info->cp;
 
-  if (info->compression == COMPRESS_RLE ||
-      info->compression == COMPRESS_ZLIB)
+  if (info->compression == COMPRESS_RLE  ||
+      info->compression == COMPRESS_ZLIB ||
+      info->compression == COMPRESS_ZSTD)
     {
       /* parallel implementation */
-      XcfJobData  *job_data;
-      guchar      *switch_out_data;
-      gint         out_data_len[XCF_TILE_SAVE_BATCH_SIZE];
-
-      GThreadPool *pool;
-      GAsyncQueue *queue;
-      gint         num_tasks = num_processors * 2;
-      gint         tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
-      gint         out_data_max_size;
-      gint         next_tile = 0;
+      XcfJobData       *job_data;
+      guchar           *switch_out_data;
+      gint              out_data_len[XCF_TILE_SAVE_BATCH_SIZE];
+
+      GThreadPool      *pool;
+      GAsyncQueue      *queue;
+      gint              num_tasks = num_processors * 2;
+      gint              tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+      gint              out_data_max_size;
+      gint              next_tile = 0;
+      CompressTileFunc  compress;
+
+      switch (info->compression)
+        {
+        case COMPRESS_RLE:
+          compress = xcf_save_tile_rle;
+          break;
+        case COMPRESS_ZLIB:
+          compress = xcf_save_tile_zlib;
+          break;
+        default:
+          if (info->file_version >= 28)
+            compress = xcf_save_tile_zstd_predict;
+          else
+            compress = xcf_save_tile_zstd;
+          break;
+        }
 
       out_data_max_size = tile_size * XCF_TILE_MAX_DATA_LENGTH_FACTOR;
       /* Prepare an additional out_data to quickly switch. */
@@ -2675,8 +2917,8 @@ xcf_save_level (XcfInfo     *info,
           job_data->buffer        = buffer;
           job_data->file_version  = info->file_version;
           job_data->max_out_data_len = out_data_max_size;
-          job_data->compress      = (info->compression == COMPRESS_RLE) ?
-                                      xcf_save_tile_rle : xcf_save_tile_zlib;
+          job_data->compress      = compress;
+          job_data->reused_offsets = reuse ? offset_table : NULL;
           job_data->tile_data     = g_malloc (tile_size);
           job_data->out_data      = g_malloc (out_data_max_size * XCF_TILE_SAVE_BATCH_SIZE);
 
@@ -2720,10 +2962,20 @@ xcf_save_level (XcfInfo     *info,
                   /* Now write the data. */
                   for (k = 0; k < batch_size; k++)
                     {
+                      if (*next_offset)
+                        {
+                          /* a clean tile, keep its previous data */
+                          info->reused_bytes += data_lengths[next_offset - offset_table];
+                          next_offset++;
+                          continue;
+                        }
+
                       *next_offset++ = offset;
                       xcf_write_int8_check_error (info,
                                                   switch_out_data + out_data_max_size * k,
-                                                  out_data_len[k], ;);
+                                                  out_data_len[k],
+                                                  g_free (offset_table);
+                                                  g_free (data_lengths));
                       if (info->cp < offset || info->cp - offset > max_data_length)
                         {
                           g_message ("xcf: invalid tile data length: %" G_GOFFSET_FORMAT,
@@ -2731,8 +2983,10 @@ xcf_save_level (XcfInfo     *info,
                           g_thread_pool_free (pool, TRUE, TRUE);
                           g_async_queue_unref (queue);
                           g_free (offset_table);
+                          g_free (data_lengths);
                           return FALSE;
                         }
+                      data_lengths[next_offset - offset_table - 1] = info->cp - offset;
                       offset = info->cp;
                     }
                   next_tile += batch_size;
@@ -2757,10 +3011,20 @@ xcf_save_level (XcfInfo     *info,
 
               for (k = 0; k < job_data->batch_size; k++)
                 {
+                  if (*next_offset)
+                    {
+                      /* a clean tile, keep its previous data */
+                      info->reused_bytes += data_lengths[next_offset - offset_table];
+                      next_offset++;
+                      continue;
+                    }
+
                   *next_offset++ = offset;
                   xcf_write_int8_check_error (info,
                                               job_data->out_data + out_data_max_size * k,
-                                              job_data->out_data_len[k], ;);
+                                              job_data->out_data_len[k],
+                                              g_free (offset_table);
+                                              g_free (data_lengths));
                   if (info->cp < offset || info->cp - offset > max_data_length)
                     {
                       g_message ("xcf: invalid tile data length: %" G_GOFFSET_FORMAT,
@@ -2768,8 +3032,10 @@ xcf_save_level (XcfInfo     *info,
                       g_thread_pool_free (pool, TRUE, TRUE);
                       g_async_queue_unref (queue);
                       g_free (offset_table);
+                      g_free (data_lengths);
                       return FALSE;
                     }
+                  data_lengths[next_offset - offset_table - 1] = info->cp - offset;
                   offset = info->cp;
                 }
               next_tile += job_data->batch_size;
@@ -2800,6 +3066,14 @@ xcf_save_level (XcfInfo     *info,
         {
           GeglRectangle rect;
 
+          if (*next_offset)
+            {
+              /* a clean tile, keep its previous data */
+              info->reused_bytes += data_lengths[i];
+              next_offset++;
+              continue;
+            }
+
           /* store the offset in the table and increment the next pointer */
           *next_offset++ = offset;
 
@@ -2812,15 +3086,19 @@ xcf_save_level (XcfInfo     *info,
             {
             case COMPRESS_NONE:
               xcf_check_error (xcf_save_tile (info, buffer, &rect, format,
-                                              error), ;);
+                                              error),
+                               g_free (offset_table);
+                               g_free (data_lengths));
               break;
             case COMPRESS_FRACTAL:
               g_warning ("xcf: fractal compression unimplemented");
               g_free (offset_table);
+              g_free (data_lengths);
               return FALSE;
             default:
               g_warning ("xcf: unsupported compression algorithm");
               g_free (offset_table);
+              g_free (data_lengths);
               return FALSE;
             }
 
@@ -2832,22 +3110,41 @@ xcf_save_level (XcfInfo     *info,
               g_message ("xcf: invalid tile data length: %" G_GOFFSET_FORMAT,
                          info->cp - offset);
               g_free (offset_table);
+              g_free (data_lengths);
               return FALSE;
             }
 
+          data_lengths[i] = info->cp - offset;
+
           /* the next tile's offset is after the tile we just wrote */
           offset = info->cp;
         }
     }
 
   /* seek back to the offset table and write it  */
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error), ;);
-  xcf_write_offset_check_error (info, offset_table, ntiles + 1, ;);
+  xcf_check_error (xcf_seek_pos (info, saved_pos, error),
+                   g_free (offset_table);
+                   g_free (data_lengths));
+  xcf_write_offset_check_error (info, offset_table, ntiles + 1,
+                                g_free (offset_table);
+                                g_free (data_lengths));
+
+  if (info->file_version >= 27)
+    xcf_write_int32_check_error (info, (guint32 *) data_lengths, ntiles,
+                                 g_free (offset_table);
+                                 g_free (data_lengths));
 
   /* seek to the end of the file */
-  xcf_check_error (xcf_seek_pos (info, offset, error), ;);
+  xcf_check_error (xcf_seek_pos (info, offset, error),
+                   g_free (offset_table);
+                   g_free (data_lengths));
+
+  /* remember where the tiles went, for the next incremental save */
+  xcf_incremental_track_tiles (buffer, info->generation,
+                               offset_table, data_lengths, ntiles);
 
   g_free (offset_table);
+  g_free (data_lengths);
 
   return TRUE;
 }
@@ -2916,6 +3213,11 @@ xcf_save_tile_parallel (XcfJobData  *job_data,
 
   for (gint i = 0; i < job_data->batch_size; ++i)
     {
+      /* clean tiles are not written again */
+      if (job_data->reused_offsets &&
+          job_data->reused_offsets[job_data->tile + i])
+        continue;
+
       gimp_gegl_buffer_get_tile_rect (job_data->buffer,
                                       XCF_TILE_WIDTH,
                                       XCF_TILE_HEIGHT,
@@ -3128,6 +3430,82 @@ xcf_save_tile_zlib (GeglRectangle  *tile_rect,
   deflateEnd (&strm);
 }
 
+static void
+xcf_save_tile_zstd (GeglRectangle  *tile_rect,
+                    guchar         *tile_data,
+                    const Babl     *format,
+                    guchar         *zstd_data,
+                    gint            zstd_data_max_len,
+                    gint           *lenptr)
+{
+  gint   bpp       = babl_format_get_bytes_per_pixel (format);
+  gint   tile_size = bpp * tile_rect->width * tile_rect->height;
+  size_t size;
+
+  *lenptr = 0;
+
+  size = ZSTD_compress (zstd_data, zstd_data_max_len,
+                        tile_data, tile_size,
+                        XCF_ZSTD_COMPRESSION_LEVEL);
+
+  if (ZSTD_isError (size))
+    {
+      g_printerr ("xcf: tile compression failed: %s",
+                  ZSTD_getErrorName (size));
+      return;
+    }
+
+  *lenptr = size;
+}
+
+/* since version 28, zstd compressed tiles start with a byte telling
+ * which predictor was applied to the tile data before compressing it
+ */
+static void
+xcf_save_tile_zstd_predict (GeglRectangle  *tile_rect,
+                            guchar         *tile_data,
+                            const Babl     *format,
+                            guchar         *zstd_data,
+                            gint            zstd_data_max_len,
+                            gint           *lenptr)
+{
+  gint              bpp          = babl_format_get_bytes_per_pixel (format);
+  gint              n_components = babl_format_get_n_components (format);
+  gint              tile_size    = bpp * tile_rect->width * tile_rect->height;
+  guchar           *planes;
+  XcfPredictorType  predictor;
+  size_t            size;
+
+  *lenptr = 0;
+
+  predictor = xcf_predictor_choose (tile_data,
+                                    tile_rect->width, tile_rect->height,
+                                    bpp / n_components, n_components);
+
+  planes = g_malloc (tile_size);
+
+  xcf_predictor_encode (predictor, tile_data, planes,
+                        tile_rect->width, tile_rect->height,
+                        bpp / n_components, n_components);
+
+  zstd_data[0] = predictor;
+
+  size = ZSTD_compress (zstd_data + 1, zstd_data_max_len - 1,
+                        planes, tile_size,
+                        XCF_ZSTD_COMPRESSION_LEVEL);
+
+  g_free (planes);
+
+  if (ZSTD_isError (size))
+    {
+      g_printerr ("xcf: tile compression failed: %s",
+                  ZSTD_getErrorName (size));
+      return;
+    }
+
+  *lenptr = size + 1;
+}
+
 static gboolean
 xcf_save_parasite (XcfInfo       *info,
                    GimpParasite  *parasite,
@@ -0,0 +1,659 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+
+#include "xcf-private.h"
+#include "xcf-load.h"
+#include "xcf-tile-handler.h"
+
+#include "gimp-log.h"
+
+#include "gimp-intl.h"
+
+
+struct _XcfMapping
+{
+  gint          ref_count;
+
+  Gimp         *gimp;
+  gchar        *path;
+  gchar        *display_name;
+  GBytes       *data;
+  GStatBuf      stat_buf;     /* the file as it was mapped            */
+  GFileMonitor *monitor;
+
+  GMutex        mutex;
+  GSList       *handlers;     /* weak references to the tile handlers */
+
+  gint          changed;      /* the file was modified in place       */
+  gint          reported;     /* a problem was reported to the user   */
+};
+
+typedef struct
+{
+  Gimp  *gimp;
+  gchar *message;
+} XcfMappingMessage;
+
+
+static void       gimp_tile_handler_xcf_finalize    (GObject            *object);
+
+static GeglTile * gimp_tile_handler_xcf_decode_tile (GeglTileSource     *source,
+                                                     gint                x,
+                                                     gint                y);
+static gpointer   gimp_tile_handler_xcf_command     (GeglTileSource     *source,
+                                                     GeglTileCommand     command,
+                                                     gint                x,
+                                                     gint                y,
+                                                     gint                z,
+                                                     gpointer            data);
+static void       gimp_tile_handler_xcf_load_all    (GimpTileHandlerXcf *xcf);
+
+static gboolean   xcf_mapping_is_valid              (XcfMapping         *mapping);
+static void       xcf_mapping_report                (XcfMapping         *mapping,
+                                                     const gchar        *format,
+                                                     ...) G_GNUC_PRINTF (2, 3);
+static gboolean   xcf_mapping_report_idle           (XcfMappingMessage  *message);
+static void       xcf_mapping_file_changed          (GFileMonitor       *monitor,
+                                                     GFile              *file,
+                                                     GFile              *other_file,
+                                                     GFileMonitorEvent   event,
+                                                     XcfMapping         *mapping);
+
+
+G_DEFINE_TYPE (GimpTileHandlerXcf, gimp_tile_handler_xcf,
+               GEGL_TYPE_TILE_HANDLER)
+
+#define parent_class gimp_tile_handler_xcf_parent_class
+
+
+static void
+gimp_tile_handler_xcf_class_init (GimpTileHandlerXcfClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_tile_handler_xcf_finalize;
+}
+
+static void
+gimp_tile_handler_xcf_init (GimpTileHandlerXcf *xcf)
+{
+  GeglTileSource *source = GEGL_TILE_SOURCE (xcf);
+
+  source->command = gimp_tile_handler_xcf_command;
+}
+
+static void
+gimp_tile_handler_xcf_finalize (GObject *object)
+{
+  GimpTileHandlerXcf *xcf = GIMP_TILE_HANDLER_XCF (object);
+
+  if (xcf->buffer)
+    g_object_remove_weak_pointer (G_OBJECT (xcf->buffer),
+                                  (gpointer) &xcf->buffer);
+
+  g_clear_pointer (&xcf->mapping, xcf_mapping_unref);
+  g_clear_pointer (&xcf->offsets, g_free);
+  g_clear_pointer (&xcf->data_lengths, g_free);
+  g_clear_pointer (&xcf->loaded, g_free);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gboolean
+gimp_tile_handler_xcf_is_loaded (GimpTileHandlerXcf *xcf,
+                                 gint                x,
+                                 gint                y)
+{
+  if (! xcf->mapping                ||
+      x < 0 || x >= xcf->n_tile_cols ||
+      y < 0 || y >= xcf->n_tile_rows)
+    {
+      return TRUE;
+    }
+
+  return xcf->loaded[y * xcf->n_tile_cols + x];
+}
+
+static void
+gimp_tile_handler_xcf_set_loaded (GimpTileHandlerXcf *xcf,
+                                  gint                x,
+                                  gint                y)
+{
+  if (gimp_tile_handler_xcf_is_loaded (xcf, x, y))
+    return;
+
+  xcf->loaded[y * xcf->n_tile_cols + x] = TRUE;
+
+  /* once every tile made it into the buffer, there is no need to
+   * keep the file mapped.
+   */
+  if (--xcf->n_pending == 0)
+    {
+      GIMP_LOG (XCF, "all lazily loaded tiles decoded, releasing file data");
+
+      g_clear_pointer (&xcf->mapping, xcf_mapping_unref);
+    }
+}
+
+static GeglTile *
+gimp_tile_handler_xcf_decode_tile (GeglTileSource *source,
+                                   gint            x,
+                                   gint            y)
+{
+  GimpTileHandlerXcf *xcf  = GIMP_TILE_HANDLER_XCF (source);
+  GeglTile           *tile = NULL;
+  const guchar       *file_data;
+  guchar             *xcf_tile_data;
+  GeglRectangle       tile_rect;
+  gint                n_xcf_tile_cols;
+  gint                bpp;
+  gint                tile_stride;
+  gint                col, row;
+
+  /* don't touch a mapping whose file was changed under us, reading it
+   * might crash.
+   */
+  if (! xcf_mapping_is_valid (xcf->mapping))
+    {
+      xcf_mapping_report (xcf->mapping,
+                          _("'%s' was modified by another program while "
+                            "it was open.  Some of its pixels could not "
+                            "be loaded."),
+                          xcf->mapping->display_name);
+
+      gimp_tile_handler_xcf_set_loaded (xcf, x, y);
+
+      return NULL;
+    }
+
+  file_data = g_bytes_get_data (xcf_mapping_get_bytes (xcf->mapping), NULL);
+
+  bpp         = babl_format_get_bytes_per_pixel (xcf->format);
+  tile_stride = bpp * xcf->tile_width;
+
+  n_xcf_tile_cols = (xcf->width + XCF_TILE_WIDTH - 1) / XCF_TILE_WIDTH;
+
+  gegl_rectangle_intersect (&tile_rect,
+                            GEGL_RECTANGLE (x * xcf->tile_width,
+                                            y * xcf->tile_height,
+                                            xcf->tile_width,
+                                            xcf->tile_height),
+                            GEGL_RECTANGLE (0, 0, xcf->width, xcf->height));
+
+  xcf_tile_data = g_malloc (XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp);
+
+  /* the buffer's tiles don't necessarily match the 64x64 XCF tiles, so
+   * decode every XCF tile the buffer tile overlaps.
+   */
+  for (row = tile_rect.y / XCF_TILE_HEIGHT;
+       row * XCF_TILE_HEIGHT < tile_rect.y + tile_rect.height;
+       row++)
+    {
+      for (col = tile_rect.x / XCF_TILE_WIDTH;
+           col * XCF_TILE_WIDTH < tile_rect.x + tile_rect.width;
+           col++)
+        {
+          GeglRectangle xcf_rect;
+          GeglRectangle rect;
+          gint          i = row * n_xcf_tile_cols + col;
+          gboolean      has_data;
+          gint          r;
+
+          xcf_rect.x      = col * XCF_TILE_WIDTH;
+          xcf_rect.y      = row * XCF_TILE_HEIGHT;
+          xcf_rect.width  = MIN (XCF_TILE_WIDTH,  xcf->width  - xcf_rect.x);
+          xcf_rect.height = MIN (XCF_TILE_HEIGHT, xcf->height - xcf_rect.y);
+
+          if (! xcf_load_tile_decode (xcf->compression, xcf->file_version,
+                                      &xcf_rect, xcf->format,
+                                      file_data + xcf->offsets[i],
+                                      xcf->data_lengths[i],
+                                      xcf_tile_data, &has_data))
+            {
+              GIMP_LOG (XCF, "failed to decode tile %d", i);
+
+              xcf_mapping_report (xcf->mapping,
+                                  _("Some of the pixels of '%s' could not "
+                                    "be decoded.  The file may be "
+                                    "corrupt."),
+                                  xcf->mapping->display_name);
+              continue;
+            }
+
+          if (! has_data)
+            continue;
+
+          if (! tile)
+            {
+              tile = gegl_tile_handler_get_source_tile (GEGL_TILE_HANDLER (source),
+                                                        x, y, 0, FALSE);
+
+              gegl_tile_lock (tile);
+
+              memset (gegl_tile_get_data (tile),
+                      0, tile_stride * xcf->tile_height);
+            }
+
+          gegl_rectangle_intersect (&rect, &xcf_rect, &tile_rect);
+
+          for (r = 0; r < rect.height; r++)
+            {
+              memcpy (gegl_tile_get_data (tile)                         +
+                      (rect.y + r - y * xcf->tile_height) * tile_stride +
+                      (rect.x     - x * xcf->tile_width)  * bpp,
+                      xcf_tile_data                                     +
+                      (rect.y + r - xcf_rect.y) * xcf_rect.width * bpp  +
+                      (rect.x     - xcf_rect.x) * bpp,
+                      rect.width * bpp);
+            }
+        }
+    }
+
+  g_free (xcf_tile_data);
+
+  if (tile)
+    gegl_tile_unlock (tile);
+
+  gimp_tile_handler_xcf_set_loaded (xcf, x, y);
+
+  return tile;
+}
+
+static gpointer
+gimp_tile_handler_xcf_command (GeglTileSource  *source,
+                               GeglTileCommand  command,
+                               gint             x,
+                               gint             y,
+                               gint             z,
+                               gpointer         data)
+{
+  GimpTileHandlerXcf *xcf = GIMP_TILE_HANDLER_XCF (source);
+
+  if (z == 0 && ! gimp_tile_handler_xcf_is_loaded (xcf, x, y))
+    {
+      switch (command)
+        {
+        case GEGL_TILE_GET:
+          /* a tile which already exists below us was written without
+           * being read first, it must not be overwritten with the
+           * file's contents.
+           */
+          if (gegl_tile_handler_source_command (source, GEGL_TILE_EXIST,
+                                                x, y, z, NULL))
+            {
+              gimp_tile_handler_xcf_set_loaded (xcf, x, y);
+              break;
+            }
+
+          return gimp_tile_handler_xcf_decode_tile (source, x, y);
+
+        case GEGL_TILE_EXIST:
+          return GINT_TO_POINTER (TRUE);
+
+        case GEGL_TILE_SET:
+        case GEGL_TILE_VOID:
+          gimp_tile_handler_xcf_set_loaded (xcf, x, y);
+          break;
+
+        case GEGL_TILE_COPY:
+          /* let the caller fall back to getting the tile */
+          return GINT_TO_POINTER (FALSE);
+
+        default:
+          break;
+        }
+    }
+
+  return gegl_tile_handler_source_command (source, command, x, y, z, data);
+}
+
+/* decodes all the remaining tiles into the buffer, so that the mapped
+ * file is no longer needed
+ */
+static void
+gimp_tile_handler_xcf_load_all (GimpTileHandlerXcf *xcf)
+{
+  guchar *pixel;
+  gint    x, y;
+
+  if (! xcf->buffer)
+    return;
+
+  pixel = g_alloca (babl_format_get_bytes_per_pixel (xcf->format));
+
+  for (y = 0; y < xcf->n_tile_rows; y++)
+    {
+      for (x = 0; x < xcf->n_tile_cols; x++)
+        {
+          if (gimp_tile_handler_xcf_is_loaded (xcf, x, y))
+            continue;
+
+          /* getting any pixel of the tile makes the buffer get the tile */
+          gegl_buffer_get (xcf->buffer,
+                           GEGL_RECTANGLE (x * xcf->tile_width,
+                                           y * xcf->tile_height,
+                                           1, 1),
+                           1.0, xcf->format, pixel,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+        }
+    }
+}
+
+static gboolean
+xcf_mapping_is_valid (XcfMapping *mapping)
+{
+  GStatBuf stat_buf;
+
+  if (g_atomic_int_get (&mapping->changed))
+    return FALSE;
+
+  /* replacing or removing the file leaves the mapped contents alone,
+   * only changing the same file in place doesn't.
+   */
+  if (g_stat (mapping->path, &stat_buf) == 0                  &&
+      stat_buf.st_dev   == mapping->stat_buf.st_dev           &&
+      stat_buf.st_ino   == mapping->stat_buf.st_ino           &&
+      (stat_buf.st_size  != mapping->stat_buf.st_size ||
+       stat_buf.st_mtime != mapping->stat_buf.st_mtime))
+    {
+      g_atomic_int_set (&mapping->changed, TRUE);
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* tiles are decoded on whatever thread accesses the buffer, so the
+ * message is shown from the main loop, and only once per file
+ */
+static void
+xcf_mapping_report (XcfMapping  *mapping,
+                    const gchar *format,
+                    ...)
+{
+  XcfMappingMessage *message;
+  va_list            args;
+
+  if (! g_atomic_int_compare_and_exchange (&mapping->reported, FALSE, TRUE))
+    return;
+
+  message       = g_slice_new (XcfMappingMessage);
+  message->gimp = mapping->gimp;
+
+  va_start (args, format);
+  message->message = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  g_idle_add ((GSourceFunc) xcf_mapping_report_idle, message);
+}
+
+static gboolean
+xcf_mapping_report_idle (XcfMappingMessage *message)
+{
+  gimp_message_literal (message->gimp, NULL, GIMP_MESSAGE_WARNING,
+                        message->message);
+
+  g_free (message->message);
+  g_slice_free (XcfMappingMessage, message);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+xcf_mapping_file_changed (GFileMonitor      *monitor,
+                          GFile             *file,
+                          GFile             *other_file,
+                          GFileMonitorEvent  event,
+                          XcfMapping        *mapping)
+{
+  GSList *handlers = NULL;
+  GSList *list;
+
+  if (event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+    return;
+
+  GIMP_LOG (XCF, "'%s' changed, decoding all remaining tiles",
+            mapping->path);
+
+  /* the handlers drop their references once all their tiles are
+   * decoded
+   */
+  xcf_mapping_ref (mapping);
+
+  g_mutex_lock (&mapping->mutex);
+
+  for (list = mapping->handlers; list; list = g_slist_next (list))
+    {
+      GimpTileHandlerXcf *xcf = g_weak_ref_get (list->data);
+
+      if (xcf)
+        handlers = g_slist_prepend (handlers, xcf);
+    }
+
+  g_mutex_unlock (&mapping->mutex);
+
+  for (list = handlers; list; list = g_slist_next (list))
+    gimp_tile_handler_xcf_load_all (list->data);
+
+  g_slist_free_full (handlers, g_object_unref);
+
+  xcf_mapping_unref (mapping);
+}
+
+
+/*  public functions  */
+
+GeglTileHandler *
+gimp_tile_handler_xcf_new (XcfMapping         *mapping,
+                           XcfCompressionType  compression,
+                           gint                file_version,
+                           const Babl         *format,
+                           gint                width,
+                           gint                height,
+                           goffset            *offsets,
+                           gint               *data_lengths)
+{
+  GimpTileHandlerXcf *xcf;
+  GWeakRef           *weak_ref;
+
+  g_return_val_if_fail (mapping != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (offsets != NULL, NULL);
+  g_return_val_if_fail (data_lengths != NULL, NULL);
+
+  xcf = g_object_new (GIMP_TYPE_TILE_HANDLER_XCF, NULL);
+
+  xcf->mapping      = xcf_mapping_ref (mapping);
+  xcf->compression  = compression;
+  xcf->file_version = file_version;
+  xcf->format       = format;
+  xcf->width        = width;
+  xcf->height       = height;
+  xcf->offsets      = offsets;
+  xcf->data_lengths = data_lengths;
+
+  weak_ref = g_new0 (GWeakRef, 1);
+  g_weak_ref_init (weak_ref, xcf);
+
+  g_mutex_lock (&mapping->mutex);
+  mapping->handlers = g_slist_prepend (mapping->handlers, weak_ref);
+  g_mutex_unlock (&mapping->mutex);
+
+  return GEGL_TILE_HANDLER (xcf);
+}
+
+void
+gimp_tile_handler_xcf_assign (GimpTileHandlerXcf *xcf,
+                              GeglBuffer         *buffer)
+{
+  g_return_if_fail (GIMP_IS_TILE_HANDLER_XCF (xcf));
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (xcf->loaded == NULL);
+  g_return_if_fail (gegl_buffer_get_width (buffer)  == xcf->width &&
+                    gegl_buffer_get_height (buffer) == xcf->height);
+
+  g_object_get (buffer,
+                "tile-width",  &xcf->tile_width,
+                "tile-height", &xcf->tile_height,
+                NULL);
+
+  xcf->n_tile_cols = (xcf->width  + xcf->tile_width  - 1) / xcf->tile_width;
+  xcf->n_tile_rows = (xcf->height + xcf->tile_height - 1) / xcf->tile_height;
+  xcf->n_pending   = xcf->n_tile_cols * xcf->n_tile_rows;
+  xcf->loaded      = g_new0 (guint8, xcf->n_pending);
+
+  xcf->buffer = buffer;
+  g_object_add_weak_pointer (G_OBJECT (buffer), (gpointer) &xcf->buffer);
+
+  gegl_buffer_add_handler (buffer, xcf);
+}
+
+/**
+ * xcf_mapping_new:
+ * @gimp: a #Gimp
+ * @file: a local file
+ *
+ * Maps @file into memory, for lazily loading its tiles.  When the file
+ * is changed while it is mapped, the tiles which are not loaded yet
+ * are decoded right away.
+ *
+ * Returns: a new #XcfMapping, or %NULL if @file can't be mapped.
+ **/
+XcfMapping *
+xcf_mapping_new (Gimp  *gimp,
+                 GFile *file)
+{
+  XcfMapping  *mapping;
+  GMappedFile *mapped_file;
+  GStatBuf     stat_buf;
+  gchar       *path;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  path = g_file_get_path (file);
+
+  if (! path)
+    return NULL;
+
+  mapped_file = g_mapped_file_new (path, FALSE, NULL);
+
+  /* make sure the file didn't change between mapping it and looking
+   * at it
+   */
+  if (! mapped_file                                          ||
+      g_stat (path, &stat_buf) != 0                          ||
+      stat_buf.st_size != g_mapped_file_get_length (mapped_file))
+    {
+      g_clear_pointer (&mapped_file, g_mapped_file_unref);
+      g_free (path);
+
+      return NULL;
+    }
+
+  mapping = g_slice_new0 (XcfMapping);
+
+  mapping->ref_count    = 1;
+  mapping->gimp         = gimp;
+  mapping->path         = path;
+  mapping->display_name = g_filename_display_name (path);
+  mapping->data         = g_mapped_file_get_bytes (mapped_file);
+  mapping->stat_buf     = stat_buf;
+
+  g_mapped_file_unref (mapped_file);
+
+  g_mutex_init (&mapping->mutex);
+
+  mapping->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE,
+                                          NULL, NULL);
+
+  if (mapping->monitor)
+    g_signal_connect (mapping->monitor, "changed",
+                      G_CALLBACK (xcf_mapping_file_changed),
+                      mapping);
+
+  return mapping;
+}
+
+XcfMapping *
+xcf_mapping_ref (XcfMapping *mapping)
+{
+  g_return_val_if_fail (mapping != NULL, NULL);
+
+  g_atomic_int_inc (&mapping->ref_count);
+
+  return mapping;
+}
+
+void
+xcf_mapping_unref (XcfMapping *mapping)
+{
+  g_return_if_fail (mapping != NULL);
+
+  if (g_atomic_int_dec_and_test (&mapping->ref_count))
+    {
+      GSList *list;
+
+      if (mapping->monitor)
+        {
+          g_signal_handlers_disconnect_by_func (mapping->monitor,
+                                                xcf_mapping_file_changed,
+                                                mapping);
+          g_file_monitor_cancel (mapping->monitor);
+          g_object_unref (mapping->monitor);
+        }
+
+      for (list = mapping->handlers; list; list = g_slist_next (list))
+        {
+          g_weak_ref_clear (list->data);
+          g_free (list->data);
+        }
+
+      g_slist_free (mapping->handlers);
+
+      g_mutex_clear (&mapping->mutex);
+
+      g_bytes_unref (mapping->data);
+      g_free (mapping->path);
+      g_free (mapping->display_name);
+
+      g_slice_free (XcfMapping, mapping);
+    }
+}
+
+GBytes *
+xcf_mapping_get_bytes (XcfMapping *mapping)
+{
+  g_return_val_if_fail (mapping != NULL, NULL);
+
+  return mapping->data;
+}
@@ -0,0 +1,88 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gegl-buffer-backend.h>
+
+
+/***
+ * GimpTileHandlerXcf is a GeglTileHandler that decodes the tiles of
+ * a lazily loaded XCF level from the memory-mapped file the first
+ * time they are accessed.
+ */
+
+#define GIMP_TYPE_TILE_HANDLER_XCF            (gimp_tile_handler_xcf_get_type ())
+#define GIMP_TILE_HANDLER_XCF(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_TILE_HANDLER_XCF, GimpTileHandlerXcf))
+#define GIMP_TILE_HANDLER_XCF_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_TILE_HANDLER_XCF, GimpTileHandlerXcfClass))
+#define GIMP_IS_TILE_HANDLER_XCF(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_TILE_HANDLER_XCF))
+#define GIMP_IS_TILE_HANDLER_XCF_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_TILE_HANDLER_XCF))
+#define GIMP_TILE_HANDLER_XCF_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_TILE_HANDLER_XCF, GimpTileHandlerXcfClass))
+
+
+typedef struct _GimpTileHandlerXcf      GimpTileHandlerXcf;
+typedef struct _GimpTileHandlerXcfClass GimpTileHandlerXcfClass;
+
+struct _GimpTileHandlerXcf
+{
+  GeglTileHandler     parent_instance;
+
+  XcfMapping         *mapping;
+  XcfCompressionType  compression;
+  gint                file_version;
+  const Babl         *format;
+  gint                width;
+  gint                height;
+  goffset            *offsets;
+  gint               *data_lengths;
+
+  GeglBuffer         *buffer;
+  gint                tile_width;
+  gint                tile_height;
+  gint                n_tile_cols;
+  gint                n_tile_rows;
+  guint8             *loaded;
+  gint                n_pending;
+};
+
+struct _GimpTileHandlerXcfClass
+{
+  GeglTileHandlerClass  parent_class;
+};
+
+
+GType             gimp_tile_handler_xcf_get_type (void) G_GNUC_CONST;
+
+GeglTileHandler * gimp_tile_handler_xcf_new      (XcfMapping         *mapping,
+                                                  XcfCompressionType  compression,
+                                                  gint                file_version,
+                                                  const Babl         *format,
+                                                  gint                width,
+                                                  gint                height,
+                                                  goffset            *offsets,
+                                                  gint               *data_lengths);
+
+void              gimp_tile_handler_xcf_assign   (GimpTileHandlerXcf *xcf,
+                                                  GeglBuffer         *buffer);
+
+
+XcfMapping      * xcf_mapping_new                (Gimp               *gimp,
+                                                  GFile              *file);
+XcfMapping      * xcf_mapping_ref                (XcfMapping         *mapping);
+void              xcf_mapping_unref              (XcfMapping         *mapping);
+
+GBytes          * xcf_mapping_get_bytes          (XcfMapping         *mapping);
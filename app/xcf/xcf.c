@@ -29,6 +29,8 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpdrawable.h"
@@ -40,9 +42,13 @@
 
 #include "xcf.h"
 #include "xcf-private.h"
+#include "xcf-incremental.h"
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
+#include "xcf-tile-handler.h"
+
+#include "gimp-log.h"
 
 #include "gimp-intl.h"
 
@@ -52,6 +58,31 @@ typedef GimpImage * GimpXcfLoaderFunc (Gimp     *gimp,
                                        GError  **error);
 
 
+static GimpImage      * xcf_load_stream_internal
+                                         (Gimp                  *gimp,
+                                          GInputStream          *input,
+                                          XcfMapping            *mapping,
+                                          GFile                 *input_file,
+                                          GimpProgress          *progress,
+                                          GError               **error);
+
+static void             xcf_save_info_init
+                                         (XcfInfo               *info,
+                                          GimpImage             *image);
+static gboolean         xcf_save_stream_internal
+                                         (Gimp                  *gimp,
+                                          GimpImage             *image,
+                                          GOutputStream         *output,
+                                          GSeekable             *seekable,
+                                          GFile                 *output_file,
+                                          GimpProgress          *progress,
+                                          XcfInfo               *info,
+                                          GError               **error);
+static gboolean         xcf_save_append  (Gimp                  *gimp,
+                                          GimpImage             *image,
+                                          GFile                 *file,
+                                          GimpProgress          *progress);
+
 static GimpValueArray * xcf_load_invoker (GimpProcedure         *procedure,
                                           Gimp                  *gimp,
                                           GimpContext           *context,
@@ -94,6 +125,9 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
   xcf_load_image,   /* version 23 */
   xcf_load_image,   /* version 24 */
   xcf_load_image,   /* version 25 */
+  xcf_load_image,   /* version 26 */
+  xcf_load_image,   /* version 27 */
+  xcf_load_image,   /* version 28 */
 };
 
 
@@ -242,18 +276,64 @@ xcf_load_stream (Gimp          *gimp,
                  GimpProgress  *progress,
                  GError       **error)
 {
-  XcfInfo      info  = { 0, };
-  const gchar *filename;
-  GimpImage   *image = NULL;
-  gchar        id[14];
-  gboolean     success;
-
   g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
   g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
   g_return_val_if_fail (input_file == NULL || G_IS_FILE (input_file), NULL);
   g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+  return xcf_load_stream_internal (gimp, input, NULL, input_file,
+                                   progress, error);
+}
+
+gboolean
+xcf_save_stream (Gimp           *gimp,
+                 GimpImage      *image,
+                 GOutputStream  *output,
+                 GFile          *output_file,
+                 GimpProgress   *progress,
+                 GError        **error)
+{
+  XcfInfo info = { 0, };
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (output), FALSE);
+  g_return_val_if_fail (output_file == NULL || G_IS_FILE (output_file), FALSE);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  xcf_save_info_init (&info, image);
+
+  return xcf_save_stream_internal (gimp, image, output, G_SEEKABLE (output),
+                                   output_file, progress, &info, error);
+}
+
+void
+xcf_drop_incremental_state (GimpImage *image)
+{
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  xcf_incremental_clear (image);
+}
+
+
+/*  private functions  */
+
+static GimpImage *
+xcf_load_stream_internal (Gimp          *gimp,
+                          GInputStream  *input,
+                          XcfMapping    *mapping,
+                          GFile         *input_file,
+                          GimpProgress  *progress,
+                          GError       **error)
+{
+  XcfInfo      info  = { 0, };
+  const gchar *filename;
+  GimpImage   *image = NULL;
+  gchar        id[14];
+  gboolean     success;
+
   if (input_file)
     filename = gimp_file_get_utf8_name (input_file);
   else
@@ -266,6 +346,7 @@ xcf_load_stream (Gimp          *gimp,
   info.progress         = progress;
   info.file             = input_file;
   info.compression      = COMPRESS_NONE;
+  info.mapping          = mapping;
 
   if (progress)
     gimp_progress_start (progress, FALSE, _("Opening '%s'"), filename);
@@ -322,76 +403,106 @@ xcf_load_stream (Gimp          *gimp,
   return image;
 }
 
-gboolean
-xcf_save_stream (Gimp           *gimp,
-                 GimpImage      *image,
-                 GOutputStream  *output,
-                 GFile          *output_file,
-                 GimpProgress   *progress,
-                 GError        **error)
+
+static void
+xcf_save_info_init (XcfInfo   *info,
+                    GimpImage *image)
+{
+  GimpXcfCompression compression = gimp_image_get_xcf_compression (image);
+
+  switch (compression)
+    {
+    case GIMP_XCF_COMPRESSION_NONE:
+      info->compression = COMPRESS_RLE;
+      break;
+
+    case GIMP_XCF_COMPRESSION_ZLIB:
+      info->compression = COMPRESS_ZLIB;
+      break;
+
+    case GIMP_XCF_COMPRESSION_ZSTD:
+      info->compression = COMPRESS_ZSTD;
+      break;
+    }
+
+  info->file_version = gimp_image_get_xcf_version (image, compression,
+                                                   NULL, NULL, NULL);
+
+  info->commit_sequence = 1;
+
+  if (info->file_version >= 11)
+    info->bytes_per_offset = 8;
+  else
+    info->bytes_per_offset = 4;
+}
+
+static gboolean
+xcf_save_stream_internal (Gimp           *gimp,
+                          GimpImage      *image,
+                          GOutputStream  *output,
+                          GSeekable      *seekable,
+                          GFile          *output_file,
+                          GimpProgress   *progress,
+                          XcfInfo        *info,
+                          GError        **error)
 {
-  XcfInfo       info     = { 0, };
   const gchar  *filename;
-  gboolean      success  = FALSE;
-  GError       *my_error = NULL;
+  goffset       append_pos = info->cp;
+  gboolean      success    = FALSE;
+  GError       *my_error   = NULL;
   GCancellable *cancellable;
 
-  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
-  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
-  g_return_val_if_fail (G_IS_OUTPUT_STREAM (output), FALSE);
-  g_return_val_if_fail (output_file == NULL || G_IS_FILE (output_file), FALSE);
-  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), FALSE);
-  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
   if (output_file)
     filename = gimp_file_get_utf8_name (output_file);
   else
     filename = _("Memory Stream");
 
-  info.gimp             = gimp;
-  info.output           = output;
-  info.seekable         = G_SEEKABLE (output);
-  info.bytes_per_offset = 4;
-  info.progress         = progress;
-  info.file             = output_file;
-
-  if (gimp_image_get_xcf_compression (image))
-    info.compression = COMPRESS_ZLIB;
-  else
-    info.compression = COMPRESS_RLE;
-
-  info.file_version = gimp_image_get_xcf_version (image,
-                                                  info.compression ==
-                                                  COMPRESS_ZLIB,
-                                                  NULL, NULL, NULL);
-
-  if (info.file_version >= 11)
-    info.bytes_per_offset = 8;
+  info->gimp     = gimp;
+  info->output   = output;
+  info->seekable = seekable;
+  info->progress = progress;
+  info->file     = output_file;
 
   if (progress)
     gimp_progress_start (progress, FALSE, _("Saving '%s'"), filename);
 
-  success = xcf_save_image (&info, image, &my_error);
+  success = xcf_save_image (info, image, &my_error);
 
-  cancellable = g_cancellable_new ();
-  if (success)
+  if (info->append)
     {
-      if (progress)
-        gimp_progress_set_text (progress, _("Closing '%s'"), filename);
+      /* unless the save went through, the commit slots still point at
+       * the previous header, so dropping whatever was appended
+       * restores the file.
+       */
+      if (! success)
+        g_seekable_truncate (seekable, append_pos, NULL, NULL);
+
+      if (! g_output_stream_close (output, NULL,
+                                   success ? &my_error : NULL))
+        success = FALSE;
     }
   else
     {
-      /* When closing the stream, the image will be actually saved,
-       * unless we properly cancel it with a GCancellable.
-       * Not closing the stream is not an option either, as this will
-       * happen anyway when finalizing the output.
-       * So let's make sure now that we don't overwrite the XCF file
-       * when an error occurred.
-       */
-      g_cancellable_cancel (cancellable);
+      cancellable = g_cancellable_new ();
+      if (success)
+        {
+          if (progress)
+            gimp_progress_set_text (progress, _("Closing '%s'"), filename);
+        }
+      else
+        {
+          /* When closing the stream, the image will be actually saved,
+           * unless we properly cancel it with a GCancellable.
+           * Not closing the stream is not an option either, as this will
+           * happen anyway when finalizing the output.
+           * So let's make sure now that we don't overwrite the XCF file
+           * when an error occurred.
+           */
+          g_cancellable_cancel (cancellable);
+        }
+      success = g_output_stream_close (output, cancellable, &my_error);
+      g_object_unref (cancellable);
     }
-  success = g_output_stream_close (info.output, cancellable, &my_error);
-  g_object_unref (cancellable);
 
   if (! success && my_error)
     g_propagate_prefixed_error (error, my_error,
@@ -403,8 +514,90 @@ xcf_save_stream (Gimp           *gimp,
   return success;
 }
 
+/* appends the changes since the last save to @file, in place.  returns
+ * FALSE if the file needs to be saved from scratch instead.
+ */
+static gboolean
+xcf_save_append (Gimp         *gimp,
+                 GimpImage    *image,
+                 GFile        *file,
+                 GimpProgress *progress)
+{
+  XcfIncremental *incremental = xcf_incremental_get (image);
+  XcfInfo         info        = { 0, };
+  GFileIOStream  *stream;
+  goffset         append_pos;
+  goffset         live_bytes;
+  GError         *my_error    = NULL;
+  gboolean        success;
+
+  xcf_save_info_init (&info, image);
+
+  if (! xcf_incremental_can_append (incremental, file,
+                                    info.file_version, info.compression))
+    return FALSE;
+
+  stream = g_file_open_readwrite (file, NULL, &my_error);
+
+  if (! stream)
+    {
+      GIMP_LOG (XCF, "can't append to '%s': %s",
+                gimp_file_get_utf8_name (file), my_error->message);
+      g_clear_error (&my_error);
+
+      return FALSE;
+    }
+
+  if (! g_seekable_can_truncate (G_SEEKABLE (stream)) ||
+      ! g_seekable_seek (G_SEEKABLE (stream), 0, G_SEEK_END, NULL, NULL))
+    {
+      g_object_unref (stream);
+
+      return FALSE;
+    }
+
+  append_pos = g_seekable_tell (G_SEEKABLE (stream));
+
+  info.cp              = append_pos;
+  info.append          = TRUE;
+  info.commit_sequence = incremental->sequence + 1;
+  info.prev_generation = incremental->generation;
+  info.generation      = xcf_incremental_new_generation ();
+
+  success = xcf_save_stream_internal (gimp, image,
+                                      g_io_stream_get_output_stream (G_IO_STREAM (stream)),
+                                      G_SEEKABLE (stream),
+                                      file, progress, &info, &my_error);
+
+  g_object_unref (stream);
+
+  if (! success)
+    {
+      if (my_error)
+        {
+          GIMP_LOG (XCF, "appending to '%s' failed: %s",
+                    gimp_file_get_utf8_name (file), my_error->message);
+          g_clear_error (&my_error);
+        }
+
+      return FALSE;
+    }
+
+  live_bytes = (XCF_COMMIT_SLOTS_END     +
+                (info.cp - append_pos)   +
+                info.reused_bytes);
+
+  GIMP_LOG (XCF, "appended %" G_GOFFSET_FORMAT " bytes, "
+            "reused %" G_GOFFSET_FORMAT " bytes",
+            info.cp - append_pos, info.reused_bytes);
+
+  xcf_incremental_set (image, file, info.generation,
+                       info.file_version, info.compression,
+                       info.commit_sequence, live_bytes);
+
+  return TRUE;
+}
 
-/*  private functions  */
 
 static GimpValueArray *
 xcf_load_invoker (GimpProcedure         *procedure,
@@ -415,20 +608,34 @@ xcf_load_invoker (GimpProcedure         *procedure,
                   GError               **error)
 {
   GimpValueArray *return_vals;
-  GimpImage      *image = NULL;
+  GimpImage      *image    = NULL;
   GFile          *file;
-  GInputStream   *input;
+  GInputStream   *input    = NULL;
+  XcfMapping     *mapping  = NULL;
   GError         *my_error = NULL;
 
   gimp_set_busy (gimp);
 
   file = g_value_get_object (gimp_value_array_index (args, 1));
 
-  input = G_INPUT_STREAM (g_file_read (file, NULL, &my_error));
+#ifndef G_OS_WIN32
+  /* a mapped file can't be replaced on Windows, which would break
+   * saving over the file, so lazy loading is not used there.
+   */
+  if (gimp->config->xcf_lazy_load)
+    mapping = xcf_mapping_new (gimp, file);
+
+  if (mapping)
+    input = g_memory_input_stream_new_from_bytes (xcf_mapping_get_bytes (mapping));
+#endif
+
+  if (! input)
+    input = G_INPUT_STREAM (g_file_read (file, NULL, &my_error));
 
   if (input)
     {
-      image = xcf_load_stream (gimp, input, file, progress, error);
+      image = xcf_load_stream_internal (gimp, input, mapping, file,
+                                        progress, error);
 
       g_object_unref (input);
     }
@@ -445,6 +652,8 @@ xcf_load_invoker (GimpProcedure         *procedure,
   if (image)
     g_value_set_object (gimp_value_array_index (return_vals, 1), image);
 
+  g_clear_pointer (&mapping, xcf_mapping_unref);
+
   gimp_unset_busy (gimp);
 
   return return_vals;
@@ -470,21 +679,45 @@ xcf_save_invoker (GimpProcedure         *procedure,
   image = g_value_get_object (gimp_value_array_index (args, 1));
   file  = g_value_get_object (gimp_value_array_index (args, 2));
 
-  output = G_OUTPUT_STREAM (g_file_replace (file,
-                                            NULL, FALSE, G_FILE_CREATE_NONE,
-                                            NULL, &my_error));
+  if (gimp->config->xcf_incremental_save)
+    success = xcf_save_append (gimp, image, file, progress);
+  else
+    xcf_incremental_clear (image);
 
-  if (output)
+  if (! success)
     {
-      success = xcf_save_stream (gimp, image, output, file, progress, error);
+      XcfInfo info = { 0, };
 
-      g_object_unref (output);
-    }
-  else
-    {
-      g_propagate_prefixed_error (error, my_error,
-                                  _("Error creating '%s': "),
-                                  gimp_file_get_utf8_name (file));
+      xcf_save_info_init (&info, image);
+
+      if (gimp->config->xcf_incremental_save)
+        info.generation = xcf_incremental_new_generation ();
+
+      output = G_OUTPUT_STREAM (g_file_replace (file,
+                                                NULL, FALSE, G_FILE_CREATE_NONE,
+                                                NULL, &my_error));
+
+      if (output)
+        {
+          success = xcf_save_stream_internal (gimp, image,
+                                              output, G_SEEKABLE (output),
+                                              file, progress, &info, error);
+
+          g_object_unref (output);
+        }
+      else
+        {
+          g_propagate_prefixed_error (error, my_error,
+                                      _("Error creating '%s': "),
+                                      gimp_file_get_utf8_name (file));
+        }
+
+      if (success && info.generation)
+        xcf_incremental_set (image, file, info.generation,
+                             info.file_version, info.compression,
+                             info.commit_sequence, info.cp);
+      else
+        xcf_incremental_clear (image);
     }
 
   return_vals = gimp_procedure_get_return_values (procedure, success,
@@ -33,3 +33,6 @@ gboolean    xcf_save_stream (Gimp           *gimp,
                              GFile          *output_file,
                              GimpProgress   *progress,
                              GError        **error);
+
+void        xcf_drop_incremental_state
+                            (GimpImage      *image);
@@ -58,10 +58,14 @@
 #endif
 
 #include "gimp.h"
+
+#include "libgimpbase/gimpprotocol.h"
+
 #include "gimp-shm.h"
 
 
-#define TILE_MAP_SIZE     (gimp_tile_width () * gimp_tile_height () * 32)
+#define TILE_SLOT_SIZE    (gimp_tile_width () * gimp_tile_height () * 32)
+#define TILE_MAP_SIZE     (TILE_SLOT_SIZE * GP_TILE_SHM_N_SLOTS)
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
 
@@ -72,6 +76,15 @@ static HANDLE  _shm_handle;
 static gint    _shm_ID   = -1;
 static guchar *_shm_addr = NULL;
 
+/*  the slots which are in use as the storage of a tile. slot 0 is
+ *  never lent, it is used for copying the tiles which don't get a slot
+ *  of their own.
+ */
+static GMutex   _slot_mutex;
+static gboolean _slot_lent[GP_TILE_SHM_N_SLOTS];
+static gint     _slot_next    = 1;
+static gint     _n_slots_lent = 0;
+
 
 guchar *
 _gimp_shm_addr (void)
@@ -79,6 +92,83 @@ _gimp_shm_addr (void)
   return _shm_addr;
 }
 
+guchar *
+_gimp_shm_slot_addr (guint slot)
+{
+  g_return_val_if_fail (slot < GP_TILE_SHM_N_SLOTS, NULL);
+
+  if (_shm_ID == -1)
+    return NULL;
+
+  return _shm_addr + (gsize) slot * TILE_SLOT_SIZE;
+}
+
+/* returns the slot @data points into, or -1 if it is not part of the
+ * shared memory segment.
+ */
+gint
+_gimp_shm_slot_find (gconstpointer data)
+{
+  const guchar *p = data;
+
+  if (_shm_ID == -1 || ! _shm_addr        ||
+      p < _shm_addr || p >= _shm_addr + (gsize) TILE_MAP_SIZE)
+    {
+      return -1;
+    }
+
+  return (p - _shm_addr) / TILE_SLOT_SIZE;
+}
+
+/* returns a slot for keeping a tile in, or 0 if all slots are in use */
+gint
+_gimp_shm_slot_lend (void)
+{
+  gint slot = 0;
+  gint i;
+
+  if (_shm_ID == -1)
+    return 0;
+
+  g_mutex_lock (&_slot_mutex);
+
+  /*  go round the ring, so a just released slot is reused last  */
+  for (i = 0; i < GP_TILE_SHM_N_SLOTS - 1; i++)
+    {
+      gint s = 1 + (_slot_next - 1 + i) % (GP_TILE_SHM_N_SLOTS - 1);
+
+      if (! _slot_lent[s])
+        {
+          _slot_lent[s] = TRUE;
+          _slot_next    = 1 + s % (GP_TILE_SHM_N_SLOTS - 1);
+          _n_slots_lent++;
+
+          slot = s;
+          break;
+        }
+    }
+
+  g_mutex_unlock (&_slot_mutex);
+
+  return slot;
+}
+
+void
+_gimp_shm_slot_release (gint slot)
+{
+  g_return_if_fail (slot > 0 && slot < GP_TILE_SHM_N_SLOTS);
+
+  g_mutex_lock (&_slot_mutex);
+
+  if (_slot_lent[slot])
+    {
+      _slot_lent[slot] = FALSE;
+      _n_slots_lent--;
+    }
+
+  g_mutex_unlock (&_slot_mutex);
+}
+
 void
 _gimp_shm_open (gint shm_ID)
 {
@@ -179,6 +269,12 @@ _gimp_shm_open (gint shm_ID)
 void
 _gimp_shm_close (void)
 {
+  /*  tiles still living in the segment may be accessed until the very
+   *  end, let exit() take care of the mapping then
+   */
+  if (g_atomic_int_get (&_n_slots_lent) > 0)
+    return;
+
 #if defined(USE_SYSV_SHM)
 
   if ((_shm_ID != -1) && _shm_addr)
@@ -24,10 +24,15 @@
 G_BEGIN_DECLS
 
 
-guchar * _gimp_shm_addr  (void);
+guchar * _gimp_shm_addr         (void);
+guchar * _gimp_shm_slot_addr    (guint         slot);
+gint     _gimp_shm_slot_find    (gconstpointer data);
 
-void     _gimp_shm_open  (gint shm_ID);
-void     _gimp_shm_close (void);
+gint     _gimp_shm_slot_lend    (void);
+void     _gimp_shm_slot_release (gint          slot);
+
+void     _gimp_shm_open         (gint          shm_ID);
+void     _gimp_shm_close        (void);
 
 
 G_END_DECLS
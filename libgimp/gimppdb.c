@@ -477,6 +477,109 @@ _gimp_pdb_run_procedure_array (GimpPDB              *pdb,
   return return_values;
 }
 
+/**
+ * _gimp_pdb_run_procedure_batch:
+ * @pdb:             the #GimpPDB object.
+ * @procedure_names: the procedures' registered names.
+ * @arguments:       the procedures' call arguments.
+ * @n_procedures:    the number of procedures.
+ *
+ * Runs all procedures in order, sending them to the core in a single
+ * message and receiving all return values in a single reply.
+ *
+ * The PDB's last error is set from the first failed call, or from the
+ * last call if they all succeeded.
+ *
+ * Returns: (transfer full): a newly allocated array of @n_procedures
+ *          return value arrays. Calls which were not run, because an
+ *          earlier one made the core close the connection, have
+ *          %NULL return values.
+ *
+ * Since: 3.2
+ */
+GimpValueArray **
+_gimp_pdb_run_procedure_batch (GimpPDB         *pdb,
+                               const gchar    **procedure_names,
+                               GimpValueArray **arguments,
+                               gint             n_procedures)
+{
+  GPProcBatchRun     proc_batch_run;
+  GPProcBatchReturn *proc_batch_return;
+  GimpWireMessage    msg;
+  GimpValueArray   **return_values;
+  GimpValueArray    *error_values = NULL;
+  gint               i;
+
+  g_return_val_if_fail (GIMP_IS_PDB (pdb), NULL);
+  g_return_val_if_fail (n_procedures > 0, NULL);
+  g_return_val_if_fail (procedure_names != NULL, NULL);
+  g_return_val_if_fail (arguments != NULL, NULL);
+
+  for (i = 0; i < n_procedures; i++)
+    {
+      g_return_val_if_fail (gimp_is_canonical_identifier (procedure_names[i]),
+                            NULL);
+      g_return_val_if_fail (arguments[i] != NULL, NULL);
+    }
+
+  proc_batch_run.n_procs = n_procedures;
+  proc_batch_run.procs   = g_new0 (GPProcRun, n_procedures);
+
+  for (i = 0; i < n_procedures; i++)
+    {
+      GPProcRun *proc_run = &proc_batch_run.procs[i];
+
+      proc_run->name     = (gchar *) procedure_names[i];
+      proc_run->n_params = gimp_value_array_length (arguments[i]);
+      proc_run->params   = _gimp_value_array_to_gp_params (arguments[i], FALSE);
+    }
+
+  if (! gp_proc_batch_run_write (_gimp_plug_in_get_write_channel (pdb->plug_in),
+                                 &proc_batch_run, pdb->plug_in))
+    gimp_quit ();
+
+  for (i = 0; i < n_procedures; i++)
+    _gimp_gp_params_free (proc_batch_run.procs[i].params,
+                          proc_batch_run.procs[i].n_params, FALSE);
+
+  g_free (proc_batch_run.procs);
+
+  _gimp_plug_in_read_expect_msg (pdb->plug_in, &msg, GP_PROC_BATCH_RETURN);
+
+  proc_batch_return = msg.data;
+
+  return_values = g_new0 (GimpValueArray *, n_procedures);
+
+  for (i = 0; i < MIN (n_procedures, proc_batch_return->n_procs); i++)
+    {
+      GPProcReturn *proc_return = &proc_batch_return->procs[i];
+
+      return_values[i] =
+        _gimp_gp_params_to_value_array (NULL,
+                                        NULL, 0,
+                                        proc_return->params,
+                                        proc_return->n_params,
+                                        TRUE);
+
+      if (! error_values &&
+          gimp_value_array_length (return_values[i]) > 0 &&
+          GIMP_VALUES_GET_ENUM (return_values[i], 0) != GIMP_PDB_SUCCESS)
+        {
+          error_values = return_values[i];
+        }
+    }
+
+  gimp_wire_destroy (&msg);
+
+  if (! error_values && i > 0)
+    error_values = return_values[i - 1];
+
+  if (error_values)
+    gimp_pdb_set_error (pdb, error_values);
+
+  return return_values;
+}
+
 
 /*  private functions  */
 
@@ -61,9 +61,13 @@ GimpPDBStatusType    gimp_pdb_get_last_status      (GimpPDB              *pdb);
 
 /* Internal use */
 
-G_GNUC_INTERNAL GimpValueArray * _gimp_pdb_run_procedure_array  (GimpPDB              *pdb,
-                                                                 const gchar          *procedure_name,
-                                                                 const GimpValueArray *arguments);
+G_GNUC_INTERNAL GimpValueArray  * _gimp_pdb_run_procedure_array (GimpPDB               *pdb,
+                                                                 const gchar           *procedure_name,
+                                                                 const GimpValueArray  *arguments);
+G_GNUC_INTERNAL GimpValueArray ** _gimp_pdb_run_procedure_batch (GimpPDB               *pdb,
+                                                                 const gchar          **procedure_names,
+                                                                 GimpValueArray       **arguments,
+                                                                 gint                   n_procedures);
 
 
 G_END_DECLS
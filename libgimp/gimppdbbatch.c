@@ -0,0 +1,296 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-2000 Peter Mattis and Spencer Kimball
+ *
+ * gimppdbbatch.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gimp.h"
+
+#include "gimppdbbatch.h"
+#include "gimpprocedureconfig-private.h"
+
+
+/**
+ * GimpPDBBatch:
+ *
+ * A list of procedure calls which are sent to the core at once.
+ *
+ * Every call of a procedure through the PDB is a round trip between
+ * the plug-in and the core. A batch collects many calls, runs them in
+ * the order they were added with a single message, and receives all
+ * their return values with a single reply, which makes a long series
+ * of small calls a lot cheaper.
+ *
+ * Since the calls are sent together, the arguments of a call can't
+ * depend on the return values of an earlier call in the same batch.
+ *
+ * Since: 3.2
+ */
+
+
+struct _GimpPDBBatch
+{
+  GObject          parent_instance;
+
+  GPtrArray       *procedure_names;
+  GPtrArray       *arguments;
+
+  GimpValueArray **return_values;
+  gint             n_return_values;
+};
+
+
+static void   gimp_pdb_batch_finalize            (GObject      *object);
+
+static void   gimp_pdb_batch_clear_return_values (GimpPDBBatch *batch);
+
+
+G_DEFINE_TYPE (GimpPDBBatch, gimp_pdb_batch, G_TYPE_OBJECT)
+
+#define parent_class gimp_pdb_batch_parent_class
+
+
+static void
+gimp_pdb_batch_class_init (GimpPDBBatchClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_pdb_batch_finalize;
+}
+
+static void
+gimp_pdb_batch_init (GimpPDBBatch *batch)
+{
+  batch->procedure_names = g_ptr_array_new_with_free_func (g_free);
+  batch->arguments       = g_ptr_array_new_with_free_func ((GDestroyNotify) gimp_value_array_unref);
+}
+
+static void
+gimp_pdb_batch_finalize (GObject *object)
+{
+  GimpPDBBatch *batch = GIMP_PDB_BATCH (object);
+
+  gimp_pdb_batch_clear_return_values (batch);
+
+  g_clear_pointer (&batch->procedure_names, g_ptr_array_unref);
+  g_clear_pointer (&batch->arguments,       g_ptr_array_unref);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+/*  public functions  */
+
+/**
+ * gimp_pdb_batch_new:
+ *
+ * Creates a new, empty batch of procedure calls.
+ *
+ * Returns: (transfer full): the new #GimpPDBBatch.
+ *
+ * Since: 3.2
+ */
+GimpPDBBatch *
+gimp_pdb_batch_new (void)
+{
+  return g_object_new (GIMP_TYPE_PDB_BATCH, NULL);
+}
+
+/**
+ * gimp_pdb_batch_add:
+ * @batch:          a #GimpPDBBatch.
+ * @procedure_name: the procedure's registered name.
+ * @arguments:      the procedure's arguments.
+ *
+ * Appends a call of the procedure named @procedure_name with
+ * @arguments to @batch.
+ *
+ * Returns: the index of the call, to be passed to
+ *          gimp_pdb_batch_get_return_values().
+ *
+ * Since: 3.2
+ */
+gint
+gimp_pdb_batch_add (GimpPDBBatch         *batch,
+                    const gchar          *procedure_name,
+                    const GimpValueArray *arguments)
+{
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), -1);
+  g_return_val_if_fail (gimp_is_canonical_identifier (procedure_name), -1);
+  g_return_val_if_fail (arguments != NULL, -1);
+
+  g_ptr_array_add (batch->procedure_names, g_strdup (procedure_name));
+  g_ptr_array_add (batch->arguments,
+                   gimp_value_array_copy (arguments));
+
+  return batch->procedure_names->len - 1;
+}
+
+/**
+ * gimp_pdb_batch_add_config:
+ * @batch:  a #GimpPDBBatch.
+ * @config: the arguments of the procedure to call.
+ *
+ * Appends a call of @config's procedure to @batch, with the arguments
+ * currently set in @config, like [method@Gimp.Procedure.run] would
+ * run it.
+ *
+ * Returns: the index of the call, to be passed to
+ *          gimp_pdb_batch_get_return_values().
+ *
+ * Since: 3.2
+ */
+gint
+gimp_pdb_batch_add_config (GimpPDBBatch        *batch,
+                           GimpProcedureConfig *config)
+{
+  GimpProcedure  *procedure;
+  GimpValueArray *args;
+
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), -1);
+  g_return_val_if_fail (GIMP_IS_PROCEDURE_CONFIG (config), -1);
+
+  procedure = gimp_procedure_config_get_procedure (config);
+
+  args = gimp_procedure_new_arguments (procedure);
+  _gimp_procedure_config_get_values (config, args);
+
+  g_ptr_array_add (batch->procedure_names,
+                   g_strdup (gimp_procedure_get_name (procedure)));
+  g_ptr_array_add (batch->arguments, args);
+
+  return batch->procedure_names->len - 1;
+}
+
+/**
+ * gimp_pdb_batch_get_n_calls:
+ * @batch: a #GimpPDBBatch.
+ *
+ * Returns: the number of calls in @batch.
+ *
+ * Since: 3.2
+ */
+gint
+gimp_pdb_batch_get_n_calls (GimpPDBBatch *batch)
+{
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), 0);
+
+  return batch->procedure_names->len;
+}
+
+/**
+ * gimp_pdb_batch_run:
+ * @batch: a #GimpPDBBatch.
+ *
+ * Runs all calls of @batch in the order they were added. All calls
+ * are run, even if an earlier one failed.
+ *
+ * The return values of the calls can be retrieved with
+ * gimp_pdb_batch_get_return_values() afterwards, and
+ * [method@Gimp.PDB.get_last_error] reports the first failed call.
+ *
+ * Returns: %TRUE if all calls succeeded.
+ *
+ * Since: 3.2
+ */
+gboolean
+gimp_pdb_batch_run (GimpPDBBatch *batch)
+{
+  gboolean success = TRUE;
+  gint     n_calls;
+  gint     i;
+
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), FALSE);
+
+  gimp_pdb_batch_clear_return_values (batch);
+
+  n_calls = batch->procedure_names->len;
+
+  if (n_calls == 0)
+    return TRUE;
+
+  batch->return_values =
+    _gimp_pdb_run_procedure_batch (gimp_get_pdb (),
+                                   (const gchar **) batch->procedure_names->pdata,
+                                   (GimpValueArray **) batch->arguments->pdata,
+                                   n_calls);
+
+  if (! batch->return_values)
+    return FALSE;
+
+  batch->n_return_values = n_calls;
+
+  for (i = 0; i < n_calls; i++)
+    {
+      GimpValueArray *return_values = batch->return_values[i];
+
+      if (! return_values                                ||
+          gimp_value_array_length (return_values) == 0   ||
+          GIMP_VALUES_GET_ENUM (return_values, 0) != GIMP_PDB_SUCCESS)
+        {
+          success = FALSE;
+        }
+    }
+
+  return success;
+}
+
+/**
+ * gimp_pdb_batch_get_return_values:
+ * @batch: a #GimpPDBBatch.
+ * @index: the index of a call, as returned when it was added.
+ *
+ * Returns the return values of the call at @index of the last
+ * gimp_pdb_batch_run().
+ *
+ * Returns: (transfer none) (nullable): the call's return values, or
+ *          %NULL if @batch wasn't run, or the call was never made.
+ *
+ * Since: 3.2
+ */
+GimpValueArray *
+gimp_pdb_batch_get_return_values (GimpPDBBatch *batch,
+                                  gint          index)
+{
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), NULL);
+  g_return_val_if_fail (index >= 0, NULL);
+
+  if (index >= batch->n_return_values)
+    return NULL;
+
+  return batch->return_values[index];
+}
+
+
+/*  private functions  */
+
+static void
+gimp_pdb_batch_clear_return_values (GimpPDBBatch *batch)
+{
+  gint i;
+
+  for (i = 0; i < batch->n_return_values; i++)
+    {
+      if (batch->return_values[i])
+        gimp_value_array_unref (batch->return_values[i]);
+    }
+
+  g_clear_pointer (&batch->return_values, g_free);
+  batch->n_return_values = 0;
+}
@@ -0,0 +1,54 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-2000 Peter Mattis and Spencer Kimball
+ *
+ * gimppdbbatch.h
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined (__GIMP_H_INSIDE__) && !defined (GIMP_COMPILATION)
+#error "Only <libgimp/gimp.h> can be included directly."
+#endif
+
+#ifndef __GIMP_PDB_BATCH_H__
+#define __GIMP_PDB_BATCH_H__
+
+G_BEGIN_DECLS
+
+/* For information look into the C source or the html documentation */
+
+
+#define GIMP_TYPE_PDB_BATCH (gimp_pdb_batch_get_type ())
+G_DECLARE_FINAL_TYPE (GimpPDBBatch, gimp_pdb_batch, GIMP, PDB_BATCH, GObject)
+
+
+GimpPDBBatch   * gimp_pdb_batch_new               (void);
+
+gint             gimp_pdb_batch_add               (GimpPDBBatch         *batch,
+                                                   const gchar          *procedure_name,
+                                                   const GimpValueArray *arguments);
+gint             gimp_pdb_batch_add_config        (GimpPDBBatch         *batch,
+                                                   GimpProcedureConfig  *config);
+
+gint             gimp_pdb_batch_get_n_calls       (GimpPDBBatch         *batch);
+
+gboolean         gimp_pdb_batch_run               (GimpPDBBatch         *batch);
+GimpValueArray * gimp_pdb_batch_get_return_values (GimpPDBBatch         *batch,
+                                                   gint                  index);
+
+
+G_END_DECLS
+
+#endif  /*  __GIMP_PDB_BATCH_H__  */
@@ -1407,6 +1407,14 @@ gimp_plug_in_loop (GimpPlugIn *plug_in)
         case GP_HAS_INIT:
           g_warning ("unexpected has init message received (should not happen)");
           break;
+
+        case GP_PROC_BATCH_RUN:
+          g_warning ("unexpected proc batch run message received (should not happen)");
+          break;
+
+        case GP_PROC_BATCH_RETURN:
+          g_warning ("unexpected proc batch return message received (should not happen)");
+          break;
         }
 
       gimp_wire_destroy (&msg);
@@ -1465,6 +1473,14 @@ gimp_plug_in_process_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       g_warning ("unexpected has init message received (should not happen)");
       break;
+
+    case GP_PROC_BATCH_RUN:
+      g_warning ("unexpected proc batch run message received (should not happen)");
+      break;
+
+    case GP_PROC_BATCH_RETURN:
+      g_warning ("unexpected proc batch return message received (should not happen)");
+      break;
     }
 }
 
@@ -48,6 +48,7 @@ struct _GimpTile
   guint   eheight;  /* the effective height of the tile */
 
   guchar *data;     /* the pixel data for the tile */
+  guint   stride;   /* the rowstride of the pixel data */
 };
 
 
@@ -85,10 +86,19 @@ static gboolean   gimp_tile_init  (GimpTileBackendPlugin *backend_plugin,
 static void       gimp_tile_unset (GimpTileBackendPlugin *backend_plugin,
                                    GimpTile              *tile);
 static void       gimp_tile_get   (GimpTileBackendPlugin *backend_plugin,
-                                   GimpTile              *tile);
+                                   GimpTile              *tile,
+                                   gint                   slot);
 static void       gimp_tile_put   (GimpTileBackendPlugin *backend_plugin,
                                    GimpTile              *tile);
 
+static void       gimp_tile_slot_release (gpointer        data);
+static void       gimp_tile_copy_rows    (const guchar   *src,
+                                          gint            src_stride,
+                                          guchar         *dest,
+                                          gint            dest_stride,
+                                          gint            row_size,
+                                          gint            n_rows);
+
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpTileBackendPlugin, _gimp_tile_backend_plugin,
                             GEGL_TYPE_TILE_BACKEND)
@@ -210,40 +220,46 @@ gimp_tile_read (GimpTileBackendPlugin *backend_plugin,
                 gint                   x,
                 gint                   y)
 {
-  GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
-  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
+  GimpTileBackendPluginPrivate *priv      = backend_plugin->priv;
+  GeglTileBackend              *backend   = GEGL_TILE_BACKEND (backend_plugin);
   GeglTile                     *tile;
   GimpTile                      gimp_tile = { 0, };
   gint                          tile_size;
-  guchar                       *tile_data;
+  gint                          slot;
 
   if (! gimp_tile_init (backend_plugin, &gimp_tile, y, x))
     return NULL;
 
-  tile_size  = gegl_tile_backend_get_tile_size (backend);
-  tile       = gegl_tile_new (tile_size);
-  tile_data  = gegl_tile_get_data (tile);
+  tile_size = gegl_tile_backend_get_tile_size (backend);
 
-  gimp_tile_get (backend_plugin, &gimp_tile);
+  slot = _gimp_shm_slot_lend ();
 
-  if (gimp_tile.ewidth * gimp_tile.eheight * priv->bpp == tile_size)
-    {
-      memcpy (tile_data, gimp_tile.data, tile_size);
-    }
-  else
+  gimp_tile_get (backend_plugin, &gimp_tile, slot);
+
+  if (slot != 0 && gimp_tile.data == _gimp_shm_slot_addr (slot))
     {
-      gint  tile_stride      = TILE_WIDTH * priv->bpp;
-      gint  gimp_tile_stride = gimp_tile.ewidth * priv->bpp;
-      guint row;
+      /*  the core wrote the tile right into its slot, which has the
+       *  layout of a GeglTile, so just lend the slot to the tile until
+       *  the tile is destroyed
+       */
+      tile = gegl_tile_new_bare ();
 
-      for (row = 0; row < gimp_tile.eheight; row++)
-        {
-          memcpy (tile_data      + row * tile_stride,
-                  gimp_tile.data + row * gimp_tile_stride,
-                  gimp_tile_stride);
-        }
+      gegl_tile_set_data_full (tile, gimp_tile.data, tile_size,
+                               gimp_tile_slot_release,
+                               GINT_TO_POINTER (slot));
+
+      return tile;
     }
 
+  if (slot != 0)
+    _gimp_shm_slot_release (slot);
+
+  tile = gegl_tile_new (tile_size);
+
+  gimp_tile_copy_rows (gimp_tile.data, gimp_tile.stride,
+                       gegl_tile_get_data (tile), TILE_WIDTH * priv->bpp,
+                       gimp_tile.ewidth * priv->bpp, gimp_tile.eheight);
+
   gimp_tile_unset (backend_plugin, &gimp_tile);
 
   return tile;
@@ -256,41 +272,16 @@ gimp_tile_write (GimpTileBackendPlugin *backend_plugin,
                  GeglTile              *tile)
 {
   GimpTileBackendPluginPrivate *priv      = backend_plugin->priv;
-  GeglTileBackend              *backend   = GEGL_TILE_BACKEND (backend_plugin);
   GimpTile                      gimp_tile = { 0, };
-  gint                          tile_size;
-  guchar                       *tile_data;
 
   if (! gimp_tile_init (backend_plugin, &gimp_tile, y, x))
     return FALSE;
 
-  tile_size = gegl_tile_backend_get_tile_size (backend);
-  tile_data = gegl_tile_get_data (tile);
-
-  gimp_tile.data = g_new (guchar,
-                          gimp_tile.ewidth * gimp_tile.eheight *
-                          priv->bpp);
-
-  if (gimp_tile.ewidth * gimp_tile.eheight * priv->bpp == tile_size)
-    {
-      memcpy (gimp_tile.data, tile_data, tile_size);
-    }
-  else
-    {
-      gint  tile_stride      = TILE_WIDTH * priv->bpp;
-      gint  gimp_tile_stride = gimp_tile.ewidth * priv->bpp;
-      guint row;
-
-      for (row = 0; row < gimp_tile.eheight; row++)
-        {
-          memcpy (gimp_tile.data + row * gimp_tile_stride,
-                  tile_data      + row * tile_stride,
-                  gimp_tile_stride);
-        }
-    }
+  /*  gimp_tile_put() takes care of repacking the data if needed  */
+  gimp_tile.data   = gegl_tile_get_data (tile);
+  gimp_tile.stride = TILE_WIDTH * priv->bpp;
 
   gimp_tile_put (backend_plugin, &gimp_tile);
-  gimp_tile_unset (backend_plugin, &gimp_tile);
 
   return TRUE;
 }
@@ -321,7 +312,8 @@ gimp_tile_init (GimpTileBackendPlugin *backend_plugin,
   else
     tile->eheight = TILE_HEIGHT;
 
-  tile->data = NULL;
+  tile->data   = NULL;
+  tile->stride = 0;
 
   return TRUE;
 }
@@ -330,12 +322,16 @@ static void
 gimp_tile_unset (GimpTileBackendPlugin *backend_plugin,
                  GimpTile              *tile)
 {
-  g_clear_pointer (&tile->data, g_free);
+  if (_gimp_shm_slot_find (tile->data) == -1)
+    g_free (tile->data);
+
+  tile->data = NULL;
 }
 
 static void
 gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
-               GimpTile              *tile)
+               GimpTile              *tile,
+               gint                   slot)
 {
   GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
   GimpPlugIn                   *plug_in = gimp_get_plug_in ();
@@ -346,6 +342,7 @@ gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
   tile_req.drawable_id = priv->drawable_id;
   tile_req.tile_num    = tile->tile_num;
   tile_req.shadow      = priv->shadow;
+  tile_req.slot        = slot;
 
   if (! gp_tile_req_write (_gimp_plug_in_get_write_channel (plug_in),
                            &tile_req, plug_in))
@@ -383,12 +380,20 @@ gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
 
   if (tile_data->use_shm)
     {
-      tile->data = g_memdup2 (_gimp_shm_addr (),
-                              tile->ewidth * tile->eheight * priv->bpp);
+      if (tile_data->slot != slot)
+        {
+          g_printerr ("received tile in slot %d instead of %d",
+                      tile_data->slot, slot);
+          gimp_quit ();
+        }
+
+      tile->data   = _gimp_shm_slot_addr (slot);
+      tile->stride = TILE_WIDTH * priv->bpp;
     }
   else
     {
-      tile->data = tile_data->data;
+      tile->data   = tile_data->data;
+      tile->stride = tile->ewidth * priv->bpp;
       tile_data->data = NULL;
     }
 
@@ -413,6 +418,7 @@ gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
   tile_req.drawable_id = -1;
   tile_req.tile_num    = 0;
   tile_req.shadow      = 0;
+  tile_req.slot        = 0;
 
   if (! gp_tile_req_write (_gimp_plug_in_get_write_channel (plug_in),
                            &tile_req, plug_in))
@@ -429,25 +435,44 @@ gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
   tile_data.width       = tile->ewidth;
   tile_data.height      = tile->eheight;
   tile_data.use_shm     = tile_info->use_shm;
+  tile_data.slot        = 0;
   tile_data.data        = NULL;
 
   if (tile_info->use_shm)
     {
-      memcpy (_gimp_shm_addr (),
-              tile->data,
-              tile->ewidth * tile->eheight * priv->bpp);
+      gint slot = _gimp_shm_slot_find (tile->data);
+
+      if (slot > 0)
+        {
+          /*  the tile's storage is a lent slot, nothing to copy  */
+          tile_data.slot = slot;
+        }
+      else
+        {
+          gimp_tile_copy_rows (tile->data, tile->stride,
+                               _gimp_shm_slot_addr (0), TILE_WIDTH * priv->bpp,
+                               tile->ewidth * priv->bpp, tile->eheight);
+        }
+    }
+  else if (tile->stride == tile->ewidth * priv->bpp)
+    {
+      tile_data.data = tile->data;
     }
   else
     {
-      tile_data.data = tile->data;
+      tile_data.data = g_malloc (tile->ewidth * tile->eheight * priv->bpp);
+
+      gimp_tile_copy_rows (tile->data, tile->stride,
+                           tile_data.data, tile->ewidth * priv->bpp,
+                           tile->ewidth * priv->bpp, tile->eheight);
     }
 
   if (! gp_tile_data_write (_gimp_plug_in_get_write_channel (plug_in),
                             &tile_data, plug_in))
     gimp_quit ();
 
-  if (! tile_info->use_shm)
-    tile_data.data = NULL;
+  if (tile_data.data != tile->data)
+    g_free (tile_data.data);
 
   gimp_wire_destroy (&msg);
 
@@ -455,3 +480,35 @@ gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
 
   gimp_wire_destroy (&msg);
 }
+
+/*  may be called from any thread destroying a tile  */
+static void
+gimp_tile_slot_release (gpointer data)
+{
+  _gimp_shm_slot_release (GPOINTER_TO_INT (data));
+}
+
+static void
+gimp_tile_copy_rows (const guchar *src,
+                     gint          src_stride,
+                     guchar       *dest,
+                     gint          dest_stride,
+                     gint          row_size,
+                     gint          n_rows)
+{
+  if (src_stride == dest_stride)
+    {
+      memcpy (dest, src, src_stride * (n_rows - 1) + row_size);
+    }
+  else
+    {
+      gint row;
+
+      for (row = 0; row < n_rows; row++)
+        {
+          memcpy (dest + row * dest_stride,
+                  src  + row * src_stride,
+                  row_size);
+        }
+    }
+}
@@ -29,6 +29,7 @@ G_BEGIN_DECLS
 
 
 typedef struct _GimpPDB                  GimpPDB;
+typedef struct _GimpPDBBatch             GimpPDBBatch;
 typedef struct _GimpPlugIn               GimpPlugIn;
 typedef struct _GimpProcedure            GimpProcedure;
 typedef struct _GimpBatchProcedure       GimpBatchProcedure;
@@ -0,0 +1,93 @@
+#define NEW_IMAGE_WIDTH  31
+#define NEW_IMAGE_HEIGHT 17
+
+static GimpValueArray *
+gimp_c_test_run (GimpProcedure        *procedure,
+                 GimpRunMode           run_mode,
+                 GimpImage            *image,
+                 GimpDrawable        **drawables,
+                 GimpProcedureConfig  *config,
+                 gpointer              run_data)
+{
+  GimpPDBBatch        *batch;
+  GimpProcedure       *image_new;
+  GimpProcedureConfig *image_new_config;
+  GimpValueArray      *args;
+  GimpValueArray      *retvals;
+  GimpImage           *first_image  = NULL;
+  GimpImage           *second_image = NULL;
+  gint                 first;
+  gint                 missing;
+  gint                 second;
+
+  image_new = gimp_pdb_lookup_procedure (gimp_get_pdb (), "gimp-image-new");
+
+  batch = gimp_pdb_batch_new ();
+
+  image_new_config = gimp_procedure_create_config (image_new);
+  g_object_set (image_new_config,
+                "width",  NEW_IMAGE_WIDTH,
+                "height", NEW_IMAGE_HEIGHT,
+                "type",   GIMP_RGB,
+                NULL);
+
+  first = gimp_pdb_batch_add_config (batch, image_new_config);
+
+  args = gimp_value_array_new (0);
+  missing = gimp_pdb_batch_add (batch, "test-pdb-batch-no-such-procedure",
+                                args);
+  gimp_value_array_unref (args);
+
+  g_object_set (image_new_config,
+                "width",  NEW_IMAGE_HEIGHT,
+                "height", NEW_IMAGE_WIDTH,
+                NULL);
+
+  second = gimp_pdb_batch_add_config (batch, image_new_config);
+  g_object_unref (image_new_config);
+
+  GIMP_TEST_START("gimp_pdb_batch_add()");
+  GIMP_TEST_END(first == 0 && missing == 1 && second == 2 &&
+                gimp_pdb_batch_get_n_calls (batch) == 3);
+
+  GIMP_TEST_START("gimp_pdb_batch_get_return_values() before running");
+  GIMP_TEST_END(gimp_pdb_batch_get_return_values (batch, first) == NULL);
+
+  GIMP_TEST_START("gimp_pdb_batch_run() reports the failed call");
+  GIMP_TEST_END(! gimp_pdb_batch_run (batch));
+
+  GIMP_TEST_START("Call before the failed call succeeded");
+  retvals = gimp_pdb_batch_get_return_values (batch, first);
+  if (retvals && GIMP_VALUES_GET_ENUM (retvals, 0) == GIMP_PDB_SUCCESS)
+    first_image = GIMP_VALUES_GET_IMAGE (retvals, 1);
+  GIMP_TEST_END(GIMP_IS_IMAGE (first_image) &&
+                gimp_image_get_width (first_image)  == NEW_IMAGE_WIDTH &&
+                gimp_image_get_height (first_image) == NEW_IMAGE_HEIGHT);
+
+  GIMP_TEST_START("Call of an unknown procedure failed");
+  retvals = gimp_pdb_batch_get_return_values (batch, missing);
+  GIMP_TEST_END(retvals != NULL &&
+                GIMP_VALUES_GET_ENUM (retvals, 0) == GIMP_PDB_CALLING_ERROR);
+
+  GIMP_TEST_START("Call after the failed call was still run");
+  retvals = gimp_pdb_batch_get_return_values (batch, second);
+  if (retvals && GIMP_VALUES_GET_ENUM (retvals, 0) == GIMP_PDB_SUCCESS)
+    second_image = GIMP_VALUES_GET_IMAGE (retvals, 1);
+  GIMP_TEST_END(GIMP_IS_IMAGE (second_image) && second_image != first_image &&
+                gimp_image_get_width (second_image)  == NEW_IMAGE_HEIGHT &&
+                gimp_image_get_height (second_image) == NEW_IMAGE_WIDTH);
+
+  GIMP_TEST_START("gimp_pdb_batch_get_return_values() out of range");
+  GIMP_TEST_END(gimp_pdb_batch_get_return_values (batch, 3) == NULL);
+
+  g_object_unref (batch);
+
+  GIMP_TEST_START("Batch images are in the image list");
+  GIMP_TEST_END(gimp_image_is_valid (first_image) &&
+                gimp_image_is_valid (second_image));
+
+  gimp_image_delete (first_image);
+  gimp_image_delete (second_image);
+
+  GIMP_TEST_RETURN
+}
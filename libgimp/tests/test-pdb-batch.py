@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+
+NEW_IMAGE_WIDTH  = 31
+NEW_IMAGE_HEIGHT = 17
+
+image_new = Gimp.get_pdb().lookup_procedure('gimp-image-new')
+
+batch = Gimp.PDBBatch.new()
+
+config = image_new.create_config()
+config.set_property('width', NEW_IMAGE_WIDTH)
+config.set_property('height', NEW_IMAGE_HEIGHT)
+config.set_property('type', Gimp.ImageBaseType.RGB)
+first = batch.add_config(config)
+
+missing = batch.add('test-pdb-batch-no-such-procedure', Gimp.ValueArray.new(0))
+
+config.set_property('width', NEW_IMAGE_HEIGHT)
+config.set_property('height', NEW_IMAGE_WIDTH)
+second = batch.add_config(config)
+
+gimp_assert('Gimp.PDBBatch.add()',
+            first == 0 and missing == 1 and second == 2 and
+            batch.get_n_calls() == 3)
+
+gimp_assert('Gimp.PDBBatch.run() reports the failed call', not batch.run())
+
+result = batch.get_return_values(first)
+gimp_assert('Call before the failed call succeeded',
+            result.index(0) == Gimp.PDBStatusType.SUCCESS)
+first_image = result.index(1)
+gimp_assert('Call before the failed call created the image',
+            first_image.get_width() == NEW_IMAGE_WIDTH and
+            first_image.get_height() == NEW_IMAGE_HEIGHT)
+
+result = batch.get_return_values(missing)
+gimp_assert('Call of an unknown procedure failed',
+            result.index(0) == Gimp.PDBStatusType.CALLING_ERROR)
+
+result = batch.get_return_values(second)
+gimp_assert('Call after the failed call was still run',
+            result.index(0) == Gimp.PDBStatusType.SUCCESS)
+second_image = result.index(1)
+gimp_assert('Call after the failed call created the image',
+            second_image != first_image and
+            second_image.get_width() == NEW_IMAGE_HEIGHT and
+            second_image.get_height() == NEW_IMAGE_WIDTH)
+
+first_image.delete()
+second_image.delete()
@@ -0,0 +1,106 @@
+/* Tile transport between the core and plug-ins.
+ *
+ * The image size is not a multiple of the tile size, so that tiles
+ * which are only partly inside the drawable are sent as well.  Running
+ * the test with GIMP's --no-shm option measures the pipe transport for
+ * comparison with the shared memory tile slots.
+ */
+
+#define TEST_WIDTH      2000
+#define TEST_HEIGHT     1500
+#define TEST_ITERATIONS 8
+
+static void
+fill_pattern (guchar *data,
+              gint    bpp,
+              gint    seed)
+{
+  gint i;
+
+  for (i = 0; i < TEST_WIDTH * TEST_HEIGHT * bpp; i++)
+    data[i] = (i * 7 + seed) & 0xff;
+}
+
+static GimpValueArray *
+gimp_c_test_run (GimpProcedure        *procedure,
+                 GimpRunMode           run_mode,
+                 GimpImage            *image,
+                 GimpDrawable        **drawables,
+                 GimpProcedureConfig  *config,
+                 gpointer              run_data)
+{
+  GimpImage   *img;
+  GimpLayer   *layer;
+  GeglBuffer  *buffer;
+  const Babl  *format;
+  guchar      *src;
+  guchar      *dest;
+  gsize        size;
+  gint         bpp;
+  GTimer      *timer;
+  gint         i;
+
+  GIMP_TEST_START("gimp_image_new()")
+  img = gimp_image_new (TEST_WIDTH, TEST_HEIGHT, GIMP_RGB);
+  GIMP_TEST_END(GIMP_IS_IMAGE (img))
+
+  layer = gimp_layer_new (img, "tiles", TEST_WIDTH, TEST_HEIGHT,
+                          GIMP_RGBA_IMAGE, 100.0, GIMP_LAYER_MODE_NORMAL);
+
+  GIMP_TEST_START("insert layer")
+  GIMP_TEST_END(gimp_image_insert_layer (img, layer, NULL, 0))
+
+  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+  bpp    = babl_format_get_bytes_per_pixel (format);
+  size   = (gsize) TEST_WIDTH * TEST_HEIGHT * bpp;
+  src    = g_malloc (size);
+  dest   = g_malloc (size);
+  timer  = g_timer_new ();
+
+  /* Write and read back a different pattern each time, so stale data
+   * left in a tile slot is detected.
+   */
+  GIMP_TEST_START("write and read back tiles")
+  for (i = 0; i < TEST_ITERATIONS && ! error; i++)
+    {
+      gdouble write_time;
+      gdouble read_time;
+
+      fill_pattern (src, bpp, i);
+
+      g_timer_start (timer);
+
+      buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+      gegl_buffer_set (buffer, NULL, 0, format, src, GEGL_AUTO_ROWSTRIDE);
+      gegl_buffer_flush (buffer);
+      g_object_unref (buffer);
+
+      write_time = g_timer_elapsed (timer, NULL);
+
+      g_timer_start (timer);
+
+      buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+      gegl_buffer_get (buffer, NULL, 1.0, format, dest,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      g_object_unref (buffer);
+
+      read_time = g_timer_elapsed (timer, NULL);
+
+      printf ("\n  write: %.1f MB/s, read: %.1f MB/s",
+              size / write_time / (1 << 20),
+              size / read_time  / (1 << 20));
+
+      if (memcmp (src, dest, size) != 0)
+        break;
+    }
+  printf ("\n");
+  GIMP_TEST_END(i == TEST_ITERATIONS)
+
+  g_timer_destroy (timer);
+  g_free (src);
+  g_free (dest);
+
+  gimp_image_delete (img);
+
+  GIMP_TEST_RETURN
+}
@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+
+# The image size is not a multiple of the tile size, so that tiles which
+# are only partly inside the drawable are sent as well.
+
+TEST_WIDTH  = 600
+TEST_HEIGHT = 333
+
+image = Gimp.Image.new(TEST_WIDTH, TEST_HEIGHT, Gimp.ImageBaseType.RGB)
+layer = Gimp.Layer.new(image, "tiles", TEST_WIDTH, TEST_HEIGHT,
+                       Gimp.ImageType.RGBA_IMAGE, 100.0,
+                       Gimp.LayerMode.NORMAL)
+gimp_assert('insert layer', image.insert_layer(layer, None, 0))
+
+size = TEST_WIDTH * TEST_HEIGHT * 4
+
+for seed in range(3):
+  src = bytes((i * 7 + seed) & 0xff for i in range(size))
+
+  buffer = layer.get_buffer()
+  buffer.set(buffer.get_extent(), None, src)
+  buffer.flush()
+  buffer = None
+
+  buffer = layer.get_buffer()
+  dest = buffer.get(buffer.get_extent(), 1.0, None, Gegl.AbyssPolicy.NONE)
+  buffer = None
+
+  gimp_assert('write and read back tiles ({})'.format(seed), dest == src)
+
+image.delete()
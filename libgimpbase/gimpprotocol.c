@@ -147,6 +147,22 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_proc_batch_run_read      (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_batch_run_write     (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_batch_run_destroy   (GimpWireMessage  *msg);
+
+static void _gp_proc_batch_return_read    (GIOChannel       *channel,
+                                           GimpWireMessage  *msg,
+                                           gpointer          user_data);
+static void _gp_proc_batch_return_write   (GIOChannel       *channel,
+                                           GimpWireMessage  *msg,
+                                           gpointer          user_data);
+static void _gp_proc_batch_return_destroy (GimpWireMessage  *msg);
+
 
 
 void
@@ -204,6 +220,14 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_PROC_BATCH_RUN,
+                      _gp_proc_batch_run_read,
+                      _gp_proc_batch_run_write,
+                      _gp_proc_batch_run_destroy);
+  gimp_wire_register (GP_PROC_BATCH_RETURN,
+                      _gp_proc_batch_return_read,
+                      _gp_proc_batch_return_write,
+                      _gp_proc_batch_return_destroy);
 }
 
 /* public writing API */
@@ -451,6 +475,44 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_proc_batch_run_write (GIOChannel     *channel,
+                         GPProcBatchRun *proc_batch_run,
+                         gpointer        user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_PROC_BATCH_RUN;
+  msg.data = proc_batch_run;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_proc_batch_return_write (GIOChannel        *channel,
+                            GPProcBatchReturn *proc_batch_return,
+                            gpointer           user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_PROC_BATCH_RETURN;
+  msg.data = proc_batch_return;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -757,6 +819,9 @@ _gp_tile_req_read (GIOChannel      *channel,
   if (! _gimp_wire_read_int32 (channel,
                                &tile_req->shadow, 1, user_data))
     goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_req->slot, 1, user_data))
+    goto cleanup;
 
   msg->data = tile_req;
   return;
@@ -783,6 +848,9 @@ _gp_tile_req_write (GIOChannel      *channel,
   if (! _gimp_wire_write_int32 (channel,
                                 &tile_req->shadow, 1, user_data))
     return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_req->slot, 1, user_data))
+    return;
 }
 
 static void
@@ -846,6 +914,9 @@ _gp_tile_data_read (GIOChannel      *channel,
   if (! _gimp_wire_read_int32 (channel,
                                &tile_data->use_shm, 1, user_data))
     goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_data->slot, 1, user_data))
+    goto cleanup;
 
   if (!tile_data->use_shm)
     {
@@ -897,6 +968,9 @@ _gp_tile_data_write (GIOChannel      *channel,
   if (! _gimp_wire_write_int32 (channel,
                                 &tile_data->use_shm, 1, user_data))
     return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_data->slot, 1, user_data))
+    return;
 
   if (!tile_data->use_shm)
     {
@@ -2525,3 +2599,186 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/*  proc_batch_run  */
+
+static void
+_gp_proc_batch_run_read (GIOChannel      *channel,
+                         GimpWireMessage *msg,
+                         gpointer         user_data)
+{
+  GPProcBatchRun *proc_batch_run = g_slice_new0 (GPProcBatchRun);
+  guint           i;
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &proc_batch_run->n_procs, 1, user_data))
+    goto cleanup;
+
+  proc_batch_run->procs = g_try_new0 (GPProcRun, proc_batch_run->n_procs);
+
+  if (proc_batch_run->n_procs > 0 && ! proc_batch_run->procs)
+    {
+      g_printerr ("%s: failed to allocate %u procedure calls\n",
+                  G_STRFUNC, proc_batch_run->n_procs);
+      goto cleanup;
+    }
+
+  for (i = 0; i < proc_batch_run->n_procs; i++)
+    {
+      GPProcRun *proc_run = &proc_batch_run->procs[i];
+
+      if (! _gimp_wire_read_string (channel, &proc_run->name, 1, user_data))
+        goto cleanup;
+
+      _gp_params_read (channel,
+                       &proc_run->params, (guint *) &proc_run->n_params,
+                       user_data);
+    }
+
+  msg->data = proc_batch_run;
+  return;
+
+ cleanup:
+  msg->data = proc_batch_run;
+  _gp_proc_batch_run_destroy (msg);
+  msg->data = NULL;
+}
+
+static void
+_gp_proc_batch_run_write (GIOChannel      *channel,
+                          GimpWireMessage *msg,
+                          gpointer         user_data)
+{
+  GPProcBatchRun *proc_batch_run = msg->data;
+  guint           i;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_batch_run->n_procs, 1, user_data))
+    return;
+
+  for (i = 0; i < proc_batch_run->n_procs; i++)
+    {
+      GPProcRun *proc_run = &proc_batch_run->procs[i];
+
+      if (! _gimp_wire_write_string (channel, &proc_run->name, 1, user_data))
+        return;
+
+      _gp_params_write (channel,
+                        proc_run->params, proc_run->n_params, user_data);
+    }
+}
+
+static void
+_gp_proc_batch_run_destroy (GimpWireMessage *msg)
+{
+  GPProcBatchRun *proc_batch_run = msg->data;
+
+  if (proc_batch_run)
+    {
+      guint i;
+
+      for (i = 0; proc_batch_run->procs && i < proc_batch_run->n_procs; i++)
+        {
+          _gp_params_destroy (proc_batch_run->procs[i].params,
+                              proc_batch_run->procs[i].n_params);
+
+          g_free (proc_batch_run->procs[i].name);
+        }
+
+      g_free (proc_batch_run->procs);
+      g_slice_free (GPProcBatchRun, proc_batch_run);
+    }
+}
+
+/*  proc_batch_return  */
+
+static void
+_gp_proc_batch_return_read (GIOChannel      *channel,
+                            GimpWireMessage *msg,
+                            gpointer         user_data)
+{
+  GPProcBatchReturn *proc_batch_return = g_slice_new0 (GPProcBatchReturn);
+  guint              i;
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &proc_batch_return->n_procs, 1, user_data))
+    goto cleanup;
+
+  proc_batch_return->procs = g_try_new0 (GPProcReturn,
+                                         proc_batch_return->n_procs);
+
+  if (proc_batch_return->n_procs > 0 && ! proc_batch_return->procs)
+    {
+      g_printerr ("%s: failed to allocate %u procedure returns\n",
+                  G_STRFUNC, proc_batch_return->n_procs);
+      goto cleanup;
+    }
+
+  for (i = 0; i < proc_batch_return->n_procs; i++)
+    {
+      GPProcReturn *proc_return = &proc_batch_return->procs[i];
+
+      if (! _gimp_wire_read_string (channel, &proc_return->name, 1, user_data))
+        goto cleanup;
+
+      _gp_params_read (channel,
+                       &proc_return->params, (guint *) &proc_return->n_params,
+                       user_data);
+    }
+
+  msg->data = proc_batch_return;
+  return;
+
+ cleanup:
+  msg->data = proc_batch_return;
+  _gp_proc_batch_return_destroy (msg);
+  msg->data = NULL;
+}
+
+static void
+_gp_proc_batch_return_write (GIOChannel      *channel,
+                             GimpWireMessage *msg,
+                             gpointer         user_data)
+{
+  GPProcBatchReturn *proc_batch_return = msg->data;
+  guint              i;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_batch_return->n_procs, 1, user_data))
+    return;
+
+  for (i = 0; i < proc_batch_return->n_procs; i++)
+    {
+      GPProcReturn *proc_return = &proc_batch_return->procs[i];
+
+      if (! _gimp_wire_write_string (channel, &proc_return->name, 1, user_data))
+        return;
+
+      _gp_params_write (channel,
+                        proc_return->params, proc_return->n_params, user_data);
+    }
+}
+
+static void
+_gp_proc_batch_return_destroy (GimpWireMessage *msg)
+{
+  GPProcBatchReturn *proc_batch_return = msg->data;
+
+  if (proc_batch_return)
+    {
+      guint i;
+
+      for (i = 0;
+           proc_batch_return->procs && i < proc_batch_return->n_procs;
+           i++)
+        {
+          _gp_params_destroy (proc_batch_return->procs[i].params,
+                              proc_batch_return->procs[i].n_params);
+
+          g_free (proc_batch_return->procs[i].name);
+        }
+
+      g_free (proc_batch_return->procs);
+      g_slice_free (GPProcBatchReturn, proc_batch_return);
+    }
+}
@@ -26,7 +26,14 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0115
+#define GIMP_PROTOCOL_VERSION  0x0117
+
+
+/* The shared memory segment passed in GPConfig is divided into this
+ * many tile slots, each large enough for a tile of 32 bytes per pixel.
+ * Tiles in a slot are stored with the rowstride of a full tile.
+ */
+#define GP_TILE_SHM_N_SLOTS    16
 
 
 enum
@@ -43,7 +50,9 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_PROC_BATCH_RUN,
+  GP_PROC_BATCH_RETURN
 };
 
 typedef enum
@@ -114,6 +123,8 @@ typedef struct _GPProcRun                GPProcRun;
 typedef struct _GPProcReturn             GPProcReturn;
 typedef struct _GPProcInstall            GPProcInstall;
 typedef struct _GPProcUninstall          GPProcUninstall;
+typedef struct _GPProcBatchRun           GPProcBatchRun;
+typedef struct _GPProcBatchReturn        GPProcBatchReturn;
 
 
 struct _GPConfig
@@ -163,6 +174,7 @@ struct _GPTileReq
   gint32   drawable_id;
   guint32  tile_num;
   guint32  shadow;
+  guint32  slot;
 };
 
 struct _GPTileData
@@ -174,6 +186,7 @@ struct _GPTileData
   guint32  width;
   guint32  height;
   guint32  use_shm;
+  guint32  slot;
   guchar  *data;
 };
 
@@ -364,6 +377,21 @@ struct _GPProcReturn
   GPParam *params;
 };
 
+/* A batch of procedure calls, which are run in order, and whose
+ * return values are sent back in a single GP_PROC_BATCH_RETURN.
+ */
+struct _GPProcBatchRun
+{
+  guint32       n_procs;
+  GPProcRun    *procs;
+};
+
+struct _GPProcBatchReturn
+{
+  guint32       n_procs;
+  GPProcReturn *procs;
+};
+
 struct _GPProcInstall
 {
   gchar      *name;
@@ -380,43 +408,49 @@ struct _GPProcUninstall
 };
 
 
-void      gp_init                   (void);
-
-gboolean  gp_quit_write             (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_config_write           (GIOChannel      *channel,
-                                     GPConfig        *config,
-                                     gpointer         user_data);
-gboolean  gp_tile_req_write         (GIOChannel      *channel,
-                                     GPTileReq       *tile_req,
-                                     gpointer         user_data);
-gboolean  gp_tile_ack_write         (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_tile_data_write        (GIOChannel      *channel,
-                                     GPTileData      *tile_data,
-                                     gpointer         user_data);
-gboolean  gp_proc_run_write         (GIOChannel      *channel,
-                                     GPProcRun       *proc_run,
-                                     gpointer         user_data);
-gboolean  gp_proc_return_write      (GIOChannel      *channel,
-                                     GPProcReturn    *proc_return,
-                                     gpointer         user_data);
-gboolean  gp_temp_proc_run_write    (GIOChannel      *channel,
-                                     GPProcRun       *proc_run,
-                                     gpointer         user_data);
-gboolean  gp_temp_proc_return_write (GIOChannel      *channel,
-                                     GPProcReturn    *proc_return,
-                                     gpointer         user_data);
-gboolean  gp_proc_install_write     (GIOChannel      *channel,
-                                     GPProcInstall   *proc_install,
-                                     gpointer         user_data);
-gboolean  gp_proc_uninstall_write   (GIOChannel      *channel,
-                                     GPProcUninstall *proc_uninstall,
-                                     gpointer         user_data);
-gboolean  gp_extension_ack_write    (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_has_init_write         (GIOChannel      *channel,
-                                     gpointer         user_data);
+void      gp_init                    (void);
+
+gboolean  gp_quit_write              (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_config_write            (GIOChannel        *channel,
+                                      GPConfig          *config,
+                                      gpointer           user_data);
+gboolean  gp_tile_req_write          (GIOChannel        *channel,
+                                      GPTileReq         *tile_req,
+                                      gpointer           user_data);
+gboolean  gp_tile_ack_write          (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_tile_data_write         (GIOChannel        *channel,
+                                      GPTileData        *tile_data,
+                                      gpointer           user_data);
+gboolean  gp_proc_run_write          (GIOChannel        *channel,
+                                      GPProcRun         *proc_run,
+                                      gpointer           user_data);
+gboolean  gp_proc_return_write       (GIOChannel        *channel,
+                                      GPProcReturn      *proc_return,
+                                      gpointer           user_data);
+gboolean  gp_temp_proc_run_write     (GIOChannel        *channel,
+                                      GPProcRun         *proc_run,
+                                      gpointer           user_data);
+gboolean  gp_temp_proc_return_write  (GIOChannel        *channel,
+                                      GPProcReturn      *proc_return,
+                                      gpointer           user_data);
+gboolean  gp_proc_install_write      (GIOChannel        *channel,
+                                      GPProcInstall     *proc_install,
+                                      gpointer           user_data);
+gboolean  gp_proc_uninstall_write    (GIOChannel        *channel,
+                                      GPProcUninstall   *proc_uninstall,
+                                      gpointer           user_data);
+gboolean  gp_extension_ack_write     (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_has_init_write          (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_proc_batch_run_write    (GIOChannel        *channel,
+                                      GPProcBatchRun    *proc_batch_run,
+                                      gpointer           user_data);
+gboolean  gp_proc_batch_return_write (GIOChannel        *channel,
+                                      GPProcBatchReturn *proc_batch_return,
+                                      gpointer           user_data);
 
 
 G_END_DECLS
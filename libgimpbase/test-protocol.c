@@ -0,0 +1,309 @@
+/* Round-trip tests for the plug-in wire protocol */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "gimpbase.h"
+#include "gimpprotocol.h"
+#include "gimpwire.h"
+
+
+typedef struct
+{
+  GByteArray *data;
+  guint       pos;
+} WireBuffer;
+
+
+static gboolean
+wire_buffer_read (GIOChannel *channel,
+                  guint8     *buf,
+                  gulong      count,
+                  gpointer    user_data)
+{
+  WireBuffer *buffer = user_data;
+
+  if (buffer->pos + count > buffer->data->len)
+    return FALSE;
+
+  memcpy (buf, buffer->data->data + buffer->pos, count);
+  buffer->pos += count;
+
+  return TRUE;
+}
+
+static gboolean
+wire_buffer_write (GIOChannel   *channel,
+                   const guint8 *buf,
+                   gulong        count,
+                   gpointer      user_data)
+{
+  WireBuffer *buffer = user_data;
+
+  g_byte_array_append (buffer->data, buf, count);
+
+  return TRUE;
+}
+
+static gboolean
+wire_buffer_flush (GIOChannel *channel,
+                   gpointer    user_data)
+{
+  return TRUE;
+}
+
+static void
+wire_buffer_init (WireBuffer *buffer)
+{
+  buffer->data = g_byte_array_new ();
+  buffer->pos  = 0;
+
+  gimp_wire_clear_error ();
+}
+
+static void
+wire_buffer_free (WireBuffer *buffer)
+{
+  g_byte_array_free (buffer->data, TRUE);
+
+  gimp_wire_clear_error ();
+}
+
+static void
+params_init (GPParam *params,
+             gint     id)
+{
+  params[0].param_type = GP_PARAM_TYPE_INT;
+  params[0].type_name  = "GimpPDBStatusType";
+  params[0].data.d_int = id;
+
+  params[1].param_type    = GP_PARAM_TYPE_DOUBLE;
+  params[1].type_name     = "gdouble";
+  params[1].data.d_double = id + 0.25;
+
+  params[2].param_type    = GP_PARAM_TYPE_STRING;
+  params[2].type_name     = "gchararray";
+  params[2].data.d_string = id % 2 ? "odd" : "even";
+}
+
+static void
+params_check (const GPParam *params,
+              guint32        n_params,
+              gint           id)
+{
+  g_assert_cmpuint (n_params, ==, 3);
+
+  g_assert_cmpint (params[0].param_type, ==, GP_PARAM_TYPE_INT);
+  g_assert_cmpstr (params[0].type_name, ==, "GimpPDBStatusType");
+  g_assert_cmpint (params[0].data.d_int, ==, id);
+
+  g_assert_cmpint (params[1].param_type, ==, GP_PARAM_TYPE_DOUBLE);
+  g_assert_cmpstr (params[1].type_name, ==, "gdouble");
+  g_assert_cmpfloat (params[1].data.d_double, ==, id + 0.25);
+
+  g_assert_cmpint (params[2].param_type, ==, GP_PARAM_TYPE_STRING);
+  g_assert_cmpstr (params[2].type_name, ==, "gchararray");
+  g_assert_cmpstr (params[2].data.d_string, ==, id % 2 ? "odd" : "even");
+}
+
+static void
+proc_batch_run (void)
+{
+  static gchar   *names[] = { "test-first", "test-second", "test-third" };
+  WireBuffer      buffer;
+  GPParam         params[G_N_ELEMENTS (names)][3];
+  GPProcRun       procs[G_N_ELEMENTS (names)];
+  GPProcBatchRun  proc_batch_run;
+  GPProcBatchRun *result;
+  GimpWireMessage msg;
+  guint           i;
+
+  wire_buffer_init (&buffer);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      params_init (params[i], i);
+
+      procs[i].name     = names[i];
+      procs[i].n_params = G_N_ELEMENTS (params[i]);
+      procs[i].params   = params[i];
+    }
+
+  proc_batch_run.n_procs = G_N_ELEMENTS (procs);
+  proc_batch_run.procs   = procs;
+
+  g_assert_true (gp_proc_batch_run_write (NULL, &proc_batch_run, &buffer));
+  g_assert_true (gimp_wire_read_msg (NULL, &msg, &buffer));
+  g_assert_cmpuint (buffer.pos, ==, buffer.data->len);
+
+  g_assert_cmpuint (msg.type, ==, GP_PROC_BATCH_RUN);
+
+  result = msg.data;
+
+  g_assert_nonnull (result);
+  g_assert_cmpuint (result->n_procs, ==, G_N_ELEMENTS (names));
+
+  for (i = 0; i < result->n_procs; i++)
+    {
+      g_assert_cmpstr (result->procs[i].name, ==, names[i]);
+
+      params_check (result->procs[i].params, result->procs[i].n_params, i);
+    }
+
+  gimp_wire_destroy (&msg);
+  wire_buffer_free (&buffer);
+}
+
+static void
+proc_batch_return (void)
+{
+  static gchar      *names[] = { "test-first", "test-second" };
+  WireBuffer         buffer;
+  GPParam            status[1];
+  GPParam            params[3];
+  GPProcReturn       procs[G_N_ELEMENTS (names)];
+  GPProcBatchReturn  proc_batch_return;
+  GPProcBatchReturn *result;
+  GimpWireMessage    msg;
+
+  wire_buffer_init (&buffer);
+
+  /*  a failed call only returns its status  */
+  status[0].param_type = GP_PARAM_TYPE_INT;
+  status[0].type_name  = "GimpPDBStatusType";
+  status[0].data.d_int = GIMP_PDB_CALLING_ERROR;
+
+  procs[0].name     = names[0];
+  procs[0].n_params = G_N_ELEMENTS (status);
+  procs[0].params   = status;
+
+  params_init (params, GIMP_PDB_SUCCESS);
+
+  procs[1].name     = names[1];
+  procs[1].n_params = G_N_ELEMENTS (params);
+  procs[1].params   = params;
+
+  proc_batch_return.n_procs = G_N_ELEMENTS (procs);
+  proc_batch_return.procs   = procs;
+
+  g_assert_true (gp_proc_batch_return_write (NULL, &proc_batch_return,
+                                             &buffer));
+  g_assert_true (gimp_wire_read_msg (NULL, &msg, &buffer));
+  g_assert_cmpuint (buffer.pos, ==, buffer.data->len);
+
+  g_assert_cmpuint (msg.type, ==, GP_PROC_BATCH_RETURN);
+
+  result = msg.data;
+
+  g_assert_nonnull (result);
+  g_assert_cmpuint (result->n_procs, ==, G_N_ELEMENTS (names));
+
+  g_assert_cmpstr (result->procs[0].name, ==, names[0]);
+  g_assert_cmpuint (result->procs[0].n_params, ==, 1);
+  g_assert_cmpint (result->procs[0].params[0].data.d_int, ==,
+                   GIMP_PDB_CALLING_ERROR);
+
+  g_assert_cmpstr (result->procs[1].name, ==, names[1]);
+  params_check (result->procs[1].params, result->procs[1].n_params,
+                GIMP_PDB_SUCCESS);
+
+  gimp_wire_destroy (&msg);
+  wire_buffer_free (&buffer);
+}
+
+static void
+proc_batch_run_empty (void)
+{
+  WireBuffer      buffer;
+  GPProcBatchRun  proc_batch_run = { 0, NULL };
+  GPProcBatchRun *result;
+  GimpWireMessage msg;
+
+  wire_buffer_init (&buffer);
+
+  g_assert_true (gp_proc_batch_run_write (NULL, &proc_batch_run, &buffer));
+  g_assert_true (gimp_wire_read_msg (NULL, &msg, &buffer));
+
+  result = msg.data;
+
+  g_assert_nonnull (result);
+  g_assert_cmpuint (result->n_procs, ==, 0);
+
+  gimp_wire_destroy (&msg);
+  wire_buffer_free (&buffer);
+}
+
+static void
+proc_batch_run_truncated (void)
+{
+  static gchar    *names[] = { "test-first", "test-second" };
+  WireBuffer       buffer;
+  GPParam          params[G_N_ELEMENTS (names)][3];
+  GPProcRun        procs[G_N_ELEMENTS (names)];
+  GPProcBatchRun   proc_batch_run;
+  GimpWireMessage  msg;
+  guint            full_length;
+  guint            i;
+
+  wire_buffer_init (&buffer);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      params_init (params[i], i);
+
+      procs[i].name     = names[i];
+      procs[i].n_params = G_N_ELEMENTS (params[i]);
+      procs[i].params   = params[i];
+    }
+
+  proc_batch_run.n_procs = G_N_ELEMENTS (procs);
+  proc_batch_run.procs   = procs;
+
+  g_assert_true (gp_proc_batch_run_write (NULL, &proc_batch_run, &buffer));
+
+  full_length = buffer.data->len;
+
+  /*  cut the message at every possible point, reading it must fail
+   *  cleanly every time
+   */
+  for (i = sizeof (guint32); i < full_length; i++)
+    {
+      g_byte_array_set_size (buffer.data, i);
+      buffer.pos = 0;
+      gimp_wire_clear_error ();
+
+      memset (&msg, 0, sizeof (msg));
+
+      g_assert_false (gimp_wire_read_msg (NULL, &msg, &buffer));
+
+      if (msg.type == GP_PROC_BATCH_RUN)
+        gimp_wire_destroy (&msg);
+    }
+
+  wire_buffer_free (&buffer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  gp_init ();
+
+  gimp_wire_set_reader (wire_buffer_read);
+  gimp_wire_set_writer (wire_buffer_write);
+  gimp_wire_set_flusher (wire_buffer_flush);
+
+  g_test_add_func ("/protocol/proc-batch-run", proc_batch_run);
+  g_test_add_func ("/protocol/proc-batch-return", proc_batch_return);
+  g_test_add_func ("/protocol/proc-batch-run-empty", proc_batch_run_empty);
+  g_test_add_func ("/protocol/proc-batch-run-truncated",
+                   proc_batch_run_truncated);
+
+  return g_test_run ();
+}